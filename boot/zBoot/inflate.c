@@ -84,6 +84,20 @@ ush mask_bits[] = {
 #define NEEDBITS(n) {while(k<(n)){b|=((ulg)NEXTBYTE())<<k;k+=8;}}
 #define DUMPBITS(n) {b>>=(n);k-=(n);}
 
+/* FILLBITS() tops up a low bit buffer with three bytes from a single
+   word load, so that the NEEDBITS() of a whole literal or length and
+   distance pair that follows it rarely has to go byte by byte.  It only
+   reads from inbuf while a whole word is left in it, which leaves the
+   refill at the end of the buffer to get_byte(), and the bytes taken
+   beyond what is used are still given back by the lookahead undo at the
+   end of inflate().  The bytes are loaded little endian, as on the i386. */
+#ifdef CRYPT
+#  define FILLBITS()
+#else
+#  define FILLBITS() {if(k<=8&&inptr+4<=insize){\
+     b|=(*(ulg *)(inbuf+inptr)&0xffffffL)<<k;inptr+=3;k+=24;}}
+#endif
+
 int lbits = 9;          /* bits in base literal/length lookup table */
 int dbits = 6;          /* bits in base distance lookup table */
 
@@ -350,6 +364,7 @@ int bl, bd;             /* number of bits decoded by tl[] and td[] */
   md = mask_bits[bd];
   for (;;)                      /* do until end of block */
   {
+    FILLBITS()
     NEEDBITS((unsigned)bl)
     if ((e = (t = tl + ((unsigned)b & ml))->e) > 16)
       do {
@@ -381,6 +396,7 @@ int bl, bd;             /* number of bits decoded by tl[] and td[] */
       DUMPBITS(e);
 
       /* decode distance of block to copy */
+      FILLBITS()
       NEEDBITS((unsigned)bd)
       if ((e = (t = td + ((unsigned)b & md))->e) > 16)
         do {
@@ -405,6 +421,23 @@ int bl, bd;             /* number of bits decoded by tl[] and td[] */
           w += e;
           d += e;
         }
+        else if (w - d == 1)      /* a run of the last byte */
+        {
+          memset(slide + w, slide[d], e);
+          w += e;
+          d += e;
+        }
+        else if (w - d >= sizeof(ulg))  /* overlaps, but not within a word */
+        {
+          for (; e >= sizeof(ulg); e -= sizeof(ulg))
+          {
+            *(ulg *)(slide + w) = *(ulg *)(slide + d);
+            w += sizeof(ulg);
+            d += sizeof(ulg);
+          }
+          while (e--)
+            slide[w++] = slide[d++];
+        }
         else                      /* do it slow to avoid memcpy() overlap */
 #endif /* !NOMEMCPY */
           do {
@@ -160,22 +160,57 @@ static void puts(const char *s)
 
 #undef memset
 
+/*
+ * memset() and memcpy() go a word at a time with the string instructions,
+ * and finish the last bytes one at a time.  They fill the matches of
+ * inflate() and copy every window out to the kernel, so they are most of
+ * the time spent in moving bytes at boot.  Most matches are only a few
+ * bytes long, too short to make up for starting a rep, so those are
+ * copied by a plain loop.
+ */
+#define SHORT_COPY 16
+
 __ptr_t memset(__ptr_t s, int c, size_t n)
 {
-	int i;
-	char *ss = (char*)s;
+	int d0, d1;
+	unsigned long fill = (unsigned char)c * 0x01010101UL;
+
+	if (n < SHORT_COPY) {
+		char *ss = (char *)s;
 
-	for (i=0;i<n;i++) ss[i] = c;
+		while (n--) *ss++ = c;
+		return s;
+	}
+	__asm__ __volatile__(
+		"rep ; stosl\n\t"
+		"movl %4,%%ecx\n\t"
+		"rep ; stosb"
+		: "=&c" (d0), "=&D" (d1)
+		: "a" (fill), "0" (n / 4), "g" (n & 3), "1" (s)
+		: "memory");
+	return s;
 }
 
 
 void *memcpy(void* __dest, __const void * __src,
 			    size_t __n)
 {
-	int i;
-	char *d = (char *)__dest, *s = (char *)__src;
+	int d0, d1, d2;
 
-	for (i=0;i<__n;i++) d[i] = s[i];
+	if (__n < SHORT_COPY) {
+		char *d = (char *)__dest, *s = (char *)__src;
+
+		while (__n--) *d++ = *s++;
+		return __dest;
+	}
+	__asm__ __volatile__(
+		"rep ; movsl\n\t"
+		"movl %4,%%ecx\n\t"
+		"rep ; movsb"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (__n / 4), "g" (__n & 3), "1" (__dest), "2" (__src)
+		: "memory");
+	return __dest;
 }
 
 int memcmp(const void *__s1, const void *__s2, size_t __n)
@@ -232,7 +267,7 @@ void clear_bufs()
  */
 int fill_inbuf()
 {
-    int len, i;
+    int len;
 
     /* Read as much as possible */
     insize = 0;
@@ -241,7 +276,7 @@ int fill_inbuf()
 	if (len > (input_len-input_ptr+1)) len=input_len-input_ptr+1;
         if (len == 0 || len == EOF) break;
 
-        for (i=0;i<len;i++) inbuf[insize+i] = input_data[input_ptr+i];
+        memcpy(inbuf+insize, input_data+input_ptr, len);
 	insize += len;
 	input_ptr += len;
     } while (insize < INBUFSIZ);
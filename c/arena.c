@@ -0,0 +1,93 @@
+/* arena.c : per-process memory arenas
+ */
+
+#include <i386.h>
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where the memory arenas of processes are managed. Each process has an
+ * arena that it bump-allocates from through sysalloc, and the arena is released in
+ * bulk when the process is cleaned up, so the allocations of a process are never
+ * freed one at a time.
+ *
+ * Notes on the arenas:
+ * - An arena is a list of chunks, each chunk is a block of pages from the page
+ *   allocator that starts with a header
+ * - Allocations are served from the chunk at the head of the list, a new chunk
+ *   is added at the head when the request does not fit in the bytes left over
+ * - Every allocation is rounded up to a paragraph
+ *
+ * List of functions that are called from outside this file:
+ * - arena_alloc
+ *   - Returns a pointer to the allocated memory if successful, NULL otherwise
+ * - arena_release
+ *   - Releases all the memory in the arena of a process
+ *-----------------------------------------------------------------------------------
+ */
+
+// The smallest chunk is 2^1 pages
+#define ARENA_CHUNK_ORDER 1
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    // The order of the block of pages holding the chunk
+    int order;
+    // Next free byte of the chunk
+    unsigned long top;
+    // End of the chunk
+    unsigned long end;
+    unsigned char data_start[0];
+} arena_chunk_t;
+
+/*-----------------------------------------------------------------------------------
+ * Allocates memory from the arena of the given process.
+ *
+ * @param proc The process to allocate for
+ * @param size The number of bytes to allocate
+ * @return     A pointer to the start of the allocated memory if successful, NULL if
+ *             the size is invalid or not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *arena_alloc(pcb_t *proc, size_t size) {
+    if (size <= 0 || size > (NBPG << (NUM_PAGE_ORDERS - 1)) - sizeof(arena_chunk_t)) {
+        return NULL;
+    }
+    size = (size + PARAGRAPH_SIZE - 1) & ~(PARAGRAPH_SIZE - 1);
+
+    arena_chunk_t *chunk = proc->arena;
+    if (chunk == NULL || chunk->end - chunk->top < size) {
+        int order = page_order(size + sizeof(arena_chunk_t));
+        if (order < ARENA_CHUNK_ORDER) {
+            order = ARENA_CHUNK_ORDER;
+        }
+        chunk = (arena_chunk_t *) kpagealloc(order);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->order = order;
+        chunk->top = (unsigned long) chunk->data_start;
+        chunk->end = (unsigned long) chunk + (NBPG << order);
+        chunk->next = proc->arena;
+        proc->arena = chunk;
+    }
+
+    void *ptr = (void *) chunk->top;
+    chunk->top += size;
+    return ptr;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Releases all the memory in the arena of the given process.
+ *
+ * @param proc The process to release the arena of
+ *-----------------------------------------------------------------------------------
+ */
+void arena_release(pcb_t *proc) {
+    arena_chunk_t *chunk = proc->arena;
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        kpagefree(chunk);
+        chunk = next;
+    }
+    proc->arena = NULL;
+}
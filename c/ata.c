@@ -0,0 +1,881 @@
+/* ata.c : ATA disk specific device driver calls */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <queue.h>
+#include <i386.h>
+#include <bufcache.h>
+#include <ata.h>
+#include <stdarg.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where ATA disk specific device driver calls live. The disk is the master
+ * drive of the primary ATA channel, a block device behind the buffer cache whose
+ * sectors are moved by programmed I/O (PIO), one interrupt per sector, so no process
+ * spins on the status register while the drive seeks.
+ *
+ * Notes on the disk:
+ * - Blocks the buffer cache reads in or writes back are queued as requests, kept
+ *   sorted by sector. A block next to a queued request of the same direction is
+ *   merged into it, so a run of blocks costs one command of up to ATA_MAX_SECTORS
+ *   sectors
+ * - The next request is picked by C-LOOK: the first at or past the sector the last
+ *   one ended at, wrapping around to the lowest once none are left past it, so the
+ *   heads sweep the disk in one direction and no request waits more than a sweep
+ * - A read or write of a process takes the cached blocks it spans, up to
+ *   ATA_IO_BLOCKS of them, and starts reading in those it needs and the cache does
+ *   not hold. It only blocks while they are read in, and ata_isr copies the bytes
+ *   to or from the process once the last of them arrives
+ * - Writes are written back by the cache, so a write returns once its bytes are in
+ *   the cached blocks. IOCTL_SYNC and the close of the disk start writing them out
+ * - In non-blocking mode a read of blocks not yet cached returns BLOCKERR and the
+ *   blocks are still read in, so a later read finds them
+ * - A read or write interrupted by a signal returns interrupted_by_signal without
+ *   moving any bytes, its blocks are still read in for the cache
+ * - The disk is a stream of bytes to processes like the RAM disk, and only one
+ *   process may have it open at a time. Only the first 2GB of a larger disk is
+ *   used, as positions are int byte offsets
+ *
+ * List of functions that are called from outside this file:
+ * - ata_register
+ *   - Registers the ATA disk device
+ * - atainit
+ *   - ATA disk specific call for di_init
+ * - ataopen
+ *   - ATA disk specific call for di_open
+ * - ataclose
+ *   - ATA disk specific call for di_close
+ * - ataread
+ *   - ATA disk specific call for di_read
+ * - atawrite
+ *   - ATA disk specific call for di_write
+ * - ataioctl
+ *   - ATA disk specific call for di_ioctl
+ * - atapoll
+ *   - ATA disk specific call for syspoll
+ * - ataaioread
+ *   - ATA disk specific call for di_aioread
+ * - atastep
+ *   - ATA disk specific call for di_step
+ * - ata_merge
+ *   - Merges a transfer into a queued request next to it
+ * - ata_insert
+ *   - Adds a request to a queue in sector order
+ * - ata_take_next
+ *   - Takes the request C-LOOK picks next off a queue
+ * - ata_isr
+ *   - ATA disk ISR
+ *-----------------------------------------------------------------------------------
+ */
+
+// A read or write of a process, in progress until the blocks it waits on are in
+typedef struct ata_io {
+    int in_use;
+    int write;
+    char *data;
+    // The byte offset into the first block, and the bytes to move
+    int offset;
+    int len;
+    // The blocks spanned, and whether each one is waited on
+    int num_bufs;
+    buf_t *bufs[ATA_IO_BLOCKS];
+    int waiting[ATA_IO_BLOCKS];
+    int pending;
+    // The process blocked in the read or write, empty once it no longer waits
+    Queue waiters;
+} ata_io_t;
+
+static unsigned int identify(void);
+static int start_io(pcb_t *proc, char *data, int len, int write, int nonblocking);
+static int complete_io(ata_io_t *io, int deliver);
+static void buffer_done(buf_t *buf);
+static void queue_read(buf_t *buf);
+static int read_block(blkdev_t *dev, buf_t *buf);
+static int write_block(blkdev_t *dev, buf_t *buf);
+static void submit(buf_t *buf, int write);
+static void start_next(void);
+static int issue(ata_request_t *req);
+static void finish_request(ata_request_t *req, int error);
+static int wait_status(unsigned char mask, unsigned char value);
+static void read_sector(char *data);
+static void write_sector(char *data);
+static int ataioctl_seek(void *ioctl_args);
+static int ataioctl_cache_stats(void *ioctl_args);
+static int ataioctl_disk_stats(void *ioctl_args);
+static int min(int a, int b);
+
+// The requests, as many as there are buffers since a buffer is in one at a time
+static ata_request_t requests[NUM_BUFS];
+static ata_request_t *free_requests;
+// The queued requests sorted by sector, and the request the drive is working on
+// with the number of its sectors done
+static ata_request_t *request_queue;
+static ata_request_t *active;
+static int active_sectors_done;
+// The sector after the last one the drive was sent to, where C-LOOK picks up
+static unsigned int head_lba;
+
+static ata_io_t ios[ATA_MAX_IOS];
+static blkdev_t ata_blkdev;
+// Whether a drive answered IDENTIFY, and its size in bytes
+static int drive_present;
+static int disk_bytes;
+// The process that has the disk open, NULL if it is not in use, and the byte
+// offset of its next read or write
+static pcb_t *ata_proc;
+static int position;
+static ata_stats_t stats;
+// The device structure registered in the device table
+static devsw_t ata_devsw;
+
+/*======================== ATA DISK DEVICE DRIVER UPPER HALF ======================*/
+
+/*-----------------------------------------------------------------------------------
+ * Registers the ATA disk device as ATA_0.
+ *-----------------------------------------------------------------------------------
+ */
+void ata_register(void) {
+    devsw_t *devsw = &ata_devsw;
+    devsw->dvioblk = &ata_blkdev;
+    devsw->dvinit = &atainit;
+    devsw->dvopen = &ataopen;
+    devsw->dvclose = &ataclose;
+    devsw->dvread = &ataread;
+    devsw->dvwrite = &atawrite;
+    devsw->dvioctl = &ataioctl;
+    devsw->dvpoll = &atapoll;
+    devsw->dvaioread = &ataaioread;
+    devsw->dvstep = &atastep;
+    di_register(devsw, "/dev/hda", ATA_0, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the ATA disk device. Asks the drive for its size, and enables its
+ * interrupt if it answers.
+ *
+ * @return 0 on success, also when there is no drive, in which case opens fail
+ *-----------------------------------------------------------------------------------
+ */
+int atainit(void) {
+    free_requests = NULL;
+    for (int i = 0; i < NUM_BUFS; i++) {
+        requests[i].next = free_requests;
+        free_requests = &requests[i];
+    }
+    request_queue = NULL;
+    active = NULL;
+    head_lba = 0;
+    for (int i = 0; i < ATA_MAX_IOS; i++) {
+        ios[i].in_use = 0;
+        init_queue(&ios[i].waiters);
+    }
+    ata_proc = NULL;
+    fill_words(&stats, 0, sizeof(stats));
+
+    unsigned int sectors = identify();
+    drive_present = sectors > 0;
+    if (!drive_present) {
+        return 0;
+    }
+    // Positions are int byte offsets, so the disk is cut to fit them
+    if (sectors > 0x7FFFFFFF / BLOCK_SIZE) {
+        sectors = 0x7FFFFFFF / BLOCK_SIZE;
+    }
+    ata_blkdev.num_blocks = sectors;
+    ata_blkdev.read_block = &read_block;
+    ata_blkdev.write_block = &write_block;
+    disk_bytes = sectors * BLOCK_SIZE;
+
+    outb(ATA_CONTROL_PORT, 0);
+    enable_irq(ATA_IRQ, 0);
+    // The second interrupt controller is cascaded on IRQ 2
+    enable_irq(2, 0);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_open. Starts the position at the start of the disk.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success, -1 if there is no drive or another process has the
+ *                  disk open
+ *-----------------------------------------------------------------------------------
+ */
+int ataopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    if (!drive_present || ata_proc) {
+        return -1;
+    }
+    ata_proc = proc;
+    position = 0;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_close. Starts writing the changed blocks in the
+ * buffer cache out to the disk.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int ataclose(devsw_t *devsw, pcb_t *proc) {
+    bsync(devsw->dvioblk);
+    ata_proc = NULL;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_read. Copies bytes from the cached blocks from the
+ * position on, once they are read in, and moves the position past them.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF)
+ *                    -1 if no block could be read
+ *                    BLOCKERR if the blocks are being read in in non-blocking mode
+ *                    -2 if the sysread call is blocked, the dispatcher is to switch
+ *                    processes
+ *-----------------------------------------------------------------------------------
+ */
+int ataread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    if (buflen == 0 || position == disk_bytes) {
+        return 0;
+    }
+    return start_io(proc, (char *) buf, buflen, 0, nonblocking);
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_write. Copies bytes into the cached blocks from the
+ * position on, and moves the position past them. Blocks written whole are not read
+ * in first, the others are before the write completes.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written on success
+ *               -1 if no bytes could be written
+ *               -2 if the syswrite call is blocked, the dispatcher is to switch
+ *               processes
+ *-----------------------------------------------------------------------------------
+ */
+int atawrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    if (buflen == 0 || position == disk_bytes) {
+        return -1;
+    }
+    return start_io(proc, (char *) buf, buflen, 1, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_ioctl.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command, one of IOCTL_SEEK with the byte offset,
+ *                   IOCTL_SYNC, IOCTL_CACHE_STATS with a pointer to a
+ *                   bufcache_stats_t, or IOCTL_DISK_STATS with a pointer to an
+ *                   ata_stats_t
+ * @param ioctl_args Additional parameters
+ * @return           0 on success, -1 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int ataioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    switch (command) {
+        case (IOCTL_SEEK):
+            return ataioctl_seek(ioctl_args);
+        case (IOCTL_SYNC):
+            return bsync(devsw->dvioblk);
+        case (IOCTL_CACHE_STATS):
+            return ataioctl_cache_stats(ioctl_args);
+        case (IOCTL_DISK_STATS):
+            return ataioctl_disk_stats(ioctl_args);
+        default:
+            // Invalid IOCTL request
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for syspoll. A read only waits for the drive, which it
+ * always answers, so it counts as not blocking.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 as a read would not block on input
+ *-----------------------------------------------------------------------------------
+ */
+int atapoll(devsw_t *devsw, pcb_t *proc) {
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_aioread. Asynchronous reads are not supported by the
+ * disk, a process that must not block on it reads it in non-blocking mode.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as asynchronous reads are not supported
+ *-----------------------------------------------------------------------------------
+ */
+int ataaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * ATA disk specific call for di_step. Reads or writes up to the end of the block at
+ * the position if the block need not be read in first, as ataread and atawrite
+ * would in non-blocking mode. A block the cache does not hold is still read in, for
+ * the dispatcher to finish the call with.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called sysread or syswrite
+ * @param buf    The buffer to read into or write from
+ * @param buflen The upper limit of bytes to move
+ * @param write  1 for syswrite, 0 for sysread
+ * @return       The result of ataread or atawrite for the bytes moved
+ *               BLOCKERR if the block is being read in
+ *-----------------------------------------------------------------------------------
+ */
+int atastep(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int write) {
+    if (buflen == 0 || position == disk_bytes) {
+        return write ? -1 : 0;
+    }
+    int n = min(buflen, BLOCK_SIZE - position % BLOCK_SIZE);
+    return start_io(proc, (char *) buf, n, write, 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Asks the drive to identify itself, with its interrupt masked.
+ *
+ * @return The number of sectors the drive addresses by LBA, 0 if there is no ATA
+ *         drive
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned int identify(void) {
+    outb(ATA_CONTROL_PORT, ATA_CONTROL_NIEN);
+    outb(ATA_BASE_PORT + ATA_DRIVE, ATA_DRIVE_MASTER_LBA);
+    outb(ATA_BASE_PORT + ATA_SECTOR_COUNT, 0);
+    outb(ATA_BASE_PORT + ATA_LBA_LOW, 0);
+    outb(ATA_BASE_PORT + ATA_LBA_MID, 0);
+    outb(ATA_BASE_PORT + ATA_LBA_HIGH, 0);
+    outb(ATA_BASE_PORT + ATA_COMMAND, ATA_CMD_IDENTIFY);
+
+    // A status of 0 means no drive, and one of all bits set means no channel
+    unsigned char status = inb(ATA_BASE_PORT + ATA_STATUS);
+    if (status == 0 || status == 0xFF || wait_status(ATA_STATUS_BSY, 0)) {
+        return 0;
+    }
+    // A packet device such as a CD drive sets the LBA registers to its signature
+    if (inb(ATA_BASE_PORT + ATA_LBA_MID) || inb(ATA_BASE_PORT + ATA_LBA_HIGH)) {
+        return 0;
+    }
+    if (wait_status(ATA_STATUS_DRQ, ATA_STATUS_DRQ)) {
+        return 0;
+    }
+    unsigned short words[BLOCK_SIZE / 2];
+    read_sector((char *) words);
+    // Words 60 and 61 hold the number of sectors addressed by 28 bit LBA
+    return words[60] | ((unsigned int) words[61] << 16);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Starts a read or write of the given process from the position on, taking the
+ * blocks it spans and reading in those it needs.
+ *
+ * @return The result of the sysread or syswrite call, -2 if the process is blocked
+ *         until the blocks are read in
+ *-----------------------------------------------------------------------------------
+ */
+static int start_io(pcb_t *proc, char *data, int len, int write, int nonblocking) {
+    ata_io_t *io = NULL;
+    for (int i = 0; i < ATA_MAX_IOS && io == NULL; i++) {
+        if (!ios[i].in_use) {
+            io = &ios[i];
+        }
+    }
+    if (io == NULL) {
+        return -1;
+    }
+
+    // The read or write waits on its setup too, so a block read in while the others
+    // are still taken does not complete it early
+    io->in_use = 1;
+    io->pending = 1;
+    io->write = write;
+    io->data = data;
+    io->offset = position % BLOCK_SIZE;
+    io->len = min(len, disk_bytes - position);
+    io->num_bufs = 0;
+    unsigned int first_block = position / BLOCK_SIZE;
+    int done = 0;
+    while (done < io->len && io->num_bufs < ATA_IO_BLOCKS) {
+        int offset = io->num_bufs == 0 ? io->offset : 0;
+        int n = min(io->len - done, BLOCK_SIZE - offset);
+        buf_t *b = bget(&ata_blkdev, first_block + io->num_bufs);
+        if (b == NULL) {
+            break;
+        }
+        int i = io->num_bufs;
+        io->bufs[i] = b;
+        io->waiting[i] = 0;
+        // A block written whole is not read in, unless a read of it already started
+        // would overwrite what is written
+        if (!(b->flags & BUF_VALID) && (!write || n < BLOCK_SIZE || (b->flags & BUF_BUSY))) {
+            io->waiting[i] = 1;
+            io->pending++;
+            if (!(b->flags & BUF_BUSY)) {
+                queue_read(b);
+            }
+        }
+        io->num_bufs++;
+        done += n;
+    }
+    if (io->num_bufs == 0) {
+        io->in_use = 0;
+        return -1;
+    }
+    io->len = done;
+    // The reads are queued together so adjacent blocks are merged before the first
+    // is sent
+    start_next();
+
+    if (--io->pending == 0) {
+        return complete_io(io, 1);
+    }
+    if (nonblocking) {
+        return BLOCKERR;
+    }
+    proc->state = BLOCKED;
+    proc->blocked_queue = DISK;
+    proc->wait_queue = &io->waiters;
+    enqueue(&io->waiters, proc);
+    return -2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finishes a read or write once none of its blocks are waited on, moving its bytes
+ * if it is still to deliver them, and releases its blocks. A read stops at the
+ * first block that could not be read in.
+ *
+ * @return The number of bytes moved, -1 if none could be
+ *-----------------------------------------------------------------------------------
+ */
+static int complete_io(ata_io_t *io, int deliver) {
+    int done = 0;
+    int failed = !deliver;
+    for (int i = 0; i < io->num_bufs; i++) {
+        buf_t *b = io->bufs[i];
+        int offset = i == 0 ? io->offset : 0;
+        int n = min(io->len - done, BLOCK_SIZE - offset);
+        if (!(b->flags & BUF_VALID) && !(io->write && n == BLOCK_SIZE)) {
+            failed = 1;
+        }
+        if (!failed) {
+            if (io->write) {
+                copy_words(b->data + offset, io->data + done, n);
+                bdirty(b);
+            } else {
+                copy_words(io->data + done, b->data + offset, n);
+            }
+            done += n;
+        }
+        brelse(b);
+    }
+    io->in_use = 0;
+    position += done;
+    return done > 0 ? done : -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Counts the given block as read in, or as failed to, for every read or write
+ * waiting on it, and completes those left waiting on no other block.
+ *-----------------------------------------------------------------------------------
+ */
+static void buffer_done(buf_t *buf) {
+    for (int i = 0; i < ATA_MAX_IOS; i++) {
+        ata_io_t *io = &ios[i];
+        if (!io->in_use) {
+            continue;
+        }
+        for (int j = 0; j < io->num_bufs; j++) {
+            if (io->waiting[j] && io->bufs[j] == buf) {
+                io->waiting[j] = 0;
+                io->pending--;
+            }
+        }
+        if (io->pending == 0) {
+            // The process stopped waiting if it was interrupted by a signal
+            pcb_t *proc = dequeue(&io->waiters);
+            int result = complete_io(io, proc != NULL);
+            if (proc != NULL) {
+                proc->result_code = result;
+                ready(proc);
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Starts reading the block of the given buffer in, for the buffer cache.
+ *-----------------------------------------------------------------------------------
+ */
+static int read_block(blkdev_t *dev, buf_t *buf) {
+    queue_read(buf);
+    start_next();
+    return BLK_STARTED;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Queues a read of the block of the given buffer without starting the drive. The
+ * buffer is held and busy until the read completes.
+ *-----------------------------------------------------------------------------------
+ */
+static void queue_read(buf_t *buf) {
+    bhold(buf);
+    buf->flags |= BUF_BUSY;
+    submit(buf, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Starts writing the given buffer out to its block, for the buffer cache. The
+ * buffer is held and busy until the write completes. A buffer changed while it is
+ * being written is left dirty, to be written again later.
+ *-----------------------------------------------------------------------------------
+ */
+static int write_block(blkdev_t *dev, buf_t *buf) {
+    if (buf->flags & BUF_BUSY) {
+        return BLK_STARTED;
+    }
+    bhold(buf);
+    buf->flags = (buf->flags | BUF_BUSY) & ~BUF_DIRTY;
+    submit(buf, 1);
+    start_next();
+    return BLK_STARTED;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Queues a transfer of the given buffer, merging it into a queued request of the
+ * same direction it is next to, or else into a new request in sector order.
+ *-----------------------------------------------------------------------------------
+ */
+static void submit(buf_t *buf, int write) {
+    if (ata_merge(request_queue, buf, write)) {
+        stats.merges++;
+        return;
+    }
+
+    // There is a request for every buffer, so one is always free
+    ata_request_t *req = free_requests;
+    free_requests = req->next;
+    req->lba = buf->blockno;
+    req->count = 1;
+    req->write = write;
+    req->bufs[0] = buf;
+    ata_insert(&request_queue, req);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Merges a transfer of the given buffer into a request of the same direction in the
+ * given queue that it is next to, if one has room for it.
+ *
+ * @param queue The first request of the queue, sorted by sector
+ * @param buf   The buffer to transfer
+ * @param write Whether the transfer is a write
+ * @return      1 if the transfer was merged, 0 if it needs a request of its own
+ *-----------------------------------------------------------------------------------
+ */
+int ata_merge(ata_request_t *queue, buf_t *buf, int write) {
+    unsigned int lba = buf->blockno;
+    for (ata_request_t *req = queue; req != NULL; req = req->next) {
+        if (req->write != write || req->count == ATA_MAX_SECTORS) {
+            continue;
+        }
+        if (lba == req->lba + req->count) {
+            req->bufs[req->count++] = buf;
+            return 1;
+        }
+        if (lba + 1 == req->lba) {
+            for (int i = req->count; i > 0; i--) {
+                req->bufs[i] = req->bufs[i - 1];
+            }
+            req->bufs[0] = buf;
+            req->lba = lba;
+            req->count++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given request to the given queue in sector order.
+ *
+ * @param queue A pointer to the first request of the queue, sorted by sector
+ * @param req   The request to add
+ *-----------------------------------------------------------------------------------
+ */
+void ata_insert(ata_request_t **queue, ata_request_t *req) {
+    ata_request_t **link = queue;
+    while (*link != NULL && (*link)->lba < req->lba) {
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    *link = req;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the request C-LOOK picks next off the given queue: the first at or past the
+ * given sector, or else the lowest.
+ *
+ * @param queue    A pointer to the first request of the queue, sorted by sector
+ * @param head_lba The sector after the last one the drive was sent to
+ * @return         The request taken, NULL if the queue is empty
+ *-----------------------------------------------------------------------------------
+ */
+ata_request_t *ata_take_next(ata_request_t **queue, unsigned int head_lba) {
+    ata_request_t **link = queue;
+    while (*link != NULL && (*link)->lba < head_lba) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        link = queue;
+    }
+    ata_request_t *req = *link;
+    if (req != NULL) {
+        *link = req->next;
+    }
+    return req;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sends the drive the next request by C-LOOK if it is idle.
+ *-----------------------------------------------------------------------------------
+ */
+static void start_next(void) {
+    while (active == NULL && request_queue != NULL) {
+        active = ata_take_next(&request_queue, head_lba);
+        active_sectors_done = 0;
+        head_lba = active->lba + active->count;
+        if (issue(active)) {
+            stats.errors++;
+            finish_request(active, 1);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sends the given request to the drive, with the first sector of a write.
+ *
+ * @return 0 on success, -1 if the drive did not take the command
+ *-----------------------------------------------------------------------------------
+ */
+static int issue(ata_request_t *req) {
+    if (wait_status(ATA_STATUS_BSY, 0)) {
+        return -1;
+    }
+    outb(ATA_BASE_PORT + ATA_DRIVE, ATA_DRIVE_MASTER_LBA | ((req->lba >> 24) & 0x0F));
+    outb(ATA_BASE_PORT + ATA_SECTOR_COUNT, req->count);
+    outb(ATA_BASE_PORT + ATA_LBA_LOW, req->lba & 0xFF);
+    outb(ATA_BASE_PORT + ATA_LBA_MID, (req->lba >> 8) & 0xFF);
+    outb(ATA_BASE_PORT + ATA_LBA_HIGH, (req->lba >> 16) & 0xFF);
+    outb(ATA_BASE_PORT + ATA_COMMAND, req->write ? ATA_CMD_WRITE_SECTORS : ATA_CMD_READ_SECTORS);
+    stats.commands++;
+    stats.sectors += req->count;
+
+    if (req->write) {
+        // The drive interrupts after each sector it takes, so the first is sent here
+        if (wait_status(ATA_STATUS_BSY | ATA_STATUS_DRQ, ATA_STATUS_DRQ)) {
+            return -1;
+        }
+        write_sector(req->bufs[0]->data);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Ends the given request once the drive is done with it, or failed on it.
+ * Sectors read in become valid, a failed write leaves its buffers dirty, and the
+ * buffers are released.
+ *-----------------------------------------------------------------------------------
+ */
+static void finish_request(ata_request_t *req, int error) {
+    if (req == active) {
+        active = NULL;
+    }
+    for (int i = 0; i < req->count; i++) {
+        buf_t *buf = req->bufs[i];
+        buf->flags &= ~BUF_BUSY;
+        if (req->write) {
+            if (error) {
+                buf->flags |= BUF_DIRTY;
+            }
+        } else {
+            if (i < active_sectors_done) {
+                buf->flags |= BUF_VALID;
+            }
+            buffer_done(buf);
+        }
+        brelse(buf);
+    }
+    req->next = free_requests;
+    free_requests = req;
+}
+
+/*======================== ATA DISK DEVICE DRIVER LOWER HALF ======================*/
+
+/*-----------------------------------------------------------------------------------
+ * The ATA disk interrupt service routine (ISR). The drive interrupts once for each
+ * sector of a read it has ready, and once for each sector of a write it has taken.
+ * Reading the status acknowledges the interrupt.
+ *-----------------------------------------------------------------------------------
+ */
+void ata_isr(void) {
+    unsigned char status = inb(ATA_BASE_PORT + ATA_STATUS);
+    if (active == NULL || (status & ATA_STATUS_BSY)) {
+        return;
+    }
+    if (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+        stats.errors++;
+        finish_request(active, 1);
+    } else if (!active->write) {
+        if (!(status & ATA_STATUS_DRQ)) {
+            return;
+        }
+        read_sector(active->bufs[active_sectors_done]->data);
+        if (++active_sectors_done == active->count) {
+            finish_request(active, 0);
+        }
+    } else {
+        if (++active_sectors_done == active->count) {
+            finish_request(active, 0);
+        } else {
+            write_sector(active->bufs[active_sectors_done]->data);
+        }
+    }
+    start_next();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Waits for the bits of the status in the given mask to equal the given value,
+ * reading the alternate status so no interrupt is acknowledged.
+ *
+ * @return 0 once they do, -1 if the drive failed or the wait gave up
+ *-----------------------------------------------------------------------------------
+ */
+static int wait_status(unsigned char mask, unsigned char value) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        unsigned char status = inb(ATA_CONTROL_PORT);
+        if (!(status & ATA_STATUS_BSY) && (status & (ATA_STATUS_ERR | ATA_STATUS_DF))) {
+            return -1;
+        }
+        if ((status & mask) == value) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves a sector from the data register into the given data, a word at a time with
+ * a single string instruction.
+ *-----------------------------------------------------------------------------------
+ */
+static void read_sector(char *data) {
+    __asm__ volatile("cld; rep insw"
+        : "+D" (data)
+        : "d" (ATA_BASE_PORT + ATA_DATA), "c" (BLOCK_SIZE / 2)
+        : "memory");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves a sector of the given data into the data register, a word at a time with a
+ * single string instruction.
+ *-----------------------------------------------------------------------------------
+ */
+static void write_sector(char *data) {
+    __asm__ volatile("cld; rep outsw"
+        : "+S" (data)
+        : "d" (ATA_BASE_PORT + ATA_DATA), "c" (BLOCK_SIZE / 2)
+        : "memory");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the position to the byte offset that is the first of the given ioctl
+ * arguments.
+ *
+ * @return 0 on success, -1 if the offset is past the end of the disk
+ *-----------------------------------------------------------------------------------
+ */
+static int ataioctl_seek(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list seek_args = (va_list) ioctl_args;
+    int offset = va_arg(seek_args, int);
+    va_end(seek_args);
+    if (offset < 0 || offset > disk_bytes) {
+        return -1;
+    }
+    position = offset;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the buffer cache into the bufcache_stats_t pointed to by
+ * the first of the given ioctl arguments.
+ *
+ * @return 0 on success, -1 if the pointer is invalid
+ *-----------------------------------------------------------------------------------
+ */
+static int ataioctl_cache_stats(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list stats_args = (va_list) ioctl_args;
+    bufcache_stats_t *cache_stats = va_arg(stats_args, bufcache_stats_t *);
+    va_end(stats_args);
+    if (!valid_buf(cache_stats, sizeof(bufcache_stats_t))) {
+        return -1;
+    }
+    get_bufcache_stats(cache_stats);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the request queue into the ata_stats_t pointed to by the
+ * first of the given ioctl arguments.
+ *
+ * @return 0 on success, -1 if the pointer is invalid
+ *-----------------------------------------------------------------------------------
+ */
+static int ataioctl_disk_stats(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list stats_args = (va_list) ioctl_args;
+    ata_stats_t *disk_stats = va_arg(stats_args, ata_stats_t *);
+    va_end(stats_args);
+    if (!valid_buf(disk_stats, sizeof(ata_stats_t))) {
+        return -1;
+    }
+    *disk_stats = stats;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smaller of the given integers.
+ *-----------------------------------------------------------------------------------
+ */
+static int min(int a, int b) {
+    return a < b ? a : b;
+}
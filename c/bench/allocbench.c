@@ -0,0 +1,311 @@
+/* allocbench.c : allocator stress and fragmentation benchmark */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <bench.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the stress benchmark of the kernel heap, which runs workloads of many
+ * blocks of mixed sizes and lifetimes through kmalloc and kfree to compare
+ * allocators. It keeps its blocks in ALLOC_BENCH_SLOTS slots, and every step of a
+ * workload either allocates a block into an empty slot or frees the block in a
+ * full one.
+ *
+ * Notes on the workloads:
+ * - The random workload picks a slot at random, from the ALLOC_BENCH_SHORT_SLOTS
+ *   short lived slots most of the time and from the others now and then, so the
+ *   blocks in the other slots live far longer. Sizes are mostly small, with a tail
+ *   of medium and large blocks
+ * - The trace workload replays a recorded pattern of the kernel, a process being
+ *   spawned with a stack and an arena, exchanging messages through a pipe and
+ *   stopping, over and over. Each round keeps the blocks of the last one alive
+ *   until it is half done, so the rounds overlap like processes do
+ * - Both workloads start from the same seed, so a run is repeated exactly on
+ *   another allocator
+ *
+ * Notes on the results:
+ * - Every ALLOC_BENCH_INTERVAL steps the fragmentation of the heap is reported, in
+ *   thousandths of the free bytes that are not in the largest free block, with the
+ *   number of free blocks
+ * - At the end the cycles taken by kmalloc and kfree are reported, the worst case
+ *   being the maximum, with the throughput in operations per 2^20 cycles and the
+ *   allocations that failed
+ *
+ * List of functions that are called from outside this file:
+ * - run_alloc_bench
+ *   - Runs the allocator stress benchmark
+ *-----------------------------------------------------------------------------------
+ */
+
+// Blocks live at once, and those of them that are short lived
+#define ALLOC_BENCH_SLOTS 256
+#define ALLOC_BENCH_SHORT_SLOTS 32
+// Steps of the random workload, and steps between reports of the fragmentation
+#define ALLOC_BENCH_STEPS 32768
+#define ALLOC_BENCH_INTERVAL 4096
+// Rounds of the trace workload
+#define ALLOC_BENCH_ROUNDS 512
+#define ALLOC_BENCH_SEED 55
+
+typedef enum {
+    ALLOC_OP_ALLOC,
+    ALLOC_OP_FREE
+} alloc_op_type_t;
+
+// A step of the trace workload, on a slot of the round
+typedef struct alloc_op {
+    alloc_op_type_t type;
+    int slot;
+    size_t size;
+} alloc_op_t;
+
+typedef struct alloc_workload {
+    bench_stats_t alloc_stats;
+    bench_stats_t free_stats;
+    int steps;
+    int failed;
+} alloc_workload_t;
+
+static void random_workload(void);
+static size_t random_size(void);
+static void trace_workload(void);
+static void alloc_step(alloc_workload_t *workload, int slot, size_t size);
+static void free_step(alloc_workload_t *workload, int slot);
+static void report_fragmentation(char *name, int steps);
+static void report_workload(char *name, alloc_workload_t *workload);
+static void free_all(void);
+
+// The trace of a round, slots counted from the first slot of the round
+static alloc_op_t const trace[] = {
+        {ALLOC_OP_ALLOC, 0, PROCESS_STACK_SIZE},
+        {ALLOC_OP_ALLOC, 1, 512},
+        {ALLOC_OP_ALLOC, 2, 4096},
+        {ALLOC_OP_ALLOC, 3, 64},
+        {ALLOC_OP_ALLOC, 4, 64},
+        {ALLOC_OP_FREE, 3, 0},
+        {ALLOC_OP_ALLOC, 5, 200},
+        {ALLOC_OP_ALLOC, 3, 64},
+        {ALLOC_OP_FREE, 4, 0},
+        {ALLOC_OP_ALLOC, 6, 1500},
+        {ALLOC_OP_FREE, 5, 0},
+        {ALLOC_OP_ALLOC, 4, 32},
+        {ALLOC_OP_FREE, 3, 0},
+        {ALLOC_OP_FREE, 6, 0},
+        {ALLOC_OP_ALLOC, 7, 16384},
+        {ALLOC_OP_FREE, 4, 0},
+        {ALLOC_OP_FREE, 2, 0},
+        {ALLOC_OP_FREE, 7, 0},
+        {ALLOC_OP_FREE, 1, 0},
+        {ALLOC_OP_FREE, 0, 0}
+};
+#define TRACE_LENGTH (sizeof(trace) / sizeof(trace[0]))
+// Slots a round of the trace uses
+#define TRACE_SLOTS 8
+
+static void *slots[ALLOC_BENCH_SLOTS];
+
+/*-----------------------------------------------------------------------------------
+ * Runs the allocator stress benchmark, to be called at boot after kstackinit,
+ * before anything else allocates from the heap. Every block is freed again before
+ * it returns.
+ *-----------------------------------------------------------------------------------
+ */
+void run_alloc_bench(void) {
+    memset(slots, 0, sizeof(slots));
+    random_workload();
+    trace_workload();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the random workload.
+ *-----------------------------------------------------------------------------------
+ */
+static void random_workload(void) {
+    alloc_workload_t workload;
+    memset(&workload, 0, sizeof(workload));
+    bench_reset(&workload.alloc_stats);
+    bench_reset(&workload.free_stats);
+    srand(ALLOC_BENCH_SEED);
+    for (int step = 1; step <= ALLOC_BENCH_STEPS; step++) {
+        int slot;
+        if (rand() % 8 != 0) {
+            slot = rand() % ALLOC_BENCH_SHORT_SLOTS;
+        } else {
+            slot = rand() % ALLOC_BENCH_SLOTS;
+        }
+        if (slots[slot] == NULL) {
+            alloc_step(&workload, slot, random_size());
+        } else {
+            free_step(&workload, slot);
+        }
+        workload.steps = step;
+        if (step % ALLOC_BENCH_INTERVAL == 0) {
+            report_fragmentation("alloc_random_frag", step);
+        }
+    }
+    free_all();
+    report_workload("alloc_random", &workload);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Picks the size of a block of the random workload, 16 to 256 bytes for 7 in 10
+ * blocks, up to 4KB for 1 in 4, and up to 32KB for the rest.
+ *-----------------------------------------------------------------------------------
+ */
+static size_t random_size(void) {
+    int kind = rand() % 20;
+    if (kind < 14) {
+        return 16 + rand() % 241;
+    }
+    if (kind < 19) {
+        return 256 + rand() % 3841;
+    }
+    return 4096 + (rand() % 7) * 4096 + rand() % 4096;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the trace workload, alternating rounds between two halves of the slots so
+ * that a round starts while the one before it still holds its blocks.
+ *-----------------------------------------------------------------------------------
+ */
+static void trace_workload(void) {
+    alloc_workload_t workload;
+    memset(&workload, 0, sizeof(workload));
+    bench_reset(&workload.alloc_stats);
+    bench_reset(&workload.free_stats);
+    int next_report = ALLOC_BENCH_INTERVAL;
+    for (int round = 0; round < ALLOC_BENCH_ROUNDS; round++) {
+        int base = (round & 1) * TRACE_SLOTS;
+        int other = TRACE_SLOTS - base;
+        for (int i = 0; i < TRACE_LENGTH; i++) {
+            // The round before lets go of what it still holds half way through
+            if (i == TRACE_LENGTH / 2) {
+                for (int slot = other; slot < other + TRACE_SLOTS; slot++) {
+                    if (slots[slot] != NULL) {
+                        free_step(&workload, slot);
+                    }
+                }
+            }
+            alloc_op_t const *op = &trace[i];
+            // The frees of the last quarter are left to the next round
+            if (op->type == ALLOC_OP_FREE && i < TRACE_LENGTH - TRACE_LENGTH / 4) {
+                if (slots[base + op->slot] != NULL) {
+                    free_step(&workload, base + op->slot);
+                }
+            } else if (op->type == ALLOC_OP_ALLOC) {
+                int slot = base + op->slot;
+                if (slots[slot] != NULL) {
+                    free_step(&workload, slot);
+                }
+                alloc_step(&workload, slot, op->size);
+            }
+            workload.steps++;
+            if (workload.steps == next_report) {
+                report_fragmentation("alloc_trace_frag", workload.steps);
+                next_report += ALLOC_BENCH_INTERVAL;
+            }
+        }
+    }
+    free_all();
+    report_workload("alloc_trace", &workload);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Allocates a block into an empty slot, timing kmalloc.
+ *
+ * @param workload The workload the step is of
+ * @param slot     The slot to allocate into
+ * @param size     The size of the block
+ *-----------------------------------------------------------------------------------
+ */
+static void alloc_step(alloc_workload_t *workload, int slot, size_t size) {
+    unsigned long long start = read_tsc();
+    slots[slot] = kmalloc(size);
+    bench_sample(&workload->alloc_stats, start, read_tsc());
+    if (slots[slot] == NULL) {
+        workload->failed++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Frees the block in a full slot, timing kfree.
+ *
+ * @param workload The workload the step is of
+ * @param slot     The slot to free
+ *-----------------------------------------------------------------------------------
+ */
+static void free_step(alloc_workload_t *workload, int slot) {
+    unsigned long long start = read_tsc();
+    kfree(slots[slot]);
+    bench_sample(&workload->free_stats, start, read_tsc());
+    slots[slot] = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reports the fragmentation of the heap as it is, and the number of free blocks.
+ *
+ * @param name  The name of the result line of the fragmentation
+ * @param steps The steps of the workload so far
+ *-----------------------------------------------------------------------------------
+ */
+static void report_fragmentation(char *name, int steps) {
+    mem_stats_t mem_stats;
+    bench_stats_t stats;
+    get_mem_stats(&mem_stats);
+    unsigned long free_bytes = mem_stats.pre_hole_free_bytes + mem_stats.post_hole_free_bytes;
+    unsigned long fragmented = 0;
+    if (free_bytes > 0) {
+        fragmented = 1000 - bench_div((unsigned long long) mem_stats.largest_free_block * 1000,
+                                      free_bytes);
+    }
+    bench_reset(&stats);
+    bench_add(&stats, fragmented);
+    bench_report(name, steps, &stats, "permille");
+    bench_reset(&stats);
+    bench_add(&stats, mem_stats.free_block_count);
+    bench_report("alloc_free_blocks", steps, &stats, "blocks");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reports the cycles of kmalloc and kfree over a workload, its throughput, and the
+ * allocations that failed.
+ *
+ * @param name     The name of the workload, the result lines add to it
+ * @param workload The workload
+ *-----------------------------------------------------------------------------------
+ */
+static void report_workload(char *name, alloc_workload_t *workload) {
+    char line_name[32];
+    bench_stats_t stats;
+    sprintf(line_name, "%s_kmalloc", name);
+    bench_report(line_name, workload->steps, &workload->alloc_stats, "cycles");
+    sprintf(line_name, "%s_kfree", name);
+    bench_report(line_name, workload->steps, &workload->free_stats, "cycles");
+
+    unsigned long ops = workload->alloc_stats.count + workload->free_stats.count;
+    unsigned long long cycles = workload->alloc_stats.total + workload->free_stats.total;
+    bench_reset(&stats);
+    if ((cycles >> 20) > 0) {
+        bench_add(&stats, bench_div(ops, cycles >> 20));
+    }
+    sprintf(line_name, "%s_throughput", name);
+    bench_report(line_name, workload->steps, &stats, "ops/Mcycle");
+
+    bench_reset(&stats);
+    bench_add(&stats, workload->failed);
+    sprintf(line_name, "%s_failed", name);
+    bench_report(line_name, workload->steps, &stats, "allocs");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Frees every block still in a slot, without timing kfree.
+ *-----------------------------------------------------------------------------------
+ */
+static void free_all(void) {
+    for (int slot = 0; slot < ALLOC_BENCH_SLOTS; slot++) {
+        if (slots[slot] != NULL) {
+            kfree(slots[slot]);
+            slots[slot] = NULL;
+        }
+    }
+}
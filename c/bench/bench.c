@@ -0,0 +1,126 @@
+/* bench.c : benchmark samples and results */
+
+#include <xeroskernel.h>
+#include <bench.h>
+
+/*-----------------------------------------------------------------------------------
+ * These are the helpers shared by the benchmarks that make bench links in place of
+ * the tests. A benchmark times each iteration of what it measures with the time
+ * stamp counter, adds the samples to a bench_stats_t, and prints one result line
+ * with the count, the minimum, the mean and the maximum of the samples.
+ *
+ * Notes on the results:
+ * - Every result is a line of its own, starting with BENCH and made of fields
+ *   separated by single spaces, in the order of the header line bench_header
+ *   prints, so the results can be picked out of the console output with grep
+ * - Samples are in cycles of the time stamp counter unless the unit says otherwise,
+ *   a sample too large for 32 bits is taken as the largest that fits
+ *
+ * List of functions that are called from outside this file:
+ * - bench_reset
+ *   - Empties the samples of a benchmark
+ * - bench_sample
+ *   - Adds the cycles between two reads of the time stamp counter as a sample
+ * - bench_add
+ *   - Adds a sample measured in some other unit
+ * - bench_header
+ *   - Prints the header of the result lines
+ * - bench_report
+ *   - Prints the result line of a benchmark
+ * - bench_div
+ *   - Divides a 64-bit number by a 32-bit one
+ *-----------------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------------
+ * Empties the samples of a benchmark.
+ *
+ * @param stats The samples of the benchmark
+ *-----------------------------------------------------------------------------------
+ */
+void bench_reset(bench_stats_t *stats) {
+    stats->count = 0;
+    stats->total = 0;
+    stats->min = 0xffffffff;
+    stats->max = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the cycles between two reads of the time stamp counter as a sample.
+ *
+ * @param stats The samples of the benchmark
+ * @param start The time stamp counter before the iteration
+ * @param end   The time stamp counter after the iteration
+ *-----------------------------------------------------------------------------------
+ */
+void bench_sample(bench_stats_t *stats, unsigned long long start, unsigned long long end) {
+    unsigned long long cycles = end - start;
+    bench_add(stats, cycles > 0xffffffff ? 0xffffffff : (unsigned long) cycles);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a sample to the samples of a benchmark.
+ *
+ * @param stats The samples of the benchmark
+ * @param value The sample
+ *-----------------------------------------------------------------------------------
+ */
+void bench_add(bench_stats_t *stats, unsigned long value) {
+    stats->count++;
+    stats->total += value;
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Prints the header of the result lines, naming their fields.
+ *-----------------------------------------------------------------------------------
+ */
+void bench_header(void) {
+    kprintf("BENCH name arg count min mean max unit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Prints the result line of a benchmark.
+ *
+ * @param name  The name of the benchmark, without spaces
+ * @param arg   The parameter the benchmark was run with, such as a size, 0 if none
+ * @param stats The samples of the benchmark
+ * @param unit  The unit of the samples, "cycles" for the time stamp counter
+ *-----------------------------------------------------------------------------------
+ */
+void bench_report(char *name, int arg, bench_stats_t *stats, char *unit) {
+    if (stats->count == 0) {
+        kprintf("BENCH %s %d 0 0 0 0 %s\n", name, arg, unit);
+        return;
+    }
+    kprintf("BENCH %s %d %u %u %u %u %s\n", name, arg, stats->count, stats->min,
+            bench_div(stats->total, stats->count), stats->max, unit);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Divides a 64-bit number by a 32-bit one, one bit at a time, as the kernel is
+ * linked without the 64-bit division of libgcc.
+ *
+ * @param dividend The number to divide, below 2^32 times the divisor
+ * @param divisor  The number to divide by, not 0
+ * @return         The quotient, rounded down
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long bench_div(unsigned long long dividend, unsigned long divisor) {
+    unsigned long long remainder = 0;
+    unsigned long quotient = 0;
+    for (int bit = 63; bit >= 0; bit--) {
+        remainder = (remainder << 1) | ((dividend >> bit) & 1);
+        quotient <<= 1;
+        if (remainder >= divisor) {
+            remainder -= divisor;
+            quotient |= 1;
+        }
+    }
+    return quotient;
+}
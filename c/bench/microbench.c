@@ -0,0 +1,282 @@
+/* microbench.c : microbenchmarks of the kernel */
+
+#include <xeroskernel.h>
+#include <bench.h>
+
+/*-----------------------------------------------------------------------------------
+ * These are the microbenchmarks that make bench links in place of the tests. Each
+ * one times BENCH_ITERATIONS iterations of a single kernel operation with the time
+ * stamp counter and prints a result line, see bench.c.
+ *
+ * Notes on the microbenchmarks:
+ * - kmalloc and kfree are measured at boot, before any process is created, and
+ *   the system calls by the root process once it runs
+ * - The system call benchmarks are run with no other process ready but their
+ *   helper, so an iteration times the kernel and not the scheduling of others
+ * - An iteration that a timer interrupt lands in is counted all the same, which
+ *   shows in the maximum but hardly in the mean
+ * - The timer wakeup latency is the time a sleep of a time slice took past the
+ *   time slice, read from the monotonic clock in microseconds
+ *
+ * List of functions that are called from outside this file:
+ * - run_boot_bench
+ *   - Runs the microbenchmarks of the kernel heap
+ * - run_bench
+ *   - Runs the microbenchmarks of the system calls
+ *-----------------------------------------------------------------------------------
+ */
+
+static void bench_null_syscall(void);
+static void bench_yield(void);
+static void yield_process(void);
+static void bench_coro_yield(void);
+static void yield_coro(void *arg);
+static void bench_getcputimes(void);
+static void bench_ping_pong(void);
+static void pong_process(void);
+static void bench_spawn(void);
+static void exit_process(void);
+static void bench_wakeup(void);
+
+// The sizes kmalloc and kfree are measured at
+static int const heap_sizes[] = {16, 64, 256, 1024, 4096, 16384};
+
+static bench_stats_t stats;
+// Set to stop the helper of the yield benchmark
+static int volatile yield_done;
+// The coroutines of the coroutine yield benchmark, which never wait in the kernel,
+// so the scheduler may be in the memory of the kernel
+static coro_sched_t coro_sched;
+static coro_t coros[2];
+static unsigned long coro_stacks[2][CORO_MIN_STACK_SIZE * 2 / sizeof(unsigned long)];
+// The accounting of a chunk of the PCB table read by the sysgetcputimes benchmark
+static unsigned long ps_space[PS_SIZE(PCB_CHUNK_SIZE) / sizeof(unsigned long) + 1];
+
+/*-----------------------------------------------------------------------------------
+ * Runs the microbenchmarks of the kernel heap, to be called at boot after kmeminit.
+ * Each iteration allocates a block and frees it again, so the heap is measured in
+ * the same state every time.
+ *-----------------------------------------------------------------------------------
+ */
+void run_boot_bench(void) {
+    bench_stats_t free_stats;
+    bench_header();
+    for (int i = 0; i < sizeof(heap_sizes) / sizeof(heap_sizes[0]); i++) {
+        bench_reset(&stats);
+        bench_reset(&free_stats);
+        for (int j = 0; j < BENCH_ITERATIONS; j++) {
+            unsigned long long start = read_tsc();
+            void *ptr = kmalloc(heap_sizes[i]);
+            unsigned long long allocated = read_tsc();
+            kfree(ptr);
+            unsigned long long freed = read_tsc();
+            bench_sample(&stats, start, allocated);
+            bench_sample(&free_stats, allocated, freed);
+        }
+        bench_report("kmalloc", heap_sizes[i], &stats, "cycles");
+        bench_report("kfree", heap_sizes[i], &free_stats, "cycles");
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the microbenchmarks of the system calls, to be called by the root process in
+ * place of the tests.
+ *-----------------------------------------------------------------------------------
+ */
+void run_bench(void) {
+    bench_null_syscall();
+    bench_yield();
+    bench_coro_yield();
+    bench_getcputimes();
+    bench_ping_pong();
+    bench_spawn();
+    bench_wakeup();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures a system call that does no work, through the dispatcher and through the
+ * fast path. Querying the trace mask does nothing but return it, and sysgetpid
+ * takes the fast path.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_null_syscall(void) {
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        systracectl(-1);
+        bench_sample(&stats, start, read_tsc());
+    }
+    bench_report("null_syscall", 0, &stats, "cycles");
+
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sysgetpid();
+        bench_sample(&stats, start, read_tsc());
+    }
+    bench_report("null_fastcall", 0, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures sysyield with a helper at the same priority that yields straight back,
+ * an iteration being two context switches.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_yield(void) {
+    yield_done = 0;
+    int pid = syscreate(&yield_process, PROCESS_STACK_SIZE);
+    // Let the helper start, so the first iteration is not its creation
+    sysyield();
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sysyield();
+        bench_sample(&stats, start, read_tsc());
+    }
+    yield_done = 1;
+    syswait(pid);
+    bench_report("yield_round_trip", 0, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * The helper of the yield benchmark, yields until the benchmark is done.
+ *-----------------------------------------------------------------------------------
+ */
+static void yield_process(void) {
+    while (!yield_done) {
+        sysyield();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures coro_yield with two coroutines that yield to each other, an iteration
+ * being two switches like yield_round_trip, but within the process.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_coro_yield(void) {
+    bench_reset(&stats);
+    coro_init(&coro_sched);
+    for (int i = 0; i < 2; i++) {
+        coro_create(&coro_sched, &coros[i], coro_stacks[i], sizeof(coro_stacks[i]), &yield_coro, (void *) i);
+    }
+    coro_run(&coro_sched);
+    bench_report("coro_yield_round_trip", 0, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * A coroutine of the coroutine yield benchmark, the first one times the iterations.
+ *-----------------------------------------------------------------------------------
+ */
+static void yield_coro(void *arg) {
+    int timing = arg == 0;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        coro_yield(&coro_sched);
+        if (timing) {
+            bench_sample(&stats, start, read_tsc());
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures sysgetcputimes, which reads the accounting of every PCB in the table, so
+ * it shows how much of each PCB a walk over the table has to bring into the cache.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_getcputimes(void) {
+    processStatuses *ps = (processStatuses *) ps_space;
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        ps->size = PCB_CHUNK_SIZE;
+        unsigned long long start = read_tsc();
+        sysgetcputimes(ps);
+        bench_sample(&stats, start, read_tsc());
+    }
+    bench_report("getcputimes", PCB_CHUNK_SIZE, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures syssend and sysrecv with a helper that sends every message back, an
+ * iteration being a message each way.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_ping_pong(void) {
+    int pid = syscreate(&pong_process, PROCESS_STACK_SIZE);
+    bench_reset(&stats);
+    for (int i = 1; i <= BENCH_ITERATIONS; i++) {
+        unsigned int from_pid = pid;
+        unsigned int num;
+        unsigned long long start = read_tsc();
+        syssend(pid, i);
+        sysrecv(&from_pid, &num);
+        bench_sample(&stats, start, read_tsc());
+    }
+    // A message of 0 stops the helper
+    syssend(pid, 0);
+    syswait(pid);
+    bench_report("send_recv_round_trip", 0, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * The helper of the ping-pong benchmark, sends every message back to its sender
+ * until it receives a message of 0.
+ *-----------------------------------------------------------------------------------
+ */
+static void pong_process(void) {
+    while (1) {
+        unsigned int from_pid = 0;
+        unsigned int num;
+        if (sysrecv(&from_pid, &num) != 0 || num == 0) {
+            return;
+        }
+        syssend(from_pid, num);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures creating a process that returns at once and waiting for it, with the
+ * default stack size that the stack pool keeps.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_spawn(void) {
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        int pid = syscreate(&exit_process, PROCESS_STACK_SIZE);
+        syswait(pid);
+        bench_sample(&stats, start, read_tsc());
+    }
+    bench_report("create_wait", PROCESS_STACK_SIZE, &stats, "cycles");
+}
+
+/*-----------------------------------------------------------------------------------
+ * The process the spawn benchmark creates, returns at once.
+ *-----------------------------------------------------------------------------------
+ */
+static void exit_process(void) {
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures how late a process wakes up from a sleep of a time slice, in
+ * microseconds of the monotonic clock, and how long the sleep took in cycles.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_wakeup(void) {
+    bench_stats_t cycle_stats;
+    bench_reset(&stats);
+    bench_reset(&cycle_stats);
+    for (int i = 0; i < BENCH_SLEEP_ITERATIONS; i++) {
+        unsigned long long before_us;
+        unsigned long long after_us;
+        sysclock(&before_us);
+        unsigned long long start = read_tsc();
+        syssleep(TIME_SLICE);
+        unsigned long long end = read_tsc();
+        sysclock(&after_us);
+        unsigned long long slept_us = after_us - before_us;
+        bench_add(&stats, slept_us > TIME_SLICE * 1000 ? slept_us - TIME_SLICE * 1000 : 0);
+        bench_sample(&cycle_stats, start, end);
+    }
+    bench_report("wakeup_latency", TIME_SLICE, &stats, "us");
+    bench_report("sleep", TIME_SLICE, &cycle_stats, "cycles");
+}
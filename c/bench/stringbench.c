@@ -0,0 +1,161 @@
+/* stringbench.c : benchmark of the string routines */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <bench.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the benchmark of the word-at-a-time string routines of string.c against
+ * the byte loops of libxc. Each routine is timed over BENCH_ITERATIONS calls on
+ * strings of each of the lengths in string_lengths, and prints a result line, see
+ * bench.c, named after the routine with _libxc or _words added.
+ *
+ * Notes on the benchmark:
+ * - The strings are word aligned, as the buffers of the shell are, and compared
+ *   with a copy of themselves, so a comparison runs to the end of the strings
+ * - It is run at boot after kmeminit, before any process is created
+ *
+ * List of functions that are called from outside this file:
+ * - run_string_bench
+ *   - Runs the benchmark of the string routines
+ *-----------------------------------------------------------------------------------
+ */
+
+// The longest string measured
+#define STRING_BENCH_MAX_LENGTH 256
+
+static void bench_strlen(int len);
+static void bench_strcmp(int len);
+static void bench_strncmp(int len);
+static void bench_strncpy(int len);
+static void report(char *name, char *kind, int len);
+
+// The lengths of the strings measured
+static int const string_lengths[] = {4, 16, 64, STRING_BENCH_MAX_LENGTH};
+
+static bench_stats_t stats;
+static unsigned long string1[STRING_BENCH_MAX_LENGTH / sizeof(unsigned long) + 1];
+static unsigned long string2[STRING_BENCH_MAX_LENGTH / sizeof(unsigned long) + 1];
+static unsigned long copy[STRING_BENCH_MAX_LENGTH / sizeof(unsigned long) + 1];
+// Results are added up here so that the calls are not left out
+static int volatile sink;
+
+/*-----------------------------------------------------------------------------------
+ * Runs the benchmark of the string routines.
+ *-----------------------------------------------------------------------------------
+ */
+void run_string_bench(void) {
+    for (int i = 0; i < sizeof(string_lengths) / sizeof(string_lengths[0]); i++) {
+        int len = string_lengths[i];
+        char *s1 = (char *) string1;
+        char *s2 = (char *) string2;
+        for (int j = 0; j < len; j++) {
+            s1[j] = s2[j] = 'a' + j % 26;
+        }
+        s1[len] = s2[len] = '\0';
+        bench_strlen(len);
+        bench_strcmp(len);
+        bench_strncmp(len);
+        bench_strncpy(len);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Times strlen and strlen_words on the first string.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_strlen(int len) {
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strlen((char *) string1);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strlen", "libxc", len);
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strlen_words((char *) string1);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strlen", "words", len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Times strcmp and strcmp_words on the two strings, which are the same.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_strcmp(int len) {
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strcmp((char *) string1, (char *) string2);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strcmp", "libxc", len);
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strcmp_words((char *) string1, (char *) string2);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strcmp", "words", len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Times strncmp and strncmp_words on the two strings, up to their length.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_strncmp(int len) {
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strncmp((char *) string1, (char *) string2, len);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strncmp", "libxc", len);
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        sink += strncmp_words((char *) string1, (char *) string2, len);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strncmp", "words", len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Times strncpy and strncpy_words copying the first string into a buffer a word
+ * longer than it, so that the copy is padded.
+ *-----------------------------------------------------------------------------------
+ */
+static void bench_strncpy(int len) {
+    int size = len + sizeof(unsigned long);
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        strncpy((char *) copy, (char *) string1, size);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strncpy", "libxc", len);
+    bench_reset(&stats);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        unsigned long long start = read_tsc();
+        strncpy_words((char *) copy, (char *) string1, size);
+        bench_sample(&stats, start, read_tsc());
+    }
+    report("strncpy", "words", len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Prints the result line of a routine.
+ *
+ * @param name The name of the routine
+ * @param kind "libxc" or "words", which of the two routines was timed
+ * @param len  The length of the strings
+ *-----------------------------------------------------------------------------------
+ */
+static void report(char *name, char *kind, int len) {
+    char line_name[32];
+    sprintf(line_name, "%s_%s", name, kind);
+    bench_report(line_name, len, &stats, "cycles");
+}
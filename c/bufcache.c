@@ -0,0 +1,349 @@
+/* bufcache.c : buffer cache of block devices
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <bufcache.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the buffer cache, which holds recently used blocks of the block devices
+ * in memory so repeated reads and writes of a block do not reach the device.
+ * Drivers of block devices, and anything else reading blocks, go through it with
+ * bread and bget, so they share NUM_BUFS buffers of BLOCK_SIZE bytes.
+ *
+ * Notes on the cache:
+ * - Buffers are found by device and block number through BUF_HASH_BUCKETS hash
+ *   chains indexed by the block number
+ * - A buffer nobody holds sits on an LRU list, least recently released first, and
+ *   a miss reuses the buffer at its head
+ * - Writes are written back: a changed buffer is marked dirty and only written to
+ *   its device when it is reused or the device is synced
+ * - A device may complete transfers later, on an interrupt, holding the buffer
+ *   until then, so a buffer being written back is passed over for reuse and a
+ *   buffer being read in is returned to its holder still invalid
+ * - A holder reads and writes the data of the buffer itself, so moving bytes
+ *   between a process and a cached block takes a single copy
+ * - The cache is used by the dispatcher with the kernel lock held, so holders
+ *   release a buffer before the system call returns
+ *
+ * List of functions that are called from outside this file:
+ * - kbufinit
+ *   - Initializes the buffers and puts them all on the LRU list
+ * - bread
+ *   - Returns the buffer of a block holding its contents
+ * - bget
+ *   - Returns the buffer of a block without reading the block in
+ * - bdirty
+ *   - Marks a buffer as changed
+ * - bhold
+ *   - Takes another hold of a buffer
+ * - brelse
+ *   - Gives up a buffer returned by bread or bget
+ * - bsync
+ *   - Writes back the changed buffers of a device
+ * - get_bufcache_stats
+ *   - Copies the counters of the cache
+ *-----------------------------------------------------------------------------------
+ */
+
+static buf_t *lookup(blkdev_t *dev, unsigned int blockno);
+static buf_t *take_lru(void);
+static void lru_append(buf_t *buf);
+static void lru_prepend(buf_t *buf);
+static void lru_remove(buf_t *buf);
+static void hash_insert(buf_t *buf);
+static void hash_remove(buf_t *buf);
+static buf_t **bucket_of(unsigned int blockno);
+static int write_back(buf_t *buf);
+
+static buf_t bufs[NUM_BUFS];
+static char buf_data[NUM_BUFS][BLOCK_SIZE];
+static buf_t *hash_chains[BUF_HASH_BUCKETS];
+static buf_t *lru_head;
+static buf_t *lru_tail;
+static bufcache_stats_t stats;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any block device is used. Empties the buffers and puts them
+ * all on the LRU list.
+ *-----------------------------------------------------------------------------------
+ */
+void kbufinit(void) {
+    lru_head = NULL;
+    lru_tail = NULL;
+    for (int i = 0; i < BUF_HASH_BUCKETS; i++) {
+        hash_chains[i] = NULL;
+    }
+    for (int i = 0; i < NUM_BUFS; i++) {
+        bufs[i].dev = NULL;
+        bufs[i].blockno = 0;
+        bufs[i].flags = 0;
+        bufs[i].refcount = 0;
+        bufs[i].data = buf_data[i];
+        bufs[i].hash_next = NULL;
+        lru_append(&bufs[i]);
+    }
+    fill_words(&stats, 0, sizeof(stats));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the buffer of the given block holding its contents, reading the block
+ * from its device on a miss. The caller releases it with brelse.
+ *
+ * @return A pointer to the buffer, or NULL if the block could not be read or every
+ *         buffer is held. On a device whose transfers complete later, the buffer
+ *         may be returned still BUF_BUSY and without BUF_VALID
+ *-----------------------------------------------------------------------------------
+ */
+buf_t *bread(blkdev_t *dev, unsigned int blockno) {
+    buf_t *buf = bget(dev, blockno);
+    if (buf == NULL || (buf->flags & (BUF_VALID | BUF_BUSY))) {
+        return buf;
+    }
+    int result = dev->read_block(dev, buf);
+    if (result < 0) {
+        brelse(buf);
+        return NULL;
+    }
+    if (result != BLK_STARTED) {
+        buf->flags |= BUF_VALID;
+    }
+    return buf;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the buffer of the given block, without reading the block in on a miss.
+ * For callers about to overwrite the whole block, which mark the buffer valid
+ * themselves. The caller releases it with brelse.
+ *
+ * @return A pointer to the buffer, or NULL if the block is past the end of the
+ *         device or every buffer is held
+ *-----------------------------------------------------------------------------------
+ */
+buf_t *bget(blkdev_t *dev, unsigned int blockno) {
+    if (blockno >= dev->num_blocks) {
+        return NULL;
+    }
+    buf_t *buf = lookup(dev, blockno);
+    if (buf != NULL) {
+        stats.hits++;
+        bhold(buf);
+        return buf;
+    }
+
+    stats.misses++;
+    buf = take_lru();
+    if (buf == NULL) {
+        return NULL;
+    }
+    if (buf->dev != NULL) {
+        hash_remove(buf);
+    }
+    buf->dev = dev;
+    buf->blockno = blockno;
+    buf->flags = 0;
+    buf->refcount = 1;
+    hash_insert(buf);
+    return buf;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Marks the given held buffer as changed, so it is written back before reuse.
+ *-----------------------------------------------------------------------------------
+ */
+void bdirty(buf_t *buf) {
+    buf->flags |= BUF_VALID | BUF_DIRTY;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes another hold of the given buffer, so it is not reused until released.
+ *-----------------------------------------------------------------------------------
+ */
+void bhold(buf_t *buf) {
+    if (buf->refcount++ == 0) {
+        lru_remove(buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Gives up the given buffer. Once no one holds it, it becomes the most recently
+ * used buffer on the LRU list. A buffer that does not hold its block is put first
+ * in line for reuse instead.
+ *-----------------------------------------------------------------------------------
+ */
+void brelse(buf_t *buf) {
+    if (--buf->refcount > 0) {
+        return;
+    }
+    if (buf->flags & BUF_VALID) {
+        lru_append(buf);
+    } else {
+        hash_remove(buf);
+        buf->dev = NULL;
+        lru_prepend(buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes back the changed buffers of the given device, or starts writing them back
+ * on a device whose transfers complete later.
+ *
+ * @return 0 on success, -1 if a block could not be written
+ *-----------------------------------------------------------------------------------
+ */
+int bsync(blkdev_t *dev) {
+    int result = 0;
+    for (int i = 0; i < NUM_BUFS; i++) {
+        if (bufs[i].dev == dev && (bufs[i].flags & BUF_DIRTY)) {
+            if (write_back(&bufs[i]) < 0) {
+                result = -1;
+            }
+        }
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the cache into the given structure.
+ *-----------------------------------------------------------------------------------
+ */
+void get_bufcache_stats(bufcache_stats_t *out) {
+    *out = stats;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the buffer of the given block if the cache has one, NULL otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static buf_t *lookup(blkdev_t *dev, unsigned int blockno) {
+    for (buf_t *buf = *bucket_of(blockno); buf != NULL; buf = buf->hash_next) {
+        if (buf->dev == dev && buf->blockno == blockno) {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the least recently used buffer off the LRU list for reuse, writing it back
+ * first if it was changed. A buffer that cannot be written back, or is still being
+ * written back, is kept.
+ *
+ * @return A pointer to the buffer, or NULL if every buffer is held or could not be
+ *         written back
+ *-----------------------------------------------------------------------------------
+ */
+static buf_t *take_lru(void) {
+    buf_t *buf = lru_head;
+    while (buf != NULL) {
+        // A write back that completes later takes the buffer off the list
+        buf_t *next_buf = buf->lru_next;
+        if (!(buf->flags & BUF_DIRTY) || write_back(buf) == 0) {
+            lru_remove(buf);
+            return buf;
+        }
+        buf = next_buf;
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given buffer to the end of the LRU list, as the most recently used.
+ *-----------------------------------------------------------------------------------
+ */
+static void lru_append(buf_t *buf) {
+    buf->lru_next = NULL;
+    buf->lru_prev = lru_tail;
+    if (lru_tail != NULL) {
+        lru_tail->lru_next = buf;
+    } else {
+        lru_head = buf;
+    }
+    lru_tail = buf;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given buffer to the start of the LRU list, as the next to be reused.
+ *-----------------------------------------------------------------------------------
+ */
+static void lru_prepend(buf_t *buf) {
+    buf->lru_prev = NULL;
+    buf->lru_next = lru_head;
+    if (lru_head != NULL) {
+        lru_head->lru_prev = buf;
+    } else {
+        lru_tail = buf;
+    }
+    lru_head = buf;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given buffer off the LRU list.
+ *-----------------------------------------------------------------------------------
+ */
+static void lru_remove(buf_t *buf) {
+    if (buf->lru_prev != NULL) {
+        buf->lru_prev->lru_next = buf->lru_next;
+    } else {
+        lru_head = buf->lru_next;
+    }
+    if (buf->lru_next != NULL) {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    } else {
+        lru_tail = buf->lru_prev;
+    }
+    buf->lru_prev = NULL;
+    buf->lru_next = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given buffer to the hash chain of its block.
+ *-----------------------------------------------------------------------------------
+ */
+static void hash_insert(buf_t *buf) {
+    buf_t **chain = bucket_of(buf->blockno);
+    buf->hash_next = *chain;
+    *chain = buf;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given buffer off the hash chain of its block.
+ *-----------------------------------------------------------------------------------
+ */
+static void hash_remove(buf_t *buf) {
+    buf_t **link = bucket_of(buf->blockno);
+    while (*link != NULL && *link != buf) {
+        link = &(*link)->hash_next;
+    }
+    if (*link == buf) {
+        *link = buf->hash_next;
+    }
+    buf->hash_next = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the hash chain buffers of the given block number are placed on.
+ *-----------------------------------------------------------------------------------
+ */
+static buf_t **bucket_of(unsigned int blockno) {
+    return &hash_chains[blockno & (BUF_HASH_BUCKETS - 1)];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the given changed buffer to its device.
+ *
+ * @return 0 on success, -1 if the block could not be written, or BLK_STARTED if
+ *         the write completes later
+ *-----------------------------------------------------------------------------------
+ */
+static int write_back(buf_t *buf) {
+    int result = buf->dev->write_block(buf->dev, buf);
+    if (result < 0) {
+        return -1;
+    }
+    if (result != BLK_STARTED) {
+        buf->flags &= ~BUF_DIRTY;
+    }
+    stats.writebacks++;
+    return result;
+}
@@ -0,0 +1,264 @@
+/* console.c : console specific device driver calls */
+
+#include <xeroskernel.h>
+#include <console.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where console specific device driver calls live, along with the output
+ * buffer of the console. The console is the text display, written by sysputs and by
+ * syswrite on an open console device.
+ *
+ * Notes on the console:
+ * - Output is copied into a buffer of CONSOLE_BUFFER_SIZE chars and written to
+ *   video memory in batches, so a process printing costs the dispatcher one copy
+ *   rather than a pass through the display for every char
+ * - The buffer is flushed on every timer tick, whenever it fills up, and by each
+ *   kprintf before it writes, so kernel messages stay in order with buffered
+ *   output. Without pre-emption there are no ticks, and every write is flushed
+ * - A flush moves the cursor once for the whole batch instead of once per char
+ * - The buffer is shared by the processors and by kprintf calls made from
+ *   processes, so it is reached with interrupts disabled under its own lock
+ *
+ * List of functions that are called from outside this file:
+ * - console_register
+ *   - Registers the console device
+ * - consoleinit
+ *   - Console specific call for di_init
+ * - consoleopen
+ *   - Console specific call for di_open
+ * - consoleclose
+ *   - Console specific call for di_close
+ * - consoleread
+ *   - Console specific call for di_read
+ * - consolewrite
+ *   - Console specific call for di_write
+ * - consoleioctl
+ *   - Console specific call for di_ioctl
+ * - consolepoll
+ *   - Console specific call for syspoll
+ * - consoleaioread
+ *   - Console specific call for di_aioread
+ * - console_write
+ *   - Copies chars into the output buffer
+ * - console_flush
+ *   - Writes the chars in the output buffer to video memory
+ *-----------------------------------------------------------------------------------
+ */
+
+static void flush_locked(void);
+static unsigned long lock_console(void);
+static void unlock_console(unsigned long eflags);
+
+static char console_buf[CONSOLE_BUFFER_SIZE];
+// The number of chars in the output buffer
+static int console_count;
+static spinlock_t console_spinlock;
+// The device structure registered in the device table
+static devsw_t console_devsw;
+
+/*========================= CONSOLE DEVICE DRIVER =================================*/
+
+/*-----------------------------------------------------------------------------------
+ * Registers the console device as CONSOLE_0.
+ *-----------------------------------------------------------------------------------
+ */
+void console_register(void) {
+    devsw_t *devsw = &console_devsw;
+    devsw->dvioblk = NULL;
+    devsw->dvinit = &consoleinit;
+    devsw->dvopen = &consoleopen;
+    devsw->dvclose = &consoleclose;
+    devsw->dvread = &consoleread;
+    devsw->dvwrite = &consolewrite;
+    devsw->dvioctl = &consoleioctl;
+    devsw->dvpoll = &consolepoll;
+    devsw->dvaioread = &consoleaioread;
+    di_register(devsw, "/dev/console", CONSOLE_0, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the console device. The output buffer starts empty.
+ *
+ * @return 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int consoleinit(void) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_open. Any number of processes may have the console
+ * open.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int consoleopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_close.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int consoleclose(devsw_t *devsw, pcb_t *proc) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_read. The console is output only.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            -1 as the console cannot be read
+ *-----------------------------------------------------------------------------------
+ */
+int consoleread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_write. Copies the bytes into the output buffer.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written
+ *-----------------------------------------------------------------------------------
+ */
+int consolewrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    console_write((char *) buf, buflen);
+    return buflen;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_ioctl. The console has no control commands.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command
+ * @param ioctl_args Additional parameters
+ * @return           -1 as there are no control commands
+ *-----------------------------------------------------------------------------------
+ */
+int consoleioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for syspoll. The console never has input.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      0 as a read would fail rather than return input
+ *-----------------------------------------------------------------------------------
+ */
+int consolepoll(devsw_t *devsw, pcb_t *proc) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Console specific call for di_aioread. The console is output only.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as the console cannot be read
+ *-----------------------------------------------------------------------------------
+ */
+int consoleaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*========================= CONSOLE OUTPUT BUFFER =================================*/
+
+/*-----------------------------------------------------------------------------------
+ * Copies the given chars into the output buffer, flushing it each time it fills
+ * up.
+ *
+ * @param buf The chars to write
+ * @param len The number of chars to write
+ *-----------------------------------------------------------------------------------
+ */
+void console_write(char *buf, int len) {
+    unsigned long eflags = lock_console();
+    while (len > 0) {
+        int n = CONSOLE_BUFFER_SIZE - console_count;
+        if (n > len) {
+            n = len;
+        }
+        copy_words(&console_buf[console_count], buf, n);
+        console_count += n;
+        buf += n;
+        len -= n;
+        if (console_count == CONSOLE_BUFFER_SIZE) {
+            flush_locked();
+        }
+    }
+    if (!PREEMPTION_ENABLED) {
+        flush_locked();
+    }
+    unlock_console(eflags);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the chars in the output buffer to video memory, and empties the buffer.
+ *-----------------------------------------------------------------------------------
+ */
+void console_flush(void) {
+    // Checked without the lock, as most ticks have nothing to flush
+    if (console_count == 0) {
+        return;
+    }
+    unsigned long eflags = lock_console();
+    flush_locked();
+    unlock_console(eflags);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the chars in the output buffer to video memory with the console lock held.
+ *-----------------------------------------------------------------------------------
+ */
+static void flush_locked(void) {
+    if (console_count > 0) {
+        kbmwrite(console_buf, console_count);
+        console_count = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Disables interrupts and takes the console lock.
+ *
+ * @return The flags to pass to unlock_console, which tell whether interrupts were
+ *         enabled
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long lock_console(void) {
+    unsigned long eflags;
+    __asm__ volatile("pushfl; popl %0; cli;" : "=r" (eflags) : : "memory");
+    spin_lock(&console_spinlock);
+    return eflags;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Releases the console lock, and enables interrupts again if they were enabled
+ * before lock_console.
+ *-----------------------------------------------------------------------------------
+ */
+static void unlock_console(unsigned long eflags) {
+    spin_unlock(&console_spinlock);
+    __asm__ volatile("pushl %0; popfl;" : : "r" (eflags) : "memory", "cc");
+}
@@ -0,0 +1,346 @@
+/* coro.c : user-level coroutines
+ */
+
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * These are coroutines, tasks that a process runs on stacks of its own and that
+ * hand the processor to each other without a system call. A coroutine runs until it
+ * yields, blocks or finishes, and the switch to the next ready coroutine saves and
+ * restores only the registers a function call must preserve, so it costs a few tens
+ * of cycles where sysyield is a full round trip through the dispatcher.
+ *
+ * Notes on the coroutines:
+ * - A scheduler holds the coroutines of one process, run by coro_run until all of
+ *   them have finished, in turn on a run queue
+ * - A coroutine that blocks with coro_block waits for coro_wake, which may be
+ *   called by any process. A wake made before the block is not lost, the block
+ *   then returns at once
+ * - Only when every coroutine is blocked does the process wait in the kernel, with
+ *   sysfutexwait on the wakeups of the scheduler, and a wake of a blocked coroutine
+ *   only makes a system call to wake the process if it waits. The scheduler must be
+ *   in the memory of the process for this, not in the memory of the kernel
+ * - A woken coroutine is placed on a list of the scheduler with an atomic
+ *   instruction, and the process moves the list to the run queue, so the run queue
+ *   is only ever changed by the process itself
+ * - The stacks are given by the caller and are not checked for overflow, a
+ *   coroutine stack need only hold what the coroutine calls
+ *
+ * List of functions that are called from outside this file:
+ * - coro_init
+ *   - Initializes a scheduler with no coroutines
+ * - coro_create
+ *   - Adds a coroutine to a scheduler, returns 0 on success, -1 if the arguments
+ *     are invalid
+ * - coro_run
+ *   - Runs the coroutines of a scheduler until all of them have finished
+ * - coro_yield
+ *   - Lets the other ready coroutines run before the calling coroutine continues
+ * - coro_block
+ *   - Blocks the calling coroutine until it is woken
+ * - coro_wake
+ *   - Wakes a blocked coroutine, or makes its next block return at once
+ * - coro_self
+ *   - Returns the running coroutine of a scheduler
+ *-----------------------------------------------------------------------------------
+ */
+
+// The states of the park field of a coroutine, running or ready, with a wake to
+// take, and blocked
+#define CORO_ACTIVE 0
+#define CORO_NOTIFIED 1
+#define CORO_PARKED 2
+
+static void coro_start(coro_t *coro);
+static void switch_to(coro_sched_t *sched, coro_t *next);
+static void coro_switch(coro_t *from, coro_t *to);
+static coro_t *next_coro(coro_sched_t *sched);
+static void push_woken(coro_sched_t *sched, coro_t *coro);
+static void take_woken(coro_sched_t *sched);
+static void enqueue_coro(coro_sched_t *sched, coro_t *coro);
+static coro_t *dequeue_coro(coro_sched_t *sched);
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given scheduler with no coroutines.
+ *-----------------------------------------------------------------------------------
+ */
+void coro_init(coro_sched_t *sched) {
+    sched->main.sched = sched;
+    sched->main.park = CORO_ACTIVE;
+    sched->current = NULL;
+    sched->run_head = NULL;
+    sched->run_tail = NULL;
+    sched->live = 0;
+    sched->woken = NULL;
+    sched->wakeups = 0;
+    sched->parked = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a coroutine to the given scheduler, ready to run the given function once
+ * coro_run is called or the running coroutines yield to it. The coroutine finishes
+ * when the function returns.
+ *
+ * @param sched      The scheduler
+ * @param coro       The coroutine, which must stay valid until it has finished
+ * @param stack      The lowest address of the stack of the coroutine
+ * @param stack_size The size of the stack in bytes, at least CORO_MIN_STACK_SIZE
+ * @param func       The function the coroutine runs
+ * @param arg        The argument passed to func
+ * @return           0 on success, -1 if func is NULL or the stack is too small
+ *-----------------------------------------------------------------------------------
+ */
+int coro_create(coro_sched_t *sched, coro_t *coro, void *stack, int stack_size, void (*func)(void *arg), void *arg) {
+    if (func == NULL || stack == NULL || stack_size < CORO_MIN_STACK_SIZE) {
+        return -1;
+    }
+    coro->func = func;
+    coro->arg = arg;
+    coro->sched = sched;
+    coro->park = CORO_ACTIVE;
+
+    // The first switch to the coroutine returns into coro_start as if it had been
+    // called with the coroutine as its argument
+    unsigned long top = ((unsigned long) stack + stack_size) & ~(sizeof(unsigned long) - 1);
+    unsigned long *frame = (unsigned long *) top;
+    *--frame = (unsigned long) coro;
+    // The return address of coro_start, which never returns
+    *--frame = 0;
+    *--frame = (unsigned long) &coro_start;
+    coro->esp = frame;
+
+    sched->live++;
+    enqueue_coro(sched, coro);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the coroutines of the given scheduler until all of them have finished. The
+ * calling process waits in the kernel while every coroutine is blocked.
+ *-----------------------------------------------------------------------------------
+ */
+void coro_run(coro_sched_t *sched) {
+    if (sched->live == 0) {
+        return;
+    }
+    sched->current = &sched->main;
+    switch_to(sched, next_coro(sched));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the running coroutine of the given scheduler to the end of the run queue
+ * and switches to the first ready coroutine. Returns at once if no other coroutine
+ * is ready.
+ *-----------------------------------------------------------------------------------
+ */
+void coro_yield(coro_sched_t *sched) {
+    if (sched->woken != NULL) {
+        take_woken(sched);
+    }
+    if (sched->run_head == NULL) {
+        return;
+    }
+    enqueue_coro(sched, sched->current);
+    switch_to(sched, dequeue_coro(sched));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Blocks the running coroutine of the given scheduler until coro_wake is called for
+ * it, and runs the other coroutines meanwhile. Returns at once if it was woken
+ * since it last blocked.
+ *-----------------------------------------------------------------------------------
+ */
+void coro_block(coro_sched_t *sched) {
+    coro_t *coro = sched->current;
+    // A wake that came first is taken instead of blocking, whether before the
+    // first check or between the two
+    if (compare_and_swap(&coro->park, CORO_NOTIFIED, CORO_ACTIVE) == CORO_NOTIFIED) {
+        return;
+    }
+    if (compare_and_swap(&coro->park, CORO_ACTIVE, CORO_PARKED) != CORO_ACTIVE) {
+        coro->park = CORO_ACTIVE;
+        return;
+    }
+    switch_to(sched, next_coro(sched));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Wakes the given coroutine if it is blocked, so it continues once its process
+ * gets to it, otherwise makes its next coro_block return at once. May be called by
+ * any process, the process of the coroutine is only woken with a system call if it
+ * waits in the kernel.
+ *-----------------------------------------------------------------------------------
+ */
+void coro_wake(coro_t *coro) {
+    while (1) {
+        int park = coro->park;
+        if (park == CORO_NOTIFIED) {
+            return;
+        }
+        int next = park == CORO_PARKED ? CORO_ACTIVE : CORO_NOTIFIED;
+        if (compare_and_swap(&coro->park, park, next) == park) {
+            if (park == CORO_PARKED) {
+                push_woken(coro->sched, coro);
+            }
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the running coroutine of the given scheduler, NULL if coro_run is not
+ * running.
+ *-----------------------------------------------------------------------------------
+ */
+coro_t *coro_self(coro_sched_t *sched) {
+    coro_t *coro = sched->current;
+    return coro == &sched->main ? NULL : coro;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Where every coroutine starts. Runs its function and, once it returns, switches to
+ * the next ready coroutine, or back to coro_run after the last one.
+ *-----------------------------------------------------------------------------------
+ */
+static void coro_start(coro_t *coro) {
+    coro->func(coro->arg);
+    coro_sched_t *sched = coro->sched;
+    sched->live--;
+    switch_to(sched, sched->live == 0 ? &sched->main : next_coro(sched));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Makes the given coroutine the running one of the given scheduler, switching to it
+ * unless it already is.
+ *-----------------------------------------------------------------------------------
+ */
+static void switch_to(coro_sched_t *sched, coro_t *next) {
+    coro_t *prev = sched->current;
+    if (next == prev) {
+        return;
+    }
+    sched->current = next;
+    coro_switch(prev, next);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Saves the stack pointer of the given coroutine and continues the other one where
+ * it was switched out. The compiler saves the registers a function call must
+ * preserve, apart from %ebp, which is pushed along with the place to continue at.
+ * %eax and %edx hold what the switch back to this coroutine left in them, so they
+ * are outputs as well as inputs.
+ *-----------------------------------------------------------------------------------
+ */
+static void coro_switch(coro_t *from, coro_t *to) {
+    void **from_esp = &from->esp;
+    void **to_esp = &to->esp;
+
+    __asm__ volatile(
+    "pushl %%ebp;"
+            "pushl $1f;"
+            "movl %%esp, (%0);"
+            "movl (%1), %%esp;"
+            "ret;"
+            "1:"
+            "popl %%ebp;"
+            : "+a" (from_esp), "+d" (to_esp)
+            :
+            : "%ebx", "%ecx", "%esi", "%edi", "memory", "cc");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the next coroutine to run from the run queue of the given scheduler. While
+ * every coroutine is blocked, the process waits in the kernel for one to be woken.
+ *
+ * @return The coroutine, which may be the one running if it was woken
+ *-----------------------------------------------------------------------------------
+ */
+static coro_t *next_coro(coro_sched_t *sched) {
+    while (1) {
+        if (sched->woken != NULL) {
+            take_woken(sched);
+        }
+        coro_t *coro = dequeue_coro(sched);
+        if (coro != NULL) {
+            return coro;
+        }
+        // The wakeups are read after parked is set, so a wake that comes after the
+        // list is checked either advances them or sees parked and wakes the process
+        exchange(&sched->parked, 1);
+        int wakeups = sched->wakeups;
+        if (sched->woken == NULL) {
+            sysfutexwait((int *) &sched->wakeups, wakeups);
+        }
+        sched->parked = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Places the given woken coroutine on the list of woken coroutines of the given
+ * scheduler, and wakes the process of the scheduler if it waits in the kernel.
+ *-----------------------------------------------------------------------------------
+ */
+static void push_woken(coro_sched_t *sched, coro_t *coro) {
+    int head;
+    do {
+        head = (int) sched->woken;
+        coro->next = (coro_t *) head;
+    } while (compare_and_swap((volatile int *) &sched->woken, head, (int) coro) != head);
+    fetch_add(&sched->wakeups, 1);
+    if (sched->parked) {
+        sysfutexwake((int *) &sched->wakeups, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the woken coroutines of the given scheduler to the end of its run queue, in
+ * the order they were woken.
+ *-----------------------------------------------------------------------------------
+ */
+static void take_woken(coro_sched_t *sched) {
+    coro_t *coro = (coro_t *) exchange((volatile int *) &sched->woken, 0);
+    // The list is newest first
+    coro_t *oldest = NULL;
+    while (coro != NULL) {
+        coro_t *next = coro->next;
+        coro->next = oldest;
+        oldest = coro;
+        coro = next;
+    }
+    while (oldest != NULL) {
+        coro_t *next = oldest->next;
+        enqueue_coro(sched, oldest);
+        oldest = next;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given coroutine to the end of the run queue of the given scheduler.
+ *-----------------------------------------------------------------------------------
+ */
+static void enqueue_coro(coro_sched_t *sched, coro_t *coro) {
+    coro->next = NULL;
+    if (sched->run_tail == NULL) {
+        sched->run_head = coro;
+    } else {
+        sched->run_tail->next = coro;
+    }
+    sched->run_tail = coro;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the first coroutine from the run queue of the given scheduler.
+ *
+ * @return The coroutine, NULL if the run queue is empty
+ *-----------------------------------------------------------------------------------
+ */
+static coro_t *dequeue_coro(coro_sched_t *sched) {
+    coro_t *coro = sched->run_head;
+    if (coro != NULL) {
+        sched->run_head = coro->next;
+        if (sched->run_head == NULL) {
+            sched->run_tail = NULL;
+        }
+    }
+    return coro;
+}
@@ -11,14 +11,43 @@
  * List of functions that are called from outside this file:
  * - create
  *   - Creates a process and adds it to the ready queue
+ * - create_thread
+ *   - Creates a thread of a process and adds it to the ready queue
+ * - spawn
+ *   - Creates a process with an argument block and attributes and adds it to the
+ *     ready queue
  * - create_idle_proc
  *   - Creates the idle process
+ * - stack_usage
+ *   - Returns the peak stack usage of a process in bytes
+ *
+ * Notes on measuring stack usage:
+ * - Every new stack is painted with STACK_PAINT_PATTERN, the stack grows down from
+ *   the end of the allocated memory, so the lowest word that no longer holds the
+ *   pattern marks the deepest the stack has been
+ *
+ * Notes on threads:
+ * - A thread is scheduled like any process and has its own PID, but its owner is
+ *   the process that created it, or the owner of the thread that did, and it uses
+ *   the signal table and file descriptor table of its owner
+ * - Its PCB is not given a signal table or file descriptor table of its own, and its
+ *   stack may be as small as MIN_THREAD_STACK_SIZE, so many threads are cheap
+ *
+ * Notes on spawning:
+ * - The argument block of spawn is copied to the top of the stack of the process,
+ *   and the process function is called with a pointer to the copy, so the parent
+ *   need not keep the block, or pass data through globals
+ * - The priority and the inherited file descriptors are set before the process is
+ *   made ready, so it never runs without them
  *-----------------------------------------------------------------------------------
  */
 
 extern unsigned long maxaddr;
 extern int user_proc_count;
 
+static int create_proc(funcptr func, int min_stack, pcb_t *owner, pcb_t *parent, void *args, int args_len,
+                       spawn_attr_t *attr);
+
 /*-----------------------------------------------------------------------------------
  * Creates a new process and adds it to the ready queue.
  *
@@ -28,43 +57,134 @@ extern int user_proc_count;
  *-----------------------------------------------------------------------------------
  */
 int create(funcptr func, int stack) {
+    spawn_attr_t attr = {stack, -1, 0};
+    return create_proc(func, MIN_PROCESS_STACK_SIZE, NULL, NULL, NULL, 0, &attr);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Creates a new thread of the process that owns the given process and adds it to the
+ * ready queue.
+ *
+ * @param creator The process creating the thread
+ * @param func    A function pointer to the start of the thread code
+ * @param stack   The amount of stack to allocate for the thread
+ * @return        1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int create_thread(pcb_t *creator, funcptr func, int stack) {
+    spawn_attr_t attr = {stack, -1, 0};
+    return create_proc(func, MIN_THREAD_STACK_SIZE, creator->owner, NULL, NULL, 0, &attr);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Creates a new process that is called with a copy of the given argument block, with
+ * the given attributes, and adds it to the ready queue.
+ *
+ * @param parent   The process spawning the new one
+ * @param func     A function pointer to the start of the process code
+ * @param args     The argument block, copied to the stack of the process
+ * @param args_len The size of the block in bytes, at most SPAWN_MAX_ARGS, 0 to pass
+ *                 args itself to the process
+ * @param attr     The attributes of the process, already checked
+ * @return         1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int spawn(pcb_t *parent, void (*func)(void *arg), void *args, int args_len, spawn_attr_t *attr) {
+    return create_proc((funcptr) func, MIN_PROCESS_STACK_SIZE, NULL, parent, args, args_len, attr);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Creates a new process, or a thread of the given owner, and adds it to the ready
+ * queue.
+ *
+ * @param func      A function pointer to the start of the process code
+ * @param min_stack The smallest stack to allocate
+ * @param owner     The process the thread shares its tables with, NULL for a process
+ * @param parent    The process to inherit file descriptors from if the attributes
+ *                  ask for it, NULL if there is none
+ * @param args      The argument block, or the argument itself if args_len is 0
+ * @param args_len  The size of the argument block in bytes
+ * @param attr      The stack size, priority and flags of the process
+ * @return          1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+static int create_proc(funcptr func, int min_stack, pcb_t *owner, pcb_t *parent, void *args, int args_len,
+                       spawn_attr_t *attr) {
     if (!valid_ptr(func)) {
         return 0;
     }
 
-    if (stack < PROCESS_STACK_SIZE) {
-        stack = PROCESS_STACK_SIZE;
+    int stack = attr->stack_size;
+    if (stack < min_stack) {
+        stack = min_stack;
     }
+    // Keep the stack a whole number of words so it can be painted
+    stack = (stack + sizeof(unsigned long) - 1) & ~(sizeof(unsigned long) - 1);
 
-    if (DEBUG) kprintf("Creating a process...\n");
+    KLOG(LOG_DEBUG, "Creating a process...\n");
 
     // Allocate the stack
-    void *proc_mem_start = kmalloc(stack);
+    // In paging mode the stack is a reserved range of virtual memory mapped on demand
+    void *proc_mem_start = PAGING_ENABLED ? vstack_alloc(stack) : kstackalloc(stack);
+    if (proc_mem_start == NULL) {
+        // The stacks of terminated processes may not have been freed yet
+        reap_terminated();
+        proc_mem_start = PAGING_ENABLED ? vstack_alloc(stack) : kstackalloc(stack);
+    }
     if (proc_mem_start == NULL) {
         kprintf("ERROR: Not enough memory to allocate stack\n");
         return 0;
     }
 
     // Acquire a free process control block from the process table
-    pcb_t *proc = get_unused_pcb();
+    pcb_t *proc = get_unused_pcb(owner);
     if (proc == NULL) {
-        if (DEBUG) kprintf("ERROR: No free PCBs available\n");
-        kfree(proc_mem_start);
+        KLOG(LOG_DEBUG, "No free PCBs available\n");
+        if (PAGING_ENABLED) {
+            vstack_free(proc_mem_start);
+        } else {
+            kstackfree(proc_mem_start);
+        }
         return 0;
     }
 
-    // Initialize the PCB
-    // By default a process is created with priority 3
+    // Initialize the PCB, get_unused_pcb has set its priority
     proc->mem_start = proc_mem_start;
-    proc->priority = INIT_PRIORITY;
+    proc->stack_size = stack;
+    if (attr->priority >= 0) {
+        proc->priority = attr->priority;
+        proc->base_priority = attr->priority;
+    }
+    if (parent != NULL && (attr->flags & SPAWN_INHERIT_FDS)) {
+        di_inherit_fds(proc, parent);
+    }
+
+    // Paint the stack to measure its peak usage, in paging mode painting would map
+    // the whole stack and the mapped pages are counted instead
+    if (!PAGING_ENABLED) {
+        unsigned long *word = (unsigned long *) proc_mem_start;
+        for (int i = 0; i < stack / sizeof(unsigned long); i++) {
+            word[i] = STACK_PAINT_PATTERN;
+        }
+    }
 
     // Position process context
     // Point to the end of the allocated memory chunk
     unsigned long mem_end = (unsigned long) proc_mem_start + (unsigned long) stack;
+    // The argument block goes at the top of the stack, a word aligned copy
+    if (args_len > 0) {
+        mem_end = (mem_end - args_len) & ~(sizeof(unsigned long) - 1);
+        copy_words((void *) mem_end, args, args_len);
+        args = (void *) mem_end;
+    }
+    // The argument of the process function, where a function called by the process
+    // finds its first parameter
+    void **arg = (void **) (mem_end - sizeof(*arg));
+    *arg = args;
     // Set-up the stack of the process so that if the process does a return, either explicitly
     // through the return statement or by running off the end of its code, it transfers control to sysstop
     funcptr *return_addr;
-    return_addr = (funcptr *)(mem_end - sizeof(*return_addr));
+    return_addr = (funcptr *) ((unsigned long) arg - sizeof(*return_addr));
     // The spot that contains the return address for the function call contains the address of sysstop
     *return_addr = &sysstop;
 
@@ -75,7 +195,7 @@ int create(funcptr func, int stack) {
 
     // Initialize process context
     context_frame_t *context_frame = esp;
-    memset(context_frame, 0, sizeof(context_frame));
+    fill_words(context_frame, 0, sizeof(context_frame));
     context_frame->ebp = ((unsigned long) context_frame) + sizeof(context_frame);
     context_frame->iret_eip = (unsigned long) func;
     context_frame->iret_cs = getCS();
@@ -87,6 +207,28 @@ int create(funcptr func, int stack) {
     return 1;
 }
 
+/*-----------------------------------------------------------------------------------
+ * Returns the peak stack usage of the given process, found by scanning the painted
+ * stack from its lowest address for the first word that was overwritten. In paging
+ * mode the usage is the number of mapped bytes of the stack.
+ *
+ * @param proc A pointer to the PCB of the process
+ * @return     The peak stack usage of the process in bytes
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long stack_usage(pcb_t *proc) {
+    if (PAGING_ENABLED) {
+        return vstack_mapped_bytes(proc->mem_start, proc->stack_size);
+    }
+    unsigned long *word = (unsigned long *) proc->mem_start;
+    unsigned long num_words = proc->stack_size / sizeof(unsigned long);
+    unsigned long untouched = 0;
+    while (untouched < num_words && word[untouched] == STACK_PAINT_PATTERN) {
+        untouched++;
+    }
+    return proc->stack_size - untouched * sizeof(unsigned long);
+}
+
 /*-----------------------------------------------------------------------------------
  * Creates the idle process.
  *
@@ -109,10 +251,11 @@ void create_idle_proc(pcb_t *idle_proc) {
     idle_proc->esp = esp;
     // PID of idle process is 0
     idle_proc->pid = 0;
+    idle_proc->owner = idle_proc;
 
     // Initialize process context
     context_frame_t *context_frame = esp;
-    memset(context_frame, 0, sizeof(context_frame));
+    fill_words(context_frame, 0, sizeof(context_frame));
     context_frame->iret_eip = (unsigned long) &idleproc;
     context_frame->iret_cs = getCS();
     context_frame->eflags = EFLAGS;
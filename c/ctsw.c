@@ -14,23 +14,51 @@
  *   - Takes a pointer to the current process and switches into the context of
  *     that process, letting it run until an event occurs, in which it will
  *     return to the dispatcher with the type of request that was made
+ *
+ * Notes on multiple processors:
+ * - The kernel stack pointer, process stack pointer, return value,
+ *   request and system call arguments are kept in the cpu_t of the
+ *   processor, which the %gs segment of each processor points to. The
+ *   entry points use %gs before anything else, so no other processor's
+ *   state is touched
+ *
+ * Notes on the keyboard, serial and disk interrupts:
+ * - _KBDEntryPoint runs kbd_lower_half on the kernel stack, below the
+ *   kernel state pushed by contextswitch, and returns straight to the
+ *   interrupted process. It only goes through _CommonEntryPoint to the
+ *   dispatcher when the interrupt made ready a process that should
+ *   pre-empt the interrupted process
+ * - _SerialEntryPoint does the same with serial_lower_half, and
+ *   _ATAEntryPoint with ata_lower_half
+ *
+ * Notes on fast system calls:
+ * - _FastSysCallEntryPoint does not switch to the kernel stack or save the
+ *   process state. It disables interrupts, which the trap gate leaves as
+ *   they were in the process, and calls fast_dispatch on the process stack
+ *   with the request in %eax and the argument in %edx, so the process can
+ *   neither be switched out nor moved to another processor during the call.
+ *   It returns to the process with the result in %eax, and iret restores
+ *   the interrupt flag of the process. Only %ecx and %edx are clobbered, which the
+ *   caller, fastcall, expects
+ *
+ * Notes on preemptible system calls:
+ * - _PreemptibleSysCallEntryPoint is the same as the fast path, but calls
+ *   preemptible_dispatch with interrupts enabled, which the trap gate
+ *   leaves as they were in the process. An interrupt taken while the call
+ *   is serviced pushes the process state onto the process stack below the
+ *   call, as it would in the process itself, so the process may be
+ *   switched out and continue the call later. Its caller is preemptcall
  *------------------------------------------------------------------------
  */
 
 void _SysCallEntryPoint(void);
 void _TimerEntryPoint(void);
 void _KBDEntryPoint(void);
-
-static void *k_stack;
-static unsigned long *ESP;
-
-// Save arguments for the dispatcher, so the dispatcher
-// does not need to know about the context part of the stack
-// Not used when processing an interrupt
-unsigned long *args;
-
-static int EAX;
-static int interrupt;
+void _SerialEntryPoint(void);
+void _ATAEntryPoint(void);
+void _APICTimerEntryPoint(void);
+void _FastSysCallEntryPoint(void);
+void _PreemptibleSysCallEntryPoint(void);
 
 /*------------------------------------------------------------------------
  * Sets the interrupt service routine entry points in the interrupt table.
@@ -42,14 +70,20 @@ void contextinit(void) {
     (void) _SysCallEntryPoint;
     (void) _TimerEntryPoint;
     (void) _KBDEntryPoint;
+    (void) _SerialEntryPoint;
+    (void) _ATAEntryPoint;
+    (void) _APICTimerEntryPoint;
+    (void) _FastSysCallEntryPoint;
+    (void) _PreemptibleSysCallEntryPoint;
 
-    // Remove compiler warning for unused k_stack
-    (void) k_stack;
-    // Remove compiler warning for unused args
-    (void) args;
     set_evec(SYSCALL_INTERRUPT_NUMBER, (unsigned long) _SysCallEntryPoint);
     set_evec(TIMER_INTERRUPT_NUMBER, (unsigned long) _TimerEntryPoint);
     set_evec(KEYBOARD_INTERRUPT_NUMBER, (unsigned long) _KBDEntryPoint);
+    set_evec(SERIAL_INTERRUPT_NUMBER, (unsigned long) _SerialEntryPoint);
+    set_evec(ATA_INTERRUPT_NUMBER, (unsigned long) _ATAEntryPoint);
+    set_evec(APIC_TIMER_INTERRUPT_NUMBER, (unsigned long) _APICTimerEntryPoint);
+    set_evec(FAST_SYSCALL_INTERRUPT_NUMBER, (unsigned long) _FastSysCallEntryPoint);
+    set_evec(PREEMPTIBLE_SYSCALL_INTERRUPT_NUMBER, (unsigned long) _PreemptibleSysCallEntryPoint);
     kprintf("Finished contextinit\n");
 }
 
@@ -70,62 +104,152 @@ void contextinit(void) {
  *------------------------------------------------------------------------
  */
 request_t contextswitch(pcb_t *proc) {
-    ESP = proc->esp;
-    EAX = proc->result_code;
+    cpu_t *cpu = this_cpu();
+    cpu->esp = proc->esp;
+    cpu->eax = proc->result_code;
 
     /*------------------------------------------------------------------------
      * In-line asm: (switch from kernel to process)
      *      push kernel state onto the kernel stack
-     *      save kernel stack pointer
+     *      save kernel stack pointer in cpu->k_stack
      *      switch to process stack
      *      pop process state from the process stack
      *      save return value in %eax
      *      iret
      * _TimerEntryPoint (switch from process to kernel):
      *      disable interrupts
-     *      save indication that this is a timer interrupt
+     *      push process state onto process stack
+     *      keep indication that this is a timer interrupt in %ecx
      *      jump to _CommonEntryPoint
      * _SysCallEntryPoint (switch from process to kernel):
      *      disable interrupts
-     *      save indication that this is a system call
-     * _CommonEntryPoint:
      *      push process state onto process stack
+     *      keep indication that this is a system call in %ecx
+     * _KBDEntryPoint (lower half on the kernel stack):
+     *      push process state onto process stack
+     *      call kbd_lower_half on the kernel stack
+     *      restore the process state and iret, unless the dispatcher must run
+     *      a process that was made ready, in which case restore the interrupted
+     *      %eax and jump to _CommonEntryPoint
+     * _FastSysCallEntryPoint (stays in the process):
+     *      disable interrupts
+     *      pass %eax and %edx to fast_dispatch on the process stack
+     *      iret with the result in %eax
+     * _PreemptibleSysCallEntryPoint (stays in the process, may be pre-empted):
+     *      enable interrupts
+     *      pass %eax and %edx to preemptible_dispatch on the process stack
+     *      iret with the result in %eax
+     * _CommonEntryPoint:
+     *      save indication in cpu->interrupt
      *      save process stack pointer
      *      switch to kernel stack
      *      save %eax
      *      retrieve system call arguments from %edx
      *      pop kernel state from kernel stack
+     *
+     * The cpu_t offsets used are 4 for k_stack, 8 for esp, 12 for eax,
+     * 16 for interrupt and 20 for args
      *------------------------------------------------------------------------
      */
     __asm__ volatile(
     "pushf;"
             "pusha;"
-            "movl %%esp, k_stack;"
-            "movl ESP, %%esp;"
+            "movl %%esp, %%gs:4;"
+            "movl %%gs:8, %%esp;"
             "popa;"
-            "movl EAX, %%eax;"
+            "movl %%gs:12, %%eax;"
             "iret;"
 
             "_TimerEntryPoint:"
             "cli;"
-            "movl $32, interrupt;"
+            "pusha;"
+            "movl $32, %%ecx;"
             "jmp _CommonEntryPoint;"
 
             "_KBDEntryPoint:"
             "cli;"
-            "movl $33, interrupt;"
+            "pusha;"
+            "movl %%esp, %%eax;"
+            "movl %%gs:4, %%esp;"
+            "pushl %%eax;"
+            "call kbd_lower_half;"
+            "popl %%esp;"
+            "testl %%eax, %%eax;"
+            "jnz _KBDReschedule;"
+            "popa;"
+            "iret;"
+            "_KBDReschedule:"
+            "movl 28(%%esp), %%eax;"
+            "movl $33, %%ecx;"
             "jmp _CommonEntryPoint;"
 
+            "_SerialEntryPoint:"
+            "cli;"
+            "pusha;"
+            "movl %%esp, %%eax;"
+            "movl %%gs:4, %%esp;"
+            "pushl %%eax;"
+            "call serial_lower_half;"
+            "popl %%esp;"
+            "testl %%eax, %%eax;"
+            "jnz _SerialReschedule;"
+            "popa;"
+            "iret;"
+            "_SerialReschedule:"
+            "movl 28(%%esp), %%eax;"
+            "movl $36, %%ecx;"
+            "jmp _CommonEntryPoint;"
+
+            "_ATAEntryPoint:"
+            "cli;"
+            "pusha;"
+            "movl %%esp, %%eax;"
+            "movl %%gs:4, %%esp;"
+            "pushl %%eax;"
+            "call ata_lower_half;"
+            "popl %%esp;"
+            "testl %%eax, %%eax;"
+            "jnz _ATAReschedule;"
+            "popa;"
+            "iret;"
+            "_ATAReschedule:"
+            "movl 28(%%esp), %%eax;"
+            "movl $46, %%ecx;"
+            "jmp _CommonEntryPoint;"
+
+            "_APICTimerEntryPoint:"
+            "cli;"
+            "pusha;"
+            "movl $48, %%ecx;"
+            "jmp _CommonEntryPoint;"
+
+            "_FastSysCallEntryPoint:"
+            "cli;"
+            "pushl %%edx;"
+            "pushl %%eax;"
+            "call fast_dispatch;"
+            "addl $8, %%esp;"
+            "iret;"
+
+            "_PreemptibleSysCallEntryPoint:"
+            "sti;"
+            "pushl %%edx;"
+            "pushl %%eax;"
+            "call preemptible_dispatch;"
+            "addl $8, %%esp;"
+            "iret;"
+
             "_SysCallEntryPoint:"
             "cli;"
-            "movl $0, interrupt;"
+            "pusha;"
+            "movl $0, %%ecx;"
 
             "_CommonEntryPoint:"
-            "pusha;"
-            "movl %%esp, ESP;"
-            "movl k_stack, %%esp;"
-            "movl %%eax, EAX;"
-            "movl %%edx, args;"
+            "movl %%ecx, %%gs:16;"
+            "movl %%esp, %%gs:8;"
+            "movl %%gs:4, %%esp;"
+            "movl %%eax, %%gs:12;"
+            "movl %%edx, %%gs:20;"
             "popa;"
             "popf;"
     :
@@ -135,21 +259,35 @@ request_t contextswitch(pcb_t *proc) {
 
     int request;
 
-    if (interrupt == TIMER_INTERRUPT_NUMBER) {
+    if (cpu->interrupt == TIMER_INTERRUPT_NUMBER) {
         // The request is a timer interrupt
         // The return value of a hardware interrupt is the value of eax when the interrupt occurred
-        proc->result_code = EAX;
+        proc->result_code = cpu->eax;
         request = TIMER_INT;
-    } else if (interrupt == KEYBOARD_INTERRUPT_NUMBER) {
+    } else if (cpu->interrupt == KEYBOARD_INTERRUPT_NUMBER) {
         // The request is a keyboard interrupt
         // The return value of a hardware interrupt is the value of eax when the interrupt occurred
-        proc->result_code = EAX;
+        proc->result_code = cpu->eax;
         request = KEYBOARD_INT;
+    } else if (cpu->interrupt == SERIAL_INTERRUPT_NUMBER) {
+        // The request is a serial port interrupt
+        // The return value of a hardware interrupt is the value of eax when the interrupt occurred
+        proc->result_code = cpu->eax;
+        request = SERIAL_INT;
+    } else if (cpu->interrupt == ATA_INTERRUPT_NUMBER) {
+        // The request is a disk interrupt
+        // The return value of a hardware interrupt is the value of eax when the interrupt occurred
+        proc->result_code = cpu->eax;
+        request = ATA_INT;
+    } else if (cpu->interrupt == APIC_TIMER_INTERRUPT_NUMBER) {
+        // The request is a local timer interrupt on one of the other processors
+        proc->result_code = cpu->eax;
+        request = APIC_TIMER_INT;
     } else {
         // The request is a system call, in which the request is in EAX
-        request = EAX;
+        request = cpu->eax;
     }
 
-    proc->esp = ESP;
+    proc->esp = cpu->esp;
     return request;
 }
@@ -2,7 +2,14 @@
  */
 
 #include <xeroskernel.h>
+#include <xeroslib.h>
 #include <kbd.h>
+#include <pipe.h>
+#include <serial.h>
+#include <console.h>
+#include <ramdisk.h>
+#include <ata.h>
+#include <memdev.h>
 
 /*-----------------------------------------------------------------------------------
  * This where the DI (device independent) calls of the DII (device independent
@@ -12,9 +19,34 @@
  * The parameters to these calls are the process that called the corresponding system
  * call, along with the parameters of the corresponding system call.
  *
+ * Notes on devices and file descriptors:
+ * - Drivers register their own device structures with di_register at boot, under a
+ *   name and a major and minor number. The major number is what sysopen takes, and
+ *   indexes the device table directly
+ * - A process starts with room for FD_TABLE_SIZE file descriptors in its PCB, and
+ *   the table is moved to the kernel heap and doubled whenever it is full, up to
+ *   MAX_FDS
+ * - The free entries of the table are kept in a bitmap, so an open takes the
+ *   lowest free descriptor with a single bit scan, and a close and the check of a
+ *   descriptor are a single bit operation, however many are open
+ * - A thread uses the table of its owner, see create.c. Devices are opened and
+ *   closed on behalf of the owner, so a descriptor stays open until the owner
+ *   closes it or is released, and reads and writes are made by the calling process,
+ *   which is the one that blocks
+ *
  * List of functions that are called from outside this file:
  * - kdiinit
  *   - Initializes the device table
+ * - di_register
+ *   - Adds a device to the device table
+ * - di_lookup
+ *   - Returns the major number of a device by name
+ * - di_init_fds
+ *   - Gives a new process an empty file descriptor table
+ * - di_release_fds
+ *   - Closes the file descriptors of a process and frees its table
+ * - di_inherit_fds
+ *   - Opens the devices a parent has open for a new process
  * - di_open
  *   - DII call for sysopen
  * - di_close
@@ -25,13 +57,21 @@
  *   - DII call for sysread
  * - di_ioctl
  *   - DII call for sysioctl
+ * - di_aioread
+ *   - DII call for sysaioread
+ * - di_step
+ *   - DII call for a step of a preemptible sysread or syswrite
  *-----------------------------------------------------------------------------------
  */
 
+static int alloc_fd(pcb_t *proc);
+static int grow_fd_table(pcb_t *proc);
 static int is_valid_fd(pcb_t *proc, int fd);
 
 /*-----------------------------------------------------------------------------------
- * The device table contains 2 devices. Both entries are for the keyboard.
+ * The device table holds the registered devices by major number, NULL where none is
+ * registered. At boot these are 2 keyboard devices followed by NUM_PIPES pipes, a
+ * serial port, the console, a RAM disk, an ATA disk and the memory devices.
  *
  * The device 0 version of the keyboard will not, by default, echo the characters as
  * they arrive. This means that if the characters need to be displayed, the
@@ -40,55 +80,187 @@ static int is_valid_fd(pcb_t *proc, int fd);
  * Device 1 will, by default, echo the characters. This means that the character
  * could be displayed before the application has actually read the character.
  *
- * Even though these are separate devices, only one of them is allowed to be open at
- * a time.
+ * Both devices read through the same line discipline, and up to LDISC_MAX_READERS
+ * processes may have either of them open at a time, each seeing all of the input,
+ * see kbd.c and ldisc.c.
+ *
+ * Each pipe is a separate device with its own ring buffer, any number of processes
+ * may have a pipe open, see pipe.c.
+ *
+ * Then comes the first serial port, which any number of processes may have open,
+ * see serial.c.
+ *
+ * Then comes the console, the output only device sysputs also writes to, see
+ * console.c.
+ *
+ * Then comes a RAM disk, a block device read and written through the buffer cache,
+ * which one process may have open at a time, see ramdisk.c.
+ *
+ * Then comes the disk of the primary ATA channel, a block device like the RAM disk
+ * whose blocks are read in and written out on interrupts, see ata.c.
+ *
+ * The last devices are /dev/null, /dev/zero and a loopback device, which are backed
+ * by kernel memory alone and serve as a baseline for the cost of the device path,
+ * see memdev.c.
  *-----------------------------------------------------------------------------------
  */
-static devsw_t dev_table[DEVICE_TABLE_SIZE];
+static devsw_t *dev_table[DEVICE_TABLE_SIZE];
 
 /*-----------------------------------------------------------------------------------
- * Initializes the device table.
+ * Initializes the device table, with the devices each driver registers.
  *-----------------------------------------------------------------------------------
  */
 void kdiinit(void) {
     kprintf("Starting kdiinit...\n");
-    kbd_devsw_init(&dev_table[KBD_0], KBD_0);
-    kbd_devsw_init(&dev_table[KBD_1], KBD_1);
-
-    dev_table[KBD_0].dvinit();
-    dev_table[KBD_1].dvinit();
+    for (int i = 0; i < DEVICE_TABLE_SIZE; i++) {
+        dev_table[i] = NULL;
+    }
+    kbd_register();
+    pipe_register();
+    serial_register();
+    console_register();
+    ramdisk_register();
+    ata_register();
+    memdev_register();
     kprintf("Finished kdiinit\n");
 }
 
+/*-----------------------------------------------------------------------------------
+ * Adds the given device structure of a driver to the device table under the given
+ * name and numbers, and initializes the device. The structure must outlive the
+ * registration, drivers keep theirs in static storage.
+ *
+ * @param devsw The device structure, with its calls filled in
+ * @param name  The name of the device, unique among the registered devices
+ * @param major The major number sysopen takes for the device
+ * @param minor The minor number, for the driver to tell its devices apart
+ * @return      0 on success, -1 if the major number is out of range or taken, the
+ *              name is taken, or the device failed to initialize
+ *-----------------------------------------------------------------------------------
+ */
+int di_register(devsw_t *devsw, char *name, int major, int minor) {
+    if (major < 0 || major >= DEVICE_TABLE_SIZE || dev_table[major] != NULL || di_lookup(name) >= 0) {
+        kprintf("di_register: %s not registered as device %d\n", name, major);
+        return -1;
+    }
+    devsw->dvname = name;
+    devsw->dvnum = major;
+    devsw->dvminor = minor;
+    if (devsw->dvinit()) {
+        return -1;
+    }
+    dev_table[major] = devsw;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the major number of the registered device with the given name.
+ *
+ * @param name The name of the device
+ * @return     The major number, -1 if no device has the name
+ *-----------------------------------------------------------------------------------
+ */
+int di_lookup(char *name) {
+    for (int i = 0; i < DEVICE_TABLE_SIZE; i++) {
+        if (dev_table[i] != NULL && strcmp_words(dev_table[i]->dvname, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Gives the given new process an empty file descriptor table of FD_TABLE_SIZE
+ * entries, kept in its PCB. A thread uses the table of its owner instead.
+ *-----------------------------------------------------------------------------------
+ */
+void di_init_fds(pcb_t *proc) {
+    proc->cold->fd_table = proc->cold->fd_inline;
+    proc->cold->fd_table_size = FD_TABLE_SIZE;
+    for (int i = 0; i < FD_TABLE_SIZE; i++) {
+        proc->cold->fd_inline[i] = NULL;
+    }
+    proc->cold->free_fds = (1 << FD_TABLE_SIZE) - 1;
+    proc->cold->nonblocking_fds = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Closes the devices the given terminating process left open, so the keyboard and
+ * pipes see the process go, and frees its file descriptor table if it grew. The
+ * process owns the table, its threads have terminated.
+ *-----------------------------------------------------------------------------------
+ */
+void di_release_fds(pcb_t *proc) {
+    unsigned int open_fds = ~proc->cold->free_fds & ((1 << proc->cold->fd_table_size) - 1);
+    int fd;
+    while ((fd = find_first_set_bit(open_fds)) >= 0) {
+        di_close(proc, fd);
+        open_fds &= ~(1 << fd);
+    }
+    if (proc->cold->fd_table != proc->cold->fd_inline) {
+        kfree(proc->cold->fd_table);
+    }
+    di_init_fds(proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Opens the devices the given parent has open for the given new process, under the
+ * same file descriptors and in the same mode, as if the new process had opened them
+ * itself. A descriptor that does not fit in the table of the new process as it
+ * cannot grow, or that the device refuses to open again, is left free.
+ *
+ * @param proc   The new process, with an empty table
+ * @param parent The process whose file descriptors are inherited
+ *-----------------------------------------------------------------------------------
+ */
+void di_inherit_fds(pcb_t *proc, pcb_t *parent) {
+    parent = parent->owner;
+    while (proc->cold->fd_table_size < parent->cold->fd_table_size) {
+        if (grow_fd_table(proc)) {
+            break;
+        }
+    }
+    unsigned int open_fds = ~parent->cold->free_fds & ((1 << parent->cold->fd_table_size) - 1);
+    int fd;
+    while ((fd = find_first_set_bit(open_fds)) >= 0 && fd < proc->cold->fd_table_size) {
+        open_fds &= ~(1 << fd);
+        devsw_t *devsw = parent->cold->fd_table[fd];
+        if (devsw->dvopen(devsw, proc, devsw->dvnum) == 0) {
+            proc->cold->fd_table[fd] = devsw;
+            proc->cold->free_fds &= ~(1 << fd);
+        }
+    }
+    proc->cold->nonblocking_fds = parent->cold->nonblocking_fds & ~proc->cold->free_fds;
+}
+
 /*-----------------------------------------------------------------------------------
  * DII call for sysopen.
  *
  * @param proc      The process that called sysopen
  * @param device_no The major device number
- * @return          A file descriptor in the range 0 to 3 (inclusive) on success,
- *                  -1 if the open fails
+ * @return          A file descriptor in the range 0 to MAX_FDS - 1 (inclusive) on
+ *                  success, the lowest one free, -1 if the open fails
  *-----------------------------------------------------------------------------------
  */
 int di_open(pcb_t *proc, int device_no) {
-    // Verify that the major number is in the valid range
-    if (device_no >= 0 && device_no < DEVICE_TABLE_SIZE) {
+    // Verify that the major number is in the valid range and registered
+    if (device_no >= 0 && device_no < DEVICE_TABLE_SIZE && dev_table[device_no] != NULL) {
+        pcb_t *owner = proc->owner;
         // Check if there is a FDT entry available
-        int fd;
-        for (fd = 0; fd < FD_TABLE_SIZE; fd++) {
-            if (proc->fd_table[fd] == NULL) break;
-        }
-        if (fd == FD_TABLE_SIZE) {
+        int fd = alloc_fd(owner);
+        if (fd < 0) {
             return -1;
         }
-        // Allocate FDT entry
         // Locate the device block with major device number
-        devsw_t *devsw = &dev_table[device_no];
+        devsw_t *devsw = dev_table[device_no];
         // Call the device specific dvopen function pointed to by the device block
-        if (devsw->dvopen(proc, device_no)) {
+        if (devsw->dvopen(devsw, owner, device_no)) {
+            owner->cold->free_fds |= 1 << fd;
             return -1;
         }
         // Add the entry to the file descriptor table in the PCB
-        proc->fd_table[fd] = devsw;
+        owner->cold->fd_table[fd] = devsw;
+        owner->cold->nonblocking_fds &= ~(1 << fd);
         // Return index of selected FDT to process
         return fd;
     } else {
@@ -105,12 +277,15 @@ int di_open(pcb_t *proc, int device_no) {
  *-----------------------------------------------------------------------------------
  */
 int di_close(pcb_t *proc, int fd) {
-    if (is_valid_fd(proc, fd)) {
-        devsw_t *devsw = proc->fd_table[fd];
-        if (devsw->dvclose(proc)) {
+    pcb_t *owner = proc->owner;
+    if (is_valid_fd(owner, fd)) {
+        devsw_t *devsw = owner->cold->fd_table[fd];
+        if (devsw->dvclose(devsw, owner)) {
             return -1;
         }
-        proc->fd_table[fd] = NULL;
+        owner->cold->fd_table[fd] = NULL;
+        owner->cold->free_fds |= 1 << fd;
+        owner->cold->nonblocking_fds &= ~(1 << fd);
         return 0;
     } else {
         return -1;
@@ -124,13 +299,15 @@ int di_close(pcb_t *proc, int fd) {
  * @param fd     The provided file descriptor
  * @param buf    The buffer to write from
  * @param buflen The upper limit of bytes to write from buf
- * @return       The number of bytes written on success, -1 if there was an error
+ * @return       The number of bytes written on success
+ *               -1 if there was an error
+ *               -2 if the syswrite call should block
  *-----------------------------------------------------------------------------------
  */
 int di_write(pcb_t *proc, int fd, void *buf, int buflen) {
-    if (valid_buf(buf, buflen) && is_valid_fd(proc, fd)) {
-        devsw_t *devsw = proc->fd_table[fd];
-        return devsw->dvwrite(proc, buf, buflen);
+    if (valid_buf(buf, buflen) && is_valid_fd(proc->owner, fd)) {
+        devsw_t *devsw = proc->owner->cold->fd_table[fd];
+        return devsw->dvwrite(devsw, proc, buf, buflen);
     } else {
         return -1;
     }
@@ -146,20 +323,24 @@ int di_write(pcb_t *proc, int fd, void *buf, int buflen) {
  * @return       The number of bytes read on success
  *               0 to indicate end-of-file (EOF)
  *               -1 if there was an error
+ *               BLOCKERR if the file descriptor is in non-blocking mode and the
+ *               read would block
  *               -2 if the sysread call should block
  *-----------------------------------------------------------------------------------
  */
 int di_read(pcb_t *proc, int fd, void *buf, int buflen) {
-    if (valid_buf(buf, buflen) && is_valid_fd(proc, fd)) {
-        devsw_t *devsw = proc->fd_table[fd];
-        return devsw->dvread(proc, buf, buflen);
+    if (valid_buf(buf, buflen) && is_valid_fd(proc->owner, fd)) {
+        devsw_t *devsw = proc->owner->cold->fd_table[fd];
+        int nonblocking = (proc->owner->cold->nonblocking_fds & (1 << fd)) != 0;
+        return devsw->dvread(devsw, proc, buf, buflen, nonblocking);
     } else {
         return -1;
     }
 }
 
 /*-----------------------------------------------------------------------------------
- * DII call for sysioctl.
+ * DII call for sysioctl. IOCTL_NONBLOCK_ON and IOCTL_NONBLOCK_OFF apply to any
+ * device and are handled here, the other commands are passed to the device.
  *
  * @param proc       The process that called sysioctl
  * @param fd         The provided file descriptor
@@ -169,23 +350,129 @@ int di_read(pcb_t *proc, int fd, void *buf, int buflen) {
  *-----------------------------------------------------------------------------------
  */
 int di_ioctl(pcb_t *proc, int fd, unsigned long command, void *ioctl_args) {
-    if (is_valid_fd(proc, fd)) {
-        devsw_t *devsw = proc->fd_table[fd];
-        return devsw->dvioctl(proc, command, ioctl_args);
+    pcb_t *owner = proc->owner;
+    if (is_valid_fd(owner, fd)) {
+        devsw_t *devsw = owner->cold->fd_table[fd];
+        switch (command) {
+            case (IOCTL_NONBLOCK_ON):
+                owner->cold->nonblocking_fds |= 1 << fd;
+                return 0;
+            case (IOCTL_NONBLOCK_OFF):
+                owner->cold->nonblocking_fds &= ~(1 << fd);
+                return 0;
+            default:
+                return devsw->dvioctl(devsw, proc, command, ioctl_args);
+        }
     } else {
         return -1;
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * DII call for sysaioread.
+ *
+ * @param proc          The process that called sysaioread
+ * @param fd            The provided file descriptor
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with, 0 to 30 (inclusive)
+ * @return              0 if the read was started, -1 if there was an error
+ *-----------------------------------------------------------------------------------
+ */
+int di_aioread(pcb_t *proc, int fd, void *buf, int buflen, int signal_number) {
+    int signal_31 = SIGNAL_TABLE_SIZE - 1;
+    if (valid_buf(buf, buflen) && is_valid_fd(proc->owner, fd) && signal_number >= 0 && signal_number < signal_31) {
+        devsw_t *devsw = proc->owner->cold->fd_table[fd];
+        return devsw->dvaioread(devsw, proc, buf, buflen, signal_number);
+    } else {
+        return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * DII call for a step of a sysread or syswrite serviced by preemptible_dispatch.
+ * Moves at most a block of a device that has a step, without blocking. Any other
+ * call, and any error, is left to the dispatcher, which reports it.
+ *
+ * @param proc   The process that called sysread or syswrite
+ * @param fd     The provided file descriptor
+ * @param buf    The buffer to read into or write from
+ * @param buflen The upper limit of bytes to move
+ * @param write  1 for syswrite, 0 for sysread
+ * @return       The number of bytes moved on success
+ *               0 to indicate end-of-file (EOF) on a read
+ *               -1 if there was an error on a write or no block could be read
+ *               BLOCKERR if the device would block
+ *               PREEMPT_DISPATCH if the call is to be serviced by the dispatcher
+ *-----------------------------------------------------------------------------------
+ */
+int di_step(pcb_t *proc, int fd, void *buf, int buflen, int write) {
+    if (valid_buf(buf, buflen) && is_valid_fd(proc->owner, fd)) {
+        devsw_t *devsw = proc->owner->cold->fd_table[fd];
+        if (devsw->dvstep != NULL) {
+            return devsw->dvstep(devsw, proc, buf, buflen, write);
+        }
+    }
+    return PREEMPT_DISPATCH;
+}
+
 /*-----------------------------------------------------------------------------------
  * Verifies that the passed in file descriptor is in the valid range and corresponds
  * to an opened device.
  *
- * @param proc The process with fd open
+ * @param proc The process that owns the table with fd open
  * @param fd   The provided file descriptor
  * @return     1 if the passed in file descriptor is valid, 0 otherwise
  *-----------------------------------------------------------------------------------
  */
 static int is_valid_fd(pcb_t *proc, int fd) {
-    return fd >= 0 && fd < FD_TABLE_SIZE && proc->fd_table[fd] != NULL;
+    return fd >= 0 && fd < proc->cold->fd_table_size && !(proc->cold->free_fds & (1 << fd));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the lowest free file descriptor of the given owner of a table, growing the
+ * table if none is free.
+ *
+ * @return The file descriptor, -1 if the table is full at MAX_FDS entries or could
+ *         not grow
+ *-----------------------------------------------------------------------------------
+ */
+static int alloc_fd(pcb_t *proc) {
+    if (proc->cold->free_fds == 0 && grow_fd_table(proc)) {
+        return -1;
+    }
+    int fd = find_first_set_bit(proc->cold->free_fds);
+    proc->cold->free_fds &= ~(1 << fd);
+    return fd;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Doubles the file descriptor table of the given owner of a table, moving it to the
+ * kernel heap. The new entries are free.
+ *
+ * @return 0 on success, -1 if the table is at MAX_FDS entries or the heap is full
+ *-----------------------------------------------------------------------------------
+ */
+static int grow_fd_table(pcb_t *proc) {
+    int old_size = proc->cold->fd_table_size;
+    int new_size = old_size * 2 > MAX_FDS ? MAX_FDS : old_size * 2;
+    if (new_size == old_size) {
+        return -1;
+    }
+    devsw_t **table = kmalloc(new_size * sizeof(devsw_t *));
+    if (table == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < new_size; i++) {
+        table[i] = i < old_size ? proc->cold->fd_table[i] : NULL;
+    }
+    if (proc->cold->fd_table != proc->cold->fd_inline) {
+        kfree(proc->cold->fd_table);
+    }
+    proc->cold->fd_table = table;
+    proc->cold->fd_table_size = new_size;
+    for (int i = old_size; i < new_size; i++) {
+        proc->cold->free_fds |= 1 << i;
+    }
+    return 0;
 }
@@ -4,9 +4,11 @@
 #include <xeroskernel.h>
 #include <i386.h>
 #include <queue.h>
-#include <deltalist.h>
 #include <xeroslib.h>
 #include <kbd.h>
+#include <serial.h>
+#include <ata.h>
+#include <console.h>
 
 /*-----------------------------------------------------------------------------------
  * This is the dispatcher, responsible for processing system calls and
@@ -14,24 +16,209 @@
  * kernel.
  *
  * Notes on PCB selection algorithm and how PIDs are assigned:
+ * - The PCB table starts with one chunk of PCB_CHUNK_SIZE PCBs, and another chunk
+ *   is allocated whenever no PCB is unused, up to MAX_PROCESSES PCBs
  * - Initially, the PID is the 1-index of the PCB table
  * - When a PCB is marked for reuse, the old PID is used to calculate the
  *   new PID:
- *   new_pid = prev_pid + PCB_TABLE_SIZE
+ *   new_pid = prev_pid + MAX_PROCESSES
  *   If this overflows, we "wrap around" and calculate the new PID:
- *   new_pid = prev_pid % PCB_TABLE_SIZE
+ *   new_pid = (prev_pid - 1) % MAX_PROCESSES + 1
  *   - This makes it possible to index into the PCB in small, constant time:
- *     pcb_t *proc = &pcb_table[(pid - 1) % PCB_TABLE_SIZE]
+ *     pcb_t *proc = pcb_at((pid - 1) % MAX_PROCESSES)
  *   - This makes it easy to determine whether or not a PID is valid, by
  *     retrieving the PCB and validating that it is not stopped
  *   - To minimize the problems with process interactions based on PIDs,
  *     the PID reuse interval is large
  *
+ * Notes on the PCB layout:
+ * - The fields of pcb_t that the scheduler and the context switcher use on every
+ *   switch and queue operation come first and fill one cache line, and the chunks
+ *   of the PCB table are aligned to cache lines, so walking a queue or the table
+ *   reads one line per PCB
+ * - The blocked queues, the receive set, the signal table, queued signals, the file
+ *   descriptor table and the statistics of the waits live in a pcb_cold_t of each
+ *   PCB, allocated in a chunk of their own along with the PCBs, so the hot lines of
+ *   neighbouring PCBs are not pushed apart by them
+ *
+ * Notes on threads, made by create_thread:
+ * - A thread takes an unused PCB like any process, but get_unused_pcb leaves the
+ *   signal table and file descriptor table of the PCB alone, the thread uses those
+ *   of its owner
+ * - When a process with threads terminates, its threads are sent signal 31, and its
+ *   PCB and file descriptors are only released once the last of them terminates, so
+ *   a thread never uses the tables of a PCB that was reused
+ *
+ * Notes on children, reaped with syswaitany:
+ * - A process created by a system call is a child of the process or thread that
+ *   made the call, its parent_pid. Threads and the processes the kernel creates
+ *   have no parent
+ * - When a child terminates, a parent blocked in syswaitany on it is unblocked with
+ *   its PID and exit status at once, otherwise the exit is appended to the exits of
+ *   the parent, so reaping costs the same whatever the number of children and no
+ *   process is blocked per child. A parent that never waits keeps only its last
+ *   MAX_CHILD_EXITS exits
+ * - The parent is looked up by PID, so a child whose parent has terminated tells no
+ *   one, and the exits a parent has not taken are freed when it terminates
+ * - syswaitpg waits the same way for the children in a process group, see pgrp.c
+ *
+ * Notes on preemptible system calls, made through preemptcall:
+ * - The dispatcher runs on the one kernel stack of the processor with interrupts
+ *   disabled, so a system call it services holds off every interrupt until it is
+ *   done. A long call is instead serviced by preemptible_dispatch on the stack of
+ *   the calling process, which is the kernel stack of the process for the call
+ * - The service is split into steps, each of which disables interrupts and takes
+ *   the kernel lock, see begin_step. Between steps interrupts are taken as in the
+ *   process itself, so a timer tick may pre-empt the service, and it continues
+ *   with its next step once the process runs again, whichever processor that is on
+ * - Nothing is held between steps, so what a step reads may have changed since
+ *   the step before, as if the call had been made in parts. A process that is
+ *   terminated part way through the call leaves nothing behind
+ * - The call is counted in the system calls of the process, not in the system
+ *   call table, and pending signals are delivered on the next entry into the
+ *   dispatcher. get_cpu_times is only serviced this way, a step per PCB, and so is
+ *   the deferred work the work process of workq.c runs, a step per work item
+ * - syssendv and sysrecvv copy a message a process already waits for a step at a
+ *   time, see msg.c, and sysread and syswrite move a block a step on the devices
+ *   with a dvstep, the RAM disk and the ATA disk. Whatever cannot be done without
+ *   blocking is left to the dispatcher: the call returns PREEMPT_DISPATCH, and the
+ *   system call stub makes the rest of it through syscall
+ *
+ * Notes on submission rings, set up with sysringsetup:
+ * - A process queues reads, writes, sends, sleeps, opens and closes on a ring in its
+ *   own memory and has all of them carried out with one sysringenter, which posts
+ *   the result of each to a completion ring next to it, so a batch of operations
+ *   costs one entry into the kernel rather than one each
+ * - The rings are checked once when they are registered, and their entries are
+ *   reached through the PCB from then on, so a submission only checks the memory
+ *   of the buffers of its operations, as the system call of each one would
+ * - The operations are carried out in order, as the system calls of the same name
+ *   would be, but without switching to a process a send or write unblocks. One that
+ *   has to wait blocks the process, and sysringenter posts its completion with the
+ *   result the process wakes up with and enters the kernel again for the rest. The
+ *   kernel hands it the number of entries it took through the second argument
+ * - A submission is only taken while the completion ring has room for it, what is
+ *   left is taken by the next sysringenter
+ * - The kernel does not poll the rings, a process with nothing to wait for but its
+ *   completions has no other way into the kernel that could carry out a blocking
+ *   operation for it
+ *
+ * Notes on reaping terminated processes:
+ * - cleanup only does what others can see at once: the processes blocked on the
+ *   terminating process are unblocked, its parent is told, and its timers, ports,
+ *   shared memory, group and open devices are let go of. Its PCB is then put on the
+ *   reap queue
+ * - Freeing the stack, the arena and the unclaimed exits of a PCB on the reap
+ *   queue, and putting the PCB back on the stopped queue, is left to reap, run by
+ *   the dispatcher REAP_BATCH PCBs at a time while the processor is idle, so a
+ *   process that terminates or is killed does not pay for it. The dispatcher also
+ *   reaps a batch once REAP_BATCH PCBs are waiting, so the reap queue stays short
+ *   when the processor is never idle
+ * - A process waited on with syswait is reaped as soon as it terminates, and a
+ *   syswait of a process that is gone reaps the queue, so what the process held is
+ *   free once syswait returns
+ * - A PCB on the reap queue is already stopped, so its PID is invalid, but it is
+ *   not reused until reaped. get_unused_pcb reaps every waiting PCB before it grows
+ *   the PCB table, and create reaps them all before it gives up on a stack
+ *
+ * Notes on time quanta:
+ * - A process is only rotated to the end of its ready queue by the timer once it
+ *   has used up its quantum, which starts every time the process is made ready
+ * - The quantum is PRIORITY_QUANTUM of the priority of the process, unless the
+ *   process has set its own quantum with syssetquantum
+ *
+ * Notes on priority inheritance:
+ * - A process that other processes are blocked on, as senders, receivers or
+ *   waiters, is scheduled at the highest priority of those processes if it is
+ *   higher than its own, so that a low priority server cannot be starved while
+ *   high priority clients wait on it
+ * - The inherited priority is recomputed whenever a process joins or leaves one of
+ *   the blocked queues of the process, and passed on along chains of blocked
+ *   processes
+ *
+ * Notes on receiving from a set of processes:
+ * - A process blocked in sysrecvset is on no queue, so the processes in its set do
+ *   not know of it. Once none of them is left it is failed with −1, as a sysrecv
+ *   from a process that terminates is
+ * - A count of the processes that blocked in sysrecvset is kept, and when it is
+ *   not 0 a terminating process searches the PCB table for receivers left with
+ *   no sender. The search recounts the receivers still blocked, so the count goes
+ *   back to 0 once they have all been sent to
+ *
+ * Notes on the IPC queue statistics, returned by sysgetipcstats:
+ * - Every process counts the waits on its queues of senders and receivers, how
+ *   many processes joined each queue, the most on it at once, and the cycles they
+ *   waited from joining it to leaving it, so a server that its clients queue up on
+ *   stands out
+ * - A wait ends when the process leaves the queue for any reason, its message
+ *   taken, a timeout, a signal or the end of the process it waited on
+ *
+ * Notes on the multilevel feedback scheduler, used if enabled by kmlfqinit:
+ * - New processes start at the highest priority, a process that is pre-empted
+ *   after using up demote_quanta full quanta at a priority is demoted
+ * - A process that wakes up from sleep, a read or IPC is promoted by wake_boost
+ * - Every aging_interval ticks, every process that has been ready for the
+ *   whole interval is promoted by one priority, so demoted processes cannot
+ *   starve
+ * - Promotions never go above the base priority of the process, which
+ *   syssetprio sets along with its current priority
+ *
+ * Notes on the stride scheduler, used if selected by kdispinit:
+ * - The ready processes that are not real-time are kept by stride.c in place of
+ *   the priority queues, and the process with the lowest pass runs next
+ * - The pass of the current process is advanced on every timer tick, priorities
+ *   and the multilevel feedback scheduler have no effect
+ *
+ * Notes on multiple processors, see smp.c:
+ * - Every processor has its own current process, idle process and ready queues,
+ *   reached through this_cpu
+ * - A process is made ready on the ready queues of the processor that readies it,
+ *   and a processor whose ready queues are empty steals the highest priority
+ *   process it may run from the processor with the most ready processes
+ * - The stride heap and the real-time queue are shared, real-time processes only
+ *   run on the boot processor, whose PIT tick also drives sleeping and aging
+ * - The periodic tick is only stopped when idle on a single processor
+ *
+ * Notes on affinity, set with syssetaffinity:
+ * - Every process has a mask of the processors it may run on, inherited from the
+ *   process that made it. Processes made by the kernel may run on every processor
+ *   but those in ISOLATED_CPUS, which only run the processes pinned to them
+ * - A process that may not run on the processor that readies it is made ready on
+ *   the allowed processor with the fewest ready processes, which runs it on its next
+ *   time slice as there is no interprocessor interrupt to reschedule it at once.
+ *   Work stealing, the stride scheduler and the direct switch to an IPC peer only
+ *   ever take a process the processor may run
+ * - A mask with no processor running the dispatcher cannot be set, and a process
+ *   whose processors have all gone is run where it is made ready
+ * - Real-time processes run on the boot processor whatever their mask says
+ * - Interrupts cannot be routed, the 8259 PIC delivers every IRQ to the boot
+ *   processor and there is no IOAPIC driver, so the keyboard and the other devices
+ *   are always serviced there. A process that reads the keyboard wakes up without
+ *   waiting for a time slice if it is pinned to processor 0
+ *
  * List of functions that are called from outside this file:
  * - kdispinit
- *   - Initializes the process queues and PCB table
+ *   - Initializes the process queues and PCB table, selects the scheduling policy
+ *     and registers the system calls of the dispatcher
+ * - kdispcpuinit
+ *   - Initializes the ready queues and idle process of a processor
+ * - kmlfqinit
+ *   - Sets the tunables of the multilevel feedback scheduler
  * - dispatch
  *   - Enters the dispatcher
+ * - kbd_lower_half
+ *   - Services a keyboard interrupt without entering the dispatcher, returns 1 if
+ *     the dispatcher must run a process it made ready
+ * - serial_lower_half
+ *   - Services a serial port interrupt the same way
+ * - ata_lower_half
+ *   - Services a disk interrupt the same way
+ * - preemptible_dispatch
+ *   - Services a long system call on the stack of the calling process with
+ *     interrupts enabled, so it can be pre-empted
+ * - fast_dispatch
+ *   - Services a system call that neither blocks nor reschedules without entering
+ *     the dispatcher
  * - ready
  *   - Adds a process to the ready queue for its priority
  * - get_unused_pcb
@@ -43,97 +230,235 @@
  * - remove_from_blocked_queue
  *   - Returns 1 if the process was removed from the queue of senders/receivers of
  *     the process it is blocked on, 0 otherwise
- * - remove_from_receive_any_queue
- *   - Returns 1 if the process was removed from the queue of processes waiting on
- *     a receive-any, 0 otherwise
+ * - update_inherited_priority
+ *   - Recomputes the priority a process inherits from the processes blocked on it
  * - only_process
  *   - Returns 1 if the current running process is the only user process, 0
  *     otherwise
+ * - reap_terminated
+ *   - Frees what every terminated process left to be reaped
  * - idleproc
  *   - The idle process
  *-----------------------------------------------------------------------------------
  */
 
-extern char *maxaddr;
-
-static pcb_t pcb_table[PCB_TABLE_SIZE];
-// Multiple ready queues, one for each priority
-static Queue ready_queues[NUM_PRIORITIES];
+// The PCB table, allocated in chunks of PCB_CHUNK_SIZE PCBs as it grows
+static pcb_t *pcb_chunks[MAX_PROCESSES / PCB_CHUNK_SIZE];
+static int num_pcb_chunks;
+// Policy for processes that are not real-time, set by kdispinit
+static sched_policy_t sched_policy;
+// Tunables of the multilevel feedback scheduler, disabled until kmlfqinit
+static mlfq_config_t mlfq;
+// Number of timer ticks since the scheduler started
+static unsigned long sched_ticks;
+// Time slices a process at each priority runs before it is rotated
+static int priority_quanta[NUM_PRIORITIES];
 static Queue stopped_queue;
-static pcb_t *current_proc;
-static pcb_t idle_proc;
+// Terminated processes whose stacks and memory are yet to be freed, see reap
+static Queue reap_queue;
+// The PCB get_unused_pcb returned last
+static pcb_t *newest_pcb;
+// At least the number of processes blocked in sysrecvset, see fail_orphaned_recv_sets
+static int recv_set_waiters;
 int user_proc_count;
 
+// The current and idle process of the processor running the dispatcher
+#define current_proc (this_cpu()->current)
+#define idle_proc (this_cpu()->idle)
 // System call arguments set by the context switcher
-extern unsigned long *args;
-
-// The list of sleeping processes
-extern DeltaList sleep_queue;
-// The list of processes waiting on a receive-any
-extern Queue receive_any_queue;
+#define args (this_cpu()->args)
 
 static void yield(void);
+static void account_switch(pcb_t *proc, int voluntary, unsigned long long switched_out);
+static void register_syscalls(void);
 static void service_syscreate(void);
+static void service_syscreatethread(void);
+static void service_sysspawn(void);
+static void service_sysexit(void);
+static void service_syswaitany(void);
+static void service_syssetpgid(void);
+static void service_sysgetpgid(void);
+static void service_syskillpg(void);
+static void service_syswaitpg(void);
+static void wait_for_child(void);
+static void service_sysgetpid(void);
 static void service_sysputs(void);
 static void service_syskill(void);
 static void service_syssetprio(void);
 static void service_syssend(void);
 static void service_sysrecv(void);
+static void service_syssendtim(void);
+static void service_sysrecvtim(void);
+static void service_syssendv(void);
+static void service_sysrecvv(void);
+static void service_send(void *buf, unsigned int len, int vectored);
+static void service_recv(void *buf, unsigned int len, int vectored);
+static void finish_recv(int recv_result_code, int vectored);
+static void service_sysrecvset(void);
+static void service_syssendbatch(void);
+static void service_sysrecvbatch(void);
+static void service_sysringsetup(void);
+static void service_sysringenter(void);
+static int run_ring_entry(io_sqe_t *sqe);
+static int ring_send(io_sqe_t *sqe);
+static void service_sysrpc(void);
+static void service_sysreplywait(void);
+static void service_sysportcreate(void);
+static void service_sysportdestroy(void);
+static void service_sysportsend(void);
+static void service_sysportrecv(void);
+static void service_sysshmcreate(void);
+static void service_sysshmattach(void);
+static void service_sysshmdetach(void);
+static void service_sysfutexwait(void);
+static void service_sysfutexwake(void);
+static int valid_futex(int *addr);
+static void service_syswaitwork(void);
+static void service_syspoll(void);
+static int valid_poll_mask(pcb_t *proc, unsigned int mask);
+static void service_systimer(void);
+static void service_systimercancel(void);
 static void service_syssleep(void);
-static void service_sysgetcputimes(void);
+static void service_sysusleep(void);
 static void service_syssighandler(void);
 static void service_syssigreturn(void);
+static void service_syssigprocmask(void);
+static void service_syssigqueue(void);
 static void service_syswait(void);
 static void service_sysopen(void);
 static void service_sysclose(void);
 static void service_syswrite(void);
 static void service_sysread(void);
 static void service_sysioctl(void);
+static void service_sysaioread(void);
+static void service_sysgetmemstats(void);
+static void service_systracectl(void);
+static void service_systraceread(void);
+static void service_sysprofstart(void);
+static void service_sysprofstop(void);
+static void service_sysprofread(void);
+static void service_syslogctl(void);
+static void service_syslogread(void);
+static void service_sysgetipcstats(void);
+static void service_sysalloc(void);
 static int get_cpu_times(processStatuses *ps);
+static int io_steps(preempt_args_t *req, int write);
+static int message_steps(preempt_args_t *req, int sending);
+static unsigned long begin_step(void);
+static void end_step(unsigned long eflags);
 static void cleanup_current_process_and_next(void);
 static pcb_t *get_pcb(PID_t pid);
 static pcb_t *next(void);
 static void stop(pcb_t *proc);
+static void reap(int max_procs);
+static pcb_t *pcb_at(int slot);
+static int grow_pcb_table(void);
 static void cleanup(pcb_t *proc);
+static void release_tables(pcb_t *proc);
+static void notify_parent(pcb_t *child);
+static int take_child_exit(pcb_t *parent);
+static int has_waited_child(pcb_t *parent);
+static int is_waited_child(pcb_t *parent, PID_t pid, PID_t pgid);
+static void release_child_exits(pcb_t *proc);
 static void unblock(pcb_t *proc, int result_code);
+static void end_ipc_wait(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue);
+static int initial_priority(void);
+static void service_syssetquantum(void);
+static void service_syssetrealtime(void);
+static void service_syssettickets(void);
+static void service_sysclock(void);
+static void service_syssettimerslack(void);
+static void account_ticks(int ticks);
+static void charge_ticks(int ticks);
+static void handoff(pcb_t *peer);
+static void run_peer(pcb_t *peer, int quantum_left);
+static void remove_from_ready_queue(pcb_t *proc);
+static int sched_priority(pcb_t *proc);
+static int outranks(pcb_t *proc, pcb_t *current);
+static void timer_tick(int ticks);
+static int quantum_of(pcb_t *proc);
+static void mlfq_quantum_expired(pcb_t *proc);
+static void age_ready_processes(void);
 static int only_process(void);
+static void fail_orphaned_recv_sets(void);
+static int has_live_sender(pcb_t *receiver);
+static pcb_t *dequeue_ready(cpu_t *cpu);
+static pcb_t *steal(void);
+static pcb_t *first_allowed(cpu_t *cpu, int cpu_index);
+static cpu_t *ready_cpu(pcb_t *proc);
+static void service_syssetaffinity(void);
+static void service_sysgetaffinity(void);
+static void quantum_tick(int ticks);
 
 /*-----------------------------------------------------------------------------------
  * To be called before entering the dispatcher. Initializes the process
  * queues and PCB table, and creates the idle process.
+ *
+ * @param policy The policy processes that are not real-time are scheduled with
  *-----------------------------------------------------------------------------------
  */
-void kdispinit(void) {
+void kdispinit(sched_policy_t policy) {
     kprintf("Starting kdispinit...\n");
 
+    sched_policy = policy;
+    kstrideinit();
+    ksystabinit();
+    register_syscalls();
+    if (sched_policy == SCHED_STRIDE) kprintf("Stride scheduling enabled\n");
+
     // Initially, all process queues are empty
+    kdispcpuinit();
     for (int i = 0; i < NUM_PRIORITIES; i++) {
-        Queue *ready_queue = &ready_queues[i];
-        init_queue(ready_queue);
+        priority_quanta[i] = PRIORITY_QUANTUM(i);
     }
+    sched_ticks = 0;
     init_queue(&stopped_queue);
+    init_queue(&reap_queue);
 
-    // Initialize the PCB table
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
-        pcb_t *proc = &pcb_table[i];
-        // Set process IDs starting from 1 (0 is reserved for idle process)
-        proc->pid = i + 1;
-        Queue *queue_of_senders = &proc->blocked_queues[0];
-        init_queue(queue_of_senders);
-        Queue *queue_of_receivers = &proc->blocked_queues[1];
-        init_queue(queue_of_receivers);
-
-        // Add process to stopped queue
-        stop(proc);
+    // Initialize the PCB table with its first chunk
+    num_pcb_chunks = 0;
+    if (grow_pcb_table() != 0) {
+        kprintf("Failed to allocate the PCB table\n");
     }
 
-    init_queue(&receive_any_queue);
-
-    create_idle_proc(&idle_proc);
     user_proc_count = 0;
     kprintf("Finished kdispinit\n");
 }
 
+/*-----------------------------------------------------------------------------------
+ * To be called on every processor before it enters the dispatcher, by kdispinit on
+ * the boot processor. Initializes the ready queues of the processor to empty and
+ * creates its idle process.
+ *-----------------------------------------------------------------------------------
+ */
+void kdispcpuinit(void) {
+    cpu_t *cpu = this_cpu();
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        Queue *ready_queue = &cpu->ready_queues[i];
+        init_queue(ready_queue);
+    }
+    cpu->ready_bitmap = 0;
+    cpu->num_ready = 0;
+    cpu->idle.cold = &cpu->idle_cold;
+    create_idle_proc(&cpu->idle);
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called after kdispinit and before any processes are created. Sets the
+ * tunables of the multilevel feedback scheduler, which is only used if
+ * config->enabled is set.
+ *
+ * @param config The tunables of the multilevel feedback scheduler
+ *-----------------------------------------------------------------------------------
+ */
+void kmlfqinit(mlfq_config_t *config) {
+    assert(config->demote_quanta >= 1, "MLFQ demote_quanta must be at least 1");
+    assert(config->wake_boost >= 0, "MLFQ wake_boost must not be negative");
+    assert(config->aging_interval >= 1, "MLFQ aging_interval must be at least 1");
+    mlfq = *config;
+    if (mlfq.enabled) kprintf("Multilevel feedback scheduling enabled\n");
+}
+
 /*-----------------------------------------------------------------------------------
  * An infinite loop that processes system calls, schedules the next process,
  * and then calls the context switcher to switch into the next scheduled
@@ -144,80 +469,93 @@ void dispatch(void) {
     kprintf("Running dispatcher...\n");
     // Schedule the next process
     current_proc = next();
+    // The process that was switched into last, whether it left through a system
+    // call, and the time stamp at which it left
+    pcb_t *prev = NULL;
+    int voluntary = 0;
+    unsigned long long switched_out = 0;
+    // The request the kernel was last entered with
+    request_t entered_with = TIMER_INT;
     for (;;) {
+        // Free what terminated processes left while there is nothing else to run,
+        // or once enough of them are waiting
+        if ((current_proc == &idle_proc && !is_empty(&reap_queue)) || size(&reap_queue) >= REAP_BATCH) {
+            reap(REAP_BATCH);
+        }
         // Handle pending signals
         handle_pending_signals(current_proc);
-        // Call the context switcher to switch into the current process
+        // Stop the periodic tick while only the idle process is runnable
+        if (PREEMPTION_ENABLED && current_proc == &idle_proc && !realtime_pending()
+            && smp_cpu_count() == 1) tickless_enter();
+        // Call the context switcher to switch into the current process, other
+        // processors may enter the dispatcher while it runs
+        if (prev != NULL) account_switch(prev, voluntary, switched_out);
+        unsigned long long switched_in = read_tsc();
+        // Interrupts have been disabled since the kernel was entered
+        if (prev != NULL) latency_span(entered_with, switched_in - switched_out);
+        kernel_unlock();
         request_t request = contextswitch(current_proc);
+        switched_out = read_tsc();
+        kernel_lock();
+        // A tick taken now was held off by the span of the kernel before
+        request_t held_off_by = entered_with;
+        entered_with = request;
+        prev = current_proc;
+        prev->run_cycles += switched_out - switched_in;
+        voluntary = request < TIMER_INT;
+        // Time slices that passed while the periodic tick was stopped, -1 if it was not
+        int elapsed_ticks = tickless_exit();
 
         // Determine the nature of the service request and process request
+        if (request < TIMER_INT) {
+            // System calls are serviced through the system call table
+            TRACE(TRACE_SYSCALL, TRACE_SYSCALL_ENTER, prev->pid, request, 0);
+            if (service_syscall(request) != 0) {
+                current_proc->result_code = -1;
+            }
+            TRACE(TRACE_SYSCALL, TRACE_SYSCALL_EXIT, prev->pid, request, prev->result_code);
+            continue;
+        }
         switch (request) {
-            case (SYSCREATE):
-                service_syscreate();
-                break;
-            case (SYSYIELD):
-                yield();
-                break;
-            case (SYSSTOP):
-                cleanup_current_process_and_next();
-                break;
-            case (SYSGETPID):
-                current_proc->result_code = current_proc->pid;
-                break;
-            case (SYSPUTS):
-                service_sysputs();
-                break;
-            case (SYSKILL):
-                service_syskill();
-                break;
-            case (SYSSETPRIO):
-                service_syssetprio();
-                break;
-            case (SYSSEND):
-                service_syssend();
-                break;
-            case (SYSRECV):
-                service_sysrecv();
-                break;
-            case (SYSSLEEP):
-                service_syssleep();
-                break;
-            case (SYSGETCPUTIMES):
-                service_sysgetcputimes();
-                break;
-            case (SYSSIGHANDLER):
-                service_syssighandler();
-                break;
-            case (SYSSIGRETURN):
-                service_syssigreturn();
-                break;
-            case (SYSWAIT):
-                service_syswait();
-                break;
-            case (SYSOPEN):
-                service_sysopen();
-                break;
-            case (SYSCLOSE):
-                service_sysclose();
-                break;
-            case (SYSWRITE):
-                service_syswrite();
-                break;
-            case (SYSREAD):
-                service_sysread();
-                break;
-            case (SYSIOCTL):
-                service_sysioctl();
-                break;
-            case (TIMER_INT):
-                current_proc->cpuTime++;
-                tick();
-                yield();
+            case (TIMER_INT): {
+                // A one-shot that split the time slice to end a sysusleep is not a
+                // tick, the woken process runs at once if it outranks the current one
+                cpu_t *cpu = this_cpu();
+                cpu->need_resched = 0;
+                int split = split_exit();
+                if (split > 0) {
+                    end_of_intr();
+                    if (cpu->need_resched) yield();
+                    break;
+                }
+                // A tick taken while the periodic tick was stopped, or that ended a
+                // split time slice, has no count to read
+                if (elapsed_ticks < 0 && split < 0) latency_tick(held_off_by, tick_age_us());
+                profile_tick(prev);
+                account_ticks(elapsed_ticks < 0 ? 1 : elapsed_ticks);
+                console_flush();
                 end_of_intr();
                 break;
+            }
             case (KEYBOARD_INT):
-                kbd_isr();
-                end_of_intr();
+            case (SERIAL_INT):
+            case (ATA_INT): {
+                // kbd_lower_half, serial_lower_half or ata_lower_half has already
+                // serviced the interrupt, and only comes here to run a process woken
+                // up by the device that outranks the current process, without
+                // waiting for a tick
+                pcb_t *interrupted = current_proc;
+                if (elapsed_ticks > 0) account_ticks(elapsed_ticks);
+                if (current_proc == interrupted) yield();
+                break;
+            }
+            case (APIC_TIMER_INT):
+                // The time slice of one of the other processors, sleeping and
+                // aging are left to the PIT tick of the boot processor
+                profile_tick(prev);
+                charge_ticks(1);
+                quantum_tick(1);
+                lapic_eoi();
                 break;
             default:
                 assert(0, "Invalid request");
@@ -225,6 +563,381 @@ void dispatch(void) {
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Registers the system calls serviced by the dispatcher in the system call table.
+ *-----------------------------------------------------------------------------------
+ */
+static void register_syscalls(void) {
+    register_syscall(SYSCREATE, "create", &service_syscreate);
+    register_syscall(SYSYIELD, "yield", &yield);
+    register_syscall(SYSSTOP, "stop", &cleanup_current_process_and_next);
+    register_syscall(SYSGETPID, "getpid", &service_sysgetpid);
+    register_syscall(SYSPUTS, "puts", &service_sysputs);
+    register_syscall(SYSKILL, "kill", &service_syskill);
+    register_syscall(SYSSETPRIO, "setprio", &service_syssetprio);
+    register_syscall(SYSSEND, "send", &service_syssend);
+    register_syscall(SYSRECV, "recv", &service_sysrecv);
+    register_syscall(SYSSLEEP, "sleep", &service_syssleep);
+    register_syscall(SYSUSLEEP, "usleep", &service_sysusleep);
+    register_syscall(SYSSIGHANDLER, "sighandler", &service_syssighandler);
+    register_syscall(SYSSIGRETURN, "sigreturn", &service_syssigreturn);
+    register_syscall(SYSWAIT, "wait", &service_syswait);
+    register_syscall(SYSOPEN, "open", &service_sysopen);
+    register_syscall(SYSCLOSE, "close", &service_sysclose);
+    register_syscall(SYSWRITE, "write", &service_syswrite);
+    register_syscall(SYSREAD, "read", &service_sysread);
+    register_syscall(SYSIOCTL, "ioctl", &service_sysioctl);
+    register_syscall(SYSGETMEMSTATS, "getmemstats", &service_sysgetmemstats);
+    register_syscall(SYSALLOC, "alloc", &service_sysalloc);
+    register_syscall(SYSSETQUANTUM, "setquantum", &service_syssetquantum);
+    register_syscall(SYSSETREALTIME, "setrealtime", &service_syssetrealtime);
+    register_syscall(SYSSETTICKETS, "settickets", &service_syssettickets);
+    register_syscall(SYSCLOCK, "clock", &service_sysclock);
+    register_syscall(SYSSENDTIM, "sendtim", &service_syssendtim);
+    register_syscall(SYSRECVTIM, "recvtim", &service_sysrecvtim);
+    register_syscall(SYSTIMER, "timer", &service_systimer);
+    register_syscall(SYSTIMERCANCEL, "timercancel", &service_systimercancel);
+    register_syscall(SYSSETTIMERSLACK, "settimerslack", &service_syssettimerslack);
+    register_syscall(SYSSENDV, "sendv", &service_syssendv);
+    register_syscall(SYSRECVV, "recvv", &service_sysrecvv);
+    register_syscall(SYSRPC, "rpc", &service_sysrpc);
+    register_syscall(SYSREPLYWAIT, "replywait", &service_sysreplywait);
+    register_syscall(SYSPORTCREATE, "portcreate", &service_sysportcreate);
+    register_syscall(SYSPORTDESTROY, "portdestroy", &service_sysportdestroy);
+    register_syscall(SYSPORTSEND, "portsend", &service_sysportsend);
+    register_syscall(SYSPORTRECV, "portrecv", &service_sysportrecv);
+    register_syscall(SYSRECVSET, "recvset", &service_sysrecvset);
+    register_syscall(SYSSENDBATCH, "sendbatch", &service_syssendbatch);
+    register_syscall(SYSRECVBATCH, "recvbatch", &service_sysrecvbatch);
+    register_syscall(SYSSHMCREATE, "shmcreate", &service_sysshmcreate);
+    register_syscall(SYSSHMATTACH, "shmattach", &service_sysshmattach);
+    register_syscall(SYSSHMDETACH, "shmdetach", &service_sysshmdetach);
+    register_syscall(SYSFUTEXWAIT, "futexwait", &service_sysfutexwait);
+    register_syscall(SYSFUTEXWAKE, "futexwake", &service_sysfutexwake);
+    register_syscall(SYSPOLL, "poll", &service_syspoll);
+    register_syscall(SYSSIGPROCMASK, "sigprocmask", &service_syssigprocmask);
+    register_syscall(SYSSIGQUEUE, "sigqueue", &service_syssigqueue);
+    register_syscall(SYSAIOREAD, "aioread", &service_sysaioread);
+    register_syscall(SYSTRACECTL, "tracectl", &service_systracectl);
+    register_syscall(SYSTRACEREAD, "traceread", &service_systraceread);
+    register_syscall(SYSPROFSTART, "profstart", &service_sysprofstart);
+    register_syscall(SYSPROFSTOP, "profstop", &service_sysprofstop);
+    register_syscall(SYSPROFREAD, "profread", &service_sysprofread);
+    register_syscall(SYSLOGCTL, "logctl", &service_syslogctl);
+    register_syscall(SYSLOGREAD, "logread", &service_syslogread);
+    register_syscall(SYSGETIPCSTATS, "getipcstats", &service_sysgetipcstats);
+    register_syscall(SYSCREATETHREAD, "createthread", &service_syscreatethread);
+    register_syscall(SYSSPAWN, "spawn", &service_sysspawn);
+    register_syscall(SYSEXIT, "exit", &service_sysexit);
+    register_syscall(SYSWAITANY, "waitany", &service_syswaitany);
+    register_syscall(SYSSETPGID, "setpgid", &service_syssetpgid);
+    register_syscall(SYSGETPGID, "getpgid", &service_sysgetpgid);
+    register_syscall(SYSKILLPG, "killpg", &service_syskillpg);
+    register_syscall(SYSWAITPG, "waitpg", &service_syswaitpg);
+    register_syscall(SYSSETAFFINITY, "setaffinity", &service_syssetaffinity);
+    register_syscall(SYSGETAFFINITY, "getaffinity", &service_sysgetaffinity);
+    register_syscall(SYSRINGSETUP, "ringsetup", &service_sysringsetup);
+    register_syscall(SYSRINGENTER, "ringenter", &service_sysringenter);
+    register_syscall(SYSWAITWORK, "waitwork", &service_syswaitwork);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetpid request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetpid(void) {
+    current_proc->result_code = current_proc->pid;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a keyboard interrupt. Called by _KBDEntryPoint on the kernel stack with
+ * interrupts disabled, without saving the interrupted process into its PCB, so the
+ * interrupted process is resumed directly unless the dispatcher has to run.
+ *
+ * @return 1 if the interrupt made ready a process that should pre-empt the
+ *         interrupted process, in which case the dispatcher is entered with a
+ *         KEYBOARD_INT request, 0 to return to the interrupted process
+ *-----------------------------------------------------------------------------------
+ */
+int kbd_lower_half(void) {
+    kernel_lock();
+    cpu_t *cpu = this_cpu();
+    cpu->need_resched = 0;
+    kbd_isr();
+    end_of_intr();
+    int resched = cpu->need_resched;
+    kernel_unlock();
+    return resched;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a serial port interrupt. Called by _SerialEntryPoint the same way
+ * kbd_lower_half is called by _KBDEntryPoint.
+ *
+ * @return 1 if the interrupt made ready a process that should pre-empt the
+ *         interrupted process, in which case the dispatcher is entered with a
+ *         SERIAL_INT request, 0 to return to the interrupted process
+ *-----------------------------------------------------------------------------------
+ */
+int serial_lower_half(void) {
+    kernel_lock();
+    cpu_t *cpu = this_cpu();
+    cpu->need_resched = 0;
+    serial_isr();
+    end_of_intr();
+    int resched = cpu->need_resched;
+    kernel_unlock();
+    return resched;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a disk interrupt. Called by _ATAEntryPoint the same way kbd_lower_half is
+ * called by _KBDEntryPoint.
+ *
+ * @return 1 if the interrupt made ready a process that should pre-empt the
+ *         interrupted process, in which case the dispatcher is entered with an
+ *         ATA_INT request, 0 to return to the interrupted process
+ *-----------------------------------------------------------------------------------
+ */
+int ata_lower_half(void) {
+    kernel_lock();
+    cpu_t *cpu = this_cpu();
+    cpu->need_resched = 0;
+    ata_isr();
+    end_of_intr();
+    int resched = cpu->need_resched;
+    kernel_unlock();
+    return resched;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Records the switch away from the given process, which was last switched into, once
+ * the dispatcher has settled on the process to run next. Nothing is recorded if the
+ * process runs again. A process that left blocked starts counting the time it is
+ * blocked from when it was switched out, until ready takes it off its blocked queue.
+ *
+ * @param proc         The process that was switched out
+ * @param voluntary    1 if it left through a system call, 0 if by an interrupt
+ * @param switched_out The time stamp at which it was switched out
+ *-----------------------------------------------------------------------------------
+ */
+static void account_switch(pcb_t *proc, int voluntary, unsigned long long switched_out) {
+    if (proc == current_proc) {
+        return;
+    }
+    if (voluntary) {
+        proc->voluntary_switches++;
+    } else {
+        proc->involuntary_switches++;
+    }
+    if (proc->state == BLOCKED && proc->blocked_since == 0) {
+        proc->blocked_since = switched_out;
+        proc->blocked_as = proc->blocked_queue;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a system call made through the preemptible system call interrupt. Runs
+ * on the stack of the calling process with interrupts enabled, and returns straight
+ * to it, in steps that each take the kernel lock, see the notes at the start of the
+ * file.
+ *
+ * @param call The system request identifier, passed in %eax
+ * @param arg  The argument of the system call, passed in %edx
+ * @return     The result of the call, or -1 if it cannot be serviced this way
+ *-----------------------------------------------------------------------------------
+ */
+int preemptible_dispatch(int call, int arg) {
+    switch (call) {
+        case (SYSGETCPUTIMES): {
+            unsigned long eflags = begin_step();
+            current_proc->syscalls++;
+            end_step(eflags);
+            return get_cpu_times((processStatuses *) arg);
+        }
+        case (SYSREAD):
+        case (SYSWRITE):
+            return io_steps((preempt_args_t *) arg, call == SYSWRITE);
+        case (SYSSENDV):
+        case (SYSRECVV):
+            return message_steps((preempt_args_t *) arg, call == SYSSENDV);
+        case (SYSRUNWORK): {
+            // An item per step, so an interrupt waits for one item at most
+            int count = 0;
+            int ran = 1;
+            while (ran && count < WORK_BUDGET) {
+                unsigned long eflags = begin_step();
+                if (count == 0) current_proc->syscalls++;
+                ran = run_next_work();
+                end_step(eflags);
+                count += ran;
+            }
+            return count;
+        }
+        default:
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysread or syswrite on the preemptible path, a block per step, for a
+ * device with a step, such as the RAM disk and the ATA disk, which move bytes
+ * between the process and the buffer cache. What a step cannot move without
+ * blocking is left to the dispatcher, as is a call to any other device.
+ *
+ * @param req   The file descriptor, buffer and length of the call, with the number
+ *              of bytes the steps moved left in done
+ * @param write 1 for syswrite, 0 for sysread
+ * @return      The result of the call, or PREEMPT_DISPATCH if the dispatcher is to
+ *              service the rest of it
+ *-----------------------------------------------------------------------------------
+ */
+static int io_steps(preempt_args_t *req, int write) {
+    unsigned long eflags = begin_step();
+    int valid = check_range(req, sizeof(preempt_args_t), 1) == RANGE_OK;
+    end_step(eflags);
+    if (!valid) {
+        return -1;
+    }
+    int fd = req->arg[0];
+    char *buf = (char *) req->arg[1];
+    int buflen = req->arg[2];
+    req->done = 0;
+    for (;;) {
+        eflags = begin_step();
+        int result = di_step(current_proc, fd, buf + req->done, buflen - req->done, write);
+        if (result > 0) {
+            req->done += result;
+        }
+        int left = result == BLOCKERR || result == PREEMPT_DISPATCH;
+        int finished = !left && (result <= 0 || req->done == buflen);
+        if (finished) current_proc->syscalls++;
+        end_step(eflags);
+        if (left) {
+            return PREEMPT_DISPATCH;
+        }
+        if (finished) {
+            return req->done > 0 ? req->done : result;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssendv or sysrecvv on the preemptible path if the process at the
+ * other end already waits for the message, which is then copied a step at a time,
+ * see msg.c. A call that would block, and any error, is left to the dispatcher.
+ *
+ * @param req     The PID or the address of the PID, the buffer and the length of
+ *                the call
+ * @param sending 1 for syssendv, 0 for sysrecvv
+ * @return        The number of bytes delivered, or PREEMPT_DISPATCH if the
+ *                dispatcher is to service the call
+ *-----------------------------------------------------------------------------------
+ */
+static int message_steps(preempt_args_t *req, int sending) {
+    unsigned long eflags = begin_step();
+    pcb_t *proc = current_proc;
+    pcb_t *peer = NULL;
+    if (check_range(req, sizeof(preempt_args_t), 1) != RANGE_OK) {
+        end_step(eflags);
+        return -1;
+    }
+    void *buf = (void *) req->arg[1];
+    unsigned int len = (unsigned int) req->arg[2];
+    if (len <= MAX_MESSAGE_SIZE && check_range(buf, len, 0) == RANGE_OK) {
+        proc->ipc_buf = buf;
+        proc->ipc_len = len;
+        proc->ipc_vectored = 1;
+        proc->ipc_reply_buf = NULL;
+        if (sending) {
+            unsigned int dest_pid = (unsigned int) req->arg[0];
+            pcb_t *recv_proc = get_pcb(dest_pid);
+            if (dest_pid != proc->pid && recv_proc != NULL) {
+                peer = claim_peer(proc, recv_proc, 1);
+            }
+        } else {
+            unsigned int *from_pid = (unsigned int *) req->arg[0];
+            if (check_range(from_pid, BUFFER_SIZE, 0) == RANGE_OK && *from_pid != proc->pid) {
+                // A PID of 0 receives from any process
+                pcb_t *send_proc = *from_pid == 0 ? NULL : get_pcb(*from_pid);
+                proc->ipc_from_pid = from_pid;
+                proc->cold->ipc_recv_set_size = 0;
+                if (*from_pid == 0 || send_proc != NULL) {
+                    peer = claim_peer(proc, send_proc, 0);
+                }
+            }
+        }
+    }
+    end_step(eflags);
+    if (peer == NULL) {
+        return PREEMPT_DISPATCH;
+    }
+
+    // The claimed process waits while its message is copied
+    unsigned int copied = 0;
+    int result = 0;
+    while (result == 0) {
+        eflags = begin_step();
+        result = copy_message_step(proc, sending, &copied);
+        if (result == 1) proc->syscalls++;
+        end_step(eflags);
+    }
+    return result == 1 ? (int) copied : PREEMPT_DISPATCH;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Begins a step of a system call serviced by preemptible_dispatch, by disabling
+ * interrupts and taking the kernel lock.
+ *
+ * @return The flags to pass to end_step
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long begin_step(void) {
+    unsigned long eflags;
+    __asm__ volatile("pushfl; popl %0; cli;" : "=r" (eflags) : : "memory");
+    kernel_lock();
+    return eflags;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Ends a step begun by begin_step, releasing the kernel lock and enabling interrupts
+ * again if they were enabled before the step, so any that came during it are taken.
+ *-----------------------------------------------------------------------------------
+ */
+static void end_step(unsigned long eflags) {
+    kernel_unlock();
+    __asm__ volatile("pushl %0; popfl;" : : "r" (eflags) : "memory", "cc");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a system call made through the fast system call interrupt. Runs on the
+ * stack of the calling process with interrupts disabled by
+ * _FastSysCallEntryPoint, so the process stays current on this processor for the
+ * whole call and only its own PCB is touched, without the kernel lock. Returns
+ * straight to it without entering the dispatcher, so only calls that neither
+ * block nor reschedule may be serviced here. Pending signals are delivered on the
+ * next entry into the dispatcher instead.
+ *
+ * @param call The system request identifier, passed in %eax
+ * @param arg  The argument of the system call, passed in %edx
+ * @return     The result of the call, or -1 if it cannot be serviced on the fast path
+ *-----------------------------------------------------------------------------------
+ */
+int fast_dispatch(int call, int arg) {
+    switch (call) {
+        case (SYSGETPID):
+            current_proc->syscalls++;
+            return current_proc->pid;
+        case (SYSSETPRIO):
+            // Only querying the priority is a fast call, setting it may reschedule
+            if (arg != -1) return -1;
+            current_proc->syscalls++;
+            return current_proc->priority;
+        default:
+            return -1;
+    }
+}
+
 /*-----------------------------------------------------------------------------------
  * Places the current process at the end of the ready queue for its
  * priority and selects the next available process.
@@ -249,23 +962,76 @@ static void service_syscreate(void) {
 
     int create_result_code = create(func, stack);
     if (create_result_code == 1) {
-        // Get PID of newly created process by peeking at the end of the ready queue for its priority
-        pcb_t *created_proc = peek_tail(&ready_queues[INIT_PRIORITY]);
-        current_proc->result_code = created_proc->pid;
+        // The newly created process got the PCB get_unused_pcb returned last, it
+        // is not necessarily at the end of a ready queue under the stride scheduler
+        current_proc->result_code = newest_pcb->pid;
+    } else {
+        current_proc->result_code = -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syscreatethread request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syscreatethread(void) {
+    void (*func)(void) = (void *) args[0];
+    int stack = args[1];
+
+    if (create_thread(current_proc, func, stack)) {
+        current_proc->result_code = newest_pcb->pid;
+    } else {
+        current_proc->result_code = -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysspawn request. The attributes are checked and copied before the
+ * process is created, without attributes the process is created as by syscreate
+ * with a stack of PROCESS_STACK_SIZE.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysspawn(void) {
+    void (*func)(void *arg) = (void *) args[0];
+    void *block = (void *) args[1];
+    int block_len = args[2];
+    spawn_attr_t *given_attr = (spawn_attr_t *) args[3];
+
+    spawn_attr_t attr = {PROCESS_STACK_SIZE, -1, 0};
+    if (block_len < 0 || block_len > SPAWN_MAX_ARGS
+            || (block_len > 0 && check_range(block, block_len, 1) != RANGE_OK)) {
+        current_proc->result_code = -2;
+        return;
+    }
+    if (given_attr != NULL) {
+        if (check_range(given_attr, sizeof(*given_attr), 1) != RANGE_OK) {
+            current_proc->result_code = -3;
+            return;
+        }
+        attr = *given_attr;
+        if (attr.priority < -1 || attr.priority >= NUM_PRIORITIES || (attr.flags & ~SPAWN_INHERIT_FDS)) {
+            current_proc->result_code = -3;
+            return;
+        }
+    }
+
+    if (spawn(current_proc, func, block, block_len, &attr)) {
+        current_proc->result_code = newest_pcb->pid;
     } else {
         current_proc->result_code = -1;
     }
 }
 
 /*-----------------------------------------------------------------------------------
- * Services a sysputs request. Since the kernel cannot be pre-empted, the
- * kernel side of sysputs can use kprintf to print the string
+ * Services a sysputs request. The string is copied into the output buffer of the
+ * console, which is written to the display on the next tick, so printing costs the
+ * dispatcher one copy
  *-----------------------------------------------------------------------------------
  */
 static void service_sysputs(void) {
     char *str = (char *) args[0];
-    if (valid_ptr(str)) {
-        kprintf(str);
+    if (check_range(str, 1, 1) == RANGE_OK) {
+        console_write(str, strlen_words(str));
     }
 }
 
@@ -281,6 +1047,47 @@ static void service_syskill(void) {
     current_proc->result_code = signal(proc_to_signal, signal_number);
 }
 
+/*-----------------------------------------------------------------------------------
+ * Services a syssigqueue request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssigqueue(void) {
+    int pid = args[0];
+    int signal_number = args[1];
+    int value = args[2];
+
+    pcb_t *proc_to_signal = get_pcb(pid);
+    current_proc->result_code = queue_signal(proc_to_signal, signal_number, current_proc->pid, value);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a systimer request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_systimer(void) {
+    int pid = args[0];
+    int signal_number = args[1];
+    unsigned int milliseconds = (unsigned int) args[2];
+    unsigned int period = (unsigned int) args[3];
+
+    pcb_t *target = get_pcb(pid);
+    if (target == NULL) {
+        current_proc->result_code = -514;
+    } else if (signal_number < 0 || signal_number >= SIGNAL_TABLE_SIZE) {
+        current_proc->result_code = -583;
+    } else {
+        current_proc->result_code = arm_timer(current_proc, target, signal_number, milliseconds, period);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a systimercancel request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_systimercancel(void) {
+    current_proc->result_code = cancel_timer(current_proc, (int) args[0]);
+}
+
 /*-----------------------------------------------------------------------------------
  * Services a syssetprio request.
  *-----------------------------------------------------------------------------------
@@ -288,9 +1095,11 @@ static void service_syskill(void) {
 static void service_syssetprio(void) {
     int current_priority = current_proc->priority;
     int req_priority = args[0];
-    int valid_req_priority = req_priority >= 0 && req_priority <= 3;
+    int valid_req_priority = req_priority >= 0 && req_priority < NUM_PRIORITIES;
     if (valid_req_priority) {
         current_proc->priority = req_priority;
+        current_proc->base_priority = req_priority;
+        current_proc->quanta_used = 0;
     }
     if (valid_req_priority || req_priority == -1) {
         current_proc->result_code = current_priority;
@@ -304,9 +1113,40 @@ static void service_syssetprio(void) {
  *-----------------------------------------------------------------------------------
  */
 static void service_syssend(void) {
-    current_proc->ipc_args = args;
+    service_send(&args[1], BUFFER_SIZE, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssendv request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssendv(void) {
+    void *buf = (void *) args[1];
+    unsigned int len = (unsigned int) args[2];
+    if (len > MAX_MESSAGE_SIZE || check_range(buf, len, 0) != RANGE_OK) {
+        // The message is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    service_send(buf, len, 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a send request of the current process, whose destination PID is the
+ * first argument of the call.
+ *
+ * @param buf      The message, validated by the caller
+ * @param len      The length of the message in bytes
+ * @param vectored 1 if the call returns the number of bytes delivered, 0 if it
+ *                 returns 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+static void service_send(void *buf, unsigned int len, int vectored) {
+    current_proc->ipc_buf = buf;
+    current_proc->ipc_len = len;
+    current_proc->ipc_vectored = vectored;
+    current_proc->ipc_reply_buf = NULL;
     unsigned int dest_pid = (unsigned int) args[0];
-    unsigned long num = (unsigned long) args[1];
 
     int send_result_code = NULL;
     if (current_proc->pid == dest_pid) {
@@ -318,16 +1158,21 @@ static void service_syssend(void) {
             // The receiving process does not exist
             send_result_code = -2;
         } else {
-            send_result_code = send(current_proc, receiving_proc, &num);
+            send_result_code = send(current_proc, receiving_proc);
         }
     }
 
-    current_proc->result_code = send_result_code;
-
     if (send_result_code == -1) {
         // The sending process was blocked
+        current_proc->result_code = send_result_code;
         // Select the next available process to run
         current_proc = next();
+    } else if (send_result_code >= 0) {
+        current_proc->result_code = vectored ? send_result_code : 0;
+        // The receiving process was unblocked, switch to it directly
+        handoff(get_pcb(dest_pid));
+    } else {
+        current_proc->result_code = send_result_code;
     }
 }
 
@@ -336,15 +1181,48 @@ static void service_syssend(void) {
  *-----------------------------------------------------------------------------------
  */
 static void service_sysrecv(void) {
-    current_proc->ipc_args = args;
-    unsigned int *from_pid = (unsigned int *) args[0];
     unsigned int *num = (unsigned int *) args[1];
+    service_recv(num, BUFFER_SIZE, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysrecvv request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysrecvv(void) {
+    void *buf = (void *) args[1];
+    unsigned int len = (unsigned int) args[2];
+    if (len > MAX_MESSAGE_SIZE) {
+        // The buffer is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    service_recv(buf, len, 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a receive request of the current process, whose first argument is the
+ * address of the PID of the sending process.
+ *
+ * @param buf      The buffer to receive into
+ * @param len      The length of the buffer in bytes
+ * @param vectored 1 if the call returns the number of bytes received, 0 if it
+ *                 returns 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+static void service_recv(void *buf, unsigned int len, int vectored) {
+    unsigned int *from_pid = (unsigned int *) args[0];
+    current_proc->ipc_buf = buf;
+    current_proc->ipc_len = len;
+    current_proc->ipc_vectored = vectored;
+    current_proc->ipc_from_pid = from_pid;
+    current_proc->cold->ipc_recv_set_size = 0;
 
     int recv_result_code = NULL;
-    if (!valid_buf(from_pid, BUFFER_SIZE)) {
+    if (check_range(from_pid, BUFFER_SIZE, 0) != RANGE_OK) {
         recv_result_code = -5;
-    } else if (!valid_buf(num, BUFFER_SIZE)) {
-        // The address of num is invalid
+    } else if (check_range(buf, len, 0) != RANGE_OK) {
+        // The address of the buffer is invalid
         recv_result_code = -4;
     } else {
         unsigned int sender_pid = *from_pid;
@@ -353,7 +1231,7 @@ static void service_sysrecv(void) {
             if (only_process()) {
                 recv_result_code = -10;
             } else {
-                recv_result_code = recv(current_proc, NULL, from_pid, num);
+                recv_result_code = recv(current_proc, NULL, from_pid);
             }
         } else {
             // pid specifies the PID of the sending process
@@ -366,42 +1244,650 @@ static void service_sysrecv(void) {
                     // The sending process does not exist
                     recv_result_code = -2;
                 } else {
-                    recv_result_code = recv(current_proc, sending_proc, from_pid, num);
+                    recv_result_code = recv(current_proc, sending_proc, from_pid);
                 }
             }
         }
     }
-    current_proc->result_code = recv_result_code;
-    if (recv_result_code == -1) {
-        // The receiving process was blocked
-        // Select the next available process to run
-        current_proc = next();
-    }
+    finish_recv(recv_result_code, vectored);
 }
 
 /*-----------------------------------------------------------------------------------
- * Services a syssleep request.
+ * Completes a receive request of the current process with the result of recv.
+ *
+ * @param recv_result_code The result of recv, or a negative error code
+ * @param vectored         1 if the call returns the number of bytes received, 0 if
+ *                         it returns 0 on success
  *-----------------------------------------------------------------------------------
  */
-static void service_syssleep(void) {
-    unsigned int milliseconds = args[0];
-    if (milliseconds > 0) {
-        sleep(current_proc, milliseconds);
+static void finish_recv(int recv_result_code, int vectored) {
+    unsigned int *from_pid = current_proc->ipc_from_pid;
+    if (recv_result_code == -1) {
+        // The receiving process was blocked
+        current_proc->result_code = recv_result_code;
         // Select the next available process to run
         current_proc = next();
+    } else if (recv_result_code >= 0) {
+        current_proc->result_code = vectored ? recv_result_code : 0;
+        // The sending process was unblocked, switch to it directly
+        handoff(get_pcb(*from_pid));
+    } else {
+        current_proc->result_code = recv_result_code;
     }
 }
 
 /*-----------------------------------------------------------------------------------
- * Services a sysgetcputimes request.
+ * Services a sysrecvset request. Receives as a sysrecv from any process would, but
+ * only from the processes in the given set of PIDs. The PIDs of processes that do
+ * not exist are left out of the set.
  *-----------------------------------------------------------------------------------
  */
-static void service_sysgetcputimes(void) {
-    processStatuses *ps = (processStatuses *) args[0];
-    int result_code = get_cpu_times(ps);
-    current_proc->result_code = result_code;
-}
-
+static void service_sysrecvset(void) {
+    unsigned int *from_pid = (unsigned int *) args[0];
+    unsigned int *num = (unsigned int *) args[1];
+    unsigned int *pids = (unsigned int *) args[2];
+    int count = (int) args[3];
+    current_proc->ipc_buf = num;
+    current_proc->ipc_len = BUFFER_SIZE;
+    current_proc->ipc_vectored = 0;
+    current_proc->ipc_from_pid = from_pid;
+    current_proc->cold->ipc_recv_set_size = 0;
+
+    int recv_result_code = NULL;
+    if (check_range(from_pid, BUFFER_SIZE, 0) != RANGE_OK) {
+        recv_result_code = -5;
+    } else if (check_range(num, BUFFER_SIZE, 0) != RANGE_OK) {
+        // The address of num is invalid
+        recv_result_code = -4;
+    } else if (count < 1 || count > MAX_RECV_SET || check_range(pids, count * sizeof(unsigned int), 0) != RANGE_OK) {
+        // The set is invalid
+        recv_result_code = -6;
+    } else {
+        for (int i = 0; i < count && recv_result_code == NULL; i++) {
+            if (pids[i] == current_proc->pid) {
+                // The receiving process is trying to receive from itself
+                recv_result_code = -3;
+            } else if (get_pcb(pids[i]) != NULL) {
+                current_proc->cold->ipc_recv_set[current_proc->cold->ipc_recv_set_size++] = pids[i];
+            }
+        }
+        if (recv_result_code == NULL) {
+            if (current_proc->cold->ipc_recv_set_size == 0) {
+                // None of the sending processes exist
+                recv_result_code = -2;
+            } else {
+                recv_result_code = recv(current_proc, NULL, from_pid);
+                if (recv_result_code == -1) {
+                    recv_set_waiters++;
+                }
+            }
+        }
+    }
+    finish_recv(recv_result_code, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssendbatch request. Sends the messages in order, each as a syssend
+ * would, without switching to the receiving processes. The results of the messages
+ * are set to BATCH_PENDING first, and the result of each message is stored as it
+ * is handled. If the receiving process of a message is not waiting for it, the
+ * sending process blocks on it and the result of the call is the result of that
+ * send, the messages after it are left for the next call.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssendbatch(void) {
+    send_batch_entry_t *msgs = (send_batch_entry_t *) args[0];
+    int count = (int) args[1];
+    if (count < 1 || count > MAX_BATCH || check_range(msgs, count * sizeof(send_batch_entry_t), 0) != RANGE_OK) {
+        // The batch is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        msgs[i].result = BATCH_PENDING;
+    }
+    current_proc->ipc_len = BUFFER_SIZE;
+    current_proc->ipc_vectored = 0;
+    current_proc->ipc_reply_buf = NULL;
+
+    for (int i = 0; i < count; i++) {
+        send_batch_entry_t *msg = &msgs[i];
+        pcb_t *receiving_proc = get_pcb(msg->dest_pid);
+        current_proc->ipc_buf = &msg->num;
+        if (msg->dest_pid == current_proc->pid) {
+            // The sending process is trying to send to itself
+            msg->result = -3;
+        } else if (receiving_proc == NULL) {
+            // The receiving process does not exist
+            msg->result = -2;
+        } else if (send(current_proc, receiving_proc) == -1) {
+            // The sending process was blocked, the result is that of this send
+            current_proc->result_code = -1;
+            current_proc = next();
+            return;
+        } else {
+            msg->result = 0;
+        }
+    }
+    current_proc->result_code = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysrecvbatch request. Receives the messages of up to the given number
+ * of processes waiting to send to the current process, earliest first, without
+ * switching to them. If no process is waiting, the current process waits for the
+ * first message as a receive from any process would, and the call returns 0.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysrecvbatch(void) {
+    recv_batch_entry_t *msgs = (recv_batch_entry_t *) args[0];
+    int count = (int) args[1];
+    if (count < 1 || count > MAX_BATCH || check_range(msgs, count * sizeof(recv_batch_entry_t), 0) != RANGE_OK) {
+        // The batch is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    current_proc->ipc_len = BUFFER_SIZE;
+    current_proc->ipc_vectored = 0;
+    current_proc->cold->ipc_recv_set_size = 0;
+
+    int received = 0;
+    while (received < count && !is_empty(&current_proc->cold->blocked_queues[SENDER])) {
+        recv_batch_entry_t *msg = &msgs[received++];
+        current_proc->ipc_buf = &msg->num;
+        current_proc->ipc_from_pid = &msg->from_pid;
+        recv(current_proc, NULL, &msg->from_pid);
+    }
+    if (received > 0) {
+        current_proc->result_code = received;
+        return;
+    }
+
+    if (only_process()) {
+        // The receiving process is the only user process
+        current_proc->result_code = -10;
+        return;
+    }
+    // No process is waiting to send, wait for the first message
+    current_proc->ipc_buf = &msgs[0].num;
+    current_proc->ipc_from_pid = &msgs[0].from_pid;
+    recv(current_proc, NULL, &msgs[0].from_pid);
+    current_proc->result_code = -1;
+    current_proc = next();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysringsetup request. Checks the rings and keeps where their entries
+ * are, and empties both rings. A NULL ring removes the rings of the process.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysringsetup(void) {
+    io_ring_t *ring = (io_ring_t *) args[0];
+    pcb_cold_t *cold = current_proc->cold;
+    if (ring == NULL) {
+        cold->ring = NULL;
+        current_proc->result_code = 0;
+        return;
+    }
+    if (check_range(ring, sizeof(io_ring_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    unsigned int entries = ring->entries;
+    if (entries == 0 || entries > IORING_MAX_ENTRIES || (entries & (entries - 1)) != 0) {
+        current_proc->result_code = -2;
+        return;
+    }
+    if (check_range(ring->sqes, entries * sizeof(io_sqe_t), 0) != RANGE_OK
+        || check_range(ring->cqes, entries * sizeof(io_cqe_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    ring->sq_head = 0;
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->cq_tail = 0;
+    cold->ring = ring;
+    cold->ring_sqes = ring->sqes;
+    cold->ring_cqes = ring->cqes;
+    cold->ring_mask = entries - 1;
+    current_proc->result_code = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysringenter request. Takes the submissions queued when the call was
+ * made, as long as the completion ring has room, and posts the completion of each.
+ * If an operation blocks the process, its completion is left for sysringenter to
+ * post once the process wakes up, and the number of entries taken is stored where
+ * the second argument points. Entries queued during the call are left for the next.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysringenter(void) {
+    io_ring_t *ring = (io_ring_t *) args[0];
+    int *taken = (int *) args[1];
+    pcb_cold_t *cold = current_proc->cold;
+    if (ring == NULL || ring != cold->ring || check_range(taken, sizeof(*taken), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    unsigned int entries = cold->ring_mask + 1;
+    unsigned int queued = ring->sq_tail - ring->sq_head;
+    if (queued > entries || ring->cq_tail - ring->cq_head > entries) {
+        // The process has moved an index past the other end of its ring
+        current_proc->result_code = -2;
+        return;
+    }
+
+    int count = 0;
+    while (count < (int) queued && ring->cq_tail - ring->cq_head < entries) {
+        io_sqe_t *sqe = &cold->ring_sqes[ring->sq_head & cold->ring_mask];
+        io_cqe_t *cqe = &cold->ring_cqes[ring->cq_tail & cold->ring_mask];
+        ring->sq_head++;
+        count++;
+        cqe->user_data = sqe->user_data;
+        int result = run_ring_entry(sqe);
+        if (current_proc->state == BLOCKED) {
+            *taken = count;
+            current_proc = next();
+            return;
+        }
+        cqe->result = result;
+        ring->cq_tail++;
+    }
+    current_proc->result_code = count;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Carries out the given operation of a submission ring for the current process, as
+ * the system call of the same name would, and blocks the process if it has to wait.
+ *
+ * @param sqe The operation
+ * @return    The result of the operation, -1 if the operation is unknown, not used
+ *            if the process was blocked
+ *-----------------------------------------------------------------------------------
+ */
+static int run_ring_entry(io_sqe_t *sqe) {
+    int result;
+    switch (sqe->opcode) {
+        case IORING_OP_NOP:
+            return 0;
+        case IORING_OP_READ:
+            result = di_read(current_proc, sqe->fd, sqe->buf, sqe->len);
+            // See service_sysread, a pipe has already blocked the process
+            if (result == -2 && current_proc->state != BLOCKED) {
+                current_proc->state = BLOCKED;
+                current_proc->blocked_queue = READ;
+            }
+            return result;
+        case IORING_OP_WRITE:
+            return di_write(current_proc, sqe->fd, sqe->buf, sqe->len);
+        case IORING_OP_SEND:
+            return ring_send(sqe);
+        case IORING_OP_SLEEP:
+            if (sqe->len > 0) {
+                sleep(current_proc, sqe->len);
+            }
+            return 0;
+        case IORING_OP_OPEN:
+            return di_open(current_proc, sqe->fd);
+        case IORING_OP_CLOSE:
+            return di_close(current_proc, sqe->fd);
+        default:
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sends the message of the given operation of a submission ring as a syssendv
+ * would, without switching to the receiving process.
+ *
+ * @param sqe The operation, whose fd is the PID of the receiving process
+ * @return    The number of bytes delivered, -1 if the current process was blocked
+ *            or the errors of syssendv
+ *-----------------------------------------------------------------------------------
+ */
+static int ring_send(io_sqe_t *sqe) {
+    unsigned int len = (unsigned int) sqe->len;
+    if (len > MAX_MESSAGE_SIZE || check_range(sqe->buf, len, 0) != RANGE_OK) {
+        // The message is invalid
+        return -4;
+    }
+    if (sqe->fd == current_proc->pid) {
+        // The sending process is trying to send to itself
+        return -3;
+    }
+    pcb_t *receiving_proc = get_pcb(sqe->fd);
+    if (receiving_proc == NULL) {
+        // The receiving process does not exist
+        return -2;
+    }
+    current_proc->ipc_buf = sqe->buf;
+    current_proc->ipc_len = len;
+    current_proc->ipc_vectored = 1;
+    current_proc->ipc_reply_buf = NULL;
+    return send(current_proc, receiving_proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysrpc request. Sends the request as a syssend would, and has the
+ * calling process wait for the reply from the same process. If the server was
+ * waiting for a request, it runs next for the rest of the quantum of the caller.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysrpc(void) {
+    unsigned int dest_pid = (unsigned int) args[0];
+    unsigned long *reply = (unsigned long *) args[2];
+    if (check_range(reply, BUFFER_SIZE, 0) != RANGE_OK) {
+        // The address of the reply is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    if (current_proc->pid == dest_pid) {
+        // The calling process is trying to call itself
+        current_proc->result_code = -3;
+        return;
+    }
+    pcb_t *server = get_pcb(dest_pid);
+    if (server == NULL) {
+        // The server does not exist
+        current_proc->result_code = -2;
+        return;
+    }
+
+    current_proc->ipc_buf = &args[1];
+    current_proc->ipc_len = BUFFER_SIZE;
+    current_proc->ipc_vectored = 0;
+    current_proc->ipc_reply_buf = reply;
+    // The PID of the replying process is the one already in the first argument
+    current_proc->ipc_from_pid = (unsigned int *) &args[0];
+    current_proc->result_code = 0;
+    if (send(current_proc, server) == -1) {
+        // The server is not waiting for a request, once it receives the request the
+        // caller is moved to the queue of receivers of the server
+        current_proc = next();
+        return;
+    }
+    // The server has the request and is ready, wait for the reply
+    start_reply_wait(current_proc);
+    enqueue_blocked_queue(current_proc, server, RECEIVER);
+    run_peer(server, current_proc->quantum_left);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysreplywait request. Replies to the client, if it is still waiting
+ * for the reply, then receives the next request from any process. If the server
+ * has to wait for a request, the client runs next for the rest of the quantum of
+ * the server.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysreplywait(void) {
+    unsigned int *client_pid = (unsigned int *) args[0];
+    unsigned long *request = (unsigned long *) args[2];
+    if (check_range(client_pid, BUFFER_SIZE, 0) != RANGE_OK) {
+        current_proc->result_code = -5;
+        return;
+    }
+    if (check_range(request, BUFFER_SIZE, 0) != RANGE_OK) {
+        // The address of the request is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+
+    pcb_t *client = *client_pid != 0 ? get_pcb(*client_pid) : NULL;
+    if (client != NULL && client->state == BLOCKED && client->blocked_on == current_proc && client->blocked_queue == RECEIVER) {
+        current_proc->ipc_buf = &args[1];
+        current_proc->ipc_len = BUFFER_SIZE;
+        current_proc->ipc_vectored = 0;
+        current_proc->ipc_reply_buf = NULL;
+        // The client is waiting for the reply, so the send completes at once
+        send(current_proc, client);
+    } else {
+        // The client is gone or was unblocked by a signal, drop the reply
+        client = NULL;
+    }
+
+    // Receive the next request from any process
+    *client_pid = 0;
+    current_proc->ipc_buf = request;
+    current_proc->ipc_len = BUFFER_SIZE;
+    current_proc->ipc_vectored = 0;
+    current_proc->ipc_from_pid = client_pid;
+    current_proc->cold->ipc_recv_set_size = 0;
+    current_proc->result_code = 0;
+    if (only_process()) {
+        // The server is the only user process
+        current_proc->result_code = -10;
+        return;
+    }
+    if (recv(current_proc, NULL, client_pid) == -1) {
+        // The server waits for a request
+        current_proc->result_code = -1;
+        if (client != NULL) {
+            run_peer(client, current_proc->quantum_left);
+        } else {
+            current_proc = next();
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysportcreate request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysportcreate(void) {
+    current_proc->result_code = port_create(current_proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysportdestroy request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysportdestroy(void) {
+    current_proc->result_code = port_destroy(current_proc, (int) args[0]);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysportsend request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysportsend(void) {
+    int port_id = (int) args[0];
+    current_proc->result_code = port_send(current_proc, port_id, &args[1]);
+    if (current_proc->result_code == -1) {
+        // The port is full, select the next available process to run
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysportrecv request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysportrecv(void) {
+    int port_id = (int) args[0];
+    unsigned long *num = (unsigned long *) args[1];
+    if (check_range(num, BUFFER_SIZE, 0) != RANGE_OK) {
+        // The address of num is invalid
+        current_proc->result_code = -4;
+        return;
+    }
+    current_proc->result_code = port_recv(current_proc, port_id, num);
+    if (current_proc->result_code == -1) {
+        // The port is empty, select the next available process to run
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysshmcreate request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysshmcreate(void) {
+    size_t size = (size_t) args[0];
+    current_proc->result_code = shm_create(current_proc, size);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysshmattach request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysshmattach(void) {
+    int shm_id = (int) args[0];
+    current_proc->result_code = (int) shm_attach(current_proc, shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysshmdetach request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysshmdetach(void) {
+    int shm_id = (int) args[0];
+    current_proc->result_code = shm_detach(current_proc, shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysfutexwait request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysfutexwait(void) {
+    int *addr = (int *) args[0];
+    int expected = (int) args[1];
+    if (!valid_futex(addr)) {
+        current_proc->result_code = -4;
+        return;
+    }
+    current_proc->result_code = futex_wait(current_proc, addr, expected);
+    if (current_proc->result_code == -1) {
+        // The process waits for a wake, select the next available process to run
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysfutexwake request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysfutexwake(void) {
+    int *addr = (int *) args[0];
+    int count = (int) args[1];
+    if (!valid_futex(addr)) {
+        current_proc->result_code = -4;
+        return;
+    }
+    current_proc->result_code = count > 0 ? futex_wake(addr, count) : 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given address of a futex is aligned and outside the kernel, 0
+ * otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int valid_futex(int *addr) {
+    return (unsigned long) addr % sizeof(int) == 0 && check_range(addr, sizeof(int), 0) == RANGE_OK;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syswaitwork request, made by the work process of workq.c.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syswaitwork(void) {
+    current_proc->result_code = wait_for_work(current_proc);
+    if (current_proc->result_code == -1) {
+        // The process waits for work to be queued, select the next available process
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syspoll request. Returns the sources that are ready at once, and
+ * otherwise blocks the process until one is or the timeout expires.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syspoll(void) {
+    unsigned int mask = (unsigned int) args[0];
+    int milliseconds = (int) args[1];
+    if (!valid_poll_mask(current_proc, mask)) {
+        current_proc->result_code = -1;
+        return;
+    }
+    unsigned int ready_mask = poll_ready(current_proc, mask);
+    if (ready_mask != 0 || milliseconds == 0) {
+        current_proc->result_code = ready_mask;
+    } else {
+        poll_block(current_proc, mask, milliseconds);
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given syspoll mask has no bits above POLL_IPC and only bits of
+ * file descriptors the given process has open below it, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int valid_poll_mask(pcb_t *proc, unsigned int mask) {
+    if (mask & ~(POLL_IPC | (POLL_IPC - 1))) {
+        return 0;
+    }
+    // Each bit below POLL_IPC must be an open file descriptor
+    unsigned int open_fds = ~proc->owner->cold->free_fds & ((1 << proc->owner->cold->fd_table_size) - 1);
+    return (mask & (POLL_IPC - 1) & ~open_fds) == 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssendtim request. Services the send as a syssend, and if the
+ * sending process was blocked, also places it on the timing wheel so the send
+ * fails with TIMEOUT if no matching receive is performed in time.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssendtim(void) {
+    pcb_t *proc = current_proc;
+    unsigned int timeout = (unsigned int) args[2];
+    service_syssend();
+    if (proc->state == BLOCKED) {
+        set_timeout(proc, timeout);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysrecvtim request. Services the receive as a sysrecv, and if the
+ * receiving process was blocked, also places it on the timing wheel so the receive
+ * fails with TIMEOUT if no matching send is performed in time.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysrecvtim(void) {
+    pcb_t *proc = current_proc;
+    unsigned int timeout = (unsigned int) args[2];
+    service_sysrecv();
+    if (proc->state == BLOCKED) {
+        set_timeout(proc, timeout);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssleep request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssleep(void) {
+    unsigned int milliseconds = args[0];
+    if (milliseconds > 0) {
+        sleep(current_proc, milliseconds);
+        // Select the next available process to run
+        current_proc = next();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysusleep request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysusleep(void) {
+    unsigned int microseconds = args[0];
+    if (microseconds > 0) {
+        sleep_us(current_proc, microseconds);
+        current_proc = next();
+    }
+}
+
 /*-----------------------------------------------------------------------------------
  * Services a syssighandler request.
  *-----------------------------------------------------------------------------------
@@ -414,15 +1900,46 @@ static void service_syssighandler(void) {
     int signal_31 = SIGNAL_TABLE_SIZE - 1;
     if (signal < 0 || signal >= signal_31) {
         current_proc->result_code = -1;
-    } else if (new_handler != NULL && !valid_ptr(new_handler)) {
+    } else if (new_handler != NULL && check_range(new_handler, 1, 1) != RANGE_OK) {
         current_proc->result_code = -2;
-    } else if (!valid_ptr(old_handler)) {
+    } else if (check_range(old_handler, sizeof(*old_handler), 1) != RANGE_OK) {
         current_proc->result_code = -3;
     } else {
         // Copy the address of the old handler to the location pointed to by old_handler
-        *old_handler = current_proc->signal_table[signal];
+        *old_handler = current_proc->owner->cold->signal_table[signal];
 
-        current_proc->signal_table[signal] = new_handler;
+        current_proc->owner->cold->signal_table[signal] = new_handler;
+        current_proc->result_code = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssigprocmask request. Signals unblocked while pending are delivered
+ * before the process runs again.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssigprocmask(void) {
+    int how = args[0];
+    int mask = args[1];
+    int *old_mask = (int *) args[2];
+
+    if (how != SIG_BLOCK && how != SIG_UNBLOCK && how != SIG_SETMASK) {
+        current_proc->result_code = -1;
+    } else if (old_mask != NULL && check_range(old_mask, sizeof(*old_mask), 1) != RANGE_OK) {
+        current_proc->result_code = -2;
+    } else {
+        if (old_mask != NULL) {
+            *old_mask = current_proc->blocked_signals;
+        }
+        if (how == SIG_BLOCK) {
+            current_proc->blocked_signals |= mask;
+        } else if (how == SIG_UNBLOCK) {
+            current_proc->blocked_signals &= ~mask;
+        } else {
+            current_proc->blocked_signals = mask;
+        }
+        // Signal 31 cannot be blocked
+        current_proc->blocked_signals = clear_signal_bit(current_proc->blocked_signals, SIGNAL_TABLE_SIZE - 1);
         current_proc->result_code = 0;
     }
 }
@@ -457,10 +1974,166 @@ static void service_syswait(void) {
         enqueue_blocked_queue(current_proc, proc_to_wait_on, WAIT);
         current_proc = next();
     } else {
+        // The process may have terminated but not been reaped yet
+        reap_terminated();
+        current_proc->result_code = -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysexit request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysexit(void) {
+    current_proc->exit_status = args[0];
+    cleanup_current_process_and_next();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syswaitany request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syswaitany(void) {
+    PID_t *pids = (PID_t *) args[0];
+    int count = args[1];
+    int *status = (int *) args[2];
+
+    if (count < 0 || count > MAX_PROCESSES
+            || (count > 0 && check_range(pids, count * sizeof(*pids), 1) != RANGE_OK)
+            || (status != NULL && check_range(status, sizeof(*status), 1) != RANGE_OK)) {
+        current_proc->result_code = -2;
+        return;
+    }
+    current_proc->wait_pids = pids;
+    current_proc->wait_count = count;
+    current_proc->wait_status = status;
+    current_proc->wait_pgid = 0;
+    wait_for_child();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syswaitpg request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syswaitpg(void) {
+    PID_t pgid = args[0];
+    int *status = (int *) args[1];
+
+    if (pgid < 1 || (status != NULL && check_range(status, sizeof(*status), 1) != RANGE_OK)) {
+        current_proc->result_code = -2;
+        return;
+    }
+    current_proc->wait_count = 0;
+    current_proc->wait_status = status;
+    current_proc->wait_pgid = pgid;
+    wait_for_child();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Waits for a child as the current process asked in syswaitany or syswaitpg. An
+ * exit the process already has is returned at once, otherwise the process blocks
+ * on no queue until notify_parent is told of an exit it waits for.
+ *-----------------------------------------------------------------------------------
+ */
+static void wait_for_child(void) {
+    if (take_child_exit(current_proc)) {
+        return;
+    }
+    if (!has_waited_child(current_proc)) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->state = BLOCKED;
+    current_proc->blocked_queue = WAIT_CHILD;
+    current_proc = next();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssetpgid request. A process may only move itself and its children,
+ * and only to a group that exists or is named after the process moved.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssetpgid(void) {
+    PID_t pid = args[0];
+    PID_t pgid = args[1];
+
+    pcb_t *proc = pid == 0 ? current_proc : get_pcb(pid);
+    if (proc == NULL || proc->owner != proc || (proc != current_proc && proc->parent_pid != current_proc->pid)) {
+        current_proc->result_code = -1;
+        return;
+    }
+    if (pgid == 0) {
+        pgid = proc->pid;
+    }
+    current_proc->result_code = pgrp_join(proc, pgid) == 0 ? 0 : -2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetpgid request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetpgid(void) {
+    PID_t pid = args[0];
+
+    pcb_t *proc = pid == 0 ? current_proc : get_pcb(pid);
+    current_proc->result_code = proc == NULL ? -1 : proc->pgid;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syskillpg request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syskillpg(void) {
+    PID_t pgid = args[0];
+    int signal_number = args[1];
+
+    current_proc->result_code = pgrp_signal(pgid, signal_number);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssetaffinity request. A ready process that may no longer run on the
+ * processor it is ready on is moved, and the calling process moves at once if it
+ * may no longer run where it runs. A process running on another processor moves
+ * once it gives up the processor.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssetaffinity(void) {
+    PID_t pid = args[0];
+    unsigned long mask = args[1];
+
+    pcb_t *proc = pid == 0 ? current_proc : get_pcb(pid);
+    if (proc == NULL) {
         current_proc->result_code = -1;
+        return;
+    }
+    if ((mask & smp_cpu_mask()) == 0) {
+        current_proc->result_code = -2;
+        return;
+    }
+    proc->cpu_affinity = mask & ALL_CPUS;
+    current_proc->result_code = 0;
+
+    if (proc->state == READY && proc->rt_period == 0 && sched_policy != SCHED_STRIDE
+        && !CPU_ALLOWED(proc, proc->cpu)) {
+        remove_from_ready_queue(proc);
+        ready(proc);
+    } else if (proc == current_proc && !CPU_ALLOWED(proc, this_cpu()->index)) {
+        ready(current_proc);
+        current_proc = next();
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetaffinity request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetaffinity(void) {
+    PID_t pid = args[0];
+
+    pcb_t *proc = pid == 0 ? current_proc : get_pcb(pid);
+    current_proc->result_code = proc == NULL ? -1 : (int) proc->cpu_affinity;
+}
+
 /*-----------------------------------------------------------------------------------
  * Services a sysopen request.
  *-----------------------------------------------------------------------------------
@@ -488,7 +2161,14 @@ static void service_syswrite(void) {
     void *buf = (void *) args[1];
     int buflen = args[2];
 
-    current_proc->result_code = di_write(current_proc, fd, buf, buflen);
+    int di_write_return = di_write(current_proc, fd, buf, buflen);
+
+    if (di_write_return == -2) {
+        // The device has blocked the process on its own queue
+        current_proc = next();
+    } else {
+        current_proc->result_code = di_write_return;
+    }
 }
 
 /*-----------------------------------------------------------------------------------
@@ -503,8 +2183,11 @@ static void service_sysread(void) {
     int di_read_return = di_read(current_proc, fd, buf, buflen);
 
     if (di_read_return == -2) {
-        current_proc->state = BLOCKED;
-        current_proc->blocked_queue = READ;
+        // A pipe has already blocked the process on its own queue
+        if (current_proc->state != BLOCKED) {
+            current_proc->state = BLOCKED;
+            current_proc->blocked_queue = READ;
+        }
         current_proc = next();
     } else {
         current_proc->result_code = di_read_return;
@@ -523,44 +2206,320 @@ static void service_sysioctl(void) {
     current_proc->result_code = di_ioctl(current_proc, fd, command, ioctl_args);
 }
 
+/*-----------------------------------------------------------------------------------
+ * Services a sysaioread request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysaioread(void) {
+    int fd = args[0];
+    void *buf = (void *) args[1];
+    int buflen = args[2];
+    int signal_number = args[3];
+
+    current_proc->result_code = di_aioread(current_proc, fd, buf, buflen, signal_number);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetmemstats request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetmemstats(void) {
+    mem_stats_t *stats = (mem_stats_t *) args[0];
+    if (check_range(stats, sizeof(mem_stats_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    get_mem_stats(stats);
+    current_proc->result_code = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a systracectl request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_systracectl(void) {
+    int mask = args[0];
+    current_proc->result_code = trace_set_mask(mask);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a systraceread request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_systraceread(void) {
+    unsigned long *cursor = (unsigned long *) args[0];
+    trace_event_t *events = (trace_event_t *) args[1];
+    int count = args[2];
+    if (count < 0 || check_range(cursor, sizeof(unsigned long), 0) != RANGE_OK ||
+        check_range(events, count * sizeof(trace_event_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->result_code = trace_read(cursor, events, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysprofstart request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysprofstart(void) {
+    int pid = args[0];
+    if (pid != 0 && get_pcb(pid) == NULL) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->result_code = profile_start(pid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysprofstop request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysprofstop(void) {
+    current_proc->result_code = profile_stop();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysprofread request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysprofread(void) {
+    profile_t *profile = (profile_t *) args[0];
+    if (check_range(profile, sizeof(profile_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    get_profile(profile);
+    current_proc->result_code = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syslogctl request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syslogctl(void) {
+    int level = args[0];
+    current_proc->result_code = log_set_level(level);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syslogread request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syslogread(void) {
+    log_record_t *records = (log_record_t *) args[0];
+    int count = args[1];
+    if (count < 0 || check_range(records, count * sizeof(log_record_t), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->result_code = log_read(records, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetipcstats request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetipcstats(void) {
+    pcb_t *proc = get_pcb((PID_t) args[0]);
+    ipc_stats_t *stats = (ipc_stats_t *) args[1];
+    if (proc == NULL) {
+        current_proc->result_code = -1;
+        return;
+    }
+    if (check_range(stats, sizeof(ipc_stats_t), 0) != RANGE_OK) {
+        current_proc->result_code = -2;
+        return;
+    }
+    stats->senders = proc->cold->ipc_queue_stats[SENDER];
+    stats->receivers = proc->cold->ipc_queue_stats[RECEIVER];
+    stats->sender_depth = size(&proc->cold->blocked_queues[SENDER]);
+    stats->receiver_depth = size(&proc->cold->blocked_queues[RECEIVER]);
+    current_proc->result_code = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysalloc request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysalloc(void) {
+    size_t size = (size_t) args[0];
+    current_proc->result_code = (int) arena_alloc(current_proc, size);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssetquantum request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssetquantum(void) {
+    int milliseconds = args[0];
+    if (milliseconds < 0 || milliseconds > MAX_PROCESS_QUANTUM) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->result_code = current_proc->quantum * TIME_SLICE;
+    current_proc->quantum = milliseconds / TIME_SLICE + (milliseconds % TIME_SLICE ? 1 : 0);
+    current_proc->quantum_left = quantum_of(current_proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssettimerslack request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssettimerslack(void) {
+    unsigned int milliseconds = (unsigned int) args[0];
+    if (milliseconds > MAX_TIMER_SLACK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    current_proc->result_code = current_proc->timer_slack * TIME_SLICE;
+    current_proc->timer_slack = milliseconds / TIME_SLICE + (milliseconds % TIME_SLICE ? 1 : 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssetrealtime request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssetrealtime(void) {
+    int period = args[0];
+    int budget = args[1];
+    current_proc->result_code = set_realtime(current_proc, period, budget);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a syssettickets request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_syssettickets(void) {
+    int tickets = args[0];
+    current_proc->result_code = set_tickets(current_proc, tickets);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysclock request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysclock(void) {
+    unsigned long long *microseconds = (unsigned long long *) args[0];
+    if (check_range(microseconds, sizeof(unsigned long long), 0) != RANGE_OK) {
+        current_proc->result_code = -1;
+        return;
+    }
+    *microseconds = clock_us();
+    current_proc->result_code = 0;
+}
+
 /*-----------------------------------------------------------------------------------
  * This function is the system side of the sysgetcputimes call. It places
  * into a structure being pointed to information about each currently
- * active process.
+ * active process, as many as fit in the size set by the caller. Serviced by
+ * preemptible_dispatch, every PCB is a step of its own.
  *
  * @param ps A pointer to a processStatuses structure that is filled with
  *           information about all the processes currently in the system
+ * @return   The last slot used, or a negative value if the structure is invalid
  *-----------------------------------------------------------------------------------
  */
 static int get_cpu_times(processStatuses *ps) {
     int i, currentSlot;
     currentSlot = -1;
-
-    // Check if address is in the hole
-    if (((unsigned long) ps) >= HOLESTART && ((unsigned long) ps <= HOLEEND))
+    unsigned long eflags = begin_step();
+    // All processors run an idle process, they share the entry of PID 0
+    long idleCpuTime = 0;
+    unsigned long long idleCycles = 0;
+    unsigned int idleSwitches = 0;
+    for (i = 0; i < MAX_CPUS; i++) {
+        cpu_t *cpu = get_cpu(i);
+        if (cpu != NULL) {
+            idleCpuTime += cpu->idle.cpuTime;
+            idleCycles += cpu->idle.run_cycles;
+            idleSwitches += cpu->idle.involuntary_switches;
+        }
+    }
+    long totalCpuTime = idleCpuTime;
+
+    // Check if address is in the hole, or if the data structure is otherwise invalid,
+    // such as going beyond the end of main memory
+    // The process may change the size between steps, the one checked is kept
+    int size = 0;
+    range_check_t reason = check_range(ps, sizeof(processStatuses), 1);
+    if (reason == RANGE_OK) {
+        // The header is readable, now check the entries it says there is room for
+        size = ps->size;
+        if (size >= 1 && size <= MAX_PROCESSES + 1) {
+            reason = check_range(ps, PS_SIZE(size), 1);
+        }
+    }
+    end_step(eflags);
+    if (reason == RANGE_IN_HOLE)
         return -1;
-
-    // Check if address of the data structure is beyond the end of main memory
-    if ((((char *) ps) + sizeof(processStatuses)) > maxaddr)
+    if (reason != RANGE_OK || size < 1 || size > MAX_PROCESSES + 1)
         return -2;
 
-    // There are probably other address checks that can be done, but this is OK for now
-
-    for (i = 0; i < PCB_TABLE_SIZE; i++) {
-        if (pcb_table[i].state != STOPPED) {
-            // Fill in the table entry
-            currentSlot++;
-            ps->pid[currentSlot] = pcb_table[i].pid;
-            ps->state[currentSlot] = current_proc->pid == pcb_table[i].pid ? RUNNING : pcb_table[i].state;
-            ps->blocked_queue[currentSlot] = pcb_table[i].blocked_queue;
-            ps->cpuTime[currentSlot] = pcb_table[i].cpuTime * TIME_SLICE;
+    int entries = 0;
+    for (i = 0; i < num_pcb_chunks * PCB_CHUNK_SIZE; i++) {
+        eflags = begin_step();
+        // Time spent on the blocked queue a process is still on is counted up to now
+        unsigned long long now = read_tsc();
+        pcb_t *proc = pcb_at(i);
+        if (proc->state != STOPPED) {
+            totalCpuTime += proc->cpuTime;
+            // Count every process, but only fill in the entries there is room for,
+            // keeping the last one for the idle process
+            if (entries++ >= size - 1) {
+                end_step(eflags);
+                continue;
+            }
+            proc_status_t *entry = &ps->proc[++currentSlot];
+            entry->pid = proc->pid;
+            entry->state = current_proc->pid == proc->pid ? RUNNING : proc->state;
+            entry->blocked_queue = proc->blocked_queue;
+            entry->cpuTime = proc->cpuTime * TIME_SLICE;
+            entry->stackUsage = stack_usage(proc);
+            entry->quantumLeft = proc->quantum_left * TIME_SLICE;
+            entry->priority = sched_priority(proc);
+            entry->runCycles = proc->run_cycles;
+            entry->voluntarySwitches = proc->voluntary_switches;
+            entry->involuntarySwitches = proc->involuntary_switches;
+            entry->syscalls = proc->syscalls;
+            entry->signalsDelivered = proc->signals_delivered;
+            entry->messagesSent = proc->messages_sent;
+            entry->messagesReceived = proc->messages_received;
+            int queue;
+            for (queue = 0; queue < NUM_BLOCKED_QUEUES; queue++) {
+                entry->blockedCycles[queue] = proc->cold->blocked_cycles[queue];
+            }
+            if (proc->blocked_since) {
+                entry->blockedCycles[proc->blocked_as] += now - proc->blocked_since;
+            }
         }
+        end_step(eflags);
     }
     // Fill in the table entry for idle process
-    currentSlot++;
-    ps->pid[currentSlot] = 0;
-    ps->state[currentSlot] = READY;
-    ps->cpuTime[currentSlot] = idle_proc.cpuTime * TIME_SLICE;
+    entries++;
+    proc_status_t *status = &ps->proc[++currentSlot];
+    status->pid = 0;
+    status->state = READY;
+    status->cpuTime = idleCpuTime * TIME_SLICE;
+    status->stackUsage = 0;
+    status->quantumLeft = 0;
+    status->priority = NUM_PRIORITIES;
+    // The idle process never makes system calls or blocks, it is only switched out
+    status->runCycles = idleCycles;
+    status->voluntarySwitches = 0;
+    status->involuntarySwitches = idleSwitches;
+    status->syscalls = 0;
+    status->signalsDelivered = 0;
+    status->messagesSent = 0;
+    status->messagesReceived = 0;
+    fill_words(status->blockedCycles, 0, sizeof(status->blockedCycles));
+    ps->entries = entries;
+
+    // The shares need the total, so they are filled in once every entry has its time
+    for (i = 0; i <= currentSlot; i++) {
+        long cpuTime = ps->proc[i].cpuTime / TIME_SLICE;
+        ps->proc[i].cpuShare = totalCpuTime > 0 ? cpuTime * 1000 / totalCpuTime : 0;
+    }
 
     return currentSlot;
 }
@@ -586,24 +2545,65 @@ static void cleanup_current_process_and_next(void) {
 void ready(pcb_t *proc) {
     // Idle process should not ever be on a ready queue
     if (proc->pid != IDLE_PROC_PID) {
+        if (mlfq.enabled && proc->state == BLOCKED) {
+            // Promote a process that wakes up, as it gave up the processor
+            proc->priority -= mlfq.wake_boost;
+            if (proc->priority < proc->base_priority) {
+                proc->priority = proc->base_priority;
+            }
+            proc->quanta_used = 0;
+        }
+        if (proc->state == BLOCKED && proc->blocked_since) {
+            proc->cold->blocked_cycles[proc->blocked_as] += read_tsc() - proc->blocked_since;
+            proc->blocked_since = 0;
+        }
+        TRACE(TRACE_SCHED, TRACE_READY, proc->pid, sched_priority(proc), proc->blocked_queue);
+        proc->ready_tick = sched_ticks;
+        // A process starts a new quantum every time it is made ready
+        proc->quantum_left = quantum_of(proc);
+        // Whichever of an IPC operation and its timeout completes first wins
+        cancel_timeout(proc);
         proc->blocked_on = NULL;
         proc->blocked_queue = NONE;
         proc->state = READY;
-        int priority = proc->priority;
-        Queue *ready_queue = &ready_queues[priority];
+        // Another processor notices the process on its next time slice
+        cpu_t *cpu = proc->rt_period > 0 || sched_policy == SCHED_STRIDE ? this_cpu() : ready_cpu(proc);
+        if (cpu == this_cpu() && outranks(proc, cpu->current)) {
+            cpu->need_resched = 1;
+        }
+        if (proc->rt_period > 0) {
+            realtime_ready(proc);
+            return;
+        }
+        if (sched_policy == SCHED_STRIDE) {
+            stride_ready(proc);
+            return;
+        }
+        int priority = sched_priority(proc);
+        Queue *ready_queue = &cpu->ready_queues[priority];
         enqueue(ready_queue, proc);
+        cpu->ready_bitmap |= 1UL << priority;
+        cpu->num_ready++;
+        proc->cpu = cpu->index;
     }
 }
 
 /*-----------------------------------------------------------------------------------
  * Removes the next process from the stopped queue, assigns it a PID, and
- * returns a pointer to its process control block.
+ * returns a pointer to its process control block. The signal table and file
+ * descriptor table are only cleared for a process, a thread uses those of its
+ * owner.
  *
- * @return A pointer to an unused PCB, or NULL if unavailable
+ * @param owner The owner of the new thread, NULL for a new process
+ * @return      A pointer to an unused PCB, or NULL if unavailable
  *-----------------------------------------------------------------------------------
  */
-pcb_t *get_unused_pcb(void) {
+pcb_t *get_unused_pcb(pcb_t *owner) {
+    // The table only grows once the terminated processes have given back their PCBs
     if (is_empty(&stopped_queue)) {
+        reap_terminated();
+    }
+    if (is_empty(&stopped_queue) && grow_pcb_table() != 0) {
         return NULL;
     }
 
@@ -611,32 +2611,94 @@ pcb_t *get_unused_pcb(void) {
 
     // See the notes at the start of the file on the PCB selection algorithm and how PIDs are assigned
     int prev_pid = unused_pcb->pid;
-    int new_pid = prev_pid + PCB_TABLE_SIZE;
+    int new_pid = prev_pid + MAX_PROCESSES;
     // Reference: https://stackoverflow.com/questions/2633661/how-to-check-for-signed-integer-overflow-in-c-without-undefined-behaviour
     if (new_pid < 1) {
-        new_pid = prev_pid % PCB_TABLE_SIZE;
+        new_pid = (prev_pid - 1) % MAX_PROCESSES + 1;
     }
     assert(new_pid >= 1, "Calculated new PID is not >= 1");
     unused_pcb->pid = new_pid;
 
     unused_pcb->cpuTime = 0;
-
-    // Clear signal table
-    int signal_31 = SIGNAL_TABLE_SIZE - 1;
-    for (int i = 0; i < signal_31; i++) {
-        unused_pcb->signal_table[i] = NULL;
-    }
-    // Signal 31 is a special signal that has as its handler sysstop
-    unused_pcb->signal_table[signal_31] = (signal_handler_funcptr) & sysstop;
+    unused_pcb->run_cycles = 0;
+    unused_pcb->voluntary_switches = 0;
+    unused_pcb->involuntary_switches = 0;
+    unused_pcb->syscalls = 0;
+    unused_pcb->signals_delivered = 0;
+    unused_pcb->messages_sent = 0;
+    unused_pcb->messages_received = 0;
+    fill_words(unused_pcb->cold->blocked_cycles, 0, sizeof(unused_pcb->cold->blocked_cycles));
+    unused_pcb->blocked_since = 0;
+    unused_pcb->blocked_as = NONE;
+    fill_words(unused_pcb->cold->ipc_queue_stats, 0, sizeof(unused_pcb->cold->ipc_queue_stats));
+    unused_pcb->priority = initial_priority();
+    unused_pcb->base_priority = unused_pcb->priority;
+    unused_pcb->quanta_used = 0;
+    unused_pcb->quantum = 0;
+    unused_pcb->timer_slack = 0;
+    unused_pcb->sleep_deadline_us = 0;
+    unused_pcb->next_sleeper = NULL;
+    unused_pcb->ipc_peer = NULL;
+    unused_pcb->inherited_priority = NUM_PRIORITIES;
+    unused_pcb->rt_period = 0;
+    set_tickets(unused_pcb, DEFAULT_TICKETS);
+    unused_pcb->pass = 0;
 
     unused_pcb->pending_signals = 0;
+    unused_pcb->blocked_signals = 0;
+    unused_pcb->cold->num_queued_signals = 0;
+    unused_pcb->cold->num_reserved_signals = 0;
+    unused_pcb->cold->ring = NULL;
     unused_pcb->last_signal_delivered = -1;
+    unused_pcb->num_threads = 0;
+    unused_pcb->parent_pid = 0;
+    unused_pcb->num_children = 0;
+    unused_pcb->exit_status = 0;
+    unused_pcb->child_exits = NULL;
+    unused_pcb->child_exits_tail = NULL;
+    unused_pcb->num_child_exits = 0;
+    unused_pcb->wait_count = 0;
+    unused_pcb->wait_pgid = 0;
+    unused_pcb->pgid = 0;
+    // See the notes at the start of the file on affinity
+    if (current_proc != NULL && current_proc->pid != IDLE_PROC_PID) {
+        unused_pcb->cpu_affinity = current_proc->cpu_affinity;
+    } else {
+        unused_pcb->cpu_affinity = ALL_CPUS & ~ISOLATED_CPUS;
+    }
 
-    // Clear FD table
-    for (int i = 0; i < FD_TABLE_SIZE; i++) {
-        unused_pcb->fd_table[i] = NULL;
+    // See the notes at the start of the file on children, a child starts in the
+    // process group of its parent
+    if (owner == NULL && current_proc != NULL && current_proc->pid != IDLE_PROC_PID) {
+        unused_pcb->parent_pid = current_proc->pid;
+        current_proc->num_children++;
+        if (current_proc->pgid != 0) {
+            pgrp_join(unused_pcb, current_proc->pgid);
+        }
     }
 
+    if (owner != NULL) {
+        unused_pcb->owner = owner;
+        owner->num_threads++;
+    } else {
+        unused_pcb->owner = unused_pcb;
+
+        // Clear signal table
+        int signal_31 = SIGNAL_TABLE_SIZE - 1;
+        for (int i = 0; i < signal_31; i++) {
+            unused_pcb->cold->signal_table[i] = NULL;
+        }
+        // Signal 31 is a special signal that has as its handler sysstop
+        unused_pcb->cold->signal_table[signal_31] = (signal_handler_funcptr) & sysstop;
+
+        // Clear FD table
+        di_init_fds(unused_pcb);
+    }
+
+    unused_pcb->arena = NULL;
+    unused_pcb->shm_held = 0;
+
+    newest_pcb = unused_pcb;
     return unused_pcb;
 }
 
@@ -649,8 +2711,8 @@ pcb_t *get_unused_pcb(void) {
  */
 static pcb_t *get_pcb(PID_t pid) {
     if (pid >= 1) {
-        pcb_t *proc = &pcb_table[(pid - 1) % PCB_TABLE_SIZE];
-        if (proc->pid == pid && proc->state != STOPPED) {
+        pcb_t *proc = pcb_at((pid - 1) % MAX_PROCESSES);
+        if (proc != NULL && proc->pid == pid && proc->state != STOPPED) {
             return proc;
         }
     }
@@ -658,92 +2720,435 @@ static pcb_t *get_pcb(PID_t pid) {
     return NULL;
 }
 
+/*-----------------------------------------------------------------------------------
+ * Returns the PCB in the given slot of the PCB table.
+ *
+ * @param slot The index of the PCB in the table, from 0 to MAX_PROCESSES - 1
+ * @return     The PCB, or NULL if the chunk holding it has not been allocated
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *pcb_at(int slot) {
+    int chunk = slot / PCB_CHUNK_SIZE;
+    if (chunk >= num_pcb_chunks) {
+        return NULL;
+    }
+    return &pcb_chunks[chunk][slot % PCB_CHUNK_SIZE];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Grows the PCB table by one chunk of PCB_CHUNK_SIZE PCBs, and adds them to the
+ * stopped queue.
+ *
+ * @return 0 on success, -1 if the table has reached MAX_PROCESSES PCBs or there is
+ *         not enough memory for another chunk
+ *-----------------------------------------------------------------------------------
+ */
+static int grow_pcb_table(void) {
+    if (num_pcb_chunks == MAX_PROCESSES / PCB_CHUNK_SIZE) {
+        return -1;
+    }
+    // See the notes at the start of the file on the PCB layout, the chunk is never
+    // freed so only its aligned start is kept
+    void *mem = kmalloc(PCB_CHUNK_SIZE * sizeof(pcb_t) + CACHE_LINE_SIZE - 1);
+    if (mem == NULL) {
+        return -1;
+    }
+    pcb_cold_t *cold_chunk = kmalloc(PCB_CHUNK_SIZE * sizeof(pcb_cold_t));
+    if (cold_chunk == NULL) {
+        kfree(mem);
+        return -1;
+    }
+    pcb_t *chunk = (pcb_t *) (((unsigned long) mem + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1));
+    fill_words(chunk, 0, PCB_CHUNK_SIZE * sizeof(pcb_t));
+    fill_words(cold_chunk, 0, PCB_CHUNK_SIZE * sizeof(pcb_cold_t));
+    pcb_chunks[num_pcb_chunks] = chunk;
+    for (int i = 0; i < PCB_CHUNK_SIZE; i++) {
+        pcb_t *proc = &chunk[i];
+        proc->cold = &cold_chunk[i];
+        // Set process IDs starting from 1 (0 is reserved for idle process)
+        proc->pid = num_pcb_chunks * PCB_CHUNK_SIZE + i + 1;
+        Queue *queue_of_senders = &proc->cold->blocked_queues[0];
+        init_queue(queue_of_senders);
+        Queue *queue_of_receivers = &proc->cold->blocked_queues[1];
+        init_queue(queue_of_receivers);
+
+        // Add process to stopped queue, it was never counted as a user process
+        proc->state = STOPPED;
+        enqueue(&stopped_queue, proc);
+    }
+    num_pcb_chunks++;
+    return 0;
+}
+
 /*-----------------------------------------------------------------------------------
  * Removes the next process from the ready queues and returns a pointer to
  * its process control block. The scheduling policy is that higher
  * priority processes (with a lower priority number) are always run first
- * and round-robin scheduling is used within a priority.
+ * and round-robin scheduling is used within a priority. The highest
+ * priority non-empty queue is found with a single bit-scan of the ready
+ * queue bitmap. Runnable real-time processes are run before all others.
+ * Under the stride scheduler the process with the lowest pass is run instead.
+ * A processor with no ready process of its own steals one from another. A process
+ * is only taken from the shared stride heap or from another processor if its
+ * affinity lets it run on this processor.
  *
  * @return A pointer to the PCB of the next process from the ready queues
  *-----------------------------------------------------------------------------------
  */
 static pcb_t *next(void) {
+    cpu_t *cpu = this_cpu();
     pcb_t *proc = NULL;
-    // To select next process, scan queues, highest to lowest priority
-    int i = 0;
-    while (i < NUM_PRIORITIES && proc == NULL) {
-        Queue *ready_queue = &ready_queues[i];
-        if (!is_empty(ready_queue)) {
-            proc = dequeue(ready_queue);
-        }
-        i++;
+    // Real-time processes run ahead of all other processes, on the boot processor
+    if (cpu->index == 0) {
+        proc = realtime_next();
+    }
+    if (proc == NULL && sched_policy == SCHED_STRIDE) {
+        proc = stride_next(cpu->index);
+    }
+    if (proc == NULL) {
+        proc = dequeue_ready(cpu);
+    }
+    if (proc == NULL) {
+        proc = steal();
     }
 
     if (proc == NULL) {
         // The idle process will run only if no other process is available
-        if (DEBUG) kprintf("Running idle process...\n");
+        KLOG(LOG_DEBUG, "Running idle process...\n");
         proc = &idle_proc;
     }
 
+    TRACE(TRACE_SCHED, TRACE_SWITCH, proc->pid, cpu->current ? cpu->current->pid : 0, 0);
     proc->state = RUNNING;
     return proc;
 }
 
 /*-----------------------------------------------------------------------------------
- * Takes a pointer to a process control block and adds it to the stopped
- * queue.
+ * Takes a pointer to a process control block, marks it as stopped and adds it to
+ * the reap queue.
  *
- * @param proc A pointer to the PCB to add to the stopped queue
+ * @param proc A pointer to the PCB to add to the reap queue
  *-----------------------------------------------------------------------------------
  */
 static void stop(pcb_t *proc) {
     proc->state = STOPPED;
-    enqueue(&stopped_queue, proc);
+    enqueue(&reap_queue, proc);
     user_proc_count--;
 }
 
+/*-----------------------------------------------------------------------------------
+ * Frees the stack, arena and unclaimed exits of up to the given number of PCBs on
+ * the reap queue, oldest first, and adds them to the stopped queue. A process whose
+ * threads have not all terminated keeps its PCB until they have, see release_tables.
+ *
+ * @param max_procs The most PCBs to reap
+ *-----------------------------------------------------------------------------------
+ */
+static void reap(int max_procs) {
+    for (int i = 0; i < max_procs; i++) {
+        pcb_t *proc = dequeue(&reap_queue);
+        if (proc == NULL) {
+            return;
+        }
+        release_child_exits(proc);
+        if (PAGING_ENABLED) {
+            vstack_free(proc->mem_start);
+        } else {
+            kstackfree(proc->mem_start);
+        }
+        arena_release(proc);
+        proc->mem_start = NULL;
+        if (proc->num_threads == 0) {
+            enqueue(&stopped_queue, proc);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reaps every PCB on the reap queue. To be called when the memory or PCBs they hold
+ * are needed now.
+ *-----------------------------------------------------------------------------------
+ */
+void reap_terminated(void) {
+    reap(size(&reap_queue));
+}
+
 /*-----------------------------------------------------------------------------------
  * Takes a pointer to a process control block and performs process
- * destruction. Frees all resources associated with the process.
+ * destruction. Releases everything other processes can see the process hold, and
+ * leaves its stack and memory to be freed by reap.
  *
  * @param proc A pointer to the PCB of the process to destroy
  *-----------------------------------------------------------------------------------
  */
 static void cleanup(pcb_t *proc) {
     // Unblock all senders waiting on the process
-    Queue *queue_of_senders = &proc->blocked_queues[SENDER];
+    Queue *queue_of_senders = &proc->cold->blocked_queues[SENDER];
     pcb_t *blocked_sender = dequeue(queue_of_senders);
     while (blocked_sender != NULL) {
+        end_ipc_wait(blocked_sender, proc, SENDER);
         // Return −1 if the receiving process terminates before the matching receive is performed
         unblock(blocked_sender, -1);
         blocked_sender = dequeue(queue_of_senders);
     }
     // Unblock all receivers waiting on the process
-    Queue *queue_of_receivers = &proc->blocked_queues[RECEIVER];
+    Queue *queue_of_receivers = &proc->cold->blocked_queues[RECEIVER];
     pcb_t *blocked_receiver = dequeue(queue_of_receivers);
     while (blocked_receiver != NULL) {
+        end_ipc_wait(blocked_receiver, proc, RECEIVER);
         // Return −1 if the sending process terminates before a matching send is performed
         unblock(blocked_receiver, -1);
         blocked_receiver = dequeue(queue_of_receivers);
     }
 
+    // Unblock the process whose message the process was copying
+    release_peer(proc);
+
     // Unblock all processes waiting on the process to terminate
-    Queue *queue_of_waiting_processes = &proc->blocked_queues[WAIT];
+    Queue *queue_of_waiting_processes = &proc->cold->blocked_queues[WAIT];
+    int waited = !is_empty(queue_of_waiting_processes);
     pcb_t *blocked_waiting_process = dequeue(queue_of_waiting_processes);
     while (blocked_waiting_process != NULL) {
         unblock(blocked_waiting_process, 0);
         blocked_waiting_process = dequeue(queue_of_waiting_processes);
     }
+    notify_parent(proc);
 
     // Mark PCB as unused
     stop(proc);
-    if (only_process() && size(&receive_any_queue) == 1) {
-        // The receiving process is the only user process
-        pcb_t *blocked_receive_any = dequeue(&receive_any_queue);
-        unblock(blocked_receive_any, -10);
+    if (only_process()) {
+        // A process receiving from any process can no longer be sent to once it is
+        // the only user process, the search is only made in this rare case
+        for (int slot = 0; slot < num_pcb_chunks * PCB_CHUNK_SIZE; slot++) {
+            pcb_t *survivor = pcb_at(slot);
+            if (survivor->state == BLOCKED && survivor->blocked_queue == RECEIVE_ANY) {
+                unblock(survivor, -10);
+                break;
+            }
+        }
+    }
+    if (recv_set_waiters > 0) {
+        fail_orphaned_recv_sets();
+    }
+    if (REPORT_STACK_USAGE) kprintf("Process %d used %d of %d bytes of stack\n", proc->pid, stack_usage(proc), proc->stack_size);
+    realtime_release(proc);
+    release_timers(proc);
+    release_ports(proc);
+    release_shm(proc);
+    release_tables(proc);
+    pgrp_leave(proc);
+    if (waited) {
+        // The waiting processes find what the process held freed
+        reap_terminated();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Releases the file descriptor table of the given terminating process, or lets go of
+ * its owner if it is a thread. A process with threads has them terminated instead,
+ * and its table is released along with its PCB once the last one is gone.
+ *
+ * @param proc A pointer to the PCB of the terminating process, already stopped
+ *-----------------------------------------------------------------------------------
+ */
+static void release_tables(pcb_t *proc) {
+    pcb_t *owner = proc->owner;
+    if (owner != proc) {
+        owner->num_threads--;
+        if (owner->state != STOPPED || owner->num_threads > 0) {
+            return;
+        }
+        // The last thread of a terminated process, which reap left out of the
+        // stopped queue, or will add to it once it is reaped
+        if (owner->mem_start == NULL) {
+            enqueue(&stopped_queue, owner);
+        }
+    } else if (proc->num_threads > 0) {
+        // Signal 31 has sysstop as its handler and cannot be blocked
+        int signal_31 = SIGNAL_TABLE_SIZE - 1;
+        for (int slot = 0; slot < num_pcb_chunks * PCB_CHUNK_SIZE; slot++) {
+            pcb_t *thread = pcb_at(slot);
+            if (thread->owner == proc && thread != proc && thread->state != STOPPED) {
+                signal(thread, signal_31);
+            }
+        }
+        return;
+    }
+    // Close the devices left open, so the keyboard and pipes see the process go
+    di_release_fds(owner);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tells the parent of the given terminating process of its exit, by unblocking the
+ * parent if it waits for it in syswaitany, otherwise by adding the exit to the exits
+ * of the parent. An exit that cannot be allocated is lost.
+ *
+ * @param child A pointer to the PCB of the terminating process
+ *-----------------------------------------------------------------------------------
+ */
+static void notify_parent(pcb_t *child) {
+    pcb_t *parent = get_pcb(child->parent_pid);
+    if (parent == NULL) {
+        return;
+    }
+    parent->num_children--;
+    if (parent->state == BLOCKED && parent->blocked_queue == WAIT_CHILD
+            && is_waited_child(parent, child->pid, child->pgid)) {
+        if (parent->wait_status != NULL) {
+            *parent->wait_status = child->exit_status;
+        }
+        unblock(parent, child->pid);
+        return;
+    }
+
+    child_exit_t *child_exit;
+    if (parent->num_child_exits == MAX_CHILD_EXITS) {
+        // The oldest exit makes room
+        child_exit = parent->child_exits;
+        parent->child_exits = child_exit->next;
+        parent->num_child_exits--;
+    } else {
+        child_exit = kmalloc(sizeof(*child_exit));
+        if (child_exit == NULL) {
+            return;
+        }
+    }
+    child_exit->pid = child->pid;
+    child_exit->status = child->exit_status;
+    child_exit->pgid = child->pgid;
+    child_exit->next = NULL;
+    if (parent->child_exits == NULL) {
+        parent->child_exits = child_exit;
+    } else {
+        parent->child_exits_tail->next = child_exit;
+    }
+    parent->child_exits_tail = child_exit;
+    parent->num_child_exits++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the oldest exit of the given process that its syswaitany or syswaitpg
+ * waits for, by setting its result code and the status it asked for.
+ *
+ * @param parent A pointer to the PCB of the process calling syswaitany or syswaitpg
+ * @return       1 if an exit was returned, 0 if the process has none it waits for
+ *-----------------------------------------------------------------------------------
+ */
+static int take_child_exit(pcb_t *parent) {
+    child_exit_t *prev = NULL;
+    for (child_exit_t *child_exit = parent->child_exits; child_exit != NULL; child_exit = child_exit->next) {
+        if (is_waited_child(parent, child_exit->pid, child_exit->pgid)) {
+            if (prev == NULL) {
+                parent->child_exits = child_exit->next;
+            } else {
+                prev->next = child_exit->next;
+            }
+            if (parent->child_exits_tail == child_exit) {
+                parent->child_exits_tail = prev;
+            }
+            parent->num_child_exits--;
+            if (parent->wait_status != NULL) {
+                *parent->wait_status = child_exit->status;
+            }
+            parent->result_code = child_exit->pid;
+            kfree(child_exit);
+            return 1;
+        }
+        prev = child_exit;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if a child the syswaitany or syswaitpg of the given process waits for
+ * has not yet terminated, 0 if the process would wait forever.
+ *-----------------------------------------------------------------------------------
+ */
+static int has_waited_child(pcb_t *parent) {
+    if (parent->wait_pgid != 0) {
+        return pgrp_has_child(parent->wait_pgid, parent->pid);
+    }
+    if (parent->wait_count == 0) {
+        return parent->num_children > 0;
+    }
+    for (int i = 0; i < parent->wait_count; i++) {
+        pcb_t *child = get_pcb(parent->wait_pids[i]);
+        if (child != NULL && child->parent_pid == parent->pid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Fails with −1 the sysrecvset of every process none of whose set is left, and
+ * recounts the processes still blocked in sysrecvset.
+ *-----------------------------------------------------------------------------------
+ */
+static void fail_orphaned_recv_sets(void) {
+    recv_set_waiters = 0;
+    for (int slot = 0; slot < num_pcb_chunks * PCB_CHUNK_SIZE; slot++) {
+        pcb_t *receiver = pcb_at(slot);
+        if (receiver->state != BLOCKED || receiver->blocked_queue != RECEIVE_ANY
+                || receiver->cold->ipc_recv_set_size == 0) {
+            continue;
+        }
+        if (has_live_sender(receiver)) {
+            recv_set_waiters++;
+        } else {
+            unblock(receiver, -1);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if a process in the set the given process receives from still exists,
+ * 0 if it would wait forever.
+ *-----------------------------------------------------------------------------------
+ */
+static int has_live_sender(pcb_t *receiver) {
+    for (int i = 0; i < receiver->cold->ipc_recv_set_size; i++) {
+        if (get_pcb(receiver->cold->ipc_recv_set[i]) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the syswaitany or syswaitpg of the given process waits for the child
+ * with the given PID and process group, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int is_waited_child(pcb_t *parent, PID_t pid, PID_t pgid) {
+    if (parent->wait_pgid != 0) {
+        return pgid == parent->wait_pgid;
+    }
+    if (parent->wait_count == 0) {
+        return 1;
+    }
+    for (int i = 0; i < parent->wait_count; i++) {
+        if (parent->wait_pids[i] == pid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Frees the exits of children the given terminating process has not taken.
+ *-----------------------------------------------------------------------------------
+ */
+static void release_child_exits(pcb_t *proc) {
+    child_exit_t *child_exit = proc->child_exits;
+    while (child_exit != NULL) {
+        child_exit_t *next = child_exit->next;
+        kfree(child_exit);
+        child_exit = next;
     }
-    // Free allocated stack
-    kfree(proc->mem_start);
+    proc->child_exits = NULL;
+    proc->child_exits_tail = NULL;
+    proc->num_child_exits = 0;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -758,6 +3163,29 @@ static void unblock(pcb_t *proc, int result_code) {
     ready(proc);
 }
 
+/*-----------------------------------------------------------------------------------
+ * Counts the wait of a process that has just left the queue of senders or receivers
+ * of the process it was blocked on, nothing is counted for the other queues.
+ *
+ * @param proc            The process that left the queue
+ * @param blocked_on_proc The process with the queue
+ * @param blocked_queue   The blocked queue the process left
+ *-----------------------------------------------------------------------------------
+ */
+static void end_ipc_wait(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue) {
+    if (blocked_queue > RECEIVER) {
+        return;
+    }
+    ipc_queue_stats_t *stats = &blocked_on_proc->cold->ipc_queue_stats[blocked_queue];
+    unsigned long long cycles = read_tsc() - proc->cold->ipc_enqueued_at;
+    stats->wait_cycles += cycles;
+    // Anything beyond 32 bits is taken as the largest wait that fits
+    unsigned long wait = cycles >> 32 ? 0xffffffffUL : (unsigned long) cycles;
+    if (wait > stats->max_wait_cycles) {
+        stats->max_wait_cycles = wait;
+    }
+}
+
 /*-----------------------------------------------------------------------------------
  * Adds a process to the queue of senders/receivers/wait of the process it
  * is blocked on.
@@ -769,11 +3197,21 @@ static void unblock(pcb_t *proc, int result_code) {
  *-----------------------------------------------------------------------------------
  */
 void enqueue_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue) {
-    enqueue(&blocked_on_proc->blocked_queues[blocked_queue], proc);
+    Queue *queue = &blocked_on_proc->cold->blocked_queues[blocked_queue];
+    enqueue(queue, proc);
+    if (blocked_queue <= RECEIVER) {
+        ipc_queue_stats_t *stats = &blocked_on_proc->cold->ipc_queue_stats[blocked_queue];
+        stats->waits++;
+        if (size(queue) > stats->max_depth) {
+            stats->max_depth = size(queue);
+        }
+        proc->cold->ipc_enqueued_at = read_tsc();
+    }
 
     proc->blocked_on = blocked_on_proc;
     proc->blocked_queue = blocked_queue;
     proc->state = BLOCKED;
+    update_inherited_priority(blocked_on_proc);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -790,7 +3228,9 @@ void enqueue_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t
  */
 int remove_from_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue) {
     if (proc->blocked_on == blocked_on_proc && proc->blocked_queue == blocked_queue) {
-        remove(&blocked_on_proc->blocked_queues[blocked_queue], proc);
+        remove(&blocked_on_proc->cold->blocked_queues[blocked_queue], proc);
+        end_ipc_wait(proc, blocked_on_proc, blocked_queue);
+        update_inherited_priority(blocked_on_proc);
         return 1;
     } else {
         return 0;
@@ -798,19 +3238,36 @@ int remove_from_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue
 }
 
 /*-----------------------------------------------------------------------------------
- * Removes a process from the queue of processes waiting on a receive-any.
+ * Recomputes the priority the given process inherits from the processes on its
+ * blocked queues. A ready process is moved to the ready queue of its new priority,
+ * and a change is passed on to the process that the given process is blocked on.
  *
- * @param proc The process to remove
- * @return     1 if the process was on the receive-any queue and was
- *             removed, 0 otherwise
+ * @param proc The process whose blocked queues have changed
  *-----------------------------------------------------------------------------------
  */
-int remove_from_receive_any_queue(pcb_t *proc) {
-    if (proc->blocked_queue == RECEIVE_ANY) {
-        remove(&receive_any_queue, proc);
-        return 1;
+void update_inherited_priority(pcb_t *proc) {
+    int inherited_priority = NUM_PRIORITIES;
+    for (int i = SENDER; i <= WAIT; i++) {
+        for (pcb_t *blocked = proc->cold->blocked_queues[i].head; blocked != NULL; blocked = blocked->next) {
+            int priority = sched_priority(blocked);
+            if (priority < inherited_priority) {
+                inherited_priority = priority;
+            }
+        }
+    }
+    if (inherited_priority == proc->inherited_priority) {
+        return;
+    }
+
+    if (proc->state == READY) {
+        remove_from_ready_queue(proc);
+        proc->inherited_priority = inherited_priority;
+        ready(proc);
     } else {
-        return 0;
+        proc->inherited_priority = inherited_priority;
+    }
+    if (proc->state == BLOCKED && proc->blocked_on != NULL) {
+        update_inherited_priority(proc->blocked_on);
     }
 }
 
@@ -830,5 +3287,310 @@ static int only_process(void) {
  *-----------------------------------------------------------------------------------
  */
 void idleproc(void) {
-    for (;;);
+    // Halt until the next interrupt instead of spinning
+    for (;;) {
+        __asm__ volatile("hlt;");
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the priority new processes are created with, the highest priority with
+ * the multilevel feedback scheduler and the lowest priority otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int initial_priority(void) {
+    return mlfq.enabled ? 0 : INIT_PRIORITY;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Accounts for the given number of time slices having passed, which is more than
+ * one when catching up after tickless idle. Charges them to the current process,
+ * notifies the sleep device of each one, and updates the scheduler.
+ *-----------------------------------------------------------------------------------
+ */
+static void account_ticks(int ticks) {
+    charge_ticks(ticks);
+    for (int i = 0; i < ticks; i++) {
+        tick();
+    }
+    timer_tick(ticks);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Charges the given number of time slices to the current process.
+ *-----------------------------------------------------------------------------------
+ */
+static void charge_ticks(int ticks) {
+    current_proc->cpuTime += ticks;
+    if (sched_policy == SCHED_STRIDE && current_proc != &idle_proc) {
+        stride_charge(current_proc, ticks);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called after the given number of timer ticks. Charges the ticks to the quantum
+ * of the current process and rotates it once its quantum is used up, the idle
+ * process is always rotated. A real-time process that becomes runnable pre-empts
+ * the current process. Periodically ages the ready processes when the
+ * multilevel feedback scheduler is enabled.
+ *-----------------------------------------------------------------------------------
+ */
+static void timer_tick(int ticks) {
+    unsigned long prev_sched_ticks = sched_ticks;
+    sched_ticks += ticks;
+    if (mlfq.enabled && sched_ticks / mlfq.aging_interval != prev_sched_ticks / mlfq.aging_interval) {
+        age_ready_processes();
+    }
+    // Real-time processes are rotated when their budget runs out or on an earlier
+    // deadline, not by quanta
+    int realtime_preempt = realtime_tick(current_proc, ticks);
+    if (realtime_preempt || current_proc->rt_period > 0) {
+        if (realtime_preempt) yield();
+        return;
+    }
+    quantum_tick(ticks);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Charges the given number of timer ticks to the quantum of the current process,
+ * which is not a real-time process, and rotates it once its quantum is used up.
+ * The idle process is always rotated.
+ *-----------------------------------------------------------------------------------
+ */
+static void quantum_tick(int ticks) {
+    if (current_proc != &idle_proc) {
+        current_proc->quantum_left -= ticks;
+        if (current_proc->quantum_left > 0) {
+            return;
+        }
+        if (mlfq.enabled) mlfq_quantum_expired(current_proc);
+    }
+    yield();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of time slices in a quantum of the given process.
+ *-----------------------------------------------------------------------------------
+ */
+static int quantum_of(pcb_t *proc) {
+    return proc->quantum > 0 ? proc->quantum : priority_quanta[proc->priority];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called when the given process has used up its quantum with the multilevel
+ * feedback scheduler enabled, demotes the process if it has used up demote_quanta
+ * quanta at its priority.
+ *-----------------------------------------------------------------------------------
+ */
+static void mlfq_quantum_expired(pcb_t *proc) {
+    proc->quanta_used++;
+    if (proc->quanta_used >= mlfq.demote_quanta) {
+        proc->quanta_used = 0;
+        if (proc->priority < NUM_PRIORITIES - 1) {
+            proc->priority++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Promotes by one priority every ready process that has waited for at least the
+ * aging interval, moving it to the end of the ready queue of its new priority.
+ *-----------------------------------------------------------------------------------
+ */
+static void age_ready_processes(void) {
+    for (int i = 0; i < num_pcb_chunks * PCB_CHUNK_SIZE; i++) {
+        pcb_t *proc = pcb_at(i);
+        if (proc->state == READY && proc->rt_period == 0 && proc->priority > proc->base_priority
+            && sched_ticks - proc->ready_tick >= mlfq.aging_interval) {
+            remove_from_ready_queue(proc);
+            proc->priority--;
+            proc->quanta_used = 0;
+            ready(proc);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Switches directly from the current process to the given peer, which has just been
+ * unblocked by a message from or to the current process. The peer is taken off its
+ * ready queue and runs for the rest of the quantum of the current process, which is
+ * placed on its ready queue.
+ *
+ * @param peer A pointer to the PCB of the unblocked peer, which is on a ready queue
+ *-----------------------------------------------------------------------------------
+ */
+static void handoff(pcb_t *peer) {
+    if (!CPU_ALLOWED(peer, this_cpu()->index)) {
+        // The peer was made ready where it may run, the current process goes on
+        return;
+    }
+    int quantum_left = current_proc->quantum_left;
+    ready(current_proc);
+    run_peer(peer, quantum_left);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Switches from the current process, which has been placed on a ready or blocked
+ * queue, directly to the given peer, which is on a ready queue. The next process
+ * runs instead if the peer may not run on this processor.
+ *
+ * @param peer         A pointer to the PCB of the peer
+ * @param quantum_left The time slices of quantum the peer is given
+ *-----------------------------------------------------------------------------------
+ */
+static void run_peer(pcb_t *peer, int quantum_left) {
+    if (!CPU_ALLOWED(peer, this_cpu()->index)) {
+        current_proc = next();
+        return;
+    }
+    remove_from_ready_queue(peer);
+    peer->quantum_left = quantum_left;
+    peer->state = RUNNING;
+    current_proc = peer;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given process from the ready queue for its priority.
+ *-----------------------------------------------------------------------------------
+ */
+static void remove_from_ready_queue(pcb_t *proc) {
+    if (proc->rt_period > 0) {
+        realtime_remove(proc);
+        return;
+    }
+    if (sched_policy == SCHED_STRIDE) {
+        stride_remove(proc);
+        return;
+    }
+    cpu_t *cpu = get_cpu(proc->cpu);
+    int priority = sched_priority(proc);
+    Queue *ready_queue = &cpu->ready_queues[priority];
+    remove(ready_queue, proc);
+    if (is_empty(ready_queue)) {
+        cpu->ready_bitmap &= ~(1UL << priority);
+    }
+    cpu->num_ready--;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the first process of the highest priority non-empty ready queue of the
+ * given processor and returns it, NULL if its ready queues are empty. The queue is
+ * found with a single bit-scan of the ready queue bitmap.
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *dequeue_ready(cpu_t *cpu) {
+    // The lowest set bit is the highest priority with a ready process
+    int priority = find_first_set_bit(cpu->ready_bitmap);
+    if (priority < 0) {
+        return NULL;
+    }
+    Queue *ready_queue = &cpu->ready_queues[priority];
+    pcb_t *proc = dequeue(ready_queue);
+    if (is_empty(ready_queue)) {
+        cpu->ready_bitmap &= ~(1UL << priority);
+    }
+    cpu->num_ready--;
+    return proc;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the highest priority ready process that this processor may run from the
+ * processor with the most ready processes that has one, and returns it, NULL if no
+ * other processor has such a process.
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *steal(void) {
+    int self = this_cpu()->index;
+    cpu_t *busiest = NULL;
+    pcb_t *proc = NULL;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        cpu_t *cpu = get_cpu(i);
+        if (i == self || cpu == NULL || cpu->num_ready == 0 || (busiest != NULL && cpu->num_ready <= busiest->num_ready)) {
+            continue;
+        }
+        pcb_t *allowed = first_allowed(cpu, self);
+        if (allowed != NULL) {
+            busiest = cpu;
+            proc = allowed;
+        }
+    }
+    if (proc != NULL) {
+        remove_from_ready_queue(proc);
+    }
+    return proc;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the highest priority process on the ready queues of the given processor
+ * that the processor with the given index may run, the first of them at that
+ * priority, NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *first_allowed(cpu_t *cpu, int cpu_index) {
+    for (int priority = 0; priority < NUM_PRIORITIES; priority++) {
+        if (!(cpu->ready_bitmap & (1UL << priority))) {
+            continue;
+        }
+        for (pcb_t *proc = cpu->ready_queues[priority].head; proc != NULL; proc = proc->next) {
+            if (CPU_ALLOWED(proc, cpu_index)) {
+                return proc;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the processor whose ready queues the given process is made ready on, the
+ * processor running the caller if the process may run on it, otherwise the allowed
+ * processor with the fewest ready processes.
+ *
+ * @return The processor, the one running the caller if no allowed processor runs
+ *         the dispatcher
+ *-----------------------------------------------------------------------------------
+ */
+static cpu_t *ready_cpu(pcb_t *proc) {
+    cpu_t *self = this_cpu();
+    if (CPU_ALLOWED(proc, self->index)) {
+        return self;
+    }
+    cpu_t *target = NULL;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        cpu_t *cpu = get_cpu(i);
+        if (cpu != NULL && CPU_ALLOWED(proc, i) && (target == NULL || cpu->num_ready < target->num_ready)) {
+            target = cpu;
+        }
+    }
+    return target == NULL ? self : target;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the priority the given process is scheduled at, the higher of its own
+ * priority and the priority it inherits.
+ *-----------------------------------------------------------------------------------
+ */
+static int sched_priority(pcb_t *proc) {
+    return proc->inherited_priority < proc->priority ? proc->inherited_priority : proc->priority;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Decides if the given process, which is being made ready, should pre-empt the
+ * given current process rather than wait for it to give up the processor. Under
+ * the stride scheduler only the real-time class and the idle process are
+ * pre-empted, as the order between other processes is decided on timer ticks.
+ *
+ * @return 1 if the process should run before the current process, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+static int outranks(pcb_t *proc, pcb_t *current) {
+    if (current == NULL || current == &idle_proc) {
+        return 1;
+    }
+    if (proc->rt_period > 0 || current->rt_period > 0) {
+        return proc->rt_period > 0 && current->rt_period == 0;
+    }
+    if (sched_policy == SCHED_STRIDE) {
+        return 0;
+    }
+    return sched_priority(proc) < sched_priority(current);
 }
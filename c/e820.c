@@ -0,0 +1,187 @@
+/* e820.c : the memory map of the BIOS
+ */
+
+#include <i386.h>
+#include <xeroskernel.h>
+#include <e820.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where the kernel learns which physical memory it has. Setup asks the BIOS
+ * for its memory map (int 0x15, eax = 0xe820) and startup.S saves the map before
+ * the bss is cleared, see e820.h. The entries of usable memory are turned into a
+ * short table of regions that kmeminit and setsegs size the memory with.
+ *
+ * Notes on the regions:
+ * - Only whole pages of memory below VSTACK_BASE are kept, the addresses above it
+ *   are taken by the process stacks in paging mode
+ * - Entries that overlap or touch are merged, so the regions are separate and in
+ *   increasing order. Entries of reserved memory are ignored, the BIOS does not give
+ *   out memory as both usable and reserved
+ * - Without a map from the BIOS, as when the kernel is loaded by the boot loader of
+ *   the lab, there is a single region of E820_DEFAULT_PAGES pages from address 0,
+ *   the memory the kernel has always assumed. The hole is reserved by kmeminit
+ *   either way
+ *
+ * List of functions that are called from outside this file:
+ * - e820_init
+ *   - Reads the map saved by startup.S, or assumes the default memory
+ * - e820_sanitize
+ *   - Returns the number of regions that the entries of a map are turned into
+ * - e820_region_count
+ *   - Returns the number of regions of usable memory
+ * - e820_get_region
+ *   - Returns a region of usable memory by its index
+ * - e820_find_region
+ *   - Returns the region that holds an address, NULL if it is not usable memory
+ * - e820_from_bios
+ *   - Returns 1 if the regions come from the BIOS, 0 if they are the default
+ *-----------------------------------------------------------------------------------
+ */
+
+// The memory assumed without a map
+#define E820_DEFAULT_PAGES 1024
+
+static int add_region(e820_region_t *regions, int count, int max_regions, unsigned long start, unsigned long end);
+
+// Saved by startup.S from E820_BOOT_ADDR
+extern e820_boot_map_t e820_boot_map;
+
+static e820_region_t usable_regions[E820_MAX_REGIONS];
+static int num_regions;
+static int from_bios;
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, from setsegs before the memory is sized. Reads
+ * the map saved by startup.S if setup left a complete one, otherwise assumes the
+ * default memory.
+ *-----------------------------------------------------------------------------------
+ */
+void e820_init(void) {
+    num_regions = 0;
+    if (e820_boot_map.signature == E820_SIGNATURE && e820_boot_map.count <= E820_MAX_ENTRIES) {
+        num_regions = e820_sanitize(e820_boot_map.entries, e820_boot_map.count, usable_regions, E820_MAX_REGIONS);
+    }
+    from_bios = num_regions > 0;
+    if (!from_bios) {
+        usable_regions[0].start = 0;
+        usable_regions[0].end = E820_DEFAULT_PAGES * NBPG;
+        num_regions = 1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Turns the entries of a map into the regions of usable memory they describe, in
+ * increasing order and merged where they overlap or touch. A region that does not
+ * fit in the table once it is full is dropped.
+ *
+ * @param entries     The entries of the map
+ * @param count       The number of entries
+ * @param regions     The table to fill
+ * @param max_regions The size of the table
+ * @return            The number of regions in the table
+ *-----------------------------------------------------------------------------------
+ */
+int e820_sanitize(e820_entry_t *entries, int count, e820_region_t *regions, int max_regions) {
+    int num = 0;
+    for (int i = 0; i < count; i++) {
+        e820_entry_t *entry = &entries[i];
+        if (entry->type != E820_RAM || entry->addr >= VSTACK_BASE) {
+            continue;
+        }
+        unsigned long long end = entry->addr + entry->size;
+        if (end > VSTACK_BASE || end < entry->addr) {
+            end = VSTACK_BASE;
+        }
+        unsigned long start = ((unsigned long) entry->addr + NBPG - 1) & ~(NBPG - 1);
+        unsigned long page_end = (unsigned long) end & ~(NBPG - 1);
+        if (start < page_end) {
+            num = add_region(regions, num, max_regions, start, page_end);
+        }
+    }
+    return num;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of regions of usable memory.
+ *-----------------------------------------------------------------------------------
+ */
+int e820_region_count(void) {
+    return num_regions;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the region of usable memory with the given index, the regions are in
+ * increasing order.
+ *
+ * @param index The index of the region, less than e820_region_count
+ * @return      The region, NULL if there is none with the index
+ *-----------------------------------------------------------------------------------
+ */
+e820_region_t *e820_get_region(int index) {
+    if (index < 0 || index >= num_regions) {
+        return NULL;
+    }
+    return &usable_regions[index];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the region of usable memory that holds the given address.
+ *
+ * @param addr The address
+ * @return     The region, NULL if the address is not in usable memory
+ *-----------------------------------------------------------------------------------
+ */
+e820_region_t *e820_find_region(unsigned long addr) {
+    for (int i = 0; i < num_regions; i++) {
+        if (addr >= usable_regions[i].start && addr < usable_regions[i].end) {
+            return &usable_regions[i];
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the regions come from the map of the BIOS, 0 if they are the default.
+ *-----------------------------------------------------------------------------------
+ */
+int e820_from_bios(void) {
+    return from_bios;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a region to a table of regions in increasing order, merging it with the
+ * regions it overlaps or touches.
+ *
+ * @return The number of regions in the table
+ *-----------------------------------------------------------------------------------
+ */
+static int add_region(e820_region_t *regions, int count, int max_regions, unsigned long start, unsigned long end) {
+    int first = 0;
+    while (first < count && regions[first].end < start) {
+        first++;
+    }
+    if (first < count && regions[first].start <= end) {
+        // Everything from first up to last is merged into first
+        int last = first;
+        while (last + 1 < count && regions[last + 1].start <= end) {
+            last++;
+        }
+        if (start < regions[first].start) {
+            regions[first].start = start;
+        }
+        regions[first].end = end > regions[last].end ? end : regions[last].end;
+        for (int i = last + 1; i < count; i++) {
+            regions[i - (last - first)] = regions[i];
+        }
+        return count - (last - first);
+    }
+    if (count == max_regions) {
+        return count;
+    }
+    for (int i = count; i > first; i--) {
+        regions[i] = regions[i - 1];
+    }
+    regions[first].start = start;
+    regions[first].end = end;
+    return count + 1;
+}
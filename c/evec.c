@@ -17,7 +17,7 @@ void initevec(void)
 	int		i;
 
         /* bzero( idt, sizeof( struct idt ) * 256 ); */
-	memset( idt, 0, sizeof( struct idt ) * 256 ); 
+	fill_words( idt, 0, sizeof( struct idt ) * 256 ); 
 
 	for (i=0; i<NID; ++i)
 		set_evec(i, (long)defevec[i]);
@@ -0,0 +1,324 @@
+/* format.c : buffered formatting */
+
+#include <xeroskernel.h>
+#include <format.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the formatter of kprintf and the logger process, which renders a format
+ * into a buffer instead of calling a function for every character as _doprnt does.
+ * The buffer is passed to a flush function whenever it fills up and once at the
+ * end, so a line of kprintf reaches the display in a single write that moves the
+ * cursor once.
+ *
+ * Notes on the formats:
+ * - The conversions, flags and fields are those of _doprnt, and give the same
+ *   output: %d, %u, %o, %x, %b and their capitals, %c, %s and %%, with -, 0, a
+ *   width or *, a precision for %s, and l, which is ignored as long is int
+ * - Hexadecimal digits are lower case for %x and %X alike, as in _doprnt
+ * - A conversion that is not known is output as its letter and takes an argument
+ * - Numbers are converted from the last digit, two decimal digits at a time
+ *
+ * List of functions that are called from outside this file:
+ * - format_buffer
+ *   - Formats into a buffer, flushing it whenever it fills up
+ * - format_string
+ *   - Formats into a string, truncating the output
+ *-----------------------------------------------------------------------------------
+ */
+
+// Where the output of a format goes
+typedef struct format_sink {
+    char *buf;
+    int size;
+    // Characters in the buffer, and written in all
+    int len;
+    int written;
+    void (*flush)(char *buf, int len);
+} format_sink_t;
+
+static void put_char(format_sink_t *sink, char c);
+static void put_chars(format_sink_t *sink, char *str, int len);
+static void put_fill(format_sink_t *sink, char fill, int count);
+static char *convert(unsigned long num, int base, char *end);
+
+// The decimal digits of 0 to 99, two to a number
+static char const decimal_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+/*-----------------------------------------------------------------------------------
+ * Formats the arguments into a buffer. If a flush function is given, the buffer is
+ * passed to it whenever it fills up and once at the end with what is left, and is
+ * not terminated. Otherwise the output is truncated to the buffer, and terminated
+ * with a null character.
+ *
+ * @param buf   The buffer to format into
+ * @param size  The size of the buffer, at least 1
+ * @param flush The function the full buffer is passed to, NULL to truncate
+ * @param fmt   The format
+ * @param ap    The arguments of the format
+ * @return      The number of characters written, to the flush function or kept in
+ *              the buffer, not counting the null character
+ *-----------------------------------------------------------------------------------
+ */
+int format_buffer(char *buf, int size, void (*flush)(char *buf, int len), char *fmt, va_list ap) {
+    format_sink_t sink;
+    sink.buf = buf;
+    sink.size = size;
+    sink.len = 0;
+    sink.written = 0;
+    sink.flush = flush;
+
+    for (;;) {
+        // Characters up to the next conversion are copied as they are
+        char *run = fmt;
+        while (*fmt != '%' && *fmt != '\0') {
+            fmt++;
+        }
+        put_chars(&sink, run, fmt - run);
+        if (*fmt == '\0') {
+            break;
+        }
+        fmt++;
+        if (*fmt == '%') {
+            put_char(&sink, *fmt++);
+            continue;
+        }
+
+        int leftjust = 0;
+        if (*fmt == '-') {
+            leftjust = 1;
+            fmt++;
+        }
+        char fill = ' ';
+        if (*fmt == '0') {
+            fill = *fmt++;
+        }
+        int fmin = 0;
+        if (*fmt == '*') {
+            fmin = va_arg(ap, int);
+            fmt++;
+        } else {
+            while ('0' <= *fmt && *fmt <= '9') {
+                fmin = fmin * 10 + *fmt++ - '0';
+            }
+        }
+        int fmax = 0;
+        if (*fmt == '.') {
+            if (*++fmt == '*') {
+                fmax = va_arg(ap, int);
+                fmt++;
+            } else {
+                while ('0' <= *fmt && *fmt <= '9') {
+                    fmax = fmax * 10 + *fmt++ - '0';
+                }
+            }
+        }
+        if (fmin > FORMAT_MAX_WIDTH || fmin < 0) {
+            fmin = 0;
+        }
+        if (fmax > FORMAT_MAX_WIDTH || fmax < 0) {
+            fmax = 0;
+        }
+        if (*fmt == 'l') {
+            fmt++;
+        }
+        char f = *fmt++;
+        if (f == '\0') {
+            put_char(&sink, '%');
+            break;
+        }
+
+        // Big enough for 32 binary digits
+        char digits[33];
+        char *end = digits + sizeof(digits);
+        char *str = end;
+        char sign = '\0';
+        switch (f) {
+            case 'c':
+                digits[0] = (char) va_arg(ap, int);
+                str = digits;
+                end = digits[0] != '\0' ? digits + 1 : digits;
+                fmax = 0;
+                fill = ' ';
+                break;
+            case 's':
+                str = va_arg(ap, char *);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                // Only as much of the string as the precision takes is looked at
+                for (end = str; *end != '\0' && (fmax == 0 || end - str < fmax); end++) {
+                }
+                fill = ' ';
+                break;
+            case 'D':
+            case 'd': {
+                long num = va_arg(ap, long);
+                if (num < 0) {
+                    sign = '-';
+                }
+                str = convert(num < 0 ? 0UL - (unsigned long) num : (unsigned long) num, 10, end);
+                fmax = 0;
+                break;
+            }
+            case 'U':
+            case 'u':
+                str = convert(va_arg(ap, unsigned long), 10, end);
+                fmax = 0;
+                break;
+            case 'O':
+            case 'o':
+                str = convert(va_arg(ap, unsigned long), 8, end);
+                fmax = 0;
+                break;
+            case 'X':
+            case 'x':
+                str = convert(va_arg(ap, unsigned long), 16, end);
+                fmax = 0;
+                break;
+            case 'B':
+            case 'b':
+                str = convert(va_arg(ap, unsigned long), 2, end);
+                fmax = 0;
+                break;
+            default:
+                put_char(&sink, f);
+                (void) va_arg(ap, int);
+                break;
+        }
+
+        int length = end - str;
+        int leading = 0;
+        if (fmax != 0 || fmin != 0) {
+            if (fmax != 0 && length > fmax) {
+                length = fmax;
+            }
+            if (fmin != 0) {
+                leading = fmin - length;
+            }
+            if (sign == '-') {
+                leading--;
+            }
+        }
+        if (sign == '-' && fill == '0') {
+            put_char(&sink, sign);
+        }
+        if (!leftjust) {
+            put_fill(&sink, fill, leading);
+        }
+        if (sign == '-' && fill == ' ') {
+            put_char(&sink, sign);
+        }
+        put_chars(&sink, str, length);
+        if (leftjust) {
+            put_fill(&sink, fill, leading);
+        }
+    }
+
+    if (flush != NULL) {
+        if (sink.len > 0) {
+            flush(buf, sink.len);
+        }
+    } else {
+        buf[sink.len] = '\0';
+    }
+    return sink.written;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Formats the arguments into a string, truncating the output to the size of the
+ * string.
+ *
+ * @param buf  The string to format into
+ * @param size The size of the string, at least 1
+ * @param fmt  The format
+ * @param ...  The arguments of the format
+ * @return     The number of characters kept in the string, not counting the null
+ *             character
+ *-----------------------------------------------------------------------------------
+ */
+int format_string(char *buf, int size, char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int written = format_buffer(buf, size, NULL, fmt, ap);
+    va_end(ap);
+    return written;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a character to the output of a format. A full buffer is flushed first, or
+ * if there is no flush function the character is dropped, the last character of
+ * the buffer being kept for the null character.
+ *-----------------------------------------------------------------------------------
+ */
+static void put_char(format_sink_t *sink, char c) {
+    if (sink->flush == NULL) {
+        if (sink->len >= sink->size - 1) {
+            return;
+        }
+    } else if (sink->len == sink->size) {
+        sink->flush(sink->buf, sink->len);
+        sink->len = 0;
+    }
+    sink->buf[sink->len++] = c;
+    sink->written++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given number of characters to the output of a format.
+ *-----------------------------------------------------------------------------------
+ */
+static void put_chars(format_sink_t *sink, char *str, int len) {
+    for (int i = 0; i < len; i++) {
+        put_char(sink, str[i]);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given number of fill characters to the output of a format, none if the
+ * number is not positive.
+ *-----------------------------------------------------------------------------------
+ */
+static void put_fill(format_sink_t *sink, char fill, int count) {
+    for (int i = 0; i < count; i++) {
+        put_char(sink, fill);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Converts a number to its digits in the given base, from the last digit back. The
+ * decimal digits are taken two at a time, halving the divisions.
+ *
+ * @param num  The number to convert
+ * @param base 2, 8, 10 or 16
+ * @param end  The address just past where the last digit goes
+ * @return     The address of the first digit
+ *-----------------------------------------------------------------------------------
+ */
+static char *convert(unsigned long num, int base, char *end) {
+    char *str = end;
+    if (base == 10) {
+        while (num >= 100) {
+            unsigned long pair = (num % 100) * 2;
+            num /= 100;
+            *--str = decimal_pairs[pair + 1];
+            *--str = decimal_pairs[pair];
+        }
+        if (num >= 10) {
+            *--str = decimal_pairs[num * 2 + 1];
+            *--str = decimal_pairs[num * 2];
+        } else {
+            *--str = '0' + num;
+        }
+        return str;
+    }
+    // The bases that are powers of 2 are converted with shifts
+    int shift = base == 16 ? 4 : base == 8 ? 3 : 1;
+    do {
+        *--str = "0123456789abcdef"[num & (base - 1)];
+        num >>= shift;
+    } while (num != 0);
+    return str;
+}
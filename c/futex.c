@@ -0,0 +1,103 @@
+/* futex.c : futex wait queues
+ */
+
+#include <xeroskernel.h>
+#include <queue.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the futex system, which blocks processes on an integer in their own
+ * memory. It is the slow path of the semaphores, mutexes and condition variables
+ * in sync.c, which change the integer with atomic instructions and only make a
+ * system call when a process has to wait or a waiting process has to be woken.
+ *
+ * Notes on futexes:
+ * - sysfutexwait blocks only if the integer still holds the value the process
+ *   expects, the check and the block are done with the kernel lock held, so a wake
+ *   made after the value changed is never missed
+ * - There is no futex object, waiters are hashed by address into one of
+ *   FUTEX_BUCKETS wait queues and a wake takes the waiters on the given address
+ *   from its bucket, earliest first
+ * - A bucket is a queue of processes, so a waiter interrupted by a signal is taken
+ *   off it like a process waiting on a message port
+ *
+ * List of functions that are called from outside this file:
+ * - kfutexinit
+ *   - Initializes the futex wait queues to empty
+ * - futex_wait
+ *   - Implements the kernel side of sysfutexwait
+ * - futex_wake
+ *   - Implements the kernel side of sysfutexwake
+ *-----------------------------------------------------------------------------------
+ */
+
+static Queue *bucket_of(int *addr);
+
+static Queue futex_buckets[FUTEX_BUCKETS];
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any process waits on a futex. Empties the wait queues.
+ *-----------------------------------------------------------------------------------
+ */
+void kfutexinit(void) {
+    for (int i = 0; i < FUTEX_BUCKETS; i++) {
+        init_queue(&futex_buckets[i]);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysfutexwait. Blocks the given process on the given
+ * address if the integer there holds the expected value.
+ *
+ * @param proc     A pointer to the PCB of the calling process
+ * @param addr     The address of the integer, validated by the dispatcher
+ * @param expected The value the integer must hold for the process to block
+ * @return         −1 if the process was blocked, or −2 if the integer does not hold
+ *                 the expected value
+ *-----------------------------------------------------------------------------------
+ */
+int futex_wait(pcb_t *proc, int *addr, int expected) {
+    if (*addr != expected) {
+        return -2;
+    }
+    Queue *bucket = bucket_of(addr);
+    proc->futex_addr = addr;
+    proc->wait_queue = bucket;
+    proc->state = BLOCKED;
+    proc->blocked_queue = FUTEX;
+    enqueue(bucket, proc);
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysfutexwake. Unblocks up to the given number of
+ * processes waiting on the given address, earliest first, with 0.
+ *
+ * @param addr  The address of the integer
+ * @param count The most processes to unblock
+ * @return      The number of processes unblocked
+ *-----------------------------------------------------------------------------------
+ */
+int futex_wake(int *addr, int count) {
+    Queue *bucket = bucket_of(addr);
+    int woken = 0;
+    pcb_t *proc = bucket->head;
+    while (proc != NULL && woken < count) {
+        pcb_t *next_proc = proc->next;
+        if (proc->futex_addr == addr) {
+            remove(bucket, proc);
+            proc->result_code = 0;
+            ready(proc);
+            woken++;
+        }
+        proc = next_proc;
+    }
+    return woken;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the wait queue processes waiting on the given address are placed on.
+ *-----------------------------------------------------------------------------------
+ */
+static Queue *bucket_of(int *addr) {
+    return &futex_buckets[((unsigned long) addr >> 2) & (FUTEX_BUCKETS - 1)];
+}
@@ -4,6 +4,7 @@
 #include <i386.h>
 #include <xeroslib.h>
 #include <xeroskernel.h>
+#include <e820.h>
 
 
 #define BOOTP_CODE
@@ -36,12 +37,15 @@ char	*maxaddr;       /* end of memory space */
 
 
 /*------------------------------------------------------------------------
- * sizmem - return memory size (in pages)
+ * sizmem - return memory size (in pages), up to the end of the last
+ * region of usable memory in the memory map
  *------------------------------------------------------------------------
  */
 long sizmem(void)
 {
-        return 1024;
+        e820_region_t *last = e820_get_region(e820_region_count() - 1);
+
+        return last->end / NBPG;
 }
 
 
@@ -55,6 +59,7 @@ void setsegs(void)
 	struct sd	*psd;
 	unsigned int	np, npages;
 
+	e820_init();
 	npages = sizmem();
 	maxaddr = (char *)(npages * NBPG - 1);
 
@@ -63,13 +68,17 @@ void setsegs(void)
 	psd->sd_lolimit = np;
 	psd->sd_hilimit = np >> 16;
 
+	/* in paging mode, process stacks are above physical memory, and
+	   with SMP the local APIC is at the top of the address space */
+	np = (PAGING_ENABLED || SMP_ENABLED) ? 0xfffff : npages;
+
 	psd = &gdt_copy[2];	/* kernel data segment */
-	psd->sd_lolimit = npages;
-	psd->sd_hilimit = npages >> 16;
+	psd->sd_lolimit = np;
+	psd->sd_hilimit = np >> 16;
 
 	psd = &gdt_copy[3];	/* kernel stack segment */
-	psd->sd_lolimit = npages;
-	psd->sd_hilimit = npages >> 16;
+	psd->sd_lolimit = np;
+	psd->sd_hilimit = np >> 16;
 
 	psd = &gdt_copy[4];	/* bootp code segment */
 	psd->sd_lolimit = npages;   /* Allows execution of 0x100000 CODE */
@@ -120,6 +129,57 @@ void initPIT( int divisor )
 }
 
 
+/*------------------------------------------------------------------------
+ * oneshotPIT - interrupt once after count timer cycles, the terminal
+ * count mode is used as the gate of counter 0 is always high
+ *------------------------------------------------------------------------
+ */
+void oneshotPIT( unsigned int count )
+{
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_INTTC | TIMER_16BIT );
+        outb( TIMER_1_PORT, count & 0xff );
+        outb( TIMER_1_PORT, count >> 8 );
+}
+
+
+/*------------------------------------------------------------------------
+ * readPIT - read the current count of counter 0
+ *------------------------------------------------------------------------
+ */
+unsigned int readPIT( void )
+{
+        unsigned int    lo;
+
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_LATCH );
+        lo = inb( TIMER_CNTR0 );
+        return lo | ( inb( TIMER_CNTR0 ) << 8 );
+}
+
+
+/*------------------------------------------------------------------------
+ * firedPIT - check if counter 0 has reached its terminal count, using
+ * the read-back status of the 8254
+ *------------------------------------------------------------------------
+ */
+int firedPIT( void )
+{
+        outb( TIMER_MODE, TIMER_READBACK_STATUS0 );
+        return ( inb( TIMER_CNTR0 ) & TIMER_STATUS_OUT ) != 0;
+}
+
+
+/*------------------------------------------------------------------------
+ * pendingPIT - check if an interrupt from counter 0 is waiting to be
+ * serviced, using the interrupt request register of the 8259A
+ *------------------------------------------------------------------------
+ */
+int pendingPIT( void )
+{
+        outb( OCR, OCW3_READ_IRR );
+        return ( inb( OCR ) & ( 1 << TIMER_IRQ ) ) != 0;
+}
+
+
 /*------------------------------------------------------------------------
  * end_of_intr - signal EOI to rearm hardware interrupts
  *------------------------------------------------------------------------
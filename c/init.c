@@ -3,6 +3,8 @@
 #include <i386.h>
 #include <xeroskernel.h>
 #include <xeroslib.h>
+#include <slab.h>
+#include <bufcache.h>
 
 extern int entry(void); /* start of kernel image, use &start    */
 extern int end(void);   /* end of kernel image, use &end        */
@@ -24,66 +26,117 @@ extern unsigned long max_addr_aligned;
 /***								                                  ***/
 /************************************************************************/
 
+// Phases of booting whose time is reported before the first process is created
+#define MAX_BOOT_PHASES 32
+
+// Runs a phase of booting and records the cycles it took under the given name
+#define BOOT_PHASE(name, call) \
+    do { unsigned long long phase_start = read_tsc(); call; record_boot_phase(name, phase_start); } while (0)
+
+typedef struct boot_phase {
+    char *name;
+    unsigned long long cycles;
+} boot_phase_t;
+
+static void print_samples(void);
+static void record_boot_phase(char *name, unsigned long long start);
+static void report_boot_phases(unsigned long long boot_cycles);
+
+static boot_phase_t boot_phases[MAX_BOOT_PHASES];
+static int num_boot_phases;
+
 /*------------------------------------------------------------------------
  *  The init process, this is where it all begins...
  *------------------------------------------------------------------------
  */
 void initproc(void)                /* The beginning */
 {
-
-    char str[1024];
-    int a = sizeof(str);
-    int b = -17;
+    unsigned long long boot_start = read_tsc();
     int i;
 
     kprintf("\n\nCPSC 415, 2018W2 \n32 Bit Xeros -21.0.0 - even before beta \nLocated at: %x to %x\n",
             &entry, &end);
 
-    kprintf("Some sample output to illustrate different types of printing\n\n");
-
-    /* A busy wait to pause things on the screen, Change the value used
-       in the termination condition to control the pause
-     */
-
-    for (i = 0; i < 3000000; i++);
-
-    /* Build a string to print) */
-    sprintf(str,
-            "This is the number -17 when printed signed %d unsigned %u hex %x and a string %s.\n      Sample printing of 1024 in signed %d, unsigned %u and hex %x.",
-            b, b, b, "Hello", a, a, a);
-
-    /* Print the string */
-
-    kprintf("\n\nThe %dstring is: \"%s\"\n\nThe formula is %d + %d = %d.\n\n\n",
-            a, str, a, b, a + b);
-
-    for (i = 0; i < 4000000; i++);
-    /* or just on its own */
-    kprintf(str);
+    // The sample output and its pauses are left out of a fast boot
+    if (!FAST_BOOT) BOOT_PHASE("samples", print_samples());
 
     /* Add your code below this line and before next comment */
 
+    if (RUN_TESTS) BOOT_PHASE("tests", run_util_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_format_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_string_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_e820_test());
     // Initialize data structures
     // Initialize free list
-    kmeminit();
-    run_mem_test();
+    BOOT_PHASE("kmeminit", kmeminit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_mem_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_page_test());
+    if (BENCH) run_boot_bench();
+    if (BENCH) run_string_bench();
+    // Pre-warm the pool of process stacks
+    BOOT_PHASE("kstackinit", kstackinit());
+    if (BENCH) run_alloc_bench();
+    // Map process stacks on demand
+    if (PAGING_ENABLED) BOOT_PHASE("kpaginginit", kpaginginit());
+    // Initialize object caches
+    BOOT_PHASE("kslabinit", kslabinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_slab_test());
+    // Message ports are allocated from their own object cache
+    BOOT_PHASE("kportinit", kportinit());
+    BOOT_PHASE("kpgrpinit", kpgrpinit());
+    // Shared memory segments are too
+    BOOT_PHASE("kshminit", kshminit());
+    BOOT_PHASE("kfutexinit", kfutexinit());
+    BOOT_PHASE("kpollinit", kpollinit());
+    // The ISRs of the devices defer their work to the work queue
+    BOOT_PHASE("kworkinit", kworkinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_workq_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_ldisc_test());
+    // Block devices share the buffer cache
+    BOOT_PHASE("kbufinit", kbufinit());
 
     // Initialize process table and process queues
-    run_queue_test();
-    run_deltalist_test();
-    kdispinit();
-    ksleepinit();
+    if (RUN_TESTS) BOOT_PHASE("tests", run_queue_test());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_timerwheel_test());
+    // Per-processor state, taking the kernel lock for the rest of the initialization
+    BOOT_PHASE("ksmpinit", ksmpinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_smp_test());
+    // Log records are kept per processor
+    BOOT_PHASE("kloginit", kloginit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_klog_test());
+    // Events are recorded with the processor they happened on
+    BOOT_PHASE("ktraceinit", ktraceinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_trace_test());
+    BOOT_PHASE("kprofileinit", kprofileinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_profile_test());
+    BOOT_PHASE("kdispinit", kdispinit(SCHED_POLICY));
+    // Spans with interrupts disabled are named after the system calls now registered
+    BOOT_PHASE("klatencyinit", klatencyinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_latency_test());
+    // Scheduling policy tunables, set before any process is created
+    mlfq_config_t mlfq_config = {MLFQ_ENABLED, MLFQ_DEMOTE_QUANTA, MLFQ_WAKE_BOOST, MLFQ_AGING_INTERVAL};
+    BOOT_PHASE("kmlfqinit", kmlfqinit(&mlfq_config));
+    BOOT_PHASE("krealtimeinit", krealtimeinit());
+    if (RUN_TESTS) BOOT_PHASE("tests", run_realtime_test());
+    BOOT_PHASE("ksleepinit", ksleepinit());
 
     // Initialize interrupt table
-    contextinit();
+    BOOT_PHASE("contextinit", contextinit());
     // Initialize device table and devices
-    kdiinit();
+    BOOT_PHASE("kdiinit", kdiinit());
+    // Start the other processors, they wait for the kernel lock
+    BOOT_PHASE("smp_boot_aps", smp_boot_aps());
 
     // Pre-emption: 10ms time slice
     if (PREEMPTION_ENABLED) initPIT(1000 / TIME_SLICE);
 
+    report_boot_phases(read_tsc() - boot_start);
+
     // Create the init process
     create(&init, PROCESS_STACK_SIZE);
+    // The deferred work of the ISRs runs in its own process, after init so that
+    // init keeps PID 1
+    kworkstart();
     // Enter the dispatcher
     dispatch();
 
@@ -94,3 +147,77 @@ void initproc(void)                /* The beginning */
     kprintf("this line should never be printed!\n");
     for (;;); /* loop forever */
 }
+
+/*------------------------------------------------------------------------
+ * Prints the sample output, pausing with busy waits so that it can be
+ * read on the screen.
+ *------------------------------------------------------------------------
+ */
+static void print_samples(void) {
+    char str[1024];
+    int a = sizeof(str);
+    int b = -17;
+    int i;
+
+    kprintf("Some sample output to illustrate different types of printing\n\n");
+
+    /* A busy wait to pause things on the screen, Change the value used
+       in the termination condition to control the pause
+     */
+
+    for (i = 0; i < 3000000; i++);
+
+    /* Build a string to print) */
+    sprintf(str,
+            "This is the number -17 when printed signed %d unsigned %u hex %x and a string %s.\n      Sample printing of 1024 in signed %d, unsigned %u and hex %x.",
+            b, b, b, "Hello", a, a, a);
+
+    /* Print the string */
+
+    kprintf("\n\nThe %dstring is: \"%s\"\n\nThe formula is %d + %d = %d.\n\n\n",
+            a, str, a, b, a + b);
+
+    for (i = 0; i < 4000000; i++);
+    /* or just on its own */
+    kprintf(str);
+}
+
+/*------------------------------------------------------------------------
+ * Adds the cycles since the given time stamp to the boot phase with the
+ * given name, which is added if it is not there yet, so that phases run
+ * several times, such as the tests, are reported once.
+ *
+ * @param name  The name of the phase, a string constant
+ * @param start The time stamp counter when the phase started
+ *------------------------------------------------------------------------
+ */
+static void record_boot_phase(char *name, unsigned long long start) {
+    unsigned long long cycles = read_tsc() - start;
+    for (int i = 0; i < num_boot_phases; i++) {
+        if (strcmp_words(boot_phases[i].name, name) == 0) {
+            boot_phases[i].cycles += cycles;
+            return;
+        }
+    }
+    if (num_boot_phases < MAX_BOOT_PHASES) {
+        boot_phases[num_boot_phases].name = name;
+        boot_phases[num_boot_phases].cycles = cycles;
+        num_boot_phases++;
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Prints the time of every boot phase in the order they were first run,
+ * one per line starting with BOOT, and the time of the whole boot, in
+ * units of 1024 cycles.
+ *
+ * @param boot_cycles The cycles taken from initproc to the first process
+ *------------------------------------------------------------------------
+ */
+static void report_boot_phases(unsigned long long boot_cycles) {
+    for (int i = 0; i < num_boot_phases; i++) {
+        kprintf("BOOT %s %u kcycles\n", boot_phases[i].name,
+                (unsigned long) (boot_phases[i].cycles >> 10));
+    }
+    kprintf("BOOT total %u kcycles\n", (unsigned long) (boot_cycles >> 10));
+}
@@ -2,6 +2,7 @@
 
 #include <xeroskernel.h>
 #include <kbd.h>
+#include <ldisc.h>
 #include <xeroslib.h>
 #include <i386.h>
 #include <stdarg.h>
@@ -11,9 +12,16 @@
  * independent calls will call the corresponding device specific device driver
  * function.
  *
+ * Notes on the keyboard:
+ * - The keyboard reads through the tty line discipline of ldisc.c, which edits the
+ *   typed line, and passes it on to every process that has the keyboard open
+ * - Up to LDISC_MAX_READERS processes may have the keyboard open at a time, each
+ *   through either of KBD_0 and KBD_1, which only differ in whether echo starts on
+ * - The keyboard hardware is enabled while any process has the keyboard open
+ *
  * List of functions that are called from outside this file:
- * - kbd_devsw_init
- *   - Initializes the keyboard device
+ * - kbd_register
+ *   - Registers the keyboard devices
  * - kbdinit
  *   - Keyboard specific call for di_init
  * - kbdopen
@@ -26,84 +34,73 @@
  *   - Keyboard specific call for di_write
  * - kbdioctl
  *   - Keyboard specific call for di_ioctl
+ * - kbdpoll
+ *   - Keyboard specific call for syspoll
+ * - kbdaioread
+ *   - Keyboard specific call for di_aioread
  * - kbd_isr
- *   - Keyboard ISR
+ *   - Keyboard ISR, which defers all but reading the scancode to the work queue
  *-----------------------------------------------------------------------------------
  */
 
-static void finish_read(void);
-static void kbd_reset(void);
-static void flush_kbd_buf(void);
-static int is_kbd_buf_full(void);
-static void write_to_kbd_buf(char c);
-static int transfer_to_read_buf(void);
-static int copy_char_to_read_buf(char c);
-static void handle_eof(void);
+static void kbd_work_func(work_t *work);
+static void kbd_echo(char c);
 static void disable_keyboard_hardware(void);
 static int kbdioctl_change_eof(void *ioctl_args);
+static int kbdioctl_get_stats(void *ioctl_args);
 static unsigned int kbtoa(unsigned char code);
 
-// Internally buffer up to 4 chars via a circular buffer
-// Use 1 index to indicate a full buffer
-static char kbd_buf[KBD_BUFFER_SIZE];
-// The next position in the buffer to place new char (moving from left to right)
-static int kbd_buf_head;
-// The ending position of buffered chars
-static int kbd_buf_tail;
-
-// Application read buffer, NULL if sysread has not been called
-static char *read_buf;
-// Application read buffer length
-static int read_buflen;
-// Chars transferred to application read buffer
-int chars_transferred;
-// Whether the read request has been fully serviced
-static int read_finished;
-
-// Current EOF char
-static unsigned char eof;
-static int eof_flag;
-
-// echo_flag and kbd_proc are not reset by kbd_reset
-static int echo_flag;
-// The process that is using the keyboard, NULL if it is not in use
-static pcb_t *kbd_proc;
+// The scancodes read by kbd_isr that kbd_work_func has yet to translate, counted
+// from the start and masked into the ring
+static unsigned char scancode_buf[KBD_SCANCODE_SIZE];
+static unsigned int scancode_head;
+static unsigned int scancode_tail;
+// Scancodes dropped while their ring was full
+static unsigned int scancodes_dropped;
+// The work item kbd_isr queues for kbd_work_func
+static work_t kbd_work;
+
+// The line discipline the typed chars are passed to, which holds the processes
+// that have the keyboard open
+static ldisc_t kbd_ldisc;
 
 static int kbd_state; /* the state of the keyboard */
 
+// The device structures of KBD_0 and KBD_1 registered in the device table
+static devsw_t kbd_devsw[2];
+
 /*===================== KEYBOARD DEVICE DRIVER UPPER HALF =========================*/
 
 /*-----------------------------------------------------------------------------------
- * Initializes the given keyboard device structure with the given kbd.
- *
- * @param kbd   The keyboard device type, one of KBD_0 or KBD_1
- * @param devsw The device structure
+ * Registers the 2 keyboard devices as KBD_0 and KBD_1, which share the driver.
  *-----------------------------------------------------------------------------------
  */
-void kbd_devsw_init(devsw_t *devsw, dev_t kbd) {
-    if (kbd == KBD_0) {
-        devsw->dvname = "/dev/keyboard0";
-        devsw->dvnum = KBD_0;
-    } else {
-        devsw->dvname = "/dev/keyboard1";
-        devsw->dvnum = KBD_1;
+void kbd_register(void) {
+    for (int i = 0; i < 2; i++) {
+        devsw_t *devsw = &kbd_devsw[i];
+        devsw->dvioblk = NULL;
+        devsw->dvinit = &kbdinit;
+        devsw->dvopen = &kbdopen;
+        devsw->dvclose = &kbdclose;
+        devsw->dvread = &kbdread;
+        devsw->dvwrite = &kbdwrite;
+        devsw->dvioctl = &kbdioctl;
+        devsw->dvpoll = &kbdpoll;
+        devsw->dvaioread = &kbdaioread;
     }
-    devsw->dvinit = &kbdinit;
-    devsw->dvopen = &kbdopen;
-    devsw->dvclose = &kbdclose;
-    devsw->dvread = &kbdread;
-    devsw->dvwrite = &kbdwrite;
-    devsw->dvioctl = &kbdioctl;
+    di_register(&kbd_devsw[0], "/dev/keyboard0", KBD_0, 0);
+    di_register(&kbd_devsw[1], "/dev/keyboard1", KBD_1, 1);
 }
 
 /*-----------------------------------------------------------------------------------
- * Initializes the keyboard device.
+ * Initializes the keyboard device. Called once for each of the 2 devices.
  *
  * @return 0 on success
  *-----------------------------------------------------------------------------------
  */
 int kbdinit(void) {
-    kbd_reset();
+    init_work(&kbd_work, &kbd_work_func);
+    ldisc_init(&kbd_ldisc, &kbd_echo);
     // Read from data and control ports to handle previous interrupts
     inb(DATA_PORT);
     inb(CONTROL_PORT);
@@ -111,46 +108,52 @@ int kbdinit(void) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Keyboard specific call for di_open. Sets up the device access.
+ * Keyboard specific call for di_open. Sets up the device access, and enables the
+ * keyboard hardware for the first process to open the keyboard.
  *
+ * @param devsw     The device structure
  * @param proc      The process that called sysopen
- * @param device_no The major device number
- * @return          0 on success, -1 on failure
+ * @param device_no The major device number, echo starts on for KBD_1
+ * @return          0 on success, -1 if the process already has the keyboard open
+ *                  or LDISC_MAX_READERS processes do
  *-----------------------------------------------------------------------------------
  */
-int kbdopen(pcb_t *proc, int device_no) {
-    // Only one process is allowed to use the keyboard at a time
-    if (kbd_proc) {
+int kbdopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    int first = kbd_ldisc.num_readers == 0;
+    if (ldisc_open(&kbd_ldisc, proc, device_no == KBD_1) < 0) {
         return -1;
     }
+    if (first) {
+        scancode_head = 0;
+        scancode_tail = 0;
+        scancodes_dropped = 0;
+        kbd_state = 0;
 
-    kbd_reset();
-    echo_flag = device_no == KBD_0 ? 0 : 1;
-    kbd_proc = proc;
-
-    // Enable keyboard
-    outb(CONTROL_PORT, 0xAE);
-
-    // Enable the keyboard interrupts through the APIC
-    enable_irq(KEYBOARD_IRQ, 0);
+        // Enable keyboard
+        outb(CONTROL_PORT, 0xAE);
 
+        // Enable the keyboard interrupts through the APIC
+        enable_irq(KEYBOARD_IRQ, 0);
+    }
     return 0;
 }
 
 /*-----------------------------------------------------------------------------------
- * Keyboard specific call for di_close. Terminates device access.
+ * Keyboard specific call for di_close. Terminates device access, and disables the
+ * keyboard hardware once the last process has closed the keyboard.
  *
- * @param proc The process that called sysclose
- * @return     0 on success, -1 on failure
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success, -1 on failure
  *-----------------------------------------------------------------------------------
  */
-int kbdclose(pcb_t *proc) {
-    kbd_reset();
-    echo_flag = 0;
-    kbd_proc = NULL;
-
-    disable_keyboard_hardware();
-
+int kbdclose(devsw_t *devsw, pcb_t *proc) {
+    if (ldisc_close(&kbd_ldisc, proc) < 0) {
+        return -1;
+    }
+    if (kbd_ldisc.num_readers == 0) {
+        disable_keyboard_hardware();
+    }
     return 0;
 }
 
@@ -159,70 +162,86 @@ int kbdclose(pcb_t *proc) {
  * keyboard, all calls to syswrite will result in an error indication (-1) being
  * returned.
  *
+ * @param devsw  The device structure
  * @param proc   The process that called syswrite
  * @param buf    The buffer to write from
  * @param buflen The upper limit of bytes to write from buf
  * @return       -1 as writes are not supported to the keyboard
  *-----------------------------------------------------------------------------------
  */
-int kbdwrite(pcb_t *proc, void *buf, int buflen) {
+int kbdwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
     return -1;
 }
 
 /*-----------------------------------------------------------------------------------
- * Keyboard specific call for di_read.
+ * Keyboard specific call for di_read. A read is complete once it has any of the
+ * input passed on by the line discipline, up to the end of a line, so in canonical
+ * mode once a line has been typed.
  *
- * @param proc   The process that called sysread
- * @param buf    The buffer to write from
- * @param buflen The upper limit of bytes to write from buf
- * @return       The number of bytes read on success
- *               0 to indicate end-of-file (EOF)
- *               -1 if there was an error
- *               -2 if the sysread call should block
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF)
+ *                    -1 if there was an error
+ *                    BLOCKERR if there is no input in non-blocking mode
+ *                    -2 if the sysread call should block
  *-----------------------------------------------------------------------------------
  */
-int kbdread(pcb_t *proc, void *buf, int buflen) {
-    // An EOF was typed: no more input follows, return an end-of-file (EOF) indication (i.e. a 0 on a sysread call)
-    // Subsequent sysread operations on this descriptor should continue to return the EOF indication
-    if (eof_flag) {
-        return 0;
-    }
-
-    read_buf = (char *) buf;
-    read_buflen = buflen;
+int kbdread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    return ldisc_read(&kbd_ldisc, proc, buf, buflen, nonblocking);
+}
 
-    transfer_to_read_buf();
-    if (chars_transferred == read_buflen) {
-        return read_buflen;
-    } else {
-        // Block calling process until the request is fully serviced
-        read_finished = 0;
-        return -2;
-    }
+/*-----------------------------------------------------------------------------------
+ * Keyboard specific call for di_aioread. Starts a read that is serviced like a
+ * sysread, without blocking the calling process. When the read completes, the
+ * given signal is queued for the process with the number of bytes read as its
+ * value, 0 for an end-of-file (EOF).
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into, filled in while the process runs
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              0 if the read was started, -1 if one is already in progress
+ *-----------------------------------------------------------------------------------
+ */
+int kbdaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return ldisc_aioread(&kbd_ldisc, proc, buf, buflen, signal_number);
 }
 
 /*-----------------------------------------------------------------------------------
  * Keyboard specific call for di_ioctl.
  *
+ * @param devsw      The device structure
  * @param proc       The process that called sysioctl
  * @param command    The control command
  * @param ioctl_args Additional parameters
  * @return           0 on success, -1 if there was an error
  *-----------------------------------------------------------------------------------
  */
-int kbdioctl(pcb_t *proc, unsigned long command, void *ioctl_args) {
+int kbdioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
     switch (command) {
         case (IOCTL_CHANGE_EOF):
             // Change the char that indicates an EOF
             return kbdioctl_change_eof(ioctl_args);
         case (IOCTL_ECHO_OFF):
-            // Turn echoing off
-            echo_flag = 0;
-            return 0;
+            // Turn echoing off for the calling process
+            return ldisc_set_echo(&kbd_ldisc, proc, 0);
         case (IOCTL_ECHO_ON):
-            // Turn echoing on
-            echo_flag = 1;
-            return 0;
+            // Turn echoing on for the calling process
+            return ldisc_set_echo(&kbd_ldisc, proc, 1);
+        case (IOCTL_GET_STATS):
+            // Copy the input counters
+            return kbdioctl_get_stats(ioctl_args);
+        case (IOCTL_MODE_CANONICAL):
+            // Edit the input a line at a time, for every process
+            return ldisc_set_mode(&kbd_ldisc, LDISC_CANONICAL);
+        case (IOCTL_MODE_RAW):
+            // Pass on every char as it is typed, for every process
+            return ldisc_set_mode(&kbd_ldisc, LDISC_RAW);
         default:
             // Invalid IOCTL request
             return -1;
@@ -230,147 +249,76 @@ int kbdioctl(pcb_t *proc, unsigned long command, void *ioctl_args) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Finishes a sysread request.
+ * Keyboard specific call for syspoll. There is input once a line is passed on to
+ * the process or it has read an EOF.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 if there is input for the process to read, 0 otherwise
  *-----------------------------------------------------------------------------------
  */
-static void finish_read(void) {
-    kbd_proc->result_code = chars_transferred;
-    chars_transferred = 0;
-    ready(kbd_proc);
+int kbdpoll(devsw_t *devsw, pcb_t *proc) {
+    return ldisc_poll(&kbd_ldisc, proc);
 }
 
 /*===================== KEYBOARD DEVICE DRIVER LOWER HALF =========================*/
 
-/*-----------------------------------------------------------------------------------
- * Resets the keyboard to its initial state.
- *-----------------------------------------------------------------------------------
- */
-static void kbd_reset(void) {
-    flush_kbd_buf();
-
-    read_buf = NULL;
-    read_buflen = 0;
-    chars_transferred = 0;
-    read_finished = 0;
-
-    eof = DEFAULT_EOF;
-    eof_flag = 0;
-
-    kbd_state = 0;
-}
-
-/*-----------------------------------------------------------------------------------
- * Flushes the kernel read buffer.
- *-----------------------------------------------------------------------------------
- */
-static void flush_kbd_buf(void) {
-    for (int i = 0; i < KBD_BUFFER_SIZE; i++) {
-        kbd_buf[i] = 0;
-    }
-    kbd_buf_head = 0;
-    kbd_buf_tail = 0;
-}
-
 /*-----------------------------------------------------------------------------------
  * The keyboard interrupt service routine (ISR). Called whenever there is a keyboard
- * interrupt.
+ * interrupt, before it is acknowledged. Only reads the scancode, and queues
+ * kbd_work_func to translate it once the interrupt has been acknowledged.
  *
- * Assumes that kbd_proc != NULL as kbd_isr should only be triggered if kbdopen has
- * been called.
+ * Assumes that a process has the keyboard open as kbd_isr should only be triggered
+ * if kbdopen has been called.
  *-----------------------------------------------------------------------------------
  */
 void kbd_isr(void) {
-    assert(kbd_proc != NULL, "kbd_isr: kbd_proc is NULL");
+    assert(kbd_ldisc.num_readers > 0, "kbd_isr: the keyboard is not open");
     // To see if there is data present read a byte from port 0x64
     // If the low order bit is 1 then there is data ready to be read from port 0x60
     int is_data_present = CONTROL_PORT_READY_MASK & inb(CONTROL_PORT);
 
     if (is_data_present) {
-        // Read a byte from port 0x60
-        int data = inb(DATA_PORT);
-        unsigned int c = kbtoa(data);
-
-        // kbtoa returns an unsigned int
-        // In the case of a key-up event, the return value of kbtoa is larger than the upper bound of char type
-        if (c > 0 && c <= 127) {
-            write_to_kbd_buf(c);
-            // If the echo version of the keyboard is opened, then each typed
-            // char is echoed to the screen as soon as it arrives
-            if (echo_flag) kprintf("%c", c);
-            if (read_buf && !read_finished) {
-                read_finished = transfer_to_read_buf();
-                if (read_finished && kbd_proc->blocked_queue == READ) finish_read();
-            }
+        // Read a byte from port 0x60, which must be done before the interrupt is
+        // acknowledged
+        unsigned char data = inb(DATA_PORT);
+        int dropped = scancode_head - scancode_tail == KBD_SCANCODE_SIZE;
+        TRACE(TRACE_INTR, TRACE_KBD, this_cpu()->current->pid, data, dropped);
+        if (dropped) {
+            scancodes_dropped++;
+            return;
         }
+        scancode_buf[scancode_head & KBD_SCANCODE_MASK] = data;
+        scancode_head++;
+        queue_work(&kbd_work);
     }
 }
 
-static int is_kbd_buf_full(void) {
-    return ((kbd_buf_head + 1) % KBD_BUFFER_SIZE) == kbd_buf_tail;
-}
-
 /*-----------------------------------------------------------------------------------
- * Writes a char to the internal buffer.
- *
- * @param c The char to write to the internal buffer
+ * The deferred work of the keyboard ISR. Translates the scancodes read since it
+ * last ran, in the order they were read, and passes each char they make to the
+ * line discipline. The scancodes are discarded if the keyboard was closed in the
+ * meantime.
  *-----------------------------------------------------------------------------------
  */
-static void write_to_kbd_buf(char c) {
-    // If the buffer is full, subsequent char arrivals are discarded and not
-    // displayed until buffer space becomes available
-    // If an EOF is received while the buffer is full, it is discarded like any other char
-    if (!is_kbd_buf_full()) {
-        kbd_buf[kbd_buf_head] = c;
-        kbd_buf_head = (kbd_buf_head + 1) % (KBD_BUFFER_SIZE);
+static void kbd_work_func(work_t *work) {
+    while (scancode_tail != scancode_head) {
+        unsigned char data = scancode_buf[scancode_tail & KBD_SCANCODE_MASK];
+        scancode_tail++;
+        if (kbd_ldisc.num_readers == 0) continue;
+        unsigned int c = kbtoa(data);
+        // kbtoa returns an unsigned int
+        // In the case of a key-up event, the return value of kbtoa is larger than the upper bound of char type
+        if (c > 0 && c <= 127) ldisc_input(&kbd_ldisc, c);
     }
 }
 
 /*-----------------------------------------------------------------------------------
- * Copy data from the kernel buffer to the application buffer passed as the parameter
- * to sysread.
- *
- * Requires that kbd_proc != NULL && read_buf != NULL, ie. kbd_proc is blocked on a
- * sysread.
- *
- * @return 1 if the read has been fully serviced, 0 otherwise
+ * Echoes a typed char to the screen, for the line discipline.
  *-----------------------------------------------------------------------------------
  */
-static int transfer_to_read_buf(void) {
-    assert(kbd_proc != NULL, "transfer_to_read_buf: kbd_proc is NULL");
-    assert(read_buf != NULL, "transfer_to_read_buf: read_buf is NULL");
-    while (kbd_buf_tail != kbd_buf_head) {
-        char c = kbd_buf[kbd_buf_tail];
-        kbd_buf_tail = (kbd_buf_tail + 1) % (KBD_BUFFER_SIZE);
-        if (c == eof) {
-            handle_eof();
-            return 1;
-        }
-        if (copy_char_to_read_buf(c)) return 1;
-    }
-    return 0;
-}
-
-/*-----------------------------------------------------------------------------------
- * Copy a byte to the application buffer.
- *
- * @return 1 if the read has been fully serviced, 0 otherwise
- *-----------------------------------------------------------------------------------
- */
-static int copy_char_to_read_buf(char c) {
-    read_buf[chars_transferred] = c;
-    chars_transferred++;
-    // The buffer passed in to sysread is full as specified by the size parameter to the read call,
-    // or the "Enter key" is encountered
-    return chars_transferred == read_buflen || c == '\n';
-}
-
-/*-----------------------------------------------------------------------------------
- * Handle EOF char.
- *-----------------------------------------------------------------------------------
- */
-static void handle_eof(void) {
-    disable_keyboard_hardware();
-    eof_flag = 1;
+static void kbd_echo(char c) {
+    kprintf("%c", c);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -398,13 +346,30 @@ static int kbdioctl_change_eof(void *ioctl_args) {
         va_list change_eof_args = (va_list) ioctl_args;
         int c = va_arg(change_eof_args, int);
         va_end(change_eof_args);
-        if (c > 0 && c <= 127) {
-            eof = (char) c;
-            return 0;
-        } else {
-            return -1;
-        }
+        return ldisc_set_eof(&kbd_ldisc, c);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the input counters to the kbd_stats_t given in the additional parameters.
+ * @param ioctl_args The IOCTL args
+ *-----------------------------------------------------------------------------------
+ */
+static int kbdioctl_get_stats(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
     }
+    va_list get_stats_args = (va_list) ioctl_args;
+    kbd_stats_t *stats = va_arg(get_stats_args, kbd_stats_t *);
+    va_end(get_stats_args);
+    if (!valid_buf(stats, sizeof(kbd_stats_t))) {
+        return -1;
+    }
+    stats->dropped = scancodes_dropped + kbd_ldisc.dropped;
+    stats->high_water = kbd_ldisc.high_water;
+    stats->lines = kbd_ldisc.lines;
+    stats->readers = kbd_ldisc.num_readers;
+    return 0;
 }
 
 // GIVEN scanCodesToAscii.txt CODE STARTS (minus extended mode and uses of printf)
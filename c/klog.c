@@ -0,0 +1,151 @@
+/* klog.c : leveled kernel log */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <stdarg.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the kernel log, for diagnostics that should not change the timing of what
+ * they report on. Unlike kprintf, which formats and writes to the display there and
+ * then with interrupts disabled, KLOG only stores its format and arguments in a ring
+ * of the processor it runs on. The logger process, which init starts at the lowest
+ * priority, reads the records with syslogread and formats and writes them out when
+ * nothing else has to run.
+ *
+ * Notes on the kernel log:
+ * - Records have a level, LOG_ERROR, LOG_WARN, LOG_INFO or LOG_DEBUG. Those above
+ *   LOG_COMPILE_LEVEL are compiled out, and those above the runtime level, set with
+ *   syslogctl, are not made
+ * - A record keeps the format and LOG_MAX_ARGS words of arguments, so the format
+ *   and any %s argument must be string constants
+ * - Each processor has a ring of LOG_RING_SIZE records, so making a record never
+ *   waits for another processor. Records made while the ring is full are dropped,
+ *   and the next record that fits says how many
+ * - Records are made with the kernel lock held or interrupts disabled, and are read
+ *   from all the rings in the order they were made
+ *
+ * List of functions that are called from outside this file:
+ * - kloginit
+ *   - Empties the log rings and sets the default level
+ * - klog_record
+ *   - Makes a log record, called through KLOG
+ * - log_set_level
+ *   - Implements the kernel side of syslogctl
+ * - log_read
+ *   - Implements the kernel side of syslogread
+ *-----------------------------------------------------------------------------------
+ */
+
+typedef struct log_ring {
+    log_record_t records[LOG_RING_SIZE];
+    // The number of records placed in the ring and taken from it
+    unsigned int head;
+    unsigned int tail;
+    // Records dropped since the last one placed in the ring
+    unsigned int dropped;
+} log_ring_t;
+
+int log_level;
+
+static log_ring_t log_rings[MAX_CPUS];
+
+/*-----------------------------------------------------------------------------------
+ * To be called after ksmpinit, before any record is made. Empties the log rings and
+ * sets the level to LOG_DEFAULT_LEVEL.
+ *-----------------------------------------------------------------------------------
+ */
+void kloginit(void) {
+    fill_words(log_rings, 0, sizeof(log_rings));
+    log_level = LOG_DEFAULT_LEVEL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Makes a log record in the ring of the processor running the caller, without
+ * formatting it. Called through KLOG, which leaves out the records above the level.
+ *
+ * @param level The level of the record
+ * @param fmt   The format of the record, a string constant
+ * @param ...   Up to LOG_MAX_ARGS arguments of the format, each of a word
+ *-----------------------------------------------------------------------------------
+ */
+void klog_record(int level, char *fmt, ...) {
+    cpu_t *cpu = this_cpu();
+    log_ring_t *ring = &log_rings[cpu->index];
+    if (ring->head - ring->tail == LOG_RING_SIZE) {
+        ring->dropped++;
+        return;
+    }
+    log_record_t *record = &ring->records[ring->head % LOG_RING_SIZE];
+    record->timestamp = read_tsc();
+    record->fmt = fmt;
+    // Words the format does not use are taken all the same, and never looked at
+    va_list ap;
+    va_start(ap, fmt);
+    for (int i = 0; i < LOG_MAX_ARGS; i++) {
+        record->args[i] = va_arg(ap, unsigned long);
+    }
+    va_end(ap);
+    record->level = level;
+    record->cpu = cpu->index;
+    record->dropped = ring->dropped > 0xffff ? 0xffff : ring->dropped;
+    ring->dropped = 0;
+    ring->head++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syslogctl. Sets the most verbose level of records
+ * that are made, the records already made are kept.
+ *
+ * @param level LOG_ERROR to LOG_DEBUG, or -1 to leave the level as it is
+ * @return      The level before the call, -1 if the level is not valid
+ *-----------------------------------------------------------------------------------
+ */
+int log_set_level(int level) {
+    int old_level = log_level;
+    if (level == -1) {
+        return old_level;
+    }
+    if (level < LOG_ERROR || level > LOG_DEBUG) {
+        return -1;
+    }
+    log_level = level;
+    return old_level;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syslogread. Takes records out of the log rings, the
+ * earliest made first whichever processor made it.
+ *
+ * @param records A pointer to where the records are copied, already checked by the
+ *                caller
+ * @param count   The most records to copy
+ * @return        The number of records copied, 0 if there are none, or -1 if count
+ *                is negative
+ *-----------------------------------------------------------------------------------
+ */
+int log_read(log_record_t *records, int count) {
+    if (count < 0) {
+        return -1;
+    }
+    int copied = 0;
+    while (copied < count) {
+        // The ring whose oldest record is the earliest
+        log_ring_t *earliest = NULL;
+        for (int i = 0; i < MAX_CPUS; i++) {
+            log_ring_t *ring = &log_rings[i];
+            if (ring->head == ring->tail) {
+                continue;
+            }
+            if (earliest == NULL || ring->records[ring->tail % LOG_RING_SIZE].timestamp <
+                                    earliest->records[earliest->tail % LOG_RING_SIZE].timestamp) {
+                earliest = ring;
+            }
+        }
+        if (earliest == NULL) {
+            break;
+        }
+        records[copied++] = earliest->records[earliest->tail % LOG_RING_SIZE];
+        earliest->tail++;
+    }
+    return copied;
+}
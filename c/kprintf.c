@@ -1,27 +1,33 @@
-/* kprintf.c - kprintf, kputc, kbmputc */
+/* kprintf.c - kprintf, kbmwrite */
 
 #include <i386.h>
 #include <xeroslib.h>
 #include <xeroskernel.h>
+#include <console.h>
+#include <format.h>
 #include <stdarg.h>
 
-static  int kputc(int, unsigned char);
+// Chars kprintf formats before writing them to the display, a line or more
+#define KPRINTF_BUFFER_SIZE 128
+
+static void vputc(unsigned char c);
 
 
 /*------------------------------------------------------------------------
- *  kprintf  --  kernel printf: formatted, unbuffered output to CONSOLE
+ *  kprintf  --  kernel printf: formatted, unbuffered output to CONSOLE.
+ *               The output is formatted into a buffer on the stack and
+ *               written to the display a buffer at a time by kbmwrite
  *------------------------------------------------------------------------
  */
 int kprintf(char * fmt, ...)
 {
-  //	unsigned int	saveof;
-
+  char buf[KPRINTF_BUFFER_SIZE];
   va_list ap;
   va_start(ap, fmt);
-  
-    //  _doprnt(fmt, &args, kputc, 0);
 
-    _doprnt(fmt, (void *) ap,  kputc, 0);
+    // Output still buffered by the console comes first
+    console_flush();
+    format_buffer(buf, sizeof(buf), kbmwrite, fmt, ap);
   va_end(ap);
   return 1;
 }
@@ -80,6 +86,7 @@ static unsigned char	att = 0x7;
 unsigned char *Crtat = (unsigned char *)CGA_BUF;
 
 static unsigned int addr_6845 = CGA_BASE;
+static unsigned char	*crtat = 0;
 static void cursor(int pos)
 {
 	outb(addr_6845,14);
@@ -89,15 +96,27 @@ static void cursor(int pos)
 }
 
 /*------------------------------------------------------------------------
- *  kbmputc - write one character to the physical monitor
+ *  kbmwrite - write a buffer of characters to the physical monitor,
+ *             moving the cursor once at the end
+ *------------------------------------------------------------------------
+ */
+void kbmwrite( char *buf, int len )
+{
+	for (int i = 0; i < len; i++)
+		vputc(buf[i]);
+	if (crtat != 0)
+		cursor((crtat-Crtat)/CHR);
+}
+
+/*------------------------------------------------------------------------
+ *  vputc - place one character in video memory, without moving the cursor
  *------------------------------------------------------------------------
  */
-static void kbmputc( unsigned char c )
+static void vputc( unsigned char c )
 {
 	unsigned		cursorat;
 	unsigned short		was;
 	unsigned char		*cp;
-	static unsigned char	*crtat = 0;
 
 	if (c == 0)
 		return;
@@ -135,7 +154,7 @@ static void kbmputc( unsigned char c )
 
 	case '\t':
 		do
-			kbmputc(' ');
+			vputc(' ');
 		while ((int)crtat % (8*CHR));
 		break;
 
@@ -169,15 +188,4 @@ static void kbmputc( unsigned char c )
 
 		crtat -= COL*CHR ;
 	}
-
-	cursor((crtat-Crtat)/CHR);
-}
-
-/*------------------------------------------------------------------------
- * kputc - do a synchronous kernel write to the console tty
- *------------------------------------------------------------------------
- */
-static int kputc(int dev, unsigned char c) {
-  kbmputc(c);
-  return (int) c;
 }
@@ -0,0 +1,149 @@
+/* latency.c : interrupts-disabled time and timer latency */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the accounting of the time the kernel runs with interrupts disabled. The
+ * kernel is entered with interrupts disabled, by a system call or an interrupt, and
+ * they stay disabled until the dispatcher switches back to a process, so every IRQ
+ * raised in between waits for the whole span. The dispatcher reports each span with
+ * the request it was entered with, and how late the PIT tick was handled, so that
+ * the requests that hold off the interrupts can be found.
+ *
+ * Notes on the statistics:
+ * - A span runs from the return of contextswitch to the next call, including the
+ *   signals and deferred work handled and the choice of the next process, as well
+ *   as the service of the request. The spans of each request are counted with the
+ *   most cycles one took, in a histogram of a bucket per power of 2 like that of
+ *   the system call table
+ * - The latency of a tick is the time from the PIT raising it to the dispatcher
+ *   handling it, read from the count of the PIT. A tick is held off by the span
+ *   before it, so its latency is counted against the request of that span
+ * - Ticks handled while the periodic tick is stopped, and the ticks of the local
+ *   APIC timers, have no count to read and are not counted
+ * - The fast system calls never reach the dispatcher and are not counted, nor is
+ *   the time spent in the upper halves of the ISRs
+ * - The statistics are updated with the kernel lock held, so the spans of every
+ *   processor go into the same statistics
+ *
+ * List of functions that are called from outside this file:
+ * - klatencyinit
+ *   - Empties the statistics and registers sysgetlatency
+ * - latency_span
+ *   - Counts a span of the kernel with interrupts disabled
+ * - latency_tick
+ *   - Counts the latency of a tick
+ * - get_latency_stats
+ *   - Implements the kernel side of sysgetlatency
+ *-----------------------------------------------------------------------------------
+ */
+
+// The number of request identifiers, system calls and interrupts
+#define NUM_REQUESTS (ATA_INT + 1)
+
+static void service_sysgetlatency(void);
+
+static latency_stats_t latency_stats[NUM_REQUESTS];
+
+// Names of the interrupt requests from TIMER_INT on, the system calls take theirs
+// from the system call table
+static char *interrupt_names[] = {"timer int", "keyboard int", "apic timer int",
+                                  "serial int", "ata int"};
+
+/*-----------------------------------------------------------------------------------
+ * To be called after kdispinit, once the system calls are registered. Empties the
+ * statistics, names them after their requests, and registers sysgetlatency.
+ *-----------------------------------------------------------------------------------
+ */
+void klatencyinit(void) {
+    register_syscall(SYSGETLATENCY, "getlatency", &service_sysgetlatency);
+    fill_words(latency_stats, 0, sizeof(latency_stats));
+    for (int request = 0; request < NUM_REQUESTS; request++) {
+        char *name = request < TIMER_INT ? syscall_name(request) : interrupt_names[request - TIMER_INT];
+        if (name == NULL) {
+            name = "";
+        }
+        int i;
+        for (i = 0; i < SYSCALL_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+            latency_stats[request].name[i] = name[i];
+        }
+        latency_stats[request].name[i] = '\0';
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the dispatcher as it switches to a process. Counts the span of the
+ * kernel with interrupts disabled since it was last entered.
+ *
+ * @param request The request the kernel was entered with
+ * @param cycles  The cycles from the entry to the switch
+ *-----------------------------------------------------------------------------------
+ */
+void latency_span(request_t request, unsigned long long cycles) {
+    if (request < 0 || request >= NUM_REQUESTS) {
+        return;
+    }
+    latency_stats_t *stats = &latency_stats[request];
+    // Anything beyond 32 bits lands in the last bucket
+    unsigned long span = cycles >> 32 ? 0xffffffffUL : (unsigned long) cycles;
+    stats->count++;
+    stats->histogram[span > 1 ? find_last_set_bit(span) : 0]++;
+    if (span > stats->max_cycles) {
+        stats->max_cycles = span;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the dispatcher as it handles a PIT tick. Counts how late the tick was
+ * handled against the request of the span before it.
+ *
+ * @param request The request of the span of the kernel before the tick was taken
+ * @param us      The microseconds since the PIT raised the tick
+ *-----------------------------------------------------------------------------------
+ */
+void latency_tick(request_t request, unsigned long us) {
+    if (request < 0 || request >= NUM_REQUESTS) {
+        return;
+    }
+    latency_stats_t *stats = &latency_stats[request];
+    int bucket = us > 1 ? find_last_set_bit(us) : 0;
+    stats->tick_count++;
+    stats->tick_histogram[bucket < LATENCY_TICK_BUCKETS ? bucket : LATENCY_TICK_BUCKETS - 1]++;
+    if (us > stats->tick_max_us) {
+        stats->tick_max_us = us;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysgetlatency. Copies the statistics of the given
+ * request.
+ *
+ * @param request The request identifier, a system call or an interrupt
+ * @param stats   A pointer to where the statistics are copied, already checked by
+ *                the caller
+ * @return        0 on success, -1 if the identifier is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int get_latency_stats(int request, latency_stats_t *stats) {
+    if (request < 0 || request >= NUM_REQUESTS) {
+        return -1;
+    }
+    copy_words(stats, &latency_stats[request], sizeof(latency_stats_t));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetlatency request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetlatency(void) {
+    cpu_t *cpu = this_cpu();
+    int request = (int) cpu->args[0];
+    latency_stats_t *stats = (latency_stats_t *) cpu->args[1];
+    if (check_range(stats, sizeof(latency_stats_t), 0) != RANGE_OK) {
+        cpu->current->result_code = -2;
+        return;
+    }
+    cpu->current->result_code = get_latency_stats(request, stats);
+}
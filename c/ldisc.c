@@ -0,0 +1,485 @@
+/* ldisc.c : tty line discipline */
+
+#include <xeroskernel.h>
+#include <queue.h>
+#include <ldisc.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the tty line discipline, which sits between a character device and the
+ * processes reading it. The device hands it every char that arrives, and it edits,
+ * echoes and buffers the input, and passes it on to the processes reading.
+ *
+ * Notes on the line discipline:
+ * - In canonical mode the line being typed is edited in the line discipline: the
+ *   erase char removes the last char and the kill char the whole line. The line is
+ *   only passed on to the readers once it ends with a newline or an EOF char, or
+ *   fills LDISC_LINE_SIZE chars, so readers are woken once per line
+ * - In raw mode every char is passed on as it arrives, and no char is special
+ * - Up to LDISC_MAX_READERS processes may read at once, and each of them reads all
+ *   of the input: the committed input is kept in a single ring, and every reader
+ *   has its own position in it
+ * - A char is dropped, and not echoed, if the ring has no room for it and the rest
+ *   of its line behind the slowest reader
+ * - A read returns once it has any chars, and stops at the end of a line, so a
+ *   read in canonical mode returns at most one line
+ * - The EOF char ends the line it is typed on, and the reader takes it as an
+ *   end-of-file (EOF): every later read of the reader returns 0
+ * - Input is echoed while any of the readers has echo on
+ *
+ * List of functions that are called from outside this file:
+ * - ldisc_init
+ *   - Initializes a line discipline with no readers
+ * - ldisc_open
+ *   - Adds a reader to a line discipline
+ * - ldisc_close
+ *   - Removes a reader from a line discipline
+ * - ldisc_read
+ *   - Services a sysread of a reader
+ * - ldisc_aioread
+ *   - Services a sysaioread of a reader
+ * - ldisc_poll
+ *   - Returns 1 if a reader has input to read, 0 otherwise
+ * - ldisc_set_mode
+ *   - Switches between canonical and raw mode
+ * - ldisc_set_eof
+ *   - Changes the EOF char
+ * - ldisc_set_echo
+ *   - Turns echoing on or off for a reader
+ * - ldisc_input
+ *   - Handles a char that arrived from the device
+ *-----------------------------------------------------------------------------------
+ */
+
+static void ldisc_reset(ldisc_t *ld);
+static ldisc_reader_t *find_reader(ldisc_t *ld, pcb_t *proc);
+static int is_waiting(ldisc_t *ld, pcb_t *proc);
+static int has_room(ldisc_t *ld, int len);
+static void commit_line(ldisc_t *ld, int eof);
+static void deliver(ldisc_t *ld);
+static int transfer(ldisc_t *ld, ldisc_reader_t *reader, char *buf, int buflen, int *done);
+static void finish_aio_read(ldisc_reader_t *reader);
+static void echo_char(ldisc_t *ld, char c);
+static void erase_chars(ldisc_t *ld, int count);
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given line discipline with no readers.
+ *
+ * @param ld   The line discipline
+ * @param echo Echoes a char on the device
+ *-----------------------------------------------------------------------------------
+ */
+void ldisc_init(ldisc_t *ld, void (*echo)(char c)) {
+    assert(ld != NULL, "ldisc_init: ld was null");
+    ld->echo = echo;
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        ld->readers[i].proc = NULL;
+    }
+    ld->num_readers = 0;
+    init_queue(&ld->waiters);
+    ldisc_reset(ld);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given process as a reader of the line discipline. The reader sees the
+ * input that is committed from now on. The first reader resets the line discipline
+ * to canonical mode with the default control chars and no input.
+ *
+ * @param ld   The line discipline
+ * @param proc The process that called sysopen
+ * @param echo Whether the input is to be echoed for the reader
+ * @return     0 on success, -1 if the process already reads the line discipline or
+ *             LDISC_MAX_READERS processes do
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_open(ldisc_t *ld, pcb_t *proc, int echo) {
+    if (find_reader(ld, proc)) {
+        return -1;
+    }
+    ldisc_reader_t *reader = find_reader(ld, NULL);
+    if (reader == NULL) {
+        return -1;
+    }
+    if (ld->num_readers == 0) {
+        ldisc_reset(ld);
+    }
+    reader->proc = proc;
+    reader->tail = ld->head;
+    reader->echo = echo;
+    reader->eof = 0;
+    reader->aio_signal = -1;
+    reader->aio_done = 0;
+    ld->num_readers++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given process as a reader of the line discipline. An asynchronous
+ * read in progress is abandoned, and the entry of the signal queue it kept freed.
+ *
+ * @param ld   The line discipline
+ * @param proc The process that called sysclose
+ * @return     0 on success, -1 if the process does not read the line discipline
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_close(ldisc_t *ld, pcb_t *proc) {
+    ldisc_reader_t *reader = find_reader(ld, proc);
+    if (reader == NULL) {
+        return -1;
+    }
+    if (reader->aio_signal >= 0) {
+        release_queued_signal(proc);
+    }
+    reader->proc = NULL;
+    ld->num_readers--;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysread of the given reader. Takes the chars the reader has not read
+ * yet, up to the end of a line.
+ *
+ * @param ld          The line discipline
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF)
+ *                    -1 if an asynchronous read is in progress
+ *                    BLOCKERR if there is no input in non-blocking mode
+ *                    -2 if the process was blocked until a line is committed
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_read(ldisc_t *ld, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    ldisc_reader_t *reader = find_reader(ld, proc);
+    if (reader == NULL || reader->aio_signal >= 0) {
+        return -1;
+    }
+    // Subsequent reads after an EOF continue to return the EOF indication
+    if (reader->eof) {
+        return 0;
+    }
+    int done = 0;
+    if (transfer(ld, reader, (char *) buf, buflen, &done)) {
+        return done;
+    }
+    if (nonblocking) {
+        return BLOCKERR;
+    }
+    proc->io_buf = (char *) buf;
+    proc->io_len = buflen;
+    proc->io_done = 0;
+    proc->state = BLOCKED;
+    proc->blocked_queue = READ;
+    proc->wait_queue = &ld->waiters;
+    enqueue(&ld->waiters, proc);
+    return -2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysaioread of the given reader. Starts a read that takes chars like a
+ * sysread without blocking the reader. When the read completes, the given signal
+ * is queued for the reader with the number of bytes read as its value, 0 for an
+ * end-of-file (EOF). An entry of the signal queue of the reader is kept for it
+ * meanwhile, so that the signal is never refused.
+ *
+ * @param ld            The line discipline
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into, filled in while the process runs
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              0 if the read was started, -1 if one is already in progress
+ *                      or the signal queue of the reader is full
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_aioread(ldisc_t *ld, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    ldisc_reader_t *reader = find_reader(ld, proc);
+    if (reader == NULL || reader->aio_signal >= 0 || reserve_queued_signal(proc) < 0) {
+        return -1;
+    }
+    reader->aio_signal = signal_number;
+    reader->aio_buf = (char *) buf;
+    reader->aio_len = buflen;
+    reader->aio_done = 0;
+    if (reader->eof || transfer(ld, reader, reader->aio_buf, buflen, &reader->aio_done)) {
+        finish_aio_read(reader);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given process reads the line discipline and has input to read
+ * or has read an EOF, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_poll(ldisc_t *ld, pcb_t *proc) {
+    ldisc_reader_t *reader = find_reader(ld, proc);
+    return reader != NULL && (reader->eof || reader->tail != ld->head);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Switches the line discipline to the given mode. The line being edited is passed
+ * on to the readers when switching to raw mode.
+ *
+ * @param mode LDISC_CANONICAL or LDISC_RAW
+ * @return     0 on success, -1 if the mode is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_set_mode(ldisc_t *ld, int mode) {
+    if (mode != LDISC_CANONICAL && mode != LDISC_RAW) {
+        return -1;
+    }
+    if (mode == LDISC_RAW && ld->line_len > 0) {
+        commit_line(ld, 0);
+    }
+    ld->mode = mode;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Changes the char that indicates an EOF in canonical mode.
+ *
+ * @param c The new EOF char
+ * @return  0 on success, -1 if the char is not an ASCII char
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_set_eof(ldisc_t *ld, int c) {
+    if (c <= 0 || c > 127) {
+        return -1;
+    }
+    ld->eof = (unsigned char) c;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Turns echoing on or off for the given reader.
+ *
+ * @return 0 on success, -1 if the process does not read the line discipline
+ *-----------------------------------------------------------------------------------
+ */
+int ldisc_set_echo(ldisc_t *ld, pcb_t *proc, int echo) {
+    ldisc_reader_t *reader = find_reader(ld, proc);
+    if (reader == NULL) {
+        return -1;
+    }
+    reader->echo = echo;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Handles a char that arrived from the device. In canonical mode the char edits
+ * the line being typed, and ends it if it is a newline or the EOF char, in raw
+ * mode it is passed on to the readers at once. Input is discarded while there are
+ * no readers.
+ *
+ * @param c The char, never LDISC_EOF_MARK
+ *-----------------------------------------------------------------------------------
+ */
+void ldisc_input(ldisc_t *ld, char c) {
+    if (ld->num_readers == 0) {
+        return;
+    }
+    if (ld->mode == LDISC_CANONICAL) {
+        if (c == ld->erase || c == DELETE_CHAR) {
+            erase_chars(ld, 1);
+            return;
+        }
+        if (c == ld->kill) {
+            erase_chars(ld, ld->line_len);
+            return;
+        }
+    }
+    // The whole of the line must fit behind the slowest reader once it ends
+    if (!has_room(ld, ld->line_len + 1)) {
+        ld->dropped++;
+        return;
+    }
+    if (ld->mode == LDISC_RAW) {
+        echo_char(ld, c);
+        ld->line[ld->line_len++] = c;
+        commit_line(ld, 0);
+    } else if (c == ld->eof) {
+        commit_line(ld, 1);
+    } else {
+        echo_char(ld, c);
+        ld->line[ld->line_len++] = c;
+        if (c == '\n' || ld->line_len == LDISC_LINE_SIZE) {
+            commit_line(ld, 0);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Resets the given line discipline to canonical mode with the default control
+ * chars, no input and cleared counters.
+ *-----------------------------------------------------------------------------------
+ */
+static void ldisc_reset(ldisc_t *ld) {
+    ld->mode = LDISC_CANONICAL;
+    ld->eof = DEFAULT_EOF;
+    ld->erase = DEFAULT_ERASE;
+    ld->kill = DEFAULT_KILL;
+    ld->line_len = 0;
+    ld->head = 0;
+    ld->dropped = 0;
+    ld->high_water = 0;
+    ld->lines = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the reader slot of the given process, or a free slot if the process is
+ * NULL, or NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static ldisc_reader_t *find_reader(ldisc_t *ld, pcb_t *proc) {
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        if (ld->readers[i].proc == proc) {
+            return &ld->readers[i];
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given process is blocked in a sysread of the line discipline, 0
+ * otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int is_waiting(ldisc_t *ld, pcb_t *proc) {
+    return proc->state == BLOCKED && proc->blocked_queue == READ && proc->wait_queue == &ld->waiters;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the ring has room for the given number of chars behind every reader,
+ * 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int has_room(ldisc_t *ld, int len) {
+    unsigned int used = 0;
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        ldisc_reader_t *reader = &ld->readers[i];
+        if (reader->proc && ld->head - reader->tail > used) {
+            used = ld->head - reader->tail;
+        }
+    }
+    return LDISC_RING_SIZE - used >= (unsigned int) len;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Places the line being edited in the ring, followed by an EOF mark if it was ended
+ * by the EOF char, and passes it on to the readers. The caller has made sure it
+ * fits.
+ *-----------------------------------------------------------------------------------
+ */
+static void commit_line(ldisc_t *ld, int eof) {
+    for (int i = 0; i < ld->line_len; i++) {
+        ld->ring[ld->head++ & LDISC_RING_MASK] = ld->line[i];
+    }
+    if (eof) {
+        ld->ring[ld->head++ & LDISC_RING_MASK] = LDISC_EOF_MARK;
+    }
+    ld->line_len = 0;
+    ld->lines++;
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        ldisc_reader_t *reader = &ld->readers[i];
+        if (reader->proc && ld->head - reader->tail > ld->high_water) {
+            ld->high_water = ld->head - reader->tail;
+        }
+    }
+    deliver(ld);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Completes the reads in progress that the committed input satisfies, and tells
+ * the polling readers there is input.
+ *-----------------------------------------------------------------------------------
+ */
+static void deliver(ldisc_t *ld) {
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        ldisc_reader_t *reader = &ld->readers[i];
+        pcb_t *proc = reader->proc;
+        if (proc == NULL) {
+            continue;
+        }
+        if (reader->aio_signal >= 0) {
+            if (transfer(ld, reader, reader->aio_buf, reader->aio_len, &reader->aio_done)) {
+                finish_aio_read(reader);
+            }
+        } else if (is_waiting(ld, proc)) {
+            if (transfer(ld, reader, proc->io_buf, proc->io_len, &proc->io_done)) {
+                remove(&ld->waiters, proc);
+                proc->result_code = proc->io_done;
+                ready(proc);
+            }
+        }
+        poll_check(proc);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the chars the given reader has not read into the given buffer, after the
+ * chars already transferred, up to the end of a line or an EOF mark.
+ *
+ * @param done The chars already in the buffer, advanced past those copied
+ * @return     1 if the read is complete as it holds chars or reached an EOF, 0 if
+ *             it has to wait for input
+ *-----------------------------------------------------------------------------------
+ */
+static int transfer(ldisc_t *ld, ldisc_reader_t *reader, char *buf, int buflen, int *done) {
+    while (*done < buflen && reader->tail != ld->head) {
+        char c = ld->ring[reader->tail & LDISC_RING_MASK];
+        reader->tail++;
+        if (c == LDISC_EOF_MARK) {
+            reader->eof = 1;
+            return 1;
+        }
+        buf[(*done)++] = c;
+        if (c == '\n') {
+            return 1;
+        }
+    }
+    return *done > 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finishes the asynchronous read of the given reader. Queues the signal of the read
+ * with the number of bytes read, in the entry of the queue kept for it.
+ *-----------------------------------------------------------------------------------
+ */
+static void finish_aio_read(ldisc_reader_t *reader) {
+    int signal_number = reader->aio_signal;
+    reader->aio_signal = -1;
+    release_queued_signal(reader->proc);
+    queue_signal(reader->proc, signal_number, 0, reader->aio_done);
+    reader->aio_done = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Echoes the given char if any reader has echo on.
+ *-----------------------------------------------------------------------------------
+ */
+static void echo_char(ldisc_t *ld, char c) {
+    if (ld->echo == NULL) {
+        return;
+    }
+    for (int i = 0; i < LDISC_MAX_READERS; i++) {
+        if (ld->readers[i].proc && ld->readers[i].echo) {
+            ld->echo(c);
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Erases up to the given number of chars from the end of the line being edited,
+ * and from the echoed line.
+ *-----------------------------------------------------------------------------------
+ */
+static void erase_chars(ldisc_t *ld, int count) {
+    for (; count > 0 && ld->line_len > 0; count--) {
+        ld->line_len--;
+        echo_char(ld, '\b');
+        echo_char(ld, ' ');
+        echo_char(ld, '\b');
+    }
+}
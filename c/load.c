@@ -0,0 +1,504 @@
+/* load.c : the load generator
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the load generator the "load" command of the shell runs, to see how the
+ * kernel holds up under a mix of work rather than under one operation at a time as
+ * the benchmarks measure it. It starts a configured number of workers of each kind,
+ * lets them run for a set time, and reports what they did:
+ * - A CPU-bound worker computes LOAD_CPU_CHUNK steps of a random number generator
+ *   per operation and never gives up the processor of its own accord
+ * - An IPC worker sends a message to a partner process of its own and receives the
+ *   reply, a round trip per operation
+ * - A sleep-heavy worker sleeps for LOAD_SLEEP_MS per operation
+ * - An allocation-heavy worker creates a shared memory segment of 1, 2 or 4 pages,
+ *   touches every page and frees it again per operation
+ *
+ * Notes on the report:
+ * - The operations per second are counted over the time from when the workers are
+ *   let go until they are told to stop, by every kind and in all
+ * - The cycles of every operation are counted in a histogram of a bucket per power
+ *   of 2, and the percentiles are the buckets they fall in
+ * - The CPU time of every worker is the difference of what sysgetcputimes reports
+ *   before and after the run, and the fairness is the Jain index of the CPU time of
+ *   the CPU-bound workers, which all ask for as much as they can get
+ * - Only one run can be made at a time, as the workers keep their counts in this
+ *   file. A run needs pre-emption as soon as it has a CPU-bound worker
+ *
+ * List of functions that are called from outside this file:
+ * - load_parse
+ *   - Parses the argument of the "load" command into what to run
+ * - load_run
+ *   - Runs the workers and fills in the report of the run
+ * - load_process
+ *   - The process the "load" command starts, runs and prints the report
+ *-----------------------------------------------------------------------------------
+ */
+
+// What a run is given if the argument leaves it out, in the order of the argument
+#define LOAD_DEFAULT_DURATION_MS 5000
+#define LOAD_DEFAULT_WORKERS 1
+// The longest a run may be
+#define LOAD_MAX_DURATION_MS 600000
+// Steps of the random number generator in an operation of a CPU-bound worker
+#define LOAD_CPU_CHUNK 4096
+// Milliseconds an operation of a sleep-heavy worker sleeps
+#define LOAD_SLEEP_MS 10
+
+// The phases of a run, the workers wait until it is running and stop once it is
+// stopping
+#define LOAD_IDLE 0
+#define LOAD_STARTING 1
+#define LOAD_RUNNING 2
+#define LOAD_STOPPING 3
+
+// The counts of one worker, written only by the worker itself
+typedef struct load_worker {
+    int kind;
+    PID_t pid;
+    unsigned long ops;
+    unsigned long failures;
+    unsigned long histogram[SYSCALL_HISTOGRAM_BUCKETS];
+} load_worker_t;
+
+static void load_worker(void *arg);
+static void load_partner(void *arg);
+static int load_op(load_worker_t *worker, PID_t partner, unsigned long *seed);
+static void sum_kinds(load_report_t *report, int num_workers, processStatuses *before, int before_procs,
+                      processStatuses *after, int after_procs);
+static long cpu_ms_of(processStatuses *ps, int procs, PID_t pid);
+static int percentile_bucket(unsigned long *histogram, unsigned long count, int permille);
+static int jain_index(unsigned long long sum, unsigned long long sum_of_squares, int count);
+static unsigned long per_second(unsigned long count, unsigned long ms);
+
+static char *kind_names[LOAD_KINDS] = {"cpu", "ipc", "sleep", "alloc"};
+
+static load_worker_t load_workers[LOAD_MAX_WORKERS];
+static int volatile load_phase;
+// Written by the CPU-bound workers so their work is not optimized away
+static unsigned long volatile load_sink;
+
+/*-----------------------------------------------------------------------------------
+ * Parses the argument of the "load" command, the seconds to run for and the number
+ * of CPU-bound, IPC, sleep-heavy and allocation-heavy workers, separated by commas,
+ * such as "10,2,1,1,1". Fields left out at the end keep their defaults, the empty
+ * argument is a run of LOAD_DEFAULT_DURATION_MS with one worker of each kind.
+ *
+ * @param spec   The argument
+ * @param config Where what to run is stored
+ * @return       0 on success, -1 if the argument is invalid, asks for no workers or
+ *               for more than LOAD_MAX_WORKERS processes
+ *-----------------------------------------------------------------------------------
+ */
+int load_parse(char *spec, load_config_t *config) {
+    config->duration_ms = LOAD_DEFAULT_DURATION_MS;
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        config->workers[kind] = LOAD_DEFAULT_WORKERS;
+    }
+
+    int field = 0;
+    while (*spec != '\0') {
+        if (field > LOAD_KINDS || *spec < '0' || *spec > '9') {
+            return -1;
+        }
+        int value = 0;
+        while (*spec >= '0' && *spec <= '9') {
+            value = value * 10 + *spec - '0';
+            if (value > LOAD_MAX_DURATION_MS / 1000) {
+                return -1;
+            }
+            spec++;
+        }
+        if (field == 0) {
+            if (value == 0) {
+                return -1;
+            }
+            config->duration_ms = value * 1000;
+        } else {
+            config->workers[field - 1] = value;
+        }
+        field++;
+        if (*spec == ',') {
+            spec++;
+            if (*spec == '\0') {
+                return -1;
+            }
+        } else if (*spec != '\0') {
+            return -1;
+        }
+    }
+
+    // An IPC worker takes a second process for its partner
+    int procs = 0;
+    int workers = 0;
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        workers += config->workers[kind];
+        procs += config->workers[kind] * (kind == LOAD_IPC ? 2 : 1);
+    }
+    return workers == 0 || procs > LOAD_MAX_WORKERS ? -1 : 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the workers the given configuration asks for, as children of the calling
+ * process, for the time it asks for, and reaps them once they have stopped.
+ *
+ * @param config What to run, as load_parse leaves it
+ * @param report Where the results of the run are stored
+ * @return       0 on success, -1 if a run is already being made, pre-emption is
+ *               disabled and a CPU-bound worker is asked for, the accounting could
+ *               not be allocated or a worker could not be started
+ *-----------------------------------------------------------------------------------
+ */
+int load_run(load_config_t *config, load_report_t *report) {
+    if ((!PREEMPTION_ENABLED && config->workers[LOAD_CPU] > 0) ||
+        compare_and_swap(&load_phase, LOAD_IDLE, LOAD_STARTING) != LOAD_IDLE) {
+        return -1;
+    }
+    // The accounting of every process before and after the run, in one buffer
+    size_t table_size = (PS_SIZE(MAX_PROCESSES + 1) + sizeof(long) - 1) & ~(sizeof(long) - 1);
+    int shm_id;
+    char *buffer = alloc_buffer(2 * table_size, &shm_id);
+    if (buffer == NULL) {
+        load_phase = LOAD_IDLE;
+        return -1;
+    }
+    processStatuses *before = (processStatuses *) buffer;
+    processStatuses *after = (processStatuses *) (buffer + table_size);
+    PID_t pids[LOAD_MAX_WORKERS];
+
+    // The workers wait for the phase to change before their first operation
+    int num_workers = 0;
+    int result = 0;
+    for (int kind = 0; kind < LOAD_KINDS && result == 0; kind++) {
+        for (int i = 0; i < config->workers[kind] && num_workers < LOAD_MAX_WORKERS; i++) {
+            load_worker_t *worker = &load_workers[num_workers];
+            memset(worker, 0, sizeof(load_worker_t));
+            worker->kind = kind;
+            worker->pid = sysspawn(&load_worker, &num_workers, sizeof(num_workers), NULL);
+            if (worker->pid < 0) {
+                // No more workers are started, of this kind or the next
+                result = -1;
+                break;
+            }
+            pids[num_workers++] = worker->pid;
+        }
+    }
+
+    unsigned long long start_us;
+    unsigned long long end_us;
+    before->size = MAX_PROCESSES + 1;
+    int before_procs = sysgetcputimes(before);
+    sysclock(&start_us);
+    if (result == 0) {
+        load_phase = LOAD_RUNNING;
+        syssleep(config->duration_ms);
+    }
+    load_phase = LOAD_STOPPING;
+    sysclock(&end_us);
+    after->size = MAX_PROCESSES + 1;
+    int after_procs = sysgetcputimes(after);
+
+    // Only the workers are waited for, the caller may have children of its own
+    int remaining = num_workers;
+    while (remaining > 0) {
+        int status;
+        PID_t pid = syswaitany(pids, remaining, &status);
+        if (pid < 0) {
+            break;
+        }
+        for (int i = 0; i < remaining; i++) {
+            if (pids[i] == pid) {
+                pids[i] = pids[--remaining];
+                break;
+            }
+        }
+    }
+
+    report->elapsed_ms = (unsigned long) (end_us - start_us) / 1000;
+    if (report->elapsed_ms == 0) {
+        report->elapsed_ms = 1;
+    }
+    sum_kinds(report, num_workers, before, before_procs, after, after_procs);
+    free_buffer(shm_id);
+    load_phase = LOAD_IDLE;
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used to service "load" command. Runs the load generator with the configuration its
+ * argument points to and prints the report, a line per kind of worker with the
+ * workers, the operations completed, per second and failed, the percentiles of the
+ * cycles an operation took, as the powers of 2 that start their buckets, and the
+ * CPU time of the workers in milliseconds. The operations per second in all and the
+ * fairness of the CPU-bound workers follow.
+ *-----------------------------------------------------------------------------------
+ */
+void load_process(void *arg) {
+    load_config_t *config = (load_config_t *) arg;
+    load_report_t report;
+    char print_buf[256];
+
+    sprintf(print_buf, "load: %d ms, %d cpu, %d ipc, %d sleep, %d alloc\n", config->duration_ms,
+            config->workers[LOAD_CPU], config->workers[LOAD_IPC], config->workers[LOAD_SLEEP],
+            config->workers[LOAD_ALLOC]);
+    sysputs(print_buf);
+    if (load_run(config, &report) != 0) {
+        sysputs("Could not start the load\n");
+        return;
+    }
+
+    sysputs("KIND  | WORKERS | OPS        | OPS/S      | FAILED | P50      | P90      | P99      | CPU MS\n");
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        load_kind_stats_t *stats = &report.kinds[kind];
+        if (stats->workers == 0) {
+            continue;
+        }
+        sprintf(print_buf, "%-5s | %-7d | %-10u | %-10u | %-6u | >= %-5u | >= %-5u | >= %-5u | %d\n",
+                kind_names[kind], stats->workers, stats->ops, stats->ops_per_sec, stats->failures,
+                1UL << stats->p50_bucket, 1UL << stats->p90_bucket, 1UL << stats->p99_bucket,
+                stats->cpu_ms);
+        sysputs(print_buf);
+    }
+    sprintf(print_buf, "%u ops/s over %u ms\n", report.ops_per_sec, report.elapsed_ms);
+    sysputs(print_buf);
+    if (report.kinds[LOAD_CPU].workers > 0) {
+        sprintf(print_buf, "Fairness of the cpu workers %d.%03d, %d to %d ms each\n", report.fairness / 1000,
+                report.fairness % 1000, report.min_cpu_ms, report.max_cpu_ms);
+        sysputs(print_buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * A worker of the load generator, its argument points to the index of its counts.
+ * Waits for the run to start, an IPC worker starting its partner first, and times
+ * its operations until the run stops.
+ *-----------------------------------------------------------------------------------
+ */
+static void load_worker(void *arg) {
+    load_worker_t *worker = &load_workers[*(int *) arg];
+    PID_t partner = 0;
+    if (worker->kind == LOAD_IPC) {
+        PID_t self = sysgetpid();
+        partner = sysspawn(&load_partner, &self, sizeof(self), NULL);
+        if (partner < 0) {
+            worker->failures++;
+            return;
+        }
+    }
+    while (load_phase == LOAD_STARTING) {
+        sysyield();
+    }
+
+    unsigned long seed = sysgetpid();
+    while (load_phase == LOAD_RUNNING) {
+        unsigned long long start = read_tsc();
+        if (load_op(worker, partner, &seed) != 0) {
+            worker->failures++;
+            // A partner that is gone does not come back
+            if (worker->kind == LOAD_IPC) {
+                return;
+            }
+            continue;
+        }
+        unsigned long long cycles = read_tsc() - start;
+        int bucket = find_last_set_bit(cycles > 0xffffffff ? 0xffffffff : (unsigned long) cycles);
+        worker->histogram[bucket < 0 ? 0 : bucket]++;
+        worker->ops++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * The partner of an IPC worker, whose PID its argument points to. Sends back every
+ * message it receives from the worker, until the worker terminates.
+ *-----------------------------------------------------------------------------------
+ */
+static void load_partner(void *arg) {
+    unsigned int worker = *(PID_t *) arg;
+    unsigned int num;
+    while (sysrecv(&worker, &num) == 0) {
+        if (syssend(worker, num) != 0) {
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Makes one operation of the kind of the given worker.
+ *
+ * @param worker  The counts of the worker
+ * @param partner The partner of an IPC worker
+ * @param seed    The state of the random number generator of the worker
+ * @return        0 on success, -1 if the operation failed
+ *-----------------------------------------------------------------------------------
+ */
+static int load_op(load_worker_t *worker, PID_t partner, unsigned long *seed) {
+    switch (worker->kind) {
+        case LOAD_CPU: {
+            // A xorshift generator, which no compiler can fold away
+            unsigned long x = *seed;
+            for (int i = 0; i < LOAD_CPU_CHUNK; i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+            }
+            *seed = x;
+            load_sink = x;
+            return 0;
+        }
+        case LOAD_IPC: {
+            unsigned int from = partner;
+            unsigned int reply;
+            if (syssend(partner, worker->ops) != 0 || sysrecv(&from, &reply) != 0) {
+                return -1;
+            }
+            return reply == (unsigned int) worker->ops ? 0 : -1;
+        }
+        case LOAD_SLEEP:
+            syssleep(LOAD_SLEEP_MS);
+            return 0;
+        case LOAD_ALLOC: {
+            int pages = 1 << (worker->ops % 3);
+            int shm_id = sysshmcreate(pages * NBPG);
+            if (shm_id < 0) {
+                return -1;
+            }
+            char *segment = sysshmattach(shm_id);
+            if (segment != NULL) {
+                for (int page = 0; page < pages; page++) {
+                    segment[page * NBPG] = (char) page;
+                }
+            }
+            sysshmdetach(shm_id);
+            return segment == NULL ? -1 : 0;
+        }
+        default:
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sums up the counts of the workers of a run by their kind, and their CPU time from
+ * the accounting taken before and after the run.
+ *-----------------------------------------------------------------------------------
+ */
+static void sum_kinds(load_report_t *report, int num_workers, processStatuses *before, int before_procs,
+                      processStatuses *after, int after_procs) {
+    static unsigned long histograms[LOAD_KINDS][SYSCALL_HISTOGRAM_BUCKETS];
+
+    memset(histograms, 0, sizeof(histograms));
+    memset(report->kinds, 0, sizeof(report->kinds));
+    unsigned long long cpu_sum = 0;
+    unsigned long long cpu_sum_of_squares = 0;
+    report->min_cpu_ms = 0;
+    report->max_cpu_ms = 0;
+    for (int i = 0; i < num_workers; i++) {
+        load_worker_t *worker = &load_workers[i];
+        load_kind_stats_t *stats = &report->kinds[worker->kind];
+        stats->workers++;
+        stats->ops += worker->ops;
+        stats->failures += worker->failures;
+        for (int bucket = 0; bucket < SYSCALL_HISTOGRAM_BUCKETS; bucket++) {
+            histograms[worker->kind][bucket] += worker->histogram[bucket];
+        }
+        // A worker that terminated before the end of the run is not in the accounting
+        // taken after it, and counts as having had no CPU time
+        long cpu_ms = cpu_ms_of(after, after_procs, worker->pid) - cpu_ms_of(before, before_procs, worker->pid);
+        if (cpu_ms < 0) {
+            cpu_ms = 0;
+        }
+        stats->cpu_ms += cpu_ms;
+        if (worker->kind == LOAD_CPU) {
+            if (stats->workers == 1 || cpu_ms < report->min_cpu_ms) report->min_cpu_ms = cpu_ms;
+            if (cpu_ms > report->max_cpu_ms) report->max_cpu_ms = cpu_ms;
+            cpu_sum += cpu_ms;
+            cpu_sum_of_squares += (unsigned long long) cpu_ms * cpu_ms;
+        }
+    }
+
+    report->ops_per_sec = 0;
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        load_kind_stats_t *stats = &report->kinds[kind];
+        stats->ops_per_sec = per_second(stats->ops, report->elapsed_ms);
+        stats->p50_bucket = percentile_bucket(histograms[kind], stats->ops, 500);
+        stats->p90_bucket = percentile_bucket(histograms[kind], stats->ops, 900);
+        stats->p99_bucket = percentile_bucket(histograms[kind], stats->ops, 990);
+        report->ops_per_sec += stats->ops_per_sec;
+    }
+    report->fairness = jain_index(cpu_sum, cpu_sum_of_squares, report->kinds[LOAD_CPU].workers);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the CPU time in milliseconds of the process with the given PID in a table
+ * filled by sysgetcputimes, 0 if it is not in the table.
+ *
+ * @param ps    The table
+ * @param procs The last slot used in the table
+ * @param pid   The PID of the process
+ *-----------------------------------------------------------------------------------
+ */
+static long cpu_ms_of(processStatuses *ps, int procs, PID_t pid) {
+    for (int j = 0; j <= procs; j++) {
+        if (ps->proc[j].pid == pid) {
+            return ps->proc[j].cpuTime;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finds the bucket of a histogram of a bucket per power of 2 that a percentile falls
+ * in.
+ *
+ * @param histogram The histogram, of SYSCALL_HISTOGRAM_BUCKETS buckets
+ * @param count     The total of the buckets
+ * @param permille  The percentile in thousandths
+ * @return          The bucket of the percentile, 0 if the histogram is empty
+ *-----------------------------------------------------------------------------------
+ */
+static int percentile_bucket(unsigned long *histogram, unsigned long count, int permille) {
+    unsigned long long wanted = (unsigned long long) count * permille;
+    unsigned long long seen = 0;
+    int bucket = 0;
+    while (bucket < SYSCALL_HISTOGRAM_BUCKETS - 1 && (seen += histogram[bucket]) * 1000 < wanted) {
+        bucket++;
+    }
+    return bucket;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the Jain fairness index of a number of shares in thousandths, the square
+ * of their sum over count times the sum of their squares. The kernel has no 64-bit
+ * division, so both are halved until the division fits in 32 bits.
+ *
+ * @param sum            The sum of the shares
+ * @param sum_of_squares The sum of the squares of the shares
+ * @param count          The number of shares
+ * @return               The index, from 1000 / count up to 1000 if the shares are
+ *                       equal, 1000 if there are no shares
+ *-----------------------------------------------------------------------------------
+ */
+static int jain_index(unsigned long long sum, unsigned long long sum_of_squares, int count) {
+    unsigned long long dividend = sum * sum;
+    unsigned long long divisor = sum_of_squares * count;
+    if (divisor == 0) {
+        return 1000;
+    }
+    while (dividend > 0xffffffffUL / 1000 || divisor > 0xffffffffUL) {
+        dividend >>= 1;
+        divisor >>= 1;
+    }
+    return divisor == 0 ? 1000 : (int) ((unsigned long) dividend * 1000 / (unsigned long) divisor);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns a count made over the given milliseconds as a rate per second, without
+ * overflowing for counts up to 2^32 - 1.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long per_second(unsigned long count, unsigned long ms) {
+    return count / ms * 1000 + count % ms * 1000 / ms;
+}
@@ -3,12 +3,39 @@
 
 #include <i386.h>
 #include <xeroskernel.h>
+#include <e820.h>
 
 /*-----------------------------------------------------------------------------------
  * This is the memory manager where we allocate memory from the free space and manage
  * the memory available to the kernel. It is used for dynamically allocating process
  * stacks.
  *
+ * Notes on the size-class bins and boundary tags:
+ * - Every free block is kept on the bin for its size class. Bin i holds the free
+ *   blocks whose size (including header) is in [2^(i + 5), 2^(i + 6)), the last bin
+ *   holds everything larger
+ * - A bitmap records which bins are non-empty, so that the smallest non-empty bin
+ *   that is guaranteed to satisfy a request is found with a single bit-scan
+ * - The prev and next fields of the header link a free block into its bin
+ * - Every free block ends with a footer that points back to its header, and every
+ *   block records in the PREV_FREE bit of its size whether the block physically
+ *   before it is free. This lets kfree find and merge both physical neighbours in
+ *   constant time, without walking the free blocks
+ * - A free block must be at least MIN_BLOCK_SIZE bytes to hold its header and
+ *   footer, so a block is not split if the remainder would be smaller
+ * - The memory before the hole is all heap, the memory after the hole is managed by
+ *   the page allocator, which gives 2^KMALLOC_HEAP_ORDER pages of it to the heap
+ * - The ends of the memory come from the memory map, see e820.c. The hole starts
+ *   early if the memory below it ends early. The page allocator holds all of the
+ *   memory that follows the hole, the usable memory past a gap in the map is added
+ *   to the heap as extra blocks. No block is merged across the end of one
+ *
+ * Notes on the stack pool:
+ * - Process stacks of the default size are recycled through a pool of up to
+ *   STACK_POOL_SIZE blocks, so that creating and stopping processes does not go
+ *   through kmalloc and kfree
+ * - Stacks in the pool stay allocated as far as kmalloc and kfree are concerned
+ *
  * List of functions that are called from outside this file:
  * - kmeminit
  *   - Initializes the free list
@@ -17,28 +44,48 @@
  *     0 if not enough memory is available
  * - kfree
  *   - Returns 1 on success, 0 on failure
+ * - kstackinit
+ *   - Pre-warms the stack pool
+ * - kstackalloc
+ *   - Returns a pointer to the start of the allocated stack if successful, 0 if not
+ *     enough memory is available
+ * - kstackfree
+ *   - Returns 1 on success, 0 on failure
+ * - get_mem_stats
+ *   - Fills the given structure with the allocator statistics
+ * - check_range
+ *   - Returns RANGE_OK if the given range of memory is valid, otherwise the reason
+ *     it is invalid
  * - valid_ptr
  *   - Returns 1 if the given pointer is valid, 0 otherwise
  * - valid_buf
  *   - Returns 1 if the given buffer is valid, 0 otherwise
  * - get_free_list_length
- *   - Returns the length of the free list
+ *   - Returns the number of free blocks
  * - print_free_list
- *   - Prints the free list
+ *   - Prints the free blocks
  *-----------------------------------------------------------------------------------
  */
 
 extern long freemem;    /* start of free memory (set in i386.c) */
 extern char *maxaddr;   /* max memory address (set in i386.c)	*/
+extern unsigned long page_arena_end;
 
 unsigned long freemem_aligned;
 unsigned long hole_start_aligned;
 unsigned long hole_end_aligned;
 unsigned long max_addr_aligned;
+// The part of the memory above the hole that kmalloc carves from the page allocator
+unsigned long heap_start_aligned;
+unsigned long heap_end_aligned;
+// The extra blocks of the heap, past the page allocator, and their bytes
+int num_extra_heaps;
+unsigned long extra_heap_bytes;
 
 typedef struct mem_header {
-    // Size of block including header
+    // Size of block including header, the low bits hold the PREV_FREE flag
     unsigned long size;
+    // Links in the bin for the size class of a free block, unused while allocated
     struct mem_header *prev;
     struct mem_header *next;
     // NULL for free block, data_start for allocated block
@@ -46,19 +93,77 @@ typedef struct mem_header {
     unsigned char data_start[0];
 } mem_header_t;
 
-static const unsigned long HEADER_SIZE = sizeof(mem_header_t);
+// Stored in the last word of every free block, points to the header of the block
+// An entry of the region table, covering the addresses from the end of the previous
+// entry up to end
+typedef struct memory_region {
+    unsigned long end;
+    range_check_t reason;
+} memory_region_t;
 
+// The fixed regions and a gap and a region for every region of the memory map
+#define NUM_MEMORY_REGIONS (7 + 2 * E820_MAX_REGIONS)
+
+typedef struct mem_footer {
+    mem_header_t *header;
+} mem_footer_t;
+
+static const unsigned long HEADER_SIZE = sizeof(mem_header_t);
+// Set in the size of a block if the block physically before it is free
+#define PREV_FREE 0x1
+// A free block must be able to hold its header and its footer
+#define MIN_BLOCK_SIZE (sizeof(mem_header_t) + PARAGRAPH_SIZE)
+// log2 of the smallest block size, blocks in bin 0 have a size in [32, 64)
+#define MIN_BLOCK_SHIFT 5
+#define NUM_SIZE_CLASSES 18
+
+static mem_header_t *find_free_block(size_t size);
+static int size_class(size_t size);
+static int size_class_fit(size_t size);
+static void insert_into_bin(mem_header_t *block);
+static void remove_from_bin(mem_header_t *block);
 static void split_off_free_block(size_t size, mem_header_t *block);
-static int are_adjacent_blocks(mem_header_t *left_block, mem_header_t *right_block);
-static void merge_blocks(mem_header_t *left_block, mem_header_t *right_block);
+static void pool_stack(void *ptr);
+static mem_header_t *allocated_block(void *ptr);
+static unsigned long block_size(mem_header_t *block);
+static void set_block_size(mem_header_t *block, unsigned long size);
+static void write_footer(mem_header_t *block);
+static mem_header_t *next_physical_block(mem_header_t *block);
+static mem_header_t *prev_physical_block(mem_header_t *block);
 static int on_paragraph_boundary(unsigned long addr);
 static unsigned long round_up_to_paragraph(unsigned long to_align);
 static unsigned long round_down_to_paragraph(unsigned long to_align);
 static int in_free_memory_range(unsigned long addr);
-static int in_memory_range(unsigned long addr);
-static int in_kernel_memory_range(unsigned long addr);
-
-static mem_header_t *free_list;
+static memory_region_t *find_region(unsigned long addr);
+static void add_memory_region(unsigned long end, range_check_t reason);
+static void add_free_block(unsigned long start, unsigned long end);
+
+// The regions of the address space in increasing order, with the reason a range
+// starting in the region is invalid
+static memory_region_t memory_regions[NUM_MEMORY_REGIONS];
+static int num_memory_regions;
+
+// The usable memory past the page allocator, added to the heap as extra blocks
+static e820_region_t extra_heaps[E820_MAX_REGIONS];
+// The largest block the heap ever has
+static unsigned long largest_heap_block;
+
+// bins[i] is the list of free blocks of size class i
+static mem_header_t *bins[NUM_SIZE_CLASSES];
+// Bit i is set if bins[i] is non-empty
+static unsigned long bin_bitmap;
+
+// Size of the block holding a stack of the default size, including the header
+#define STACK_BLOCK_SIZE (PROCESS_STACK_SIZE + sizeof(mem_header_t))
+// Recycled stacks of the default size, used as a stack
+static mem_header_t *stack_pool[STACK_POOL_SIZE];
+static int stack_pool_count;
+
+// Allocator statistics, stacks in the stack pool are counted as in use
+static unsigned long bytes_in_use;
+static int num_allocs;
+static int num_frees;
+static int failed_allocs;
 
 /*-----------------------------------------------------------------------------------
  * To be only called by the kernel, before any memory allocations occur.
@@ -68,27 +173,93 @@ static mem_header_t *free_list;
 void kmeminit(void) {
     kprintf("\nStarting kmeminit...\n");
 
+    // The image and the kernel stack that follows it must be below the hole, or the
+    // globals at the end of the bss are in video memory and the option ROMs
+    assert(freemem <= HOLESTART, "The kernel image and its stack overlap the hole");
+
+    // The hole starts where the memory below it ends, if that is sooner
+    unsigned long hole_start = HOLESTART;
+    e820_region_t *low_region = e820_find_region(freemem);
+    if (low_region != NULL && low_region->end < hole_start) {
+        hole_start = low_region->end;
+    }
+    // The page allocator takes the memory that follows the hole
+    e820_region_t *high_region = e820_find_region(HOLEEND);
+    assert(high_region != NULL, "No memory after the hole");
+    kprintf("Memory map %s, %d regions, memory after the hole up to %x\n",
+            e820_from_bios() ? "from the BIOS" : "assumed", e820_region_count(), high_region->end);
+
     freemem_aligned = round_up_to_paragraph(freemem);
-    hole_start_aligned = round_down_to_paragraph(HOLESTART);
+    hole_start_aligned = round_down_to_paragraph(hole_start);
     hole_end_aligned = round_up_to_paragraph(HOLEEND);
     max_addr_aligned = round_down_to_paragraph((unsigned long) maxaddr);
-
-    // Initially, the free list should contain the block before the hole and the block after the hole
-    // Initialize the block before the hole
-    free_list = (mem_header_t *) freemem_aligned;
-    free_list->size = hole_start_aligned - freemem_aligned;
-    free_list->sanity_check = NULL;
-
-    // Initialize the block after the hole
-    mem_header_t *post_hole_block = (mem_header_t *) hole_end_aligned;
-    post_hole_block->size = max_addr_aligned - hole_end_aligned;
-    post_hole_block->sanity_check = NULL;
-
-    // Link the blocks together
-    free_list->prev = NULL;
-    free_list->next = post_hole_block;
-    post_hole_block->prev = free_list;
-    post_hole_block->next = NULL;
+    // The region table and the heap before the hole need memory between the kernel
+    // and the hole, a memory map whose memory below 640K ends sooner is not usable
+    assert(hole_start_aligned > freemem_aligned, "No memory between the kernel and the hole");
+
+    // Build the region table used to validate memory passed in by processes, the
+    // gaps of the memory map after the hole are holes too
+    num_memory_regions = 0;
+    add_memory_region(freemem_aligned, RANGE_IN_KERNEL);
+    add_memory_region(hole_start, RANGE_OK);
+    add_memory_region(HOLEEND, RANGE_IN_HOLE);
+    // The memory ends before maxaddr, the last address
+    unsigned long memory_end = (unsigned long) maxaddr;
+    add_memory_region(high_region->end < memory_end ? high_region->end : memory_end, RANGE_OK);
+    for (int i = 0; i < e820_region_count(); i++) {
+        e820_region_t *region = e820_get_region(i);
+        if (region->start > high_region->start) {
+            add_memory_region(region->start, RANGE_IN_HOLE);
+            add_memory_region(region->end < memory_end ? region->end : memory_end, RANGE_OK);
+        }
+    }
+    add_memory_region(VSTACK_BASE, RANGE_BEYOND_MEMORY);
+    // Process stacks are in virtual memory in paging mode
+    add_memory_region(VSTACK_END, PAGING_ENABLED ? RANGE_OK : RANGE_BEYOND_MEMORY);
+    add_memory_region(~0UL, RANGE_BEYOND_MEMORY);
+
+    // Initially, all bins are empty
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        bins[i] = NULL;
+    }
+    bin_bitmap = 0;
+    bytes_in_use = 0;
+    num_allocs = 0;
+    num_frees = 0;
+    failed_allocs = 0;
+
+    // The memory after the hole belongs to the page allocator, kmalloc takes a block
+    // of pages from it for the heap after the hole
+    kpageinit(hole_end_aligned, high_region->end);
+    void *heap = NULL;
+    for (int order = KMALLOC_HEAP_ORDER; heap == NULL && order >= 0; order--) {
+        heap = kpagealloc(order);
+        heap_end_aligned = (unsigned long) heap + (NBPG << order);
+    }
+    assert(heap != NULL, "Not enough memory for the heap after the hole");
+    heap_start_aligned = (unsigned long) heap;
+
+    // Initially, there is a free block before the hole and a free block after the hole
+    largest_heap_block = 0;
+    add_free_block(freemem_aligned, hole_start_aligned);
+    add_free_block(heap_start_aligned, heap_end_aligned);
+
+    // The memory past the gaps of the memory map, and what is left of the memory that
+    // follows the hole past the last whole page of the arena, are extra blocks
+    num_extra_heaps = 0;
+    extra_heap_bytes = 0;
+    for (int i = 0; i < e820_region_count(); i++) {
+        e820_region_t *region = e820_get_region(i);
+        unsigned long start = region == high_region ? page_arena_end : region->start;
+        unsigned long end = region->end < max_addr_aligned ? region->end : max_addr_aligned;
+        if (region->start >= high_region->start && start < end && end - start >= MIN_BLOCK_SIZE) {
+            extra_heaps[num_extra_heaps].start = start;
+            extra_heaps[num_extra_heaps].end = end;
+            num_extra_heaps++;
+            extra_heap_bytes += end - start;
+            add_free_block(start, end);
+        }
+    }
 
     kprintf("Finished kmeminit\n");
 }
@@ -103,51 +274,168 @@ void kmeminit(void) {
  *-----------------------------------------------------------------------------------
  */
 void *kmalloc(size_t req_sz) {
-    size_t max_size = max_addr_aligned - freemem_aligned - HEADER_SIZE;
+    size_t max_size = largest_heap_block - HEADER_SIZE;
     if (req_sz <= 0 || req_sz > max_size) {
+        failed_allocs++;
         return 0;
     }
     // Compute amount of memory to set aside for this request
     size_t size = round_up_to_paragraph(req_sz) + HEADER_SIZE;
 
-    // Scan free list looking for block
-    mem_header_t *mem_slot = free_list;
-    while (mem_slot != NULL) {
-        // If free block is large enough to allocate to, allocate to block
-        if (size <= mem_slot->size) {
-            if (size != mem_slot->size) {
-                split_off_free_block(size, mem_slot);
-            }
-            // Fill in header fields
-            mem_slot->size = size;
-            mem_slot->sanity_check = (char *) mem_slot->data_start;
+    // Find a free block from the bins
+    mem_header_t *mem_slot = find_free_block(size);
+    if (mem_slot == NULL) {
+        // No suitable free blocks were found
+        failed_allocs++;
+        return 0;
+    }
+    remove_from_bin(mem_slot);
 
-            // Remove block from free list
-            if (mem_slot->prev) {
-                mem_slot->prev->next = mem_slot->next;
-            } else {
-                // The first block was allocated, start free list at block after
-                free_list = mem_slot->next;
-            }
-            if (mem_slot->next) {
-                mem_slot->next->prev = mem_slot->prev;
-            }
+    // Only split if the bytes left over can form a free block
+    if (block_size(mem_slot) - size >= MIN_BLOCK_SIZE) {
+        split_off_free_block(size, mem_slot);
+    } else {
+        // The block after this one no longer follows a free block
+        mem_header_t *next_block = next_physical_block(mem_slot);
+        if (next_block != NULL) {
+            next_block->size &= ~PREV_FREE;
+        }
+    }
+    // Fill in header fields
+    mem_slot->prev = NULL;
+    mem_slot->next = NULL;
+    mem_slot->sanity_check = (char *) mem_slot->data_start;
+    bytes_in_use += block_size(mem_slot);
+    num_allocs++;
+
+    unsigned long data_start = (unsigned long) mem_slot->data_start;
+    assert(in_free_memory_range(data_start),
+           "Address returned by kmalloc is not in the range of allocatable memory");
+    assert(on_paragraph_boundary(data_start), "Address returned by kmalloc is not on paragraph boundary");
+    return mem_slot->data_start;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finds a free block that is large enough to hold the given number of bytes. The
+ * head of the bin for the size class of the request is tried first, so that a block
+ * of about the right size is not passed over. Otherwise, the smallest non-empty bin
+ * whose blocks are all large enough is found with a bit-scan on the bin bitmap. Only
+ * if both fail is the bin for the size class of the request scanned in full.
+ *
+ * @param size The number of bytes needed, including the header
+ * @return     A free block of at least the given size, NULL if there is none
+ *-----------------------------------------------------------------------------------
+ */
+static mem_header_t *find_free_block(size_t size) {
+    int class = size_class(size);
+    mem_header_t *block = bins[class];
+    if (block != NULL && size <= block_size(block)) {
+        return block;
+    }
+
+    // Every block in a bin at or above this size class is large enough
+    int fit_class = size_class_fit(size);
+    if (fit_class < NUM_SIZE_CLASSES) {
+        unsigned long fitting_bins = bin_bitmap & (~0UL << fit_class);
+        if (fitting_bins != 0) {
+            return bins[find_first_set_bit(fitting_bins)];
+        }
+    }
 
-            unsigned long data_start = (unsigned long) mem_slot->data_start;
-            assert(in_free_memory_range(data_start),
-                   "Address returned by kmalloc is not in the range of allocatable memory");
-            assert(on_paragraph_boundary(data_start), "Address returned by kmalloc is not on paragraph boundary");
-            return mem_slot->data_start;
+    // Fall back to first fit within the bin for the size class of the request
+    while (block != NULL) {
+        if (size <= block_size(block)) {
+            return block;
         }
-        mem_slot = mem_slot->next;
+        block = block->next;
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the size class of a block with the given size, ie. the bin it is kept on.
+ *
+ * @param size The size of the block, including the header
+ * @return     The size class of the block
+ *-----------------------------------------------------------------------------------
+ */
+static int size_class(size_t size) {
+    int class = find_last_set_bit(size) - MIN_BLOCK_SHIFT;
+    if (class < 0) {
+        return 0;
+    }
+    if (class >= NUM_SIZE_CLASSES) {
+        return NUM_SIZE_CLASSES - 1;
+    }
+    return class;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smallest size class in which every block can hold the given size.
+ *
+ * @param size The number of bytes needed, including the header
+ * @return     The smallest size class whose blocks are all at least size bytes,
+ *             NUM_SIZE_CLASSES if no such size class exists
+ *-----------------------------------------------------------------------------------
+ */
+static int size_class_fit(size_t size) {
+    int class = find_last_set_bit(size) - MIN_BLOCK_SHIFT;
+    // Round up if size is not a power of two
+    if (size & (size - 1)) {
+        class++;
+    }
+    if (class < 0) {
+        return 0;
+    }
+    // The last bin is unbounded, so it only guarantees its lower bound
+    if (class >= NUM_SIZE_CLASSES) {
+        return NUM_SIZE_CLASSES;
+    }
+    return class;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a free block to the head of the bin for its size class.
+ *
+ * @param block The free block to add
+ *-----------------------------------------------------------------------------------
+ */
+static void insert_into_bin(mem_header_t *block) {
+    int class = size_class(block_size(block));
+    block->prev = NULL;
+    block->next = bins[class];
+    if (bins[class] != NULL) {
+        bins[class]->prev = block;
+    }
+    bins[class] = block;
+    bin_bitmap |= 1UL << class;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes a free block from the bin for its size class.
+ *
+ * @param block The free block to remove, must be on the bin for its current size
+ *-----------------------------------------------------------------------------------
+ */
+static void remove_from_bin(mem_header_t *block) {
+    int class = size_class(block_size(block));
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        bins[class] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    if (bins[class] == NULL) {
+        bin_bitmap &= ~(1UL << class);
     }
-    // No suitable free blocks were found
-    return 0;
 }
 
 /*-----------------------------------------------------------------------------------
  * Splits off a free block of the given size from the given block, creating another
- * free block with the bytes left over.
+ * free block with the bytes left over. The block created is added to the bin for its
+ * size class, the block split from is expected to have been removed from its bin.
  *
  * @param block The free block to split from
  * @param size  The number of bytes to split off from the free block
@@ -155,17 +443,13 @@ void *kmalloc(size_t req_sz) {
  */
 static void split_off_free_block(size_t size, mem_header_t *block) {
     mem_header_t *remaining_block = (mem_header_t *) ((size_t) block + size);
-    remaining_block->size = block->size - size;
+    // The block before the remaining block is being allocated
+    remaining_block->size = block_size(block) - size;
     remaining_block->sanity_check = NULL;
+    write_footer(remaining_block);
+    insert_into_bin(remaining_block);
 
-    remaining_block->prev = block;
-    remaining_block->next = block->next;
-    if (remaining_block->next != NULL) {
-        remaining_block->next->prev = remaining_block;
-    }
-
-    block->size = size;
-    block->next = remaining_block;
+    set_block_size(block, size);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -177,95 +461,250 @@ static void split_off_free_block(size_t size, mem_header_t *block) {
  *-----------------------------------------------------------------------------------
  */
 int kfree(void *ptr) {
-    if (ptr == NULL) {
-        return 0;
-    }
-    unsigned long addr = (unsigned long) ptr;
-    if (!in_free_memory_range(addr) || !on_paragraph_boundary(addr)) {
-        return 0;
-    }
-    // Determine start of allocated area
-    mem_header_t *block_to_free = (mem_header_t *) (ptr - HEADER_SIZE);
-    if (!in_free_memory_range((unsigned long) block_to_free)
-        || !on_paragraph_boundary((unsigned long) block_to_free)
-        || block_to_free->sanity_check != ptr) {
+    mem_header_t *block_to_free = allocated_block(ptr);
+    if (block_to_free == NULL) {
         return 0;
     }
 
     block_to_free->sanity_check = NULL;
+    bytes_in_use -= block_size(block_to_free);
+    num_frees++;
+
+    // Merge freed block with its physical neighbours if they are free
+    // Merge if next block is free
+    mem_header_t *next_block = next_physical_block(block_to_free);
+    if (next_block != NULL && next_block->sanity_check == NULL) {
+        remove_from_bin(next_block);
+        set_block_size(block_to_free, block_size(block_to_free) + block_size(next_block));
+    } else if (next_block != NULL) {
+        // The next block now follows a free block
+        next_block->size |= PREV_FREE;
+    }
+    // Merge if previous block is free
+    mem_header_t *prev_block = prev_physical_block(block_to_free);
+    if (prev_block != NULL) {
+        remove_from_bin(prev_block);
+        set_block_size(prev_block, block_size(prev_block) + block_size(block_to_free));
+        block_to_free = prev_block;
+    }
 
-    // Add memory back to free list
-    mem_header_t *prev_mem_slot = NULL;
-    mem_header_t *next_mem_slot = free_list;
+    // Add memory back to the bin for the size class of the merged block
+    write_footer(block_to_free);
+    insert_into_bin(block_to_free);
+    return 1;
+}
 
-    while (next_mem_slot != NULL && next_mem_slot < block_to_free) {
-        prev_mem_slot = next_mem_slot;
-        next_mem_slot = next_mem_slot->next;
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, after kmeminit. Pre-warms the stack pool with
+ * STACK_POOL_SIZE stacks of the default size.
+ *-----------------------------------------------------------------------------------
+ */
+void kstackinit(void) {
+    while (stack_pool_count < STACK_POOL_SIZE) {
+        void *stack = kmalloc(PROCESS_STACK_SIZE);
+        assert(stack != NULL, "Not enough memory to pre-warm the stack pool");
+        pool_stack(stack);
     }
-    // prev_mem_slot now points to the block that should be before the freed block
-    // next_mem_slot now points to the block that should be after the freed block
+}
 
-    block_to_free->prev = prev_mem_slot;
-    block_to_free->next = next_mem_slot;
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel. Allocates a process stack, taking it from the
+ * stack pool if it is of the default size and the pool is not empty.
+ *
+ * @param size Number of bytes to allocate for the stack
+ * @return     A pointer to the start of the stack if successful, 0 if not enough
+ *             memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *kstackalloc(size_t size) {
+    if (round_up_to_paragraph(size) == PROCESS_STACK_SIZE && stack_pool_count > 0) {
+        mem_header_t *block = stack_pool[--stack_pool_count];
+        block->sanity_check = (char *) block->data_start;
+        return block->data_start;
+    }
+    return kmalloc(size);
+}
 
-    // Adjust free list pointers
-    if (prev_mem_slot == NULL) {
-        // Freed block is at the start
-        free_list = block_to_free;
-    } else {
-        prev_mem_slot->next = block_to_free;
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel. Takes a pointer to a stack allocated by
+ * kstackalloc and returns it to the stack pool if it is of the default size and the
+ * pool is not full, otherwise to the free memory pool.
+ *
+ * @param ptr A pointer to a stack allocated by kstackalloc
+ * @return    1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int kstackfree(void *ptr) {
+    mem_header_t *block = allocated_block(ptr);
+    if (block == NULL) {
+        return 0;
+    }
+    if (block_size(block) == STACK_BLOCK_SIZE && stack_pool_count < STACK_POOL_SIZE) {
+        pool_stack(ptr);
+        return 1;
     }
+    return kfree(ptr);
+}
 
-    if (next_mem_slot != NULL) {
-        next_mem_slot->prev = block_to_free;
+/*-----------------------------------------------------------------------------------
+ * Adds an allocated stack of the default size to the stack pool. The block stays
+ * allocated, but its sanity check no longer matches, so that it cannot be freed
+ * while it is in the pool.
+ *-----------------------------------------------------------------------------------
+ */
+static void pool_stack(void *ptr) {
+    mem_header_t *block = (mem_header_t *) (ptr - HEADER_SIZE);
+    block->sanity_check = (char *) block;
+    stack_pool[stack_pool_count++] = block;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the header of the allocated block starting at the given pointer.
+ *
+ * @param ptr A pointer to a previously allocated block of memory
+ * @return    The header of the block, NULL if ptr is not an allocated block
+ *-----------------------------------------------------------------------------------
+ */
+static mem_header_t *allocated_block(void *ptr) {
+    if (ptr == NULL) {
+        return NULL;
     }
+    unsigned long addr = (unsigned long) ptr;
+    if (!in_free_memory_range(addr) || !on_paragraph_boundary(addr)) {
+        return NULL;
+    }
+    // Determine start of allocated area
+    mem_header_t *block = (mem_header_t *) (ptr - HEADER_SIZE);
+    if (!in_free_memory_range((unsigned long) block)
+        || !on_paragraph_boundary((unsigned long) block)
+        || block->sanity_check != ptr) {
+        return NULL;
+    }
+    return block;
+}
 
-    // Merge freed block with any blocks in the free list that it is adjacent to
-    // Merge if adjacent to next block
-    if (are_adjacent_blocks(block_to_free, block_to_free->next)) {
-        merge_blocks(block_to_free, block_to_free->next);
+/*-----------------------------------------------------------------------------------
+ * Fills the given structure with the live allocator statistics. The free bytes are
+ * counted per region by walking the bins.
+ *
+ * @param stats A pointer to the structure to fill
+ *-----------------------------------------------------------------------------------
+ */
+void get_mem_stats(mem_stats_t *stats) {
+    stats->bytes_in_use = bytes_in_use;
+    stats->pre_hole_free_bytes = 0;
+    stats->post_hole_free_bytes = 0;
+    stats->largest_free_block = 0;
+    stats->free_block_count = 0;
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        mem_header_t *curr = bins[i];
+        while (curr != NULL) {
+            unsigned long size = block_size(curr);
+            if ((unsigned long) curr < hole_start_aligned) {
+                stats->pre_hole_free_bytes += size;
+            } else {
+                stats->post_hole_free_bytes += size;
+            }
+            if (size > stats->largest_free_block) {
+                stats->largest_free_block = size;
+            }
+            stats->free_block_count++;
+            curr = curr->next;
+        }
     }
-    // Merge if adjacent to previous block
-    if (are_adjacent_blocks(block_to_free->prev, block_to_free)) {
-        merge_blocks(block_to_free->prev, block_to_free);
+    stats->free_pages = get_free_page_count();
+    stats->num_allocs = num_allocs;
+    stats->num_frees = num_frees;
+    stats->failed_allocs = failed_allocs;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds an entry to the end of the region table, covering the addresses from the end
+ * of the previous entry up to the given end.
+ *-----------------------------------------------------------------------------------
+ */
+static void add_memory_region(unsigned long end, range_check_t reason) {
+    memory_regions[num_memory_regions].end = end;
+    memory_regions[num_memory_regions].reason = reason;
+    num_memory_regions++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Puts the memory from start up to end into the bins as a single free block, whose
+ * previous block is not free.
+ *-----------------------------------------------------------------------------------
+ */
+static void add_free_block(unsigned long start, unsigned long end) {
+    mem_header_t *block = (mem_header_t *) start;
+    block->size = end - start;
+    block->sanity_check = NULL;
+    write_footer(block);
+    insert_into_bin(block);
+    if (end - start > largest_heap_block) {
+        largest_heap_block = end - start;
     }
-    return 1;
 }
 
 /*-----------------------------------------------------------------------------------
- * Checks whether the given free blocks are adjacent.
+ * Returns the size of the given block, including the header.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long block_size(mem_header_t *block) {
+    return block->size & ~PREV_FREE;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sets the size of the given block, preserving its PREV_FREE flag.
+ *-----------------------------------------------------------------------------------
+ */
+static void set_block_size(mem_header_t *block, unsigned long size) {
+    block->size = size | (block->size & PREV_FREE);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the footer of the given free block.
+ *-----------------------------------------------------------------------------------
+ */
+static void write_footer(mem_header_t *block) {
+    mem_footer_t *footer = (mem_footer_t *) ((unsigned long) block + block_size(block) - sizeof(mem_footer_t));
+    footer->header = block;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the block physically after the given block.
  *
- * @param left_block  The left block to check
- * @param right_block The right block to check
- * @return            1 if blocks are adjacent, 0 otherwise
+ * @param block The block to find the next block of
+ * @return      The next block, NULL if the given block is the last block before the
+ *              hole or before the end of the heap after the hole
  *-----------------------------------------------------------------------------------
  */
-static int are_adjacent_blocks(mem_header_t *left_block, mem_header_t *right_block) {
-    if (left_block == NULL || right_block == NULL) {
-        return 0;
+static mem_header_t *next_physical_block(mem_header_t *block) {
+    unsigned long next_addr = (unsigned long) block + block_size(block);
+    if (next_addr == hole_start_aligned || next_addr == heap_end_aligned) {
+        return NULL;
     }
-    unsigned long left_block_addr = (unsigned long) left_block;
-    unsigned long right_block_addr = (unsigned long) right_block;
-    if (left_block_addr + left_block->size == right_block_addr) {
-        return 1;
-    } else {
-        return 0;
+    for (int i = 0; i < num_extra_heaps; i++) {
+        if (next_addr == extra_heaps[i].end) {
+            return NULL;
+        }
     }
+    return (mem_header_t *) next_addr;
 }
 
 /*-----------------------------------------------------------------------------------
- * Merges the given free blocks into one. Will merge the right block into the left.
+ * Returns the block physically before the given block if it is free, using the
+ * footer of the free block.
  *
- * @param left_block  The left block to merge
- * @param right_block The right block to merge, will become part of left block
+ * @param block The block to find the previous block of
+ * @return      The previous block if it is free, NULL otherwise
  *-----------------------------------------------------------------------------------
  */
-static void merge_blocks(mem_header_t *left_block, mem_header_t *right_block) {
-    left_block->size = left_block->size + right_block->size;
-    left_block->next = right_block->next;
-    if (left_block->next != NULL) {
-        left_block->next->prev = left_block;
+static mem_header_t *prev_physical_block(mem_header_t *block) {
+    if (!(block->size & PREV_FREE)) {
+        return NULL;
     }
+    mem_footer_t *footer = (mem_footer_t *) ((unsigned long) block - sizeof(mem_footer_t));
+    return footer->header;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -288,7 +727,12 @@ static int on_paragraph_boundary(unsigned long addr) {
  */
 static int in_free_memory_range(unsigned long addr) {
     int in_pre_hole = addr >= freemem_aligned && addr <= hole_start_aligned;
-    int in_post_hole = addr >= hole_end_aligned && addr <= max_addr_aligned;
+    int in_post_hole = addr >= heap_start_aligned && addr <= heap_end_aligned;
+    for (int i = 0; i < num_extra_heaps; i++) {
+        if (addr >= extra_heaps[i].start && addr <= extra_heaps[i].end) {
+            return 1;
+        }
+    }
     return in_pre_hole || in_post_hole;
 }
 
@@ -317,18 +761,57 @@ static unsigned long round_down_to_paragraph(unsigned long to_align) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Checks if a given pointer is valid.
+ * Checks a whole range of memory passed in by a process against the region table
+ * and returns why it is invalid, if it is. A range is valid if it lies entirely in
+ * the memory available to processes, or also in the kernel if allow_kernel is set.
+ *
+ * @param ptr          The start of the range
+ * @param length       The number of bytes in the range
+ * @param allow_kernel 1 if the range may lie in kernel memory, 0 otherwise
+ * @return             RANGE_OK if the range is valid, otherwise the reason it is not
+ *-----------------------------------------------------------------------------------
+ */
+range_check_t check_range(void *ptr, unsigned long length, int allow_kernel) {
+    unsigned long start = (unsigned long) ptr;
+    unsigned long last = start + length - 1;
+    if (start == 0) {
+        return RANGE_NULL;
+    }
+    if (length == 0) {
+        return RANGE_EMPTY;
+    }
+    if (last < start) {
+        return RANGE_OVERFLOW;
+    }
+
+    // Every region the range crosses must be valid, a range from one valid region to
+    // another may still span the hole or a gap of the memory map between them
+    memory_region_t *region = find_region(start);
+    for (;;) {
+        range_check_t reason = region->reason;
+        if (reason == RANGE_IN_KERNEL && allow_kernel) {
+            reason = RANGE_OK;
+        }
+        if (reason != RANGE_OK || last < region->end || region == &memory_regions[num_memory_regions - 1]) {
+            return reason;
+        }
+        region++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Checks if a given pointer is valid, it may point into kernel memory.
  *
  * @param ptr The pointer to check
  * @return    1 if the pointer is valid, 0 otherwise
  *-----------------------------------------------------------------------------------
  */
 int valid_ptr(void *ptr) {
-    return ptr != NULL && in_memory_range((unsigned long) ptr);
+    return check_range(ptr, 1, 1) == RANGE_OK;
 }
 
 /*-----------------------------------------------------------------------------------
- * Checks if a given buffer is valid.
+ * Checks if a given buffer is valid, it may not lie in kernel memory.
  *
  * @param ptr    The pointer to check
  * @param length The length of the buffer
@@ -336,73 +819,57 @@ int valid_ptr(void *ptr) {
  *-----------------------------------------------------------------------------------
  */
 int valid_buf(void *ptr, unsigned long length) {
-    if (valid_ptr(ptr) && !in_kernel_memory_range((unsigned long) ptr) && length > 0) {
-        unsigned long buf_start = (unsigned long) ptr;
-        unsigned long buf_end = buf_start + length;
-        return in_memory_range(buf_end) && !in_kernel_memory_range(buf_end);
-    }
-    return 0;
-}
-
-/*-----------------------------------------------------------------------------------
- * Checks if the given address is in the valid range for a process.
- *
- * @param addr The address to check
- * @return     1 if the address is in the valid range, 0 otherwise
- *-----------------------------------------------------------------------------------
- */
-static int in_memory_range(unsigned long addr) {
-    int in_pre_hole = addr > 0 && addr < HOLESTART;
-    int in_post_hole = addr >= HOLEEND && addr < (unsigned long) maxaddr;
-    return in_pre_hole || in_post_hole;
+    return check_range(ptr, length, 0) == RANGE_OK;
 }
 
 /*-----------------------------------------------------------------------------------
- * Checks if the given address is in the range of kernel memory.
- *
- * @param addr The address to check
- * @return     1 if the address is in the range of kernel memory, 0 otherwise
+ * Returns the entry of the region table that contains the given address.
  *-----------------------------------------------------------------------------------
  */
-static int in_kernel_memory_range(unsigned long addr) {
-    return addr > 0 && addr < freemem_aligned;
+static memory_region_t *find_region(unsigned long addr) {
+    memory_region_t *region = memory_regions;
+    while (addr >= region->end && region < &memory_regions[num_memory_regions - 1]) {
+        region++;
+    }
+    return region;
 }
 
 /* Functions for testing */
 
 /*-----------------------------------------------------------------------------------
- * Returns the length of the free list.
+ * Returns the length of the free list, ie. the number of free blocks over all bins.
  *
  * @return The length of the free list
  *-----------------------------------------------------------------------------------
  */
 int get_free_list_length(void) {
-    if (free_list == NULL) {
-        return 0;
-    }
     int length = 0;
-    mem_header_t *curr = free_list;
-    while (curr != NULL) {
-        length++;
-        curr = curr->next;
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        mem_header_t *curr = bins[i];
+        while (curr != NULL) {
+            length++;
+            curr = curr->next;
+        }
     }
     return length;
 }
 
 /*-----------------------------------------------------------------------------------
- * Prints the free list.
+ * Prints the free list, bin by bin.
  *-----------------------------------------------------------------------------------
  */
 void print_free_list(void) {
     kprintf("\nFree list:\n");
-    if (free_list == NULL) {
+    if (bin_bitmap == 0) {
         kprintf("Empty\n");
     }
     int count = 0;
-    mem_header_t *curr = free_list;
-    while (curr != NULL) {
-        count++;
-        kprintf("Block %d: 0x%x\n", count, curr);
-        curr = curr->next;
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        mem_header_t *curr = bins[i];
+        while (curr != NULL) {
+            count++;
+            kprintf("Block %d: 0x%x, size %d, bin %d\n", count, curr, block_size(curr), i);
+            curr = curr->next;
+        }
     }
 }
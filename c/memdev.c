@@ -0,0 +1,299 @@
+/* memdev.c : null, zero and loopback device driver calls */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <memdev.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where the memory devices live, which are backed by nothing but kernel
+ * memory. They go through the same sysopen, sysread and syswrite paths, the DII and
+ * the devsw_t calls as any device, but never wait for hardware, so timing them
+ * measures the cost of the device path itself.
+ *
+ * Notes on the memory devices:
+ * - /dev/null discards what is written to it, and a read of it returns an
+ *   end-of-file (EOF) indication
+ * - /dev/zero discards what is written to it, and a read of it fills the buffer
+ *   with zero bytes
+ * - /dev/loop0 returns what was written to it, through a ring of LOOP_BUFFER_SIZE
+ *   bytes. A write takes only what fits and a read of the empty ring returns EOF,
+ *   so neither ever blocks
+ * - Any number of processes may have the devices open, the loopback ring is shared
+ *   by all of them
+ *
+ * List of functions that are called from outside this file:
+ * - memdev_register
+ *   - Registers the null, zero and loopback devices
+ * - memdevinit
+ *   - Memory device specific call for di_init
+ * - memdevopen
+ *   - Memory device specific call for di_open
+ * - memdevclose
+ *   - Memory device specific call for di_close
+ * - nullread, zeroread, loopread
+ *   - Memory device specific calls for di_read
+ * - nullwrite, loopwrite
+ *   - Memory device specific calls for di_write
+ * - memdevioctl
+ *   - Memory device specific call for di_ioctl
+ * - memdevpoll, looppoll
+ *   - Memory device specific calls for syspoll
+ * - memdevaioread
+ *   - Memory device specific call for di_aioread
+ *-----------------------------------------------------------------------------------
+ */
+
+static void fill_devsw(devsw_t *devsw);
+static int min(int a, int b);
+
+// The device structures registered in the device table
+static devsw_t null_devsw;
+static devsw_t zero_devsw;
+static devsw_t loop_devsw;
+
+// The ring of the loopback device
+// The indices count bytes from the start and are masked into the ring, so the ring
+// is full when they are LOOP_BUFFER_SIZE apart
+static char loop_ring[LOOP_BUFFER_SIZE];
+static unsigned int loop_head;
+static unsigned int loop_tail;
+
+/*======================== MEMORY DEVICE DRIVERS ==================================*/
+
+/*-----------------------------------------------------------------------------------
+ * Registers the null, zero and loopback devices as NULL_0, ZERO_0 and LOOP_0.
+ *-----------------------------------------------------------------------------------
+ */
+void memdev_register(void) {
+    fill_devsw(&null_devsw);
+    null_devsw.dvread = &nullread;
+    di_register(&null_devsw, "/dev/null", NULL_0, 0);
+
+    fill_devsw(&zero_devsw);
+    zero_devsw.dvread = &zeroread;
+    di_register(&zero_devsw, "/dev/zero", ZERO_0, 0);
+
+    fill_devsw(&loop_devsw);
+    loop_devsw.dvread = &loopread;
+    loop_devsw.dvwrite = &loopwrite;
+    loop_devsw.dvpoll = &looppoll;
+    di_register(&loop_devsw, "/dev/loop0", LOOP_0, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the memory devices. The loopback ring starts empty.
+ *
+ * @return 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int memdevinit(void) {
+    loop_head = loop_tail = 0;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Memory device specific call for di_open. Any number of processes may have the
+ * devices open.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int memdevopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Memory device specific call for di_close.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int memdevclose(devsw_t *devsw, pcb_t *proc) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Null device specific call for di_read. There is never anything to read.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            0 to indicate end-of-file (EOF)
+ *-----------------------------------------------------------------------------------
+ */
+int nullread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Zero device specific call for di_read. Fills the buffer with zero bytes.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read, buflen
+ *-----------------------------------------------------------------------------------
+ */
+int zeroread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    fill_words(buf, 0, buflen);
+    return buflen;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Loopback device specific call for di_read. Takes the oldest bytes written.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF) once the ring is empty
+ *                    BLOCKERR if the ring is empty in non-blocking mode
+ *-----------------------------------------------------------------------------------
+ */
+int loopread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    if (loop_head == loop_tail) {
+        return nonblocking ? BLOCKERR : 0;
+    }
+    char *data = (char *) buf;
+    int len = min(buflen, loop_head - loop_tail);
+    int done = 0;
+    // At most two copies, up to the end of the ring and from its start
+    while (done < len) {
+        int offset = loop_tail & LOOP_BUFFER_MASK;
+        int n = min(len - done, LOOP_BUFFER_SIZE - offset);
+        copy_words(data + done, &loop_ring[offset], n);
+        loop_tail += n;
+        done += n;
+    }
+    return done;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Null and zero device specific call for di_write. Discards the bytes.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written, buflen
+ *-----------------------------------------------------------------------------------
+ */
+int nullwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    return buflen;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Loopback device specific call for di_write. Queues as many of the bytes as fit in
+ * the ring.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written, 0 if the ring is full
+ *-----------------------------------------------------------------------------------
+ */
+int loopwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    char *data = (char *) buf;
+    int len = min(buflen, LOOP_BUFFER_SIZE - (loop_head - loop_tail));
+    int done = 0;
+    while (done < len) {
+        int offset = loop_head & LOOP_BUFFER_MASK;
+        int n = min(len - done, LOOP_BUFFER_SIZE - offset);
+        copy_words(&loop_ring[offset], data + done, n);
+        loop_head += n;
+        done += n;
+    }
+    return done;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Memory device specific call for di_ioctl. The memory devices have no control
+ * commands.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command
+ * @param ioctl_args Additional parameters
+ * @return           -1 as there are no control commands
+ *-----------------------------------------------------------------------------------
+ */
+int memdevioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Null and zero device specific call for syspoll. A read never blocks.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 as a read would not block
+ *-----------------------------------------------------------------------------------
+ */
+int memdevpoll(devsw_t *devsw, pcb_t *proc) {
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Loopback device specific call for syspoll. There is input while the ring holds
+ * bytes.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 if the ring holds bytes, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int looppoll(devsw_t *devsw, pcb_t *proc) {
+    return loop_head != loop_tail;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Memory device specific call for di_aioread. Reads of the memory devices never
+ * block, so there is nothing to complete asynchronously.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as asynchronous reads are not supported
+ *-----------------------------------------------------------------------------------
+ */
+int memdevaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Fills in the calls the memory devices share, those of the null device.
+ *-----------------------------------------------------------------------------------
+ */
+static void fill_devsw(devsw_t *devsw) {
+    devsw->dvioblk = NULL;
+    devsw->dvinit = &memdevinit;
+    devsw->dvopen = &memdevopen;
+    devsw->dvclose = &memdevclose;
+    devsw->dvread = &nullread;
+    devsw->dvwrite = &nullwrite;
+    devsw->dvioctl = &memdevioctl;
+    devsw->dvpoll = &memdevpoll;
+    devsw->dvaioread = &memdevaioread;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smaller of the given integers.
+ *-----------------------------------------------------------------------------------
+ */
+static int min(int a, int b) {
+    return a < b ? a : b;
+}
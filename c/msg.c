@@ -8,86 +8,140 @@
 /*-----------------------------------------------------------------------------------
  * This is the messaging system used by the kernel for servicing IPC requests.
  *
+ * Notes on messages:
+ * - syssend and sysrecv carry a single unsigned long, syssendv and sysrecvv a
+ *   buffer of up to MAX_MESSAGE_SIZE bytes, and either kind of send matches either
+ *   kind of receive
+ * - The message is copied straight from the buffer of the sender into the buffer of
+ *   the receiver, a word at a time, and is truncated to the shorter of the two
+ *
+ * Notes on receiving from any process:
+ * - A process receiving from any process, or from a set of processes with
+ *   sysrecvset, is blocked on no queue, its blocked_queue of RECEIVE_ANY tells a
+ *   send that it waits, so the send finds it without searching
+ * - The set is checked against the PID of the sender, MAX_RECV_SET PIDs at most,
+ *   an empty set accepts every sender
+ * - Messages already waiting are taken from the queue of senders of the receiving
+ *   process, the earliest one from a process in the set is received
+ *
+ * Notes on remote procedure calls:
+ * - sysrpc sends a request and receives the reply from the same process in a
+ *   single system call, the caller goes from the queue of senders of the server
+ *   straight onto its queue of receivers without being made ready in between
+ * - sysreplywait replies to the caller waiting on the server and receives the next
+ *   request in a single system call, the reply is dropped if the caller no longer
+ *   waits for it
+ *
+ * Notes on preemptible messages:
+ * - syssendv and sysrecvv go through preemptcall, and a message to or from a
+ *   process that already waits for it is copied COPY_STEP_SIZE bytes a step by
+ *   preemptible_dispatch. A call that would block is left to the dispatcher
+ * - The waiting process is claimed before the first step: it is taken off the
+ *   queue it is on, its timeout is cancelled, and it is blocked as COPYING on the
+ *   copying process, on no queue, so no other send or receive matches it
+ * - A claimed process that is signalled is unblocked as from any other queue, and
+ *   the copying process finds it gone on its next step. A copying process that
+ *   terminates unblocks the process it claimed with -1
+ *
  * List of functions that are called from outside this file:
  * - send
- *   - Implements the kernel side of syssend
+ *   - Implements the kernel side of syssend and syssendv
  * - recv
- *   - Implements the kernel side of sysrecv
+ *   - Implements the kernel side of sysrecv and sysrecvv
+ * - start_reply_wait
+ *   - Turns the delivered request of a caller of sysrpc into the receive of the
+ *     reply
+ * - ipc_timeout
+ *   - Fails the send or receive a process is blocked on with TIMEOUT
+ * - claim_peer
+ *   - Claims the process waiting for the message of a preemptible send or receive
+ * - copy_message_step
+ *   - Copies the next step of the message of a preemptible send or receive
+ * - release_peer
+ *   - Unblocks the process claimed by a process that terminates
  *-----------------------------------------------------------------------------------
  */
 
-// The list of processes waiting on a receive-any
-Queue receive_any_queue;
+static int transfer(pcb_t *send_proc, pcb_t *recv_proc);
+static int message_result(pcb_t *proc, int len);
+static void complete_send(pcb_t *send_proc, pcb_t *recv_proc, int len);
+static int receives_any_from(pcb_t *recv_proc, pcb_t *send_proc);
+static int in_recv_set(pcb_t *recv_proc, unsigned int pid);
+static pcb_t *first_sender_in_set(pcb_t *recv_proc);
+static int is_claimed(pcb_t *peer, pcb_t *proc);
+
+// Bytes of a message copied by a step of a preemptible send or receive
+#define COPY_STEP_SIZE 512
 
 /*-----------------------------------------------------------------------------------
- * Implements the kernel side of syssend. Called by the dispatcher upon
- * receipt of a syssend request to perform the actual work of the system
- * call.
+ * Implements the kernel side of syssend and syssendv. Called by the dispatcher upon
+ * receipt of a send request to perform the actual work of the system call. The
+ * message is described by the ipc_buf and ipc_len of the sending process.
  *
  * @param send_proc A pointer to the PCB of the sending process
  * @param recv_proc A pointer to the PCB of the receiving process
  *                  - Validated by the dispatcher to not be the sending process
  *                    or invalid
- * @param send_buf  The buffer containing the data to send
- * @return          0 on success, −1 if the sending process was blocked, or
- *                  −100 if any other problem is detected
+ * @return          The number of bytes delivered on success, −1 if the sending
+ *                  process was blocked, or −100 if any other problem is detected
  *-----------------------------------------------------------------------------------
  */
-int send(pcb_t *send_proc, pcb_t *recv_proc, unsigned long *send_buf) {
+int send(pcb_t *send_proc, pcb_t *recv_proc) {
+    TRACE(TRACE_IPC, TRACE_SEND, send_proc->pid, recv_proc->pid, send_proc->ipc_len);
     // If the receiving process is on the queue of receivers of the sending process, or
-    // if the receiving process is willing to receive from any process
-    if (remove_from_blocked_queue(recv_proc, send_proc, RECEIVER) || remove_from_receive_any_queue(recv_proc)) {
+    // if the receiving process is willing to receive from any process in a set the
+    // sending process is in
+    if (remove_from_blocked_queue(recv_proc, send_proc, RECEIVER) || receives_any_from(recv_proc, send_proc)) {
         // The receiving process is blocked on a receive from the sending process
-        unsigned int *from_pid = (unsigned int *) recv_proc->ipc_args[0];
-        unsigned int *recv_buff = (unsigned int *) recv_proc->ipc_args[1];
-        *from_pid = send_proc->pid;
+        *recv_proc->ipc_from_pid = send_proc->pid;
         // Copy the message into the receive buffer
-        strncpy((char *) recv_buff, (char *) send_buf, BUFFER_SIZE);
+        int len = transfer(send_proc, recv_proc);
 
         // Unblock receiving process
-        recv_proc->result_code = 0;
+        recv_proc->result_code = message_result(recv_proc, len);
         ready(recv_proc);
-        return 0;
+        return len;
     }
     // syssend was called before the matching sysrecv:
     // The receiving process is not blocked on a matching receive
     // The sending process is blocked until the matching receive occurs
     // Add the sending process to the queue of senders of the receiving process
     enqueue_blocked_queue(send_proc, recv_proc, SENDER);
+    // The receiving process may be polling for a process waiting to send
+    poll_check(recv_proc);
     return -1;
 }
 
 /*-----------------------------------------------------------------------------------
- * Implements the kernel side of sysrecv. Called by the dispatcher upon
- * receipt of a sysrecv request to perform the actual work of the system
- * call.
+ * Implements the kernel side of sysrecv and sysrecvv. Called by the dispatcher upon
+ * receipt of a receive request to perform the actual work of the system call. The
+ * buffer to receive into is described by the ipc_buf and ipc_len of the receiving
+ * process.
  *
  * @param recv_proc A pointer to the PCB of the receiving process
  * @param send_proc A pointer to the PCB of the sending process, NULL if the
- *                  receiving process is willing to receive from any process
+ *                  receiving process is willing to receive from any process in
+ *                  its ipc_recv_set
  *                  - If not NULL, validated by the dispatcher to not be the
  *                    receiving process or invalid
  * @param from_pid  The address containing the PID of the sending process
  *                  - Validated by the dispatcher to not be invalid
- * @param recv_buf  The buffer to receive the data, validated by the dispatcher
- *                  - Validated by the dispatcher to not be invalid
- * @return          0 on success, −1 if the receiving process was blocked, or
- *                  −100 if any other problem is detected
+ * @return          The number of bytes received on success, −1 if the receiving
+ *                  process was blocked, or −100 if any other problem is detected
  *-----------------------------------------------------------------------------------
  */
-int recv(pcb_t *recv_proc, pcb_t *send_proc, unsigned int *from_pid, unsigned int *recv_buf) {
+int recv(pcb_t *recv_proc, pcb_t *send_proc, unsigned int *from_pid) {
+    TRACE(TRACE_IPC, TRACE_RECV, recv_proc->pid, send_proc ? send_proc->pid : 0, recv_proc->ipc_len);
     if (send_proc != NULL) {
         // If the sending process is on the queue of senders of the receiving process
         if (remove_from_blocked_queue(send_proc, recv_proc, SENDER)) {
             // The sending process is blocked on a send to the receiving process
-            unsigned long *send_buf = &send_proc->ipc_args[1];
             // Copy the message into the receive buffer
-            strncpy((char *) recv_buf, (char *) send_buf, BUFFER_SIZE);
+            int len = transfer(send_proc, recv_proc);
 
-            // Unblock sending process
-            send_proc->result_code = 0;
-            ready(send_proc);
-            return 0;
+            // Unblock sending process, or have a caller of sysrpc wait for the reply
+            complete_send(send_proc, recv_proc, len);
+            return len;
         } else {
             // sysrecv was called before the matching syssend:
             // The sending process is not blocked on a matching send
@@ -97,29 +151,255 @@ int recv(pcb_t *recv_proc, pcb_t *send_proc, unsigned int *from_pid, unsigned in
             return -1;
         }
     } else {
-        // The receiving process is willing to receive from any process
-        // The earliest unreceived send to the receiving process is the matching send to the receive
-        pcb_t *send_proc = dequeue(&recv_proc->blocked_queues[SENDER]);
+        // The receiving process is willing to receive from any process in its set
+        // The earliest unreceived send from the set is the matching send to the receive
+        pcb_t *send_proc = first_sender_in_set(recv_proc);
         if (send_proc != NULL) {
+            // The receiving process no longer inherits the priority of the sender
+            remove_from_blocked_queue(send_proc, recv_proc, SENDER);
             // A process is waiting to send to the receiving process
-            unsigned long *send_buf = &send_proc->ipc_args[1];
             // Copy the message into the receive buffer
-            strncpy((char *) recv_buf, (char *) send_buf, BUFFER_SIZE);
+            int len = transfer(send_proc, recv_proc);
 
             // Update from_pid to reflect the PID of the sending process
             *from_pid = send_proc->pid;
 
-            // Unblock sending process
-            send_proc->result_code = 0;
-            ready(send_proc);
-            return 0;
+            // Unblock sending process, or have a caller of sysrpc wait for the reply
+            complete_send(send_proc, recv_proc, len);
+            return len;
         } else {
             // No process is ready to send to the receiving process
-            // The receiving process is blocked until a process sends to it
+            // The receiving process is blocked until a process sends to it, on no
+            // queue since a send checks its set directly
             recv_proc->state = BLOCKED;
             recv_proc->blocked_queue = RECEIVE_ANY;
-            enqueue(&receive_any_queue, recv_proc);
             return -1;
         }
     }
 }
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the receiving process is blocked on a receive from any process and
+ * accepts a message from the sending process, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int receives_any_from(pcb_t *recv_proc, pcb_t *send_proc) {
+    return recv_proc->state == BLOCKED && recv_proc->blocked_queue == RECEIVE_ANY &&
+           in_recv_set(recv_proc, send_proc->pid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given PID is in the set the receiving process accepts messages
+ * from, or the set is empty, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int in_recv_set(pcb_t *recv_proc, unsigned int pid) {
+    if (recv_proc->cold->ipc_recv_set_size == 0) {
+        return 1;
+    }
+    for (int i = 0; i < recv_proc->cold->ipc_recv_set_size; i++) {
+        if (recv_proc->cold->ipc_recv_set[i] == pid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the earliest process on the queue of senders of the receiving process
+ * that is in the set it accepts messages from, NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *first_sender_in_set(pcb_t *recv_proc) {
+    pcb_t *send_proc = recv_proc->cold->blocked_queues[SENDER].head;
+    while (send_proc != NULL && !in_recv_set(recv_proc, send_proc->pid)) {
+        send_proc = send_proc->next;
+    }
+    return send_proc;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the message of the sending process into the buffer of the receiving
+ * process, truncated to the length of the buffer.
+ *
+ * @return The number of bytes copied
+ *-----------------------------------------------------------------------------------
+ */
+static int transfer(pcb_t *send_proc, pcb_t *recv_proc) {
+    unsigned int len = send_proc->ipc_len < recv_proc->ipc_len ? send_proc->ipc_len : recv_proc->ipc_len;
+    copy_words(recv_proc->ipc_buf, send_proc->ipc_buf, len);
+    send_proc->messages_sent++;
+    recv_proc->messages_received++;
+    return len;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Completes the send of the given blocked process, whose message has just been
+ * received. The sending process is unblocked, unless it is a caller of sysrpc,
+ * which is moved onto the queue of receivers of the receiving process to wait for
+ * the reply.
+ *
+ * @param send_proc A pointer to the PCB of the sending process
+ * @param recv_proc A pointer to the PCB of the receiving process
+ * @param len       The number of bytes delivered
+ *-----------------------------------------------------------------------------------
+ */
+static void complete_send(pcb_t *send_proc, pcb_t *recv_proc, int len) {
+    if (send_proc->ipc_reply_buf != NULL) {
+        start_reply_wait(send_proc);
+        enqueue_blocked_queue(send_proc, recv_proc, RECEIVER);
+        return;
+    }
+    send_proc->result_code = message_result(send_proc, len);
+    ready(send_proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Turns the request of a caller of sysrpc, which has been delivered, into the
+ * receive of the reply. The caller is not placed on any queue.
+ *
+ * @param proc A pointer to the PCB of the caller
+ *-----------------------------------------------------------------------------------
+ */
+void start_reply_wait(pcb_t *proc) {
+    proc->ipc_buf = proc->ipc_reply_buf;
+    proc->ipc_len = BUFFER_SIZE;
+    proc->ipc_vectored = 0;
+    proc->ipc_reply_buf = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the result of a completed send or receive for the given process, the
+ * number of bytes copied for syssendv and sysrecvv, 0 for the single word calls.
+ *-----------------------------------------------------------------------------------
+ */
+static int message_result(pcb_t *proc, int len) {
+    return proc->ipc_vectored ? len : 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the sleep device when the timeout of a syssendtim or sysrecvtim
+ * expires before the operation completes. Takes the process off the queue it is
+ * blocked on and unblocks it with TIMEOUT.
+ *
+ * @param proc A pointer to the PCB of the blocked process
+ *-----------------------------------------------------------------------------------
+ */
+void ipc_timeout(pcb_t *proc) {
+    switch (proc->blocked_queue) {
+        case (SENDER):
+        case (RECEIVER):
+            remove_from_blocked_queue(proc, proc->blocked_on, proc->blocked_queue);
+            break;
+        case (RECEIVE_ANY):
+            // The process is on no queue
+            break;
+        default:
+            assert(0, "timed out process is not blocked on IPC");
+    }
+    proc->result_code = TIMEOUT;
+    ready(proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Claims the process whose message the given process is to copy in steps, if it
+ * already waits for the message, see the notes at the start of the file.
+ *
+ * @param proc    A pointer to the PCB of the process making the call
+ * @param peer    A pointer to the PCB of the other process, NULL if proc receives
+ *                from any process in its ipc_recv_set
+ *                - If not NULL, validated by the caller to not be proc or invalid
+ * @param sending 1 if proc is sending, 0 if it is receiving
+ * @return        A pointer to the PCB of the claimed process, NULL if no process
+ *                waits for the message
+ *-----------------------------------------------------------------------------------
+ */
+pcb_t *claim_peer(pcb_t *proc, pcb_t *peer, int sending) {
+    if (sending) {
+        if (!remove_from_blocked_queue(peer, proc, RECEIVER) && !receives_any_from(peer, proc)) {
+            return NULL;
+        }
+    } else {
+        if (peer == NULL) {
+            peer = first_sender_in_set(proc);
+        }
+        if (peer == NULL || !remove_from_blocked_queue(peer, proc, SENDER)) {
+            return NULL;
+        }
+    }
+    // The message is on its way, so it no longer times out
+    cancel_timeout(peer);
+    peer->state = BLOCKED;
+    peer->blocked_queue = COPYING;
+    peer->blocked_on = proc;
+    proc->ipc_peer = peer;
+    return peer;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the next COPY_STEP_SIZE bytes of the message between the given process and
+ * the process it claimed, and completes the send and the receive once the whole
+ * message is copied, as send and recv would.
+ *
+ * @param proc    A pointer to the PCB of the process making the call
+ * @param sending 1 if proc is sending, 0 if it is receiving
+ * @param copied  The number of bytes the steps before copied, updated by the step
+ * @return        1 once the message is delivered, 0 if there is more to copy, or -1
+ *                if the claimed process has been unblocked since the last step
+ *-----------------------------------------------------------------------------------
+ */
+int copy_message_step(pcb_t *proc, int sending, unsigned int *copied) {
+    pcb_t *peer = proc->ipc_peer;
+    if (!is_claimed(peer, proc)) {
+        proc->ipc_peer = NULL;
+        return -1;
+    }
+    pcb_t *send_proc = sending ? proc : peer;
+    pcb_t *recv_proc = sending ? peer : proc;
+    unsigned int len = send_proc->ipc_len < recv_proc->ipc_len ? send_proc->ipc_len : recv_proc->ipc_len;
+    unsigned int n = len - *copied < COPY_STEP_SIZE ? len - *copied : COPY_STEP_SIZE;
+    copy_words((char *) recv_proc->ipc_buf + *copied, (char *) send_proc->ipc_buf + *copied, n);
+    *copied += n;
+    if (*copied < len) {
+        return 0;
+    }
+
+    proc->ipc_peer = NULL;
+    send_proc->messages_sent++;
+    recv_proc->messages_received++;
+    *recv_proc->ipc_from_pid = send_proc->pid;
+    if (sending) {
+        recv_proc->result_code = message_result(recv_proc, len);
+        ready(recv_proc);
+    } else {
+        // Unblock sending process, or have a caller of sysrpc wait for the reply
+        complete_send(send_proc, recv_proc, len);
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unblocks the process the given process claimed with -1, as if the given process
+ * had terminated before the matching send or receive. Called when the given process
+ * terminates, part way through the copy or not.
+ *
+ * @param proc A pointer to the PCB of the terminating process
+ *-----------------------------------------------------------------------------------
+ */
+void release_peer(pcb_t *proc) {
+    pcb_t *peer = proc->ipc_peer;
+    proc->ipc_peer = NULL;
+    if (is_claimed(peer, proc)) {
+        peer->result_code = -1;
+        ready(peer);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the given peer is still blocked as claimed by the given process, 0 if
+ * it has been unblocked or there is no peer.
+ *-----------------------------------------------------------------------------------
+ */
+static int is_claimed(pcb_t *peer, pcb_t *proc) {
+    return peer != NULL && peer->state == BLOCKED && peer->blocked_queue == COPYING && peer->blocked_on == proc;
+}
@@ -0,0 +1,259 @@
+/* page.c : page allocator
+ */
+
+#include <i386.h>
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the page allocator where page-aligned blocks of 2^order pages are
+ * allocated from the memory above the hole, using the buddy system.
+ *
+ * Notes on the buddy system:
+ * - The free blocks of each order are kept on a doubly-linked list, the links are
+ *   stored in the first bytes of the free block itself
+ * - A bitmap records which orders have free blocks, so that the smallest free block
+ *   that is large enough is found with a single bit-scan
+ * - A block of order k that starts at page i of the arena has its buddy at page
+ *   i ^ 2^k, a freed block is merged with its buddy for as long as the buddy is free
+ *   and of the same order
+ * - page_info records for the first page of every block whether the block is free
+ *   or allocated and its order, the remaining pages of a block are marked unused
+ * - page_info has a byte per page of the arena and takes the first pages of the
+ *   memory given to kpageinit, so the arena covers all of that memory whatever its
+ *   size
+ *
+ * List of functions that are called from outside this file:
+ * - kpageinit
+ *   - Initializes the page allocator over the given range of memory
+ * - kpagealloc
+ *   - Returns a pointer to the start of the allocated pages if successful, NULL if
+ *     no block of the given order is available
+ * - kpagefree
+ *   - Returns 1 on success, 0 on failure
+ * - page_order
+ *   - Returns the smallest order that holds the given number of bytes
+ * - get_free_page_count
+ *   - Returns the number of free pages
+ *-----------------------------------------------------------------------------------
+ */
+
+// Set in page_info for the first page of a block
+#define PAGE_HEAD 0x80
+// Set in page_info for the first page of a free block
+#define PAGE_FREE 0x40
+#define PAGE_ORDER_MASK 0x3f
+
+typedef struct page_block {
+    struct page_block *prev;
+    struct page_block *next;
+} page_block_t;
+
+static void insert_free_block(unsigned long index, int order);
+static void remove_free_block(unsigned long index, int order);
+static unsigned long page_index(void *addr);
+static void *page_addr(unsigned long index);
+
+unsigned long page_arena_start;
+unsigned long page_arena_end;
+static unsigned long num_pages;
+
+// free_areas[k] is the list of free blocks of order k
+static page_block_t *free_areas[NUM_PAGE_ORDERS];
+// Bit k is set if free_areas[k] is non-empty
+static unsigned long free_area_bitmap;
+static unsigned char *page_info;
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, before any pages are allocated. Initializes the
+ * page allocator over the whole pages between the given addresses, carving them
+ * into the largest blocks whose start is aligned to their size. The first pages
+ * hold page_info, the rest are the arena.
+ *
+ * @param start The start of the memory to manage
+ * @param end   The end of the memory to manage
+ *-----------------------------------------------------------------------------------
+ */
+void kpageinit(unsigned long start, unsigned long end) {
+    unsigned long first_page = (start + NBPG - 1) & ~(NBPG - 1);
+    unsigned long total_pages = ((end & ~(NBPG - 1)) - first_page) / NBPG;
+    unsigned long info_pages = (total_pages + NBPG - 1) / NBPG;
+    assert(total_pages > info_pages, "kpageinit: no memory for the arena");
+
+    page_info = (unsigned char *) first_page;
+    page_arena_start = first_page + info_pages * NBPG;
+    num_pages = total_pages - info_pages;
+    page_arena_end = page_arena_start + num_pages * NBPG;
+
+    for (int i = 0; i < NUM_PAGE_ORDERS; i++) {
+        free_areas[i] = NULL;
+    }
+    free_area_bitmap = 0;
+    fill_words(page_info, 0, num_pages);
+
+    unsigned long index = 0;
+    while (index < num_pages) {
+        int order = NUM_PAGE_ORDERS - 1;
+        while (index % (1UL << order) != 0 || index + (1UL << order) > num_pages) {
+            order--;
+        }
+        insert_free_block(index, order);
+        index += 1UL << order;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel. Allocates a block of 2^order pages that is
+ * aligned to a page boundary.
+ *
+ * @param order The log2 of the number of pages to allocate
+ * @return      A pointer to the start of the block if successful, NULL if the order
+ *              is invalid or if no block of the given order is available
+ *-----------------------------------------------------------------------------------
+ */
+void *kpagealloc(int order) {
+    if (order < 0 || order >= NUM_PAGE_ORDERS) {
+        return NULL;
+    }
+    // Find the smallest order at or above the requested order with a free block
+    unsigned long available = free_area_bitmap & (~0UL << order);
+    if (available == 0) {
+        return NULL;
+    }
+    int block_order = find_first_set_bit(available);
+    unsigned long index = page_index(free_areas[block_order]);
+    remove_free_block(index, block_order);
+
+    // Split the block, returning the upper halves until it is of the requested order
+    while (block_order > order) {
+        block_order--;
+        insert_free_block(index + (1UL << block_order), block_order);
+    }
+    page_info[index] = PAGE_HEAD | order;
+    return page_addr(index);
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel. Takes a pointer to a block of pages allocated by
+ * kpagealloc and returns it to the page allocator, merging it with its buddies.
+ *
+ * @param ptr A pointer to a previously allocated block of pages
+ * @return    1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int kpagefree(void *ptr) {
+    unsigned long addr = (unsigned long) ptr;
+    if (addr < page_arena_start || addr >= page_arena_end || addr % NBPG != 0) {
+        return 0;
+    }
+    unsigned long index = page_index(ptr);
+    if ((page_info[index] & (PAGE_HEAD | PAGE_FREE)) != PAGE_HEAD) {
+        // Not the start of an allocated block
+        return 0;
+    }
+    int order = page_info[index] & PAGE_ORDER_MASK;
+    page_info[index] = 0;
+
+    while (order < NUM_PAGE_ORDERS - 1) {
+        unsigned long buddy = index ^ (1UL << order);
+        if (buddy >= num_pages || page_info[buddy] != (PAGE_HEAD | PAGE_FREE | order)) {
+            break;
+        }
+        remove_free_block(buddy, order);
+        page_info[buddy] = 0;
+        if (buddy < index) {
+            index = buddy;
+        }
+        order++;
+    }
+    insert_free_block(index, order);
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smallest order of a block of pages that holds the given number of
+ * bytes.
+ *
+ * @param size The number of bytes needed
+ * @return     The smallest order that holds size bytes, 0 for 0 bytes
+ *-----------------------------------------------------------------------------------
+ */
+int page_order(size_t size) {
+    unsigned long pages = (size + NBPG - 1) / NBPG;
+    if (pages <= 1) {
+        return 0;
+    }
+    return find_last_set_bit(pages - 1) + 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the block of the given order starting at the given page to its free list.
+ *-----------------------------------------------------------------------------------
+ */
+static void insert_free_block(unsigned long index, int order) {
+    page_block_t *block = (page_block_t *) page_addr(index);
+    block->prev = NULL;
+    block->next = free_areas[order];
+    if (free_areas[order] != NULL) {
+        free_areas[order]->prev = block;
+    }
+    free_areas[order] = block;
+    free_area_bitmap |= 1UL << order;
+    page_info[index] = PAGE_HEAD | PAGE_FREE | order;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the free block of the given order starting at the given page from its
+ * free list.
+ *-----------------------------------------------------------------------------------
+ */
+static void remove_free_block(unsigned long index, int order) {
+    page_block_t *block = (page_block_t *) page_addr(index);
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        free_areas[order] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    if (free_areas[order] == NULL) {
+        free_area_bitmap &= ~(1UL << order);
+    }
+    page_info[index] = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the index in the arena of the page at the given address.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long page_index(void *addr) {
+    return ((unsigned long) addr - page_arena_start) / NBPG;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the address of the page at the given index in the arena.
+ *-----------------------------------------------------------------------------------
+ */
+static void *page_addr(unsigned long index) {
+    return (void *) (page_arena_start + index * NBPG);
+}
+
+/* Functions for testing */
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of free pages.
+ *
+ * @return The number of free pages over all orders
+ *-----------------------------------------------------------------------------------
+ */
+int get_free_page_count(void) {
+    int count = 0;
+    for (int i = 0; i < NUM_PAGE_ORDERS; i++) {
+        page_block_t *curr = free_areas[i];
+        while (curr != NULL) {
+            count += 1 << i;
+            curr = curr->next;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,392 @@
+/* paging.c : paging and lazily mapped process stacks
+ */
+
+#include <i386.h>
+#include <xeroslib.h>
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where paging is set up when PAGING_ENABLED is set. All of physical memory
+ * is identity mapped, and process stacks become reserved ranges of virtual memory
+ * whose pages are only mapped when they are first touched.
+ *
+ * Notes on the stack slots:
+ * - The virtual memory starting at VSTACK_BASE is divided into VSTACK_SLOT_SIZE
+ *   slots, one for each process stack
+ * - A stack occupies the top of its slot, the pages below it are never mapped and
+ *   act as guard pages that catch a stack overflow
+ * - The top page of a stack is mapped when the stack is allocated, as it holds the
+ *   initial context of the process, every other page is mapped by the page fault
+ *   handler on first touch
+ *
+ * Notes on the page fault handler:
+ * - Processes run on their own stacks at the same privilege level as the kernel, so a
+ *   page fault caused by touching an unmapped stack page cannot push its exception
+ *   frame onto that stack without faulting again. The page fault vector is therefore
+ *   a task gate, and the handler runs as its own task with its own stack
+ * - Everything else runs as the main task, whose TSS receives the registers of the
+ *   interrupted code on a page fault
+ * - On a stack overflow the faulting process is redirected to stack_overflow_exit on
+ *   the top page of its stack, where it terminates itself
+ *
+ * List of functions that are called from outside this file:
+ * - kpaginginit
+ *   - Builds the page tables and enables paging
+ * - vstack_alloc
+ *   - Returns the lowest address of a new stack, NULL on failure
+ * - vstack_free
+ *   - Unmaps a stack and frees its pages
+ * - vstack_mapped_bytes
+ *   - Returns the number of bytes of a stack that are mapped
+ *-----------------------------------------------------------------------------------
+ */
+
+#define PAGES_PER_TABLE 1024
+#define PAGE_PRESENT 0x1
+#define PAGE_WRITABLE 0x2
+#define PAGE_FRAME_MASK (~(NBPG - 1))
+#define CR0_PG 0x80000000
+// Selectors of the TSS descriptors in the GDT
+#define MAIN_TSS_SELECTOR (5 * 8)
+#define PAGE_FAULT_TSS_SELECTOR (6 * 8)
+#define PAGE_FAULT_INTERRUPT_NUMBER 14
+#define PAGE_FAULT_STACK_SIZE 1024
+#define TSS_TYPE_AVAILABLE 9
+
+typedef struct tss {
+    unsigned short link, reserved0;
+    unsigned long esp0;
+    unsigned short ss0, reserved1;
+    unsigned long esp1;
+    unsigned short ss1, reserved2;
+    unsigned long esp2;
+    unsigned short ss2, reserved3;
+    unsigned long cr3;
+    unsigned long eip;
+    unsigned long eflags;
+    unsigned long eax, ecx, edx, ebx;
+    unsigned long esp, ebp, esi, edi;
+    unsigned short es, reserved4;
+    unsigned short cs, reserved5;
+    unsigned short ss, reserved6;
+    unsigned short ds, reserved7;
+    unsigned short fs, reserved8;
+    unsigned short gs, reserved9;
+    unsigned short ldt, reserved10;
+    unsigned short trap, iomap_base;
+} tss_t;
+
+extern struct sd gdt[];
+extern struct idt idt[256];
+extern char *maxaddr;
+
+void _PageFaultTaskEntry(void);
+void handle_page_fault(void);
+
+static void set_tss_descriptor(int index, tss_t *tss);
+static void stack_overflow_exit(void);
+static unsigned long *vstack_pte(unsigned long addr);
+static int vstack_slot(unsigned long addr);
+static unsigned long vstack_slot_top(int slot);
+static void flush_tlb(void);
+static void page_fault_halt(char *reason, unsigned long addr);
+
+static unsigned long *page_directory;
+// Page table covering the stack slots
+static unsigned long *vstack_page_table;
+// Lowest page of the stack in each slot, 0 if the slot is free
+static unsigned long vstack_start[NUM_VSTACK_SLOTS];
+
+static tss_t main_tss;
+static tss_t page_fault_tss;
+static unsigned long page_fault_stack[PAGE_FAULT_STACK_SIZE / sizeof(unsigned long)];
+
+/*------------------------------------------------------------------------
+ * The page fault task. Each page fault switches to this task with the
+ * error code pushed on its stack, and the iret switches back to the
+ * interrupted task. The next page fault resumes after the iret.
+ *------------------------------------------------------------------------
+ */
+__asm__(
+".text;"
+"_PageFaultTaskEntry:"
+        "call handle_page_fault;"
+        // Pop the error code
+        "addl $4, %esp;"
+        "iret;"
+        "jmp _PageFaultTaskEntry;"
+);
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, after kmeminit and before any processes are
+ * created. Identity maps physical memory, reserves the page table for the stack
+ * slots, installs the page fault task and enables paging.
+ *-----------------------------------------------------------------------------------
+ */
+void kpaginginit(void) {
+    kprintf("\nStarting kpaginginit...\n");
+
+    page_directory = (unsigned long *) kpagealloc(0);
+    vstack_page_table = (unsigned long *) kpagealloc(0);
+    assert(page_directory != NULL && vstack_page_table != NULL, "Not enough memory for page tables");
+    fill_words(page_directory, 0, NBPG);
+    fill_words(vstack_page_table, 0, NBPG);
+
+    // Identity map physical memory, one page table for every 4MB
+    unsigned long num_pages = ((unsigned long) maxaddr + 1) / NBPG;
+    for (unsigned long table = 0; table * PAGES_PER_TABLE < num_pages; table++) {
+        unsigned long *page_table = (unsigned long *) kpagealloc(0);
+        assert(page_table != NULL, "Not enough memory for page tables");
+        for (unsigned long i = 0; i < PAGES_PER_TABLE; i++) {
+            unsigned long page = table * PAGES_PER_TABLE + i;
+            page_table[i] = page < num_pages ? (page * NBPG) | PAGE_PRESENT | PAGE_WRITABLE : 0;
+        }
+        page_directory[table] = (unsigned long) page_table | PAGE_PRESENT | PAGE_WRITABLE;
+    }
+    page_directory[VSTACK_BASE / (PAGES_PER_TABLE * NBPG)] =
+            (unsigned long) vstack_page_table | PAGE_PRESENT | PAGE_WRITABLE;
+
+    for (int i = 0; i < NUM_VSTACK_SLOTS; i++) {
+        vstack_start[i] = 0;
+    }
+
+    // The main task only needs a TSS to save its registers in on a task switch
+    fill_words(&main_tss, 0, sizeof(tss_t));
+    main_tss.iomap_base = sizeof(tss_t);
+    set_tss_descriptor(MAIN_TSS_SELECTOR / 8, &main_tss);
+
+    // The page fault task runs with interrupts disabled on its own stack
+    fill_words(&page_fault_tss, 0, sizeof(tss_t));
+    page_fault_tss.cr3 = (unsigned long) page_directory;
+    page_fault_tss.eip = (unsigned long) _PageFaultTaskEntry;
+    page_fault_tss.eflags = 0x2;
+    page_fault_tss.esp = (unsigned long) page_fault_stack + PAGE_FAULT_STACK_SIZE;
+    page_fault_tss.cs = 0x8;
+    page_fault_tss.ds = 0x10;
+    page_fault_tss.es = 0x10;
+    page_fault_tss.fs = 0x10;
+    page_fault_tss.gs = 0x10;
+    page_fault_tss.ss = 0x18;
+    page_fault_tss.iomap_base = sizeof(tss_t);
+    set_tss_descriptor(PAGE_FAULT_TSS_SELECTOR / 8, &page_fault_tss);
+
+    struct idt *pidt = &idt[PAGE_FAULT_INTERRUPT_NUMBER];
+    pidt->igd_loffset = 0;
+    pidt->igd_segsel = PAGE_FAULT_TSS_SELECTOR;
+    pidt->igd_rsvd = 0;
+    pidt->igd_mbz = 0;
+    pidt->igd_type = IGDT_TASK;
+    pidt->igd_dpl = 0;
+    pidt->igd_present = 1;
+    pidt->igd_hoffset = 0;
+
+    __asm__ volatile(
+    "ltr %%ax;"
+            "movl %%ebx, %%cr3;"
+            "movl %%cr0, %%ebx;"
+            "orl %%ecx, %%ebx;"
+            "movl %%ebx, %%cr0;"
+    :
+    : "a" (MAIN_TSS_SELECTOR), "b" (page_directory), "c" (CR0_PG)
+    );
+
+    kprintf("Finished kpaginginit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reserves a stack slot for a new stack and maps the top page of the stack.
+ *
+ * @param stack The size of the stack in bytes
+ * @return      The lowest address of the stack if successful, NULL if the stack is
+ *              too large, no slot is free or not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *vstack_alloc(int stack) {
+    unsigned long size = (stack + NBPG - 1) & PAGE_FRAME_MASK;
+    // Leave at least one guard page below the stack
+    if (size > VSTACK_SLOT_SIZE - NBPG) {
+        return NULL;
+    }
+    for (int slot = 0; slot < NUM_VSTACK_SLOTS; slot++) {
+        if (vstack_start[slot] == 0) {
+            unsigned long top = vstack_slot_top(slot);
+            void *page = kpagealloc(0);
+            if (page == NULL) {
+                return NULL;
+            }
+            *vstack_pte(top - NBPG) = (unsigned long) page | PAGE_PRESENT | PAGE_WRITABLE;
+            vstack_start[slot] = top - size;
+            // The stack ends at the top of the slot, even if not a whole number of pages
+            return (void *) (top - stack);
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unmaps the stack starting at the given address, frees its pages and frees its
+ * stack slot.
+ *
+ * @param mem_start The lowest address of a stack returned by vstack_alloc
+ *-----------------------------------------------------------------------------------
+ */
+void vstack_free(void *mem_start) {
+    int slot = vstack_slot((unsigned long) mem_start);
+    if (slot < 0 || vstack_start[slot] == 0) {
+        return;
+    }
+    // Free every mapped page of the slot, including the guard pages mapped on overflow
+    unsigned long base = vstack_slot_top(slot) - VSTACK_SLOT_SIZE;
+    for (unsigned long addr = base; addr < base + VSTACK_SLOT_SIZE; addr += NBPG) {
+        unsigned long *pte = vstack_pte(addr);
+        if (*pte & PAGE_PRESENT) {
+            kpagefree((void *) (*pte & PAGE_FRAME_MASK));
+            *pte = 0;
+        }
+    }
+    flush_tlb();
+    vstack_start[slot] = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of bytes of the given stack that are mapped, the peak usage of
+ * the stack rounded up to a page.
+ *
+ * @param mem_start The lowest address of the stack
+ * @param size      The size of the stack
+ * @return          The number of mapped bytes
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long vstack_mapped_bytes(void *mem_start, unsigned long size) {
+    unsigned long mapped = 0;
+    unsigned long start = (unsigned long) mem_start & PAGE_FRAME_MASK;
+    for (unsigned long addr = start; addr < (unsigned long) mem_start + size; addr += NBPG) {
+        if (*vstack_pte(addr) & PAGE_PRESENT) {
+            mapped += NBPG;
+        }
+    }
+    return mapped;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Handles a page fault in the page fault task. Maps a new page if the fault is in a
+ * stack, redirects the process to stack_overflow_exit if the fault is in the guard
+ * pages below its stack, and halts otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+void handle_page_fault(void) {
+    unsigned long addr;
+    __asm__ volatile("movl %%cr2, %0;" : "=r" (addr));
+
+    int slot = vstack_slot(addr);
+    if (slot < 0 || vstack_start[slot] == 0) {
+        page_fault_halt("Page fault outside of a stack", addr);
+    }
+
+    unsigned long top = vstack_slot_top(slot);
+    if (addr >= vstack_start[slot]) {
+        // First touch of a stack page
+        void *page = kpagealloc(0);
+        if (page == NULL) {
+            page_fault_halt("Not enough memory to grow stack", addr);
+        }
+        *vstack_pte(addr) = (unsigned long) page | PAGE_PRESENT | PAGE_WRITABLE;
+        return;
+    }
+
+    // Stack overflow, only a process running on the stack can be terminated
+    if (main_tss.esp < top - VSTACK_SLOT_SIZE || main_tss.esp >= top) {
+        page_fault_halt("Kernel overflowed a process stack", addr);
+    }
+    // Continue the process on the top page of its stack, which is always mapped
+    main_tss.esp = top - sizeof(context_frame_t) - 2 * sizeof(unsigned long);
+    main_tss.ebp = main_tss.esp;
+    main_tss.eip = (unsigned long) &stack_overflow_exit;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Where a process that overflowed its stack continues, terminates the process.
+ *-----------------------------------------------------------------------------------
+ */
+static void stack_overflow_exit(void) {
+    kprintf("Stack overflow in process %d\n", sysgetpid());
+    sysstop();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sets the GDT descriptor at the given index to an available TSS.
+ *-----------------------------------------------------------------------------------
+ */
+static void set_tss_descriptor(int index, tss_t *tss) {
+    struct sd *psd = &gdt[index];
+    unsigned long base = (unsigned long) tss;
+    unsigned long limit = sizeof(tss_t) - 1;
+
+    psd->sd_lolimit = limit;
+    psd->sd_hilimit = limit >> 16;
+    psd->sd_lobase = base;
+    psd->sd_midbase = base >> 16;
+    psd->sd_hibase = base >> 24;
+    // The 4 bit type is split over sd_perm and sd_iscode
+    psd->sd_perm = TSS_TYPE_AVAILABLE & 0x7;
+    psd->sd_iscode = TSS_TYPE_AVAILABLE >> 3;
+    psd->sd_isapp = 0;
+    psd->sd_dpl = 0;
+    psd->sd_present = 1;
+    psd->sd_avl = 0;
+    psd->sd_mbz = 0;
+    psd->sd_32b = 0;
+    psd->sd_gran = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the page table entry for the given address in the stack slots.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long *vstack_pte(unsigned long addr) {
+    return &vstack_page_table[(addr - VSTACK_BASE) / NBPG];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the stack slot containing the given address, -1 if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static int vstack_slot(unsigned long addr) {
+    if (addr < VSTACK_BASE || addr >= VSTACK_END) {
+        return -1;
+    }
+    return (addr - VSTACK_BASE) / VSTACK_SLOT_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the address just past the top of the given stack slot.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long vstack_slot_top(int slot) {
+    return VSTACK_BASE + (slot + 1) * VSTACK_SLOT_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Flushes the TLB by reloading the page directory, as invlpg is not available on
+ * the i386.
+ *-----------------------------------------------------------------------------------
+ */
+static void flush_tlb(void) {
+    __asm__ volatile(
+    "movl %%cr3, %%eax;"
+            "movl %%eax, %%cr3;"
+    :
+    :
+    : "%eax"
+    );
+}
+
+/*-----------------------------------------------------------------------------------
+ * Prints the reason for an unrecoverable page fault and halts, as trap does.
+ *-----------------------------------------------------------------------------------
+ */
+static void page_fault_halt(char *reason, unsigned long addr) {
+    kprintf("%s at address %x\n", reason, addr);
+    kprintf("\nHalting.....\n");
+    for (;;);
+}
@@ -0,0 +1,178 @@
+/* pgrp.c : process groups
+ */
+
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where processes are grouped into jobs, so a whole job can be signalled or
+ * waited for with one system call. A group is named by its group ID, the PID of the
+ * process that made it, and holds its members on a list that runs through their
+ * PCBs, so signalling a group is one pass over its members whatever the size of the
+ * PCB table.
+ *
+ * Notes on process groups:
+ * - A process created by a system call starts in the group of the process that
+ *   created it, a process created by the kernel and a thread are in no group
+ * - A group lives as long as it has members, also once the process that made it has
+ *   terminated
+ * - The list of a group is found in the group table at the slot of the PCB its group
+ *   ID was first given to. The slot is taken until the group is empty, so a process
+ *   whose PCB held the leader of a group that lives on cannot make a group of its
+ *   own until then
+ *
+ * List of functions that are called from outside this file:
+ * - kpgrpinit
+ *   - Initializes the group table to empty
+ * - pgrp_join
+ *   - Moves a process to a group, making the group if it is named after the process
+ * - pgrp_leave
+ *   - Takes a process out of its group
+ * - pgrp_signal
+ *   - Sends a signal to every member of a group, returns how many were signalled
+ * - pgrp_has_child
+ *   - Returns 1 if a group has a member that is a child of a process
+ *-----------------------------------------------------------------------------------
+ */
+
+typedef struct pgrp {
+    // The ID of the group in the slot, and its first member, NULL if the slot is free
+    PID_t pgid;
+    pcb_t *first;
+} pgrp_t;
+
+static pgrp_t *get_pgrp(PID_t pgid);
+
+static pgrp_t pgrp_table[MAX_PROCESSES];
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any processes are created. Empties the group table.
+ *-----------------------------------------------------------------------------------
+ */
+void kpgrpinit(void) {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        pgrp_table[i].pgid = 0;
+        pgrp_table[i].first = NULL;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the given process from its group to the group with the given ID. The group
+ * is made if its ID is the PID of the process.
+ *
+ * @param proc A pointer to the PCB of the process, which is not a thread
+ * @param pgid The ID of the group to join
+ * @return     0 on success, -1 if the group does not exist and cannot be made
+ *-----------------------------------------------------------------------------------
+ */
+int pgrp_join(pcb_t *proc, PID_t pgid) {
+    if (proc->pgid == pgid) {
+        return 0;
+    }
+    pgrp_t *pgrp = get_pgrp(pgid);
+    if (pgrp == NULL) {
+        pgrp = &pgrp_table[(pgid - 1) % MAX_PROCESSES];
+        if (pgid != proc->pid || pgrp->first != NULL) {
+            return -1;
+        }
+        pgrp->pgid = pgid;
+    }
+    pgrp_leave(proc);
+
+    proc->pgid = pgid;
+    proc->pgrp_prev = NULL;
+    proc->pgrp_next = pgrp->first;
+    if (pgrp->first != NULL) {
+        pgrp->first->pgrp_prev = proc;
+    }
+    pgrp->first = proc;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given process out of its group, if it is in one. The group is gone once
+ * its last member leaves.
+ *
+ * @param proc A pointer to the PCB of the process
+ *-----------------------------------------------------------------------------------
+ */
+void pgrp_leave(pcb_t *proc) {
+    pgrp_t *pgrp = get_pgrp(proc->pgid);
+    if (pgrp == NULL) {
+        return;
+    }
+    if (proc->pgrp_prev == NULL) {
+        pgrp->first = proc->pgrp_next;
+    } else {
+        proc->pgrp_prev->pgrp_next = proc->pgrp_next;
+    }
+    if (proc->pgrp_next != NULL) {
+        proc->pgrp_next->pgrp_prev = proc->pgrp_prev;
+    }
+    proc->pgid = 0;
+    proc->pgrp_prev = NULL;
+    proc->pgrp_next = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syskillpg. Sends the given signal to every member of
+ * the group with the given ID, as syskill would to each of them.
+ *
+ * @param pgid          The ID of the group
+ * @param signal_number The signal to send
+ * @return              The number of members signalled
+ *                      -514 if the group does not exist
+ *                      -583 if the signal number is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int pgrp_signal(PID_t pgid, int signal_number) {
+    pgrp_t *pgrp = get_pgrp(pgid);
+    if (pgrp == NULL) {
+        return -514;
+    }
+    if (signal_number < 0 || signal_number >= SIGNAL_TABLE_SIZE) {
+        return -583;
+    }
+    // Signalling a member leaves it in the group, even when it unblocks it
+    int count = 0;
+    for (pcb_t *member = pgrp->first; member != NULL; member = member->pgrp_next) {
+        signal(member, signal_number);
+        count++;
+    }
+    return count;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the group with the given ID has a member that is a child of the
+ * process with the given PID, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+int pgrp_has_child(PID_t pgid, PID_t parent_pid) {
+    pgrp_t *pgrp = get_pgrp(pgid);
+    if (pgrp == NULL) {
+        return 0;
+    }
+    for (pcb_t *member = pgrp->first; member != NULL; member = member->pgrp_next) {
+        if (member->parent_pid == parent_pid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the group with the given ID.
+ *
+ * @param pgid The ID of the group
+ * @return     The group, NULL if it does not exist
+ *-----------------------------------------------------------------------------------
+ */
+static pgrp_t *get_pgrp(PID_t pgid) {
+    if (pgid < 1) {
+        return NULL;
+    }
+    pgrp_t *pgrp = &pgrp_table[(pgid - 1) % MAX_PROCESSES];
+    if (pgrp->first == NULL || pgrp->pgid != pgid) {
+        return NULL;
+    }
+    return pgrp;
+}
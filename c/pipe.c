@@ -0,0 +1,371 @@
+/* pipe.c : pipe specific device driver calls */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <queue.h>
+#include <pipe.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where pipe specific device driver calls live. A pipe is a virtual device
+ * that streams bytes written by one process to the processes reading it, through a
+ * ring buffer in the kernel, so processes can pass data of any length without
+ * splitting it into messages.
+ *
+ * Notes on pipes:
+ * - Each pipe has a ring of PIPE_BUFFER_SIZE bytes, reached through the dvioblk of
+ *   its device structure, so all pipes share the functions in this file
+ * - A read returns as soon as any bytes are available, with up to the requested
+ *   number of them, and only blocks when the pipe is empty
+ * - A write returns once all of its bytes are in the ring or handed to readers,
+ *   the writing process is blocked while the ring is full and the rest of its bytes
+ *   are moved in as readers free space
+ * - Readers only wait on an empty pipe, so a write hands its bytes straight to them
+ *   before filling the ring
+ * - A pipe counts the opens of all processes, a read of an empty pipe returns an
+ *   end-of-file (EOF) indication and a write to a full pipe returns the bytes
+ *   written so far when the caller is the only holder, since no other process
+ *   could write or read the rest
+ * - A process blocked in a pipe that loses its last other holder is unblocked the
+ *   same way
+ *
+ * List of functions that are called from outside this file:
+ * - pipe_register
+ *   - Registers the pipe devices
+ * - pipeinit
+ *   - Pipe specific call for di_init
+ * - pipeopen
+ *   - Pipe specific call for di_open
+ * - pipeclose
+ *   - Pipe specific call for di_close
+ * - piperead
+ *   - Pipe specific call for di_read
+ * - pipewrite
+ *   - Pipe specific call for di_write
+ * - pipeioctl
+ *   - Pipe specific call for di_ioctl
+ * - pipepoll
+ *   - Pipe specific call for syspoll
+ * - pipeaioread
+ *   - Pipe specific call for di_aioread
+ *-----------------------------------------------------------------------------------
+ */
+
+typedef struct pipe {
+    char name[16];
+    // Index of the oldest byte in the ring, and the number of bytes in it
+    int head;
+    int count;
+    char ring[PIPE_BUFFER_SIZE];
+    // The number of opens of the pipe not yet closed, by all processes
+    int opens;
+    // Processes waiting for bytes to read, and for space to write to
+    Queue readers;
+    Queue writers;
+} pipe_t;
+
+static int ring_put(pipe_t *pipe, char *buf, int len);
+static int ring_get(pipe_t *pipe, char *buf, int len);
+static void refill_from_writers(pipe_t *pipe);
+static void block_on_pipe(pcb_t *proc, Queue *queue, char *buf, int len, int done);
+static void unblock_all(pipe_t *pipe);
+static int min(int a, int b);
+
+static pipe_t pipes[NUM_PIPES];
+// The device structure of each pipe registered in the device table
+static devsw_t pipe_devsw[NUM_PIPES];
+
+/*-----------------------------------------------------------------------------------
+ * Registers the NUM_PIPES pipe devices as PIPE_0 onwards, with the pipe number as
+ * the minor number, and empties the pipes.
+ *-----------------------------------------------------------------------------------
+ */
+void pipe_register(void) {
+    for (int i = 0; i < NUM_PIPES; i++) {
+        pipe_t *p = &pipes[i];
+        sprintf(p->name, "/dev/pipe%d", i);
+        p->head = 0;
+        p->count = 0;
+        p->opens = 0;
+        init_queue(&p->readers);
+        init_queue(&p->writers);
+
+        devsw_t *devsw = &pipe_devsw[i];
+        devsw->dvioblk = p;
+        devsw->dvinit = &pipeinit;
+        devsw->dvopen = &pipeopen;
+        devsw->dvclose = &pipeclose;
+        devsw->dvread = &piperead;
+        devsw->dvwrite = &pipewrite;
+        devsw->dvioctl = &pipeioctl;
+        devsw->dvpoll = &pipepoll;
+        devsw->dvaioread = &pipeaioread;
+        di_register(devsw, p->name, PIPE_0 + i, i);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the pipe device. The pipes are emptied by pipe_register.
+ *
+ * @return 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int pipeinit(void) {
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_open. Counts the open.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int pipeopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    pipe_t *pipe = devsw->dvioblk;
+    pipe->opens++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_close. Unblocks the process waiting on the pipe if it
+ * is left as the only holder, and empties the pipe once no process holds it.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int pipeclose(devsw_t *devsw, pcb_t *proc) {
+    pipe_t *pipe = devsw->dvioblk;
+    pipe->opens--;
+    if (pipe->opens == 1) {
+        unblock_all(pipe);
+        // The remaining holder now reads EOF
+        poll_wakeup();
+    } else if (pipe->opens == 0) {
+        pipe->head = 0;
+        pipe->count = 0;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_write. Hands the bytes to waiting readers and places
+ * the rest in the ring.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written on success
+ *               -1 if no bytes could be written
+ *               -2 if the syswrite call is blocked, the dispatcher is to switch
+ *               processes
+ *-----------------------------------------------------------------------------------
+ */
+int pipewrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    pipe_t *pipe = devsw->dvioblk;
+    char *data = (char *) buf;
+    int done = 0;
+
+    pcb_t *reader;
+    while (done < buflen && (reader = dequeue(&pipe->readers)) != NULL) {
+        // The ring is empty, give the bytes straight to the reader
+        int n = min(reader->io_len, buflen - done);
+        copy_words(reader->io_buf, data + done, n);
+        done += n;
+        reader->result_code = n;
+        ready(reader);
+    }
+    done += ring_put(pipe, data + done, buflen - done);
+    if (pipe->count > 0) {
+        poll_wakeup();
+    }
+    if (done == buflen) {
+        return buflen;
+    }
+
+    if (pipe->opens == 1) {
+        return done > 0 ? done : -1;
+    }
+    block_on_pipe(proc, &pipe->writers, data + done, buflen - done, done);
+    return -2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_read. Takes the oldest bytes from the pipe, and moves
+ * the bytes of waiting writers into the space freed.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF)
+ *                    BLOCKERR if the pipe is empty in non-blocking mode
+ *                    -2 if the sysread call is blocked, the dispatcher is to switch
+ *                    processes
+ *-----------------------------------------------------------------------------------
+ */
+int piperead(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    pipe_t *pipe = devsw->dvioblk;
+    if (pipe->count == 0) {
+        if (pipe->opens == 1) {
+            return 0;
+        }
+        if (nonblocking) {
+            return BLOCKERR;
+        }
+        block_on_pipe(proc, &pipe->readers, (char *) buf, buflen, 0);
+        return -2;
+    }
+    int n = ring_get(pipe, (char *) buf, buflen);
+    refill_from_writers(pipe);
+    return n;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_ioctl. Pipes have no control commands.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command
+ * @param ioctl_args Additional parameters
+ * @return           -1 as there are no control commands
+ *-----------------------------------------------------------------------------------
+ */
+int pipeioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for syspoll. There is input while the ring holds bytes, and
+ * an EOF indication once the process is the only holder.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 if a read would not block, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int pipepoll(devsw_t *devsw, pcb_t *proc) {
+    pipe_t *pipe = devsw->dvioblk;
+    return pipe->count > 0 || pipe->opens == 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Pipe specific call for di_aioread. Asynchronous reads are not supported by
+ * pipes, a process that must not block on a pipe polls it with syspoll.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as asynchronous reads are not supported
+ *-----------------------------------------------------------------------------------
+ */
+int pipeaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies up to the given number of bytes into the free space of the ring of the
+ * given pipe.
+ *
+ * @return The number of bytes copied
+ *-----------------------------------------------------------------------------------
+ */
+static int ring_put(pipe_t *pipe, char *buf, int len) {
+    int n = min(len, PIPE_BUFFER_SIZE - pipe->count);
+    int tail = (pipe->head + pipe->count) % PIPE_BUFFER_SIZE;
+    // The free space may wrap around the end of the ring
+    int first = min(n, PIPE_BUFFER_SIZE - tail);
+    copy_words(&pipe->ring[tail], buf, first);
+    copy_words(pipe->ring, buf + first, n - first);
+    pipe->count += n;
+    return n;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies up to the given number of the oldest bytes out of the ring of the given
+ * pipe.
+ *
+ * @return The number of bytes copied
+ *-----------------------------------------------------------------------------------
+ */
+static int ring_get(pipe_t *pipe, char *buf, int len) {
+    int n = min(len, pipe->count);
+    // The bytes may wrap around the end of the ring
+    int first = min(n, PIPE_BUFFER_SIZE - pipe->head);
+    copy_words(buf, &pipe->ring[pipe->head], first);
+    copy_words(buf + first, pipe->ring, n - first);
+    pipe->head = (pipe->head + n) % PIPE_BUFFER_SIZE;
+    pipe->count -= n;
+    return n;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the bytes of the processes waiting to write to the given pipe into the free
+ * space of its ring, earliest first, and unblocks the writers whose bytes have all
+ * been moved with the length of their write.
+ *-----------------------------------------------------------------------------------
+ */
+static void refill_from_writers(pipe_t *pipe) {
+    pcb_t *writer;
+    while ((writer = pipe->writers.head) != NULL && pipe->count < PIPE_BUFFER_SIZE) {
+        int n = ring_put(pipe, writer->io_buf, writer->io_len);
+        writer->io_buf += n;
+        writer->io_len -= n;
+        writer->io_done += n;
+        if (writer->io_len > 0) {
+            return;
+        }
+        dequeue(&pipe->writers);
+        writer->result_code = writer->io_done;
+        ready(writer);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Blocks the given process on the given queue of a pipe, with the given buffer, the
+ * bytes left to move, and the bytes already moved.
+ *-----------------------------------------------------------------------------------
+ */
+static void block_on_pipe(pcb_t *proc, Queue *queue, char *buf, int len, int done) {
+    proc->io_buf = buf;
+    proc->io_len = len;
+    proc->io_done = done;
+    proc->state = BLOCKED;
+    proc->blocked_queue = PIPE;
+    proc->wait_queue = queue;
+    enqueue(queue, proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unblocks the processes waiting on the given pipe, readers with an end-of-file
+ * (EOF) indication, and writers with the bytes written so far or -1 if there are
+ * none.
+ *-----------------------------------------------------------------------------------
+ */
+static void unblock_all(pipe_t *pipe) {
+    pcb_t *proc;
+    while ((proc = dequeue(&pipe->readers)) != NULL) {
+        proc->result_code = 0;
+        ready(proc);
+    }
+    while ((proc = dequeue(&pipe->writers)) != NULL) {
+        proc->result_code = proc->io_done > 0 ? proc->io_done : -1;
+        ready(proc);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smaller of the given integers.
+ *-----------------------------------------------------------------------------------
+ */
+static int min(int a, int b) {
+    return a < b ? a : b;
+}
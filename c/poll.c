@@ -0,0 +1,133 @@
+/* poll.c : waiting on several sources at once
+ */
+
+#include <xeroskernel.h>
+#include <queue.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the poll system, which lets a process wait on several sources at once
+ * with syspoll: input on any of its file descriptors, a process waiting to send to
+ * it, and a timeout. A single server process can thereby serve the keyboard, pipes
+ * and IPC clients.
+ *
+ * Notes on polling:
+ * - A source is ready when reading it would not wait: a device asks its dvpoll,
+ *   and IPC is ready when a process is on the queue of senders of the poller
+ * - Polling consumes nothing, the poller reads from the sources reported ready, so
+ *   a source can be reported ready more than once
+ * - Pollers wait on a single queue, and each source that may become ready checks
+ *   them: the line discipline of the keyboard checks the processes that have the
+ *   keyboard open, a pipe checks all pollers, and a send checks the receiving
+ *   process
+ * - The timeout is an entry on the timing wheel like that of the timed IPC calls,
+ *   a poll that times out returns an empty mask
+ *
+ * List of functions that are called from outside this file:
+ * - kpollinit
+ *   - Initializes the queue of polling processes to empty
+ * - poll_ready
+ *   - Returns the sources of a mask that are ready
+ * - poll_block
+ *   - Blocks a process until a source of a mask is ready
+ * - poll_check
+ *   - Unblocks a polling process if a source it waits on is ready
+ * - poll_wakeup
+ *   - Unblocks the polling processes with a source that is ready
+ * - poll_timeout
+ *   - Unblocks a polling process whose timeout expired
+ *-----------------------------------------------------------------------------------
+ */
+
+static Queue pollers;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any process polls. Empties the queue of polling processes.
+ *-----------------------------------------------------------------------------------
+ */
+void kpollinit(void) {
+    init_queue(&pollers);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the bits of the given mask whose sources are ready for the given process.
+ * The mask is validated by the dispatcher.
+ *-----------------------------------------------------------------------------------
+ */
+unsigned int poll_ready(pcb_t *proc, unsigned int mask) {
+    unsigned int ready_mask = 0;
+    unsigned int fd_mask = mask & (POLL_IPC - 1);
+    int fd;
+    while ((fd = find_first_set_bit(fd_mask)) >= 0) {
+        devsw_t *devsw = proc->owner->cold->fd_table[fd];
+        if (devsw->dvpoll(devsw, proc)) {
+            ready_mask |= 1 << fd;
+        }
+        fd_mask &= ~(1 << fd);
+    }
+    if ((mask & POLL_IPC) && proc->cold->blocked_queues[SENDER].head != NULL) {
+        ready_mask |= POLL_IPC;
+    }
+    return ready_mask;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Blocks the given process until a source of the given mask is ready, or the given
+ * timeout expires.
+ *
+ * @param proc         A pointer to the PCB of the polling process
+ * @param mask         The sources to wait on, none of which is ready
+ * @param milliseconds The most milliseconds to wait for, negative for no timeout
+ *-----------------------------------------------------------------------------------
+ */
+void poll_block(pcb_t *proc, unsigned int mask, int milliseconds) {
+    proc->poll_mask = mask;
+    proc->state = BLOCKED;
+    proc->blocked_queue = POLL;
+    proc->wait_queue = &pollers;
+    enqueue(&pollers, proc);
+    if (milliseconds > 0) {
+        set_timeout(proc, milliseconds);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unblocks the given process with the sources that are ready, if it is polling and
+ * any source it waits on is ready.
+ *-----------------------------------------------------------------------------------
+ */
+void poll_check(pcb_t *proc) {
+    if (proc->state != BLOCKED || proc->blocked_queue != POLL) {
+        return;
+    }
+    unsigned int ready_mask = poll_ready(proc, proc->poll_mask);
+    if (ready_mask != 0) {
+        remove(&pollers, proc);
+        proc->result_code = ready_mask;
+        ready(proc);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unblocks every polling process that has a source it waits on ready. Called by
+ * sources that any process may poll.
+ *-----------------------------------------------------------------------------------
+ */
+void poll_wakeup(void) {
+    pcb_t *proc = pollers.head;
+    while (proc != NULL) {
+        pcb_t *next_proc = proc->next;
+        poll_check(proc);
+        proc = next_proc;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the sleep device when the timeout of a polling process expires before
+ * any source is ready. Unblocks the process with an empty mask.
+ *-----------------------------------------------------------------------------------
+ */
+void poll_timeout(pcb_t *proc) {
+    remove(&pollers, proc);
+    proc->result_code = 0;
+    ready(proc);
+}
@@ -0,0 +1,246 @@
+/* port.c : message ports
+ */
+
+#include <xeroskernel.h>
+#include <queue.h>
+#include <slab.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the message port system, which buffers messages between processes so
+ * that a sender does not wait for the receiver. A port is created by one process
+ * and any process may send to it or receive from it.
+ *
+ * Notes on ports:
+ * - A port holds a ring of PORT_SLOTS messages, a send only blocks when the ring is
+ *   full and a receive only blocks when it is empty
+ * - A message sent to a port with processes waiting to receive is given straight
+ *   to the first of them, and a receive from a full port with processes waiting to
+ *   send moves the message of the first of them into the ring
+ * - Ports are allocated from a slab cache, and the port table maps the identifiers
+ *   returned by sysportcreate to them
+ * - A port is destroyed by sysportdestroy or when the process that created it is
+ *   cleaned up, the processes waiting on it are unblocked with -1
+ *
+ * List of functions that are called from outside this file:
+ * - kportinit
+ *   - Initializes the port table and the cache ports are allocated from
+ * - port_create
+ *   - Implements the kernel side of sysportcreate
+ * - port_destroy
+ *   - Implements the kernel side of sysportdestroy
+ * - port_send
+ *   - Implements the kernel side of sysportsend
+ * - port_recv
+ *   - Implements the kernel side of sysportrecv
+ * - release_ports
+ *   - Destroys the ports created by a process
+ *-----------------------------------------------------------------------------------
+ */
+
+typedef struct port {
+    // The process that created the port
+    pcb_t *owner;
+    // Index of the oldest message in the ring, and the number of messages in it
+    int head;
+    int count;
+    unsigned long slots[PORT_SLOTS];
+    // Processes waiting for a slot to send to, and for a message to receive
+    Queue senders;
+    Queue receivers;
+} port_t;
+
+static port_t *get_port(int port_id);
+static void free_port(int port_id);
+static void block_on_port(pcb_t *proc, Queue *queue, unsigned long *buf);
+
+static kmem_cache_t *port_cache;
+static port_t *port_table[MAX_PORTS];
+
+/*-----------------------------------------------------------------------------------
+ * To be called after kslabinit and before any ports are created. Initializes the
+ * port table to empty and creates the cache ports are allocated from.
+ *-----------------------------------------------------------------------------------
+ */
+void kportinit(void) {
+    kprintf("Starting kportinit...\n");
+    for (int i = 0; i < MAX_PORTS; i++) {
+        port_table[i] = NULL;
+    }
+    port_cache = kmem_cache_create("port", sizeof(port_t));
+    if (port_cache == NULL) {
+        kprintf("Failed to create the port cache\n");
+    }
+    kprintf("Finished kportinit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysportcreate. Creates an empty port.
+ *
+ * @param owner A pointer to the PCB of the calling process
+ * @return      The identifier of the port, or -1 if no port could be allocated
+ *-----------------------------------------------------------------------------------
+ */
+int port_create(pcb_t *owner) {
+    for (int i = 0; i < MAX_PORTS; i++) {
+        if (port_table[i] == NULL) {
+            port_t *port = kmem_cache_alloc(port_cache);
+            if (port == NULL) {
+                return -1;
+            }
+            port->owner = owner;
+            port->head = 0;
+            port->count = 0;
+            init_queue(&port->senders);
+            init_queue(&port->receivers);
+            port_table[i] = port;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysportdestroy. Destroys the given port, unblocking
+ * the processes waiting on it with -1. The messages in the port are lost.
+ *
+ * @param owner   A pointer to the PCB of the calling process
+ * @param port_id The identifier of the port
+ * @return        0 on success, or -1 if the port does not exist or was not created
+ *                by the process
+ *-----------------------------------------------------------------------------------
+ */
+int port_destroy(pcb_t *owner, int port_id) {
+    port_t *port = get_port(port_id);
+    if (port == NULL || port->owner != owner) {
+        return -1;
+    }
+    free_port(port_id);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysportsend. Places the message in the given port,
+ * or hands it to a process waiting to receive. The sending process is blocked if
+ * the ring of the port is full.
+ *
+ * @param proc    A pointer to the PCB of the sending process
+ * @param port_id The identifier of the port
+ * @param buf     The message, on the stack of the sending process
+ * @return        0 on success, −1 if the sending process was blocked, or −2 if the
+ *                port does not exist
+ *-----------------------------------------------------------------------------------
+ */
+int port_send(pcb_t *proc, int port_id, unsigned long *buf) {
+    port_t *port = get_port(port_id);
+    if (port == NULL) {
+        return -2;
+    }
+    pcb_t *receiver = dequeue(&port->receivers);
+    if (receiver != NULL) {
+        // The ring is empty, give the message straight to the receiver
+        *(unsigned long *) receiver->ipc_buf = *buf;
+        receiver->result_code = 0;
+        ready(receiver);
+        return 0;
+    }
+    if (port->count == PORT_SLOTS) {
+        block_on_port(proc, &port->senders, buf);
+        return -1;
+    }
+    port->slots[(port->head + port->count) % PORT_SLOTS] = *buf;
+    port->count++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysportrecv. Takes the oldest message from the
+ * given port. The receiving process is blocked if the port is empty.
+ *
+ * @param proc    A pointer to the PCB of the receiving process
+ * @param port_id The identifier of the port
+ * @param buf     The address to store the message into, validated by the
+ *                dispatcher
+ * @return        0 on success, −1 if the receiving process was blocked, or −2 if
+ *                the port does not exist
+ *-----------------------------------------------------------------------------------
+ */
+int port_recv(pcb_t *proc, int port_id, unsigned long *buf) {
+    port_t *port = get_port(port_id);
+    if (port == NULL) {
+        return -2;
+    }
+    if (port->count == 0) {
+        block_on_port(proc, &port->receivers, buf);
+        return -1;
+    }
+    *buf = port->slots[port->head];
+    port->head = (port->head + 1) % PORT_SLOTS;
+    port->count--;
+
+    pcb_t *sender = dequeue(&port->senders);
+    if (sender != NULL) {
+        // A slot is free, move the message of the sender into it
+        port->slots[(port->head + port->count) % PORT_SLOTS] = *(unsigned long *) sender->ipc_buf;
+        port->count++;
+        sender->result_code = 0;
+        ready(sender);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called when a process is cleaned up. Destroys the ports created by the
+ * given process.
+ *-----------------------------------------------------------------------------------
+ */
+void release_ports(pcb_t *proc) {
+    for (int i = 0; i < MAX_PORTS; i++) {
+        if (port_table[i] != NULL && port_table[i]->owner == proc) {
+            free_port(i);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the port with the given identifier, NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static port_t *get_port(int port_id) {
+    if (port_id < 0 || port_id >= MAX_PORTS) {
+        return NULL;
+    }
+    return port_table[port_id];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unblocks the processes waiting on the port with the given identifier with -1, and
+ * returns the port to its cache.
+ *-----------------------------------------------------------------------------------
+ */
+static void free_port(int port_id) {
+    port_t *port = port_table[port_id];
+    pcb_t *proc;
+    while ((proc = dequeue(&port->senders)) != NULL) {
+        proc->result_code = -1;
+        ready(proc);
+    }
+    while ((proc = dequeue(&port->receivers)) != NULL) {
+        proc->result_code = -1;
+        ready(proc);
+    }
+    port_table[port_id] = NULL;
+    kmem_cache_free(port_cache, port);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Blocks the given process on the given queue of a port, with the given message or
+ * receive buffer.
+ *-----------------------------------------------------------------------------------
+ */
+static void block_on_port(pcb_t *proc, Queue *queue, unsigned long *buf) {
+    proc->ipc_buf = buf;
+    proc->state = BLOCKED;
+    proc->blocked_queue = PORT;
+    proc->wait_queue = queue;
+    enqueue(queue, proc);
+}
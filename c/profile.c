@@ -0,0 +1,123 @@
+/* profile.c : timer-driven sampling profiler */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the sampling profiler, which finds out where the processes spend their
+ * time. On every timer interrupt taken while it runs, the address the interrupted
+ * process was executing, the iret_eip of the context frame it was switched out
+ * with, is counted in a histogram of PROFILE_BUCKETS buckets.
+ *
+ * Notes on the profiler:
+ * - The histogram covers the kernel text, which holds the code of every process,
+ *   bucket i counts the samples from address i << shift on, shift being the
+ *   smallest that fits the text into the buckets
+ * - Either every process or a single one is sampled, the idle process is only
+ *   counted, as its address is always the same
+ * - Taking a sample is a single increment, of a bucket, or of the counter of idle
+ *   samples or samples outside the text, the total is left to the reader
+ * - Samples are taken on the timer interrupts of every processor, with the kernel
+ *   lock held
+ *
+ * List of functions that are called from outside this file:
+ * - kprofileinit
+ *   - Initializes the profiler to stopped with an empty histogram
+ * - profile_start
+ *   - Implements the kernel side of sysprofstart
+ * - profile_stop
+ *   - Implements the kernel side of sysprofstop
+ * - profile_tick
+ *   - Takes a sample of the process interrupted by a timer interrupt
+ * - get_profile
+ *   - Implements the kernel side of sysprofread
+ *-----------------------------------------------------------------------------------
+ */
+
+// The end of the kernel text, set by the linker
+extern int etext;
+
+static profile_t profile;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before the timer is enabled. Stops the profiler, empties the
+ * histogram, and sizes its buckets to cover the kernel text.
+ *-----------------------------------------------------------------------------------
+ */
+void kprofileinit(void) {
+    fill_words(&profile, 0, sizeof(profile_t));
+    while (((unsigned long) &etext >> profile.shift) >= PROFILE_BUCKETS) {
+        profile.shift++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysprofstart. Empties the histogram and starts
+ * sampling, over again if the profiler was already running.
+ *
+ * @param pid The PID of the process to sample, 0 for every process, already
+ *            checked by the caller to belong to a process
+ * @return    0 on success, -1 if the PID is negative
+ *-----------------------------------------------------------------------------------
+ */
+int profile_start(int pid) {
+    if (pid < 0) {
+        return -1;
+    }
+    profile.idle = 0;
+    profile.outside = 0;
+    fill_words(profile.histogram, 0, sizeof(profile.histogram));
+    profile.pid = pid;
+    profile.running = 1;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysprofstop. Stops sampling, the histogram is kept
+ * until the profiler is started again.
+ *
+ * @return 0 on success, -1 if the profiler was not running
+ *-----------------------------------------------------------------------------------
+ */
+int profile_stop(void) {
+    if (!profile.running) {
+        return -1;
+    }
+    profile.running = 0;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the dispatcher on every timer interrupt. Counts the address the given
+ * process was interrupted at, if it is being sampled.
+ *
+ * @param proc The process the timer interrupted, switched out with its context
+ *             frame on top of its stack
+ *-----------------------------------------------------------------------------------
+ */
+void profile_tick(pcb_t *proc) {
+    if (!profile.running || (profile.pid != 0 && proc->pid != profile.pid)) {
+        return;
+    }
+    if (proc->pid == IDLE_PROC_PID) {
+        profile.idle++;
+        return;
+    }
+    unsigned long bucket = ((context_frame_t *) proc->esp)->iret_eip >> profile.shift;
+    if (bucket < PROFILE_BUCKETS) {
+        profile.histogram[bucket]++;
+    } else {
+        profile.outside++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysprofread. Copies the state and histogram of the
+ * profiler.
+ *
+ * @param out A pointer to where the profile is copied, already checked by the caller
+ *-----------------------------------------------------------------------------------
+ */
+void get_profile(profile_t *out) {
+    copy_words(out, &profile, sizeof(profile_t));
+}
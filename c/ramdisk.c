@@ -0,0 +1,340 @@
+/* ramdisk.c : RAM disk specific device driver calls */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <bufcache.h>
+#include <ramdisk.h>
+#include <stdarg.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where RAM disk specific device driver calls live. The RAM disk is a block
+ * device of RAMDISK_BLOCKS blocks kept in kernel memory, a fast scratch store that
+ * is lost on reboot.
+ *
+ * Notes on the RAM disk:
+ * - Reads and writes go through the buffer cache like those of any block device,
+ *   bytes are copied straight between the process and the cached blocks, and the
+ *   disk itself is only reached on a miss or a write back
+ * - The disk is a stream of bytes to processes: a read or write starts at the
+ *   position of the open and moves it, IOCTL_SEEK moves it anywhere on the disk
+ * - A read at the end of the disk returns an end-of-file (EOF) indication, and a
+ *   write there writes only what fits
+ * - Only one process may have the disk open at a time, and the position belongs to
+ *   that open
+ *
+ * List of functions that are called from outside this file:
+ * - ramdisk_register
+ *   - Registers the RAM disk device
+ * - ramdiskinit
+ *   - RAM disk specific call for di_init
+ * - ramdiskopen
+ *   - RAM disk specific call for di_open
+ * - ramdiskclose
+ *   - RAM disk specific call for di_close
+ * - ramdiskread
+ *   - RAM disk specific call for di_read
+ * - ramdiskwrite
+ *   - RAM disk specific call for di_write
+ * - ramdiskioctl
+ *   - RAM disk specific call for di_ioctl
+ * - ramdiskpoll
+ *   - RAM disk specific call for syspoll
+ * - ramdiskaioread
+ *   - RAM disk specific call for di_aioread
+ * - ramdiskstep
+ *   - RAM disk specific call for di_step
+ *-----------------------------------------------------------------------------------
+ */
+
+static int read_block(blkdev_t *dev, buf_t *buf);
+static int write_block(blkdev_t *dev, buf_t *buf);
+static int ramdiskioctl_seek(void *ioctl_args);
+static int ramdiskioctl_cache_stats(void *ioctl_args);
+static int min(int a, int b);
+
+#define RAMDISK_BYTES (RAMDISK_BLOCKS * BLOCK_SIZE)
+
+static char ramdisk_store[RAMDISK_BYTES];
+static blkdev_t ramdisk_blkdev;
+// The process that has the disk open, NULL if it is not in use, and the byte
+// offset of its next read or write
+static pcb_t *ramdisk_proc;
+static int position;
+// The device structure registered in the device table
+static devsw_t ramdisk_devsw;
+
+/*-----------------------------------------------------------------------------------
+ * Registers the RAM disk device as RAMDISK_0.
+ *-----------------------------------------------------------------------------------
+ */
+void ramdisk_register(void) {
+    devsw_t *devsw = &ramdisk_devsw;
+    devsw->dvioblk = &ramdisk_blkdev;
+    devsw->dvinit = &ramdiskinit;
+    devsw->dvopen = &ramdiskopen;
+    devsw->dvclose = &ramdiskclose;
+    devsw->dvread = &ramdiskread;
+    devsw->dvwrite = &ramdiskwrite;
+    devsw->dvioctl = &ramdiskioctl;
+    devsw->dvpoll = &ramdiskpoll;
+    devsw->dvaioread = &ramdiskaioread;
+    devsw->dvstep = &ramdiskstep;
+    di_register(devsw, "/dev/ramdisk0", RAMDISK_0, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the RAM disk device, with every byte 0.
+ *
+ * @return 0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskinit(void) {
+    fill_words(ramdisk_store, 0, RAMDISK_BYTES);
+    ramdisk_blkdev.num_blocks = RAMDISK_BLOCKS;
+    ramdisk_blkdev.read_block = &read_block;
+    ramdisk_blkdev.write_block = &write_block;
+    ramdisk_proc = NULL;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_open. Starts the position at the start of the disk.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success, -1 if another process has the disk open
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    if (ramdisk_proc) {
+        return -1;
+    }
+    ramdisk_proc = proc;
+    position = 0;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_close. The changed blocks stay in the buffer cache.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskclose(devsw_t *devsw, pcb_t *proc) {
+    ramdisk_proc = NULL;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_read. Copies bytes from the cached blocks from the
+ * position on, and moves the position past them.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode, reads
+ *                    of the disk never block
+ * @return            The number of bytes read on success
+ *                    0 to indicate end-of-file (EOF)
+ *                    -1 if no block could be read
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    blkdev_t *dev = devsw->dvioblk;
+    char *data = (char *) buf;
+    int len = min(buflen, RAMDISK_BYTES - position);
+    int done = 0;
+    while (done < len) {
+        int offset = position % BLOCK_SIZE;
+        int n = min(len - done, BLOCK_SIZE - offset);
+        buf_t *b = bread(dev, position / BLOCK_SIZE);
+        if (b == NULL) {
+            break;
+        }
+        copy_words(data + done, b->data + offset, n);
+        brelse(b);
+        done += n;
+        position += n;
+    }
+    return done > 0 || len == 0 ? done : -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_write. Copies bytes into the cached blocks from the
+ * position on, and moves the position past them. Blocks written whole are not read
+ * in first.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes written on success
+ *               -1 if no bytes could be written
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    blkdev_t *dev = devsw->dvioblk;
+    char *data = (char *) buf;
+    int len = min(buflen, RAMDISK_BYTES - position);
+    int done = 0;
+    while (done < len) {
+        int offset = position % BLOCK_SIZE;
+        int n = min(len - done, BLOCK_SIZE - offset);
+        unsigned int blockno = position / BLOCK_SIZE;
+        buf_t *b = n == BLOCK_SIZE ? bget(dev, blockno) : bread(dev, blockno);
+        if (b == NULL) {
+            break;
+        }
+        copy_words(b->data + offset, data + done, n);
+        bdirty(b);
+        brelse(b);
+        done += n;
+        position += n;
+    }
+    return done > 0 ? done : -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_ioctl.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command, one of IOCTL_SEEK with the byte offset,
+ *                   IOCTL_SYNC, or IOCTL_CACHE_STATS with a pointer to a
+ *                   bufcache_stats_t
+ * @param ioctl_args Additional parameters
+ * @return           0 on success, -1 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    switch (command) {
+        case (IOCTL_SEEK):
+            return ramdiskioctl_seek(ioctl_args);
+        case (IOCTL_SYNC):
+            return bsync(devsw->dvioblk);
+        case (IOCTL_CACHE_STATS):
+            return ramdiskioctl_cache_stats(ioctl_args);
+        default:
+            // Invalid IOCTL request
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for syspoll. Reads of the disk never block.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 as a read would not block
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskpoll(devsw_t *devsw, pcb_t *proc) {
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_aioread. Reads of the disk never block, so there is
+ * nothing to complete asynchronously.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as asynchronous reads are not supported
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * RAM disk specific call for di_step. Reads or writes up to the end of the block at
+ * the position, as ramdiskread and ramdiskwrite would.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called sysread or syswrite
+ * @param buf    The buffer to read into or write from
+ * @param buflen The upper limit of bytes to move
+ * @param write  1 for syswrite, 0 for sysread
+ * @return       The result of ramdiskread or ramdiskwrite for the bytes moved
+ *-----------------------------------------------------------------------------------
+ */
+int ramdiskstep(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int write) {
+    int n = min(buflen, BLOCK_SIZE - position % BLOCK_SIZE);
+    return write ? ramdiskwrite(devsw, proc, buf, n) : ramdiskread(devsw, proc, buf, n, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the block of the given buffer from the disk into its data, for the buffer
+ * cache.
+ *-----------------------------------------------------------------------------------
+ */
+static int read_block(blkdev_t *dev, buf_t *buf) {
+    copy_words(buf->data, &ramdisk_store[buf->blockno * BLOCK_SIZE], BLOCK_SIZE);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the data of the given buffer into its block of the disk, for the buffer
+ * cache.
+ *-----------------------------------------------------------------------------------
+ */
+static int write_block(blkdev_t *dev, buf_t *buf) {
+    copy_words(&ramdisk_store[buf->blockno * BLOCK_SIZE], buf->data, BLOCK_SIZE);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the position to the byte offset that is the first of the given ioctl
+ * arguments.
+ *
+ * @return 0 on success, -1 if the offset is past the end of the disk
+ *-----------------------------------------------------------------------------------
+ */
+static int ramdiskioctl_seek(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list seek_args = (va_list) ioctl_args;
+    int offset = va_arg(seek_args, int);
+    va_end(seek_args);
+    if (offset < 0 || offset > RAMDISK_BYTES) {
+        return -1;
+    }
+    position = offset;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the buffer cache into the bufcache_stats_t pointed to by
+ * the first of the given ioctl arguments.
+ *
+ * @return 0 on success, -1 if the pointer is invalid
+ *-----------------------------------------------------------------------------------
+ */
+static int ramdiskioctl_cache_stats(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list stats_args = (va_list) ioctl_args;
+    bufcache_stats_t *stats = va_arg(stats_args, bufcache_stats_t *);
+    va_end(stats_args);
+    if (!valid_buf(stats, sizeof(bufcache_stats_t))) {
+        return -1;
+    }
+    get_bufcache_stats(stats);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the smaller of the given integers.
+ *-----------------------------------------------------------------------------------
+ */
+static int min(int a, int b) {
+    return a < b ? a : b;
+}
@@ -0,0 +1,266 @@
+/* realtime.c : real-time scheduling class
+ */
+
+#include <xeroskernel.h>
+#include <queue.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the real-time scheduling class, which is scheduled ahead of the priority
+ * queues of the dispatcher. A real-time process declares a period and a budget
+ * through syssetrealtime, and is guaranteed its budget of processor time in every
+ * period.
+ *
+ * Notes on the scheduling policy:
+ * - The runnable real-time process with the earliest deadline runs first, the
+ *   deadline of a process is the end of its current period
+ * - At the start of every period the budget of a process is replenished and its
+ *   deadline moves on by one period
+ * - The running real-time process is charged on every timer tick, once its budget
+ *   is used up it is not run again until its next period, even if the processor
+ *   would otherwise be idle
+ * - A process is only admitted if the total utilization, the sum of budget over
+ *   period of all real-time processes, stays at most 100%, which is the bound
+ *   under which earliest-deadline-first meets every deadline
+ *
+ * List of functions that are called from outside this file:
+ * - krealtimeinit
+ *   - Initializes the real-time class
+ * - set_realtime
+ *   - Implements the kernel side of syssetrealtime
+ * - realtime_release
+ *   - Removes a process from the real-time class
+ * - realtime_ready
+ *   - Adds a real-time process to the queue of ready real-time processes
+ * - realtime_remove
+ *   - Removes a real-time process from the queue of ready real-time processes
+ * - realtime_next
+ *   - Returns the runnable real-time process with the earliest deadline, or NULL
+ * - realtime_tick
+ *   - Returns 1 if the current process should be pre-empted for a real-time
+ *     process, 0 otherwise
+ * - realtime_pending
+ *   - Returns 1 if a ready real-time process is waiting for its budget
+ *-----------------------------------------------------------------------------------
+ */
+
+// Utilizations are fractions of this, so 100% is RT_UTILIZATION_SCALE. It is the
+// least common multiple of 1 to 16, so that the utilization of most periods is exact
+// and a set of processes adding up to exactly 100% is admitted. The budget of the
+// longest period times the scale still fits in 32 bits.
+#define RT_UTILIZATION_SCALE 720720UL
+
+static int ms_to_ticks(int milliseconds);
+static unsigned long utilization(pcb_t *proc);
+static pcb_t *earliest_runnable(void);
+static void replenish(pcb_t *proc);
+
+// Ready real-time processes, in no particular order
+static Queue realtime_queue;
+// All processes in the real-time class, whatever their state
+static pcb_t *realtime_procs[MAX_PROCESSES];
+static int num_realtime_procs;
+// Sum of the utilizations of all processes in the real-time class
+static unsigned long total_utilization;
+// Number of timer ticks seen by the real-time class
+static unsigned long realtime_ticks;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any processes are created. Initializes the real-time class
+ * with no processes in it.
+ *-----------------------------------------------------------------------------------
+ */
+void krealtimeinit(void) {
+    init_queue(&realtime_queue);
+    num_realtime_procs = 0;
+    total_utilization = 0;
+    realtime_ticks = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syssetrealtime. Places the given process in the
+ * real-time class with the given period and budget, or removes it from the class
+ * if the period is 0. The first period of the process starts immediately.
+ *
+ * @param proc        A pointer to the PCB of the calling process
+ * @param period_ms   The period in milliseconds, at most MAX_REALTIME_PERIOD, 0 to
+ *                    leave the real-time class
+ * @param budget_ms   The budget in milliseconds, at most the period
+ * @return            0 on success, -1 if the period or budget is invalid, or -2 if
+ *                    admitting the process would take the total utilization over
+ *                    100%
+ *-----------------------------------------------------------------------------------
+ */
+int set_realtime(pcb_t *proc, int period_ms, int budget_ms) {
+    if (period_ms == 0) {
+        realtime_release(proc);
+        return 0;
+    }
+    if (period_ms < 0 || period_ms > MAX_REALTIME_PERIOD || budget_ms <= 0 || budget_ms > period_ms) {
+        return -1;
+    }
+
+    int period = ms_to_ticks(period_ms);
+    int budget = ms_to_ticks(budget_ms);
+    if (budget > period) {
+        budget = period;
+    }
+    // Budgets are rounded up, so the utilization is rounded up too
+    unsigned long new_utilization = (budget * RT_UTILIZATION_SCALE + period - 1) / period;
+    if (total_utilization - utilization(proc) + new_utilization > RT_UTILIZATION_SCALE) {
+        return -2;
+    }
+
+    if (proc->rt_period == 0) {
+        realtime_procs[num_realtime_procs++] = proc;
+    }
+    total_utilization = total_utilization - utilization(proc) + new_utilization;
+    proc->rt_period = period;
+    proc->rt_budget = budget;
+    proc->rt_budget_left = budget;
+    proc->rt_deadline = realtime_ticks + period;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given process from the real-time class, if it is in it. To be called
+ * when the process leaves the class or terminates.
+ *
+ * @param proc A pointer to the PCB of the process
+ *-----------------------------------------------------------------------------------
+ */
+void realtime_release(pcb_t *proc) {
+    if (proc->rt_period == 0) {
+        return;
+    }
+    if (proc->state == READY) {
+        remove(&realtime_queue, proc);
+    }
+    for (int i = 0; i < num_realtime_procs; i++) {
+        if (realtime_procs[i] == proc) {
+            realtime_procs[i] = realtime_procs[--num_realtime_procs];
+            break;
+        }
+    }
+    total_utilization -= utilization(proc);
+    proc->rt_period = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given real-time process to the queue of ready real-time processes.
+ *-----------------------------------------------------------------------------------
+ */
+void realtime_ready(pcb_t *proc) {
+    enqueue(&realtime_queue, proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given real-time process from the queue of ready real-time processes.
+ *-----------------------------------------------------------------------------------
+ */
+void realtime_remove(pcb_t *proc) {
+    remove(&realtime_queue, proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the runnable real-time process with the earliest deadline from the queue
+ * of ready real-time processes and returns it.
+ *
+ * @return A pointer to the PCB of the process, or NULL if no ready real-time
+ *         process has budget left
+ *-----------------------------------------------------------------------------------
+ */
+pcb_t *realtime_next(void) {
+    pcb_t *proc = earliest_runnable();
+    if (proc != NULL) {
+        remove(&realtime_queue, proc);
+    }
+    return proc;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called on every timer tick. Starts the new periods of real-time processes,
+ * charges the ticks to the given current process if it is a real-time process, and
+ * decides if it should be pre-empted.
+ *
+ * @param current A pointer to the PCB of the current process
+ * @param ticks   The number of ticks that have passed
+ * @return        1 if the current process has used up its budget or a real-time
+ *                process with an earlier deadline is runnable, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int realtime_tick(pcb_t *current, int ticks) {
+    realtime_ticks += ticks;
+    if (current->rt_period > 0) {
+        current->rt_budget_left -= ticks;
+        if (current->rt_budget_left < 0) {
+            current->rt_budget_left = 0;
+        }
+    }
+    for (int i = 0; i < num_realtime_procs; i++) {
+        replenish(realtime_procs[i]);
+    }
+
+    pcb_t *earliest = earliest_runnable();
+    if (current->rt_period == 0) {
+        return earliest != NULL;
+    }
+    return current->rt_budget_left == 0
+           || (earliest != NULL && earliest->rt_deadline < current->rt_deadline);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Checks if a ready real-time process is waiting for its budget to be replenished,
+ * in which case the timer must keep ticking.
+ *
+ * @return 1 if the queue of ready real-time processes is non-empty, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int realtime_pending(void) {
+    return !is_empty(&realtime_queue);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the ready real-time process with budget left that has the earliest
+ * deadline, NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static pcb_t *earliest_runnable(void) {
+    pcb_t *earliest = NULL;
+    for (pcb_t *proc = realtime_queue.head; proc != NULL; proc = proc->next) {
+        if (proc->rt_budget_left > 0 && (earliest == NULL || proc->rt_deadline < earliest->rt_deadline)) {
+            earliest = proc;
+        }
+    }
+    return earliest;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Starts the next period of the given real-time process if its deadline has
+ * passed, replenishing its budget.
+ *-----------------------------------------------------------------------------------
+ */
+static void replenish(pcb_t *proc) {
+    while (realtime_ticks >= proc->rt_deadline) {
+        proc->rt_deadline += proc->rt_period;
+        proc->rt_budget_left = proc->rt_budget;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the utilization of the given process, 0 if it is not a real-time process.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long utilization(pcb_t *proc) {
+    if (proc->rt_period == 0) {
+        return 0;
+    }
+    return (proc->rt_budget * RT_UTILIZATION_SCALE + proc->rt_period - 1) / proc->rt_period;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Converts the given number of milliseconds into time slices, rounding up.
+ *-----------------------------------------------------------------------------------
+ */
+static int ms_to_ticks(int milliseconds) {
+    return milliseconds / TIME_SLICE + (milliseconds % TIME_SLICE ? 1 : 0);
+}
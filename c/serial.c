@@ -0,0 +1,473 @@
+/* serial.c : serial port specific device driver calls */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <queue.h>
+#include <i386.h>
+#include <serial.h>
+#include <stdarg.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where serial port specific device driver calls live. The serial port is
+ * the first 16550 UART of the PC, driven by its interrupts in both directions so no
+ * process spins on the line status register.
+ *
+ * Notes on the serial port:
+ * - Received bytes are moved by serial_isr from the receive FIFO into a ring of
+ *   SERIAL_BUFFER_SIZE bytes, and bytes written are queued in a second ring that
+ *   serial_isr feeds to the transmit FIFO, SERIAL_TX_FIFO_SIZE bytes each time the
+ *   FIFO empties
+ * - The receive FIFO interrupts once 14 bytes have arrived, or when bytes have sat
+ *   in it for a while, so a burst of input costs one interrupt per 14 bytes
+ * - A write returns as soon as all of its bytes are queued in the ring, not when
+ *   they are sent, and only blocks while the ring is full
+ * - A read returns as soon as any bytes have been received, with up to the
+ *   requested number of them, and only blocks when none have, like a pipe
+ * - The transmit interrupt is only enabled while the transmit ring holds bytes,
+ *   since the UART raises it whenever the FIFO is empty
+ * - Any number of processes may have the port open. Bytes received while the
+ *   receive ring is full are dropped and counted
+ * - IOCTL_LOOPBACK_ON feeds transmitted bytes back to the receiver inside the UART,
+ *   so the driver can be exercised with nothing attached to the port
+ *
+ * List of functions that are called from outside this file:
+ * - serial_register
+ *   - Registers the serial device
+ * - serialinit
+ *   - Serial specific call for di_init
+ * - serialopen
+ *   - Serial specific call for di_open
+ * - serialclose
+ *   - Serial specific call for di_close
+ * - serialread
+ *   - Serial specific call for di_read
+ * - serialwrite
+ *   - Serial specific call for di_write
+ * - serialioctl
+ *   - Serial specific call for di_ioctl
+ * - serialpoll
+ *   - Serial specific call for syspoll
+ * - serialaioread
+ *   - Serial specific call for di_aioread
+ * - serial_isr
+ *   - Serial port ISR
+ *-----------------------------------------------------------------------------------
+ */
+
+static void receive(void);
+static void transmit(void);
+static void set_ier(unsigned char value);
+static int rx_get(char *buf, int len);
+static int tx_put(char *buf, int len);
+static void refill_from_writers(void);
+static void block_on_serial(pcb_t *proc, Queue *queue, char *buf, int len, int done);
+static int serialioctl_get_stats(void *ioctl_args);
+
+// The rings of received bytes and of bytes waiting to be transmitted
+// The indices count bytes from the start and are masked into the rings, so a ring is
+// full when its indices are SERIAL_BUFFER_SIZE apart
+static char rx_ring[SERIAL_BUFFER_SIZE];
+static unsigned int rx_head;
+static unsigned int rx_tail;
+static char tx_ring[SERIAL_BUFFER_SIZE];
+static unsigned int tx_head;
+static unsigned int tx_tail;
+
+// Whether a UART answered at SERIAL_BASE_PORT
+static int uart_present;
+// The number of opens of the port not yet closed, by all processes
+static int opens;
+// The interrupts enabled in the UART
+static unsigned char ier;
+// Processes waiting for bytes to read, and for space in the transmit ring
+static Queue readers;
+static Queue writers;
+static serial_stats_t stats;
+// The device structure registered in the device table
+static devsw_t serial_devsw;
+
+/*====================== SERIAL DEVICE DRIVER UPPER HALF ==========================*/
+
+/*-----------------------------------------------------------------------------------
+ * Registers the serial device as SERIAL_0.
+ *-----------------------------------------------------------------------------------
+ */
+void serial_register(void) {
+    devsw_t *devsw = &serial_devsw;
+    devsw->dvioblk = NULL;
+    devsw->dvinit = &serialinit;
+    devsw->dvopen = &serialopen;
+    devsw->dvclose = &serialclose;
+    devsw->dvread = &serialread;
+    devsw->dvwrite = &serialwrite;
+    devsw->dvioctl = &serialioctl;
+    devsw->dvpoll = &serialpoll;
+    devsw->dvaioread = &serialaioread;
+    di_register(devsw, "/dev/serial0", SERIAL_0, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the serial device. Programs the UART for SERIAL_DIVISOR and 8 data
+ * bits with no parity and 1 stop bit, with its FIFOs enabled and its interrupts
+ * disabled until the port is opened.
+ *
+ * @return 0 on success, also when there is no UART, in which case opens fail
+ *-----------------------------------------------------------------------------------
+ */
+int serialinit(void) {
+    rx_head = rx_tail = 0;
+    tx_head = tx_tail = 0;
+    opens = 0;
+    init_queue(&readers);
+    init_queue(&writers);
+
+    // The scratch register holds what is written to it only if there is a UART
+    outb(SERIAL_BASE_PORT + SERIAL_SCRATCH, 0x5A);
+    uart_present = inb(SERIAL_BASE_PORT + SERIAL_SCRATCH) == 0x5A;
+    if (!uart_present) {
+        return 0;
+    }
+
+    ier = 0;
+    outb(SERIAL_BASE_PORT + SERIAL_IER, 0);
+    outb(SERIAL_BASE_PORT + SERIAL_LCR, LCR_DLAB);
+    outb(SERIAL_BASE_PORT + SERIAL_DLL, SERIAL_DIVISOR & 0xFF);
+    outb(SERIAL_BASE_PORT + SERIAL_DLM, SERIAL_DIVISOR >> 8);
+    outb(SERIAL_BASE_PORT + SERIAL_LCR, LCR_8N1);
+    outb(SERIAL_BASE_PORT + SERIAL_FCR, FCR_ENABLE_14);
+    outb(SERIAL_BASE_PORT + SERIAL_MCR, MCR_DTR_RTS_OUT2);
+    // Read the status registers to clear conditions left from before
+    inb(SERIAL_BASE_PORT + SERIAL_LSR);
+    inb(SERIAL_BASE_PORT + SERIAL_DATA);
+    inb(SERIAL_BASE_PORT + SERIAL_IIR);
+    inb(SERIAL_BASE_PORT + SERIAL_MSR);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_open. Counts the open, and enables the receive
+ * interrupts on the first open.
+ *
+ * @param devsw     The device structure
+ * @param proc      The process that called sysopen
+ * @param device_no The major device number
+ * @return          0 on success, -1 if there is no UART
+ *-----------------------------------------------------------------------------------
+ */
+int serialopen(devsw_t *devsw, pcb_t *proc, int device_no) {
+    if (!uart_present) {
+        return -1;
+    }
+    if (opens++ == 0) {
+        fill_words(&stats, 0, sizeof(stats));
+        set_ier(ier | IER_RX | IER_LINE);
+        enable_irq(SERIAL_IRQ, 0);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_close. Disables the receive interrupts and empties the
+ * receive ring once no process holds the port. Bytes already queued are still
+ * transmitted.
+ *
+ * @param devsw The device structure
+ * @param proc  The process that called sysclose
+ * @return      0 on success
+ *-----------------------------------------------------------------------------------
+ */
+int serialclose(devsw_t *devsw, pcb_t *proc) {
+    if (--opens == 0) {
+        set_ier(ier & IER_TX);
+        outb(SERIAL_BASE_PORT + SERIAL_MCR, MCR_DTR_RTS_OUT2);
+        rx_head = rx_tail = 0;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_read. Takes the oldest bytes received.
+ *
+ * @param devsw       The device structure
+ * @param proc        The process that called sysread
+ * @param buf         The buffer to read into
+ * @param buflen      The upper limit of bytes to read into buf
+ * @param nonblocking Whether the file descriptor is in non-blocking mode
+ * @return            The number of bytes read on success
+ *                    BLOCKERR if nothing has been received in non-blocking mode
+ *                    -2 if the sysread call is blocked, the dispatcher is to switch
+ *                    processes
+ *-----------------------------------------------------------------------------------
+ */
+int serialread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking) {
+    if (rx_head == rx_tail) {
+        if (nonblocking) {
+            return BLOCKERR;
+        }
+        block_on_serial(proc, &readers, (char *) buf, buflen, 0);
+        return -2;
+    }
+    return rx_get((char *) buf, buflen);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_write. Queues the bytes in the transmit ring and
+ * starts transmitting them.
+ *
+ * @param devsw  The device structure
+ * @param proc   The process that called syswrite
+ * @param buf    The buffer to write from
+ * @param buflen The upper limit of bytes to write from buf
+ * @return       The number of bytes queued on success
+ *               -2 if the syswrite call is blocked, the dispatcher is to switch
+ *               processes
+ *-----------------------------------------------------------------------------------
+ */
+int serialwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen) {
+    char *data = (char *) buf;
+    int done = tx_put(data, buflen);
+    transmit();
+    if (done == buflen) {
+        return buflen;
+    }
+    // The rest is queued by serial_isr as the transmit ring drains
+    block_on_serial(proc, &writers, data + done, buflen - done, done);
+    return -2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_ioctl.
+ *
+ * @param devsw      The device structure
+ * @param proc       The process that called sysioctl
+ * @param command    The control command, one of IOCTL_LOOPBACK_ON,
+ *                   IOCTL_LOOPBACK_OFF, or IOCTL_SERIAL_STATS with a pointer to a
+ *                   serial_stats_t
+ * @param ioctl_args Additional parameters
+ * @return           0 on success, -1 on failure
+ *-----------------------------------------------------------------------------------
+ */
+int serialioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args) {
+    switch (command) {
+        case (IOCTL_LOOPBACK_ON):
+            outb(SERIAL_BASE_PORT + SERIAL_MCR, MCR_DTR_RTS_OUT2 | MCR_LOOPBACK);
+            return 0;
+        case (IOCTL_LOOPBACK_OFF):
+            outb(SERIAL_BASE_PORT + SERIAL_MCR, MCR_DTR_RTS_OUT2);
+            return 0;
+        case (IOCTL_SERIAL_STATS):
+            return serialioctl_get_stats(ioctl_args);
+        default:
+            // Invalid IOCTL request
+            return -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for syspoll. There is input while the receive ring holds
+ * bytes.
+ *
+ * @param devsw The device structure
+ * @param proc  The polling process
+ * @return      1 if a read would not block, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int serialpoll(devsw_t *devsw, pcb_t *proc) {
+    return rx_head != rx_tail;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Serial specific call for di_aioread. Asynchronous reads are not supported by the
+ * serial port, a process that must not block on it polls it with syspoll.
+ *
+ * @param devsw         The device structure
+ * @param proc          The process that called sysaioread
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with
+ * @return              -1 as asynchronous reads are not supported
+ *-----------------------------------------------------------------------------------
+ */
+int serialaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number) {
+    return -1;
+}
+
+/*====================== SERIAL DEVICE DRIVER LOWER HALF ==========================*/
+
+/*-----------------------------------------------------------------------------------
+ * The serial port interrupt service routine (ISR). Services every condition the
+ * UART has pending, as the line to the interrupt controller stays raised until
+ * there are none.
+ *-----------------------------------------------------------------------------------
+ */
+void serial_isr(void) {
+    unsigned char iir;
+    while (!((iir = inb(SERIAL_BASE_PORT + SERIAL_IIR)) & IIR_NONE)) {
+        switch (iir & IIR_CAUSE_MASK) {
+            case (IIR_RX):
+            case (IIR_RX_TIMEOUT):
+                receive();
+                break;
+            case (IIR_TX):
+                transmit();
+                break;
+            case (IIR_LINE):
+                if (inb(SERIAL_BASE_PORT + SERIAL_LSR) & LSR_OVERRUN) {
+                    stats.overruns++;
+                }
+                break;
+            default:
+                // Reading the modem status clears its interrupt
+                inb(SERIAL_BASE_PORT + SERIAL_MSR);
+                break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the bytes in the receive FIFO into the receive ring, and hands them to the
+ * waiting readers.
+ *-----------------------------------------------------------------------------------
+ */
+static void receive(void) {
+    unsigned char lsr;
+    while ((lsr = inb(SERIAL_BASE_PORT + SERIAL_LSR)) & LSR_DATA_READY) {
+        char c = inb(SERIAL_BASE_PORT + SERIAL_DATA);
+        if (lsr & LSR_OVERRUN) {
+            stats.overruns++;
+        }
+        stats.received++;
+        if (rx_head - rx_tail == SERIAL_BUFFER_SIZE) {
+            stats.dropped++;
+        } else {
+            rx_ring[rx_head & SERIAL_BUFFER_MASK] = c;
+            rx_head++;
+        }
+    }
+
+    pcb_t *reader;
+    while (rx_head != rx_tail && (reader = dequeue(&readers)) != NULL) {
+        reader->result_code = rx_get(reader->io_buf, reader->io_len);
+        ready(reader);
+    }
+    if (rx_head != rx_tail) {
+        poll_wakeup();
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Fills the transmit FIFO from the transmit ring if it is empty, moves the bytes of
+ * waiting writers into the space freed, and enables the transmit interrupt only
+ * while bytes are left to send.
+ *-----------------------------------------------------------------------------------
+ */
+static void transmit(void) {
+    if (inb(SERIAL_BASE_PORT + SERIAL_LSR) & LSR_TX_EMPTY) {
+        for (int i = 0; i < SERIAL_TX_FIFO_SIZE && tx_tail != tx_head; i++) {
+            outb(SERIAL_BASE_PORT + SERIAL_DATA, tx_ring[tx_tail & SERIAL_BUFFER_MASK]);
+            tx_tail++;
+            stats.transmitted++;
+        }
+    }
+    refill_from_writers();
+    set_ier(tx_tail != tx_head ? ier | IER_TX : ier & ~IER_TX);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the given value to the interrupt enable register if it changes it.
+ *-----------------------------------------------------------------------------------
+ */
+static void set_ier(unsigned char value) {
+    if (value != ier) {
+        ier = value;
+        outb(SERIAL_BASE_PORT + SERIAL_IER, ier);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies up to the given number of the oldest bytes out of the receive ring.
+ *
+ * @return The number of bytes copied
+ *-----------------------------------------------------------------------------------
+ */
+static int rx_get(char *buf, int len) {
+    int n = 0;
+    while (n < len && rx_tail != rx_head) {
+        buf[n++] = rx_ring[rx_tail & SERIAL_BUFFER_MASK];
+        rx_tail++;
+    }
+    return n;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies up to the given number of bytes into the free space of the transmit ring.
+ *
+ * @return The number of bytes copied
+ *-----------------------------------------------------------------------------------
+ */
+static int tx_put(char *buf, int len) {
+    int n = 0;
+    while (n < len && tx_head - tx_tail < SERIAL_BUFFER_SIZE) {
+        tx_ring[tx_head & SERIAL_BUFFER_MASK] = buf[n++];
+        tx_head++;
+    }
+    return n;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the bytes of the processes waiting to write into the free space of the
+ * transmit ring, earliest first, and unblocks the writers whose bytes have all been
+ * queued with the length of their write.
+ *-----------------------------------------------------------------------------------
+ */
+static void refill_from_writers(void) {
+    pcb_t *writer;
+    while ((writer = writers.head) != NULL && tx_head - tx_tail < SERIAL_BUFFER_SIZE) {
+        int n = tx_put(writer->io_buf, writer->io_len);
+        writer->io_buf += n;
+        writer->io_len -= n;
+        writer->io_done += n;
+        if (writer->io_len > 0) {
+            return;
+        }
+        dequeue(&writers);
+        writer->result_code = writer->io_done;
+        ready(writer);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Blocks the given process on the given queue of the serial port, with the given
+ * buffer, the bytes left to move, and the bytes already moved.
+ *-----------------------------------------------------------------------------------
+ */
+static void block_on_serial(pcb_t *proc, Queue *queue, char *buf, int len, int done) {
+    proc->io_buf = buf;
+    proc->io_len = len;
+    proc->io_done = done;
+    proc->state = BLOCKED;
+    proc->blocked_queue = SERIAL;
+    proc->wait_queue = queue;
+    enqueue(queue, proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the serial port into the serial_stats_t pointed to by the
+ * first of the given ioctl arguments.
+ *
+ * @return 0 on success, -1 if the pointer is invalid
+ *-----------------------------------------------------------------------------------
+ */
+static int serialioctl_get_stats(void *ioctl_args) {
+    if (ioctl_args == NULL) {
+        return -1;
+    }
+    va_list get_stats_args = (va_list) ioctl_args;
+    serial_stats_t *out = va_arg(get_stats_args, serial_stats_t *);
+    va_end(get_stats_args);
+    if (!valid_buf(out, sizeof(serial_stats_t))) {
+        return -1;
+    }
+    *out = stats;
+    return 0;
+}
@@ -0,0 +1,175 @@
+/* shm.c : shared memory segments
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+#include <slab.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the shared memory system, which lets processes exchange large buffers
+ * without copying them through system calls. A segment is created by one process
+ * and attached by others with the identifier returned by sysshmcreate, IPC is then
+ * only needed to tell the other side that the buffer is ready.
+ *
+ * Notes on segments:
+ * - A segment is a block of pages from the page allocator, zeroed when it is
+ *   created, so every segment is page aligned and its size is rounded up to a power
+ *   of 2 pages
+ * - All processes share one address space, so a segment is at the same address in
+ *   every process that attaches it
+ * - Each segment counts the processes holding it, the creator holds it from the
+ *   start, and the segment is freed when the last holder detaches it or is cleaned
+ *   up
+ * - The segments a process holds are kept as a bit mask in its PCB, a process that
+ *   attaches a segment it already holds is not counted twice
+ * - A process must not use a segment after detaching it, the pages may have been
+ *   handed out again
+ *
+ * List of functions that are called from outside this file:
+ * - kshminit
+ *   - Initializes the segment table and the cache segments are allocated from
+ * - shm_create
+ *   - Implements the kernel side of sysshmcreate
+ * - shm_attach
+ *   - Implements the kernel side of sysshmattach
+ * - shm_detach
+ *   - Implements the kernel side of sysshmdetach
+ * - release_shm
+ *   - Detaches the segments held by a process
+ *-----------------------------------------------------------------------------------
+ */
+
+typedef struct shm_segment {
+    // The pages of the segment, and the order of the block holding them
+    void *base;
+    int order;
+    // The number of processes holding the segment
+    int holders;
+} shm_segment_t;
+
+static shm_segment_t *get_segment(int shm_id);
+
+static kmem_cache_t *shm_cache;
+static shm_segment_t *shm_table[MAX_SHM_SEGMENTS];
+
+/*-----------------------------------------------------------------------------------
+ * To be called after kslabinit and before any segments are created. Initializes the
+ * segment table to empty and creates the cache segments are allocated from.
+ *-----------------------------------------------------------------------------------
+ */
+void kshminit(void) {
+    kprintf("Starting kshminit...\n");
+    for (int i = 0; i < MAX_SHM_SEGMENTS; i++) {
+        shm_table[i] = NULL;
+    }
+    shm_cache = kmem_cache_create("shm", sizeof(shm_segment_t));
+    if (shm_cache == NULL) {
+        kprintf("Failed to create the shared memory cache\n");
+    }
+    kprintf("Finished kshminit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysshmcreate. Creates a zeroed segment of at least
+ * the given size, held by the calling process.
+ *
+ * @param proc A pointer to the PCB of the calling process
+ * @param size The size of the segment in bytes, from 1 to NBPG * 2^(NUM_PAGE_ORDERS
+ *             - 1)
+ * @return     The identifier of the segment, or -1 if the size is out of range or
+ *             no segment could be allocated
+ *-----------------------------------------------------------------------------------
+ */
+int shm_create(pcb_t *proc, size_t size) {
+    if (size == 0 || size > (NBPG << (NUM_PAGE_ORDERS - 1))) {
+        return -1;
+    }
+    for (int i = 0; i < MAX_SHM_SEGMENTS; i++) {
+        if (shm_table[i] == NULL) {
+            shm_segment_t *segment = kmem_cache_alloc(shm_cache);
+            if (segment == NULL) {
+                return -1;
+            }
+            segment->order = page_order(size);
+            segment->base = kpagealloc(segment->order);
+            if (segment->base == NULL) {
+                kmem_cache_free(shm_cache, segment);
+                return -1;
+            }
+            fill_words(segment->base, 0, NBPG << segment->order);
+            segment->holders = 1;
+            proc->shm_held |= 1UL << i;
+            shm_table[i] = segment;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysshmattach. Makes the calling process a holder
+ * of the given segment, unless it already holds it.
+ *
+ * @param proc   A pointer to the PCB of the calling process
+ * @param shm_id The identifier of the segment
+ * @return       The address of the segment, or NULL if the segment does not exist
+ *-----------------------------------------------------------------------------------
+ */
+void *shm_attach(pcb_t *proc, int shm_id) {
+    shm_segment_t *segment = get_segment(shm_id);
+    if (segment == NULL) {
+        return NULL;
+    }
+    if (!(proc->shm_held & (1UL << shm_id))) {
+        proc->shm_held |= 1UL << shm_id;
+        segment->holders++;
+    }
+    return segment->base;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysshmdetach. Drops the hold of the calling process
+ * on the given segment, and frees the segment if no other process holds it.
+ *
+ * @param proc   A pointer to the PCB of the calling process
+ * @param shm_id The identifier of the segment
+ * @return       0 on success, or -1 if the segment does not exist or is not held by
+ *               the process
+ *-----------------------------------------------------------------------------------
+ */
+int shm_detach(pcb_t *proc, int shm_id) {
+    shm_segment_t *segment = get_segment(shm_id);
+    if (segment == NULL || !(proc->shm_held & (1UL << shm_id))) {
+        return -1;
+    }
+    proc->shm_held &= ~(1UL << shm_id);
+    if (--segment->holders == 0) {
+        kpagefree(segment->base);
+        kmem_cache_free(shm_cache, segment);
+        shm_table[shm_id] = NULL;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called when a process is cleaned up. Detaches the segments held by the
+ * given process.
+ *-----------------------------------------------------------------------------------
+ */
+void release_shm(pcb_t *proc) {
+    while (proc->shm_held != 0) {
+        shm_detach(proc, find_last_set_bit(proc->shm_held));
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the segment with the given identifier, NULL if there is none.
+ *-----------------------------------------------------------------------------------
+ */
+static shm_segment_t *get_segment(int shm_id) {
+    if (shm_id < 0 || shm_id >= MAX_SHM_SEGMENTS) {
+        return NULL;
+    }
+    return shm_table[shm_id];
+}
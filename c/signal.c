@@ -3,7 +3,7 @@
 
 #include <xeroskernel.h>
 #include <xeroslib.h>
-#include <deltalist.h>
+#include <queue.h>
 
 /*-----------------------------------------------------------------------------------
  * This is the signalling system. The signalling system supports 32 signals, numbered
@@ -17,13 +17,32 @@
  * signal's processing can be interrupted by signals numbered 24 to 31 while signals
  * 0 to 23 would be held in abeyance until the handling of signal 23 is finished.
  *
- * The only way a signal can be posted (signalled) is via the syskill call.
+ * A signal is posted (signalled) via the syskill call or a kernel timer, and posting
+ * a signal that is already pending has no effect. A signal may also be queued with
+ * syssigqueue, which carries a value and the PID of the sender, and every signal
+ * queued is delivered, up to SIGNAL_QUEUE_SIZE waiting at once for each process. A
+ * signal posted while queued signals of the same number wait is merged with them.
+ * An asynchronous read reserves an entry of the queue when it starts, so that the
+ * signal that completes it is never refused.
+ * A handler reads what it is told about its signal with signal_info.
  *
  * The default action for all signals is to ignore the signal.
  *
+ * A process may block signals with syssigprocmask, for example around a critical
+ * section. A blocked signal is kept pending and does not interrupt a blocked system
+ * call, it is delivered once it is unblocked. Signal 31 cannot be blocked.
+ *
  * List of functions that are called from outside this file:
  * - signal
  *   - Registers a signal for delivery to a process
+ * - queue_signal
+ *   - Queues a signal carrying a value for delivery to a process
+ * - reserve_queued_signal
+ *   - Keeps an entry of the signal queue of a process free
+ * - release_queued_signal
+ *   - Frees an entry kept by reserve_queued_signal
+ * - signal_info
+ *   - Returns what the handler of a signal is told about it
  * - handle_pending_signals
  *   - Handles pending signals for a process before context switch, delivering any
  *     necessary signals
@@ -36,12 +55,8 @@
  *-----------------------------------------------------------------------------------
  */
 
-// The list of sleeping processes
-extern DeltaList sleep_queue;
-// Chars transferred to application read buffer
-extern int chars_transferred;
-
 static void unblock_on_signal(pcb_t *proc_to_signal);
+static void take_signal_info(pcb_t *proc, int signal_number, siginfo_t *info);
 
 /*-----------------------------------------------------------------------------------
  * When the kernel decides to deliver a signal to a process, the kernel modifies the
@@ -73,11 +88,15 @@ void sigtramp(signal_handler_funcptr handler, void *cntx) {
 int signal(pcb_t *proc_to_signal, int signal_number) {
     if (proc_to_signal != NULL) {
         if (signal_number >= 0 && signal_number < SIGNAL_TABLE_SIZE) {
-            if (proc_to_signal->signal_table[signal_number]) {
+            if (proc_to_signal->owner->cold->signal_table[signal_number]) {
+                if (signal_number == SIGNAL_TABLE_SIZE - 1) {
+                    // Signal 31 terminates the process, see syswaitany
+                    proc_to_signal->exit_status = EXIT_KILLED;
+                }
                 // Mark signal for delivery
                 proc_to_signal->pending_signals = set_signal_bit(proc_to_signal->pending_signals, signal_number);
 
-                if (proc_to_signal->state == BLOCKED) {
+                if (proc_to_signal->state == BLOCKED && !is_signal_bit_set(proc_to_signal->blocked_signals, signal_number)) {
                     // Process is blocked on a system call when it is targeted to receive a signal
                     // Unblock target process
                     unblock_on_signal(proc_to_signal);
@@ -97,6 +116,78 @@ int signal(pcb_t *proc_to_signal, int signal_number) {
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Queues a signal carrying a value for delivery to a process.
+ *
+ * @param proc_to_signal The process to queue a signal for
+ * @param signal_number  The signal to queue
+ * @param sender_pid     The PID of the process queuing the signal
+ * @param value          The value the signal carries
+ * @return               0 on success
+ *                       -3 if the queue of the process is full, counting the
+ *                       entries that are reserved
+ *                       -514 if the target process does not exist
+ *                       -583 if the signal number is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int queue_signal(pcb_t *proc_to_signal, int signal_number, unsigned int sender_pid, int value) {
+    if (proc_to_signal == NULL || signal_number < 0 || signal_number >= SIGNAL_TABLE_SIZE
+            || !proc_to_signal->owner->cold->signal_table[signal_number]) {
+        // Fails or ignores the signal as signal does
+        return signal(proc_to_signal, signal_number);
+    }
+    if (proc_to_signal->cold->num_queued_signals + proc_to_signal->cold->num_reserved_signals
+            == SIGNAL_QUEUE_SIZE) {
+        return -3;
+    }
+    siginfo_t *info = &proc_to_signal->cold->queued_signals[proc_to_signal->cold->num_queued_signals++];
+    info->signal_number = signal_number;
+    info->sender_pid = sender_pid;
+    info->value = value;
+    return signal(proc_to_signal, signal_number);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Keeps an entry of the signal queue of the given process free until it is released
+ * with release_queued_signal, which is to be called just before the signal it was
+ * kept for is queued.
+ *
+ * @param proc The process to keep an entry free for
+ * @return     0 on success, -3 if the queue of the process is full
+ *-----------------------------------------------------------------------------------
+ */
+int reserve_queued_signal(pcb_t *proc) {
+    if (proc->cold->num_queued_signals + proc->cold->num_reserved_signals == SIGNAL_QUEUE_SIZE) {
+        return -3;
+    }
+    proc->cold->num_reserved_signals++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Frees an entry of the signal queue of the given process kept by
+ * reserve_queued_signal.
+ *
+ * @param proc The process the entry was kept for
+ *-----------------------------------------------------------------------------------
+ */
+void release_queued_signal(pcb_t *proc) {
+    proc->cold->num_reserved_signals--;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns what the handler of a signal is told about it. To be called by the
+ * handler with the argument it was given.
+ *
+ * @param cntx The argument of the handler, the context at the time of the signal
+ * @return     The number of the signal, and the sender and value if it was queued
+ *-----------------------------------------------------------------------------------
+ */
+siginfo_t *signal_info(void *cntx) {
+    // The delivery context is just below the context at the time of the signal
+    return &((signal_delivery_context_t *) cntx - 1)->info;
+}
+
 /*------------------------------------------------------------------------
  * Removes the process from whichever blocked queue it is on and sets the
  * result code.
@@ -118,25 +209,36 @@ static void unblock_on_signal(pcb_t *proc_to_signal) {
             proc_to_signal->result_code = interrupted_by_signal;
             break;
         case (RECEIVE_ANY):
-            remove_from_receive_any_queue(proc_to_signal);
+        case (WAIT_CHILD):
+        case (COPYING):
+            // The process is on no queue, a process copying its message finds it
+            // gone on its next step
             proc_to_signal->result_code = interrupted_by_signal;
             break;
-        case (SLEEP):;
+        case (SLEEP):
             // Return the time left to sleep if the call is interrupted
-            int time_left = delta_remove(&sleep_queue, proc_to_signal);
-            proc_to_signal->result_code = time_left * TIME_SLICE;
+            proc_to_signal->result_code = cancel_sleep(proc_to_signal);
             break;
         case (WAIT):
             remove_from_blocked_queue(proc_to_signal, proc_to_signal->blocked_on, WAIT);
             proc_to_signal->result_code = interrupted_by_signal;
             break;
+        case (PORT):
+        case (FUTEX):
+        case (POLL):
+        case (DISK):
+            remove(proc_to_signal->wait_queue, proc_to_signal);
+            proc_to_signal->result_code = interrupted_by_signal;
+            break;
+        case (PIPE):
+        case (SERIAL):
         case (READ):
-            // Return the number of chars that have been placed in the buffer supplied by the application
-            // If that value is zero, then return -666
-            if (chars_transferred == 0) {
+            // A write returns the bytes already moved, a read blocks until it has any
+            remove(proc_to_signal->wait_queue, proc_to_signal);
+            if (proc_to_signal->io_done == 0) {
                 proc_to_signal->result_code = interrupted_by_signal;
             } else {
-                proc_to_signal->result_code = chars_transferred;
+                proc_to_signal->result_code = proc_to_signal->io_done;
             }
             break;
         default:
@@ -147,46 +249,83 @@ static void unblock_on_signal(pcb_t *proc_to_signal) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Handles pending signals. Delivers the highest priority pending
- * signal if it is higher priority than the last signal delivered.
+ * Handles pending signals. Delivers the highest priority pending signal that is
+ * not blocked if it is higher priority than the last signal delivered. Called
+ * before every context switch, so the common case of no pending signals returns
+ * at once, and the highest pending signal is found with a single bit scan.
  *-----------------------------------------------------------------------------------
  */
 void handle_pending_signals(pcb_t *proc) {
-    int signal_number = SIGNAL_TABLE_SIZE - 1;
-    while (!is_signal_bit_set(proc->pending_signals, signal_number) && signal_number != -1) {
-        signal_number--;
+    int deliverable = proc->pending_signals & ~proc->blocked_signals;
+    if (deliverable == 0) {
+        return;
+    }
+    int signal_number = find_last_set_bit(deliverable);
+    // signal_number is now the highest priority pending signal that is not blocked
+    if (signal_number > proc->last_signal_delivered) {
+        void *old_esp = proc->esp;
+        void *new_esp = (void *) ((unsigned long) old_esp - sizeof(signal_delivery_context_t));
+
+        // Store the new stack pointer as the value for the stack pointer in PCB
+        proc->esp = new_esp;
+
+        // Initialize signal delivery context
+        signal_delivery_context_t *signal_delivery_context = new_esp;
+        fill_words(signal_delivery_context, 0, sizeof(*signal_delivery_context));
+        signal_delivery_context->context_frame.ebp =
+                ((unsigned long) signal_delivery_context) + sizeof(context_frame_t);
+        signal_delivery_context->context_frame.iret_eip = (unsigned long) &sigtramp;
+        signal_delivery_context->context_frame.iret_cs = getCS();
+        signal_delivery_context->context_frame.eflags = EFLAGS;
+
+        // Set sigtramp arguments
+        signal_delivery_context->handler = proc->owner->cold->signal_table[signal_number];
+        // cntx is the start of the context at the time the signal is delivered
+        signal_delivery_context->cntx = old_esp;
+        signal_delivery_context->last_signal_delivered = proc->last_signal_delivered;
+        // Saved return value
+        signal_delivery_context->saved_result_code = proc->result_code;
+        // Deliver the oldest queued signal of the number, the signal stays pending
+        // while more are queued
+        take_signal_info(proc, signal_number, &signal_delivery_context->info);
+
+        proc->last_signal_delivered = signal_number;
+        proc->signals_delivered++;
     }
-    if (signal_number != -1) {
-        // signal_number is now the highest priority pending signal
-        if (signal_number > proc->last_signal_delivered) {
-            // Deliver signal
-            proc->pending_signals = clear_signal_bit(proc->pending_signals, signal_number);
-
-            void *old_esp = proc->esp;
-            void *new_esp = (void *) ((unsigned long) old_esp - sizeof(signal_delivery_context_t));
-
-            // Store the new stack pointer as the value for the stack pointer in PCB
-            proc->esp = new_esp;
-
-            // Initialize signal delivery context
-            signal_delivery_context_t *signal_delivery_context = new_esp;
-            memset(signal_delivery_context, 0, sizeof(signal_delivery_context));
-            signal_delivery_context->context_frame.ebp =
-                    ((unsigned long) signal_delivery_context) + sizeof(context_frame_t);
-            signal_delivery_context->context_frame.iret_eip = (unsigned long) &sigtramp;
-            signal_delivery_context->context_frame.iret_cs = getCS();
-            signal_delivery_context->context_frame.eflags = EFLAGS;
-
-            // Set sigtramp arguments
-            signal_delivery_context->handler = proc->signal_table[signal_number];
-            // cntx is the start of the context at the time the signal is delivered
-            signal_delivery_context->cntx = old_esp;
-            signal_delivery_context->last_signal_delivered = proc->last_signal_delivered;
-            // Saved return value
-            signal_delivery_context->saved_result_code = proc->result_code;
-
-            proc->last_signal_delivered = signal_number;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Fills in what the handler of the given signal is told about it, taking the
+ * oldest queued signal of the number off the queue of the given process if there
+ * is one, and clears the pending bit of the signal unless more are queued.
+ *-----------------------------------------------------------------------------------
+ */
+static void take_signal_info(pcb_t *proc, int signal_number, siginfo_t *info) {
+    info->signal_number = signal_number;
+    info->sender_pid = 0;
+    info->value = 0;
+    int found = 0;
+    int still_queued = 0;
+    for (int i = 0; i < proc->cold->num_queued_signals; i++) {
+        siginfo_t *queued = &proc->cold->queued_signals[i];
+        if (queued->signal_number != signal_number) {
+            continue;
+        }
+        if (found) {
+            still_queued = 1;
+            break;
+        }
+        *info = *queued;
+        found = 1;
+        // Close the gap, keeping the queue in order
+        for (int j = i; j < proc->cold->num_queued_signals - 1; j++) {
+            proc->cold->queued_signals[j] = proc->cold->queued_signals[j + 1];
         }
+        proc->cold->num_queued_signals--;
+        i--;
+    }
+    if (!still_queued) {
+        proc->pending_signals = clear_signal_bit(proc->pending_signals, signal_number);
     }
 }
 
@@ -0,0 +1,354 @@
+/* slab.c : object caches
+ */
+
+#include <i386.h>
+#include <xeroskernel.h>
+#include <slab.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the slab allocator where fixed-size kernel objects are allocated from
+ * object caches. Each cache gets slabs of one page from the page allocator and carves
+ * them into objects of a single size, so that allocating and freeing objects neither
+ * walks nor fragments the free list of the memory manager.
+ *
+ * Notes on the slabs:
+ * - A slab starts with a header, followed by the objects. As slabs are page aligned,
+ *   the slab of an object is found by rounding the object down to a page
+ * - Each slab keeps a bitmap of its free objects, bit i is set if object i is free,
+ *   so that a free object is found with a single bit-scan per bitmap word
+ * - Slabs with a free object are kept on the partial list of their cache and full
+ *   slabs are kept on the full list, so allocations never look at a full slab
+ * - When a slab becomes empty it is returned to the page allocator, unless it is the only slab
+ *   with free objects left in the cache, which is kept to avoid getting and returning
+ *   a slab on every allocation and free
+ *
+ * List of functions that are called from outside this file:
+ * - kslabinit
+ *   - Initializes the cache table
+ * - kmem_cache_create
+ *   - Returns a new cache for objects of the given size, NULL on failure
+ * - kmem_cache_destroy
+ *   - Returns 1 on success, 0 on failure
+ * - kmem_cache_alloc
+ *   - Returns a pointer to an object from the cache, NULL on failure
+ * - kmem_cache_free
+ *   - Returns 1 on success, 0 on failure
+ * - kmem_cache_get_stats
+ *   - Returns 1 on success, 0 on failure
+ *-----------------------------------------------------------------------------------
+ */
+
+#define SLAB_SIZE NBPG
+
+extern unsigned long page_arena_start;
+extern unsigned long page_arena_end;
+#define BITS_PER_WORD 32
+
+typedef struct slab {
+    kmem_cache_t *cache;
+    // prev and next pointers for the partial or full list of the cache
+    struct slab *prev;
+    struct slab *next;
+    // Number of free objects in this slab
+    int free_count;
+    // Bit i is set if object i is free
+    unsigned long free_bitmap[SLAB_BITMAP_WORDS];
+    unsigned char objects[0];
+} slab_t;
+
+static int valid_cache(kmem_cache_t *cache);
+static slab_t *new_slab(kmem_cache_t *cache);
+static void release_slab(slab_t *slab);
+static slab_t *find_slab(kmem_cache_t *cache, void *obj);
+static void push_slab(slab_t **list, slab_t *slab);
+static void unlink_slab(slab_t **list, slab_t *slab);
+
+static kmem_cache_t cache_table[KMEM_CACHE_TABLE_SIZE];
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, after kmeminit and before any caches are created.
+ * This function initializes the cache table.
+ *-----------------------------------------------------------------------------------
+ */
+void kslabinit(void) {
+    kprintf("\nStarting kslabinit...\n");
+    for (int i = 0; i < KMEM_CACHE_TABLE_SIZE; i++) {
+        cache_table[i].in_use = 0;
+    }
+    kprintf("Finished kslabinit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Creates a cache for objects of the given size. No slabs are allocated until the
+ * first object is allocated.
+ *
+ * @param name        The name of the cache, used for printing
+ * @param object_size The size of each object in bytes
+ * @return            The cache if successful, NULL if the size is invalid or if the
+ *                    cache table is full
+ *-----------------------------------------------------------------------------------
+ */
+kmem_cache_t *kmem_cache_create(char *name, size_t object_size) {
+    if (object_size <= 0 || object_size > SLAB_SIZE - sizeof(slab_t)) {
+        return NULL;
+    }
+    for (int i = 0; i < KMEM_CACHE_TABLE_SIZE; i++) {
+        kmem_cache_t *cache = &cache_table[i];
+        if (!cache->in_use) {
+            cache->in_use = 1;
+            cache->name = name;
+            // Keep every object on a paragraph boundary
+            cache->object_size = (object_size + PARAGRAPH_SIZE - 1) & ~(PARAGRAPH_SIZE - 1);
+            cache->partial_slabs = NULL;
+            cache->full_slabs = NULL;
+
+            int objects_per_slab = (SLAB_SIZE - sizeof(slab_t)) / cache->object_size;
+            if (objects_per_slab > SLAB_BITMAP_WORDS * BITS_PER_WORD) {
+                objects_per_slab = SLAB_BITMAP_WORDS * BITS_PER_WORD;
+            }
+            cache->stats.num_slabs = 0;
+            cache->stats.objects_per_slab = objects_per_slab;
+            cache->stats.objects_in_use = 0;
+            cache->stats.objects_free = 0;
+            cache->stats.num_allocs = 0;
+            cache->stats.num_frees = 0;
+            cache->stats.failed_allocs = 0;
+            return cache;
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Destroys the given cache, returning all of its slabs to the page allocator.
+ *
+ * @param cache The cache to destroy
+ * @return      1 on success, 0 if the cache is invalid or still has objects in use
+ *-----------------------------------------------------------------------------------
+ */
+int kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!valid_cache(cache) || cache->stats.objects_in_use != 0) {
+        return 0;
+    }
+    while (cache->partial_slabs != NULL) {
+        release_slab(cache->partial_slabs);
+    }
+    cache->in_use = 0;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Allocates an object from the given cache.
+ *
+ * @param cache The cache to allocate from
+ * @return      A pointer to the object if successful, NULL if the cache is invalid or
+ *              if a new slab was needed and not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!valid_cache(cache)) {
+        return NULL;
+    }
+    slab_t *slab = cache->partial_slabs;
+    if (slab == NULL) {
+        slab = new_slab(cache);
+        if (slab == NULL) {
+            cache->stats.failed_allocs++;
+            return NULL;
+        }
+    }
+
+    // A slab on the partial list always has a free object
+    int word = 0;
+    while (slab->free_bitmap[word] == 0) {
+        word++;
+    }
+    int bit = find_first_set_bit(slab->free_bitmap[word]);
+    slab->free_bitmap[word] &= ~(1UL << bit);
+    slab->free_count--;
+    if (slab->free_count == 0) {
+        unlink_slab(&cache->partial_slabs, slab);
+        push_slab(&cache->full_slabs, slab);
+    }
+
+    cache->stats.objects_in_use++;
+    cache->stats.objects_free--;
+    cache->stats.num_allocs++;
+    return slab->objects + (word * BITS_PER_WORD + bit) * cache->object_size;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns an object to the cache it was allocated from.
+ *
+ * @param cache The cache the object was allocated from
+ * @param obj   A pointer to the object
+ * @return      1 on success, 0 if the cache is invalid, if the object was not
+ *              allocated from the cache or if the object is already free
+ *-----------------------------------------------------------------------------------
+ */
+int kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!valid_cache(cache) || obj == NULL) {
+        return 0;
+    }
+    slab_t *slab = find_slab(cache, obj);
+    if (slab == NULL) {
+        return 0;
+    }
+    unsigned long offset = (unsigned long) obj - (unsigned long) slab->objects;
+    if (offset % cache->object_size != 0) {
+        return 0;
+    }
+    int index = offset / cache->object_size;
+    int word = index / BITS_PER_WORD;
+    unsigned long mask = 1UL << (index % BITS_PER_WORD);
+    if (slab->free_bitmap[word] & mask) {
+        // Cannot free object twice
+        return 0;
+    }
+
+    slab->free_bitmap[word] |= mask;
+    slab->free_count++;
+    if (slab->free_count == 1) {
+        unlink_slab(&cache->full_slabs, slab);
+        push_slab(&cache->partial_slabs, slab);
+    }
+    cache->stats.objects_in_use--;
+    cache->stats.objects_free++;
+    cache->stats.num_frees++;
+
+    // Return an empty slab unless it is the last one that can serve allocations
+    if (slab->free_count == cache->stats.objects_per_slab
+        && (cache->partial_slabs != slab || slab->next != NULL)) {
+        release_slab(slab);
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the statistics of the given cache.
+ *
+ * @param cache The cache to get the statistics of
+ * @param stats Where to copy the statistics to
+ * @return      1 on success, 0 if the cache is invalid or stats is NULL
+ *-----------------------------------------------------------------------------------
+ */
+int kmem_cache_get_stats(kmem_cache_t *cache, kmem_cache_stats_t *stats) {
+    if (!valid_cache(cache) || stats == NULL) {
+        return 0;
+    }
+    *stats = cache->stats;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Checks whether the given cache is an entry of the cache table that is in use.
+ *
+ * @param cache The cache to check
+ * @return      1 if the cache is valid, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+static int valid_cache(kmem_cache_t *cache) {
+    if (cache == NULL) {
+        return 0;
+    }
+    int index = cache - cache_table;
+    return index >= 0 && index < KMEM_CACHE_TABLE_SIZE && &cache_table[index] == cache && cache->in_use;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Gets a new slab from the page allocator for the given cache, with all of its objects free,
+ * and adds it to the partial list of the cache.
+ *
+ * @param cache The cache to get a new slab for
+ * @return      The new slab, NULL if not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+static slab_t *new_slab(kmem_cache_t *cache) {
+    slab_t *slab = (slab_t *) kpagealloc(0);
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->cache = cache;
+    int objects_per_slab = cache->stats.objects_per_slab;
+    slab->free_count = objects_per_slab;
+    for (int i = 0; i < SLAB_BITMAP_WORDS; i++) {
+        int objects_in_word = objects_per_slab - i * BITS_PER_WORD;
+        if (objects_in_word >= BITS_PER_WORD) {
+            slab->free_bitmap[i] = ~0UL;
+        } else if (objects_in_word > 0) {
+            slab->free_bitmap[i] = (1UL << objects_in_word) - 1;
+        } else {
+            slab->free_bitmap[i] = 0;
+        }
+    }
+    push_slab(&cache->partial_slabs, slab);
+
+    cache->stats.num_slabs++;
+    cache->stats.objects_free += objects_per_slab;
+    return slab;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes an empty slab from the partial list of its cache and returns it to the
+ * page allocator.
+ *
+ * @param slab The empty slab to release
+ *-----------------------------------------------------------------------------------
+ */
+static void release_slab(slab_t *slab) {
+    kmem_cache_t *cache = slab->cache;
+    unlink_slab(&cache->partial_slabs, slab);
+    cache->stats.num_slabs--;
+    cache->stats.objects_free -= cache->stats.objects_per_slab;
+    kpagefree(slab);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finds the slab of the given cache that contains the given object.
+ *
+ * @param cache The cache the object was allocated from
+ * @param obj   A pointer to the object
+ * @return      The slab containing the object, NULL if there is none
+ *-----------------------------------------------------------------------------------
+ */
+static slab_t *find_slab(kmem_cache_t *cache, void *obj) {
+    unsigned long addr = (unsigned long) obj;
+    if (addr < page_arena_start || addr >= page_arena_end) {
+        return NULL;
+    }
+    slab_t *slab = (slab_t *) (addr & ~(SLAB_SIZE - 1));
+    unsigned long objects_end = (unsigned long) slab->objects + cache->stats.objects_per_slab * cache->object_size;
+    // Only slabs that belong to the cache point back to it
+    if (slab->cache != cache || addr < (unsigned long) slab->objects || addr >= objects_end) {
+        return NULL;
+    }
+    return slab;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds a slab to the head of the given list.
+ *-----------------------------------------------------------------------------------
+ */
+static void push_slab(slab_t **list, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes a slab from the given list.
+ *-----------------------------------------------------------------------------------
+ */
+static void unlink_slab(slab_t **list, slab_t *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
@@ -3,35 +3,160 @@
 
 #include <xeroskernel.h>
 #include <xeroslib.h>
-#include <deltalist.h>
+#include <timerwheel.h>
+#include <i386.h>
 
 /*-----------------------------------------------------------------------------------
  * This is a sleep device for processing sleep requests and timer ticks.
  *
  * List of functions that are called from outside this file:
  * - ksleepinit
- *   - Initializes the delta list of sleeping processes
+ *   - Initializes the timing wheel of sleeping processes
+ * - sleep_us
+ *   - Implements the kernel side of sysusleep
+ * - cancel_sleep
+ *   - Takes a sleeping process off the timing wheel, returns the time it had left
  * - tick
  *   - Notifies the sleep device that a time slice has occurred
+ * - set_timeout
+ *   - Places a process blocked on IPC onto the timing wheel
+ * - cancel_timeout
+ *   - Takes a process off the timing wheel if it is on it
+ * - arm_timer
+ *   - Implements the kernel side of systimer
+ * - cancel_timer
+ *   - Implements the kernel side of systimercancel
+ * - release_timers
+ *   - Frees the kernel timers armed by or targeting a process
+ * - tickless_enter
+ *   - Stops the periodic tick until the first sleeping process is due
+ * - tickless_exit
+ *   - Restarts the periodic tick, returns the number of time slices that passed
+ *     while it was stopped, or -1 if it was running
+ * - split_exit
+ *   - Wakes the processes whose sysusleep ends at a one-shot splitting the time
+ *     slice, returns whether the time slice is over
+ * - clock_us
+ *   - Returns the monotonic clock in microseconds
+ * - tick_age_us
+ *   - Returns the microseconds since the PIT raised the last tick
+ *
+ * Notes on tickless idle:
+ * - While only the idle process is runnable, the periodic tick is replaced with a
+ *   one-shot timer for the first sleeping process, so an idle system is not woken
+ *   every time slice
+ * - The PIT counts at most 65535 cycles, so one shot lasts at most
+ *   MAX_ONESHOT_TICKS time slices and a longer sleep takes several shots
+ * - Any interrupt ends tickless idle, the time slices that passed are then caught
+ *   up on by the dispatcher, a partly elapsed time slice is lost
+ *
+ * Notes on sleeps with sysusleep:
+ * - The process sleeps on the timing wheel until the tick that starts the time
+ *   slice its deadline falls in, then goes onto precise_sleepers, kept in order of
+ *   deadline, as does a process whose deadline falls in the current time slice
+ * - While a process is on precise_sleepers the time slice is split: the PIT is set
+ *   to a one-shot that ends at its deadline, and each one-shot then wakes whoever
+ *   is due and is followed by one to the next deadline, or to the end of the time
+ *   slice, after which the periodic tick starts again
+ * - A one-shot in the middle of a time slice is not a tick, nothing is charged for
+ *   it and the time slice of the current process goes on, unless the woken process
+ *   outranks it
+ * - The PIT keeps counting down past the terminal count of a one-shot, so the
+ *   cycles between the one-shot and the point it is read are not lost, only those
+ *   between reading the PIT and setting the next one-shot are. Timer slack does not
+ *   apply, and tickless idle waits for the split time slice to end
+ *
+ * Notes on timer slack:
+ * - A process with timer slack may have its sleeps and IPC timeouts extended by up
+ *   to its slack, and they are moved to the tick with the most trailing zero bits
+ *   in that window
+ * - Processes with slack are thereby woken on a few shared ticks, in a single pass
+ *   of tick, rather than one or two at a time on adjacent ticks
+ *
+ * Notes on kernel timers:
+ * - A kernel timer delivers a signal to a process when it expires, and has an entry
+ *   of its own on the timing wheel, so no process sleeps on its behalf
+ * - A periodic timer is put back on the wheel for the tick one period after the
+ *   tick it was due at, so the periods do not drift however late the signal is
+ *   handled
+ * - A timer is freed when it is cancelled, when a one-shot timer expires, or when
+ *   the process that armed it or the process it targets is cleaned up
+ *
+ * Notes on the monotonic clock:
+ * - The clock counts the time slices the sleep device has been notified of, plus
+ *   the PIT cycles that have passed in the current time slice, or since the
+ *   one-shot timer was set during tickless idle, or since the start of a split time
+ *   slice
+ * - A time slice whose interrupt is still waiting to be serviced is counted by
+ *   checking the interrupt request register of the interrupt controller
+ * - The clock never goes back, time lost when a time slice is caught up on is
+ *   made up for by holding the clock until it has passed the last value returned
  *-----------------------------------------------------------------------------------
  */
 
+// Timer cycles in one time slice
+#define TICK_COUNT TIMER_DIV(1000 / TIME_SLICE)
+// Longest one-shot the 16 bit counter of the PIT can time
+#define MAX_ONESHOT_TICKS (0xffff / TICK_COUNT)
+// Microseconds in one time slice
+#define TICK_US (TIME_SLICE * 1000)
+// Shortest one-shot splitting a time slice, so it cannot expire before it is noted
+#define MIN_SPLIT_CYCLES 16
+
+typedef struct kernel_timer {
+    timer_entry_t entry;
+    // The process that armed the timer, NULL if the timer is free
+    pcb_t *owner;
+    pcb_t *target;
+    int signal_number;
+    // Time slices between expiries, 0 for a one-shot timer
+    int period;
+} kernel_timer_t;
+
 static int ms_to_time_slices(unsigned int milliseconds);
+static int add_slack(pcb_t *proc, int delay);
+static void expire_process(timer_entry_t *entry);
+static void expire_timer(timer_entry_t *entry);
+static void free_timer(kernel_timer_t *timer);
+static unsigned long tick_cycles(void);
+static void expire_precise(timer_entry_t *entry);
+static void schedule_precise(pcb_t *proc);
+static void remove_precise(pcb_t *proc);
+static void wake_precise_sleepers(void);
+static void arm_split(void);
+static unsigned long split_elapsed(void);
 
-DeltaList sleep_queue;
+TimerWheel sleep_queue;
+// Time slices the one-shot timer was set for, 0 if the periodic tick is running
+static int oneshot_ticks;
+// The last value of the monotonic clock returned
+static unsigned long long last_clock_us;
+// Processes whose sysusleep ends in the current time slice, earliest deadline first
+static pcb_t *precise_sleepers;
+// While the time slice is split, the PIT cycles into the time slice at which the
+// current one-shot was set and its length, both 0 while the periodic tick runs
+static unsigned long split_start;
+static unsigned long split_cycles;
+static kernel_timer_t timers[MAX_TIMERS];
 
 /*------------------------------------------------------------------------
- * Initializes the delta list of sleeping processes.
+ * Initializes the timing wheel of sleeping processes.
  *------------------------------------------------------------------------
  */
 void ksleepinit(void) {
     kprintf("Starting ksleepinit...\n");
-    init_delta_list(&sleep_queue);
+    init_timer_wheel(&sleep_queue);
+    oneshot_ticks = 0;
+    last_clock_us = 0;
+    precise_sleepers = NULL;
+    split_start = 0;
+    split_cycles = 0;
+    fill_words(timers, 0, sizeof(timers));
     kprintf("Finished ksleepinit\n");
 }
 
 /*-----------------------------------------------------------------------------------
- * Places a process onto the delta list of sleeping processes.
+ * Places a process onto the timing wheel of sleeping processes.
  *
  * @param proc         The process to put to sleep
  * @param milliseconds The number of milliseconds to sleep for
@@ -39,10 +164,156 @@ void ksleepinit(void) {
  */
 void sleep(pcb_t *proc, unsigned int milliseconds) {
     int time_slices_to_sleep = ms_to_time_slices(milliseconds);
-    insert(&sleep_queue, proc, time_slices_to_sleep);
+    proc->timer.expire = &expire_process;
+    proc->timer.owner = proc;
+    wheel_insert(&sleep_queue, &proc->timer, add_slack(proc, time_slices_to_sleep));
+
+    proc->state = BLOCKED;
+    proc->blocked_queue = SLEEP;
+}
 
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysusleep. Blocks the process until the monotonic
+ * clock has passed the given number of microseconds from now, see the notes on
+ * sleeps with sysusleep.
+ *
+ * @param proc         The process to put to sleep
+ * @param microseconds The number of microseconds to sleep for
+ *-----------------------------------------------------------------------------------
+ */
+void sleep_us(pcb_t *proc, unsigned int microseconds) {
+    unsigned long long now = clock_us();
+    proc->sleep_deadline_us = now + microseconds;
+    // Without 64 bit division, the clock is at most a few time slices past the tick
+    unsigned long into_tick = (unsigned long) (now - sleep_queue.now * TICK_US);
+    proc->sleep_deadline_tick = sleep_queue.now + microseconds / TICK_US
+        + (into_tick + microseconds % TICK_US) / TICK_US;
+    proc->timer.expire = &expire_precise;
+    proc->timer.owner = proc;
     proc->state = BLOCKED;
     proc->blocked_queue = SLEEP;
+    schedule_precise(proc);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes a process blocked in syssleep or sysusleep off the timing wheel, or off
+ * precise_sleepers, when its sleep is interrupted.
+ *
+ * @return The number of milliseconds the process had left to sleep
+ *-----------------------------------------------------------------------------------
+ */
+unsigned int cancel_sleep(pcb_t *proc) {
+    if (proc->sleep_deadline_us == 0) {
+        return wheel_remove(&sleep_queue, &proc->timer) * TIME_SLICE;
+    }
+    unsigned long long now = clock_us();
+    // No more than the microseconds the sleep was for
+    unsigned long left = proc->sleep_deadline_us > now ? (unsigned long) (proc->sleep_deadline_us - now) : 0;
+    cancel_timeout(proc);
+    return left / 1000 + (left % 1000 ? 1 : 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Places a process that is blocked on IPC onto the timing wheel, so the operation
+ * it is blocked on fails with TIMEOUT if it has not completed in time. The state
+ * of the process is left as it is.
+ *
+ * @param proc         The blocked process
+ * @param milliseconds The number of milliseconds to wait for
+ *-----------------------------------------------------------------------------------
+ */
+void set_timeout(pcb_t *proc, unsigned int milliseconds) {
+    proc->timer.expire = &expire_process;
+    proc->timer.owner = proc;
+    wheel_insert(&sleep_queue, &proc->timer, add_slack(proc, ms_to_time_slices(milliseconds)));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given process off the timing wheel if it is on it.
+ *-----------------------------------------------------------------------------------
+ */
+void cancel_timeout(pcb_t *proc) {
+    if (in_wheel(&proc->timer)) {
+        wheel_remove(&sleep_queue, &proc->timer);
+    } else if (proc->sleep_deadline_us != 0) {
+        remove_precise(proc);
+    }
+    proc->sleep_deadline_us = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of systimer. Arms a free kernel timer to deliver the
+ * given signal to the given process.
+ *
+ * @param owner         A pointer to the PCB of the calling process
+ * @param target        A pointer to the PCB of the process to signal, validated by
+ *                      the dispatcher
+ * @param signal_number The signal to deliver, validated by the dispatcher
+ * @param milliseconds  The number of milliseconds until the timer first expires
+ * @param period        The number of milliseconds between the later expiries, 0 for
+ *                      a one-shot timer
+ * @return              The identifier of the timer, or -1 if every timer is in use
+ *-----------------------------------------------------------------------------------
+ */
+int arm_timer(pcb_t *owner, pcb_t *target, int signal_number, unsigned int milliseconds, unsigned int period) {
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        kernel_timer_t *timer = &timers[i];
+        if (timer->owner == NULL) {
+            timer->owner = owner;
+            timer->target = target;
+            timer->signal_number = signal_number;
+            timer->period = ms_to_time_slices(period);
+            timer->entry.expire = &expire_timer;
+            timer->entry.owner = timer;
+            wheel_insert(&sleep_queue, &timer->entry, ms_to_time_slices(milliseconds));
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of systimercancel. Stops and frees the given kernel
+ * timer.
+ *
+ * @param owner    A pointer to the PCB of the calling process
+ * @param timer_id The identifier returned by arm_timer
+ * @return         0 on success, or -1 if the timer is not armed by the process
+ *-----------------------------------------------------------------------------------
+ */
+int cancel_timer(pcb_t *owner, int timer_id) {
+    if (timer_id < 0 || timer_id >= MAX_TIMERS || timers[timer_id].owner != owner) {
+        return -1;
+    }
+    free_timer(&timers[timer_id]);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called when a process is cleaned up. Frees the kernel timers armed by the
+ * given process and those targeting it.
+ *-----------------------------------------------------------------------------------
+ */
+void release_timers(pcb_t *proc) {
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        kernel_timer_t *timer = &timers[i];
+        if (timer->owner != NULL && (timer->owner == proc || timer->target == proc)) {
+            free_timer(timer);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given kernel timer off the timing wheel if it is on it, and marks it
+ * free.
+ *-----------------------------------------------------------------------------------
+ */
+static void free_timer(kernel_timer_t *timer) {
+    if (in_wheel(&timer->entry)) {
+        wheel_remove(&sleep_queue, &timer->entry);
+    }
+    timer->owner = NULL;
+    timer->target = NULL;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -53,6 +324,40 @@ static int ms_to_time_slices(unsigned int milliseconds) {
     return milliseconds / TIME_SLICE + (milliseconds % TIME_SLICE ? 1 : 0);
 }
 
+/*-----------------------------------------------------------------------------------
+ * Extends the given delay by up to the timer slack of the given process, to the tick
+ * with the most trailing zero bits, so that the processes with slack expire on as
+ * few ticks as possible.
+ *
+ * @param proc  The process the delay is for
+ * @param delay The shortest delay in time slices
+ * @return      The delay in time slices to insert into the timing wheel
+ *-----------------------------------------------------------------------------------
+ */
+static int add_slack(pcb_t *proc, int delay) {
+    if (proc->timer_slack == 0) {
+        return delay;
+    }
+    // The wheel wakes a delay of 0 on the next tick
+    if (delay < 1) {
+        delay = 1;
+    }
+    unsigned long long earliest = sleep_queue.now + delay;
+    unsigned long long latest = earliest + proc->timer_slack;
+    // Every tick in the window agrees with latest above the highest bit in which
+    // latest and the tick before the window differ, clearing the bits below it gives
+    // the tick in the window with the most trailing zero bits
+    unsigned long long differing = (earliest - 1) ^ latest;
+    int bit;
+    if (differing >> 32) {
+        bit = 32 + find_last_set_bit((unsigned long) (differing >> 32));
+    } else {
+        bit = find_last_set_bit((unsigned long) differing);
+    }
+    unsigned long long aligned = latest & ~((1ULL << bit) - 1);
+    return (int) (aligned - sleep_queue.now);
+}
+
 /*-----------------------------------------------------------------------------------
  * Notifies the sleep device that a time slice has occurred. Wakes up any processes
  * that need to be woken up by placing them on the ready queue associated with their
@@ -60,15 +365,299 @@ static int ms_to_time_slices(unsigned int milliseconds) {
  *-----------------------------------------------------------------------------------
  */
 void tick(void) {
-    pcb_t *proc = delta_peek(&sleep_queue);
-    if (proc != NULL) {
-        proc->key--;
-        while (proc != NULL && proc->key <= 0) {
-            pcb_t *proc_to_wake = poll(&sleep_queue);
-            proc_to_wake->result_code = 0;
-            ready(proc_to_wake);
-
-            proc = delta_peek(&sleep_queue);
+    wheel_advance(&sleep_queue);
+    wake_precise_sleepers();
+    arm_split();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the timing wheel for every process that is due. A sleeping process is
+ * woken up, a polling process is unblocked with no sources ready, and a process
+ * blocked on IPC has its operation fail with TIMEOUT.
+ *-----------------------------------------------------------------------------------
+ */
+static void expire_process(timer_entry_t *entry) {
+    pcb_t *proc = entry->owner;
+    TRACE(TRACE_TIMER, TRACE_WAKEUP, proc->pid, proc->blocked_queue, (unsigned long) sleep_queue.now);
+    if (proc->blocked_queue == SLEEP) {
+        proc->result_code = 0;
+        ready(proc);
+    } else if (proc->blocked_queue == POLL) {
+        poll_timeout(proc);
+    } else {
+        ipc_timeout(proc);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the timing wheel for every kernel timer that is due. Delivers the
+ * signal of the timer, then puts a periodic timer back on the wheel one period
+ * later and frees a one-shot timer.
+ *-----------------------------------------------------------------------------------
+ */
+static void expire_timer(timer_entry_t *entry) {
+    kernel_timer_t *timer = entry->owner;
+    signal(timer->target, timer->signal_number);
+    if (timer->period > 0) {
+        // The wheel is at the tick the timer was due at
+        wheel_insert(&sleep_queue, entry, timer->period);
+    } else {
+        free_timer(timer);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Called by the timing wheel for every process sleeping with sysusleep whose entry
+ * is due, at the start of the time slice its deadline falls in or on the way there.
+ *-----------------------------------------------------------------------------------
+ */
+static void expire_precise(timer_entry_t *entry) {
+    schedule_precise(entry->owner);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Places a process sleeping with sysusleep onto the timing wheel until the tick that
+ * starts the time slice its deadline falls in, or if that is the current time slice
+ * onto precise_sleepers, splitting the time slice at its deadline.
+ *-----------------------------------------------------------------------------------
+ */
+static void schedule_precise(pcb_t *proc) {
+    if (proc->sleep_deadline_tick > sleep_queue.now) {
+        // A delay the wheel cannot hold is shortened, the entry is then put back
+        wheel_insert(&sleep_queue, &proc->timer, (int) (proc->sleep_deadline_tick - sleep_queue.now));
+        return;
+    }
+    pcb_t **link = &precise_sleepers;
+    while (*link != NULL && (*link)->sleep_deadline_us <= proc->sleep_deadline_us) {
+        link = &(*link)->next_sleeper;
+    }
+    proc->next_sleeper = *link;
+    *link = proc;
+    arm_split();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes the given process off precise_sleepers if it is on it.
+ *-----------------------------------------------------------------------------------
+ */
+static void remove_precise(pcb_t *proc) {
+    for (pcb_t **link = &precise_sleepers; *link != NULL; link = &(*link)->next_sleeper) {
+        if (*link == proc) {
+            *link = proc->next_sleeper;
+            proc->next_sleeper = NULL;
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Wakes up the processes on precise_sleepers whose deadline the monotonic clock has
+ * passed.
+ *-----------------------------------------------------------------------------------
+ */
+static void wake_precise_sleepers(void) {
+    if (precise_sleepers == NULL) {
+        return;
+    }
+    unsigned long long now = clock_us();
+    while (precise_sleepers != NULL && precise_sleepers->sleep_deadline_us <= now) {
+        pcb_t *proc = precise_sleepers;
+        precise_sleepers = proc->next_sleeper;
+        proc->next_sleeper = NULL;
+        proc->sleep_deadline_us = 0;
+        TRACE(TRACE_TIMER, TRACE_WAKEUP, proc->pid, proc->blocked_queue, (unsigned long) sleep_queue.now);
+        proc->result_code = 0;
+        ready(proc);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sets the PIT to a one-shot that ends at the first deadline on precise_sleepers, or
+ * at the end of the time slice if the time slice is split and no deadline is left.
+ * Nothing is set while the tick ending the time slice is raised and not yet taken,
+ * the next time slice is split once it starts.
+ *-----------------------------------------------------------------------------------
+ */
+static void arm_split(void) {
+    if (!PREEMPTION_ENABLED || oneshot_ticks > 0 || (precise_sleepers == NULL && split_cycles == 0)) {
+        return;
+    }
+    int periodic = split_cycles == 0;
+    unsigned long into = periodic ? tick_cycles() : split_elapsed();
+    if (into >= TICK_COUNT) {
+        return;
+    }
+    unsigned long end = TICK_COUNT;
+    if (precise_sleepers != NULL) {
+        // Rounded up, so the one-shot does not end before the deadline
+        unsigned long long tick_start = sleep_queue.now * TICK_US;
+        unsigned long long deadline = precise_sleepers->sleep_deadline_us;
+        if (deadline < tick_start + TICK_US) {
+            unsigned long offset = deadline > tick_start ? (unsigned long) (deadline - tick_start) : 0;
+            end = (offset * TICK_COUNT + TICK_US - 1) / TICK_US;
+        }
+    }
+    // The periodic tick ends the time slice as early
+    if (periodic && end == TICK_COUNT) {
+        return;
+    }
+    if (end < into + MIN_SPLIT_CYCLES) {
+        end = into + MIN_SPLIT_CYCLES;
+    }
+    oneshotPIT(end - into);
+    split_start = into;
+    split_cycles = end - into;
+    if (periodic && pendingPIT()) {
+        // The periodic tick was raised before the one-shot was set, and ends the
+        // time slice as usual
+        split_start = 0;
+        split_cycles = 0;
+        initPIT(1000 / TIME_SLICE);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called on every timer interrupt. Wakes up the processes whose sysusleep ends
+ * at a one-shot splitting the time slice and sets the next one-shot, or restarts
+ * the periodic tick once the time slice is over.
+ *
+ * @return 1 if the time slice goes on, 0 if the interrupt ends a split time slice,
+ *         or -1 if the time slice was not split
+ *-----------------------------------------------------------------------------------
+ */
+int split_exit(void) {
+    if (split_cycles == 0) {
+        return -1;
+    }
+    if (split_elapsed() >= TICK_COUNT) {
+        split_start = 0;
+        split_cycles = 0;
+        initPIT(1000 / TIME_SLICE);
+        return 0;
+    }
+    wake_precise_sleepers();
+    arm_split();
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the cycles the PIT has counted since the start of a split time slice.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long split_elapsed(void) {
+    // Read the status again in case the one-shot expired between the two reads
+    int fired = firedPIT();
+    unsigned int count = readPIT();
+    if (!fired && firedPIT()) {
+        fired = 1;
+        count = readPIT();
+    }
+    if (fired) {
+        // Past the terminal count the counter wraps around and goes on counting down
+        return split_start + split_cycles + ((0x10000 - count) & 0xffff);
+    }
+    // The count is loaded a cycle after the one-shot is set
+    if (count > split_cycles) {
+        return split_start;
+    }
+    return split_start + split_cycles - count;
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called when only the idle process is runnable, just before switching to
+ * it. Replaces the periodic tick with a one-shot timer that expires when the first
+ * sleeping process is due, or after MAX_ONESHOT_TICKS time slices.
+ *-----------------------------------------------------------------------------------
+ */
+void tickless_enter(void) {
+    // A split time slice ends with the periodic tick
+    if (precise_sleepers != NULL || split_cycles > 0) {
+        return;
+    }
+    int ticks = wheel_next_expiry(&sleep_queue, MAX_ONESHOT_TICKS);
+    // The periodic tick is as early
+    if (ticks <= 1) {
+        return;
+    }
+    oneshotPIT(ticks * TICK_COUNT);
+    oneshot_ticks = ticks;
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called on every interrupt. Restarts the periodic tick if it was stopped by
+ * tickless_enter.
+ *
+ * @return The number of whole time slices that passed while the periodic tick was
+ *         stopped, or -1 if the periodic tick was running
+ *-----------------------------------------------------------------------------------
+ */
+int tickless_exit(void) {
+    if (oneshot_ticks == 0) {
+        return -1;
+    }
+    int elapsed = oneshot_ticks;
+    if (!firedPIT()) {
+        // Woken up early by another interrupt
+        elapsed = (oneshot_ticks * TICK_COUNT - readPIT()) / TICK_COUNT;
+    }
+    oneshot_ticks = 0;
+    initPIT(1000 / TIME_SLICE);
+    return elapsed;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the cycles the PIT has counted since the last tick the processor took,
+ * while the periodic tick runs. A tick that has been raised and not yet taken adds
+ * a whole tick.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long tick_cycles(void) {
+    // The counter reloads when the tick is raised, so read the request register
+    // again in case the counter reloaded between the two reads
+    int pending = pendingPIT();
+    unsigned int count = readPIT();
+    if (!pending && pendingPIT()) {
+        pending = 1;
+        count = readPIT();
+    }
+    return TICK_COUNT - count + (pending ? TICK_COUNT : 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the time since the PIT raised the last tick, for the dispatcher to find
+ * out how late it handles a tick. Only meaningful while the periodic tick runs.
+ *
+ * @return The number of microseconds since the last tick was raised
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long tick_age_us(void) {
+    return tick_cycles() * (TIME_SLICE * 1000) / TICK_COUNT;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reads the monotonic clock, with the resolution of the PIT, which counts at
+ * TIMER_FREQ Hz.
+ *
+ * @return The number of microseconds since the sleep device was initialized
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long long clock_us(void) {
+    unsigned long cycles;
+    if (oneshot_ticks > 0) {
+        cycles = oneshot_ticks * TICK_COUNT;
+        if (!firedPIT()) {
+            cycles -= readPIT();
         }
+    } else if (split_cycles > 0) {
+        cycles = split_elapsed();
+    } else {
+        cycles = tick_cycles();
+    }
+
+    unsigned long long us = sleep_queue.now * (TIME_SLICE * 1000) + cycles * (TIME_SLICE * 1000) / TICK_COUNT;
+    if (us < last_clock_us) {
+        us = last_clock_us;
     }
+    last_clock_us = us;
+    return us;
 }
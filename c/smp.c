@@ -0,0 +1,513 @@
+/* smp.c : multiprocessor support
+ */
+
+#include <i386.h>
+#include <xeroslib.h>
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is where the state of each processor is kept and, when SMP_ENABLED is set,
+ * where the other processors of the machine are started through the local APIC.
+ * Each processor runs its own dispatcher loop on its own kernel stack, with its own
+ * current process, idle process and ready queues.
+ *
+ * Notes on the processor state:
+ * - Every processor has a cpu_t in cpus, and a data segment in the GDT whose base is
+ *   its cpu_t, which is loaded into %gs and never changed, so that this_cpu and the
+ *   context switcher find the state of the processor they run on
+ * - Processes do not save or restore %gs, so they pick up the %gs of whichever
+ *   processor they run on
+ *
+ * Notes on mutual exclusion:
+ * - The kernel runs with interrupts disabled, which only excludes the processor
+ *   itself, so the dispatcher also holds the kernel lock, a spinlock, whenever it
+ *   is not running a process
+ * - The boot processor takes the kernel lock in ksmpinit and holds it through the
+ *   rest of the initialization, so the other processors only enter the dispatcher
+ *   once the first process runs
+ *
+ * Notes on starting the other processors:
+ * - An INIT and two STARTUP interprocessor interrupts are broadcast to all other
+ *   processors, which start in real mode at ap_trampoline. The kernel is linked at
+ *   address 0, so the trampoline runs in place from the first 1MB, aligned to a page
+ *   as the STARTUP vector is a page number
+ * - The trampoline loads the GDT of the kernel, enters protected mode and claims
+ *   the next processor index, processors past MAX_CPUS halt
+ * - Once the boot processor stops waiting for the others it swaps MAX_CPUS into the
+ *   next index, so a processor that starts late claims an index past MAX_CPUS and
+ *   halts without touching the stacks of the indices nobody claimed, which are freed
+ * - The local APIC timer of the boot processor is calibrated against the PIT, and
+ *   drives the time slices of the other processors, the boot processor keeps the
+ *   PIT, the sleep device and the keyboard
+ * - Not supported with PAGING_ENABLED, whose page fault task cannot be shared
+ * - make smp builds the kernel with SMP_ENABLED set, and the top level make smp
+ *   runs it in bochs on two processors
+ *
+ * List of functions that are called from outside this file:
+ * - ksmpinit
+ *   - Sets up the state of the boot processor and takes the kernel lock
+ * - smp_boot_aps
+ *   - Starts the other processors if SMP_ENABLED is set
+ * - this_cpu
+ *   - Returns the state of the processor running the caller
+ * - get_cpu
+ *   - Returns the state of the processor with the given index, or NULL if it is not
+ *     running the dispatcher
+ * - smp_cpu_count
+ *   - Returns the number of processors started
+ * - smp_cpu_mask
+ *   - Returns the processors running the dispatcher, one bit per index
+ * - lapic_eoi
+ *   - Acknowledges an interrupt from the local APIC
+ * - spin_lock, spin_unlock
+ *   - Acquire and release a spinlock
+ * - kernel_lock, kernel_unlock
+ *   - Acquire and release the kernel lock
+ *-----------------------------------------------------------------------------------
+ */
+
+// Index in the GDT of the data segment of the boot processor, the others follow it
+#define CPU_GDT_INDEX 8
+#define EFLAGS_ID 0x200000
+#define CPUID_APIC 0x200
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_ENABLE 0x800
+// Local APIC registers, as offsets from its base
+#define LAPIC_ID 0x20
+#define LAPIC_EOI 0xb0
+#define LAPIC_SVR 0xf0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3e0
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_DIVIDE_16 0x3
+// Interprocessor interrupts broadcast to all processors but the sender
+#define ICR_INIT_ALL_BUT_SELF 0xc4500
+#define ICR_STARTUP_ALL_BUT_SELF 0xc4600
+#define ICR_DELIVERY_PENDING 0x1000
+// PIT cycles waited after the INIT and after each STARTUP interrupt
+#define INIT_DELAY TIMER_DIV(100)
+#define STARTUP_DELAY TIMER_DIV(5000)
+
+void ap_trampoline(void);
+void ap_main(int index);
+void _SpuriousEntryPoint(void);
+
+static void set_cpu_descriptor(int index);
+static void load_cpu_segment(int index);
+static void init_cpu(int index);
+static int has_apic(void);
+static unsigned long lapic_read(unsigned long reg);
+static void lapic_write(unsigned long reg, unsigned long value);
+static void lapic_enable(void);
+static void send_ipi(unsigned long command);
+static void pit_delay(unsigned int cycles);
+static unsigned long calibrate_lapic_timer(void);
+
+extern struct sd gdt[];
+
+static cpu_t cpus[MAX_CPUS];
+static spinlock_t kernel_spinlock;
+static unsigned long lapic_base;
+// Local APIC timer counts in a time slice
+static unsigned long lapic_slice_count;
+static int num_cpus;
+
+// Used by the trampoline, the index of the next processor to start and the top of
+// its kernel stack
+volatile int ap_next_index;
+int ap_max_cpus = MAX_CPUS;
+unsigned long ap_stack_tops[MAX_CPUS];
+
+/*------------------------------------------------------------------------
+ * Where the other processors start, in real mode at the page the STARTUP
+ * interrupt names. Enters protected mode with the GDT of the kernel,
+ * claims a processor index and calls ap_main on the kernel stack for it.
+ *------------------------------------------------------------------------
+ */
+__asm__(
+".text;"
+".balign 4096;"
+".code16;"
+"ap_trampoline:"
+        "cli;"
+        "movw %cs, %ax;"
+        "movw %ax, %ds;"
+        "lgdtl ap_gdtr - ap_trampoline;"
+        "movl %cr0, %eax;"
+        "orl $1, %eax;"
+        "movl %eax, %cr0;"
+        "ljmpl $0x8, $ap_protected_entry;"
+".code32;"
+"ap_protected_entry:"
+        "movw $0x10, %ax;"
+        "movw %ax, %ds;"
+        "movw %ax, %es;"
+        "movw %ax, %fs;"
+        "movw $0x18, %ax;"
+        "movw %ax, %ss;"
+        "movl $1, %eax;"
+        "lock xaddl %eax, ap_next_index;"
+        "cmpl ap_max_cpus, %eax;"
+        "jae ap_park;"
+        "movl ap_stack_tops(,%eax,4), %esp;"
+        "pushl %eax;"
+        "call ap_main;"
+"ap_park:"
+        "cli;"
+        "hlt;"
+        "jmp ap_park;"
+".balign 4;"
+"ap_gdtr:"
+        ".word 127;"
+        ".long gdt;"
+
+// Spurious interrupts from the local APIC are not acknowledged
+"_SpuriousEntryPoint:"
+        "iret;"
+);
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, before kdispinit. Sets up the state of the boot
+ * processor, loads its %gs and takes the kernel lock.
+ *-----------------------------------------------------------------------------------
+ */
+void ksmpinit(void) {
+    kprintf("Starting ksmpinit...\n");
+    fill_words(cpus, 0, sizeof(cpus));
+    kernel_spinlock.locked = 0;
+    num_cpus = 1;
+    ap_next_index = 1;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        set_cpu_descriptor(i);
+    }
+    load_cpu_segment(0);
+    init_cpu(0);
+    kernel_lock();
+    kprintf("Finished ksmpinit\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be only called by the kernel, after kdispinit and contextinit and before
+ * initPIT. Starts the other processors if SMP_ENABLED is set, they wait for the
+ * kernel lock before entering the dispatcher.
+ *-----------------------------------------------------------------------------------
+ */
+void smp_boot_aps(void) {
+    if (!SMP_ENABLED) {
+        return;
+    }
+    if (PAGING_ENABLED) {
+        kprintf("SMP is not supported with paging, running on one processor\n");
+        return;
+    }
+    if (!has_apic()) {
+        kprintf("No local APIC, running on one processor\n");
+        return;
+    }
+    kprintf("Starting smp_boot_aps...\n");
+
+    unsigned long lo, hi;
+    __asm__ volatile("rdmsr;" : "=a" (lo), "=d" (hi) : "c" (MSR_APIC_BASE));
+    (void) hi;
+    lapic_base = lo & ~(NBPG - 1);
+    set_evec(SPURIOUS_INTERRUPT_NUMBER, (unsigned long) _SpuriousEntryPoint);
+    lapic_enable();
+    lapic_slice_count = calibrate_lapic_timer();
+
+    for (int i = 1; i < MAX_CPUS; i++) {
+        void *stack = kmalloc(KERNEL_STACK);
+        assert(stack != NULL, "Not enough memory for processor stacks");
+        ap_stack_tops[i] = (unsigned long) stack + KERNEL_STACK - sizeof(unsigned long);
+    }
+
+    unsigned long vector = (unsigned long) &ap_trampoline / NBPG;
+    send_ipi(ICR_INIT_ALL_BUT_SELF);
+    pit_delay(INIT_DELAY);
+    send_ipi(ICR_STARTUP_ALL_BUT_SELF | vector);
+    pit_delay(STARTUP_DELAY);
+    send_ipi(ICR_STARTUP_ALL_BUT_SELF | vector);
+    // Give the processors time to claim their index
+    pit_delay(INIT_DELAY);
+
+    // Close the indices, every processor that claimed one below MAX_CPUS has a stack
+    int claimed = MAX_CPUS;
+    __asm__ volatile("xchgl %0, %1;" : "+r" (claimed), "+m" (ap_next_index) : : "memory");
+    num_cpus = claimed < MAX_CPUS ? claimed : MAX_CPUS;
+    for (int i = num_cpus; i < MAX_CPUS; i++) {
+        kfree((void *) (ap_stack_tops[i] + sizeof(unsigned long) - KERNEL_STACK));
+    }
+    kprintf("Started %d processors\n", num_cpus);
+    kprintf("Finished smp_boot_aps\n");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Where the other processors continue from the trampoline, on their own kernel
+ * stack. Sets up the processor and enters the dispatcher once the kernel lock is
+ * free.
+ *
+ * @param index The index of the processor
+ *-----------------------------------------------------------------------------------
+ */
+void ap_main(int index) {
+    load_cpu_segment(index);
+    lidt();
+    lapic_enable();
+
+    kernel_lock();
+    init_cpu(index);
+    kdispcpuinit();
+    kprintf("Processor %d running\n", index);
+    if (PREEMPTION_ENABLED) {
+        lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+        lapic_write(LAPIC_LVT_TIMER, APIC_TIMER_INTERRUPT_NUMBER | LAPIC_TIMER_PERIODIC);
+        lapic_write(LAPIC_TIMER_INITIAL, lapic_slice_count);
+    }
+    dispatch();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns a pointer to the state of the processor running the caller.
+ *-----------------------------------------------------------------------------------
+ */
+cpu_t *this_cpu(void) {
+    cpu_t *cpu;
+    __asm__ volatile("movl %%gs:0, %0;" : "=r" (cpu));
+    return cpu;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns a pointer to the state of the processor with the given index.
+ *
+ * @param index The index of the processor
+ * @return      A pointer to its state, NULL if it is not running the dispatcher
+ *-----------------------------------------------------------------------------------
+ */
+cpu_t *get_cpu(int index) {
+    if (index < 0 || index >= MAX_CPUS || !cpus[index].online) {
+        return NULL;
+    }
+    return &cpus[index];
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of processors started, 1 unless SMP_ENABLED is set.
+ *-----------------------------------------------------------------------------------
+ */
+int smp_cpu_count(void) {
+    return num_cpus;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the processors running the dispatcher, bit i set if processor i is.
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long smp_cpu_mask(void) {
+    unsigned long mask = 0;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        if (cpus[i].online) {
+            mask |= 1UL << i;
+        }
+    }
+    return mask;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Acknowledges the interrupt from the local APIC being serviced.
+ *-----------------------------------------------------------------------------------
+ */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Acquires the given spinlock, spinning until it is free.
+ *
+ * @param lock A pointer to the spinlock
+ *-----------------------------------------------------------------------------------
+ */
+void spin_lock(spinlock_t *lock) {
+    int locked = 1;
+    for (;;) {
+        __asm__ volatile("xchgl %0, %1;" : "+r" (locked), "+m" (lock->locked) : : "memory");
+        if (!locked) {
+            return;
+        }
+        // Only spin on reads until the lock looks free, then try to take it again
+        while (lock->locked) {
+            __asm__ volatile("rep; nop;");
+        }
+        locked = 1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Releases the given spinlock.
+ *
+ * @param lock A pointer to the spinlock, held by the caller
+ *-----------------------------------------------------------------------------------
+ */
+void spin_unlock(spinlock_t *lock) {
+    __asm__ volatile("" : : : "memory");
+    lock->locked = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Acquires the kernel lock, which the dispatcher holds while it is not running a
+ * process.
+ *-----------------------------------------------------------------------------------
+ */
+void kernel_lock(void) {
+    spin_lock(&kernel_spinlock);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Releases the kernel lock.
+ *-----------------------------------------------------------------------------------
+ */
+void kernel_unlock(void) {
+    spin_unlock(&kernel_spinlock);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sets the GDT descriptor of the processor with the given index to a data segment
+ * covering its cpu_t.
+ *-----------------------------------------------------------------------------------
+ */
+static void set_cpu_descriptor(int index) {
+    struct sd *psd = &gdt[CPU_GDT_INDEX + index];
+    unsigned long base = (unsigned long) &cpus[index];
+    unsigned long limit = sizeof(cpu_t) - 1;
+
+    psd->sd_lolimit = limit;
+    psd->sd_hilimit = limit >> 16;
+    psd->sd_lobase = base;
+    psd->sd_midbase = base >> 16;
+    psd->sd_hibase = base >> 24;
+    // Read/write data
+    psd->sd_perm = 2;
+    psd->sd_iscode = 0;
+    psd->sd_isapp = 1;
+    psd->sd_dpl = 0;
+    psd->sd_present = 1;
+    psd->sd_avl = 0;
+    psd->sd_mbz = 0;
+    psd->sd_32b = 1;
+    psd->sd_gran = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Loads the data segment of the processor with the given index into %gs.
+ *-----------------------------------------------------------------------------------
+ */
+static void load_cpu_segment(int index) {
+    unsigned short selector = (CPU_GDT_INDEX + index) * 8;
+    __asm__ volatile("movw %0, %%gs;" : : "r" (selector));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Fills in the state of the processor with the given index and marks it online.
+ *-----------------------------------------------------------------------------------
+ */
+static void init_cpu(int index) {
+    cpu_t *cpu = &cpus[index];
+    cpu->self = cpu;
+    cpu->index = index;
+    cpu->online = 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if the processor has a local APIC, 0 otherwise. CPUID is only available
+ * if the ID flag can be changed.
+ *-----------------------------------------------------------------------------------
+ */
+static int has_apic(void) {
+    unsigned long changed;
+    __asm__ volatile(
+    "pushfl;"
+            "popl %%eax;"
+            "movl %%eax, %%ecx;"
+            "xorl %1, %%eax;"
+            "pushl %%eax;"
+            "popfl;"
+            "pushfl;"
+            "popl %%eax;"
+            "xorl %%ecx, %%eax;"
+            "pushl %%ecx;"
+            "popfl;"
+    : "=a" (changed)
+    : "i" (EFLAGS_ID)
+    : "%ecx"
+    );
+    if (!(changed & EFLAGS_ID)) {
+        return 0;
+    }
+
+    unsigned long eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid;" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    return (edx & CPUID_APIC) != 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Reads the given register of the local APIC.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long lapic_read(unsigned long reg) {
+    return *(volatile unsigned long *) (lapic_base + reg);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Writes the given value to the given register of the local APIC.
+ *-----------------------------------------------------------------------------------
+ */
+static void lapic_write(unsigned long reg, unsigned long value) {
+    *(volatile unsigned long *) (lapic_base + reg) = value;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Software enables the local APIC of the processor, with its spurious interrupts
+ * on SPURIOUS_INTERRUPT_NUMBER.
+ *-----------------------------------------------------------------------------------
+ */
+static void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_INTERRUPT_NUMBER);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sends the given interprocessor interrupt and waits until it is delivered.
+ *-----------------------------------------------------------------------------------
+ */
+static void send_ipi(unsigned long command) {
+    lapic_write(LAPIC_ICR_HIGH, 0);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_DELIVERY_PENDING);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Busy waits for the given number of PIT cycles, at most 65535.
+ *-----------------------------------------------------------------------------------
+ */
+static void pit_delay(unsigned int cycles) {
+    oneshotPIT(cycles);
+    while (!firedPIT());
+}
+
+/*-----------------------------------------------------------------------------------
+ * Measures the number of local APIC timer counts in one time slice, using the PIT.
+ * The local APIC timers of all processors run at the same rate.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long calibrate_lapic_timer(void) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xffffffff);
+    pit_delay(TIMER_DIV(1000 / TIME_SLICE));
+    unsigned long count = 0xffffffff - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    return count;
+}
@@ -0,0 +1,209 @@
+/* stride.c : stride scheduler
+ */
+
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the stride scheduler, which replaces the priority queues of the
+ * dispatcher when kdispinit is called with SCHED_STRIDE. Every process holds a
+ * number of tickets, set with syssettickets, and receives a share of the processor
+ * proportional to its tickets.
+ *
+ * Notes on the scheduling policy:
+ * - The stride of a process is STRIDE_ONE divided by its tickets, and its pass is
+ *   advanced by its stride for every time slice it runs
+ * - The ready process with the lowest pass runs next, the ready processes are kept
+ *   in a binary min-heap ordered by pass
+ * - A process that becomes ready with a pass behind the pass of the last process
+ *   selected is moved up to it, so time spent blocked is not saved up as credit
+ * - Passes are compared by their signed difference, so they may wrap around
+ * - The heap is shared by all processors. A processor that may not run the process
+ *   at the top of the heap, see the notes on affinity in disp.c, searches the heap
+ *   for the lowest pass it may run, so pinned processes cost a pass over the heap
+ *
+ * List of functions that are called from outside this file:
+ * - kstrideinit
+ *   - Initializes the stride scheduler with no ready processes
+ * - set_tickets
+ *   - Implements the kernel side of syssettickets
+ * - stride_ready
+ *   - Adds a process to the heap of ready processes
+ * - stride_remove
+ *   - Removes a process from the heap of ready processes
+ * - stride_next
+ *   - Returns the ready process with the lowest pass a processor may run, or NULL
+ * - stride_charge
+ *   - Advances the pass of a process for the time slices it has run
+ *-----------------------------------------------------------------------------------
+ */
+
+// The stride of a process with a single ticket
+#define STRIDE_ONE (1UL << 16)
+
+static int pass_before(pcb_t *a, pcb_t *b);
+static void swap(int i, int j);
+static void sift_up(int i);
+static void sift_down(int i);
+
+// Ready processes, a binary min-heap ordered by pass
+static pcb_t *stride_heap[MAX_PROCESSES];
+static int heap_size;
+// Pass of the process selected last
+static unsigned long global_pass;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any processes are made ready. Initializes the stride
+ * scheduler with an empty heap.
+ *-----------------------------------------------------------------------------------
+ */
+void kstrideinit(void) {
+    heap_size = 0;
+    global_pass = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syssettickets. Gives the given process the given
+ * number of tickets. The process must not be on the heap.
+ *
+ * @param proc    A pointer to the PCB of the calling process
+ * @param tickets The number of tickets, from 1 to MAX_TICKETS
+ * @return        The previous number of tickets of the process, or -1 if the number
+ *                of tickets is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int set_tickets(pcb_t *proc, int tickets) {
+    if (tickets < 1 || tickets > MAX_TICKETS) {
+        return -1;
+    }
+    int prev_tickets = proc->tickets;
+    proc->tickets = tickets;
+    proc->stride = STRIDE_ONE / tickets;
+    return prev_tickets;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given process to the heap of ready processes, first moving its pass up
+ * to the pass of the process selected last if it is behind.
+ *-----------------------------------------------------------------------------------
+ */
+void stride_ready(pcb_t *proc) {
+    if ((long) (proc->pass - global_pass) < 0) {
+        proc->pass = global_pass;
+    }
+    proc->heap_index = heap_size;
+    stride_heap[heap_size++] = proc;
+    sift_up(proc->heap_index);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given process from the heap of ready processes.
+ *-----------------------------------------------------------------------------------
+ */
+void stride_remove(pcb_t *proc) {
+    int i = proc->heap_index;
+    heap_size--;
+    if (i == heap_size) {
+        return;
+    }
+    // Fill the hole with the last process and restore the heap order around it
+    stride_heap[i] = stride_heap[heap_size];
+    stride_heap[i]->heap_index = i;
+    sift_up(i);
+    sift_down(stride_heap[i]->heap_index);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the ready process with the lowest pass that the given processor may run
+ * from the heap and returns it.
+ *
+ * @param cpu_index The index of the processor
+ * @return          A pointer to the PCB of the process, or NULL if there is none
+ *-----------------------------------------------------------------------------------
+ */
+pcb_t *stride_next(int cpu_index) {
+    if (heap_size == 0) {
+        return NULL;
+    }
+    pcb_t *proc = stride_heap[0];
+    if (!CPU_ALLOWED(proc, cpu_index)) {
+        // Below the top the heap is only partly ordered, so every entry is looked at
+        proc = NULL;
+        for (int i = 1; i < heap_size; i++) {
+            pcb_t *candidate = stride_heap[i];
+            if (CPU_ALLOWED(candidate, cpu_index) && (proc == NULL || pass_before(candidate, proc))) {
+                proc = candidate;
+            }
+        }
+        if (proc == NULL) {
+            return NULL;
+        }
+    }
+    stride_remove(proc);
+    global_pass = proc->pass;
+    return proc;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Advances the pass of the given process by its stride for each of the given
+ * number of time slices it has run.
+ *-----------------------------------------------------------------------------------
+ */
+void stride_charge(pcb_t *proc, int ticks) {
+    proc->pass += proc->stride * ticks;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if process a has a lower pass than process b, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static int pass_before(pcb_t *a, pcb_t *b) {
+    return (long) (a->pass - b->pass) < 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Swaps the processes at the given positions of the heap.
+ *-----------------------------------------------------------------------------------
+ */
+static void swap(int i, int j) {
+    pcb_t *proc = stride_heap[i];
+    stride_heap[i] = stride_heap[j];
+    stride_heap[j] = proc;
+    stride_heap[i]->heap_index = i;
+    stride_heap[j]->heap_index = j;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the process at the given position of the heap up until its parent has a
+ * pass no higher than its own.
+ *-----------------------------------------------------------------------------------
+ */
+static void sift_up(int i) {
+    while (i > 0 && pass_before(stride_heap[i], stride_heap[(i - 1) / 2])) {
+        swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the process at the given position of the heap down until neither of its
+ * children has a pass lower than its own.
+ *-----------------------------------------------------------------------------------
+ */
+static void sift_down(int i) {
+    for (;;) {
+        int lowest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < heap_size && pass_before(stride_heap[left], stride_heap[lowest])) {
+            lowest = left;
+        }
+        if (right < heap_size && pass_before(stride_heap[right], stride_heap[lowest])) {
+            lowest = right;
+        }
+        if (lowest == i) {
+            return;
+        }
+        swap(i, lowest);
+        i = lowest;
+    }
+}
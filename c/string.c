@@ -0,0 +1,191 @@
+/* string.c : word-at-a-time string routines */
+
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * These are the string routines of the kernel and the shell, which give the same
+ * results as those of libxc but look at a word of the string at a time where they
+ * can. A word holds a zero byte if HAS_ZERO_BYTE of it is not 0, so the end of a
+ * string is found without testing each byte.
+ *
+ * Notes on the routines:
+ * - Only aligned words are loaded, so a load never crosses into a page that the
+ *   string does not reach. The bytes up to the first word boundary, and those of
+ *   the word holding the end of the string, are looked at one at a time
+ * - Two strings are only compared, or copied, a word at a time if they are at the
+ *   same offset from a word boundary, otherwise a byte at a time
+ * - A comparison returns the difference of the first bytes that differ, as chars,
+ *   as strcmp and strncmp of libxc do
+ *
+ * List of functions that are called from outside this file:
+ * - strlen_words
+ *   - Returns the length of a string
+ * - strcmp_words
+ *   - Compares two strings
+ * - strncmp_words
+ *   - Compares two strings up to a length
+ * - strncpy_words
+ *   - Copies a string into a buffer of a length, padding it with zero bytes
+ *-----------------------------------------------------------------------------------
+ */
+
+#define WORD_MASK (sizeof(unsigned long) - 1)
+// Not 0 if a byte of the word is 0
+#define HAS_ZERO_BYTE(word) (((word) - 0x01010101UL) & ~(word) & 0x80808080UL)
+// Whether an address is on a word boundary, and two are as far from one
+#define ALIGNED(ptr) (((unsigned long) (ptr) & WORD_MASK) == 0)
+#define SAME_ALIGNMENT(ptr1, ptr2) ((((unsigned long) (ptr1) ^ (unsigned long) (ptr2)) & WORD_MASK) == 0)
+
+/*-----------------------------------------------------------------------------------
+ * Returns the length of a string, the number of bytes before its zero byte.
+ *
+ * @param s The string
+ * @return  The length of the string
+ *-----------------------------------------------------------------------------------
+ */
+int strlen_words(char *s) {
+    char *end = s;
+    while (!ALIGNED(end)) {
+        if (*end == '\0') {
+            return end - s;
+        }
+        end++;
+    }
+    unsigned long *word = (unsigned long *) end;
+    while (!HAS_ZERO_BYTE(*word)) {
+        word++;
+    }
+    end = (char *) word;
+    while (*end != '\0') {
+        end++;
+    }
+    return end - s;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Compares two strings.
+ *
+ * @param s1 The first string
+ * @param s2 The second string
+ * @return   0 if the strings are the same, otherwise the first byte of s1 that
+ *           differs less that of s2
+ *-----------------------------------------------------------------------------------
+ */
+int strcmp_words(char *s1, char *s2) {
+    if (SAME_ALIGNMENT(s1, s2)) {
+        while (!ALIGNED(s1)) {
+            if (*s1 != *s2) {
+                return *s1 - *s2;
+            }
+            if (*s1 == '\0') {
+                return 0;
+            }
+            s1++;
+            s2++;
+        }
+        // Equal words without a zero byte are passed over, whatever stops this is
+        // looked at a byte at a time
+        unsigned long *word1 = (unsigned long *) s1;
+        unsigned long *word2 = (unsigned long *) s2;
+        while (*word1 == *word2 && !HAS_ZERO_BYTE(*word1)) {
+            word1++;
+            word2++;
+        }
+        s1 = (char *) word1;
+        s2 = (char *) word2;
+    }
+    while (*s1 == *s2) {
+        if (*s1 == '\0') {
+            return 0;
+        }
+        s1++;
+        s2++;
+    }
+    return *s1 - *s2;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Compares two strings up to the given number of bytes.
+ *
+ * @param s1 The first string
+ * @param s2 The second string
+ * @param n  The most bytes to compare
+ * @return   0 if the strings are the same up to n bytes, otherwise the first byte
+ *           of s1 that differs less that of s2
+ *-----------------------------------------------------------------------------------
+ */
+int strncmp_words(char *s1, char *s2, int n) {
+    if (SAME_ALIGNMENT(s1, s2)) {
+        while (n > 0 && !ALIGNED(s1)) {
+            if (*s1 != *s2) {
+                return *s1 - *s2;
+            }
+            if (*s1 == '\0') {
+                return 0;
+            }
+            s1++;
+            s2++;
+            n--;
+        }
+        unsigned long *word1 = (unsigned long *) s1;
+        unsigned long *word2 = (unsigned long *) s2;
+        while (n >= (int) sizeof(unsigned long) && *word1 == *word2 && !HAS_ZERO_BYTE(*word1)) {
+            word1++;
+            word2++;
+            n -= sizeof(unsigned long);
+        }
+        s1 = (char *) word1;
+        s2 = (char *) word2;
+    }
+    for (; n > 0; n--) {
+        if (*s1 != *s2) {
+            return *s1 - *s2;
+        }
+        if (*s1 == '\0') {
+            return 0;
+        }
+        s1++;
+        s2++;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies a string into a buffer of the given number of bytes. A string shorter than
+ * the buffer is followed by zero bytes up to its end, a longer one is cut short and
+ * not terminated.
+ *
+ * @param s1 The buffer to copy to
+ * @param s2 The string to copy
+ * @param n  The size of the buffer
+ * @return   The buffer
+ *-----------------------------------------------------------------------------------
+ */
+char *strncpy_words(char *s1, char *s2, int n) {
+    char *to = s1;
+    if (SAME_ALIGNMENT(to, s2)) {
+        while (n > 0 && !ALIGNED(to) && *s2 != '\0') {
+            *to++ = *s2++;
+            n--;
+        }
+        if (ALIGNED(to)) {
+            unsigned long *to_word = (unsigned long *) to;
+            unsigned long *from_word = (unsigned long *) s2;
+            while (n >= (int) sizeof(unsigned long) && !HAS_ZERO_BYTE(*from_word)) {
+                *to_word++ = *from_word++;
+                n -= sizeof(unsigned long);
+            }
+            to = (char *) to_word;
+            s2 = (char *) from_word;
+        }
+    }
+    while (n > 0 && *s2 != '\0') {
+        *to++ = *s2++;
+        n--;
+    }
+    // The zero byte of the string is the first of the padding
+    if (n > 0) {
+        fill_words(to, 0, n);
+    }
+    return s1;
+}
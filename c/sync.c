@@ -0,0 +1,225 @@
+/* sync.c : user-level synchronization
+ */
+
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * These are the mutexes, semaphores and condition variables processes synchronize
+ * with. They run in the calling process and change their state with atomic
+ * instructions, so taking a free mutex or semaphore and releasing one nobody waits
+ * for make no system call. A process only enters the kernel, with sysfutexwait and
+ * sysfutexwake, when it has to wait or has to wake a waiting process.
+ *
+ * Notes on the primitives:
+ * - A mutex is 0 when unlocked, 1 when locked and 2 when locked with processes
+ *   that may be waiting, only an unlock from 2 wakes a waiter, and a woken process
+ *   takes the mutex as 2 since it cannot tell whether others still wait
+ * - A semaphore and a condition variable count the processes that may be waiting,
+ *   so a post or a signal with no waiters makes no system call
+ * - A condition variable waits on a sequence number advanced by every signal, so a
+ *   signal made between the unlock of the mutex and the wait is not missed
+ * - Like any condition variable, cond_wait may return without a signal, callers
+ *   check their condition in a loop
+ *
+ * List of functions that are called from outside this file:
+ * - mutex_init, mutex_lock, mutex_trylock, mutex_unlock
+ *   - Initialize, lock, try to lock without waiting, and unlock a mutex
+ * - sem_init, sem_wait, sem_trywait, sem_post
+ *   - Initialize, decrement, try to decrement without waiting, and increment a
+ *     semaphore
+ * - cond_init, cond_wait, cond_signal, cond_broadcast
+ *   - Initialize, wait on, and wake one or all of the waiters of a condition
+ *     variable
+ * - compare_and_swap, exchange, fetch_add
+ *   - The atomic operations the primitives are built on, also used by coro.c
+ *-----------------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given mutex to unlocked.
+ *-----------------------------------------------------------------------------------
+ */
+void mutex_init(mutex_t *mutex) {
+    mutex->state = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Locks the given mutex, waiting for it if it is locked.
+ *-----------------------------------------------------------------------------------
+ */
+void mutex_lock(mutex_t *mutex) {
+    int state = compare_and_swap(&mutex->state, 0, 1);
+    if (state == 0) {
+        return;
+    }
+    // Mark the mutex as waited on before waiting, so the unlock wakes a waiter
+    if (state != 2) {
+        state = exchange(&mutex->state, 2);
+    }
+    while (state != 0) {
+        sysfutexwait((int *) &mutex->state, 2);
+        state = exchange(&mutex->state, 2);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Locks the given mutex only if it is unlocked.
+ *
+ * @return 1 if the mutex was locked, 0 if it was already locked
+ *-----------------------------------------------------------------------------------
+ */
+int mutex_trylock(mutex_t *mutex) {
+    return compare_and_swap(&mutex->state, 0, 1) == 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unlocks the given mutex, held by the caller, and wakes a waiting process if there
+ * may be one.
+ *-----------------------------------------------------------------------------------
+ */
+void mutex_unlock(mutex_t *mutex) {
+    if (fetch_add(&mutex->state, -1) != 1) {
+        mutex->state = 0;
+        sysfutexwake((int *) &mutex->state, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given semaphore to the given count.
+ *-----------------------------------------------------------------------------------
+ */
+void sem_init(semaphore_t *sem, int count) {
+    sem->count = count;
+    sem->waiters = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Decrements the count of the given semaphore, waiting for it to become positive
+ * first.
+ *-----------------------------------------------------------------------------------
+ */
+void sem_wait(semaphore_t *sem) {
+    while (!sem_trywait(sem)) {
+        fetch_add(&sem->waiters, 1);
+        // Returns at once if a post raced in before the wait
+        sysfutexwait((int *) &sem->count, 0);
+        fetch_add(&sem->waiters, -1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Decrements the count of the given semaphore only if it is positive.
+ *
+ * @return 1 if the count was decremented, 0 if it was not positive
+ *-----------------------------------------------------------------------------------
+ */
+int sem_trywait(semaphore_t *sem) {
+    int count = sem->count;
+    while (count > 0) {
+        int seen = compare_and_swap(&sem->count, count, count - 1);
+        if (seen == count) {
+            return 1;
+        }
+        count = seen;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Increments the count of the given semaphore, and wakes a waiting process if there
+ * may be one.
+ *-----------------------------------------------------------------------------------
+ */
+void sem_post(semaphore_t *sem) {
+    fetch_add(&sem->count, 1);
+    if (sem->waiters > 0) {
+        sysfutexwake((int *) &sem->count, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given condition variable with no waiters.
+ *-----------------------------------------------------------------------------------
+ */
+void cond_init(cond_t *cond) {
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Unlocks the given mutex, held by the caller, waits for the given condition
+ * variable to be signalled, and locks the mutex again.
+ *-----------------------------------------------------------------------------------
+ */
+void cond_wait(cond_t *cond, mutex_t *mutex) {
+    int seq = cond->seq;
+    fetch_add(&cond->waiters, 1);
+    mutex_unlock(mutex);
+    // Returns at once if a signal advanced the sequence number since it was read
+    sysfutexwait((int *) &cond->seq, seq);
+    fetch_add(&cond->waiters, -1);
+    // Other waiters may have been woken too, so take the mutex as waited on
+    while (exchange(&mutex->state, 2) != 0) {
+        sysfutexwait((int *) &mutex->state, 2);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Wakes one of the processes waiting on the given condition variable, if any.
+ *-----------------------------------------------------------------------------------
+ */
+void cond_signal(cond_t *cond) {
+    fetch_add(&cond->seq, 1);
+    if (cond->waiters > 0) {
+        sysfutexwake((int *) &cond->seq, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Wakes all of the processes waiting on the given condition variable.
+ *-----------------------------------------------------------------------------------
+ */
+void cond_broadcast(cond_t *cond) {
+    fetch_add(&cond->seq, 1);
+    if (cond->waiters > 0) {
+        sysfutexwake((int *) &cond->seq, MAX_PROCESSES);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Atomically stores the given value at the given address if it holds the expected
+ * value.
+ *
+ * @return The value the address held
+ *-----------------------------------------------------------------------------------
+ */
+int compare_and_swap(volatile int *ptr, int expected, int value) {
+    int prev;
+    __asm__ volatile("lock; cmpxchgl %2, %1;"
+            : "=a" (prev), "+m" (*ptr)
+            : "r" (value), "0" (expected)
+            : "memory");
+    return prev;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Atomically stores the given value at the given address.
+ *
+ * @return The value the address held
+ *-----------------------------------------------------------------------------------
+ */
+int exchange(volatile int *ptr, int value) {
+    __asm__ volatile("xchgl %0, %1;" : "+r" (value), "+m" (*ptr) : : "memory");
+    return value;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Atomically adds the given value to the integer at the given address.
+ *
+ * @return The value the address held before the addition
+ *-----------------------------------------------------------------------------------
+ */
+int fetch_add(volatile int *ptr, int value) {
+    __asm__ volatile("lock; xaddl %0, %1;" : "+r" (value), "+m" (*ptr) : : "memory");
+    return value;
+}
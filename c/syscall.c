@@ -10,7 +10,29 @@
  * steps needed to transition to the kernel which will perform the
  * corresponding task on behalf of the calling process.
  *
+ * Notes on fast system calls:
+ * - Calls that neither block nor reschedule, such as sysgetpid and querying the
+ *   priority with syssetprio, go through fastcall instead of syscall
+ * - fastcall passes the request and its single argument in registers (%eax and
+ *   %edx) and raises FAST_SYSCALL_INTERRUPT_NUMBER, which is serviced by
+ *   fast_dispatch on the stack of the process, skipping the context switch, the
+ *   dispatcher and the delivery of signals
+ *
+ * Notes on preemptible system calls:
+ * - Calls that may run long, such as sysgetcputimes, go through preemptcall, which
+ *   raises PREEMPTIBLE_SYSCALL_INTERRUPT_NUMBER the same way. They are serviced by
+ *   preemptible_dispatch on the stack of the process with interrupts enabled, so
+ *   the process may be pre-empted part way through the call
+ * - sysread, syswrite, syssendv and sysrecvv pass their arguments in a
+ *   preempt_args_t. What cannot be done without blocking comes back as
+ *   PREEMPT_DISPATCH, and the stub makes the rest of the call through syscall
+ *
  * List of functions that are called from outside this file:
+ * - fastcall
+ *   - Makes a system call that returns without entering the dispatcher
+ * - preemptcall
+ *   - Makes a system call that is serviced on the stack of the process and may be
+ *     pre-empted
  * - syscreate
  *   - Creates a new process, returns the process ID of the created process,
  *     -1 if create was unsuccessful
@@ -59,9 +81,136 @@
  *     descriptor
  * - sysioctl
  *   - Executes the specified control command
+ * - sysgetmemstats
+ *   - Fills a given mem_stats_t structure with the memory allocator statistics
+ * - sysalloc
+ *   - Allocates memory from the arena of the process
+ * - syssetquantum
+ *   - Sets the quantum of the process, returns the previous quantum or -1 if the
+ *     requested quantum is out of range
+ * - syssetrealtime
+ *   - Places the process in the real-time class, returns 0 on success, -1 if the
+ *     arguments are invalid or -2 if the process was not admitted
+ * - syssettickets
+ *   - Sets the tickets of the process, returns the previous number of tickets or -1
+ *     if the requested number is out of range
+ * - sysgetsyscallstats
+ *   - Fills a given syscall_stats_t structure with the statistics of a system call
+ * - sysclock
+ *   - Reads the monotonic clock in microseconds
+ * - sysusleep
+ *   - Sleeps for a requested number of microseconds, woken within the time slice
+ *     the sleep ends in
+ * - syssendtim
+ *   - Sends an unsigned long integer message, giving up after a timeout
+ * - sysrecvtim
+ *   - Receives an unsigned long integer message, giving up after a timeout
+ * - systimer
+ *   - Arms a kernel timer that delivers a signal to a process, returns the
+ *     identifier of the timer
+ * - systimercancel
+ *   - Stops a kernel timer armed by the process
+ * - syssettimerslack
+ *   - Sets how much later the sleeps and timeouts of the process may expire, returns
+ *     the previous slack or -1 if the requested slack is out of range
+ * - syssendv
+ *   - Sends a message of up to MAX_MESSAGE_SIZE bytes
+ * - sysrecvv
+ *   - Receives a message of up to MAX_MESSAGE_SIZE bytes
+ * - sysrpc
+ *   - Sends a request and receives the reply in a single system call
+ * - sysreplywait
+ *   - Replies to a client and receives the next request in a single system call
+ * - sysportcreate
+ *   - Creates a message port, returns its identifier or -1
+ * - sysportdestroy
+ *   - Destroys a message port created by the process
+ * - sysportsend
+ *   - Places a message in a message port, blocking only if it is full
+ * - sysportrecv
+ *   - Takes a message from a message port, blocking only if it is empty
+ * - sysrecvset
+ *   - Receives an unsigned long integer message from any process in a set
+ * - syssendbatch
+ *   - Sends several unsigned long integer messages, to one or more processes
+ * - sysrecvbatch
+ *   - Receives the messages of several processes waiting to send
+ * - sysshmcreate
+ *   - Creates a shared memory segment, returns its identifier or -1
+ * - sysshmattach
+ *   - Attaches a shared memory segment, returns its address or NULL
+ * - sysshmdetach
+ *   - Detaches a shared memory segment held by the process
+ * - sysfutexwait
+ *   - Waits on an integer for as long as it holds an expected value
+ * - sysfutexwake
+ *   - Wakes processes waiting on an integer
+ * - syspoll
+ *   - Waits for input on file descriptors, a process waiting to send, or a timeout
+ * - syssigprocmask
+ *   - Changes the signals the process holds pending instead of handling
+ * - syssigqueue
+ *   - Queues a signal carrying a value for delivery to a process
+ * - sysaioread
+ *   - Starts a read from a device that completes with a signal
+ * - systracectl
+ *   - Sets the categories of events recorded in the kernel trace buffer
+ * - systraceread
+ *   - Copies events from the kernel trace buffer
+ * - sysprofstart
+ *   - Starts the sampling profiler
+ * - sysprofstop
+ *   - Stops the sampling profiler
+ * - sysprofread
+ *   - Copies the histogram of the sampling profiler
+ * - syslogctl
+ *   - Sets the level of the records made in the kernel log
+ * - syslogread
+ *   - Takes records out of the kernel log
+ * - sysgetlatency
+ *   - Fills a given latency_stats_t structure with the time the kernel ran with
+ *     interrupts disabled after a request, and how late it handled the PIT tick
+ * - sysgetipcstats
+ *   - Fills a given ipc_stats_t structure with the waits on the queues of senders
+ *     and receivers of a process
+ * - syscreatethread
+ *   - Creates a thread that shares the signal handlers and file descriptors of
+ *     the process, returns its process ID, -1 if it could not be created
+ * - sysspawn
+ *   - Creates a process that is passed an argument block, at a given priority and
+ *     with a given stack, and optionally the open file descriptors of the caller,
+ *     returns its process ID or why it could not be created
+ * - sysexit
+ *   - Terminates the calling process with an exit status for its parent
+ * - syswaitany
+ *   - Waits for any child, or any of a set of children, to terminate, returns its
+ *     process ID and exit status
+ * - syssetpgid
+ *   - Moves the process or a child to a process group, or makes a new group
+ * - sysgetpgid
+ *   - Returns the process group of a process
+ * - syskillpg
+ *   - Sends a signal to every process of a process group
+ * - syswaitpg
+ *   - Waits for any child in a process group to terminate, as syswaitany
+ * - syssetaffinity
+ *   - Sets the processors a process may run on
+ * - sysgetaffinity
+ *   - Returns the processors a process may run on
+ * - sysringsetup
+ *   - Registers a submission ring and a completion ring in the memory of the process
+ * - sysringenter
+ *   - Carries out the operations queued on the submission ring, posting their
+ *     completions, with one system call
+ * - sysrunwork
+ *   - Runs the deferred work of the ISRs, for the work process
+ * - syswaitwork
+ *   - Waits for deferred work to be queued, for the work process
  *-----------------------------------------------------------------------------------
  */
 
+static int preemptible_io(int call, int fd, void *buf, int buflen);
+
 /*-----------------------------------------------------------------------------------
  * Takes a system request identifier and arguments for the system call.
  * Each system call (i.e. syscreate(), sysyield(), and sysstop()) will
@@ -102,6 +251,70 @@ int syscall(int call, ...) {
     return return_value;
 }
 
+/*-----------------------------------------------------------------------------------
+ * Takes a system request identifier and a single argument, and makes a system call
+ * that is serviced without entering the dispatcher. Only calls that neither block
+ * nor reschedule are serviced this way.
+ *
+ * @param call A system request identifier, SYSGETPID or SYSSETPRIO
+ * @param arg  The argument of the system call, passed in a register
+ * @return     The result of the call, or -1 if the call cannot be serviced
+ *-----------------------------------------------------------------------------------
+ */
+int fastcall(int call, int arg) {
+    int return_value;
+
+/*-----------------------------------------------------------------------------------
+ * In-line asm:
+ *     Store the value of call in %eax and the argument in %edx
+ *     Execute an interrupt instruction to enter the fast path of the kernel
+ *     Upon return from the kernel, the result is in register %eax, and %edx is
+ *     whatever the C code servicing the call left in it
+ *-----------------------------------------------------------------------------------
+ */
+    __asm__ __volatile__(
+    "int $68;"
+    : "=a" (return_value), "+d" (arg)
+    : "a" (call)
+    : "%ecx", "memory"
+    );
+
+    return return_value;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Takes a system request identifier and a single argument, and makes a system call
+ * that is serviced on the stack of the calling process with interrupts enabled, so
+ * a long call does not hold off the interrupts and the other processes.
+ *
+ * @param call A system request identifier, SYSGETCPUTIMES, SYSRUNWORK, or SYSREAD,
+ *             SYSWRITE, SYSSENDV or SYSRECVV with a preempt_args_t
+ * @param arg  The argument of the system call, passed in a register
+ * @return     The result of the call, PREEMPT_DISPATCH if the rest of the call is
+ *             to be made through syscall, or -1 if the call cannot be serviced
+ *-----------------------------------------------------------------------------------
+ */
+int preemptcall(int call, int arg) {
+    int return_value;
+
+/*-----------------------------------------------------------------------------------
+ * In-line asm:
+ *     Store the value of call in %eax and the argument in %edx
+ *     Execute an interrupt instruction to enter the preemptible path of the kernel
+ *     Upon return from the kernel, the result is in register %eax, and %edx is
+ *     whatever the C code servicing the call left in it
+ *-----------------------------------------------------------------------------------
+ */
+    __asm__ __volatile__(
+    "int $69;"
+    : "=a" (return_value), "+d" (arg)
+    : "a" (call)
+    : "%ecx", "memory"
+    );
+
+    return return_value;
+}
+
 /*-----------------------------------------------------------------------------------
  * Generates a system call to create a new process.
  *
@@ -139,7 +352,7 @@ void sysstop(void) {
  *-----------------------------------------------------------------------------------
  */
 PID_t sysgetpid(void) {
-    return syscall(SYSGETPID);
+    return fastcall(SYSGETPID, 0);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -174,8 +387,9 @@ int syskill(int pid, int signal_number) {
 /*-----------------------------------------------------------------------------------
  * Generates a system call which allows a process to set its priority.
  *
- * @param priority The requested priority, from 0 to 3 with 3 being the
- *                 lowest priority and 0 being the highest priority
+ * @param priority The requested priority, from 0 to NUM_PRIORITIES - 1 with
+ *                 NUM_PRIORITIES - 1 being the lowest priority and 0 being
+ *                 the highest priority
  * @return         -1 if the call failed because the requested priority
  *                 was out of range, otherwise it returns the priority the
  *                 process had when this call was made. There is one
@@ -186,6 +400,9 @@ int syskill(int pid, int signal_number) {
  *-----------------------------------------------------------------------------------
  */
 int syssetprio(int priority) {
+    if (priority == -1) {
+        return fastcall(SYSSETPRIO, priority);
+    }
     return syscall(SYSSETPRIO, priority);
 }
 
@@ -260,16 +477,19 @@ unsigned int syssleep(unsigned int milliseconds) {
  * Generates a system call to fill the given ps table starting with table element 0.
  * For each process the PID, current process state and the number of milliseconds
  * that have been charged to the process are recorded. Process 0 is always reported
- * and it is the NULL/idle process.
+ * in the last slot used and it is the NULL/idle process. The caller sets the size
+ * of the table, if there are more processes than fit only the first ones are
+ * reported, and the number of processes in the system is recorded in the table.
  *
- * @param ps A pointer to a processStatuses structure
+ * @param ps A pointer to a processStatuses structure with its size set
  * @return   The last slot used on success
  *           -1 if the given address is in the hole
- *           -2 if the structure being pointed to goes beyond the end of main memory
+ *           -2 if the structure being pointed to goes beyond the end of main memory,
+ *           or the size is out of range
  *-----------------------------------------------------------------------------------
  */
 int sysgetcputimes(processStatuses *ps) {
-    return syscall(SYSGETCPUTIMES, ps);
+    return preemptcall(SYSGETCPUTIMES, (int) ps);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -312,7 +532,8 @@ void syssigreturn(void *old_sp) {
 
 /*-----------------------------------------------------------------------------------
  * Generates a system call that causes the calling process to wait for the process
- * with PID to terminate.
+ * with PID to terminate. Once it returns, the stack and memory of the process have
+ * been freed.
  *
  * @param  pid The PID of the process to wait for termination
  * @return 0 if the call terminates normally
@@ -330,8 +551,8 @@ int syswait(int pid) {
  * device table.
  *
  * @param device_no The major device number
- * @return          A file descriptor in the range 0 to 3 (inclusive) on success,
- *                  -1 if the open fails
+ * @return          A file descriptor in the range 0 to MAX_FDS - 1 (inclusive) on
+ *                  success, -1 if the open fails
  *-----------------------------------------------------------------------------------
  */
 int sysopen(int device_no) {
@@ -362,7 +583,7 @@ int sysclose(int fd) {
  *-----------------------------------------------------------------------------------
  */
 int syswrite(int fd, void *buf, int buflen) {
-    return syscall(SYSWRITE, buf, buflen);
+    return preemptible_io(SYSWRITE, fd, buf, buflen);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -376,6 +597,7 @@ int syswrite(int fd, void *buf, int buflen) {
  * @return       The number of bytes read on success
  *               0 to indicate end-of-file (EOF)
  *               -1 if there was an error
+ *               BLOCKERR if fd is in non-blocking mode and no bytes are available
  *
  *               If interrupted by a signal:
  *                 The number of bytes read if the number of bytes read is non-zero
@@ -383,13 +605,40 @@ int syswrite(int fd, void *buf, int buflen) {
  *-----------------------------------------------------------------------------------
  */
 int sysread(int fd, void *buf, int buflen) {
-    return syscall(SYSREAD, fd, buf, buflen);
+    return preemptible_io(SYSREAD, fd, buf, buflen);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Makes a sysread or syswrite through preemptcall, which moves what it can without
+ * blocking, and the rest of it through syscall.
+ *
+ * @param call   SYSREAD or SYSWRITE
+ * @param fd     The provided file descriptor
+ * @param buf    The buffer to read into or write from
+ * @param buflen The upper limit of bytes to move
+ * @return       The result of the call, with the bytes moved through preemptcall
+ *               counted in
+ *-----------------------------------------------------------------------------------
+ */
+static int preemptible_io(int call, int fd, void *buf, int buflen) {
+    preempt_args_t req = {{fd, (int) buf, buflen}, 0};
+    int result = preemptcall(call, (int) &req);
+    if (result != PREEMPT_DISPATCH) {
+        return result;
+    }
+    result = syscall(call, fd, (char *) buf + req.done, buflen - req.done);
+    if (req.done == 0) {
+        return result;
+    }
+    // The bytes already moved are kept whatever the rest of the call returns
+    return result > 0 ? req.done + result : req.done;
 }
 
 /*-----------------------------------------------------------------------------------
  * Generates a system call to execute the specified control command. The action taken
  * is device specific and depends upon the control command. Additional parameters are
- * device specific.
+ * device specific. IOCTL_NONBLOCK_ON and IOCTL_NONBLOCK_OFF apply to any device, and
+ * make reads of fd return BLOCKERR instead of blocking, or block again.
  *
  * @param fd      The provided file descriptor
  * @param command The control command
@@ -407,3 +656,938 @@ int sysioctl(int fd, unsigned long command, ...) {
 
     return return_value;
 }
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to fill the given structure with the live statistics of
+ * the kernel memory allocator.
+ *
+ * @param stats A pointer to a mem_stats_t structure
+ * @return      0 on success, -1 if the structure is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetmemstats(mem_stats_t *stats) {
+    return syscall(SYSGETMEMSTATS, stats);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to allocate memory from the arena of the calling process.
+ * Memory allocated this way cannot be freed individually, it is all released when
+ * the process terminates.
+ *
+ * @param size The number of bytes to allocate
+ * @return     A pointer to the allocated memory, aligned to a paragraph, on success,
+ *             NULL if the size is invalid or not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *sysalloc(size_t size) {
+    return (void *) syscall(SYSALLOC, size);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the quantum of the calling process, the time it
+ * runs before it is rotated to the end of its ready queue. The quantum is rounded
+ * up to a whole number of time slices and the new quantum starts immediately.
+ *
+ * @param milliseconds The quantum in milliseconds, from 1 to MAX_PROCESS_QUANTUM,
+ *                     or 0 to use the quantum of the priority of the process
+ * @return             The previous quantum of the process in milliseconds, 0 if it
+ *                     used the quantum of its priority, or -1 if the requested
+ *                     quantum is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int syssetquantum(int milliseconds) {
+    return syscall(SYSSETQUANTUM, milliseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to place the calling process in the real-time class, in
+ * which it is guaranteed budget milliseconds of processor time in every period.
+ * Real-time processes are scheduled earliest deadline first, ahead of all other
+ * processes, and are not run again in a period once they have used up its budget.
+ *
+ * @param period The period in milliseconds, from 1 to MAX_REALTIME_PERIOD, or 0
+ *               to leave the real-time class
+ * @param budget The budget in milliseconds, from 1 to period
+ * @return       0 on success, -1 if the period or budget is invalid, or -2 if the
+ *               total utilization of the real-time processes would exceed 100%
+ *-----------------------------------------------------------------------------------
+ */
+int syssetrealtime(int period, int budget) {
+    return syscall(SYSSETREALTIME, period, budget);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the number of tickets of the calling process.
+ * Under the stride scheduler every process receives a share of the processor
+ * proportional to its tickets, otherwise the tickets have no effect.
+ *
+ * @param tickets The number of tickets, from 1 to MAX_TICKETS
+ * @return        The previous number of tickets of the process, or -1 if the
+ *                requested number is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int syssettickets(int tickets) {
+    return syscall(SYSSETTICKETS, tickets);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to retrieve the statistics the system call table keeps for
+ * the given system call: the number of times it was serviced and a histogram of the
+ * processor cycles it took.
+ *
+ * @param call  The system request identifier, such as SYSCREATE
+ * @param stats A pointer to a syscall_stats_t structure that is filled in
+ * @return      0 on success, -1 if no system call is registered with the given
+ *              identifier, or -2 if the structure is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetsyscallstats(int call, syscall_stats_t *stats) {
+    return syscall(SYSGETSYSCALLSTATS, call, stats);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to read the monotonic clock, which has microsecond
+ * resolution and never goes back.
+ *
+ * @param microseconds A pointer to where the number of microseconds since the
+ *                     kernel started is stored
+ * @return             0 on success, or -1 if the pointer is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysclock(unsigned long long *microseconds) {
+    return syscall(SYSCLOCK, microseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to sleep for the requested number of microseconds. The
+ * process is blocked on the timing wheel until the time slice the sleep ends in,
+ * and then woken by a one-shot of the PIT within that time slice, so it does not
+ * wait for the next tick and takes no processor time while it sleeps.
+ *
+ * @param microseconds The number of microseconds to sleep for
+ * @return             0 if the process slept for the time requested, otherwise
+ *                     the number of milliseconds it still had to sleep when it
+ *                     was woken up by a signal
+ *-----------------------------------------------------------------------------------
+ */
+unsigned int sysusleep(unsigned int microseconds) {
+    return syscall(SYSUSLEEP, microseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to send an unsigned long integer message, like syssend,
+ * but gives up if the matching receive is not performed within the given number
+ * of milliseconds. The timeout is rounded up to whole time slices, so a timeout of
+ * 0 still waits until the next clock tick.
+ *
+ * @param dest_pid     The PID of the receiving process
+ * @param num          The integer to send
+ * @param milliseconds The number of milliseconds to wait for the matching receive
+ * @return             The results of syssend, or TIMEOUT (−3) if the timeout
+ *                     expired before the matching receive was performed
+ *-----------------------------------------------------------------------------------
+ */
+int syssendtim(unsigned int dest_pid, unsigned long num, unsigned int milliseconds) {
+    return syscall(SYSSENDTIM, dest_pid, num, milliseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to receive an unsigned long integer message, like
+ * sysrecv, but gives up if the matching send is not performed within the given
+ * number of milliseconds. The timeout is rounded up to whole time slices, so a
+ * timeout of 0 still waits until the next clock tick.
+ *
+ * @param from_pid     The address containing the PID of the sending process, 0 to
+ *                     receive from any process
+ * @param num          The address to store the received value into
+ * @param milliseconds The number of milliseconds to wait for the matching send
+ * @return             The results of sysrecv, or TIMEOUT (−3) if the timeout
+ *                     expired before the matching send was performed
+ *-----------------------------------------------------------------------------------
+ */
+int sysrecvtim(unsigned int *from_pid, unsigned int *num, unsigned int milliseconds) {
+    return syscall(SYSRECVTIM, from_pid, num, milliseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to arm a kernel timer, which delivers the given signal to
+ * the given process when it expires, as syskill would. The timer is kept by the
+ * kernel, so no process has to sleep for it. Times are rounded up to whole time
+ * slices.
+ *
+ * @param pid           The PID of the process to deliver the signal to
+ * @param signal_number The number of the signal to be delivered (ie. 0 to 31)
+ * @param milliseconds  The number of milliseconds until the timer first expires
+ * @param period        The number of milliseconds between the later expiries of a
+ *                      periodic timer, which are counted from when the timer was
+ *                      due so they do not drift, or 0 for a one-shot timer
+ * @return              The identifier of the timer on success
+ *                      -1 if every kernel timer is in use
+ *                      -514 if the target process does not exist
+ *                      -583 if the signal number is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int systimer(int pid, int signal_number, unsigned int milliseconds, unsigned int period) {
+    return syscall(SYSTIMER, pid, signal_number, milliseconds, period);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to stop a kernel timer armed by the calling process. A
+ * one-shot timer that has expired is stopped already, and its identifier may have
+ * been given to another timer.
+ *
+ * @param timer_id The identifier returned by systimer
+ * @return         0 on success, or -1 if no such timer is armed by the process
+ *-----------------------------------------------------------------------------------
+ */
+int systimercancel(int timer_id) {
+    return syscall(SYSTIMERCANCEL, timer_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the timer slack of the calling process, the time
+ * its sleeps and IPC timeouts may be extended by so that they expire on the same
+ * clock tick as those of other processes. Wakeups that would fall on nearby ticks
+ * are then serviced together. The slack is rounded up to whole time slices.
+ *
+ * @param milliseconds The slack in milliseconds, from 0 to MAX_TIMER_SLACK, 0 to
+ *                     expire on the earliest tick
+ * @return             The previous slack of the process in milliseconds, or -1 if
+ *                     the requested slack is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int syssettimerslack(unsigned int milliseconds) {
+    return syscall(SYSSETTIMERSLACK, milliseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to send a message of the given length. This call blocks
+ * until the send operation completes. The message is copied straight into the
+ * buffer of the receiver, and is truncated if the buffer is shorter. A receiver
+ * using sysrecv receives the first BUFFER_SIZE bytes.
+ *
+ * @param dest_pid The PID of the receiving process
+ * @param buf      The message
+ * @param len      The length of the message in bytes, from 1 to MAX_MESSAGE_SIZE
+ * @return         The number of bytes delivered on success, or the errors of
+ *                 syssend, and:
+ *                   - −4 if the message is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int syssendv(unsigned int dest_pid, void *buf, unsigned int len) {
+    // A receiver that already waits is copied to without entering the dispatcher
+    preempt_args_t req = {{dest_pid, (int) buf, len}, 0};
+    int result = preemptcall(SYSSENDV, (int) &req);
+    return result != PREEMPT_DISPATCH ? result : syscall(SYSSENDV, dest_pid, buf, len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to receive a message into a buffer of the given length.
+ * A longer message is truncated to the buffer, a sender using syssend delivers
+ * BUFFER_SIZE bytes.
+ *
+ * @param from_pid The address containing the PID of the sending process, 0 to
+ *                 receive from any process
+ * @param buf      The buffer to receive the message into
+ * @param len      The length of the buffer in bytes, from 1 to MAX_MESSAGE_SIZE
+ * @return         The number of bytes received on success, or the errors of
+ *                 sysrecv, where −4 also means the length is out of range
+ *-----------------------------------------------------------------------------------
+ */
+int sysrecvv(unsigned int *from_pid, void *buf, unsigned int len) {
+    // A sender that already waits is copied from without entering the dispatcher
+    preempt_args_t req = {{(int) from_pid, (int) buf, len}, 0};
+    int result = preemptcall(SYSRECVV, (int) &req);
+    return result != PREEMPT_DISPATCH ? result : syscall(SYSRECVV, from_pid, buf, len);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to send a request to a server and receive its reply, in
+ * a single system call. This is the same as a syssend followed by a sysrecv from
+ * the server, and the server may receive the request and reply with either
+ * sysrecv and syssend or sysreplywait.
+ *
+ * @param dest_pid The PID of the server
+ * @param request  The request to send
+ * @param reply    The address to store the reply into
+ * @return         0 on success and a negative value if the operation failed:
+ *                   - −1 if the server terminates before it replies
+ *                   - −2 if the server does not exist
+ *                   - −3 if the process tries to call itself
+ *                   - −4 if reply is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int sysrpc(unsigned int dest_pid, unsigned long request, unsigned long *reply) {
+    return syscall(SYSRPC, dest_pid, request, reply);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to reply to a client and receive the next request from
+ * any process, in a single system call. The reply is delivered if the client is
+ * waiting to receive from the server, as it is in sysrpc, and is dropped otherwise.
+ *
+ * @param client_pid The address containing the PID of the client to reply to, 0 to
+ *                   only receive, in which the PID of the next client is stored
+ * @param reply      The reply to send
+ * @param request    The address to store the next request into
+ * @return           0 on success and a negative value if the operation failed:
+ *                     - −4 if request is invalid
+ *                     - −5 if client_pid is invalid
+ *                     - −10 if the server is the only user process
+ *-----------------------------------------------------------------------------------
+ */
+int sysreplywait(unsigned int *client_pid, unsigned long reply, unsigned long *request) {
+    return syscall(SYSREPLYWAIT, client_pid, reply, request);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to create a message port, which buffers up to PORT_SLOTS
+ * unsigned long messages so senders do not wait for receivers. Any process may
+ * send to and receive from the port, which lasts until it is destroyed by the
+ * calling process or the calling process terminates.
+ *
+ * @return The identifier of the port, or -1 if no port could be created
+ *-----------------------------------------------------------------------------------
+ */
+int sysportcreate(void) {
+    return syscall(SYSPORTCREATE);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to destroy a message port created by the calling
+ * process. The processes waiting on the port return -1, and the messages left in
+ * the port are lost.
+ *
+ * @param port The identifier of the port
+ * @return     0 on success, or -1 if the port does not exist or was not created by
+ *             the calling process
+ *-----------------------------------------------------------------------------------
+ */
+int sysportdestroy(int port) {
+    return syscall(SYSPORTDESTROY, port);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to send an unsigned long integer message to a message
+ * port. The call returns at once unless the port is full, in which case it blocks
+ * until a slot is freed by a receive.
+ *
+ * @param port The identifier of the port
+ * @param num  The integer to send
+ * @return     0 on success and a negative value if the operation failed:
+ *               - −1 if the port is destroyed while the process waits
+ *               - −2 if the port does not exist
+ *-----------------------------------------------------------------------------------
+ */
+int sysportsend(int port, unsigned long num) {
+    return syscall(SYSPORTSEND, port, num);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to receive the oldest unsigned long integer message of a
+ * message port. The call returns at once unless the port is empty, in which case
+ * it blocks until a message is sent.
+ *
+ * @param port The identifier of the port
+ * @param num  The address to store the received value into
+ * @return     0 on success and a negative value if the operation failed:
+ *               - −1 if the port is destroyed while the process waits
+ *               - −2 if the port does not exist
+ *               - −4 if num is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int sysportrecv(int port, unsigned long *num) {
+    return syscall(SYSPORTRECV, port, num);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to receive an unsigned long integer message from any of
+ * the processes in the given set. This is the same as a sysrecv from any process,
+ * except that messages from processes outside the set are left waiting.
+ *
+ * @param from_pid The address to store the PID of the sending process into
+ * @param num      The address to store the received value into
+ * @param pids     The PIDs of the processes to receive from, the PIDs of processes
+ *                 that do not exist are ignored
+ * @param count    The number of PIDs in the set, from 1 to MAX_RECV_SET
+ * @return         0 on success, or the errors of sysrecv, and:
+ *                   - −1 if every process in the set terminates before sending
+ *                   - −2 if none of the processes in the set exist
+ *                   - −3 if the set contains the receiving process
+ *                   - −6 if the set is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int sysrecvset(unsigned int *from_pid, unsigned int *num, unsigned int *pids, int count) {
+    return syscall(SYSRECVSET, from_pid, num, pids, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sends the given messages in order, each as a syssend would. Messages to processes
+ * waiting for them are delivered within a single system call, another system call
+ * is only made after the process blocks on a message whose receiver is not yet
+ * waiting.
+ *
+ * @param msgs  The messages, the result of each is stored with it:
+ *                - 0 on success
+ *                - The errors of syssend otherwise
+ * @param count The number of messages, from 1 to MAX_BATCH
+ * @return      The number of messages delivered, or −4 if the messages are invalid
+ *-----------------------------------------------------------------------------------
+ */
+int syssendbatch(send_batch_entry_t *msgs, int count) {
+    int done = 0;
+    do {
+        int result = syscall(SYSSENDBATCH, msgs + done, count - done);
+        if (result == -4) {
+            return result;
+        }
+        // The kernel stops at the message it blocked on, the only one left pending
+        // before the messages it has not reached, and returns the result of its send
+        while (done < count && msgs[done].result != BATCH_PENDING) {
+            done++;
+        }
+        if (done < count) {
+            msgs[done++].result = result;
+        }
+    } while (done < count);
+
+    int delivered = 0;
+    for (int i = 0; i < count; i++) {
+        if (msgs[i].result == 0) {
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to receive the messages of up to the given number of
+ * processes waiting to send to the process, earliest first. If no process is
+ * waiting, the call blocks until one sends, as a sysrecv from any process would.
+ *
+ * @param msgs  Where the messages and the PIDs of their senders are stored
+ * @param count The most messages to receive, from 1 to MAX_BATCH
+ * @return      The number of messages received on success, or:
+ *                - −4 if the messages are invalid
+ *                - −10 if the process is the only user process
+ *                - −666 if a signal interrupts the wait for the first message
+ *-----------------------------------------------------------------------------------
+ */
+int sysrecvbatch(recv_batch_entry_t *msgs, int count) {
+    int result = syscall(SYSRECVBATCH, msgs, count);
+    // A call that had to wait for the first message returns 0
+    return result == 0 ? 1 : result;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to create a zeroed shared memory segment, held by the
+ * calling process. Other processes attach it with the identifier returned.
+ *
+ * @param size The size of the segment in bytes, rounded up to a power of 2 pages
+ * @return     The identifier of the segment on success, -1 if the size is invalid
+ *             or not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+int sysshmcreate(size_t size) {
+    return syscall(SYSSHMCREATE, size);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to attach a shared memory segment. The segment is at the
+ * same address in every process that attaches it.
+ *
+ * @param shm_id The identifier of the segment
+ * @return       A pointer to the page aligned start of the segment on success, NULL
+ *               if the segment does not exist
+ *-----------------------------------------------------------------------------------
+ */
+void *sysshmattach(int shm_id) {
+    return (void *) syscall(SYSSHMATTACH, shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to detach a shared memory segment. The segment is freed
+ * when the last process holding it detaches it or terminates, and must not be used
+ * after it is detached.
+ *
+ * @param shm_id The identifier of the segment
+ * @return       0 on success, -1 if the segment does not exist or is not held by
+ *               the process
+ *-----------------------------------------------------------------------------------
+ */
+int sysshmdetach(int shm_id) {
+    return syscall(SYSSHMDETACH, shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to wait on the given integer, if it holds the expected
+ * value, until a process wakes it with sysfutexwake. Used by the primitives of
+ * sync.c when they have to wait.
+ *
+ * @param addr     The address of the integer, aligned to its size
+ * @param expected The value the integer must hold for the process to wait
+ * @return         0 when woken, or:
+ *                   - −2 if the integer does not hold the expected value
+ *                   - −4 if addr is invalid
+ *                   - −666 if a signal interrupts the wait
+ *-----------------------------------------------------------------------------------
+ */
+int sysfutexwait(int *addr, int expected) {
+    return syscall(SYSFUTEXWAIT, addr, expected);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to wake up to the given number of processes waiting on
+ * the given integer, earliest first.
+ *
+ * @param addr  The address of the integer, aligned to its size
+ * @param count The most processes to wake
+ * @return      The number of processes woken, or −4 if addr is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int sysfutexwake(int *addr, int count) {
+    return syscall(SYSFUTEXWAKE, addr, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to wait until any of the given sources is ready: one of
+ * the file descriptors has input to read, or a process waits to send to the caller.
+ * No message or input is consumed, the caller reads from the sources reported
+ * ready.
+ *
+ * @param mask         Bit i set for file descriptor i, and POLL_IPC for a process
+ *                     waiting to send
+ * @param milliseconds The most milliseconds to wait for, 0 to return at once and
+ *                     negative to wait for as long as it takes
+ * @return             - The bits of the mask that are ready, 0 if the wait timed
+ *                       out
+ *                     - −1 if the mask has bits of file descriptors not open or
+ *                       above POLL_IPC
+ *                     - −666 if a signal interrupts the wait
+ *-----------------------------------------------------------------------------------
+ */
+int syspoll(unsigned int mask, int milliseconds) {
+    return syscall(SYSPOLL, mask, milliseconds);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call that changes the signals the process blocks. A blocked
+ * signal stays pending, and does not interrupt a blocked system call, until it is
+ * unblocked. Signal 31 cannot be blocked.
+ *
+ * @param how      SIG_BLOCK to add the signals of mask to the blocked signals,
+ *                 SIG_UNBLOCK to remove them, or SIG_SETMASK to block exactly them
+ * @param mask     Bit i set for signal i
+ * @param old_mask Where the blocked signals before the call are stored, NULL if
+ *                 they are not wanted
+ * @return         0 on success
+ *                 -1 if how is invalid
+ *                 -2 if old_mask is an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int syssigprocmask(int how, int mask, int *old_mask) {
+    return syscall(SYSSIGPROCMASK, how, mask, old_mask);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to queue a signal carrying the given value for delivery
+ * to a process. Unlike syskill, every signal queued is delivered, in the order
+ * queued, and its handler finds the value and the PID of the caller with
+ * signal_info. As with syskill, queuing a signal the process ignores succeeds.
+ *
+ * @param pid           The PID of the process to deliver the signal to
+ * @param signal_number The number of the signal to be delivered (ie. 0 to 31)
+ * @param value         The value the signal carries
+ * @return              0 on success
+ *                      -3 if SIGNAL_QUEUE_SIZE signals are already queued for the
+ *                      process
+ *                      -514 if the target process does not exist
+ *                      -583 if the signal number is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int syssigqueue(int pid, int signal_number, int value) {
+    return syscall(SYSSIGQUEUE, pid, signal_number, value);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to start a read from the device associated with the
+ * provided file descriptor without blocking. The read is serviced like a sysread
+ * while the process runs, and when it completes the given signal is queued for the
+ * process, as with syssigqueue, with the number of bytes read as its value and 0 as
+ * its sender. The buffer must not be used until then.
+ *
+ * @param fd            The provided file descriptor
+ * @param buf           The buffer to read into
+ * @param buflen        The upper limit of bytes to read into buf
+ * @param signal_number The signal to complete the read with, 0 to 30 (inclusive)
+ * @return              0 if the read was started
+ *                      -1 if there was an error, the device does not support
+ *                      asynchronous reads, a read is already in progress, or
+ *                      SIGNAL_QUEUE_SIZE signals are already queued for the process
+ *-----------------------------------------------------------------------------------
+ */
+int sysaioread(int fd, void *buf, int buflen, int signal_number) {
+    return syscall(SYSAIOREAD, fd, buf, buflen, signal_number);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the categories of events recorded in the kernel
+ * trace buffer, any of TRACE_SYSCALL, TRACE_SCHED, TRACE_IPC, TRACE_TIMER and
+ * TRACE_INTR. The events already recorded are kept.
+ *
+ * @param mask The categories to record, 0 to record nothing, or -1 to leave them as
+ *             they are
+ * @return     The categories that were recorded before the call, or -1 if the mask
+ *             has bits that are not a category
+ *-----------------------------------------------------------------------------------
+ */
+int systracectl(int mask) {
+    return syscall(SYSTRACECTL, mask);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to copy events from the kernel trace buffer, oldest first,
+ * starting at the event with the sequence number in the cursor. The cursor is
+ * advanced past the events copied, so calling again with the same cursor returns
+ * only the events recorded since. Events overwritten before they were read are
+ * skipped, the seq of the first event copied tells how many.
+ *
+ * @param cursor A pointer to the sequence number of the next event to read, 0 to
+ *               start from the oldest event in the buffer
+ * @param events The buffer to copy the events into
+ * @param count  The most events to copy
+ * @return       The number of events copied, 0 if there are no new events, or -1 if
+ *               count is negative or either buffer is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int systraceread(unsigned long *cursor, trace_event_t *events, int count) {
+    return syscall(SYSTRACEREAD, cursor, events, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to start the sampling profiler, which counts the address
+ * the sampled processes are interrupted at on every timer interrupt. The histogram
+ * of a previous run is emptied.
+ *
+ * @param pid The PID of the process to sample, 0 to sample every process
+ * @return    0 on success, -1 if there is no process with the given PID
+ *-----------------------------------------------------------------------------------
+ */
+int sysprofstart(int pid) {
+    return syscall(SYSPROFSTART, pid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to stop the sampling profiler. The histogram is kept
+ * until the profiler is started again.
+ *
+ * @return 0 on success, -1 if the profiler was not running
+ *-----------------------------------------------------------------------------------
+ */
+int sysprofstop(void) {
+    return syscall(SYSPROFSTOP);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to copy the histogram of the sampling profiler, whether
+ * or not it is running.
+ *
+ * @param profile A pointer to a profile_t structure that is filled in
+ * @return        0 on success, -1 if the structure is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysprofread(profile_t *profile) {
+    return syscall(SYSPROFREAD, profile);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the most verbose level of the records made in the
+ * kernel log, LOG_ERROR to LOG_DEBUG. Records above LOG_COMPILE_LEVEL are never
+ * made, whatever the level.
+ *
+ * @param level The level, or -1 to leave it as it is
+ * @return      The level before the call, or -1 if the level is not valid
+ *-----------------------------------------------------------------------------------
+ */
+int syslogctl(int level) {
+    return syscall(SYSLOGCTL, level);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to take records out of the kernel log, the earliest made
+ * first. The records are not formatted, the caller formats each with its fmt and
+ * args.
+ *
+ * @param records The buffer to copy the records into
+ * @param count   The most records to copy
+ * @return        The number of records copied, 0 if there are none, or -1 if count
+ *                is negative or the buffer is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int syslogread(log_record_t *records, int count) {
+    return syscall(SYSLOGREAD, records, count);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to retrieve how long the kernel ran with interrupts
+ * disabled after being entered with the given request, and how late the PIT ticks
+ * it held off were handled.
+ *
+ * @param request The request identifier, a system call such as SYSCREATE or an
+ *                interrupt such as TIMER_INT
+ * @param stats   A pointer to a latency_stats_t structure that is filled in
+ * @return        0 on success, -1 if the identifier is out of range, or -2 if the
+ *                structure is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetlatency(int request, latency_stats_t *stats) {
+    return syscall(SYSGETLATENCY, request, stats);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to retrieve how many processes have waited on the queues
+ * of senders and receivers of the given process, how long they waited, and how many
+ * are on the queues now.
+ *
+ * @param pid   The process ID of the process
+ * @param stats A pointer to an ipc_stats_t structure that is filled in
+ * @return      0 on success, -1 if there is no process with the PID, or -2 if the
+ *              structure is at an invalid address
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetipcstats(int pid, ipc_stats_t *stats) {
+    return syscall(SYSGETIPCSTATS, pid, stats);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to create a thread of the process. The thread is scheduled
+ * like a process, but uses the signal handlers and file descriptors of the process
+ * that created it, and is terminated along with it.
+ *
+ * @param func  A function pointer to the address to start execution at
+ * @param stack The size of the stack of the thread in bytes, at least
+ *              MIN_THREAD_STACK_SIZE is allocated
+ * @return      The process ID of the created thread, -1 if it could not be created
+ *-----------------------------------------------------------------------------------
+ */
+PID_t syscreatethread(void (*func)(void), int stack) {
+    return syscall(SYSCREATETHREAD, func, stack);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to create a new process in a single call, with everything
+ * it needs to start. The argument block is copied onto the stack of the new process
+ * and func is called with a pointer to the copy.
+ *
+ * @param func     A function pointer to the address to start execution at
+ * @param args     The argument block
+ * @param args_len The size of the block in bytes, at most SPAWN_MAX_ARGS, 0 to pass
+ *                 args itself to func without a copy
+ * @param attr     The stack size, priority and flags of the new process, NULL for a
+ *                 stack of PROCESS_STACK_SIZE and the priority syscreate gives
+ * @return         The process ID of the created process
+ *                 -1 if the process could not be created
+ *                 -2 if the argument block is too long or at an invalid address
+ *                 -3 if attr is at an invalid address, the priority is out of range
+ *                 or a flag is unknown
+ *-----------------------------------------------------------------------------------
+ */
+PID_t sysspawn(void (*func)(void *arg), void *args, int args_len, spawn_attr_t *attr) {
+    return syscall(SYSSPAWN, func, args, args_len, attr);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to terminate the calling process with the given exit
+ * status, which syswaitany returns to its parent. Returning from the process
+ * function or calling sysstop terminates it with status 0. This call does not
+ * return.
+ *
+ * @param status The exit status
+ *-----------------------------------------------------------------------------------
+ */
+void sysexit(int status) {
+    syscall(SYSEXIT, status);
+    assert(0, "sysexit returned");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call that causes the calling process to wait for a child to
+ * terminate, a child being a process it created with syscreate or sysspawn. Returns
+ * at once with a child that terminated before the call, the oldest first.
+ *
+ * @param pids   The PIDs of the children to wait for, ignored if count is 0
+ * @param count  The number of PIDs, 0 to wait for any child
+ * @param status Where the exit status of the child is stored, given to sysexit or
+ *               EXIT_KILLED if it was killed with signal 31, NULL if not needed
+ * @return       The PID of the child that terminated
+ *               -1 if no child to wait for remains
+ *               -2 if count is out of range or pids or status is at an invalid
+ *               address
+ *               -666 if the call was interrupted by a signal
+ *-----------------------------------------------------------------------------------
+ */
+PID_t syswaitany(PID_t *pids, int count, int *status) {
+    return syscall(SYSWAITANY, pids, count, status);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to move a process to a process group, so it can be
+ * signalled and waited for along with the rest of the group. A process starts in
+ * the group of the process that created it.
+ *
+ * @param pid  The PID of the process to move, the caller or one of its children, 0
+ *             for the caller
+ * @param pgid The ID of the group to move it to, 0 to make a new group with the PID
+ *             of the process as its ID
+ * @return     0 on success
+ *             -1 if the process does not exist or is not the caller or a child of it
+ *             -2 if the group does not exist and cannot be made
+ *-----------------------------------------------------------------------------------
+ */
+int syssetpgid(PID_t pid, PID_t pgid) {
+    return syscall(SYSSETPGID, pid, pgid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to get the process group of a process.
+ *
+ * @param pid The PID of the process, 0 for the caller
+ * @return    The ID of the group, 0 if the process is in none, -1 if the process
+ *            does not exist
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetpgid(PID_t pid) {
+    return syscall(SYSGETPGID, pid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to send a signal to every process of a process group in
+ * one call, the caller included if it is in the group.
+ *
+ * @param pgid          The ID of the group
+ * @param signal_number The signal to send, 31 terminates the processes
+ * @return              The number of processes signalled
+ *                      -514 if the group does not exist
+ *                      -583 if the signal number is invalid
+ *-----------------------------------------------------------------------------------
+ */
+int syskillpg(PID_t pgid, int signal_number) {
+    return syscall(SYSKILLPG, pgid, signal_number);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call that causes the calling process to wait for any of its
+ * children in a process group to terminate, as syswaitany does for any child.
+ *
+ * @param pgid   The ID of the group
+ * @param status Where the exit status of the child is stored, NULL if not needed
+ * @return       The PID of the child that terminated
+ *               -1 if no child in the group remains
+ *               -2 if pgid is 0 or status is at an invalid address
+ *               -666 if the call was interrupted by a signal
+ *-----------------------------------------------------------------------------------
+ */
+PID_t syswaitpg(PID_t pgid, int *status) {
+    return syscall(SYSWAITPG, pgid, status);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to set the processors a process may run on, see the notes
+ * on affinity in disp.c. The processes the process creates from then on inherit the
+ * mask.
+ *
+ * @param pid  The PID of the process, 0 for the caller
+ * @param mask The processors, bit i set if the process may run on processor i
+ * @return     0 on success
+ *             -1 if the process does not exist
+ *             -2 if none of the processors in the mask runs the dispatcher
+ *-----------------------------------------------------------------------------------
+ */
+int syssetaffinity(PID_t pid, unsigned long mask) {
+    return syscall(SYSSETAFFINITY, pid, mask);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to get the processors a process may run on.
+ *
+ * @param pid The PID of the process, 0 for the caller
+ * @return    The processors, bit i set if the process may run on processor i, -1 if
+ *            the process does not exist
+ *-----------------------------------------------------------------------------------
+ */
+int sysgetaffinity(PID_t pid) {
+    return syscall(SYSGETAFFINITY, pid);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to register the given rings, see the notes on submission
+ * rings in disp.c. The process fills in the number of entries and where they are,
+ * and the kernel empties both rings. The rings and their entries must stay in the
+ * memory of the process until other rings are registered.
+ *
+ * @param ring The rings, NULL to remove the rings of the process
+ * @return     0 on success
+ *             -1 if the rings or their entries are at an invalid address
+ *             -2 if the number of entries is not a power of two up to
+ *             IORING_MAX_ENTRIES
+ *-----------------------------------------------------------------------------------
+ */
+int sysringsetup(io_ring_t *ring) {
+    return syscall(SYSRINGSETUP, ring);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to carry out the operations queued on the submission ring
+ * of the given registered rings, in order, and post the completion of each to the
+ * completion ring. An operation is queued by filling in the entry at sq_tail and
+ * advancing sq_tail, and its completion is read at cq_head before cq_head is
+ * advanced past it. Only as many operations are taken as the completion ring has
+ * room for.
+ *
+ * An operation that has to wait blocks the process as its system call would, and
+ * the process makes another call for the operations after it once it wakes up.
+ *
+ * @param ring The registered rings
+ * @return     The number of operations taken from the submission ring
+ *             -1 if the rings are not the ones registered
+ *             -2 if an index of a ring is past its other end
+ *-----------------------------------------------------------------------------------
+ */
+int sysringenter(io_ring_t *ring) {
+    int submitted = 0;
+    while (1) {
+        int taken = 0;
+        int result = syscall(SYSRINGENTER, ring, &taken);
+        if (taken == 0) {
+            return result < 0 ? result : submitted + result;
+        }
+        // The kernel blocked the process on the last operation it took, and left
+        // the completion of the operation for the result the process woke up with
+        ring->cqes[ring->cq_tail & (ring->entries - 1)].result = result;
+        ring->cq_tail++;
+        submitted += taken;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a preemptible system call to run the work items the ISRs deferred, up to
+ * WORK_BUDGET of them, with interrupts enabled between the items. Made by the work
+ * process of workq.c.
+ *
+ * @return The number of items run, 0 if the work queue is empty
+ *-----------------------------------------------------------------------------------
+ */
+int sysrunwork(void) {
+    return preemptcall(SYSRUNWORK, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Generates a system call to wait until a work item is queued, returning at once if
+ * there is one on the work queue. Made by the work process of workq.c.
+ *
+ * @return 0 once there is work to run
+ *-----------------------------------------------------------------------------------
+ */
+int syswaitwork(void) {
+    return syscall(SYSWAITWORK);
+}
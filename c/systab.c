@@ -0,0 +1,163 @@
+/* systab.c : system call table
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the system call table, which maps every system request identifier to the
+ * function servicing it. The dispatcher registers its own system calls in
+ * kdispinit, and drivers and other subsystems may register more during
+ * initialization without changes to the dispatcher.
+ *
+ * Notes on statistics:
+ * - Every system call serviced through the table is counted, and the number of
+ *   processor cycles its service function took, read with rdtsc, is added to a
+ *   histogram of SYSCALL_HISTOGRAM_BUCKETS buckets
+ * - Bucket i counts the calls that took from 2^i to 2^(i + 1) - 1 cycles, calls of
+ *   0 or 1 cycles go in bucket 0 and calls of 2^32 cycles or more in the last
+ *   bucket
+ * - The cycles are those of the service function only, the time spent switching
+ *   contexts and in the dispatcher is not included
+ *
+ * List of functions that are called from outside this file:
+ * - ksystabinit
+ *   - Initializes the system call table with no system calls in it
+ * - register_syscall
+ *   - Registers the function servicing a system call
+ * - service_syscall
+ *   - Calls the function servicing a system call and records its statistics
+ * - get_syscall_stats
+ *   - Implements the kernel side of sysgetsyscallstats
+ * - syscall_name
+ *   - Returns the name a system call was registered with
+ *-----------------------------------------------------------------------------------
+ */
+
+// The number of system request identifiers, the requests after the last one are
+// interrupts
+#define NUM_SYSCALLS TIMER_INT
+
+typedef struct syscall_entry {
+    syscall_handler_t handler;
+    syscall_stats_t stats;
+} syscall_entry_t;
+
+static void service_sysgetsyscallstats(void);
+
+static syscall_entry_t syscall_table[NUM_SYSCALLS];
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any system calls are registered. Empties the system call
+ * table, and registers sysgetsyscallstats.
+ *-----------------------------------------------------------------------------------
+ */
+void ksystabinit(void) {
+    fill_words(syscall_table, 0, sizeof(syscall_table));
+    register_syscall(SYSGETSYSCALLSTATS, "getsyscallstats", &service_sysgetsyscallstats);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Registers the function servicing the given system call. The function finds the
+ * arguments of the call in this_cpu()->args, and places the result in the
+ * result_code of this_cpu()->current.
+ *
+ * @param call    The system request identifier
+ * @param name    The name reported for the system call, truncated to
+ *                SYSCALL_NAME_LENGTH - 1 characters
+ * @param handler The function servicing the system call
+ * @return        0 on success, -1 if the identifier is out of range or the system
+ *                call is already registered
+ *-----------------------------------------------------------------------------------
+ */
+int register_syscall(request_t call, char *name, syscall_handler_t handler) {
+    if (call < 0 || call >= NUM_SYSCALLS || handler == NULL || syscall_table[call].handler != NULL) {
+        return -1;
+    }
+    syscall_entry_t *entry = &syscall_table[call];
+    entry->handler = handler;
+    int i;
+    for (i = 0; i < SYSCALL_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+        entry->stats.name[i] = name[i];
+    }
+    entry->stats.name[i] = '\0';
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls the function servicing the given system call for the current process, and
+ * records how long it took.
+ *
+ * @param call The system request identifier the process passed
+ * @return     0 if the system call was serviced, -1 if no function is registered
+ *             for it
+ *-----------------------------------------------------------------------------------
+ */
+int service_syscall(request_t call) {
+    if (call < 0 || call >= NUM_SYSCALLS || syscall_table[call].handler == NULL) {
+        return -1;
+    }
+    syscall_entry_t *entry = &syscall_table[call];
+    this_cpu()->current->syscalls++;
+
+    unsigned long long start = read_tsc();
+    entry->handler();
+    unsigned long long elapsed = read_tsc() - start;
+
+    // Anything beyond 32 bits lands in the last bucket
+    unsigned long cycles = elapsed >> 32 ? 0xffffffffUL : (unsigned long) elapsed;
+    int bucket = cycles > 1 ? find_last_set_bit(cycles) : 0;
+    entry->stats.count++;
+    entry->stats.histogram[bucket]++;
+    if (cycles > entry->stats.max_cycles) {
+        entry->stats.max_cycles = cycles;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of sysgetsyscallstats. Copies the statistics of the
+ * given system call.
+ *
+ * @param call  The system request identifier
+ * @param stats A pointer to where the statistics are copied, already checked by the
+ *              caller
+ * @return      0 on success, -1 if the system call is not registered
+ *-----------------------------------------------------------------------------------
+ */
+int get_syscall_stats(int call, syscall_stats_t *stats) {
+    if (call < 0 || call >= NUM_SYSCALLS || syscall_table[call].handler == NULL) {
+        return -1;
+    }
+    *stats = syscall_table[call].stats;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the name the given system call was registered with.
+ *
+ * @param call The system request identifier
+ * @return     The name of the system call, NULL if it is not registered
+ *-----------------------------------------------------------------------------------
+ */
+char *syscall_name(int call) {
+    if (call < 0 || call >= NUM_SYSCALLS || syscall_table[call].handler == NULL) {
+        return NULL;
+    }
+    return syscall_table[call].stats.name;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Services a sysgetsyscallstats request.
+ *-----------------------------------------------------------------------------------
+ */
+static void service_sysgetsyscallstats(void) {
+    cpu_t *cpu = this_cpu();
+    int call = (int) cpu->args[0];
+    syscall_stats_t *stats = (syscall_stats_t *) cpu->args[1];
+    if (check_range(stats, sizeof(syscall_stats_t), 0) != RANGE_OK) {
+        cpu->current->result_code = -2;
+        return;
+    }
+    cpu->current->result_code = get_syscall_stats(call, stats);
+}
@@ -0,0 +1,60 @@
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for arena.c. This test suite assumes that the root process and dispatcher
+ * are running.
+ *
+ * List of functions that are called from outside this file:
+ * - run_arena_test
+ *   - Runs the test suite for arena.c
+ *-----------------------------------------------------------------------------------
+ */
+
+static void arena_process(void);
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for arena.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_arena_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: sysalloc rejects invalid sizes
+    assert_equal((int) sysalloc(0), 0);
+    assert_equal((int) sysalloc((size_t) -1), 0);
+
+    // Test: The arena of a process is released once it has terminated and been
+    // reaped, which is done by the time syswait returns
+    int free_pages = get_free_page_count();
+    PID_t pid = syscreate(&arena_process, PROCESS_STACK_SIZE);
+    // The process may already have terminated if the root process was pre-empted
+    syswait(pid);
+    assert_equal(get_free_page_count(), free_pages);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by run_arena_test to allocate from its arena and terminate.
+ *-----------------------------------------------------------------------------------
+ */
+static void arena_process(void) {
+    int free_pages = get_free_page_count();
+
+    // Test: Allocations are bump-allocated on paragraph boundaries
+    char *a1 = (char *) sysalloc(10);
+    char *a2 = (char *) sysalloc(10);
+    assert(a1 != NULL && a2 != NULL, "sysalloc failed");
+    assert_equal((unsigned long) a1 % PARAGRAPH_SIZE, 0);
+    assert_equal((int) (a2 - a1), PARAGRAPH_SIZE);
+    assert(get_free_page_count() < free_pages, "The arena did not take pages");
+
+    // Test: An allocation larger than the chunk gets its own chunk
+    char *a3 = (char *) sysalloc(5 * 4096);
+    assert(a3 != NULL, "sysalloc failed");
+    for (int i = 0; i < 5 * 4096; i++) {
+        a3[i] = 'a';
+    }
+    a1[0] = 'b';
+    assert_equal(a3[0], 'a');
+}
@@ -28,7 +28,7 @@ void run_create_test(void) {
     assert_equal(create(&dummy_process, 50), 1);
 
     // sysyield to stop dummy processes
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) sysyield();
+    for (int i = 0; i < PCB_CHUNK_SIZE; i++) sysyield();
 
     yield_to_all();
     kprintf("Finished %s\n", __func__);
@@ -1,6 +1,12 @@
 #include <xeroskernel.h>
 #include <i386.h>
 #include <kbd.h>
+#include <serial.h>
+#include <bufcache.h>
+#include <ramdisk.h>
+#include <ata.h>
+#include <memdev.h>
+#include <ldisc.h>
 #include <xeroslib.h>
 
 /*-----------------------------------------------------------------------------------
@@ -16,9 +22,41 @@ static void sysopen_sysclose_test(void);
 static void syswrite_test(void);
 static void sysread_test(void);
 static void sysioctl_test(void);
+static void pipe_test(void);
+static void pipe_reader(void);
+static void sysaioread_test(void);
+static void count_aio_signal(void *cntx);
+static void serial_test(void);
+static void console_test(void);
+static void nonblocking_test(void);
+static void ramdisk_test(void);
+static void ata_test(void);
+static void ata_queue_test(void);
+static void fd_table_test(void);
+static void memdev_test(void);
+static void kbd_readers_test(void);
+static void kbd_reader(void);
+static int count_mismatches(char *a, char *b, int len);
 
 static int const debug = 0;
 
+// The block of the ATA disk written by ata_test, past the blocks it reads first,
+// and the requests and buffers ata_queue_test queues
+#define ATA_TEST_BLOCK 64
+#define ATA_QUEUE_REQUESTS 4
+static ata_request_t g_ata_requests[ATA_QUEUE_REQUESTS];
+static buf_t g_ata_bufs[ATA_QUEUE_REQUESTS + 3];
+
+// Bytes streamed through a pipe by pipe_test, more than its ring holds
+#define PIPE_STREAM_BYTES (3 * PIPE_BUFFER_SIZE + 7)
+static int g_pipe_reader_opened;
+static int g_pipe_bytes_read;
+static int g_pipe_mismatches;
+static int g_pipe_reads;
+static int g_aio_signals;
+static int g_kbd_reader_fd;
+static int g_kbd_reader_readers;
+
 void run_device_test(void) {
     kprintf("Running %s\n", __func__);
 
@@ -30,6 +68,17 @@ void run_device_test(void) {
         busy_wait();
     }
     sysioctl_test();
+    pipe_test();
+    sysaioread_test();
+    serial_test();
+    console_test();
+    nonblocking_test();
+    ramdisk_test();
+    ata_test();
+    ata_queue_test();
+    fd_table_test();
+    memdev_test();
+    kbd_readers_test();
 
     kprintf("Finished %s\n", __func__);
 }
@@ -173,6 +222,13 @@ static void sysioctl_test(void) {
     assert_equal(sysioctl(fd, IOCTL_CHANGE_EOF, NULL), -1);
     assert_equal(sysioctl(fd, IOCTL_CHANGE_EOF, NULL, NULL), -1);
 
+    if (debug) sysputs("IOCTL to get the input counters...\n");
+    kbd_stats_t stats;
+    assert_equal(sysioctl(fd, IOCTL_GET_STATS, &stats), 0);
+    assert_equal(stats.dropped, 0);
+    assert_equal(stats.high_water, 0);
+    assert_equal(sysioctl(fd, IOCTL_GET_STATS, (kbd_stats_t *) HOLESTART), -1);
+
     if (debug) sysputs("Failure tests: IOCTL with closed FD...\n");
     assert_equal(sysclose(fd), 0);
     assert_equal(sysioctl(fd, IOCTL_CHANGE_EOF, 'a'), SYSERR);
@@ -181,3 +237,621 @@ static void sysioctl_test(void) {
 
     if (debug) kprintf("Finished %s\n", __func__);
 }
+
+/*-----------------------------------------------------------------------------------
+ * Tests that pipes return partial reads, report end-of-file once the caller is the
+ * only holder, and stream a write larger than the ring to a reader.
+ *-----------------------------------------------------------------------------------
+ */
+static void pipe_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char buf[PIPE_STREAM_BYTES];
+    int fd = sysopen(PIPE_0);
+    int fd2 = sysopen(PIPE_0);
+    assert(fd >= 0 && fd2 >= 0, "sysopen of a pipe failed");
+    assert_equal(sysioctl(fd, IOCTL_ECHO_ON), SYSERR);
+
+    if (debug) sysputs("A read returns the bytes available...\n");
+    char input[20];
+    sprintf(input, "cs415");
+    assert_equal(syswrite(fd, input, strlen(input)), 5);
+    memset(buf, '\0', sizeof(buf));
+    assert_equal(sysread(fd2, buf, sizeof(input)), 5);
+    assert_equal(strcmp(buf, input), 0);
+
+    if (debug) sysputs("The only holder reads EOF and writes only what fits...\n");
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(sysread(fd, buf, 16), 0);
+    assert_equal(syswrite(fd, buf, PIPE_BUFFER_SIZE + 10), PIPE_BUFFER_SIZE);
+    assert_equal(syswrite(fd, buf, 1), -1);
+    assert_equal(sysread(fd, buf, PIPE_STREAM_BYTES), PIPE_BUFFER_SIZE);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) sysputs("A write larger than the ring streams to a reader...\n");
+    fd = sysopen(PIPE_0);
+    g_pipe_reader_opened = 0;
+    PID_t pid = syscreate(&pipe_reader, PROCESS_STACK_SIZE);
+    while (!g_pipe_reader_opened) {
+        sysyield();
+    }
+    for (int i = 0; i < PIPE_STREAM_BYTES; i++) {
+        buf[i] = i % 251;
+    }
+    assert_equal(syswrite(fd, buf, PIPE_STREAM_BYTES), PIPE_STREAM_BYTES);
+    // The reader is unblocked with EOF once it is the only holder
+    assert_equal(sysclose(fd), 0);
+    syswait(pid);
+    assert_equal(g_pipe_bytes_read, PIPE_STREAM_BYTES);
+    assert_equal(g_pipe_mismatches, 0);
+    assert(g_pipe_reads > 1, "the stream was not split across reads");
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by pipe_test to read the stream from the pipe until EOF, checking that the
+ * bytes arrive in order.
+ *-----------------------------------------------------------------------------------
+ */
+static void pipe_reader(void) {
+    // The bytes are read on the stack, kernel memory is not accepted
+    char buf[PIPE_BUFFER_SIZE / 2];
+    int fd = sysopen(PIPE_0);
+    g_pipe_bytes_read = 0;
+    g_pipe_mismatches = 0;
+    g_pipe_reads = 0;
+    g_pipe_reader_opened = 1;
+
+    int bytes;
+    while ((bytes = sysread(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < bytes; i++) {
+            if (buf[i] != (char) ((g_pipe_bytes_read + i) % 251)) {
+                g_pipe_mismatches++;
+            }
+        }
+        g_pipe_bytes_read += bytes;
+        g_pipe_reads++;
+    }
+    sysclose(fd);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests the failure cases of sysaioread, that only one read of the keyboard is in
+ * progress at a time, and that a read keeps an entry of the signal queue for the
+ * signal that completes it. Completing a read requires user input.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysaioread_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char buf[20];
+    int signal_number = 10;
+
+    if (debug) sysputs("Failure tests: invalid FD, signal and device...\n");
+    assert_equal(sysaioread(-1, buf, sizeof(buf), signal_number), SYSERR);
+    int fd = sysopen(PIPE_0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), SYSERR);
+    assert_equal(sysclose(fd), 0);
+    fd = sysopen(KBD_0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), SIGNAL_TABLE_SIZE - 1), SYSERR);
+    assert_equal(sysaioread(fd, (void *) HOLESTART, sizeof(buf), signal_number), SYSERR);
+
+    if (debug) sysputs("A read in progress refuses further reads until closed...\n");
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), 0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), SYSERR);
+    assert_equal(sysread(fd, buf, sizeof(buf)), SYSERR);
+    assert_equal(sysclose(fd), 0);
+    fd = sysopen(KBD_0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) sysputs("A read in progress keeps an entry of the signal queue...\n");
+    signal_handler_funcptr old_handler;
+    PID_t pid = sysgetpid();
+    g_aio_signals = 0;
+    assert_equal(syssighandler(signal_number, &count_aio_signal, &old_handler), 0);
+    syssigprocmask(SIG_BLOCK, 1 << signal_number, NULL);
+    fd = sysopen(KBD_0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), 0);
+    for (int i = 0; i < SIGNAL_QUEUE_SIZE - 1; i++) {
+        assert_equal(syssigqueue(pid, signal_number, i), 0);
+    }
+    assert_equal(syssigqueue(pid, signal_number, -1), -3);
+    // Closing abandons the read and frees its entry
+    assert_equal(sysclose(fd), 0);
+    assert_equal(syssigqueue(pid, signal_number, -1), 0);
+    fd = sysopen(KBD_0);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), signal_number), SYSERR);
+    assert_equal(sysclose(fd), 0);
+    syssigprocmask(SIG_UNBLOCK, 1 << signal_number, NULL);
+    sysyield();
+    assert_equal(g_aio_signals, SIGNAL_QUEUE_SIZE);
+    syssighandler(signal_number, old_handler, &old_handler);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysaioread_test to count the signals delivered to it.
+ *-----------------------------------------------------------------------------------
+ */
+static void count_aio_signal(void *cntx) {
+    g_aio_signals++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that a write to the serial port returns once its bytes are queued, and that
+ * they come back through the receive interrupt in loopback mode. Skipped on
+ * machines without a UART.
+ *-----------------------------------------------------------------------------------
+ */
+static void serial_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    int fd = sysopen(SERIAL_0);
+    if (fd == SYSERR) {
+        kprintf("%s: no serial port, skipped\n", __func__);
+        return;
+    }
+    assert_equal(sysioctl(fd, IOCTL_ECHO_ON), SYSERR);
+    assert_equal(sysaioread(fd, NULL, 0, 10), SYSERR);
+
+    if (debug) sysputs("Bytes written in loopback mode are read back...\n");
+    assert_equal(sysioctl(fd, IOCTL_LOOPBACK_ON), 0);
+    char input[20];
+    char buf[20];
+    sprintf(input, "loopback");
+    int len = strlen(input);
+    assert_equal(syswrite(fd, input, len), len);
+    memset(buf, '\0', sizeof(buf));
+    int received = 0;
+    while (received < len) {
+        // The bytes may arrive over more than one receive interrupt
+        assert_equal(syspoll(1 << fd, 1000), 1 << fd);
+        int n = sysread(fd, buf + received, len - received);
+        assert(n > 0, "sysread of the serial port failed");
+        received += n;
+    }
+    assert_equal(strcmp(buf, input), 0);
+
+    if (debug) sysputs("IOCTL to get the counters...\n");
+    serial_stats_t stats;
+    assert_equal(sysioctl(fd, IOCTL_SERIAL_STATS, &stats), 0);
+    assert_equal(stats.transmitted, len);
+    assert_equal(stats.received, len);
+    assert_equal(stats.dropped, 0);
+    assert_equal(sysioctl(fd, IOCTL_SERIAL_STATS, (serial_stats_t *) HOLESTART), -1);
+
+    assert_equal(sysioctl(fd, IOCTL_LOOPBACK_OFF), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the console takes writes from any number of holders and refuses reads.
+ *-----------------------------------------------------------------------------------
+ */
+static void console_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    int fd = sysopen(CONSOLE_0);
+    int fd2 = sysopen(CONSOLE_0);
+    assert(fd >= 0 && fd2 >= 0, "sysopen of the console failed");
+
+    if (debug) sysputs("A write returns once its bytes are buffered...\n");
+    char output[40];
+    sprintf(output, "%s: console write\n", __func__);
+    int len = strlen(output);
+    assert_equal(syswrite(fd2, output, len), len);
+
+    if (debug) sysputs("Failure tests: the console is output only...\n");
+    char buf[20];
+    assert_equal(sysread(fd, buf, sizeof(buf)), SYSERR);
+    assert_equal(sysaioread(fd, buf, sizeof(buf), 10), SYSERR);
+    assert_equal(syspoll(1 << fd, 0), 0);
+    assert_equal(sysioctl(fd, IOCTL_ECHO_ON), SYSERR);
+
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that a read of a file descriptor in non-blocking mode returns BLOCKERR
+ * instead of blocking, and the bytes available otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+static void nonblocking_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char buf[20];
+    assert_equal(sysioctl(-1, IOCTL_NONBLOCK_ON), SYSERR);
+
+    if (debug) sysputs("An empty pipe returns BLOCKERR...\n");
+    int fd = sysopen(PIPE_0);
+    int fd2 = sysopen(PIPE_0);
+    assert_equal(sysioctl(fd2, IOCTL_NONBLOCK_ON), 0);
+    assert_equal(sysread(fd2, buf, sizeof(buf)), BLOCKERR);
+
+    if (debug) sysputs("The bytes available are returned...\n");
+    char input[20];
+    sprintf(input, "cs415");
+    assert_equal(syswrite(fd, input, strlen(input)), 5);
+    memset(buf, '\0', sizeof(buf));
+    assert_equal(sysread(fd2, buf, sizeof(buf)), 5);
+    assert_equal(strcmp(buf, input), 0);
+    assert_equal(sysread(fd2, buf, sizeof(buf)), BLOCKERR);
+    assert_equal(sysioctl(fd2, IOCTL_NONBLOCK_OFF), 0);
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) sysputs("A keyboard with nothing typed returns BLOCKERR...\n");
+    fd = sysopen(KBD_0);
+    assert_equal(sysioctl(fd, IOCTL_NONBLOCK_ON), 0);
+    assert_equal(sysread(fd, buf, sizeof(buf)), BLOCKERR);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the RAM disk reads back what was written across block boundaries, moves
+ * with IOCTL_SEEK, stops at its end, and serves repeated reads from the cache.
+ *-----------------------------------------------------------------------------------
+ */
+static void ramdisk_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    int disk_bytes = RAMDISK_BLOCKS * BLOCK_SIZE;
+    char buf[3 * BLOCK_SIZE];
+    char out[3 * BLOCK_SIZE];
+    int fd = sysopen(RAMDISK_0);
+    assert(fd >= 0, "sysopen of the RAM disk failed");
+    assert_equal(sysopen(RAMDISK_0), SYSERR);
+
+    if (debug) sysputs("A write across blocks is read back...\n");
+    for (int i = 0; i < sizeof(out); i++) {
+        out[i] = i % 251;
+    }
+    assert_equal(sysioctl(fd, IOCTL_SEEK, 100), 0);
+    assert_equal(syswrite(fd, out, sizeof(out)), sizeof(out));
+    assert_equal(sysioctl(fd, IOCTL_SEEK, 100), 0);
+    bufcache_stats_t before;
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &before), 0);
+    memset(buf, 0, sizeof(buf));
+    assert_equal(sysread(fd, buf, sizeof(buf)), sizeof(buf));
+    assert_equal(count_mismatches(buf, out, sizeof(buf)), 0);
+
+    if (debug) sysputs("The blocks just written are served from the cache...\n");
+    bufcache_stats_t after;
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &after), 0);
+    assert_equal(after.hits - before.hits, 4);
+    assert_equal(after.misses, before.misses);
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, (bufcache_stats_t *) HOLESTART), -1);
+    assert_equal(sysioctl(fd, IOCTL_SYNC), 0);
+
+    if (debug) sysputs("The end of the disk...\n");
+    assert_equal(sysioctl(fd, IOCTL_SEEK, disk_bytes - 10), 0);
+    assert_equal(syswrite(fd, out, 20), 10);
+    assert_equal(syswrite(fd, out, 20), SYSERR);
+    assert_equal(sysread(fd, buf, 20), 0);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, disk_bytes - 10), 0);
+    assert_equal(sysread(fd, buf, 20), 10);
+    assert_equal(count_mismatches(buf, out, 10), 0);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, disk_bytes + 1), -1);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, -1), -1);
+
+    if (debug) sysputs("A reopened disk keeps its contents...\n");
+    assert_equal(sysclose(fd), 0);
+    fd = sysopen(RAMDISK_0);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, 100), 0);
+    assert_equal(sysread(fd, buf, BLOCK_SIZE), BLOCK_SIZE);
+    assert_equal(count_mismatches(buf, out, BLOCK_SIZE), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the ATA disk reads blocks in with one merged command, and serves them
+ * again from the cache, and that a block written back reads back from the disk.
+ * The disk may hold the boot image, so the block written is restored.
+ *-----------------------------------------------------------------------------------
+ */
+static void ata_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char buf[3 * BLOCK_SIZE];
+    char again[3 * BLOCK_SIZE];
+    int fd = sysopen(ATA_0);
+    if (fd == SYSERR) {
+        kprintf("%s: no disk, skipped\n", __func__);
+        return;
+    }
+    assert_equal(sysopen(ATA_0), SYSERR);
+
+    if (debug) sysputs("Adjacent blocks are read in by one command...\n");
+    bufcache_stats_t cache_before;
+    ata_stats_t disk_before;
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_before), 0);
+    assert_equal(sysioctl(fd, IOCTL_DISK_STATS, &disk_before), 0);
+    assert_equal(sysread(fd, buf, sizeof(buf)), sizeof(buf));
+    bufcache_stats_t cache_after;
+    ata_stats_t disk_after;
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_after), 0);
+    assert_equal(sysioctl(fd, IOCTL_DISK_STATS, &disk_after), 0);
+    assert_equal(disk_after.errors, disk_before.errors);
+    // Nothing else reads the disk, so its blocks are not cached yet
+    assert_equal(cache_after.misses - cache_before.misses, 3);
+    assert_equal(disk_after.commands - disk_before.commands, 1);
+    assert_equal(disk_after.sectors - disk_before.sectors, 3);
+    assert_equal(disk_after.merges - disk_before.merges, 2);
+
+    if (debug) sysputs("A read across blocks is served from the cache...\n");
+    assert_equal(sysioctl(fd, IOCTL_SEEK, 100), 0);
+    assert_equal(sysioctl(fd, IOCTL_NONBLOCK_ON), 0);
+    assert_equal(sysread(fd, again, 2 * BLOCK_SIZE), 2 * BLOCK_SIZE);
+    assert_equal(count_mismatches(again, buf + 100, 2 * BLOCK_SIZE), 0);
+    assert_equal(sysioctl(fd, IOCTL_DISK_STATS, &disk_before), 0);
+    assert_equal(disk_before.commands, disk_after.commands);
+    assert_equal(sysioctl(fd, IOCTL_DISK_STATS, (ata_stats_t *) HOLESTART), -1);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, -1), -1);
+    assert_equal(sysioctl(fd, IOCTL_NONBLOCK_OFF), 0);
+
+    if (debug) sysputs("A block written back reads back from the disk...\n");
+    char saved[BLOCK_SIZE];
+    assert_equal(sysioctl(fd, IOCTL_SEEK, ATA_TEST_BLOCK * BLOCK_SIZE), 0);
+    assert_equal(sysread(fd, saved, BLOCK_SIZE), BLOCK_SIZE);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        buf[i] = ~saved[i];
+    }
+    assert_equal(sysioctl(fd, IOCTL_SEEK, ATA_TEST_BLOCK * BLOCK_SIZE), 0);
+    assert_equal(syswrite(fd, buf, BLOCK_SIZE), BLOCK_SIZE);
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_before), 0);
+    assert_equal(sysioctl(fd, IOCTL_SYNC), 0);
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_after), 0);
+    assert_equal(cache_after.writebacks - cache_before.writebacks, 1);
+    // Reading more blocks not yet cached than the cache holds evicts the block, the
+    // drive takes the write before any of the reads
+    assert_equal(sysioctl(fd, IOCTL_SEEK, (ATA_TEST_BLOCK + 1) * BLOCK_SIZE), 0);
+    for (int block = 0; block < NUM_BUFS; block += 3) {
+        assert_equal(sysread(fd, again, sizeof(again)), sizeof(again));
+    }
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_before), 0);
+    assert_equal(sysioctl(fd, IOCTL_SEEK, ATA_TEST_BLOCK * BLOCK_SIZE), 0);
+    assert_equal(sysread(fd, again, BLOCK_SIZE), BLOCK_SIZE);
+    assert_equal(sysioctl(fd, IOCTL_CACHE_STATS, &cache_after), 0);
+    assert_equal(cache_after.misses - cache_before.misses, 1);
+    assert_equal(count_mismatches(again, buf, BLOCK_SIZE), 0);
+    assert_equal(sysioctl(fd, IOCTL_DISK_STATS, &disk_after), 0);
+    assert_equal(disk_after.errors, disk_before.errors);
+    // Closing writes the restored block back
+    assert_equal(sysioctl(fd, IOCTL_SEEK, ATA_TEST_BLOCK * BLOCK_SIZE), 0);
+    assert_equal(syswrite(fd, saved, BLOCK_SIZE), BLOCK_SIZE);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests the request queue of the ATA disk on made up requests, without the drive:
+ * transfers next to a queued request are merged into it, requests are kept in
+ * sector order, and C-LOOK takes the first at or past the head, wrapping around to
+ * the lowest.
+ *-----------------------------------------------------------------------------------
+ */
+static void ata_queue_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    ata_request_t *queue = NULL;
+    unsigned int lbas[ATA_QUEUE_REQUESTS] = {40, 10, 70, 30};
+    for (int i = 0; i < ATA_QUEUE_REQUESTS; i++) {
+        g_ata_bufs[i].blockno = lbas[i];
+        g_ata_requests[i].lba = lbas[i];
+        g_ata_requests[i].count = 1;
+        g_ata_requests[i].write = 0;
+        g_ata_requests[i].bufs[0] = &g_ata_bufs[i];
+        assert_equal(ata_merge(queue, &g_ata_bufs[i], 0), 0);
+        ata_insert(&queue, &g_ata_requests[i]);
+    }
+
+    if (debug) sysputs("Requests are kept in sector order...\n");
+    assert(queue == &g_ata_requests[1], "The lowest request is not first");
+    assert(queue->next == &g_ata_requests[3], "The requests are out of order");
+    assert(queue->next->next == &g_ata_requests[0], "The requests are out of order");
+    assert(queue->next->next->next == &g_ata_requests[2], "The requests are out of order");
+
+    if (debug) sysputs("Adjacent transfers of the same direction are merged...\n");
+    buf_t *after = &g_ata_bufs[ATA_QUEUE_REQUESTS];
+    buf_t *before = &g_ata_bufs[ATA_QUEUE_REQUESTS + 1];
+    buf_t *apart = &g_ata_bufs[ATA_QUEUE_REQUESTS + 2];
+    after->blockno = 41;
+    before->blockno = 9;
+    apart->blockno = 50;
+    assert_equal(ata_merge(queue, after, 1), 0);
+    assert_equal(ata_merge(queue, after, 0), 1);
+    assert_equal(g_ata_requests[0].count, 2);
+    assert(g_ata_requests[0].bufs[1] == after, "The buffer is not merged at the end");
+    assert_equal(ata_merge(queue, before, 0), 1);
+    assert_equal(g_ata_requests[1].lba, 9);
+    assert(g_ata_requests[1].bufs[0] == before, "The buffer is not merged at the start");
+    assert_equal(ata_merge(queue, apart, 0), 0);
+
+    if (debug) sysputs("C-LOOK sweeps up from the head and wraps around...\n");
+    assert(ata_take_next(&queue, 35) == &g_ata_requests[0], "40 does not follow head 35");
+    assert(ata_take_next(&queue, 42) == &g_ata_requests[2], "70 does not follow head 42");
+    assert(ata_take_next(&queue, 71) == &g_ata_requests[1], "C-LOOK did not wrap to 9");
+    assert(ata_take_next(&queue, 11) == &g_ata_requests[3], "30 does not follow head 11");
+    assert(ata_take_next(&queue, 31) == NULL, "The empty queue returned a request");
+    assert(queue == NULL, "The queue is not empty");
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the file descriptor table grows to MAX_FDS entries, hands out the lowest
+ * free descriptor, and that devices are registered by name and number.
+ *-----------------------------------------------------------------------------------
+ */
+static void fd_table_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    if (debug) sysputs("Devices are found by name...\n");
+    assert_equal(di_lookup("/dev/pipe1"), PIPE_1);
+    assert_equal(di_lookup("/dev/serial0"), SERIAL_0);
+    assert_equal(di_lookup("/dev/none"), -1);
+
+    if (debug) sysputs("Failure tests: a major number or name already taken...\n");
+    devsw_t devsw;
+    assert_equal(di_register(&devsw, "/dev/none", KBD_0, 0), -1);
+    assert_equal(di_register(&devsw, "/dev/pipe0", DEVICE_TABLE_SIZE - 1, 0), -1);
+    assert_equal(di_register(&devsw, "/dev/none", DEVICE_TABLE_SIZE, 0), -1);
+    assert_equal(sysopen(DEVICE_TABLE_SIZE - 1), SYSERR);
+
+    if (debug) sysputs("The table grows past its first entries...\n");
+    for (int i = 0; i < MAX_FDS; i++) {
+        assert_equal(sysopen(PIPE_0), i);
+    }
+    assert_equal(sysopen(PIPE_0), SYSERR);
+
+    if (debug) sysputs("The lowest free descriptor is reused...\n");
+    assert_equal(sysclose(5), 0);
+    assert_equal(sysclose(2), 0);
+    assert_equal(sysopen(PIPE_1), 2);
+    assert_equal(sysopen(PIPE_1), 5);
+    assert_equal(syspoll((1 << 2) | (1 << 5), 0), 0);
+    assert_equal(syspoll(1 << MAX_FDS << 1, 0), SYSERR);
+    for (int i = 0; i < MAX_FDS; i++) {
+        assert_equal(sysclose(i), 0);
+    }
+    assert_equal(syspoll(1 << 3, 0), SYSERR);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that /dev/null and /dev/zero take any write and read back nothing and zero
+ * bytes, and that the loopback device returns what was written, across the end of
+ * its ring.
+ *-----------------------------------------------------------------------------------
+ */
+static void memdev_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char out[3000];
+    char buf[3000];
+    for (int i = 0; i < sizeof(out); i++) {
+        out[i] = i % 253 + 1;
+    }
+
+    if (debug) sysputs("The null device...\n");
+    int fd = sysopen(NULL_0);
+    assert(fd >= 0, "sysopen of the null device failed");
+    assert_equal(syswrite(fd, out, sizeof(out)), sizeof(out));
+    assert_equal(sysread(fd, buf, sizeof(buf)), 0);
+    assert_equal(syspoll(1 << fd, 0), 1 << fd);
+    assert_equal(sysioctl(fd, IOCTL_ECHO_ON), SYSERR);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) sysputs("The zero device...\n");
+    fd = sysopen(ZERO_0);
+    memset(buf, 0xFF, sizeof(buf));
+    assert_equal(sysread(fd, buf, 100), 100);
+    for (int i = 0; i < 100; i++) {
+        assert_equal(buf[i], 0);
+    }
+    assert_equal(buf[100], (char) 0xFF);
+    assert_equal(syswrite(fd, out, 10), 10);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) sysputs("The loopback device, across the end of its ring...\n");
+    fd = sysopen(LOOP_0);
+    assert_equal(sysread(fd, buf, sizeof(buf)), 0);
+    assert_equal(syspoll(1 << fd, 0), 0);
+    for (int round = 0; round < 2; round++) {
+        assert_equal(syswrite(fd, out, sizeof(out)), sizeof(out));
+        assert_equal(syspoll(1 << fd, 0), 1 << fd);
+        memset(buf, 0, sizeof(buf));
+        assert_equal(sysread(fd, buf, 1000), 1000);
+        assert_equal(sysread(fd, buf + 1000, sizeof(buf)), sizeof(buf) - 1000);
+        assert_equal(count_mismatches(buf, out, sizeof(buf)), 0);
+    }
+
+    if (debug) sysputs("A full ring takes only what fits...\n");
+    assert_equal(syswrite(fd, out, sizeof(out)), sizeof(out));
+    assert_equal(syswrite(fd, out, sizeof(out)), LOOP_BUFFER_SIZE - sizeof(out));
+    assert_equal(syswrite(fd, out, sizeof(out)), 0);
+    while (sysread(fd, buf, sizeof(buf)) > 0);
+    assert_equal(sysioctl(fd, IOCTL_NONBLOCK_ON), 0);
+    assert_equal(sysread(fd, buf, sizeof(buf)), BLOCKERR);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that another process can open the keyboard while it is open, and that the
+ * mode of the line discipline is switched through sysioctl. Reading typed lines
+ * requires user input, see ldisctest.c for the line editing.
+ *-----------------------------------------------------------------------------------
+ */
+static void kbd_readers_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+
+    char buf[20];
+    int fd = sysopen(KBD_1);
+    assert(fd >= 0, "sysopen of the keyboard failed");
+
+    if (debug) sysputs("A second process opens the keyboard...\n");
+    g_kbd_reader_fd = SYSERR;
+    g_kbd_reader_readers = 0;
+    PID_t pid = syscreate(&kbd_reader, PROCESS_STACK_SIZE);
+    syswait(pid);
+    assert_equal(g_kbd_reader_fd, 0);
+    assert_equal(g_kbd_reader_readers, 2);
+    kbd_stats_t stats;
+    assert_equal(sysioctl(fd, IOCTL_GET_STATS, &stats), 0);
+    assert_equal(stats.readers, 1);
+
+    if (debug) sysputs("Raw and canonical mode...\n");
+    assert_equal(sysioctl(fd, IOCTL_MODE_RAW), 0);
+    assert_equal(sysioctl(fd, IOCTL_NONBLOCK_ON), 0);
+    assert_equal(sysread(fd, buf, sizeof(buf)), BLOCKERR);
+    assert_equal(sysioctl(fd, IOCTL_MODE_CANONICAL), 0);
+    assert_equal(sysclose(fd), 0);
+
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by kbd_readers_test to open the keyboard while the test has it open.
+ *-----------------------------------------------------------------------------------
+ */
+static void kbd_reader(void) {
+    char buf[20];
+    int fd = sysopen(KBD_0);
+    g_kbd_reader_fd = fd;
+    kbd_stats_t stats;
+    if (sysioctl(fd, IOCTL_GET_STATS, &stats) == 0) {
+        g_kbd_reader_readers = stats.readers;
+    }
+    sysioctl(fd, IOCTL_NONBLOCK_ON);
+    assert_equal(sysread(fd, buf, sizeof(buf)), BLOCKERR);
+    sysclose(fd);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of the given number of bytes that differ between the given
+ * buffers.
+ *-----------------------------------------------------------------------------------
+ */
+static int count_mismatches(char *a, char *b, int len) {
+    int mismatches = 0;
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) mismatches++;
+    }
+    return mismatches;
+}
@@ -0,0 +1,101 @@
+#include <xeroskernel.h>
+#include <i386.h>
+#include <e820.h>
+
+/*------------------------------------------------------------------------
+ * Tests for e820.c. Maps as a BIOS might return them are turned into
+ * regions, and the regions the kernel booted with are checked.
+ *
+ * List of functions that are called from outside this file:
+ * - run_e820_test
+ *   - Runs the test suite for e820.c
+ *------------------------------------------------------------------------
+ */
+
+static void set_entry(e820_entry_t *entry, unsigned long long addr, unsigned long long size, unsigned long type);
+
+static int const debug = 0;
+
+static e820_entry_t entries[8];
+static e820_region_t regions[4];
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for e820.c.
+ *------------------------------------------------------------------------
+ */
+void run_e820_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: The entries of usable memory become whole pages, sorted, with
+    // the reserved entries left out and the ones that overlap or touch
+    // merged
+    set_entry(&entries[0], 0x100000, 0x700000, E820_RAM);
+    set_entry(&entries[1], 0x9fc00, 0x400, 2);
+    set_entry(&entries[2], 0, 0x9fc00, E820_RAM);
+    set_entry(&entries[3], 0x800000, 0x100000, E820_RAM);
+    set_entry(&entries[4], 0x400000, 0x80000, E820_RAM);
+    set_entry(&entries[5], 0x2000800, 0x1000, E820_RAM);
+    assert_equal(e820_sanitize(entries, 6, regions, 4), 2);
+    if (debug) kprintf("%x-%x %x-%x\n", regions[0].start, regions[0].end, regions[1].start, regions[1].end);
+    assert_equal(regions[0].start, 0);
+    assert_equal(regions[0].end, 0x9f000);
+    assert_equal(regions[1].start, 0x100000);
+    assert_equal(regions[1].end, 0x900000);
+
+    // Test: Memory at and above VSTACK_BASE is cut off, also when the size
+    // of an entry takes it past 4GB
+    set_entry(&entries[0], VSTACK_BASE - 0x2000, 0x10000, E820_RAM);
+    set_entry(&entries[1], 0x100000000ULL, 0x100000, E820_RAM);
+    set_entry(&entries[2], 0x200000, 0xffffffffffff0000ULL, E820_RAM);
+    assert_equal(e820_sanitize(entries, 2, regions, 4), 1);
+    assert_equal(regions[0].start, VSTACK_BASE - 0x2000);
+    assert_equal(regions[0].end, VSTACK_BASE);
+    assert_equal(e820_sanitize(&entries[2], 1, regions, 4), 1);
+    assert_equal(regions[0].end, VSTACK_BASE);
+
+    // Test: A region that joins the two around it merges all three, and
+    // regions that do not fit in the table are dropped
+    set_entry(&entries[0], 0x1000, 0x1000, E820_RAM);
+    set_entry(&entries[1], 0x5000, 0x1000, E820_RAM);
+    set_entry(&entries[2], 0x1800, 0x4000, E820_RAM);
+    assert_equal(e820_sanitize(entries, 3, regions, 4), 1);
+    assert_equal(regions[0].start, 0x1000);
+    assert_equal(regions[0].end, 0x6000);
+    for (int i = 0; i < 6; i++) {
+        set_entry(&entries[i], (i + 1) * 0x10000, 0x1000, E820_RAM);
+    }
+    assert_equal(e820_sanitize(entries, 6, regions, 4), 4);
+    assert_equal(regions[3].start, 0x40000);
+
+    // Test: The regions the kernel booted with are separate and in order,
+    // and without a map they are the memory the kernel has always assumed
+    for (int i = 0; i < e820_region_count(); i++) {
+        e820_region_t *region = e820_get_region(i);
+        assert(region->start < region->end, "Empty region");
+        assert_equal(region->start % NBPG, 0);
+        assert_equal(region->end % NBPG, 0);
+        if (i > 0) {
+            assert(e820_get_region(i - 1)->end < region->start, "Regions out of order");
+        }
+        assert(e820_find_region(region->start) == region, "Region not found");
+        assert(e820_find_region(region->end) != region, "Region found past its end");
+    }
+    assert(e820_get_region(e820_region_count()) == NULL, "Region past the last");
+    if (!e820_from_bios()) {
+        assert_equal(e820_region_count(), 1);
+        assert_equal(e820_get_region(0)->start, 0);
+        assert_equal(e820_get_region(0)->end, 1024 * NBPG);
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Fills in an entry of a map.
+ *------------------------------------------------------------------------
+ */
+static void set_entry(e820_entry_t *entry, unsigned long long addr, unsigned long long size, unsigned long type) {
+    entry->addr = addr;
+    entry->size = size;
+    entry->type = type;
+}
@@ -0,0 +1,121 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <format.h>
+
+/*------------------------------------------------------------------------
+ * Tests for format.c. The output of every format is checked against
+ * sprintf, whose _doprnt it stands in for, and against the expected
+ * string when that is known.
+ *
+ * List of functions that are called from outside this file:
+ * - run_format_test
+ *   - Runs the test suite for format.c
+ *------------------------------------------------------------------------
+ */
+
+// The size of the buffer the flush test formats into
+#define FORMAT_TEST_FLUSH_SIZE 5
+
+static void check_format(char *expected, char *fmt, unsigned long arg);
+static int format_collected(char *buf, char *fmt, ...);
+static void collect(char *buf, int len);
+
+static int const debug = 0;
+
+static char collected[128];
+static int collected_len;
+static int flushes;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for format.c.
+ *------------------------------------------------------------------------
+ */
+void run_format_test(void) {
+    kprintf("Running %s\n", __func__);
+    char buf[64];
+
+    // Test: Every conversion, flag and field gives the output of sprintf
+    check_format("42", "%d", 42);
+    check_format("-42", "%d", -42);
+    check_format("-2147483648", "%d", 0x80000000);
+    check_format("0", "%u", 0);
+    check_format("4294967295", "%u", 0xffffffff);
+    check_format("1234567890", "%lu", 1234567890);
+    check_format("[   -7]", "[%5d]", -7);
+    check_format("[-0007]", "[%05d]", -7);
+    check_format("[7    ]", "[%-5u]", 7);
+    check_format("[abc  ]", "[%-5s]", (unsigned long) "abc");
+    check_format("[  abc]", "[%5s]", (unsigned long) "abc");
+    check_format("[ab]", "[%.2s]", (unsigned long) "abc");
+    check_format("deadbeef", "%x", 0xdeadbeef);
+    check_format("deadbeef", "%X", 0xdeadbeef);
+    check_format("000000ff", "%08x", 0xff);
+    check_format("777", "%o", 0777);
+    check_format("101", "%b", 5);
+    check_format("x", "%c", 'x');
+    check_format("100%", "100%%", 0);
+    check_format("[3]", "[%100d]", 3);
+    check_format("%", "%", 0);
+
+    // Test: Output that does not fit is truncated and terminated
+    assert_equal(format_string(buf, 4, "%d", 123456), 3);
+    assert_equal(strcmp(buf, "123"), 0);
+    assert_equal(format_string(buf, 1, "abc"), 0);
+    assert_equal(buf[0], '\0');
+    assert_equal(format_string(buf, sizeof(buf), "%s %d", "xy", 5), 4);
+    assert_equal(strcmp(buf, "xy 5"), 0);
+
+    // Test: A buffer that fills up is flushed and reused, every character
+    // written once and in order
+    collected_len = 0;
+    flushes = 0;
+    assert_equal(format_collected(buf, "a%sb%dc", "xyz", 1234), 10);
+    collected[collected_len] = '\0';
+    if (debug) kprintf("collected %s in %d flushes\n", collected, flushes);
+    assert_equal(strcmp(collected, "axyzb1234c"), 0);
+    assert_equal(flushes, 2);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Checks that a format of a single argument gives the same output as
+ * sprintf, and the expected string if it is not NULL.
+ *------------------------------------------------------------------------
+ */
+static void check_format(char *expected, char *fmt, unsigned long arg) {
+    char buf[128];
+    char reference[128];
+    format_string(buf, sizeof(buf), fmt, arg);
+    sprintf(reference, fmt, arg);
+    if (debug) kprintf("%s: [%s] [%s]\n", fmt, buf, reference);
+    assert_equal(strcmp(buf, reference), 0);
+    if (expected != NULL) {
+        assert_equal(strcmp(buf, expected), 0);
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Formats with collect as the flush function, into a buffer of
+ * FORMAT_TEST_FLUSH_SIZE characters.
+ *------------------------------------------------------------------------
+ */
+static int format_collected(char *buf, char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int written = format_buffer(buf, FORMAT_TEST_FLUSH_SIZE, collect, fmt, ap);
+    va_end(ap);
+    return written;
+}
+
+/*------------------------------------------------------------------------
+ * The flush function of the flush test, appends the buffer to what has
+ * been collected.
+ *------------------------------------------------------------------------
+ */
+static void collect(char *buf, int len) {
+    for (int i = 0; i < len; i++) {
+        collected[collected_len++] = buf[i];
+    }
+    flushes++;
+}
@@ -0,0 +1,72 @@
+#include <xeroskernel.h>
+
+/*------------------------------------------------------------------------
+ * Tests for klog.c. Run at boot before any process is created, so the
+ * only records made are those of the tests.
+ *
+ * List of functions that are called from outside this file:
+ * - run_klog_test
+ *   - Runs the test suite for klog.c
+ *------------------------------------------------------------------------
+ */
+
+static int const debug = 0;
+
+static log_record_t records[LOG_RING_SIZE + 1];
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for klog.c.
+ *------------------------------------------------------------------------
+ */
+void run_klog_test(void) {
+    kprintf("Running %s\n", __func__);
+    char *fmt = "test %d %d\n";
+
+    // Test: The level only takes valid levels, and -1 leaves it as it is
+    assert_equal(log_set_level(-1), LOG_DEFAULT_LEVEL);
+    assert_equal(log_set_level(LOG_DEBUG + 1), -1);
+    assert_equal(log_set_level(LOG_ERROR - 2), -1);
+    assert_equal(log_set_level(LOG_INFO), LOG_DEFAULT_LEVEL);
+    assert_equal(log_read(records, LOG_RING_SIZE), 0);
+    assert_equal(log_read(records, -1), -1);
+
+    // Test: Records above the level are not made, the others keep their
+    // format, arguments and level, and are read in the order they were made
+    KLOG(LOG_ERROR, fmt, 1, 2);
+    KLOG(LOG_DEBUG, fmt, 3, 4);
+    KLOG(LOG_INFO, fmt, 5, 6);
+    assert_equal(log_read(records, LOG_RING_SIZE), 2);
+    assert(records[0].fmt == fmt, "The format was not kept");
+    assert_equal(records[0].args[0], 1);
+    assert_equal(records[0].args[1], 2);
+    assert_equal(records[0].level, LOG_ERROR);
+    assert_equal(records[0].cpu, this_cpu()->index);
+    assert_equal(records[0].dropped, 0);
+    assert_equal(records[1].args[0], 5);
+    assert_equal(records[1].level, LOG_INFO);
+    assert(records[1].timestamp >= records[0].timestamp, "Records are out of order");
+    assert_equal(log_read(records, LOG_RING_SIZE), 0);
+
+    // Test: A read takes at most count records and the next continues
+    for (int i = 0; i < 3; i++) {
+        KLOG(LOG_WARN, fmt, i, 0);
+    }
+    assert_equal(log_read(records, 2), 2);
+    assert_equal(log_read(records, 2), 1);
+    assert_equal(records[0].args[0], 2);
+
+    // Test: Records made while the ring is full are dropped, and the next
+    // record that fits counts them
+    for (int i = 0; i < LOG_RING_SIZE + 3; i++) {
+        KLOG(LOG_WARN, fmt, i, 0);
+    }
+    assert_equal(log_read(records, LOG_RING_SIZE + 1), LOG_RING_SIZE);
+    assert_equal(records[LOG_RING_SIZE - 1].args[0], LOG_RING_SIZE - 1);
+    KLOG(LOG_WARN, fmt, 0, 0);
+    assert_equal(log_read(records, LOG_RING_SIZE), 1);
+    assert_equal(records[0].dropped, 3);
+    if (debug) kprintf(records[0].fmt, records[0].args[0], records[0].args[1]);
+
+    kloginit();
+    kprintf("Finished %s\n", __func__);
+}
@@ -0,0 +1,68 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*------------------------------------------------------------------------
+ * Tests for latency.c. Run at boot before the dispatcher is entered, so
+ * the only spans and ticks counted are those of the tests.
+ *
+ * List of functions that are called from outside this file:
+ * - run_latency_test
+ *   - Runs the test suite for latency.c
+ *------------------------------------------------------------------------
+ */
+
+static latency_stats_t stats;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for latency.c.
+ *------------------------------------------------------------------------
+ */
+void run_latency_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: Only system calls and interrupts have statistics, named after
+    // their requests, and none is counted yet
+    assert_equal(get_latency_stats(-1, &stats), -1);
+    assert_equal(get_latency_stats(ATA_INT + 1, &stats), -1);
+    assert_equal(get_latency_stats(SYSCREATE, &stats), 0);
+    assert_equal(strcmp(stats.name, "create"), 0);
+    assert_equal(stats.count, 0);
+    assert_equal(get_latency_stats(SYSGETLATENCY, &stats), 0);
+    assert_equal(strcmp(stats.name, "getlatency"), 0);
+    assert_equal(get_latency_stats(TIMER_INT, &stats), 0);
+    assert_equal(strcmp(stats.name, "timer int"), 0);
+
+    // Test: A span goes in the bucket of its highest bit, 0 and 1 cycles in
+    // the first, anything beyond 32 bits in the last
+    latency_span(ATA_INT, 0);
+    latency_span(ATA_INT, 1000);
+    latency_span(ATA_INT, 1ULL << 40);
+    get_latency_stats(ATA_INT, &stats);
+    assert_equal(stats.count, 3);
+    assert_equal(stats.histogram[0], 1);
+    assert_equal(stats.histogram[9], 1);
+    assert_equal(stats.histogram[SYSCALL_HISTOGRAM_BUCKETS - 1], 1);
+    assert(stats.max_cycles == 0xffffffffUL, "The longest span was not kept");
+
+    // Test: Ticks are counted apart from the spans, the last bucket counts
+    // the longer waits too
+    latency_tick(ATA_INT, 3);
+    latency_tick(ATA_INT, 1 << 20);
+    get_latency_stats(ATA_INT, &stats);
+    assert_equal(stats.count, 3);
+    assert_equal(stats.tick_count, 2);
+    assert_equal(stats.tick_histogram[1], 1);
+    assert_equal(stats.tick_histogram[LATENCY_TICK_BUCKETS - 1], 1);
+    assert_equal(stats.tick_max_us, 1 << 20);
+
+    // Test: Requests out of range are not counted
+    latency_span(ATA_INT + 1, 10);
+    latency_tick(-1, 10);
+
+    // Empty the statistics the tests made, sysgetlatency stays registered
+    klatencyinit();
+    get_latency_stats(ATA_INT, &stats);
+    assert_equal(stats.count, 0);
+    assert_equal(stats.tick_count, 0);
+    kprintf("Finished %s\n", __func__);
+}
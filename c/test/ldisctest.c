@@ -0,0 +1,176 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <ldisc.h>
+
+/*------------------------------------------------------------------------
+ * Tests for ldisc.c. Run at boot on a line discipline of their own, with
+ * the chars typed handed straight to ldisc_input, and readers that are
+ * never blocked.
+ *
+ * List of functions that are called from outside this file:
+ * - run_ldisc_test
+ *   - Runs the test suite for ldisc.c
+ *------------------------------------------------------------------------
+ */
+
+static void type(char *s);
+static int read_line(pcb_t *proc, char *buf, int buflen);
+static void count_echo(char c);
+
+static int const debug = 0;
+
+static ldisc_t ld;
+static pcb_t pcbs[LDISC_MAX_READERS + 1];
+static int echoes;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for ldisc.c.
+ *------------------------------------------------------------------------
+ */
+void run_ldisc_test(void) {
+    kprintf("Running %s\n", __func__);
+    for (int i = 0; i <= LDISC_MAX_READERS; i++) {
+        pcbs[i].pid = i + 1;
+        pcbs[i].state = READY;
+    }
+    pcb_t *a = &pcbs[0];
+    pcb_t *b = &pcbs[1];
+    char buf[LDISC_RING_SIZE];
+    ldisc_init(&ld, &count_echo);
+
+    // Test: Up to LDISC_MAX_READERS processes read at once, each only once
+    assert_equal(ldisc_open(&ld, a, 1), 0);
+    assert_equal(ldisc_open(&ld, a, 1), -1);
+    for (int i = 1; i < LDISC_MAX_READERS; i++) {
+        assert_equal(ldisc_open(&ld, &pcbs[i], 0), 0);
+    }
+    assert_equal(ldisc_open(&ld, &pcbs[LDISC_MAX_READERS], 0), -1);
+    for (int i = 2; i < LDISC_MAX_READERS; i++) {
+        assert_equal(ldisc_close(&ld, &pcbs[i]), 0);
+    }
+    assert_equal(ldisc_close(&ld, &pcbs[2]), -1);
+    assert_equal(ld.num_readers, 2);
+
+    // Test: A line is only passed on once it ends, and every reader gets it
+    echoes = 0;
+    type("ab");
+    assert_equal(ldisc_read(&ld, a, buf, sizeof(buf), 1), BLOCKERR);
+    assert_equal(ldisc_poll(&ld, b), 0);
+    assert_equal(echoes, 2);
+
+    // Test: The erase char removes the last char, from the screen too
+    type("\bc\n");
+    assert_equal(echoes, 2 + 3 + 2);
+    assert_equal(ldisc_poll(&ld, b), 1);
+    assert_equal(read_line(a, buf, sizeof(buf)), 3);
+    assert_equal(strcmp(buf, "ac\n"), 0);
+    assert_equal(read_line(b, buf, sizeof(buf)), 3);
+    assert_equal(strcmp(buf, "ac\n"), 0);
+    assert_equal(ld.lines, 1);
+
+    // Test: The kill char removes the line, and a read stops at the end of a
+    // line or the end of its buffer
+    type("xyz\x15ok\nno\n");
+    assert_equal(read_line(a, buf, sizeof(buf)), 3);
+    assert_equal(strcmp(buf, "ok\n"), 0);
+    assert_equal(read_line(b, buf, 1), 1);
+    assert_equal(read_line(b, buf, sizeof(buf)), 2);
+    assert_equal(strcmp(buf, "k\n"), 0);
+    assert_equal(read_line(b, buf, sizeof(buf)), 3);
+    assert_equal(read_line(a, buf, sizeof(buf)), 3);
+    assert_equal(strcmp(buf, "no\n"), 0);
+
+    // Test: Echo is off once no reader has it on
+    assert_equal(ldisc_set_echo(&ld, a, 0), 0);
+    echoes = 0;
+    type("q\n");
+    assert_equal(echoes, 0);
+    read_line(a, buf, sizeof(buf));
+    read_line(b, buf, sizeof(buf));
+
+    // Test: The EOF char ends the line, and every later read returns EOF
+    type("hi\x04");
+    assert_equal(read_line(a, buf, sizeof(buf)), 2);
+    assert_equal(strcmp(buf, "hi"), 0);
+    assert_equal(ldisc_read(&ld, a, buf, sizeof(buf), 1), 0);
+    assert_equal(ldisc_read(&ld, a, buf, sizeof(buf), 1), 0);
+    assert_equal(ldisc_poll(&ld, a), 1);
+    assert_equal(read_line(b, buf, sizeof(buf)), 2);
+    assert_equal(ldisc_read(&ld, b, buf, sizeof(buf), 1), 0);
+
+    // Test: Another EOF char may be set, and the old one is then a plain char
+    assert_equal(ldisc_set_eof(&ld, 0), -1);
+    assert_equal(ldisc_set_eof(&ld, 'z'), 0);
+    assert_equal(ldisc_close(&ld, a), 0);
+    assert_equal(ldisc_open(&ld, a, 0), 0);
+    type("\x04z");
+    assert_equal(read_line(a, buf, sizeof(buf)), 1);
+    assert_equal(buf[0], '\x04');
+    assert_equal(ldisc_read(&ld, a, buf, sizeof(buf), 1), 0);
+
+    // Test: A reader that opens again starts afresh, the others keep the state
+    assert_equal(ldisc_close(&ld, a), 0);
+    assert_equal(ldisc_open(&ld, a, 0), 0);
+    assert_equal(ld.eof, 'z');
+    assert_equal(ldisc_read(&ld, a, buf, sizeof(buf), 1), BLOCKERR);
+    assert_equal(ldisc_close(&ld, b), 0);
+
+    // Test: In raw mode the line being edited is passed on, and then every char
+    // as it arrives, the control chars included
+    type("ra");
+    assert_equal(ldisc_set_mode(&ld, 2), -1);
+    assert_equal(ldisc_set_mode(&ld, LDISC_RAW), 0);
+    assert_equal(read_line(a, buf, sizeof(buf)), 2);
+    type("w\b");
+    assert_equal(read_line(a, buf, sizeof(buf)), 2);
+    assert_equal(buf[1], '\b');
+
+    // Test: Input is dropped once the ring is full behind the slowest reader
+    assert_equal(ldisc_open(&ld, b, 0), 0);
+    for (int i = 0; i < LDISC_RING_SIZE + 5; i++) {
+        ldisc_input(&ld, 'x');
+        read_line(a, buf, sizeof(buf));
+    }
+    assert_equal(ld.dropped, 5);
+    assert_equal(ld.high_water, LDISC_RING_SIZE);
+    assert_equal(read_line(b, buf, sizeof(buf)), LDISC_RING_SIZE);
+    assert_equal(ldisc_set_mode(&ld, LDISC_CANONICAL), 0);
+    if (debug) kprintf("%d lines passed on\n", ld.lines);
+
+    // Test: The first reader to open resets the line discipline
+    assert_equal(ldisc_close(&ld, a), 0);
+    assert_equal(ldisc_close(&ld, b), 0);
+    assert_equal(ldisc_open(&ld, a, 0), 0);
+    assert_equal(ld.mode, LDISC_CANONICAL);
+    assert_equal(ld.eof, DEFAULT_EOF);
+    assert_equal(ld.dropped, 0);
+    assert_equal(ldisc_close(&ld, a), 0);
+}
+
+/*------------------------------------------------------------------------
+ * Hands the chars of the given string to the line discipline.
+ *------------------------------------------------------------------------
+ */
+static void type(char *s) {
+    for (; *s; s++) {
+        ldisc_input(&ld, *s);
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Reads into the given buffer without blocking, with the buffer cleared
+ * first so that what was read ends with a null char if there is room.
+ *------------------------------------------------------------------------
+ */
+static int read_line(pcb_t *proc, char *buf, int buflen) {
+    memset(buf, '\0', buflen);
+    return ldisc_read(&ld, proc, buf, buflen, 1);
+}
+
+/*------------------------------------------------------------------------
+ * Counts the chars echoed.
+ *------------------------------------------------------------------------
+ */
+static void count_echo(char c) {
+    echoes++;
+}
@@ -0,0 +1,96 @@
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for load.c. This test suite assumes that the root process and dispatcher are
+ * running, and that pre-emption is enabled.
+ *
+ * List of functions that are called from outside this file:
+ * - run_load_test
+ *   - Runs the test suite for load.c
+ *-----------------------------------------------------------------------------------
+ */
+
+static void load_parse_test(void);
+static void load_run_test(void);
+
+static int const debug = 0;
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for load.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_load_test(void) {
+    kprintf("Running %s\n", __func__);
+    load_parse_test();
+    load_run_test();
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests load_parse.
+ *-----------------------------------------------------------------------------------
+ */
+static void load_parse_test(void) {
+    load_config_t config;
+
+    // Test: The empty argument runs one worker of each kind for the default time,
+    // and fields left out at the end keep their defaults
+    assert_equal(load_parse("", &config), 0);
+    assert_equal(config.duration_ms, 5000);
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        assert_equal(config.workers[kind], 1);
+    }
+    assert_equal(load_parse("10,3,0", &config), 0);
+    assert_equal(config.duration_ms, 10000);
+    assert_equal(config.workers[LOAD_CPU], 3);
+    assert_equal(config.workers[LOAD_IPC], 0);
+    assert_equal(config.workers[LOAD_SLEEP], 1);
+    assert_equal(config.workers[LOAD_ALLOC], 1);
+
+    // Test: Malformed arguments, no time, no workers, too many fields and more
+    // processes than a run may have are rejected, an IPC worker counting twice
+    assert_equal(load_parse("x", &config), -1);
+    assert_equal(load_parse("5,", &config), -1);
+    assert_equal(load_parse("5,,1", &config), -1);
+    assert_equal(load_parse("0", &config), -1);
+    assert_equal(load_parse("5,0,0,0,0", &config), -1);
+    assert_equal(load_parse("5,1,1,1,1,1", &config), -1);
+    assert_equal(load_parse("5,16,0,0,0", &config), 0);
+    assert_equal(load_parse("5,0,8,0,0", &config), 0);
+    assert_equal(load_parse("5,1,8,0,0", &config), -1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests load_run.
+ *-----------------------------------------------------------------------------------
+ */
+static void load_run_test(void) {
+    load_config_t config;
+    load_report_t report;
+
+    // Test: A short run of every kind of worker completes operations of each kind,
+    // none of which fail, and the CPU-bound workers share the processor
+    assert_equal(load_parse("1,2,1,1,1", &config), 0);
+    config.duration_ms = 300;
+    assert_equal(load_run(&config, &report), 0);
+    if (debug) kprintf("%d ms, %d ops/s, fairness %d\n", report.elapsed_ms, report.ops_per_sec, report.fairness);
+    assert(report.elapsed_ms >= 300, "The run was cut short");
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+        load_kind_stats_t *stats = &report.kinds[kind];
+        assert_equal(stats->workers, config.workers[kind]);
+        assert(stats->ops > 0, "A kind of worker completed no operations");
+        assert_equal(stats->failures, 0);
+        assert(stats->p50_bucket <= stats->p90_bucket && stats->p90_bucket <= stats->p99_bucket,
+               "The percentiles are out of order");
+    }
+    assert(report.kinds[LOAD_CPU].cpu_ms > 0, "The CPU-bound workers got no CPU time");
+    assert(report.fairness > 750 && report.fairness <= 1000, "The CPU-bound workers were treated unfairly");
+    assert(report.min_cpu_ms <= report.max_cpu_ms, "The CPU time range is inverted");
+
+    // Test: Every worker was reaped, so a second run can be made
+    config.workers[LOAD_CPU] = 0;
+    config.duration_ms = 50;
+    assert_equal(load_run(&config, &report), 0);
+    assert_equal(report.kinds[LOAD_CPU].workers, 0);
+    assert_equal(report.fairness, 1000);
+}
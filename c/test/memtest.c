@@ -14,6 +14,10 @@ extern unsigned long freemem_aligned;
 extern unsigned long hole_start_aligned;
 extern unsigned long hole_end_aligned;
 extern unsigned long max_addr_aligned;
+extern unsigned long heap_start_aligned;
+extern unsigned long heap_end_aligned;
+extern unsigned long extra_heap_bytes;
+extern int num_extra_heaps;
 
 /*-----------------------------------------------------------------------------------
  * Runs the test suite for mem.c.
@@ -22,8 +26,9 @@ extern unsigned long max_addr_aligned;
 void run_mem_test(void) {
     kprintf("Testing memory management...\n");
 
-    // Test: kmeminit initializes with 2 free blocks
-    assert_equal(get_free_list_length(), 2);
+    // Test: kmeminit initializes with 2 free blocks, and the extra blocks of a memory
+    // map from the BIOS
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
 
     // Test: kmalloc rejects 0
     assert_equal((int) kmalloc(0), 0);
@@ -46,30 +51,107 @@ void run_mem_test(void) {
     unsigned long *p2 = (unsigned long *) kmalloc(16);
     unsigned long *p3 = (unsigned long *) kmalloc(16);
     unsigned long *p4 = (unsigned long *) kmalloc(16);
-    assert_equal(get_free_list_length(), 2);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
 
     // Test: kfree merges adjacent free blocks
     assert_equal(kfree(p1), 1);
-    assert_equal(get_free_list_length(), 3);
+    assert_equal(get_free_list_length(), 3 + num_extra_heaps);
     assert_equal(kfree(p2), 1);
-    assert_equal(get_free_list_length(), 3);
+    assert_equal(get_free_list_length(), 3 + num_extra_heaps);
     assert_equal(kfree(p4), 1);
-    assert_equal(get_free_list_length(), 3);
+    assert_equal(get_free_list_length(), 3 + num_extra_heaps);
     assert_equal(kfree(p3), 1);
-    assert_equal(get_free_list_length(), 2);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
 
     // Test: Cannot free block twice
     assert_equal(kfree(p4), 0);
 
+    // Test: kfree merges a block with both of its neighbours at once
+    p1 = (unsigned long *) kmalloc(16);
+    p2 = (unsigned long *) kmalloc(16);
+    p3 = (unsigned long *) kmalloc(16);
+    p4 = (unsigned long *) kmalloc(16);
+    assert_equal(kfree(p1), 1);
+    assert_equal(kfree(p3), 1);
+    assert_equal(get_free_list_length(), 4 + num_extra_heaps);
+    assert_equal(kfree(p2), 1);
+    assert_equal(get_free_list_length(), 3 + num_extra_heaps);
+    // The merged block is reused from its start
+    unsigned long *p9 = (unsigned long *) kmalloc(64);
+    assert_equal((int) p9, (int) p1);
+    assert_equal(kfree(p9), 1);
+    assert_equal(kfree(p4), 1);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+
+    // Test: kmalloc reuses a freed block of the same size class instead of splitting a larger block
+    unsigned long *s1 = (unsigned long *) kmalloc(PROCESS_STACK_SIZE);
+    unsigned long *s2 = (unsigned long *) kmalloc(PROCESS_STACK_SIZE);
+    assert_equal(kfree(s1), 1);
+    assert_equal(get_free_list_length(), 3 + num_extra_heaps);
+    unsigned long *s3 = (unsigned long *) kmalloc(PROCESS_STACK_SIZE);
+    assert_equal((int) s3, (int) s1);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+    assert_equal(kfree(s2), 1);
+    assert_equal(kfree(s3), 1);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+
+    // Test: kstackfree keeps a stack of the default size in the stack pool
+    unsigned long *k1 = (unsigned long *) kstackalloc(PROCESS_STACK_SIZE);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+    assert_equal(kstackfree(k1), 1);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+    // Test: Cannot free a stack in the stack pool
+    assert_equal(kstackfree(k1), 0);
+    assert_equal(kfree(k1), 0);
+    // Test: kstackalloc reuses the stack in the stack pool
+    assert_equal((int) kstackalloc(PROCESS_STACK_SIZE), (int) k1);
+    assert_equal(kfree(k1), 1);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
+
+    // Test: get_mem_stats tracks allocations, frees and failed allocations
+    mem_stats_t stats_before, stats_after;
+    get_mem_stats(&stats_before);
+    assert_equal(stats_before.free_block_count, 2 + num_extra_heaps);
+    assert_equal(stats_before.pre_hole_free_bytes, hole_start_aligned - freemem_aligned);
+    assert_equal(stats_before.post_hole_free_bytes, heap_end_aligned - heap_start_aligned + extra_heap_bytes);
+    unsigned long *m1 = (unsigned long *) kmalloc(100);
+    assert_equal((int) kmalloc(0), 0);
+    get_mem_stats(&stats_after);
+    assert_equal(stats_after.bytes_in_use - stats_before.bytes_in_use, 112 + 16);
+    assert_equal(stats_after.num_allocs - stats_before.num_allocs, 1);
+    assert_equal(stats_after.failed_allocs - stats_before.failed_allocs, 1);
+    assert_equal(kfree(m1), 1);
+    get_mem_stats(&stats_after);
+    assert_equal(stats_after.bytes_in_use, stats_before.bytes_in_use);
+    assert_equal(stats_after.num_frees - stats_before.num_frees, 1);
+
+    // Test: check_range reports why a range is invalid
+    assert_equal(check_range((void *) freemem_aligned, 16, 0), RANGE_OK);
+    assert_equal(check_range((void *) HOLEEND, 16, 0), RANGE_OK);
+    assert_equal(check_range(NULL, 16, 0), RANGE_NULL);
+    assert_equal(check_range((void *) freemem_aligned, 0, 0), RANGE_EMPTY);
+    assert_equal(check_range((void *) HOLEEND, (unsigned long) -1, 0), RANGE_OVERFLOW);
+    assert_equal(check_range((void *) (freemem_aligned - 16), 16, 0), RANGE_IN_KERNEL);
+    assert_equal(check_range((void *) (freemem_aligned - 16), 16, 1), RANGE_OK);
+    assert_equal(check_range((void *) HOLESTART, 16, 0), RANGE_IN_HOLE);
+    assert_equal(check_range((void *) (HOLESTART - 8), 16, 0), RANGE_IN_HOLE);
+    assert_equal(check_range((void *) (max_addr_aligned + 16), 16, 0), RANGE_BEYOND_MEMORY);
+    assert_equal(check_range((void *) (max_addr_aligned - 16), 32, 0), RANGE_BEYOND_MEMORY);
+    // Test: A range whose first and last bytes are valid is not if it spans the hole
+    assert_equal(check_range((void *) (hole_start_aligned - 16), HOLEEND - hole_start_aligned + 32, 0),
+                 RANGE_IN_HOLE);
+    assert_equal(check_range((void *) (freemem_aligned - 16), HOLEEND - freemem_aligned + 32, 1),
+                 RANGE_IN_HOLE);
+
     // Test: Allocate all available free memory
     unsigned long *p5 = (unsigned long *) kmalloc(hole_start_aligned - freemem_aligned - 16);
-    unsigned long *p6 = (unsigned long *) kmalloc(max_addr_aligned - hole_end_aligned - 16);
+    unsigned long *p6 = (unsigned long *) kmalloc(heap_end_aligned - heap_start_aligned - 16);
     assert_equal((int) kmalloc(1), 0);
-    assert_equal(get_free_list_length(), 0);
+    assert_equal(get_free_list_length(), 0 + num_extra_heaps);
     assert_equal(kfree(p5), 1);
-    assert_equal(get_free_list_length(), 1);
+    assert_equal(get_free_list_length(), 1 + num_extra_heaps);
     assert_equal(kfree(p6), 1);
-    assert_equal(get_free_list_length(), 2);
+    assert_equal(get_free_list_length(), 2 + num_extra_heaps);
 
     // Test: kmalloc aligns on paragraph boundary
     // Need 16 bytes for header, then 10 bytes to satisfy request
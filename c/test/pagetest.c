@@ -0,0 +1,84 @@
+#include <xeroskernel.h>
+#include <i386.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for page.c.
+ *
+ * List of functions that are called from outside this file:
+ * - run_page_test
+ *   - Runs the test suite for page.c
+ *-----------------------------------------------------------------------------------
+ */
+
+extern unsigned long page_arena_start;
+extern unsigned long page_arena_end;
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for page.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_page_test(void) {
+    kprintf("Testing page allocator...\n");
+
+    int initial_free_page_count = get_free_page_count();
+    assert(initial_free_page_count > 0, "No free pages");
+
+    // Test: page_order rounds up to a power of two pages
+    assert_equal(page_order(1), 0);
+    assert_equal(page_order(NBPG), 0);
+    assert_equal(page_order(NBPG + 1), 1);
+    assert_equal(page_order(4 * NBPG), 2);
+    assert_equal(page_order(5 * NBPG), 3);
+
+    // Test: kpagealloc rejects invalid orders
+    assert_equal((int) kpagealloc(-1), 0);
+    assert_equal((int) kpagealloc(NUM_PAGE_ORDERS), 0);
+
+    // Test: kpagealloc returns page-aligned blocks in the arena
+    unsigned long p1 = (unsigned long) kpagealloc(2);
+    assert(p1 != 0, "kpagealloc failed");
+    assert_equal(p1 % NBPG, 0);
+    assert(p1 >= page_arena_start && p1 + 4 * NBPG <= page_arena_end, "Block is not in the arena");
+    // Blocks are aligned to their size within the arena
+    assert_equal((p1 - page_arena_start) % (4 * NBPG), 0);
+    assert_equal(get_free_page_count(), initial_free_page_count - 4);
+
+    // Test: kpagefree rejects pointers that are not the start of an allocated block
+    assert_equal(kpagefree((void *) (p1 + NBPG)), 0);
+    assert_equal(kpagefree((void *) (p1 + 1)), 0);
+    assert_equal(kpagefree(NULL), 0);
+    assert_equal(kpagefree((void *) page_arena_end), 0);
+
+    // Test: Cannot free block twice
+    assert_equal(kpagefree((void *) p1), 1);
+    assert_equal(kpagefree((void *) p1), 0);
+    assert_equal(get_free_page_count(), initial_free_page_count);
+
+    // Test: Allocate all free pages one at a time, chaining them through their first word
+    unsigned long *pages = NULL;
+    unsigned long *page = (unsigned long *) kpagealloc(0);
+    int allocated = 0;
+    while (page != NULL) {
+        *page = (unsigned long) pages;
+        pages = page;
+        allocated++;
+        page = (unsigned long *) kpagealloc(0);
+    }
+    assert_equal(allocated, initial_free_page_count);
+    assert_equal(get_free_page_count(), 0);
+
+    // Test: Freeing every page merges the buddies back into large blocks
+    while (pages != NULL) {
+        unsigned long *next = (unsigned long *) *pages;
+        assert_equal(kpagefree(pages), 1);
+        pages = next;
+    }
+    assert_equal(get_free_page_count(), initial_free_page_count);
+    int largest_order = find_last_set_bit(initial_free_page_count);
+    if (largest_order > NUM_PAGE_ORDERS - 1) {
+        largest_order = NUM_PAGE_ORDERS - 1;
+    }
+    unsigned long p2 = (unsigned long) kpagealloc(largest_order);
+    assert(p2 != 0, "Buddies were not merged");
+    assert_equal(kpagefree((void *) p2), 1);
+}
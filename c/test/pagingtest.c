@@ -0,0 +1,70 @@
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for paging.c. This test suite assumes that the root process and dispatcher
+ * are running, and only runs in paging mode, which make paging builds.
+ *
+ * List of functions that are called from outside this file:
+ * - run_paging_test
+ *   - Runs the test suite for paging.c
+ *-----------------------------------------------------------------------------------
+ */
+
+#define TOUCHED_STACK_PAGES 4
+
+static void paging_process(void);
+static void touch_stack(void);
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for paging.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_paging_test(void) {
+    if (!PAGING_ENABLED) {
+        return;
+    }
+    kprintf("Running %s\n", __func__);
+
+    // Test: Stacks larger than a stack slot are rejected
+    assert_equal(syscreate(&paging_process, VSTACK_SLOT_SIZE), -1);
+
+    // Test: The pages a stack grows into are freed once the process has terminated
+    // and been reaped, which is done by the time syswait returns
+    int free_pages = get_free_page_count();
+    int pid = syscreate(&paging_process, PROCESS_STACK_SIZE);
+    assert(pid > 0, "syscreate failed");
+    // The process may already have terminated if the root process was pre-empted
+    syswait(pid);
+    assert_equal(get_free_page_count(), free_pages);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by run_paging_test to grow its stack and terminate.
+ *-----------------------------------------------------------------------------------
+ */
+static void paging_process(void) {
+    int free_pages = get_free_page_count();
+
+    // Test: Only the top page of a new stack is mapped
+    proc_status_t status;
+    assert_equal(get_process_status(sysgetpid(), &status), 0);
+    assert_equal(status.stackUsage, 4096);
+
+    // Test: Touching the stack maps new pages
+    touch_stack();
+    assert_equal(get_free_page_count(), free_pages - TOUCHED_STACK_PAGES);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by paging_process to touch the pages below the top page of its stack.
+ *-----------------------------------------------------------------------------------
+ */
+static void touch_stack(void) {
+    char buffer[TOUCHED_STACK_PAGES * 4096 - 512];
+    for (int i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = 'a';
+    }
+    assert_equal(buffer[0], 'a');
+}
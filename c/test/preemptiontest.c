@@ -3,7 +3,9 @@
 
 /*-----------------------------------------------------------------------------------
  * Tests for pre-emption. This test suite assumes that the root process and dispatcher
- * are running, and that pre-emption is enabled.
+ * are running, and that pre-emption is enabled. The tests of the multilevel feedback
+ * scheduler only run in a kernel built with make mlfq, and those of the stride
+ * scheduler in one built with make stride.
  *
  * List of functions that are called from outside this file:
  * - run_preemption_test
@@ -19,12 +21,20 @@ static void cooperative_process_test(void);
 static void sub1_process(void);
 static void add2_process(void);
 static void wait_for_a_time_slice(void);
+static void mlfq_test(void);
+static void mlfq_process(void);
+static void stride_test(void);
+static void stride_heavy_process(void);
+static void stride_light_process(void);
+static void stride_spin(void);
 
 // Used for cooperative_process_test
 static unsigned int g_add2_pid;
 static unsigned int g_sub1_pid;
 // The number of communication rounds between sender and receiver processes
 static int TOTAL_ROUNDS = 5;
+// Used for stride_test, set to stop the spinning processes
+static volatile int g_stride_done;
 
 static int const debug = 0;
 
@@ -33,6 +43,8 @@ void run_preemption_test(void) {
 
     uncooperative_process_test();
     cooperative_process_test();
+    if (MLFQ_ENABLED) mlfq_test();
+    if (SCHED_POLICY == SCHED_STRIDE) stride_test();
 
     kprintf("Finished %s\n", __func__);
 }
@@ -175,3 +187,95 @@ static void sub1_process(void) {
 static void wait_for_a_time_slice(void) {
     for (int i = 0; i < TIME_SLICE; i++);
 }
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the multilevel feedback scheduler demotes a CPU-bound process and
+ * promotes it when it wakes up.
+ *-----------------------------------------------------------------------------------
+ */
+static void mlfq_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+    int pid = syscreate(&mlfq_process, PROCESS_STACK_SIZE);
+    syswait(pid);
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by mlfq_test to spin until it is demoted and then sleep.
+ *-----------------------------------------------------------------------------------
+ */
+static void mlfq_process(void) {
+    // Test: A new process starts at the highest priority
+    assert_equal(syssetprio(-1), 0);
+
+    // Test: A process that keeps using its time slices is demoted
+    for (int i = 0; i < 100000 && syssetprio(-1) < MLFQ_WAKE_BOOST; i++) {
+        for (int j = 0; j < 1000; j++);
+    }
+    int demoted_priority = syssetprio(-1);
+    assert(demoted_priority >= MLFQ_WAKE_BOOST, "CPU-bound process was not demoted");
+
+    // Test: A process that wakes up from sleep is promoted
+    syssleep(TIME_SLICE);
+    assert(syssetprio(-1) < demoted_priority, "Process was not promoted on wake up");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the stride scheduler shares the processor between two CPU-bound
+ * processes in proportion to their tickets.
+ *-----------------------------------------------------------------------------------
+ */
+static void stride_test(void) {
+    if (debug) kprintf("Running %s\n", __func__);
+    g_stride_done = 0;
+    PID_t heavy_pid = syscreate(&stride_heavy_process, PROCESS_STACK_SIZE);
+    PID_t light_pid = syscreate(&stride_light_process, PROCESS_STACK_SIZE);
+    syssleep(100 * TIME_SLICE);
+
+    proc_status_t heavy;
+    proc_status_t light;
+    assert_equal(get_process_status(heavy_pid, &heavy), 0);
+    assert_equal(get_process_status(light_pid, &light), 0);
+    long heavy_time = heavy.cpuTime;
+    long light_time = light.cpuTime;
+    int heavy_share = heavy.cpuShare;
+    int light_share = light.cpuShare;
+    // Test: The process with three times the tickets gets about three times the time
+    assert(light_time > 0, "Process with fewer tickets was starved");
+    assert(heavy_time >= 2 * light_time && heavy_time <= 4 * light_time,
+           "Processor time is not shared in proportion to the tickets");
+    // Test: The share reported follows the processor time
+    assert(heavy_share > light_share && heavy_share <= 1000, "Share of the processor is out of range");
+
+    g_stride_done = 1;
+    syswait(heavy_pid);
+    syswait(light_pid);
+    if (debug) kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by stride_test to spin with three times the default tickets.
+ *-----------------------------------------------------------------------------------
+ */
+static void stride_heavy_process(void) {
+    assert_equal(syssettickets(3 * DEFAULT_TICKETS), DEFAULT_TICKETS);
+    stride_spin();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by stride_test to spin with the default tickets.
+ *-----------------------------------------------------------------------------------
+ */
+static void stride_light_process(void) {
+    stride_spin();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Spins until stride_test is done.
+ *-----------------------------------------------------------------------------------
+ */
+static void stride_spin(void) {
+    while (!g_stride_done) {
+        wait_for_a_time_slice();
+    }
+}
@@ -0,0 +1,99 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*------------------------------------------------------------------------
+ * Tests for profile.c. Run at boot before the timer is enabled, so the
+ * only samples taken are those of the tests, of made up processes.
+ *
+ * List of functions that are called from outside this file:
+ * - run_profile_test
+ *   - Runs the test suite for profile.c
+ *------------------------------------------------------------------------
+ */
+
+static void sample_at(pcb_t *proc, unsigned long eip);
+
+static int const debug = 0;
+
+// The profile is too large for the stack
+static profile_t profile;
+// Made up processes that are sampled
+static pcb_t proc;
+static pcb_t other;
+static pcb_t idle;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for profile.c.
+ *------------------------------------------------------------------------
+ */
+void run_profile_test(void) {
+    kprintf("Running %s\n", __func__);
+    memset(&proc, 0, sizeof(pcb_t));
+    memset(&other, 0, sizeof(pcb_t));
+    memset(&idle, 0, sizeof(pcb_t));
+    proc.pid = 5;
+    other.pid = 6;
+    idle.pid = IDLE_PROC_PID;
+    unsigned long here = (unsigned long) &run_profile_test;
+
+    // Test: The buckets cover the kernel text, and no samples are taken
+    // before the profiler is started
+    get_profile(&profile);
+    assert(profile.shift >= 0, "The bucket size is negative");
+    assert((here >> profile.shift) < PROFILE_BUCKETS, "The text is not covered");
+    if (debug) kprintf("Buckets of %d bytes\n", 1 << profile.shift);
+    assert_equal(profile_stop(), -1);
+    sample_at(&proc, here);
+    get_profile(&profile);
+    assert_equal(profile.running, 0);
+    assert_equal(profile.histogram[here >> profile.shift], 0);
+
+    // Test: Every process is sampled, at the address it was interrupted at,
+    // and the idle process and addresses outside the text are only counted
+    assert_equal(profile_start(-1), -1);
+    assert_equal(profile_start(0), 0);
+    sample_at(&proc, here);
+    sample_at(&other, here);
+    sample_at(&idle, here);
+    sample_at(&proc, 0xffffffffUL);
+    get_profile(&profile);
+    assert_equal(profile.running, 1);
+    assert_equal(profile.histogram[here >> profile.shift], 2);
+    assert_equal(profile.idle, 1);
+    assert_equal(profile.outside, 1);
+
+    // Test: Starting again empties the histogram, and only the given process
+    // is sampled
+    assert_equal(profile_start(proc.pid), 0);
+    sample_at(&proc, here);
+    sample_at(&other, here);
+    sample_at(&idle, here);
+    get_profile(&profile);
+    assert_equal(profile.pid, proc.pid);
+    assert_equal(profile.histogram[here >> profile.shift], 1);
+    assert_equal(profile.idle, 0);
+    assert_equal(profile.outside, 0);
+
+    // Test: Stopping keeps the histogram and takes no more samples
+    assert_equal(profile_stop(), 0);
+    sample_at(&proc, here);
+    get_profile(&profile);
+    assert_equal(profile.running, 0);
+    assert_equal(profile.histogram[here >> profile.shift], 1);
+
+    kprofileinit();
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Takes a sample of the given process as if a timer interrupt had
+ * switched it out at the given address.
+ *------------------------------------------------------------------------
+ */
+static void sample_at(pcb_t *proc, unsigned long eip) {
+    context_frame_t frame;
+    memset(&frame, 0, sizeof(context_frame_t));
+    frame.iret_eip = eip;
+    proc->esp = &frame;
+    profile_tick(proc);
+}
@@ -30,29 +30,29 @@ void run_queue_test(void) {
 
     // Initialize 64 PCBs to test process queue
     // The PID is the index of the pcbs array
-    pcb_t pcbs[2 * PCB_TABLE_SIZE];
-    for (int i = 0; i < 2 * PCB_TABLE_SIZE; i++) {
+    pcb_t pcbs[2 * PCB_CHUNK_SIZE];
+    for (int i = 0; i < 2 * PCB_CHUNK_SIZE; i++) {
         pcbs[i].pid = i;
     }
 
     // Test: enqueue behaves correctly
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
+    for (int i = 0; i < PCB_CHUNK_SIZE; i++) {
         enqueue(&q, &pcbs[i]);
         if (debug) print_queue(&q);
     }
-    assert_equal(size(&q), PCB_TABLE_SIZE);
+    assert_equal(size(&q), PCB_CHUNK_SIZE);
 
     // Test: peek_tail
     pcb_t *proc = peek_tail(&q);
     assert(proc != NULL, "peek_tail() should not return NULL");
-    assert_equal(proc->pid, PCB_TABLE_SIZE - 1);
+    assert_equal(proc->pid, PCB_CHUNK_SIZE - 1);
 
     // Test: is_empty
     assert_equal(is_empty(&q), 0);
 
     if (debug) busy_wait();
     // Test: enqueue and dequeue coordinate correctly
-    for (int i = PCB_TABLE_SIZE; i < 2 * PCB_TABLE_SIZE; i++) {
+    for (int i = PCB_CHUNK_SIZE; i < 2 * PCB_CHUNK_SIZE; i++) {
         pcb_t *proc = dequeue(&q);
         if (debug) kprintf("dequeued process w/ pid = %d\n", proc->pid);
         enqueue(&q, &pcbs[i]);
@@ -60,12 +60,12 @@ void run_queue_test(void) {
         if (debug) print_queue(&q);
         if (debug) wait();
     }
-    assert_equal(size(&q), PCB_TABLE_SIZE);
+    assert_equal(size(&q), PCB_CHUNK_SIZE);
 
     if (debug) busy_wait();
 
     // Test: dequeue behaves correctly
-    for (int i = 0; i < PCB_TABLE_SIZE; ++i) {
+    for (int i = 0; i < PCB_CHUNK_SIZE; ++i) {
         dequeue(&q);
         if (debug) print_queue(&q);
         if (debug) wait();
@@ -79,7 +79,7 @@ void run_queue_test(void) {
     assert(peek_tail(&q) == NULL, "peek_tail() should return NULL");
 
     // Test: remove
-    for (int i = 0; i < PCB_TABLE_SIZE; i++) {
+    for (int i = 0; i < PCB_CHUNK_SIZE; i++) {
         enqueue(&q, &pcbs[i]);
         if (debug) print_queue(&q);
         if (debug) wait();
@@ -87,7 +87,7 @@ void run_queue_test(void) {
 
     // Remove elements from right to left
     if (debug) kprintf("Start removing elements from queue...\n");
-    for (int i = PCB_TABLE_SIZE - 1; i >= 0; i--) {
+    for (int i = PCB_CHUNK_SIZE - 1; i >= 0; i--) {
         remove(&q, &pcbs[i]);
         if (debug) print_queue(&q);
         if (debug) wait();
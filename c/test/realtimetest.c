@@ -0,0 +1,107 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*------------------------------------------------------------------------
+ * Tests for realtime.c. Run at boot before the timer is enabled, so the
+ * only ticks seen by the real-time class are those of the tests, charged
+ * to made up processes.
+ *
+ * List of functions that are called from outside this file:
+ * - run_realtime_test
+ *   - Runs the test suite for realtime.c
+ *------------------------------------------------------------------------
+ */
+
+// Ticks the made up processes are scheduled for
+#define SCHEDULE_TICKS 16
+
+static pcb_t *pick(void);
+static char name_of(pcb_t *proc);
+
+static int const debug = 0;
+
+// Made up real-time processes of different periods, and a process that is
+// not real-time and runs while neither of them can
+static pcb_t short_proc;
+static pcb_t long_proc;
+static pcb_t other;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for realtime.c.
+ *------------------------------------------------------------------------
+ */
+void run_realtime_test(void) {
+    kprintf("Running %s\n", __func__);
+    memset(&short_proc, 0, sizeof(pcb_t));
+    memset(&long_proc, 0, sizeof(pcb_t));
+    memset(&other, 0, sizeof(pcb_t));
+    short_proc.state = READY;
+    long_proc.state = READY;
+
+    // A budget of 1 tick every 3, and of 4 every 8, both starting now
+    assert_equal(set_realtime(&short_proc, 3 * TIME_SLICE, TIME_SLICE), 0);
+    assert_equal(set_realtime(&long_proc, 8 * TIME_SLICE, 4 * TIME_SLICE), 0);
+    unsigned long start = short_proc.rt_deadline - short_proc.rt_period;
+    assert_equal(long_proc.rt_deadline - long_proc.rt_period, start);
+    // Ready in the opposite order of their deadlines
+    realtime_ready(&long_proc);
+    realtime_ready(&short_proc);
+
+    // Test: Ticks are run the way the dispatcher does, the current process
+    // runs until realtime_tick says it is pre-empted. The process with the
+    // earliest deadline runs first and pre-empts one with a later deadline
+    // when its period starts, a process is throttled once its budget is used
+    // up, and nothing real-time runs while both are throttled
+    char schedule[SCHEDULE_TICKS + 1];
+    pcb_t *current = pick();
+    for (int tick = 0; tick < SCHEDULE_TICKS; tick++) {
+        schedule[tick] = name_of(current);
+        if (realtime_tick(current, 1)) {
+            if (current != &other) {
+                realtime_ready(current);
+            }
+            current = pick();
+        }
+    }
+    schedule[SCHEDULE_TICKS] = '\0';
+    if (debug) kprintf("Schedule %s\n", schedule);
+    assert_equal(strcmp(schedule, "SLLSLLS-LSLLSL-S"), 0);
+
+    // Test: The budget is replenished and the deadline moves on by a period
+    // at every deadline reached, the short process has used the budget of
+    // its sixth period and the long process is at the start of its third
+    assert_equal(short_proc.rt_budget_left, 0);
+    assert_equal(short_proc.rt_deadline - start, 18);
+    assert_equal(long_proc.rt_budget_left, 4);
+    assert_equal(long_proc.rt_deadline - start, 24);
+
+    if (current != &other) {
+        realtime_ready(current);
+    }
+    realtime_release(&short_proc);
+    realtime_release(&long_proc);
+    assert_equal(realtime_pending(), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Returns the process to run next, the runnable real-time process with the
+ * earliest deadline if there is one.
+ *------------------------------------------------------------------------
+ */
+static pcb_t *pick(void) {
+    pcb_t *proc = realtime_next();
+    return proc != NULL ? proc : &other;
+}
+
+/*------------------------------------------------------------------------
+ * Returns the char the given process is shown as in a schedule.
+ *------------------------------------------------------------------------
+ */
+static char name_of(pcb_t *proc) {
+    if (proc == &short_proc) {
+        return 'S';
+    }
+    return proc == &long_proc ? 'L' : '-';
+}
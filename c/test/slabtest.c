@@ -0,0 +1,86 @@
+#include <xeroskernel.h>
+#include <i386.h>
+#include <slab.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for slab.c.
+ *
+ * List of functions that are called from outside this file:
+ * - run_slab_test
+ *   - Runs the test suite for slab.c
+ *-----------------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for slab.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_slab_test(void) {
+    kprintf("Testing slab allocator...\n");
+
+    int initial_free_list_length = get_free_list_length();
+    kmem_cache_stats_t stats;
+
+    // Test: kmem_cache_create rejects invalid sizes
+    assert_equal((int) kmem_cache_create("zero", 0), 0);
+    assert_equal((int) kmem_cache_create("huge", 2 * NBPG), 0);
+
+    // Test: kmem_cache_create does not allocate a slab
+    kmem_cache_t *cache = kmem_cache_create("test", 20);
+    assert(cache != NULL, "kmem_cache_create failed");
+    assert_equal(kmem_cache_get_stats(cache, &stats), 1);
+    assert_equal(stats.num_slabs, 0);
+    assert_equal(cache->object_size, 32);
+
+    // Test: Objects are allocated from the same slab until it is full
+    int objects_per_slab = stats.objects_per_slab;
+    assert(objects_per_slab > 2, "Slab holds too few objects");
+    char *o1 = (char *) kmem_cache_alloc(cache);
+    char *o2 = (char *) kmem_cache_alloc(cache);
+    assert_equal((int) (o2 - o1), 32);
+    assert_equal(kmem_cache_get_stats(cache, &stats), 1);
+    assert_equal(stats.num_slabs, 1);
+    assert_equal(stats.objects_in_use, 2);
+    assert_equal(stats.objects_free, objects_per_slab - 2);
+
+    // Test: A freed object is reused
+    assert_equal(kmem_cache_free(cache, o1), 1);
+    assert_equal((int) kmem_cache_alloc(cache), (int) o1);
+
+    // Test: Cannot free object twice, or free an object not from the cache
+    assert_equal(kmem_cache_free(cache, o2), 1);
+    assert_equal(kmem_cache_free(cache, o2), 0);
+    assert_equal(kmem_cache_free(cache, o1 + 1), 0);
+    assert_equal(kmem_cache_free(cache, NULL), 0);
+
+    // Test: A new slab is allocated once a slab is full
+    void *objects[2 * objects_per_slab];
+    objects[0] = o1;
+    for (int i = 1; i < 2 * objects_per_slab; i++) {
+        objects[i] = kmem_cache_alloc(cache);
+        assert(objects[i] != NULL, "kmem_cache_alloc failed");
+    }
+    assert_equal(kmem_cache_get_stats(cache, &stats), 1);
+    assert_equal(stats.num_slabs, 2);
+    assert_equal(stats.objects_in_use, 2 * objects_per_slab);
+    assert_equal(stats.objects_free, 0);
+
+    // Test: Cannot destroy a cache with objects in use
+    assert_equal(kmem_cache_destroy(cache), 0);
+
+    // Test: Empty slabs are returned, except for the last one with free objects
+    for (int i = 0; i < 2 * objects_per_slab; i++) {
+        assert_equal(kmem_cache_free(cache, objects[i]), 1);
+    }
+    assert_equal(kmem_cache_get_stats(cache, &stats), 1);
+    assert_equal(stats.num_slabs, 1);
+    assert_equal(stats.objects_in_use, 0);
+    assert_equal(stats.num_allocs, 2 * objects_per_slab + 2);
+    assert_equal(stats.num_frees, 2 * objects_per_slab + 2);
+
+    // Test: kmem_cache_destroy returns all slabs
+    assert_equal(kmem_cache_destroy(cache), 1);
+    assert_equal(kmem_cache_get_stats(cache, &stats), 0);
+    assert_equal((int) kmem_cache_alloc(cache), 0);
+    assert_equal(get_free_list_length(), initial_free_list_length);
+}
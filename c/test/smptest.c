@@ -0,0 +1,65 @@
+#include <xeroskernel.h>
+
+/*-----------------------------------------------------------------------------------
+ * Tests for smp.c. This test suite assumes that ksmpinit has been called and that
+ * the dispatcher is not running yet.
+ *
+ * List of functions that are called from outside this file:
+ * - run_smp_test
+ *   - Runs the test suite for smp.c
+ *-----------------------------------------------------------------------------------
+ */
+
+static void this_cpu_test(void);
+static void spin_lock_test(void);
+
+/*-----------------------------------------------------------------------------------
+ * Runs the test suite for smp.c.
+ *-----------------------------------------------------------------------------------
+ */
+void run_smp_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    this_cpu_test();
+    spin_lock_test();
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that the boot processor finds its own state.
+ *-----------------------------------------------------------------------------------
+ */
+static void this_cpu_test(void) {
+    // Test: %gs of the boot processor points at the state of processor 0
+    cpu_t *cpu = this_cpu();
+    assert(cpu == get_cpu(0), "this_cpu is not processor 0");
+    assert(cpu->self == cpu, "Processor state does not point to itself");
+    assert_equal(cpu->index, 0);
+
+    // Test: Only the boot processor is online before the others are started
+    for (int i = 1; i < MAX_CPUS; i++) {
+        assert(get_cpu(i) == NULL, "Processor is online before it was started");
+    }
+    assert(get_cpu(-1) == NULL && get_cpu(MAX_CPUS) == NULL, "Invalid processor index");
+    assert_equal(smp_cpu_count(), 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests acquiring and releasing a spinlock.
+ *-----------------------------------------------------------------------------------
+ */
+static void spin_lock_test(void) {
+    spinlock_t lock = {0};
+
+    // Test: A free lock is taken and released
+    spin_lock(&lock);
+    assert_equal(lock.locked, 1);
+    spin_unlock(&lock);
+    assert_equal(lock.locked, 0);
+
+    // Test: A released lock can be taken again
+    spin_lock(&lock);
+    spin_unlock(&lock);
+    assert_equal(lock.locked, 0);
+}
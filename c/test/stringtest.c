@@ -0,0 +1,111 @@
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*------------------------------------------------------------------------
+ * Tests for string.c. Strings of every length up to a few words, at
+ * every alignment, are measured, compared and copied by the routines of
+ * string.c and those of libxc, which must give the same results.
+ *
+ * List of functions that are called from outside this file:
+ * - run_string_test
+ *   - Runs the test suite for string.c
+ *------------------------------------------------------------------------
+ */
+
+// Lengths of the strings tested, and the size of their buffers
+#define STRING_TEST_LENGTH 20
+#define STRING_TEST_SIZE (STRING_TEST_LENGTH + 2 * sizeof(unsigned long))
+
+static void make_string(char *buf, int offset, int len);
+static int sign(int num);
+
+static int const debug = 0;
+
+static char buf1[STRING_TEST_SIZE];
+static char buf2[STRING_TEST_SIZE];
+static char copy1[STRING_TEST_SIZE];
+static char copy2[STRING_TEST_SIZE];
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for string.c.
+ *------------------------------------------------------------------------
+ */
+void run_string_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    for (int offset1 = 0; offset1 < sizeof(unsigned long); offset1++) {
+        for (int len = 0; len <= STRING_TEST_LENGTH; len++) {
+            char *s1 = buf1 + offset1;
+            make_string(buf1, offset1, len);
+
+            // Test: The length is found at every alignment
+            assert_equal(strlen_words(s1), len);
+            assert_equal(strlen_words(s1), strlen(s1));
+
+            for (int offset2 = 0; offset2 < sizeof(unsigned long); offset2++) {
+                char *s2 = buf2 + offset2;
+
+                // Test: Equal strings compare equal, at the same alignment and
+                // at different ones
+                make_string(buf2, offset2, len);
+                assert_equal(strcmp_words(s1, s2), 0);
+                assert_equal(strncmp_words(s1, s2, len + 1), 0);
+
+                // Test: The first difference decides, wherever it is, and
+                // strncmp stops before it if n is too short to reach it
+                for (int diff = 0; diff < len; diff++) {
+                    make_string(buf2, offset2, len);
+                    s2[diff] = (diff & 1) ? s1[diff] + 1 : (char) 0x90;
+                    if (debug) kprintf("%d %d %d %d\n", offset1, offset2, len, diff);
+                    assert_equal(strcmp_words(s1, s2), strcmp(s1, s2));
+                    assert_equal(sign(strcmp_words(s2, s1)), -sign(strcmp_words(s1, s2)));
+                    assert_equal(strncmp_words(s1, s2, diff), 0);
+                    assert_equal(strncmp_words(s1, s2, diff + 1), strncmp(s1, s2, diff + 1));
+                }
+
+                // Test: A string that is a prefix of the other is less
+                make_string(buf2, offset2, len + 1);
+                assert(strcmp_words(s1, s2) < 0, "A prefix is not less");
+                assert_equal(strcmp_words(s1, s2), strcmp(s1, s2));
+                assert_equal(strncmp_words(s1, s2, 0), 0);
+                assert_equal(strncmp_words(s1, s2, -1), 0);
+
+                // Test: Copies are cut short or padded with zero bytes as with
+                // strncpy, and nothing past n is written
+                for (int n = 0; n <= len + 6 && offset2 + n <= STRING_TEST_SIZE; n++) {
+                    for (int i = 0; i < STRING_TEST_SIZE; i++) {
+                        copy1[i] = copy2[i] = 'z';
+                    }
+                    assert(strncpy_words(copy1 + offset2, s1, n) == copy1 + offset2, "The buffer was not returned");
+                    strncpy(copy2 + offset2, s1, n);
+                    for (int i = 0; i < STRING_TEST_SIZE; i++) {
+                        assert_equal(copy1[i], copy2[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Writes a string of the given length into a test buffer at the given
+ * offset, followed by bytes that are not 0 so that a read past the end
+ * of the string would be noticed.
+ *------------------------------------------------------------------------
+ */
+static void make_string(char *buf, int offset, int len) {
+    for (int i = 0; i < STRING_TEST_SIZE; i++) {
+        buf[i] = 'a' + (i - offset) % 26;
+    }
+    buf[offset + len] = '\0';
+}
+
+/*------------------------------------------------------------------------
+ * Returns -1, 0 or 1 for a negative, zero or positive number.
+ *------------------------------------------------------------------------
+ */
+static int sign(int num) {
+    return num < 0 ? -1 : num > 0;
+}
@@ -1,6 +1,7 @@
 #include <xeroskernel.h>
-#include <deltalist.h>
+#include <timerwheel.h>
 #include <i386.h>
+#include <xeroslib.h>
 
 /*-----------------------------------------------------------------------------------
  * Tests for syscall.c. This test suite assumes that the root process and dispatcher
@@ -19,6 +20,7 @@ static void syssetprio_test(void);
 static void process_for_syssetprio_test(void);
 
 static void syscreate_test_bad_params(void);
+static void fastcall_test(void);
 static void syscreate_test_max_processes(void);
 static void syscall_test_factorial(void);
 static int factorial(int n);
@@ -27,6 +29,78 @@ static void factorial_test2(void);
 static void syssleep_test(void);
 static void sleep_process(void);
 static void sysgetcputimes_test(void);
+static void stack_usage_test(void);
+static void stack_using_process(void);
+static void sysgetmemstats_test(void);
+static void syssetquantum_test(void);
+static void syssend_handoff_test(void);
+static void handoff_receiver(void);
+static void priority_inheritance_test(void);
+static void inheriting_receiver(void);
+static int own_sched_priority(void);
+static void syssetrealtime_test(void);
+static void realtime_admission_process(void);
+static void syssettickets_test(void);
+static void sysgetsyscallstats_test(void);
+static void sysclock_test(void);
+static void ipc_timeout_test(void);
+static void timed_sender(void);
+static void systimer_test(void);
+static void count_timer_signal(void *arg);
+static void timer_arming_process(void);
+static void syssettimerslack_test(void);
+static void vectored_message_test(void);
+static void vectored_echo_process(void);
+static void large_receiver(void *arg);
+static void sysrpc_test(void);
+static void rpc_server(void);
+static void port_test(void);
+static void port_consumer(void);
+static void sysrecvset_test(void);
+static void silent_process(void);
+static void pid_sender(void);
+static void sysbatch_test(void);
+static void pid_receiver(void);
+static void ioring_test(void);
+static void queue_entry(io_ring_t *ring, int opcode, int fd, void *buf, int len);
+static int completion(io_ring_t *ring, unsigned int index);
+static void shm_test(void);
+static void shm_writer(void);
+static int free_pages(void);
+static void futex_test(void);
+static void futex_waiter(void);
+static void sync_test(void);
+static void mutex_worker(void);
+static void sem_cond_worker(void);
+static void coro_test(void);
+static void logging_coro(void *arg);
+static void blocking_coro(void *arg);
+static void coro_waker(void);
+static void syspoll_test(void);
+static void pipe_poll_writer(void);
+static void syssigprocmask_test(void);
+static void syssigqueue_test(void);
+static void record_queued_signal(void *cntx);
+static void systrace_test(void);
+static void sysprof_test(void);
+static void syslog_test(void);
+static void sysgetlatency_test(void);
+static void sysgetipcstats_test(void);
+static void process_for_sysgetipcstats_test(void);
+static void syscreatethread_test(void);
+static void pipe_writing_thread(void);
+static void sleeping_thread(void);
+static void thread_owner(void);
+static void sysspawn_test(void);
+static void spawned_process(void *arg);
+static void syswaitany_test(void);
+static void exiting_process(void *arg);
+static void reaping_process(void);
+static void pgrp_test(void);
+static void group_parent(void);
+static void sysaffinity_test(void);
+static void affinity_child(void *arg);
+static void pinned_child(void *arg);
 
 // Used for sysgetcputimes_test
 extern char *maxaddr;
@@ -36,7 +110,103 @@ static PID_t next_pid = NULL;
 static int const debug = 0;
 
 // Used for syssleep_test
-extern DeltaList sleep_queue;
+extern TimerWheel sleep_queue;
+
+// Used for syssend_handoff_test
+static int g_handoff_received;
+
+// Used for ipc_timeout_test
+static PID_t g_timed_receiver_pid;
+
+// Used for vectored_message_test
+#define ECHO_BUFFER_SIZE 100
+static PID_t g_echo_client_pid;
+static unsigned char g_large_message[MAX_MESSAGE_SIZE];
+static unsigned char g_large_received[MAX_MESSAGE_SIZE];
+
+// Used for sysrpc_test
+#define RPC_CALLS 5
+#define RPC_STOP 0
+
+// Used for port_test
+#define PORT_MESSAGES (PORT_SLOTS + 4)
+static int g_port;
+static unsigned long g_port_received[PORT_MESSAGES];
+static int g_port_consumer_result;
+
+// Used for stack_usage_test, less than the smallest stack
+#define STACK_USING_BYTES 1024
+
+// Used for sysrecvset_test, sysbatch_test and sysgetipcstats_test
+static PID_t g_pid_receiver;
+static PID_t g_pid_sender;
+
+// Used for shm_test
+#define SHM_SIZE (NBPG + 100)
+static int g_shm_id;
+
+// Used for futex_test and sync_test, the futexes are on the stack of the test since
+// the kernel refuses addresses in its own memory
+#define MUTEX_WORKERS 3
+#define MUTEX_ROUNDS 20
+static int *g_futex;
+static int g_futex_results;
+static mutex_t *g_mutex;
+static semaphore_t *g_sem;
+static cond_t *g_cond;
+static int g_counter;
+
+// Used for coro_test, the scheduler is on the stack of the test so the process can
+// wait on it in the kernel
+#define CORO_STACK_SIZE 1024
+#define CORO_ROUNDS 3
+static coro_sched_t *g_coro_sched;
+static coro_t g_coros[2];
+static unsigned long g_coro_stacks[2][CORO_STACK_SIZE / sizeof(unsigned long)];
+static char g_coro_log[2 * CORO_ROUNDS];
+static int g_coro_log_len;
+static coro_t *volatile g_blocked_coro;
+
+// Used for systimer_test and syssigprocmask_test
+#define TIMER_SIGNAL 20
+static int g_timer_signals;
+
+// Used for syssigqueue_test
+static int g_queued_values[SIGNAL_QUEUE_SIZE];
+static unsigned int g_queued_senders[SIGNAL_QUEUE_SIZE];
+static int g_queued_signals;
+
+// Used for syscreatethread_test
+static int g_thread_fd;
+static PID_t g_thread_pid;
+
+// Used for sysspawn_test
+typedef struct spawn_test_args {
+    int fd;
+    char text[8];
+} spawn_test_args_t;
+static spawn_test_args_t g_spawned_args;
+static void *g_spawned_arg;
+static int g_spawned_priority;
+static int g_spawned_write;
+
+// Used for syswaitany_test
+#define REAPED_WORKERS 4
+static PID_t g_worker_pids[REAPED_WORKERS];
+static PID_t g_reaped_pids[REAPED_WORKERS];
+static int g_reaped_statuses[REAPED_WORKERS];
+static int g_reap_result;
+
+// Used for pgrp_test
+#define GROUP_MEMBERS 2
+static PID_t g_pgid;
+static volatile PID_t g_group_child;
+
+// Used for priority_inheritance_test
+#define SENDER_PRIORITY 10
+#define RECEIVER_PRIORITY 20
+static int g_inherited_priority;
+static int g_released_priority;
 
 /*-----------------------------------------------------------------------------------
  * Runs the test suite for syscall.c.
@@ -48,10 +218,46 @@ void run_syscall_test(void) {
     sysgetpid_test();
     sysputs_test();
     syssetprio_test();
+    fastcall_test();
     syscreate_test_bad_params();
     syscall_test_factorial();
     syssleep_test();
     sysgetcputimes_test();
+    stack_usage_test();
+    sysgetmemstats_test();
+    syssetquantum_test();
+    syssend_handoff_test();
+    priority_inheritance_test();
+    syssetrealtime_test();
+    syssettickets_test();
+    sysgetsyscallstats_test();
+    sysclock_test();
+    ipc_timeout_test();
+    systimer_test();
+    syssettimerslack_test();
+    vectored_message_test();
+    sysrpc_test();
+    port_test();
+    sysrecvset_test();
+    sysbatch_test();
+    ioring_test();
+    shm_test();
+    futex_test();
+    sync_test();
+    coro_test();
+    syspoll_test();
+    syssigprocmask_test();
+    syssigqueue_test();
+    systrace_test();
+    sysprof_test();
+    syslog_test();
+    sysgetlatency_test();
+    sysgetipcstats_test();
+    syscreatethread_test();
+    sysspawn_test();
+    syswaitany_test();
+    pgrp_test();
+    sysaffinity_test();
     syscreate_test_max_processes();
 
     kprintf("Finished %s\n", __func__);
@@ -115,31 +321,591 @@ static void syssetprio_test(void) {
     kprintf("Finished %s\n", __func__);
 }
 
+/*-----------------------------------------------------------------------------------
+ * Tests that the fast system calls agree with the same calls made through the
+ * dispatcher.
+ *-----------------------------------------------------------------------------------
+ */
+static void fastcall_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: The fast path returns what the dispatcher returns
+    assert_equal(fastcall(SYSGETPID, 0), syscall(SYSGETPID));
+    assert_equal(fastcall(SYSSETPRIO, -1), syscall(SYSSETPRIO, -1));
+    assert_equal(sysgetpid(), syscall(SYSGETPID));
+
+    // Test: A priority set through the dispatcher is seen by the fast path
+    int old_priority = syssetprio(1);
+    assert_equal(syssetprio(-1), 1);
+    syssetprio(old_priority);
+    assert_equal(fastcall(SYSSETPRIO, -1), old_priority);
+
+    // Test: Calls that may block or reschedule are refused
+    assert_equal(fastcall(SYSSETPRIO, 0), -1);
+    assert_equal(fastcall(SYSSLEEP, TIME_SLICE), -1);
+
+    kprintf("Finished %s\n", __func__);
+}
+
 /*-----------------------------------------------------------------------------------
  * Used by syssetprio_test.
  *-----------------------------------------------------------------------------------
  */
 static void process_for_syssetprio_test(void) {
     int curr_priority = syssetprio(-1);
-    // 3 is the default priority when a process is created
-    assert_equal(curr_priority, 3);
+    // The lowest priority is the default priority when a process is created, the
+    // multilevel feedback scheduler starts processes at the highest priority
+    int init_priority = MLFQ_ENABLED ? 0 : INIT_PRIORITY;
+    assert_equal(curr_priority, init_priority);
 
     // Test: Error cases where requested priority is out of range
     if (debug) sysputs("Request priorities out of range...\n");
     assert_equal(syssetprio(-2), -1);
-    assert_equal(syssetprio(4), -1);
+    assert_equal(syssetprio(NUM_PRIORITIES), -1);
 
     if (debug) sysputs("Request priorities in the range...\n");
-    assert_equal(syssetprio(2), 3);
+    assert_equal(syssetprio(2), init_priority);
     assert_equal(syssetprio(1), 2);
     assert_equal(syssetprio(-1), 1);
     assert_equal(syssetprio(0), 1);
     assert_equal(syssetprio(-1), 0);
 
+    // Test: The whole range of priorities is usable
+    assert_equal(syssetprio(NUM_PRIORITIES - 1), 0);
+    assert_equal(syssetprio(-1), NUM_PRIORITIES - 1);
+
     sysstop();
     assert(0, "process_for_syssetprio_test is still executing after sysstop");
 }
 
+/*-----------------------------------------------------------------------------------
+ * Tests syslogctl and syslogread. The logger process is not running yet, so the
+ * records are left for the test to read.
+ *-----------------------------------------------------------------------------------
+ */
+static void syslog_test(void) {
+    kprintf("Running %s\n", __func__);
+    log_record_t records[4];
+
+    // Test: Invalid arguments
+    assert_equal(syslogctl(LOG_DEBUG + 1), -1);
+    assert_equal(syslogread(records, -1), -1);
+    assert_equal(syslogread((log_record_t *) HOLESTART, 4), -1);
+
+    // Test: The level is changed and restored, and the log can be read empty
+    int old_level = syslogctl(LOG_ERROR);
+    assert_equal(syslogctl(-1), LOG_ERROR);
+    assert_equal(syslogctl(old_level), LOG_ERROR);
+    while (syslogread(records, 4) > 0);
+    assert_equal(syslogread(records, 4), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysgetlatency.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysgetlatency_test(void) {
+    kprintf("Running %s\n", __func__);
+    latency_stats_t stats;
+
+    // Test: Invalid arguments
+    assert_equal(sysgetlatency(-1, &stats), -1);
+    assert_equal(sysgetlatency(ATA_INT + 1, &stats), -1);
+    assert_equal(sysgetlatency(SYSYIELD, (latency_stats_t *) HOLESTART), -2);
+
+    // Test: Every entry of the kernel through the dispatcher is counted with
+    // the time it then ran with interrupts disabled
+    assert_equal(sysgetlatency(SYSYIELD, &stats), 0);
+    unsigned long count = stats.count;
+    sysyield();
+    sysgetlatency(SYSYIELD, &stats);
+    assert(stats.count > count, "The yield was not counted");
+    assert(stats.max_cycles > 0, "The time in the kernel was not counted");
+    assert_equal(strcmp(stats.name, "yield"), 0);
+    call_sysgetlatency();
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysgetipcstats.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysgetipcstats_test(void) {
+    kprintf("Running %s\n", __func__);
+    ipc_stats_t stats;
+    g_pid_receiver = sysgetpid();
+
+    // Test: Invalid arguments
+    assert_equal(sysgetipcstats(-1, &stats), -1);
+    assert_equal(sysgetipcstats(g_pid_receiver, (ipc_stats_t *) HOLESTART), -2);
+
+    // Test: Senders are counted as they join the queue of senders
+    assert_equal(sysgetipcstats(g_pid_receiver, &stats), 0);
+    unsigned long waits = stats.senders.waits;
+    unsigned long long wait_cycles = stats.senders.wait_cycles;
+    assert_equal(stats.sender_depth, 0);
+    PID_t pid_1 = syscreate(&process_for_sysgetipcstats_test, PROCESS_STACK_SIZE);
+    PID_t pid_2 = syscreate(&process_for_sysgetipcstats_test, PROCESS_STACK_SIZE);
+    for (int i = 0; i < 10 && stats.sender_depth < 2; i++) {
+        sysyield();
+        sysgetipcstats(g_pid_receiver, &stats);
+    }
+    assert_equal(stats.sender_depth, 2);
+    assert_equal(stats.senders.waits, waits + 2);
+    assert(stats.senders.max_depth >= 2, "The depth of the queue was not counted");
+
+    // Test: The waits are counted as the messages are received
+    for (int i = 0; i < 2; i++) {
+        unsigned int from_pid = 0;
+        unsigned int num;
+        assert_equal(sysrecv(&from_pid, &num), 0);
+    }
+    sysgetipcstats(g_pid_receiver, &stats);
+    assert_equal(stats.sender_depth, 0);
+    assert(stats.senders.wait_cycles > wait_cycles, "The waits were not counted");
+    assert(stats.senders.max_wait_cycles > 0, "The longest wait was not counted");
+    syswait(pid_1);
+    syswait(pid_2);
+    call_sysgetipcstats();
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysgetipcstats_test to wait on the queue of senders of the test.
+ *-----------------------------------------------------------------------------------
+ */
+static void process_for_sysgetipcstats_test(void) {
+    assert_equal(syssend(g_pid_receiver, 1), 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syscreatethread, that a thread uses the file descriptors and signal handlers
+ * of the process that created it and is terminated along with it.
+ *-----------------------------------------------------------------------------------
+ */
+static void syscreatethread_test(void) {
+    kprintf("Running %s\n", __func__);
+    char buf[4];
+
+    // Invalid arguments
+    assert_equal(syscreatethread(NULL, MIN_THREAD_STACK_SIZE), -1);
+
+    // Test: A thread with the smallest stack writes to a pipe the test opened
+    g_thread_fd = sysopen(PIPE_1);
+    int fd2 = sysopen(PIPE_1);
+    assert(g_thread_fd >= 0 && fd2 >= 0, "sysopen of a pipe failed");
+    PID_t pid = syscreatethread(&pipe_writing_thread, 0);
+    assert(pid > 0, "syscreatethread failed");
+    assert_equal(syswait(pid), 0);
+    assert_equal(sysread(fd2, buf, sizeof(buf)), 1);
+    assert_equal(buf[0], 't');
+    // The descriptors stay open after the thread terminates
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(sysclose(g_thread_fd), 0);
+
+    // Test: A signal to a thread runs the handler the test installed
+    signal_handler_funcptr old_handler;
+    syssighandler(TIMER_SIGNAL, &count_timer_signal, &old_handler);
+    g_timer_signals = 0;
+    pid = syscreatethread(&sleeping_thread, MIN_THREAD_STACK_SIZE);
+    sysyield();
+    assert_equal(syskill(pid, TIMER_SIGNAL), 0);
+    assert_equal(syswait(pid), 0);
+    assert_equal(g_timer_signals, 1);
+    syssighandler(TIMER_SIGNAL, old_handler, &old_handler);
+
+    // Test: The threads of a process are terminated when it terminates
+    g_thread_pid = 0;
+    pid = syscreate(&thread_owner, PROCESS_STACK_SIZE);
+    assert_equal(syswait(pid), 0);
+    assert(g_thread_pid > 0, "syscreatethread failed");
+    syswait(g_thread_pid);
+    assert_equal(syskill(g_thread_pid, 0), -514);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syscreatethread_test to write a byte to the pipe its creator opened.
+ *-----------------------------------------------------------------------------------
+ */
+static void pipe_writing_thread(void) {
+    char c = 't';
+    assert_equal(syswrite(g_thread_fd, &c, 1), 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syscreatethread_test to sleep until it is signalled or terminated.
+ *-----------------------------------------------------------------------------------
+ */
+static void sleeping_thread(void) {
+    syssleep(100000);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syscreatethread_test to create a thread and terminate before it does.
+ *-----------------------------------------------------------------------------------
+ */
+static void thread_owner(void) {
+    g_thread_pid = syscreatethread(&sleeping_thread, MIN_THREAD_STACK_SIZE);
+    sysyield();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that sysspawn passes a copy of the argument block, starts the process at the
+ * given priority and gives it the file descriptors of the caller if asked to.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysspawn_test(void) {
+    kprintf("Running %s\n", __func__);
+    spawn_test_args_t block = {-1, "spawned"};
+    spawn_attr_t attr = {MIN_PROCESS_STACK_SIZE, -1, 0};
+    char buf[4];
+
+    // Invalid arguments
+    assert_equal(sysspawn(NULL, NULL, 0, NULL), -1);
+    assert_equal(sysspawn(&spawned_process, &block, SPAWN_MAX_ARGS + 1, NULL), -2);
+    assert_equal(sysspawn(&spawned_process, (void *) HOLESTART, sizeof(block), NULL), -2);
+    assert_equal(sysspawn(&spawned_process, &block, sizeof(block), (spawn_attr_t *) HOLESTART), -3);
+    attr.priority = NUM_PRIORITIES;
+    assert_equal(sysspawn(&spawned_process, &block, sizeof(block), &attr), -3);
+    attr.priority = -1;
+    attr.flags = SPAWN_INHERIT_FDS << 1;
+    assert_equal(sysspawn(&spawned_process, &block, sizeof(block), &attr), -3);
+
+    // Test: The process gets a copy of the block on its own stack, at the priority
+    // asked for, and the descriptors of the caller are not open in it
+    int fd = sysopen(PIPE_1);
+    int fd2 = sysopen(PIPE_1);
+    assert(fd >= 0 && fd2 >= 0, "sysopen of a pipe failed");
+    block.fd = fd;
+    attr.priority = 5;
+    attr.flags = 0;
+    PID_t pid = sysspawn(&spawned_process, &block, sizeof(block), &attr);
+    assert(pid > 0, "sysspawn failed");
+    block.text[0] = 'X';
+    assert_equal(syswait(pid), 0);
+    assert(g_spawned_arg != &block, "The block was not copied");
+    assert_equal(g_spawned_args.fd, fd);
+    assert_equal(strcmp_words(g_spawned_args.text, "spawned"), 0);
+    assert_equal(g_spawned_priority, 5);
+    assert_equal(g_spawned_write, -1);
+
+    // Test: With SPAWN_INHERIT_FDS the process writes to the pipe the caller opened,
+    // which stays open for the caller once the process has terminated
+    attr.priority = -1;
+    attr.flags = SPAWN_INHERIT_FDS;
+    pid = sysspawn(&spawned_process, &block, sizeof(block), &attr);
+    assert_equal(syswait(pid), 0);
+    assert_equal(g_spawned_write, 1);
+    assert_equal(sysread(fd2, buf, sizeof(buf)), 1);
+    assert_equal(buf[0], 'X');
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(sysclose(fd), 0);
+
+    // Test: Without a block, the argument is passed as it is
+    pid = sysspawn(&spawned_process, NULL, 0, NULL);
+    assert_equal(syswait(pid), 0);
+    assert(g_spawned_arg == NULL, "The argument was not passed");
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysspawn_test to record its argument and priority, and write the first
+ * char of its text to the descriptor in its block.
+ *-----------------------------------------------------------------------------------
+ */
+static void spawned_process(void *arg) {
+    g_spawned_arg = arg;
+    g_spawned_priority = syssetprio(-1);
+    if (arg != NULL) {
+        g_spawned_args = *(spawn_test_args_t *) arg;
+        g_spawned_write = syswrite(g_spawned_args.fd, g_spawned_args.text, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysexit and syswaitany.
+ *-----------------------------------------------------------------------------------
+ */
+static void syswaitany_test(void) {
+    kprintf("Running %s\n", __func__);
+    PID_t pids[2];
+    int status = -1;
+
+    // Invalid arguments, and a set with no children of the caller
+    pids[0] = sysgetpid();
+    assert_equal(syswaitany(pids, -1, NULL), -2);
+    assert_equal(syswaitany((PID_t *) HOLESTART, 1, NULL), -2);
+    assert_equal(syswaitany(pids, 1, (int *) HOLESTART), -2);
+    assert_equal(syswaitany(pids, 1, &status), -1);
+
+    // Test: A wait on a set returns the child in the set with its exit status, and
+    // leaves the exit of a child outside it to a later wait, which returns at once
+    pids[0] = sysspawn(&exiting_process, (void *) 3, 0, NULL);
+    pids[1] = sysspawn(&exiting_process, (void *) 1, 0, NULL);
+    assert(pids[0] > 0 && pids[1] > 0, "sysspawn failed");
+    assert_equal(syswaitany(&pids[0], 1, &status), pids[0]);
+    assert_equal(status, 3);
+    assert_equal(syswaitany(&pids[1], 1, &status), pids[1]);
+    assert_equal(status, 1);
+    assert_equal(syswaitany(pids, 2, &status), -1);
+
+    // Test: A child killed with signal 31 exits with EXIT_KILLED
+    pids[0] = sysspawn(&exiting_process, (void *) 1000, 0, NULL);
+    assert_equal(syskill(pids[0], SIGNAL_TABLE_SIZE - 1), 0);
+    assert_equal(syswaitany(pids, 1, &status), pids[0]);
+    assert_equal(status, EXIT_KILLED);
+
+    // Test: A process reaps all of its children with waits for any child, each
+    // one once, and a wait with none left fails
+    assert_equal(syswait(syscreate(&reaping_process, PROCESS_STACK_SIZE)), 0);
+    assert_equal(g_reap_result, -1);
+    for (int i = 0; i < REAPED_WORKERS; i++) {
+        int reaped = 0;
+        for (int j = 0; j < REAPED_WORKERS; j++) {
+            if (g_reaped_pids[j] == g_worker_pids[i]) {
+                assert_equal(g_reaped_statuses[j], i);
+                reaped++;
+            }
+        }
+        assert_equal(reaped, 1);
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syswaitany_test to sleep 10 ms for every unit of the exit status it is
+ * passed, then exit with it.
+ *-----------------------------------------------------------------------------------
+ */
+static void exiting_process(void *arg) {
+    int status = (int) arg;
+    syssleep(status * 10);
+    sysexit(status);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syswaitany_test to start REAPED_WORKERS children and wait for any child
+ * until none remains.
+ *-----------------------------------------------------------------------------------
+ */
+static void reaping_process(void) {
+    for (int i = 0; i < REAPED_WORKERS; i++) {
+        g_worker_pids[i] = sysspawn(&exiting_process, (void *) i, 0, NULL);
+    }
+    for (int i = 0; i < REAPED_WORKERS; i++) {
+        g_reaped_pids[i] = syswaitany(NULL, 0, &g_reaped_statuses[i]);
+    }
+    g_reap_result = syswaitany(NULL, 0, NULL);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssetpgid, sysgetpgid, syskillpg and syswaitpg.
+ *-----------------------------------------------------------------------------------
+ */
+static void pgrp_test(void) {
+    kprintf("Running %s\n", __func__);
+    int status;
+
+    // Invalid arguments
+    assert_equal(syssetpgid(MAX_PROCESSES * 1000, 0), -1);
+    assert_equal(syssetpgid(0, sysgetpid() + MAX_PROCESSES), -2);
+    assert_equal(sysgetpgid(MAX_PROCESSES * 1000), -1);
+    assert_equal(syskillpg(MAX_PROCESSES * 1000, 31), -514);
+    assert_equal(syswaitpg(0, NULL), -2);
+
+    // Test: A child makes a group named after it that other children can join, and
+    // the children of a member start in its group
+    g_pgid = sysspawn(&exiting_process, (void *) 1000, 0, NULL);
+    assert_equal(syssetpgid(g_pgid, 0), 0);
+    assert_equal(sysgetpgid(g_pgid), g_pgid);
+    for (int i = 0; i < GROUP_MEMBERS; i++) {
+        PID_t pid = sysspawn(&exiting_process, (void *) 1000, 0, NULL);
+        assert_equal(syssetpgid(pid, g_pgid), 0);
+    }
+    g_group_child = 0;
+    syscreate(&group_parent, PROCESS_STACK_SIZE);
+    while (g_group_child == 0) {
+        sysyield();
+    }
+    assert_equal(sysgetpgid(g_group_child), g_pgid);
+    assert_equal(syssetpgid(g_group_child, 0), -1);
+    assert_equal(syskillpg(g_pgid, SIGNAL_TABLE_SIZE), -583);
+
+    // Test: One call kills the whole group, grandchild included, and the children in
+    // it are reaped by group until none remains
+    assert_equal(syskillpg(g_pgid, 31), GROUP_MEMBERS + 3);
+    for (int i = 0; i < GROUP_MEMBERS + 2; i++) {
+        status = 0;
+        assert(syswaitpg(g_pgid, &status) > 0, "syswaitpg failed");
+        assert_equal(status, EXIT_KILLED);
+    }
+    assert_equal(syswaitpg(g_pgid, &status), -1);
+    syswait(g_group_child);
+    assert_equal(sysgetpgid(g_group_child), -1);
+    assert_equal(syskillpg(g_pgid, 31), -514);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by pgrp_test to join the group of the test and start a child, which is
+ * in the group without joining it.
+ *-----------------------------------------------------------------------------------
+ */
+static void group_parent(void) {
+    assert_equal(syssetpgid(0, g_pgid), 0);
+    g_group_child = sysspawn(&exiting_process, (void *) 1000, 0, NULL);
+    syssleep(10000);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssetaffinity and sysgetaffinity.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysaffinity_test(void) {
+    kprintf("Running %s\n", __func__);
+    int status;
+
+    // Invalid arguments
+    assert_equal(syssetaffinity(MAX_PROCESSES * 1000, 1), -1);
+    assert_equal(sysgetaffinity(MAX_PROCESSES * 1000), -1);
+    assert_equal(syssetaffinity(0, 0), -2);
+    assert_equal(syssetaffinity(0, ALL_CPUS & ~smp_cpu_mask()), -2);
+
+    // Test: The test runs where it was made ready and may run on every processor
+    // that is not isolated
+    int affinity = sysgetaffinity(0);
+    assert_equal(affinity, ALL_CPUS & ~ISOLATED_CPUS);
+    assert_equal(sysgetaffinity(sysgetpid()), affinity);
+
+    // Test: A pinned process still runs, processors past MAX_CPUS are dropped and a
+    // child inherits the mask of its parent
+    assert_equal(syssetaffinity(0, ~0UL), 0);
+    assert_equal(sysgetaffinity(0), ALL_CPUS);
+    assert_equal(syssetaffinity(0, 1), 0);
+    assert_equal(sysgetaffinity(0), 1);
+    sysyield();
+    assert(this_cpu()->index == 0, "The test runs on a processor it is not pinned to");
+    PID_t pid = sysspawn(&affinity_child, NULL, 0, NULL);
+    assert(pid > 0, "sysspawn failed");
+    assert_equal(syswaitany(&pid, 1, &status), pid);
+    assert_equal(status, 1);
+
+    // Test: On more than one processor, a process pinned to any processor running
+    // the dispatcher runs there
+    if (SMP_ENABLED && !PAGING_ENABLED) {
+        assert(smp_cpu_count() > 1, "Only the boot processor was started");
+    }
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        pid = sysspawn(&pinned_child, (void *) i, 0, NULL);
+        assert(pid > 0, "sysspawn failed");
+        assert_equal(syswaitany(&pid, 1, &status), pid);
+        assert_equal(status, i);
+    }
+
+    // Test: The mask of another process can be set
+    pid = sysspawn(&exiting_process, (void *) 1000, 0, NULL);
+    assert_equal(syssetaffinity(pid, smp_cpu_mask()), 0);
+    assert_equal(sysgetaffinity(pid), smp_cpu_mask());
+    assert_equal(syskill(pid, 31), 0);
+    assert_equal(syswaitany(&pid, 1, &status), pid);
+    assert_equal(status, EXIT_KILLED);
+
+    assert_equal(syssetaffinity(0, affinity), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysaffinity_test to exit with the affinity it inherited.
+ *-----------------------------------------------------------------------------------
+ */
+static void affinity_child(void *arg) {
+    sysexit(sysgetaffinity(0));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysaffinity_test to pin itself to the processor with the given index, and
+ * exit with the index of the processor it then runs on.
+ *-----------------------------------------------------------------------------------
+ */
+static void pinned_child(void *arg) {
+    assert_equal(syssetaffinity(0, 1UL << (int) arg), 0);
+    sysyield();
+    sysexit(this_cpu()->index);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysprofstart, sysprofstop and sysprofread.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysprof_test(void) {
+    kprintf("Running %s\n", __func__);
+    // Too large for the stack
+    static profile_t profile;
+
+    // Test: Invalid arguments
+    assert_equal(sysprofstart(MAX_PROCESSES + 100), -1);
+    assert_equal(sysprofread((profile_t *) HOLESTART), -1);
+    assert_equal(sysprofread((profile_t *) (maxaddr + 1)), -1);
+
+    // Test: The profiler samples the given process until it is stopped
+    assert_equal(sysprofstop(), -1);
+    assert_equal(sysprofstart(sysgetpid()), 0);
+    assert_equal(sysprofread(&profile), 0);
+    assert_equal(profile.running, 1);
+    assert_equal(profile.pid, sysgetpid());
+    assert_equal(sysprofstop(), 0);
+    assert_equal(sysprofread(&profile), 0);
+    assert_equal(profile.running, 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests systracectl and systraceread.
+ *-----------------------------------------------------------------------------------
+ */
+static void systrace_test(void) {
+    kprintf("Running %s\n", __func__);
+    trace_event_t events[8];
+    unsigned long cursor = 0;
+
+    // Test: Invalid arguments
+    assert_equal(systracectl(TRACE_ALL + 1), -1);
+    assert_equal(systraceread(&cursor, events, -1), -1);
+    assert_equal(systraceread((unsigned long *) HOLESTART, events, 8), -1);
+    assert_equal(systraceread(&cursor, (trace_event_t *) HOLESTART, 8), -1);
+
+    // Test: The system calls made while they are traced are recorded with the PID of
+    // the caller, and nothing is recorded once tracing is disabled again
+    int old_mask = systracectl(TRACE_SYSCALL);
+    sysyield();
+    systracectl(old_mask);
+    int found = 0;
+    int count;
+    while ((count = systraceread(&cursor, events, 8)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (events[i].type == TRACE_SYSCALL_ENTER && events[i].arg0 == SYSYIELD) {
+                assert_equal(events[i].pid, sysgetpid());
+                found = 1;
+            }
+        }
+    }
+    assert(found, "The sysyield was not traced");
+    assert_equal(systraceread(&cursor, events, 8), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
 /*-----------------------------------------------------------------------------------
  * Keeps creating new processes until the maximum is reached. Verifies
  * that the correct error code is returned.
@@ -154,7 +920,7 @@ static void syscreate_test_max_processes(void) {
     int count = 0;
 
     do {
-        result = syscreate(&dummy_process, PROCESS_STACK_SIZE);
+        result = syscreate(&dummy_process, MIN_PROCESS_STACK_SIZE);
         if (result == -1) {
             if (debug) sysputs("syscreate returned -1\n");
         } else {
@@ -163,9 +929,11 @@ static void syscreate_test_max_processes(void) {
         }
     } while (result >= 1);
     assert_equal(result, -1);
-    // The root process is the only process before this test runs,
-    // so we should be able to create 31 processes
-    assert_equal(count, PCB_TABLE_SIZE - 1);
+    // The root process and the work process are the only processes before this test
+    // runs, so we should be able to create processes until the PCB table is full, past
+    // its first chunk. With paging every stack also takes one of the stack slots, which
+    // run out first.
+    assert_equal(count, (PAGING_ENABLED ? NUM_VSTACK_SLOTS : MAX_PROCESSES) - 2);
 
     // Clean up created dummy processes
     yield_to_all();
@@ -268,12 +1036,11 @@ static void syscall_test_factorial(void) {
 static void syssleep_test(void) {
     kprintf("Running %s\n", __func__);
     unsigned int pid = syscreate(&sleep_process, PROCESS_STACK_SIZE);
-    assert(delta_is_empty(&sleep_queue), "sleep_queue is not empty");
-    assert_equal(delta_size(&sleep_queue), 0);
+    assert_equal(wheel_size(&sleep_queue), 0);
     sysyield();
-    assert_equal(delta_size(&sleep_queue), 1);
+    assert_equal(wheel_size(&sleep_queue), 1);
     syskill(pid, 31);
-    assert(delta_is_empty(&sleep_queue), "sleep_queue is not empty");
+    assert_equal(wheel_size(&sleep_queue), 0);
 
     kprintf("Finished %s\n", __func__);
 }
@@ -299,20 +1066,1549 @@ static void sysgetcputimes_test(void) {
     assert(sysgetcputimes((processStatuses *) (maxaddr + 1)) == -2, "Invalid address, beyond the end of main memory");
     assert(sysgetcputimes((processStatuses *) HOLESTART) == -1, "Invalid address, in the hole region");
 
-    processStatuses ps;
+    // Too large for the stack with the accounting of every process
+    static char space[PS_SIZE(PCB_CHUNK_SIZE)];
+    processStatuses *ps = (processStatuses *) space;
+
+    // Invalid size
+    ps->size = 0;
+    assert_equal(sysgetcputimes(ps), -2);
+    ps->size = MAX_PROCESSES + 2;
+    assert_equal(sysgetcputimes(ps), -2);
 
     // Valid cases
-    int last_slot_used1 = sysgetcputimes(&ps);
-    assert(last_slot_used1 >= 0 && last_slot_used1 < PCB_TABLE_SIZE, "Return value of sysgetcputimes is not expected");
+    ps->size = PCB_CHUNK_SIZE;
+    int last_slot_used1 = sysgetcputimes(ps);
+    assert(last_slot_used1 >= 0 && last_slot_used1 < PCB_CHUNK_SIZE, "Return value of sysgetcputimes is not expected");
+    assert_equal(ps->entries, last_slot_used1 + 1);
+    assert_equal(ps->proc[last_slot_used1].pid, 0);
     // Check that the printed information is reasonable
     call_sysgetcputimes();
 
+    // Test: The call is only serviced on the stack of the process, which refuses the
+    // calls it does not service
+    assert_equal(syscall(SYSGETCPUTIMES, ps), -1);
+    assert_equal(preemptcall(SYSGETCPUTIMES, (int) ps), last_slot_used1);
+    assert_equal(preemptcall(SYSGETPID, 0), -1);
+
     sysputs("Creating more processes...\n");
 
     syscreate(&dummy_process, PROCESS_STACK_SIZE);
     syscreate(&dummy_process, PROCESS_STACK_SIZE);
     call_sysgetcputimes();
 
+    // Test: A table too small for every process only reports the first ones and the
+    // idle process, but counts them all
+    int last_slot_used2 = sysgetcputimes(ps);
+    ps->size = 2;
+    assert_equal(sysgetcputimes(ps), 1);
+    assert_equal(ps->entries, last_slot_used2 + 1);
+    assert(ps->proc[0].pid != 0, "The first slot is not a user process");
+    assert_equal(ps->proc[1].pid, 0);
+    yield_to_all();
+
+    // Test: A process that went to sleep made a system call, was switched out
+    // through it, and has been blocked on the sleep queue since
+    proc_status_t status;
+    PID_t pid = syscreate(&sleep_process, PROCESS_STACK_SIZE);
+    sysyield();
+    assert_equal(get_process_status(pid, &status), 0);
+    assert_equal(status.state, BLOCKED);
+    assert(status.syscalls >= 1, "The system call of the sleeper was not counted");
+    assert(status.voluntarySwitches >= 1, "The sleeper was not switched out voluntarily");
+    assert(status.runCycles > 0, "The run time of the sleeper was not counted");
+    assert(status.blockedCycles[SLEEP] > 0, "The time asleep was not counted");
+    assert(status.blockedCycles[WAIT] == 0, "Time was counted on the wrong blocked queue");
+    unsigned long long asleep = status.blockedCycles[SLEEP];
+    get_process_status(pid, &status);
+    assert(status.blockedCycles[SLEEP] > asleep, "The time asleep does not keep counting");
+    syskill(pid, 31);
+
+    // Test: Every system call of the calling process is counted, fast calls included
+    get_process_status(sysgetpid(), &status);
+    unsigned int syscalls = status.syscalls;
+    sysgetpid();
+    sysputs("");
+    get_process_status(sysgetpid(), &status);
+    // sysgetpid, sysputs, sysgetpid and the second sysgetcputimes, the first one was
+    // counted before it read the table
+    assert_equal(status.syscalls - syscalls, 4);
+    call_sysgetaccounting();
+
+    yield_to_all();
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests the peak stack usage sysgetcputimes reports.
+ *-----------------------------------------------------------------------------------
+ */
+static void stack_usage_test(void) {
+    kprintf("Running %s\n", __func__);
+    proc_status_t status;
+
+    // Test: A process that has not run yet has only used its initial context frame
+    // and return address, whatever the size of its stack
+    PID_t pids[2];
+    pids[0] = syscreate(&dummy_process, PROCESS_STACK_SIZE);
+    pids[1] = syscreate(&dummy_process, MIN_PROCESS_STACK_SIZE);
+    for (int i = 0; i < 2; i++) {
+        assert_equal(get_process_status(pids[i], &status), 0);
+        assert(status.stackUsage >= sizeof(context_frame_t) + sizeof(funcptr), "Stack usage is too small");
+        assert(status.stackUsage < STACK_USING_BYTES, "Stack usage counts unused stack");
+    }
     yield_to_all();
+
+    // Test: The deepest word a process has written is reported, and stays reported
+    // once the stack has unwound
+    PID_t pid = syscreate(&stack_using_process, MIN_PROCESS_STACK_SIZE);
+    sysyield();
+    assert_equal(get_process_status(pid, &status), 0);
+    assert(status.stackUsage >= STACK_USING_BYTES, "Stack usage misses the deepest write");
+    assert(status.stackUsage <= MIN_PROCESS_STACK_SIZE, "Stack usage is larger than the stack");
+    syskill(pid, 31);
+    syswait(pid);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by stack_usage_test to write STACK_USING_BYTES of its stack, then sleep until
+ * it is terminated.
+ *-----------------------------------------------------------------------------------
+ */
+static void stack_using_process(void) {
+    char bytes[STACK_USING_BYTES];
+    memset(bytes, 0, sizeof(bytes));
+    syssleep(90000000);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysgetmemstats.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysgetmemstats_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Invalid address
+    assert_equal(sysgetmemstats(NULL), -1);
+    assert_equal(sysgetmemstats((mem_stats_t *) HOLESTART), -1);
+
+    // Valid case
+    mem_stats_t stats;
+    assert_equal(sysgetmemstats(&stats), 0);
+    assert(stats.bytes_in_use > 0, "Process stacks are not counted as in use");
+    assert(stats.largest_free_block <= stats.pre_hole_free_bytes + stats.post_hole_free_bytes,
+           "Largest free block is larger than the free memory");
+    // Check that the printed information is reasonable
+    call_sysgetmemstats();
+
     kprintf("Finished %s\n", __func__);
 }
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssetquantum.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssetquantum_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: Error cases where requested quantum is out of range
+    assert_equal(syssetquantum(-1), -1);
+    assert_equal(syssetquantum(MAX_PROCESS_QUANTUM + 1), -1);
+
+    // Test: The quantum is rounded up to whole time slices
+    assert_equal(syssetquantum(TIME_SLICE * 2 + 1), 0);
+    assert_equal(syssetquantum(TIME_SLICE * 5), TIME_SLICE * 3);
+
+    // Test: The time left in the quantum is reported and does not exceed the quantum
+    proc_status_t status;
+    assert_equal(get_process_status(sysgetpid(), &status), 0);
+    assert(status.quantumLeft > 0 && status.quantumLeft <= TIME_SLICE * 5,
+           "Time left in the quantum is out of range");
+
+    // Go back to the quantum of the priority
+    assert_equal(syssetquantum(0), TIME_SLICE * 5);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that a send to a blocked receiver switches directly to the receiver.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssend_handoff_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    g_handoff_received = 0;
+    PID_t pid = syscreate(&handoff_receiver, PROCESS_STACK_SIZE);
+
+    // Wait for the receiver to block on its receive
+    int blocked = 0;
+    while (!blocked) {
+        sysyield();
+        proc_status_t status;
+        if (get_process_status(pid, &status) == 0) {
+            blocked = status.state == BLOCKED;
+        }
+    }
+
+    proc_status_t status;
+    get_process_status(sysgetpid(), &status);
+    unsigned int sent = status.messagesSent;
+
+    // Test: The receiver has run by the time the send returns
+    assert_equal(syssend(pid, 42), 0);
+    assert_equal(g_handoff_received, 42);
+
+    // Test: The delivered message was counted for the sender
+    get_process_status(sysgetpid(), &status);
+    assert_equal(status.messagesSent - sent, 1);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syssend_handoff_test to receive a single message.
+ *-----------------------------------------------------------------------------------
+ */
+static void handoff_receiver(void) {
+    unsigned int from_pid = 0;
+    unsigned int num = 0;
+    if (sysrecv(&from_pid, &num) == 0) {
+        g_handoff_received = num;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that a process inherits the priority of a sender blocked on it, and drops
+ * back to its own priority when the sender is released.
+ *-----------------------------------------------------------------------------------
+ */
+static void priority_inheritance_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    g_inherited_priority = -1;
+    g_released_priority = -1;
+    PID_t pid = syscreate(&inheriting_receiver, PROCESS_STACK_SIZE);
+    // Let the receiver lower its priority and go to sleep
+    sysyield();
+
+    // Block on the receiver at a higher priority than the receiver
+    int old_priority = syssetprio(SENDER_PRIORITY);
+    assert_equal(syssend(pid, 1), 0);
+    while (g_released_priority == -1) {
+        syssleep(TIME_SLICE);
+    }
+    syssetprio(old_priority);
+
+    // Test: The receiver ran at the priority of the sender until it was released
+    assert_equal(g_inherited_priority, SENDER_PRIORITY);
+    assert_equal(g_released_priority, RECEIVER_PRIORITY);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by priority_inheritance_test to record its priority while a sender is
+ * blocked on it and after it has received from the sender.
+ *-----------------------------------------------------------------------------------
+ */
+static void inheriting_receiver(void) {
+    syssetprio(RECEIVER_PRIORITY);
+    syssleep(5 * TIME_SLICE);
+    g_inherited_priority = own_sched_priority();
+
+    unsigned int from_pid = 0;
+    unsigned int num = 0;
+    sysrecv(&from_pid, &num);
+    g_released_priority = own_sched_priority();
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the priority the calling process is scheduled at.
+ *-----------------------------------------------------------------------------------
+ */
+static int own_sched_priority(void) {
+    proc_status_t status;
+    if (get_process_status(sysgetpid(), &status) == 0) {
+        return status.priority;
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssetrealtime.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssetrealtime_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: Error cases where the period or budget is invalid
+    assert_equal(syssetrealtime(-1, 10), -1);
+    assert_equal(syssetrealtime(MAX_REALTIME_PERIOD + 1, 10), -1);
+    assert_equal(syssetrealtime(100, 0), -1);
+    assert_equal(syssetrealtime(100, 200), -1);
+
+    // Test: A process is admitted while the total utilization is at most 100%
+    assert_equal(syssetrealtime(10 * TIME_SLICE, 6 * TIME_SLICE), 0);
+    // The other process is rejected as it would take the utilization to 110%
+    PID_t pid = syscreate(&realtime_admission_process, PROCESS_STACK_SIZE);
+    syswait(pid);
+
+    // Test: Changing the budget of an admitted process replaces its utilization
+    assert_equal(syssetrealtime(10 * TIME_SLICE, 10 * TIME_SLICE), 0);
+
+    // Test: Leaving the real-time class frees its utilization
+    assert_equal(syssetrealtime(0, 0), 0);
+    assert_equal(syssetrealtime(TIME_SLICE, TIME_SLICE), 0);
+    assert_equal(syssetrealtime(0, 0), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syssetrealtime_test to request a utilization that cannot be admitted.
+ *-----------------------------------------------------------------------------------
+ */
+static void realtime_admission_process(void) {
+    assert_equal(syssetrealtime(10 * TIME_SLICE, 5 * TIME_SLICE), -2);
+    assert_equal(syssetrealtime(10 * TIME_SLICE, 4 * TIME_SLICE), 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssettickets.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssettickets_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Test: Error cases where the number of tickets is out of range
+    assert_equal(syssettickets(0), -1);
+    assert_equal(syssettickets(MAX_TICKETS + 1), -1);
+
+    // Test: A process starts with the default tickets, the previous number is returned
+    assert_equal(syssettickets(MAX_TICKETS), DEFAULT_TICKETS);
+    assert_equal(syssettickets(1), MAX_TICKETS);
+    assert_equal(syssettickets(DEFAULT_TICKETS), 1);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysgetsyscallstats.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysgetsyscallstats_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Invalid system calls and addresses
+    syscall_stats_t stats;
+    assert_equal(sysgetsyscallstats(-1, &stats), -1);
+    assert_equal(sysgetsyscallstats(TIMER_INT, &stats), -1);
+    assert_equal(sysgetsyscallstats(SYSGETMEMSTATS, (syscall_stats_t *) HOLESTART), -2);
+
+    // Test: Every call made is counted and lands in one bucket of the histogram
+    assert_equal(sysgetsyscallstats(SYSGETMEMSTATS, &stats), 0);
+    assert_equal(strcmp(stats.name, "getmemstats"), 0);
+    unsigned long count = stats.count;
+    mem_stats_t mem_stats;
+    for (int i = 0; i < 3; i++) {
+        sysgetmemstats(&mem_stats);
+    }
+    assert_equal(sysgetsyscallstats(SYSGETMEMSTATS, &stats), 0);
+    assert_equal(stats.count, count + 3);
+    unsigned long total = 0;
+    for (int i = 0; i < SYSCALL_HISTOGRAM_BUCKETS; i++) {
+        total += stats.histogram[i];
+    }
+    assert_equal(total, stats.count);
+    assert(stats.max_cycles > 0, "No cycles were recorded");
+
+    // Test: A system call that is already registered cannot be replaced
+    assert_equal(register_syscall(SYSGETMEMSTATS, "other", &sysyield), -1);
+    // Check that the printed information is reasonable
+    call_sysgetsyscallstats();
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysclock and sysusleep.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysclock_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Invalid address
+    assert_equal(sysclock((unsigned long long *) HOLESTART), -1);
+
+    // Test: The clock never goes back
+    unsigned long long prev;
+    unsigned long long now;
+    assert_equal(sysclock(&prev), 0);
+    for (int i = 0; i < 1000; i++) {
+        sysclock(&now);
+        assert(now >= prev, "The clock went back");
+        prev = now;
+    }
+
+    // Test: The clock resolves time within a time slice
+    unsigned long long start;
+    sysclock(&start);
+    do {
+        sysclock(&now);
+    } while (now == start);
+    assert(now - start < TIME_SLICE * 1000, "The clock only advances by whole time slices");
+
+    // Test: Short and long waits take at least the time requested, and short waits
+    // do not wait for the next time slice
+    unsigned int waits[] = {300, 1500, 5 * TIME_SLICE * 1000 + 700};
+    for (int i = 0; i < sizeof(waits) / sizeof(waits[0]); i++) {
+        sysclock(&start);
+        assert_equal(sysusleep(waits[i]), 0);
+        sysclock(&now);
+        assert(now - start >= waits[i], "sysusleep returned early");
+        assert(now - start < waits[i] + TIME_SLICE * 1000, "sysusleep overslept");
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssendtim and sysrecvtim.
+ *-----------------------------------------------------------------------------------
+ */
+static void ipc_timeout_test(void) {
+    kprintf("Running %s\n", __func__);
+    unsigned long long start;
+    unsigned long long now;
+    unsigned int from_pid;
+    unsigned int num;
+
+    // Test: A receive from any process times out when nothing is sent, and is
+    // taken off the timing wheel
+    PID_t pid = syscreate(&sleep_process, PROCESS_STACK_SIZE);
+    sysclock(&start);
+    from_pid = 0;
+    assert_equal(sysrecvtim(&from_pid, &num, 3 * TIME_SLICE), TIMEOUT);
+    sysclock(&now);
+    assert(now - start >= 2 * TIME_SLICE * 1000, "sysrecvtim returned early");
+    assert_equal(wheel_size(&sleep_queue), 1);
+
+    // Test: A receive from a process that never sends times out
+    from_pid = pid;
+    assert_equal(sysrecvtim(&from_pid, &num, TIME_SLICE), TIMEOUT);
+    assert_equal(wheel_size(&sleep_queue), 1);
+
+    // Test: A send to a process that never receives times out
+    assert_equal(syssendtim(pid, 7, 0), TIMEOUT);
+    assert_equal(wheel_size(&sleep_queue), 1);
+    syskill(pid, 31);
+
+    // Test: A send performed before the timeout completes the receive and cancels
+    // the timeout
+    g_timed_receiver_pid = sysgetpid();
+    pid = syscreate(&timed_sender, PROCESS_STACK_SIZE);
+    from_pid = pid;
+    num = 0;
+    assert_equal(sysrecvtim(&from_pid, &num, 1000 * TIME_SLICE), 0);
+    assert_equal(num, 42);
+    assert_equal(wheel_size(&sleep_queue), 0);
+
+    // Test: A receive performed before the timeout completes the send and cancels
+    // the timeout
+    assert_equal(syssendtim(pid, 43, 1000 * TIME_SLICE), 0);
+    assert_equal(wheel_size(&sleep_queue), 0);
+    syswait(pid);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by ipc_timeout_test to send a message to the test process once it is
+ * blocked on its receive, then to receive one from it.
+ *-----------------------------------------------------------------------------------
+ */
+static void timed_sender(void) {
+    syssend(g_timed_receiver_pid, 42);
+    unsigned int from_pid = g_timed_receiver_pid;
+    unsigned int num;
+    sysrecv(&from_pid, &num);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests systimer and systimercancel.
+ *-----------------------------------------------------------------------------------
+ */
+static void systimer_test(void) {
+    kprintf("Running %s\n", __func__);
+    PID_t pid = sysgetpid();
+    signal_handler_funcptr old_handler;
+    syssighandler(TIMER_SIGNAL, &count_timer_signal, &old_handler);
+
+    // Invalid arguments
+    assert_equal(systimer(-1, TIMER_SIGNAL, TIME_SLICE, 0), -514);
+    assert_equal(systimer(pid, SIGNAL_TABLE_SIZE, TIME_SLICE, 0), -583);
+    assert_equal(systimercancel(-1), -1);
+    assert_equal(systimercancel(MAX_TIMERS), -1);
+
+    // Test: A one-shot timer delivers its signal once, without a process sleeping for
+    // it, and is freed when it expires
+    g_timer_signals = 0;
+    int timer_id = systimer(pid, TIMER_SIGNAL, 2 * TIME_SLICE, 0);
+    assert(timer_id >= 0, "systimer failed");
+    assert_equal(wheel_size(&sleep_queue), 1);
+    assert(syssleep(100 * TIME_SLICE) > 0, "The timer did not interrupt the sleep");
+    assert_equal(g_timer_signals, 1);
+    assert_equal(wheel_size(&sleep_queue), 0);
+    assert_equal(systimercancel(timer_id), -1);
+
+    // Test: A timer interrupts sysusleep the same way, which returns the milliseconds
+    // it had left
+    g_timer_signals = 0;
+    timer_id = systimer(pid, TIMER_SIGNAL, 2 * TIME_SLICE, 0);
+    assert(timer_id >= 0, "systimer failed");
+    unsigned int left = sysusleep(100 * TIME_SLICE * 1000);
+    assert(left > 0 && left <= 100 * TIME_SLICE, "The timer did not interrupt the sleep");
+    assert_equal(g_timer_signals, 1);
+    assert_equal(wheel_size(&sleep_queue), 0);
+
+    // Test: A periodic timer expires once every period until it is cancelled
+    g_timer_signals = 0;
+    unsigned long long start;
+    unsigned long long now;
+    sysclock(&start);
+    timer_id = systimer(pid, TIMER_SIGNAL, TIME_SLICE, 2 * TIME_SLICE);
+    while (g_timer_signals < 4) {
+        sysyield();
+    }
+    sysclock(&now);
+    assert(now - start >= 6 * TIME_SLICE * 1000, "The periodic timer expired early");
+    assert_equal(systimercancel(timer_id), 0);
+    assert_equal(wheel_size(&sleep_queue), 0);
+
+    // Test: Arming fails once every timer is in use
+    int timer_ids[MAX_TIMERS];
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        timer_ids[i] = systimer(pid, TIMER_SIGNAL, 1000 * TIME_SLICE, 0);
+        assert(timer_ids[i] >= 0, "systimer failed");
+    }
+    assert_equal(systimer(pid, TIMER_SIGNAL, 1000 * TIME_SLICE, 0), -1);
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        assert_equal(systimercancel(timer_ids[i]), 0);
+    }
+
+    // Test: The timers of a process are freed when it terminates
+    syswait(syscreate(&timer_arming_process, PROCESS_STACK_SIZE));
+    assert_equal(wheel_size(&sleep_queue), 0);
+
+    syssighandler(TIMER_SIGNAL, old_handler, &old_handler);
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by systimer_test to count the signals delivered by timers.
+ *-----------------------------------------------------------------------------------
+ */
+static void count_timer_signal(void *arg) {
+    g_timer_signals++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by systimer_test to arm a timer and terminate before it expires.
+ *-----------------------------------------------------------------------------------
+ */
+static void timer_arming_process(void) {
+    systimer(sysgetpid(), TIMER_SIGNAL, 1000 * TIME_SLICE, 1000 * TIME_SLICE);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssettimerslack.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssettimerslack_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Out of range
+    assert_equal(syssettimerslack(MAX_TIMER_SLACK + 1), -1);
+
+    // Test: The slack is rounded up to whole time slices and the previous slack is
+    // returned
+    assert_equal(syssettimerslack(1), 0);
+    assert_equal(syssettimerslack(7 * TIME_SLICE), TIME_SLICE);
+
+    // Test: With a slack of 7 time slices, every window holds a tick that is a
+    // multiple of 8, and the sleep is moved to it
+    for (int i = 0; i < 4; i++) {
+        unsigned long long start = sleep_queue.now;
+        assert_equal(syssleep((i + 1) * TIME_SLICE), 0);
+        assert_equal((int) (sleep_queue.now & 7), 0);
+        assert(sleep_queue.now - start >= i + 1, "The sleep was shortened");
+        assert(sleep_queue.now - start <= i + 8, "The sleep was extended past its slack");
+    }
+
+    assert_equal(syssettimerslack(0), 7 * TIME_SLICE);
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests syssendv and sysrecvv.
+ *-----------------------------------------------------------------------------------
+ */
+static void vectored_message_test(void) {
+    kprintf("Running %s\n", __func__);
+    unsigned char message[ECHO_BUFFER_SIZE + 1];
+    unsigned char reply[ECHO_BUFFER_SIZE + 1];
+    for (int i = 0; i < sizeof(message); i++) {
+        // Zero bytes do not end the message
+        message[i] = i % 3 == 0 ? 0 : i;
+    }
+    g_echo_client_pid = sysgetpid();
+    PID_t pid = syscreate(&vectored_echo_process, PROCESS_STACK_SIZE);
+
+    // Invalid arguments
+    assert_equal(syssendv(pid, message, 0), -4);
+    assert_equal(syssendv(pid, message, MAX_MESSAGE_SIZE + 1), -4);
+    assert_equal(syssendv(pid, (void *) HOLESTART, 4), -4);
+    unsigned int from_pid = pid;
+    assert_equal(sysrecvv(&from_pid, reply, MAX_MESSAGE_SIZE + 1), -4);
+
+    // Test: A message of odd length and alignment is delivered whole, with its zero
+    // bytes, and echoed back
+    assert_equal(syssendv(pid, message + 1, ECHO_BUFFER_SIZE - 3), ECHO_BUFFER_SIZE - 3);
+    memset(reply, 0xff, sizeof(reply));
+    from_pid = pid;
+    assert_equal(sysrecvv(&from_pid, reply, sizeof(reply)), ECHO_BUFFER_SIZE - 3);
+    for (int i = 0; i < ECHO_BUFFER_SIZE - 3; i++) {
+        assert_equal(reply[i], message[i + 1]);
+    }
+    assert_equal(reply[ECHO_BUFFER_SIZE - 3], 0xff);
+
+    // Test: A message longer than the buffer of the receiver is truncated
+    assert_equal(syssendv(pid, message, sizeof(message)), ECHO_BUFFER_SIZE);
+    from_pid = pid;
+    assert_equal(sysrecvv(&from_pid, reply, sizeof(reply)), ECHO_BUFFER_SIZE);
+
+    // Test: A single word send is received by sysrecvv, whatever its bytes
+    assert_equal(syssend(pid, 0x12000034), 0);
+    from_pid = pid;
+    unsigned long word = 0;
+    assert_equal(sysrecvv(&from_pid, &word, sizeof(word)), BUFFER_SIZE);
+    assert_equal(word, 0x12000034);
+    syswait(pid);
+
+    // Test: A message to a receiver that already waits is copied on the stack of the
+    // sender, a step at a time, and delivered whole
+    for (int i = 0; i < MAX_MESSAGE_SIZE; i++) {
+        g_large_message[i] = i * 7;
+    }
+    pid = sysspawn(&large_receiver, NULL, 0, NULL);
+    proc_status_t status;
+    do {
+        sysyield();
+        get_process_status(pid, &status);
+    } while (status.state != BLOCKED);
+    preempt_args_t req = {{pid, (int) g_large_message, MAX_MESSAGE_SIZE}, 0};
+    assert_equal(preemptcall(SYSSENDV, (int) &req), MAX_MESSAGE_SIZE);
+    int exit_status;
+    assert_equal(syswaitany(&pid, 1, &exit_status), pid);
+    assert_equal(exit_status, MAX_MESSAGE_SIZE);
+    for (int i = 0; i < MAX_MESSAGE_SIZE; i++) {
+        assert_equal(g_large_received[i], g_large_message[i]);
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by vectored_message_test to receive three messages with sysrecvv and send
+ * each back.
+ *-----------------------------------------------------------------------------------
+ */
+static void vectored_echo_process(void) {
+    unsigned char buf[ECHO_BUFFER_SIZE];
+    for (int i = 0; i < 3; i++) {
+        unsigned int from_pid = g_echo_client_pid;
+        int len = sysrecvv(&from_pid, buf, sizeof(buf));
+        syssendv(from_pid, buf, len);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by vectored_message_test to receive a message of MAX_MESSAGE_SIZE bytes from
+ * the test, and exit with its length.
+ *-----------------------------------------------------------------------------------
+ */
+static void large_receiver(void *arg) {
+    unsigned int from_pid = g_echo_client_pid;
+    sysexit(sysrecvv(&from_pid, g_large_received, MAX_MESSAGE_SIZE));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysrpc and sysreplywait.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysrpc_test(void) {
+    kprintf("Running %s\n", __func__);
+    unsigned long reply;
+
+    // Invalid arguments
+    assert_equal(sysrpc(sysgetpid(), 1, &reply), -3);
+    assert_equal(sysrpc(-1, 1, &reply), -2);
+    unsigned int client_pid = 0;
+    assert_equal(sysreplywait(&client_pid, 0, (unsigned long *) HOLESTART), -4);
+    assert_equal(sysreplywait((unsigned int *) HOLESTART, 0, &reply), -5);
+
+    // Test: Each call gets the reply to its own request, whether the server is
+    // waiting for the request or not
+    PID_t pid = syscreate(&rpc_server, PROCESS_STACK_SIZE);
+    assert_equal(sysrpc(pid, 1, (unsigned long *) HOLESTART), -4);
+    for (unsigned long i = 1; i <= RPC_CALLS; i++) {
+        if (i % 2 == 0) {
+            // Let the server block in sysreplywait first
+            sysyield();
+        }
+        assert_equal(sysrpc(pid, i, &reply), 0);
+        assert_equal(reply, i * 10);
+    }
+
+    // Test: A call fails when the server terminates before replying
+    assert_equal(sysrpc(pid, RPC_STOP, &reply), -1);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysrpc_test to reply to every request with ten times the request, until
+ * it receives RPC_STOP.
+ *-----------------------------------------------------------------------------------
+ */
+static void rpc_server(void) {
+    unsigned int client_pid = 0;
+    unsigned long request;
+    unsigned long reply = 0;
+    while (sysreplywait(&client_pid, reply, &request) == 0 && request != RPC_STOP) {
+        reply = request * 10;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysportcreate, sysportdestroy, sysportsend and sysportrecv.
+ *-----------------------------------------------------------------------------------
+ */
+static void port_test(void) {
+    kprintf("Running %s\n", __func__);
+    unsigned long num;
+
+    // Invalid arguments
+    assert_equal(sysportsend(-1, 1), -2);
+    assert_equal(sysportsend(MAX_PORTS, 1), -2);
+    assert_equal(sysportrecv(MAX_PORTS, &num), -2);
+    assert_equal(sysportdestroy(-1), -1);
+
+    g_port = sysportcreate();
+    assert(g_port >= 0, "sysportcreate failed");
+    assert_equal(sysportrecv(g_port, (unsigned long *) HOLESTART), -4);
+
+    // Test: A full ring of messages is sent without a receiver, and received in
+    // order
+    for (unsigned long i = 0; i < PORT_SLOTS; i++) {
+        assert_equal(sysportsend(g_port, i), 0);
+    }
+    for (unsigned long i = 0; i < PORT_SLOTS; i++) {
+        assert_equal(sysportrecv(g_port, &num), 0);
+        assert_equal(num, i);
+    }
+
+    // Test: A sender blocks only once the ring is full, and a waiting receiver is
+    // given the message directly, in order
+    PID_t pid = syscreate(&port_consumer, PROCESS_STACK_SIZE);
+    for (unsigned long i = 0; i < PORT_MESSAGES; i++) {
+        assert_equal(sysportsend(g_port, i * 3), 0);
+    }
+    syswait(pid);
+    assert_equal(g_port_consumer_result, 0);
+    for (int i = 0; i < PORT_MESSAGES; i++) {
+        assert_equal(g_port_received[i], i * 3);
+    }
+
+    // Test: Destroying a port unblocks its receivers with -1
+    pid = syscreate(&port_consumer, PROCESS_STACK_SIZE);
+    sysyield();
+    assert_equal(sysportdestroy(g_port), 0);
+    syswait(pid);
+    assert_equal(g_port_consumer_result, -1);
+    assert_equal(sysportsend(g_port, 1), -2);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by port_test to receive PORT_MESSAGES messages from the port, stopping at
+ * the first failure.
+ *-----------------------------------------------------------------------------------
+ */
+static void port_consumer(void) {
+    for (int i = 0; i < PORT_MESSAGES; i++) {
+        // The message is received on the stack, kernel memory is not accepted
+        unsigned long num;
+        g_port_consumer_result = sysportrecv(g_port, &num);
+        if (g_port_consumer_result != 0) {
+            return;
+        }
+        g_port_received[i] = num;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that sysrecvset receives only from the processes in the set, both from
+ * senders already waiting and from senders that send after it blocks.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysrecvset_test(void) {
+    kprintf("Running %s\n", __func__);
+    PID_t pids[3];
+    unsigned int set[2];
+    unsigned int from_pid = 0;
+    unsigned int num = 0;
+
+    g_pid_receiver = sysgetpid();
+    for (int i = 0; i < 3; i++) {
+        pids[i] = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    }
+    yield_to_all();
+
+    // Test: The earliest waiting sender in the set is received from, whatever the
+    // order of the set, and the sender outside the set is left waiting
+    set[0] = pids[2];
+    set[1] = pids[0];
+    assert_equal(sysrecvset(&from_pid, &num, set, 2), 0);
+    assert_equal(from_pid, pids[0]);
+    assert_equal(num, pids[0]);
+    assert_equal(sysrecvset(&from_pid, &num, set, 2), 0);
+    assert_equal(from_pid, pids[2]);
+    from_pid = 0;
+    assert_equal(sysrecv(&from_pid, &num), 0);
+    assert_equal(from_pid, pids[1]);
+
+    // Test: A receiver waiting on a set is not matched by a sender outside the set
+    pids[0] = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    pids[1] = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    set[0] = pids[1];
+    assert_equal(sysrecvset(&from_pid, &num, set, 1), 0);
+    assert_equal(from_pid, pids[1]);
+    from_pid = pids[0];
+    assert_equal(sysrecv(&from_pid, &num), 0);
+    assert_equal(num, pids[0]);
+    yield_to_all();
+
+    // Test: A receiver waiting on a set is failed once every process in the set has
+    // terminated without sending, another process keeps it from being the only one
+    PID_t bystander = syscreate(&sleep_process, PROCESS_STACK_SIZE);
+    set[0] = syscreate(&silent_process, PROCESS_STACK_SIZE);
+    set[1] = syscreate(&silent_process, PROCESS_STACK_SIZE);
+    assert_equal(sysrecvset(&from_pid, &num, set, 2), -1);
+    syskill(bystander, 31);
+    syswait(bystander);
+
+    // Invalid arguments
+    set[0] = sysgetpid();
+    assert_equal(sysrecvset(&from_pid, &num, set, 1), -3);
+    set[0] = pids[0];
+    assert_equal(sysrecvset(&from_pid, &num, set, 1), -2);
+    assert_equal(sysrecvset(&from_pid, &num, set, 0), -6);
+    assert_equal(sysrecvset(&from_pid, &num, set, MAX_RECV_SET + 1), -6);
+    assert_equal(sysrecvset(&from_pid, &num, (unsigned int *) HOLESTART, 1), -6);
+    assert_equal(sysrecvset(&from_pid, (unsigned int *) HOLESTART, set, 1), -4);
+    assert_equal(sysrecvset((unsigned int *) HOLESTART, &num, set, 1), -5);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysrecvset_test to terminate after a while without sending.
+ *-----------------------------------------------------------------------------------
+ */
+static void silent_process(void) {
+    syssleep(2 * TIME_SLICE);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysrecvset_test and sysbatch_test to send its PID to g_pid_receiver.
+ *-----------------------------------------------------------------------------------
+ */
+static void pid_sender(void) {
+    assert_equal(syssend(g_pid_receiver, sysgetpid()), 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that syssendbatch delivers to several processes, blocking only on receivers
+ * that are not waiting, and that sysrecvbatch drains the processes waiting to send.
+ *-----------------------------------------------------------------------------------
+ */
+static void sysbatch_test(void) {
+    kprintf("Running %s\n", __func__);
+    send_batch_entry_t sends[5];
+    recv_batch_entry_t recvs[2];
+    PID_t pids[3];
+
+    // Invalid arguments
+    assert_equal(syssendbatch(sends, 0), -4);
+    assert_equal(syssendbatch((send_batch_entry_t *) HOLESTART, 1), -4);
+    assert_equal(sysrecvbatch(recvs, MAX_BATCH + 1), -4);
+    assert_equal(sysrecvbatch((recv_batch_entry_t *) HOLESTART, 1), -4);
+
+    // Test: Messages to waiting receivers are delivered, and failures are reported
+    // per message
+    g_pid_sender = sysgetpid();
+    for (int i = 0; i < 3; i++) {
+        pids[i] = syscreate(&pid_receiver, PROCESS_STACK_SIZE);
+        sends[i].dest_pid = pids[i];
+        sends[i].num = pids[i];
+    }
+    yield_to_all();
+    sends[3].dest_pid = pids[2] + MAX_PROCESSES;
+    sends[4].dest_pid = sysgetpid();
+    assert_equal(syssendbatch(sends, 5), 3);
+    for (int i = 0; i < 3; i++) {
+        assert_equal(sends[i].result, 0);
+    }
+    assert_equal(sends[3].result, -2);
+    assert_equal(sends[4].result, -3);
+    yield_to_all();
+
+    // Test: The sender blocks on a receiver that is not waiting yet, and the rest of
+    // the batch is sent after it
+    for (int i = 0; i < 2; i++) {
+        pids[i] = syscreate(&pid_receiver, PROCESS_STACK_SIZE);
+        sends[i].dest_pid = pids[i];
+        sends[i].num = pids[i];
+    }
+    assert_equal(syssendbatch(sends, 2), 2);
+    assert_equal(sends[0].result, 0);
+    assert_equal(sends[1].result, 0);
+    yield_to_all();
+
+    // Test: Waiting senders are drained up to the size of the batch, earliest first
+    g_pid_receiver = sysgetpid();
+    for (int i = 0; i < 3; i++) {
+        pids[i] = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    }
+    yield_to_all();
+    assert_equal(sysrecvbatch(recvs, 2), 2);
+    for (int i = 0; i < 2; i++) {
+        assert_equal(recvs[i].from_pid, pids[i]);
+        assert_equal(recvs[i].num, pids[i]);
+    }
+    assert_equal(sysrecvbatch(recvs, 2), 1);
+    assert_equal(recvs[0].from_pid, pids[2]);
+
+    // Test: With no sender waiting, the receiver waits for the first message
+    pids[0] = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    assert_equal(sysrecvbatch(recvs, 2), 1);
+    assert_equal(recvs[0].from_pid, pids[0]);
+    yield_to_all();
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sysbatch_test to receive its own PID from g_pid_sender.
+ *-----------------------------------------------------------------------------------
+ */
+static void pid_receiver(void) {
+    unsigned int from_pid = g_pid_sender;
+    unsigned int num = 0;
+    assert_equal(sysrecv(&from_pid, &num), 0);
+    assert_equal(num, sysgetpid());
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysringsetup and sysringenter.
+ *-----------------------------------------------------------------------------------
+ */
+static void ioring_test(void) {
+    kprintf("Running %s\n", __func__);
+    io_sqe_t sqes[8];
+    io_cqe_t cqes[8];
+    io_ring_t ring;
+    char out[3] = {'a', 'b', 'c'};
+    char in[4];
+
+    // Invalid arguments
+    ring.entries = 6;
+    ring.sqes = sqes;
+    ring.cqes = cqes;
+    assert_equal(sysringsetup(&ring), -2);
+    ring.entries = IORING_MAX_ENTRIES * 2;
+    assert_equal(sysringsetup(&ring), -2);
+    ring.entries = 8;
+    ring.cqes = (io_cqe_t *) HOLESTART;
+    assert_equal(sysringsetup(&ring), -1);
+    assert_equal(sysringsetup((io_ring_t *) HOLESTART), -1);
+    assert_equal(sysringenter(&ring), -1);
+    ring.cqes = cqes;
+    assert_equal(sysringsetup(&ring), 0);
+    assert_equal(ring.sq_tail, 0);
+    assert_equal(ring.cq_tail, 0);
+
+    // Test: One call carries out a whole batch of operations in order, with the
+    // result of each in its completion
+    int fd = sysopen(PIPE_1);
+    assert(fd >= 0, "sysopen of a pipe failed");
+    g_pid_sender = sysgetpid();
+    PID_t receiver = syscreate(&pid_receiver, PROCESS_STACK_SIZE);
+    unsigned long num = receiver;
+    queue_entry(&ring, IORING_OP_WRITE, fd, out, sizeof(out));
+    queue_entry(&ring, IORING_OP_READ, fd, in, sizeof(in));
+    queue_entry(&ring, IORING_OP_SEND, receiver, &num, sizeof(num));
+    queue_entry(&ring, IORING_OP_CLOSE, fd, NULL, 0);
+    queue_entry(&ring, IORING_OP_READ, fd, in, sizeof(in));
+    queue_entry(&ring, IORING_OP_OPEN, PIPE_1, NULL, 0);
+    queue_entry(&ring, IORING_OP_NOP, 0, NULL, 0);
+    queue_entry(&ring, -1, 0, NULL, 0);
+    assert_equal(sysringenter(&ring), 8);
+    assert_equal(ring.sq_head, 8);
+    assert_equal(ring.cq_tail, 8);
+    assert_equal(completion(&ring, 0), 3);
+    assert_equal(completion(&ring, 1), 3);
+    assert(in[0] == 'a' && in[2] == 'c', "The read did not get the bytes written");
+    assert_equal(completion(&ring, 2), sizeof(num));
+    assert_equal(completion(&ring, 3), 0);
+    assert_equal(completion(&ring, 4), -1);
+    fd = completion(&ring, 5);
+    assert(fd >= 0, "The open of a pipe failed");
+    assert_equal(completion(&ring, 6), 0);
+    assert_equal(completion(&ring, 7), -1);
+    ring.cq_head = ring.cq_tail;
+
+    // Test: An operation that has to wait blocks the process, and the operations
+    // after it are carried out once it completes. The second open keeps the read
+    // from seeing EOF before the writer opens the pipe
+    int fd2 = sysopen(PIPE_1);
+    syscreate(&pipe_poll_writer, PROCESS_STACK_SIZE);
+    queue_entry(&ring, IORING_OP_READ, fd, in, sizeof(in));
+    queue_entry(&ring, IORING_OP_SLEEP, 0, NULL, 10);
+    queue_entry(&ring, IORING_OP_NOP, 0, NULL, 0);
+    assert_equal(sysringenter(&ring), 3);
+    assert_equal(completion(&ring, 8), 1);
+    assert(in[0] == 'p', "The blocked read did not get the byte written");
+    assert_equal(completion(&ring, 9), 0);
+    assert_equal(completion(&ring, 10), 0);
+    ring.cq_head = ring.cq_tail;
+
+    // Test: Only as many operations are taken as there are free completions, the
+    // rest wait for the next call
+    for (int i = 0; i < 6; i++) {
+        queue_entry(&ring, IORING_OP_NOP, 0, NULL, 0);
+    }
+    assert_equal(sysringenter(&ring), 6);
+    for (int i = 0; i < 4; i++) {
+        queue_entry(&ring, IORING_OP_NOP, 0, NULL, 0);
+    }
+    assert_equal(sysringenter(&ring), 2);
+    assert_equal(ring.sq_tail - ring.sq_head, 2);
+    ring.cq_head = ring.cq_tail;
+    assert_equal(sysringenter(&ring), 2);
+    assert_equal(sysringenter(&ring), 0);
+    ring.cq_head = ring.cq_tail;
+
+    // Test: Indices past the other end of a ring are rejected, and rings that have
+    // been removed are not used
+    ring.sq_tail = ring.sq_head + 9;
+    assert_equal(sysringenter(&ring), -2);
+    ring.sq_tail = ring.sq_head;
+    assert_equal(sysringsetup(NULL), 0);
+    assert_equal(sysringenter(&ring), -1);
+    assert_equal(sysclose(fd), 0);
+    assert_equal(sysclose(fd2), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by ioring_test to queue an operation on the submission ring of the given
+ * rings, numbered by its index.
+ *-----------------------------------------------------------------------------------
+ */
+static void queue_entry(io_ring_t *ring, int opcode, int fd, void *buf, int len) {
+    io_sqe_t *sqe = &ring->sqes[ring->sq_tail & (ring->entries - 1)];
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->len = len;
+    sqe->user_data = ring->sq_tail;
+    ring->sq_tail++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by ioring_test to return the result of the operation with the given index,
+ * whose completion has the same index as the operations complete in order.
+ *-----------------------------------------------------------------------------------
+ */
+static int completion(io_ring_t *ring, unsigned int index) {
+    io_cqe_t *cqe = &ring->cqes[index & (ring->entries - 1)];
+    assert_equal(cqe->user_data, index);
+    return cqe->result;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysshmcreate, sysshmattach and sysshmdetach.
+ *-----------------------------------------------------------------------------------
+ */
+static void shm_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    // Invalid arguments
+    assert_equal(sysshmcreate(0), -1);
+    assert_equal(sysshmcreate((NBPG << (NUM_PAGE_ORDERS - 1)) + 1), -1);
+    assert(sysshmattach(-1) == NULL, "Attached a segment that does not exist");
+    assert(sysshmattach(MAX_SHM_SEGMENTS) == NULL, "Attached a segment that does not exist");
+    assert_equal(sysshmdetach(0), -1);
+
+    // Test: A segment is zeroed and page aligned, and what another process writes to
+    // it is seen at the same address
+    // The first segment also takes a slab for the segment cache, which is kept
+    assert_equal(sysshmdetach(sysshmcreate(1)), 0);
+    int pages_before = free_pages();
+    g_shm_id = sysshmcreate(SHM_SIZE);
+    assert(g_shm_id >= 0, "sysshmcreate failed");
+    assert_equal(free_pages(), pages_before - 2);
+    unsigned char *segment = sysshmattach(g_shm_id);
+    assert(segment != NULL, "The creator could not attach its segment");
+    assert_equal((unsigned long) segment % NBPG, 0);
+    for (int i = 0; i < SHM_SIZE; i++) {
+        assert_equal(segment[i], 0);
+    }
+    PID_t pid = syscreate(&shm_writer, PROCESS_STACK_SIZE);
+    // The writer is reaped by the time syswait returns, so its stack is freed
+    syswait(pid);
+    for (int i = 0; i < SHM_SIZE; i++) {
+        assert_equal(segment[i], (unsigned char) i);
+    }
+
+    // Test: Attaching twice holds the segment once, so it is freed by the single
+    // detach of its last holder
+    assert(sysshmattach(g_shm_id) == segment, "The segment moved");
+    assert_equal(sysshmdetach(g_shm_id), 0);
+    assert_equal(free_pages(), pages_before);
+    assert_equal(sysshmdetach(g_shm_id), -1);
+    assert(sysshmattach(g_shm_id) == NULL, "Attached a freed segment");
+
+    // Test: A segment held by a process that terminates is freed when it is cleaned
+    // up
+    g_shm_id = -1;
+    pid = syscreate(&shm_writer, PROCESS_STACK_SIZE);
+    syswait(pid);
+    assert_equal(free_pages(), pages_before);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by shm_test to fill the segment g_shm_id with a pattern and detach it, or if
+ * g_shm_id is -1, to create a segment and terminate without detaching it.
+ *-----------------------------------------------------------------------------------
+ */
+static void shm_writer(void) {
+    if (g_shm_id == -1) {
+        assert(sysshmcreate(SHM_SIZE) >= 0, "sysshmcreate failed");
+        return;
+    }
+    unsigned char *segment = sysshmattach(g_shm_id);
+    assert(segment != NULL, "Could not attach the segment");
+    for (int i = 0; i < SHM_SIZE; i++) {
+        segment[i] = (unsigned char) i;
+    }
+    assert_equal(sysshmdetach(g_shm_id), 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of pages left in the page allocator.
+ *-----------------------------------------------------------------------------------
+ */
+static int free_pages(void) {
+    mem_stats_t stats;
+    assert_equal(sysgetmemstats(&stats), 0);
+    return stats.free_pages;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests sysfutexwait and sysfutexwake.
+ *-----------------------------------------------------------------------------------
+ */
+static void futex_test(void) {
+    kprintf("Running %s\n", __func__);
+    int futex[2] = {0, 0};
+
+    // Invalid arguments
+    assert_equal(sysfutexwait(NULL, 0), -4);
+    assert_equal(sysfutexwait((int *) HOLESTART, 0), -4);
+    assert_equal(sysfutexwait((int *) ((char *) &futex[0] + 1), 0), -4);
+    assert_equal(sysfutexwake((int *) HOLESTART, 1), -4);
+
+    // Test: A wait returns at once if the value is not the expected one, and a wake
+    // with no waiters wakes nothing
+    assert_equal(sysfutexwait(&futex[0], 1), -2);
+    assert_equal(sysfutexwake(&futex[0], 1), 0);
+
+    // Test: Wakes take only the waiters on the given address, up to the count
+    g_futex = &futex[0];
+    g_futex_results = 0;
+    for (int i = 0; i < 2; i++) {
+        syscreate(&futex_waiter, PROCESS_STACK_SIZE);
+    }
+    yield_to_all();
+    assert_equal(sysfutexwake(&futex[1], 2), 0);
+    assert_equal(sysfutexwake(&futex[0], 1), 1);
+    assert_equal(sysfutexwake(&futex[0], 5), 1);
+    assert_equal(sysfutexwake(&futex[0], 5), 0);
+    yield_to_all();
+    assert_equal(g_futex_results, 2);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by futex_test to wait on g_futex, counting the successful waits in
+ * g_futex_results.
+ *-----------------------------------------------------------------------------------
+ */
+static void futex_waiter(void) {
+    if (sysfutexwait(g_futex, 0) == 0) {
+        g_futex_results++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests the mutexes, semaphores and condition variables of sync.c.
+ *-----------------------------------------------------------------------------------
+ */
+static void sync_test(void) {
+    kprintf("Running %s\n", __func__);
+    mutex_t mutex;
+    semaphore_t sem;
+    cond_t cond;
+    PID_t pids[MUTEX_WORKERS];
+
+    // Test: An uncontended mutex and semaphore make no system call
+    mutex_init(&mutex);
+    syscall_stats_t before;
+    syscall_stats_t after;
+    sysgetsyscallstats(SYSFUTEXWAKE, &before);
+    mutex_lock(&mutex);
+    assert_equal(mutex_trylock(&mutex), 0);
+    mutex_unlock(&mutex);
+    sem_init(&sem, 1);
+    sem_wait(&sem);
+    assert_equal(sem_trywait(&sem), 0);
+    sem_post(&sem);
+    sysgetsyscallstats(SYSFUTEXWAKE, &after);
+    assert_equal(after.count, before.count);
+
+    // Test: Processes that yield while holding the mutex never lose an update
+    g_mutex = &mutex;
+    g_counter = 0;
+    for (int i = 0; i < MUTEX_WORKERS; i++) {
+        pids[i] = syscreate(&mutex_worker, PROCESS_STACK_SIZE);
+    }
+    for (int i = 0; i < MUTEX_WORKERS; i++) {
+        syswait(pids[i]);
+    }
+    assert_equal(g_counter, MUTEX_WORKERS * MUTEX_ROUNDS);
+    assert_equal(mutex.state, 0);
+
+    // Test: A process waiting on a semaphore is woken by a post, and one waiting on
+    // a condition variable by a signal
+    sem_init(&sem, 0);
+    cond_init(&cond);
+    g_sem = &sem;
+    g_cond = &cond;
+    g_counter = 0;
+    PID_t pid = syscreate(&sem_cond_worker, PROCESS_STACK_SIZE);
+    yield_to_all();
+    assert_equal(g_counter, 0);
+    sem_post(&sem);
+    yield_to_all();
+    assert_equal(g_counter, 1);
+    mutex_lock(&mutex);
+    g_counter = 2;
+    cond_signal(&cond);
+    mutex_unlock(&mutex);
+    syswait(pid);
+    assert_equal(g_counter, 3);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sync_test to increment g_counter under g_mutex, yielding in the middle of
+ * every increment so the other workers find the mutex locked.
+ *-----------------------------------------------------------------------------------
+ */
+static void mutex_worker(void) {
+    for (int i = 0; i < MUTEX_ROUNDS; i++) {
+        mutex_lock(g_mutex);
+        int counter = g_counter;
+        sysyield();
+        g_counter = counter + 1;
+        mutex_unlock(g_mutex);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by sync_test to set g_counter to 1 once g_sem is posted, then wait on g_cond
+ * until g_counter is 2 and set it to 3.
+ *-----------------------------------------------------------------------------------
+ */
+static void sem_cond_worker(void) {
+    sem_wait(g_sem);
+    g_counter = 1;
+    mutex_lock(g_mutex);
+    while (g_counter != 2) {
+        cond_wait(g_cond, g_mutex);
+    }
+    g_counter = 3;
+    mutex_unlock(g_mutex);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests the coroutines of coro.c.
+ *-----------------------------------------------------------------------------------
+ */
+static void coro_test(void) {
+    kprintf("Running %s\n", __func__);
+    coro_sched_t sched;
+    syscall_stats_t before;
+    syscall_stats_t after;
+    g_coro_sched = &sched;
+
+    // Invalid arguments
+    coro_init(&sched);
+    assert_equal(coro_create(&sched, &g_coros[0], g_coro_stacks[0], CORO_MIN_STACK_SIZE - 1, &logging_coro, "a"), -1);
+    assert_equal(coro_create(&sched, &g_coros[0], g_coro_stacks[0], CORO_STACK_SIZE, NULL, NULL), -1);
+    assert(coro_self(&sched) == NULL, "A coroutine runs outside coro_run");
+
+    // Test: Coroutines that yield take turns, and make no system call to do so
+    g_coro_log_len = 0;
+    assert_equal(coro_create(&sched, &g_coros[0], g_coro_stacks[0], CORO_STACK_SIZE, &logging_coro, "a"), 0);
+    assert_equal(coro_create(&sched, &g_coros[1], g_coro_stacks[1], CORO_STACK_SIZE, &logging_coro, "b"), 0);
+    sysgetsyscallstats(SYSYIELD, &before);
+    coro_run(&sched);
+    sysgetsyscallstats(SYSYIELD, &after);
+    assert_equal(after.count, before.count);
+    assert_equal(g_coro_log_len, 2 * CORO_ROUNDS);
+    for (int i = 0; i < g_coro_log_len; i++) {
+        assert_equal(g_coro_log[i], i % 2 ? 'b' : 'a');
+    }
+
+    // Test: A wake made before a block is taken, and the process waits in the kernel
+    // while the only coroutine is blocked, until another process wakes it
+    coro_init(&sched);
+    g_blocked_coro = NULL;
+    coro_create(&sched, &g_coros[0], g_coro_stacks[0], CORO_STACK_SIZE, &blocking_coro, NULL);
+    PID_t pid = syscreate(&coro_waker, PROCESS_STACK_SIZE);
+    sysgetsyscallstats(SYSFUTEXWAIT, &before);
+    coro_run(&sched);
+    sysgetsyscallstats(SYSFUTEXWAIT, &after);
+    assert(after.count > before.count, "The process did not wait in the kernel");
+    assert(g_blocked_coro == NULL, "The coroutine did not run to the end");
+    syswait(pid);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by coro_test to add the given char to g_coro_log, yielding after each.
+ *-----------------------------------------------------------------------------------
+ */
+static void logging_coro(void *arg) {
+    for (int i = 0; i < CORO_ROUNDS; i++) {
+        g_coro_log[g_coro_log_len++] = *(char *) arg;
+        coro_yield(g_coro_sched);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by coro_test to take a wake of its own, then block until coro_waker wakes it.
+ *-----------------------------------------------------------------------------------
+ */
+static void blocking_coro(void *arg) {
+    coro_t *self = coro_self(g_coro_sched);
+    coro_wake(self);
+    coro_block(g_coro_sched);
+    g_blocked_coro = self;
+    coro_block(g_coro_sched);
+    g_blocked_coro = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by coro_test to wake the coroutine once it has blocked, giving the test time
+ * to wait in the kernel.
+ *-----------------------------------------------------------------------------------
+ */
+static void coro_waker(void) {
+    while (g_blocked_coro == NULL) {
+        sysyield();
+    }
+    syssleep(50);
+    coro_wake(g_blocked_coro);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that syspoll reports a pipe with input and a process waiting to send, and
+ * returns an empty mask when it times out.
+ *-----------------------------------------------------------------------------------
+ */
+static void syspoll_test(void) {
+    kprintf("Running %s\n", __func__);
+    char buf[4];
+    unsigned int num;
+    unsigned int from_pid;
+
+    // Invalid arguments
+    assert_equal(syspoll(1, 0), -1);
+    assert_equal(syspoll(POLL_IPC << 1, 0), -1);
+
+    // Test: Nothing is ready, the poll returns at once or after the timeout
+    int fd = sysopen(PIPE_1);
+    int fd2 = sysopen(PIPE_1);
+    assert(fd >= 0 && fd2 >= 0, "sysopen of a pipe failed");
+    unsigned int mask = (1 << fd) | POLL_IPC;
+    assert_equal(syspoll(mask, 0), 0);
+    assert_equal(syspoll(mask, 20), 0);
+
+    // Test: A write to a pipe wakes the poller, and the input stays to be read
+    PID_t pid = syscreate(&pipe_poll_writer, PROCESS_STACK_SIZE);
+    assert_equal(syspoll(mask, -1), 1 << fd);
+    assert_equal(syspoll(mask, 0), 1 << fd);
+    assert_equal(sysread(fd, buf, sizeof(buf)), 1);
+    assert_equal(buf[0], 'p');
+    syswait(pid);
+
+    // Test: A process sending to the poller wakes it, and the message is then
+    // received
+    g_pid_receiver = sysgetpid();
+    pid = syscreate(&pid_sender, PROCESS_STACK_SIZE);
+    assert_equal(syspoll(mask, -1), POLL_IPC);
+    from_pid = pid;
+    assert_equal(sysrecv(&from_pid, &num), 0);
+    assert_equal(num, pid);
+
+    // Test: The remaining holder of a pipe is ready to read EOF
+    assert_equal(sysclose(fd2), 0);
+    assert_equal(syspoll(mask, 0), 1 << fd);
+    assert_equal(sysread(fd, buf, sizeof(buf)), 0);
+    assert_equal(sysclose(fd), 0);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syspoll_test to write a byte to PIPE_1. The pipe is closed when the
+ * process is cleaned up.
+ *-----------------------------------------------------------------------------------
+ */
+static void pipe_poll_writer(void) {
+    char c = 'p';
+    int fd = sysopen(PIPE_1);
+    assert_equal(syswrite(fd, &c, 1), 1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that a blocked signal stays pending without interrupting a sleep, and is
+ * delivered once it is unblocked.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssigprocmask_test(void) {
+    kprintf("Running %s\n", __func__);
+    signal_handler_funcptr old_handler;
+    int old_mask;
+    PID_t pid = sysgetpid();
+    syssighandler(TIMER_SIGNAL, &count_timer_signal, &old_handler);
+
+    // Invalid arguments
+    assert_equal(syssigprocmask(3, 0, NULL), -1);
+    assert_equal(syssigprocmask(SIG_BLOCK, 0, (int *) HOLESTART), -2);
+
+    // Test: Signal 31 cannot be blocked, and the previous mask is returned
+    assert_equal(syssigprocmask(SIG_SETMASK, -1, NULL), 0);
+    assert_equal(syssigprocmask(SIG_SETMASK, 0, &old_mask), 0);
+    assert_equal(old_mask, ~(1 << (SIGNAL_TABLE_SIZE - 1)));
+
+    // Test: A blocked signal does not interrupt a sleep and is not delivered
+    g_timer_signals = 0;
+    assert_equal(syssigprocmask(SIG_BLOCK, 1 << TIMER_SIGNAL, &old_mask), 0);
+    assert_equal(old_mask, 0);
+    assert(systimer(pid, TIMER_SIGNAL, TIME_SLICE, 0) >= 0, "systimer failed");
+    assert_equal(syssleep(5 * TIME_SLICE), 0);
+    assert_equal(g_timer_signals, 0);
+
+    // Test: The pending signal is delivered once unblocked
+    assert_equal(syssigprocmask(SIG_UNBLOCK, 1 << TIMER_SIGNAL, &old_mask), 0);
+    assert_equal(old_mask, 1 << TIMER_SIGNAL);
+    sysyield();
+    assert_equal(g_timer_signals, 1);
+
+    syssighandler(TIMER_SIGNAL, old_handler, &old_handler);
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Tests that every signal queued with syssigqueue is delivered in order with its
+ * value and sender, up to the size of the queue.
+ *-----------------------------------------------------------------------------------
+ */
+static void syssigqueue_test(void) {
+    kprintf("Running %s\n", __func__);
+    signal_handler_funcptr old_handler;
+    PID_t pid = sysgetpid();
+    syssighandler(TIMER_SIGNAL, &record_queued_signal, &old_handler);
+
+    // Invalid arguments
+    assert_equal(syssigqueue(-1, TIMER_SIGNAL, 0), -514);
+    assert_equal(syssigqueue(pid, SIGNAL_TABLE_SIZE, 0), -583);
+
+    // Test: Signals queued while blocked do not collapse, and the queue is bounded
+    g_queued_signals = 0;
+    syssigprocmask(SIG_BLOCK, 1 << TIMER_SIGNAL, NULL);
+    for (int i = 0; i < SIGNAL_QUEUE_SIZE; i++) {
+        assert_equal(syssigqueue(pid, TIMER_SIGNAL, i * 10), 0);
+    }
+    assert_equal(syssigqueue(pid, TIMER_SIGNAL, -1), -3);
+    assert_equal(g_queued_signals, 0);
+
+    // Test: Once unblocked, each is delivered in order with its value and sender
+    syssigprocmask(SIG_UNBLOCK, 1 << TIMER_SIGNAL, NULL);
+    sysyield();
+    assert_equal(g_queued_signals, SIGNAL_QUEUE_SIZE);
+    for (int i = 0; i < SIGNAL_QUEUE_SIZE; i++) {
+        assert_equal(g_queued_values[i], i * 10);
+        assert_equal(g_queued_senders[i], pid);
+    }
+
+    // Test: A signal raised by syskill carries no sender
+    assert_equal(syskill(pid, TIMER_SIGNAL), 0);
+    sysyield();
+    assert_equal(g_queued_signals, SIGNAL_QUEUE_SIZE + 1);
+
+    syssighandler(TIMER_SIGNAL, old_handler, &old_handler);
+    kprintf("Finished %s\n", __func__);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used by syssigqueue_test to record the value and sender of each signal queued.
+ *-----------------------------------------------------------------------------------
+ */
+static void record_queued_signal(void *cntx) {
+    siginfo_t *info = signal_info(cntx);
+    assert_equal(info->signal_number, TIMER_SIGNAL);
+    if (g_queued_signals < SIGNAL_QUEUE_SIZE) {
+        g_queued_values[g_queued_signals] = info->value;
+        g_queued_senders[g_queued_signals] = info->sender_pid;
+    } else {
+        assert_equal(info->sender_pid, 0);
+    }
+    g_queued_signals++;
+}
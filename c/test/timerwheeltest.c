@@ -0,0 +1,172 @@
+#include <xeroskernel.h>
+#include <queue.h>
+#include <timerwheel.h>
+
+/*------------------------------------------------------------------------
+ * Tests for timerwheel.c.
+ *
+ * List of functions that are called from outside this file:
+ * - run_timerwheel_test
+ *   - Runs the test suite for timerwheel.c
+ *------------------------------------------------------------------------
+ */
+
+#define NUM_TEST_PCBS 8
+
+static int advance_until_due(TimerWheel *wheel, int max_ticks);
+static void record_expired(timer_entry_t *entry);
+static pcb_t *next_expired(void);
+static void reinsert_expired(timer_entry_t *entry);
+
+static int const debug = 0;
+
+// Too large for the kernel stack
+static TimerWheel wheel;
+static pcb_t pcbs[NUM_TEST_PCBS];
+// The processes found due by the wheel, in the order they were found
+static pcb_t *expired[NUM_TEST_PCBS];
+static int num_expired;
+static int next_expired_index;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for timerwheel.c.
+ *------------------------------------------------------------------------
+ */
+void run_timerwheel_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    init_timer_wheel(&wheel);
+    for (int i = 0; i < NUM_TEST_PCBS; i++) {
+        pcbs[i].pid = i;
+        pcbs[i].timer.slot = NULL;
+        pcbs[i].timer.expire = &record_expired;
+        pcbs[i].timer.owner = &pcbs[i];
+    }
+
+    // Test: wheel_size on an empty wheel
+    assert_equal(wheel_size(&wheel), 0);
+
+    // Test: Processes are woken after exactly their delay, on every level of the
+    // wheel and across the slots where processes are moved down
+    int delays[NUM_TEST_PCBS] = {1, 5, 63, 64, 65, 4095, 4096 + 3, WHEEL_SLOTS * 4096 + 7};
+    for (int i = 0; i < NUM_TEST_PCBS; i++) {
+        unsigned long long start = wheel.now;
+        wheel_insert(&wheel, &pcbs[i].timer, delays[i]);
+        assert_equal(wheel_size(&wheel), 1);
+        assert_equal(advance_until_due(&wheel, delays[i] + 1), delays[i]);
+        assert_equal((int) (wheel.now - start), delays[i]);
+        assert(next_expired() == &pcbs[i], "The process woken is not the one inserted");
+        assert_equal(wheel_size(&wheel), 0);
+        if (debug) kprintf("woken after %d ticks\n", delays[i]);
+    }
+
+    // Test: A delay of 0 is woken on the next tick
+    wheel_insert(&wheel, &pcbs[0].timer, 0);
+    assert_equal(advance_until_due(&wheel, 2), 1);
+    next_expired();
+
+    // Test: Processes due at the same tick are woken in the order they were inserted
+    for (int i = 0; i < NUM_TEST_PCBS; i++) {
+        wheel_insert(&wheel, &pcbs[i].timer, 100);
+    }
+    assert_equal(advance_until_due(&wheel, 101), 100);
+    assert_equal(num_expired, NUM_TEST_PCBS);
+    for (int i = 0; i < NUM_TEST_PCBS; i++) {
+        assert(next_expired() == &pcbs[i], "Processes were not woken in order");
+    }
+
+    // Test: A process can be in the wheel and on a process queue at once
+    Queue queue;
+    init_queue(&queue);
+    enqueue(&queue, &pcbs[0]);
+    wheel_insert(&wheel, &pcbs[0].timer, 2);
+    assert_equal(in_wheel(&pcbs[0].timer), 1);
+    assert_equal(advance_until_due(&wheel, 3), 2);
+    assert(next_expired() == &pcbs[0], "The process on a queue was not woken");
+    assert_equal(in_wheel(&pcbs[0].timer), 0);
+    assert(dequeue(&queue) == &pcbs[0], "The process was taken off its queue");
+
+    // Test: wheel_remove returns the ticks left, and removed processes are not woken
+    wheel_insert(&wheel, &pcbs[0].timer, 10);
+    wheel_insert(&wheel, &pcbs[1].timer, 5000);
+    wheel_insert(&wheel, &pcbs[2].timer, 20);
+    for (int i = 0; i < 3; i++) {
+        wheel_advance(&wheel);
+    }
+    assert_equal(wheel_remove(&wheel, &pcbs[1].timer), 4997);
+    assert_equal(wheel_remove(&wheel, &pcbs[0].timer), 7);
+    assert_equal(wheel_size(&wheel), 1);
+    assert_equal(advance_until_due(&wheel, 5000), 17);
+    assert(next_expired() == &pcbs[2], "A removed process was woken");
+    assert_equal(wheel_size(&wheel), 0);
+
+    // Test: An entry put back on the wheel by its expire function while the wheel is
+    // advanced is due again one delay after the tick it was due at
+    pcbs[3].timer.expire = &reinsert_expired;
+    wheel_insert(&wheel, &pcbs[3].timer, 70);
+    assert_equal(advance_until_due(&wheel, 71), 70);
+    assert_equal(advance_until_due(&wheel, 71), 70);
+    assert_equal(in_wheel(&pcbs[3].timer), 1);
+    wheel_remove(&wheel, &pcbs[3].timer);
+    pcbs[3].timer.expire = &record_expired;
+
+    // Test: wheel_next_expiry finds the next process on level 0, and is bounded
+    assert_equal(wheel_next_expiry(&wheel, 1), 1);
+    while ((wheel.now & (WHEEL_SLOTS - 1)) != 0) {
+        wheel_advance(&wheel);
+    }
+    assert_equal(wheel_next_expiry(&wheel, 10), 10);
+    wheel_insert(&wheel, &pcbs[0].timer, 3);
+    assert_equal(wheel_next_expiry(&wheel, 10), 3);
+    wheel_remove(&wheel, &pcbs[0].timer);
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Advances the wheel until a process is due or the given number of ticks
+ * has passed, forgetting the processes found due before.
+ *
+ * @return The number of ticks the wheel was advanced by
+ *------------------------------------------------------------------------
+ */
+static int advance_until_due(TimerWheel *wheel, int max_ticks) {
+    int ticks = 0;
+    num_expired = 0;
+    next_expired_index = 0;
+    while (ticks < max_ticks && num_expired == 0) {
+        wheel_advance(wheel);
+        ticks++;
+    }
+    return ticks;
+}
+
+/*------------------------------------------------------------------------
+ * Used by the wheel to report a process that is due.
+ *------------------------------------------------------------------------
+ */
+static void record_expired(timer_entry_t *entry) {
+    assert(num_expired < NUM_TEST_PCBS, "Too many processes were due");
+    expired[num_expired++] = entry->owner;
+}
+
+/*------------------------------------------------------------------------
+ * Returns the next process found due, NULL if there is none.
+ *------------------------------------------------------------------------
+ */
+static pcb_t *next_expired(void) {
+    if (next_expired_index == num_expired) {
+        return NULL;
+    }
+    return expired[next_expired_index++];
+}
+
+/*------------------------------------------------------------------------
+ * Used by the wheel to report an entry that is due, and put it back on
+ * the wheel to be due 70 ticks later.
+ *------------------------------------------------------------------------
+ */
+static void reinsert_expired(timer_entry_t *entry) {
+    record_expired(entry);
+    wheel_insert(&wheel, entry, 70);
+}
@@ -0,0 +1,88 @@
+#include <xeroskernel.h>
+
+/*------------------------------------------------------------------------
+ * Tests for trace.c. Run at boot before any process is created, so the
+ * only events recorded are those of the tests.
+ *
+ * List of functions that are called from outside this file:
+ * - run_trace_test
+ *   - Runs the test suite for trace.c
+ *------------------------------------------------------------------------
+ */
+
+#define TRACE_TEST_SIZE (1 << TRACE_BUFFER_ORDER)
+
+static int const debug = 0;
+
+static trace_event_t events[4];
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for trace.c.
+ *------------------------------------------------------------------------
+ */
+void run_trace_test(void) {
+    kprintf("Running %s\n", __func__);
+    unsigned long cursor = 0;
+
+    // Test: Nothing is recorded while the category is disabled
+    assert_equal(trace_set_mask(0), TRACE_DEFAULT_MASK);
+    TRACE(TRACE_IPC, TRACE_SEND, 1, 2, 3);
+    assert_equal(trace_read(&cursor, events, 4), 0);
+    assert_equal(cursor, 0);
+
+    // Test: The mask only takes categories, and -1 leaves it as it is
+    assert_equal(trace_set_mask(TRACE_ALL + 1), -1);
+    assert_equal(trace_set_mask(TRACE_IPC), 0);
+    assert_equal(trace_set_mask(-1), TRACE_IPC);
+
+    // Test: Only the events of enabled categories are recorded, in order,
+    // and the cursor moves past the events read
+    TRACE(TRACE_IPC, TRACE_SEND, 1, 2, 3);
+    TRACE(TRACE_SCHED, TRACE_READY, 4, 5, 6);
+    TRACE(TRACE_IPC, TRACE_RECV, 2, 1, 7);
+    assert_equal(trace_read(&cursor, events, 4), 2);
+    assert_equal(cursor, 2);
+    assert_equal(events[0].seq, 0);
+    assert_equal(events[0].type, TRACE_SEND);
+    assert_equal(events[0].pid, 1);
+    assert_equal(events[0].arg0, 2);
+    assert_equal(events[0].arg1, 3);
+    assert_equal(events[0].cpu, this_cpu()->index);
+    assert_equal(events[1].seq, 1);
+    assert_equal(events[1].type, TRACE_RECV);
+    assert(events[1].timestamp >= events[0].timestamp, "Timestamps went backwards");
+    assert_equal(trace_read(&cursor, events, 4), 0);
+
+    // Test: A read copies at most count events and a later read continues
+    for (int i = 0; i < 3; i++) {
+        TRACE(TRACE_IPC, TRACE_SEND, i, 0, 0);
+    }
+    assert_equal(trace_read(&cursor, events, 2), 2);
+    assert_equal(events[1].pid, 1);
+    assert_equal(trace_read(&cursor, events, 4), 1);
+    assert_equal(events[0].pid, 2);
+    assert_equal(cursor, 5);
+
+    // Test: Once the buffer wraps the oldest events are overwritten, and a
+    // cursor pointing at them starts at the oldest event left
+    for (int i = 0; i < TRACE_TEST_SIZE + 3; i++) {
+        TRACE(TRACE_IPC, TRACE_SEND, i, 0, 0);
+    }
+    assert_equal(trace_read(&cursor, events, 1), 1);
+    assert_equal(events[0].seq, 8);
+    assert_equal(events[0].pid, 3);
+    unsigned long oldest = 0;
+    assert_equal(trace_read(&oldest, events, 1), 1);
+    assert_equal(events[0].seq, 8);
+    if (debug) kprintf("Cursor at %d after the wrap\n", cursor);
+
+    // Test: A cursor ahead of the head reads nothing
+    cursor = 1000000;
+    assert_equal(trace_read(&cursor, events, 4), 0);
+    assert_equal(cursor, TRACE_TEST_SIZE + 8);
+    assert_equal(trace_read(&cursor, events, -1), -1);
+
+    // Leave the buffer empty with the default categories
+    ktraceinit();
+    kprintf("Finished %s\n", __func__);
+}
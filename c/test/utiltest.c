@@ -0,0 +1,106 @@
+#include <xeroskernel.h>
+
+/*------------------------------------------------------------------------
+ * Tests for the block memory functions of util.c and of the startup
+ * code. Blocks of every length up to a few words are copied, moved and
+ * set at every alignment, and checked against a byte at a time
+ * reference, with the bytes around them left as they were.
+ *
+ * List of functions that are called from outside this file:
+ * - run_util_test
+ *   - Runs the test suite for the block memory functions
+ *------------------------------------------------------------------------
+ */
+
+// Lengths tested, and the bytes around a block that must not change
+#define UTIL_TEST_LENGTH 24
+#define UTIL_TEST_GUARD 8
+#define UTIL_TEST_SIZE (UTIL_TEST_LENGTH + 2 * UTIL_TEST_GUARD + sizeof(unsigned long))
+
+static void fill_pattern(unsigned char *buf);
+static void check_same(unsigned char *buf, unsigned char *expected);
+
+static int const debug = 0;
+
+static unsigned char buf[UTIL_TEST_SIZE];
+static unsigned char expected[UTIL_TEST_SIZE];
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for the block memory functions.
+ *------------------------------------------------------------------------
+ */
+void run_util_test(void) {
+    kprintf("Running %s\n", __func__);
+
+    for (int offset = 0; offset < sizeof(unsigned long); offset++) {
+        for (int len = 0; len <= UTIL_TEST_LENGTH; len++) {
+            unsigned char *block = buf + UTIL_TEST_GUARD + offset;
+            int start = UTIL_TEST_GUARD + offset;
+
+            // Test: fill_words and bzero set the block and nothing else
+            fill_pattern(buf);
+            fill_pattern(expected);
+            for (int i = 0; i < len; i++) {
+                expected[start + i] = 0xa5;
+            }
+            fill_words(block, 0x1a5, len);
+            check_same(buf, expected);
+            for (int i = 0; i < len; i++) {
+                expected[start + i] = 0;
+            }
+            bzero(block, len);
+            check_same(buf, expected);
+
+            // Test: copy_words and bcopy copy from a source at a different
+            // alignment
+            unsigned char src[UTIL_TEST_LENGTH + sizeof(unsigned long)];
+            for (int i = 0; i < sizeof(src); i++) {
+                src[i] = i * 7 + 1;
+            }
+            fill_pattern(buf);
+            fill_pattern(expected);
+            for (int i = 0; i < len; i++) {
+                expected[start + i] = src[i + 1];
+            }
+            copy_words(block, src + 1, len);
+            check_same(buf, expected);
+            fill_pattern(buf);
+            bcopy(src + 1, block, len);
+            check_same(buf, expected);
+
+            // Test: move_words copies overlapping blocks in either direction
+            for (int shift = -5; shift <= 5; shift++) {
+                fill_pattern(buf);
+                fill_pattern(expected);
+                for (int i = 0; i < len; i++) {
+                    expected[start + shift + i] = buf[start + i];
+                }
+                move_words(block + shift, block, len);
+                if (debug) kprintf("offset %d length %d shift %d\n", offset, len, shift);
+                check_same(buf, expected);
+            }
+        }
+    }
+
+    kprintf("Finished %s\n", __func__);
+}
+
+/*------------------------------------------------------------------------
+ * Sets every byte of a test buffer to a value of its own.
+ *------------------------------------------------------------------------
+ */
+static void fill_pattern(unsigned char *buf) {
+    for (int i = 0; i < UTIL_TEST_SIZE; i++) {
+        buf[i] = i + 0x40;
+    }
+}
+
+/*------------------------------------------------------------------------
+ * Checks that a test buffer holds what was expected.
+ *------------------------------------------------------------------------
+ */
+static void check_same(unsigned char *buf, unsigned char *expected) {
+    for (int i = 0; i < UTIL_TEST_SIZE; i++) {
+        assert_equal(buf[i], expected[i]);
+    }
+}
@@ -0,0 +1,103 @@
+#include <xeroskernel.h>
+
+/*------------------------------------------------------------------------
+ * Tests for workq.c. Run at boot before interrupts are enabled, so no
+ * drain of the work queue runs but those of the tests.
+ *
+ * List of functions that are called from outside this file:
+ * - run_workq_test
+ *   - Runs the test suite for workq.c
+ *------------------------------------------------------------------------
+ */
+
+#define NUM_TEST_WORK (WORK_BUDGET + 2)
+
+static void record_run(work_t *work);
+static void requeue_once(work_t *work);
+
+static int const debug = 0;
+
+static work_t works[NUM_TEST_WORK];
+// The items run, in the order they were run
+static work_t *runs[NUM_TEST_WORK * 2];
+static int num_runs;
+
+/*------------------------------------------------------------------------
+ * Runs the test suite for workq.c.
+ *------------------------------------------------------------------------
+ */
+void run_workq_test(void) {
+    kprintf("Running %s\n", __func__);
+    for (int i = 0; i < NUM_TEST_WORK; i++) {
+        init_work(&works[i], &record_run);
+    }
+    work_stats_t stats;
+
+    // Test: An empty queue runs nothing
+    assert_equal(work_pending(), 0);
+    assert_equal(run_work(), 0);
+
+    // Test: Items run once in the order they were queued, however many times
+    // they were queued
+    assert_equal(queue_work(&works[1]), 1);
+    assert_equal(queue_work(&works[0]), 1);
+    assert_equal(queue_work(&works[1]), 0);
+    assert_equal(work_pending(), 1);
+    num_runs = 0;
+    assert_equal(run_work(), 2);
+    assert_equal(num_runs, 2);
+    assert(runs[0] == &works[1] && runs[1] == &works[0], "Items did not run in the order queued");
+    assert_equal(work_pending(), 0);
+    get_work_stats(&stats);
+    assert_equal(stats.queued, 2);
+    assert_equal(stats.coalesced, 1);
+    assert_equal(stats.run, 2);
+    assert_equal(stats.high_water, 2);
+
+    // Test: A drain runs at most WORK_BUDGET items and leaves the rest queued
+    for (int i = 0; i < NUM_TEST_WORK; i++) {
+        queue_work(&works[i]);
+    }
+    num_runs = 0;
+    assert_equal(run_work(), WORK_BUDGET);
+    assert_equal(work_pending(), 1);
+    assert_equal(run_work(), NUM_TEST_WORK - WORK_BUDGET);
+    assert_equal(num_runs, NUM_TEST_WORK);
+    for (int i = 0; i < NUM_TEST_WORK; i++) {
+        assert(runs[i] == &works[i], "Items did not run in the order queued");
+    }
+    get_work_stats(&stats);
+    assert_equal(stats.deferred, 1);
+
+    // Test: An item may queue itself again while it runs, and runs again in the
+    // same drain
+    init_work(&works[0], &requeue_once);
+    queue_work(&works[0]);
+    num_runs = 0;
+    assert_equal(run_work(), 2);
+    assert_equal(num_runs, 2);
+    assert_equal(work_pending(), 0);
+    if (debug) kprintf("%d items run in all\n", stats.run);
+
+    // Leave the counters to the devices
+    kworkinit();
+}
+
+/*------------------------------------------------------------------------
+ * Records that a work item ran.
+ *------------------------------------------------------------------------
+ */
+static void record_run(work_t *work) {
+    runs[num_runs++] = work;
+}
+
+/*------------------------------------------------------------------------
+ * Records that a work item ran, and queues it again the first time.
+ *------------------------------------------------------------------------
+ */
+static void requeue_once(work_t *work) {
+    record_run(work);
+    if (num_runs == 1) {
+        assert_equal(queue_work(work), 1);
+    }
+}
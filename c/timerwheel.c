@@ -0,0 +1,243 @@
+#include <xeroskernel.h>
+#include <timerwheel.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is a hierarchical timing wheel to store timer entries, keyed on the tick at
+ * which an entry is due. The entries are embedded in what they time, a sleeping or
+ * blocked process or a kernel timer. Inserting, removing and expiring an entry
+ * take constant time, however many entries are in the wheel.
+ *
+ * Notes on the wheel:
+ * - The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots each, a slot is a list
+ *   of the entries that are due in it, linked through their own pointers so a
+ *   process may also be on a blocked queue while it waits for a timeout
+ * - An entry due at tick e sits on the lowest level L at which e and the current
+ *   tick agree in every bit above the first L + 1 groups of WHEEL_LEVEL_BITS bits,
+ *   in the slot given by the L-th group of bits of e
+ * - When the current tick enters the slot of a level above 0, the entries in that
+ *   slot are moved down to the levels below, so an entry is moved at most
+ *   WHEEL_LEVELS - 1 times before it expires
+ * - Every entry on level 0 in the slot of the current tick is due, and the expire
+ *   function of the entry is called once it has been removed from the wheel
+ *
+ * References:
+ * - G. Varghese and T. Lauck, Hashed and Hierarchical Timing Wheels
+ *
+ * List of functions that are called from outside this file:
+ * - init_timer_wheel
+ *   - Initializes the timing wheel
+ * - wheel_insert
+ *   - Adds an entry to the timing wheel
+ * - wheel_remove
+ *   - Removes an entry from the timing wheel
+ * - wheel_advance
+ *   - Advances the timing wheel by one tick and expires the entries due
+ * - wheel_next_expiry
+ *   - Returns a lower bound on the number of ticks until an entry is due
+ * - wheel_size
+ *   - Returns the number of entries in the timing wheel
+ * - in_wheel
+ *   - Returns 1 if an entry is in a timing wheel, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+
+static void place(TimerWheel *wheel, timer_entry_t *entry);
+static void cascade(TimerWheel *wheel, int level);
+static void slot_append(TimerSlot *slot, timer_entry_t *entry);
+static void slot_unlink(TimerSlot *slot, timer_entry_t *entry);
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the timing wheel with no entries in it.
+ *-----------------------------------------------------------------------------------
+ */
+void init_timer_wheel(TimerWheel *wheel) {
+    assert(wheel != NULL, "wheel passed to init_timer_wheel was null");
+    wheel->now = 0;
+    wheel->size = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot].head = NULL;
+            wheel->slots[level][slot].tail = NULL;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds an entry with a specified delay (in ticks) to the timing wheel. Two entries
+ * due at the same tick are expired in the order they were inserted. The expire
+ * function of the entry must be set.
+ *
+ * @param entry The entry to add
+ * @param delay The delay in ticks until the entry is due, a delay of 0 is due on
+ *              the next tick and a delay over WHEEL_MAX_DELAY is shortened to it
+ *-----------------------------------------------------------------------------------
+ */
+void wheel_insert(TimerWheel *wheel, timer_entry_t *entry, int delay) {
+    assert(wheel != NULL, "wheel passed to wheel_insert was null");
+    assert(entry != NULL, "entry passed to wheel_insert was null");
+    assert(entry->expire != NULL, "entry passed to wheel_insert has no expire function");
+    assert(delay >= 0, "delay passed to wheel_insert was negative");
+    assert(entry->slot == NULL, "entry passed to wheel_insert is already in the wheel");
+
+    if (delay < 1) {
+        delay = 1;
+    }
+    if (delay > WHEEL_MAX_DELAY) {
+        delay = WHEEL_MAX_DELAY;
+    }
+    entry->wake_tick = wheel->now + delay;
+    place(wheel, entry);
+    wheel->size++;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given entry from the timing wheel.
+ *
+ * @return The number of ticks the entry had left until it was due
+ *-----------------------------------------------------------------------------------
+ */
+int wheel_remove(TimerWheel *wheel, timer_entry_t *entry) {
+    assert(wheel != NULL, "wheel_remove: wheel was null");
+    assert(entry != NULL, "wheel_remove: entry was null");
+    assert(entry->slot != NULL, "wheel_remove: entry is not in the wheel");
+
+    slot_unlink(entry->slot, entry);
+    wheel->size--;
+    return (int) (entry->wake_tick - wheel->now);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Advances the timing wheel by one tick, removes every entry that is due at the new
+ * tick and calls its expire function, in the order the entries were inserted. An
+ * expire function may insert and remove entries, including the one expired.
+ *-----------------------------------------------------------------------------------
+ */
+void wheel_advance(TimerWheel *wheel) {
+    assert(wheel != NULL, "wheel passed to wheel_advance was null");
+    wheel->now++;
+
+    // Find the highest level whose slot the new tick has just entered, and move its
+    // entries down, starting from the top so none is moved past its level
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && ((wheel->now >> (WHEEL_LEVEL_BITS * level)) & (WHEEL_SLOTS - 1)) == 0) {
+        level++;
+    }
+    for (; level > 0; level--) {
+        cascade(wheel, level);
+    }
+
+    TimerSlot *due = &wheel->slots[0][wheel->now & (WHEEL_SLOTS - 1)];
+    while (due->head != NULL) {
+        timer_entry_t *entry = due->head;
+        slot_unlink(due, entry);
+        wheel->size--;
+        entry->expire(entry);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of ticks until the next entry is due, or until entries may be
+ * moved down to level 0 if that is sooner, so the timing wheel must be advanced by
+ * at least that many ticks before any entry is missed.
+ *
+ * @param limit The largest number of ticks to look ahead
+ * @return      A number of ticks from 1 to limit
+ *-----------------------------------------------------------------------------------
+ */
+int wheel_next_expiry(TimerWheel *wheel, int limit) {
+    assert(wheel != NULL, "wheel passed to wheel_next_expiry was null");
+    int current = wheel->now & (WHEEL_SLOTS - 1);
+    for (int ticks = 1; ticks < limit; ticks++) {
+        int slot = current + ticks;
+        // The wheel cascades when level 0 wraps around
+        if (slot >= WHEEL_SLOTS || wheel->slots[0][slot].head != NULL) {
+            return ticks;
+        }
+    }
+    return limit;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the number of entries in the timing wheel.
+ *-----------------------------------------------------------------------------------
+ */
+int wheel_size(TimerWheel *wheel) {
+    assert(wheel != NULL, "wheel passed to wheel_size was null");
+    return wheel->size;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Checks if the given entry is in a timing wheel.
+ *
+ * @return 1 if the entry is in a timing wheel, 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+int in_wheel(timer_entry_t *entry) {
+    return entry->slot != NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given entry to the slot of the timing wheel for its wake tick, given the
+ * current tick.
+ *-----------------------------------------------------------------------------------
+ */
+static void place(TimerWheel *wheel, timer_entry_t *entry) {
+    unsigned long long differing = entry->wake_tick ^ wheel->now;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && (differing >> (WHEEL_LEVEL_BITS * (level + 1))) != 0) {
+        level++;
+    }
+    int slot = (entry->wake_tick >> (WHEEL_LEVEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    slot_append(&wheel->slots[level][slot], entry);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Moves the entries in the slot of the given level that the current tick has just
+ * entered down to the levels below.
+ *-----------------------------------------------------------------------------------
+ */
+static void cascade(TimerWheel *wheel, int level) {
+    int slot = (wheel->now >> (WHEEL_LEVEL_BITS * level)) & (WHEEL_SLOTS - 1);
+    TimerSlot *moved = &wheel->slots[level][slot];
+    while (moved->head != NULL) {
+        timer_entry_t *entry = moved->head;
+        slot_unlink(moved, entry);
+        place(wheel, entry);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given entry to the end of the given slot.
+ *-----------------------------------------------------------------------------------
+ */
+static void slot_append(TimerSlot *slot, timer_entry_t *entry) {
+    entry->next = NULL;
+    entry->prev = slot->tail;
+    if (slot->tail != NULL) {
+        slot->tail->next = entry;
+    } else {
+        slot->head = entry;
+    }
+    slot->tail = entry;
+    entry->slot = slot;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Removes the given entry from the given slot it is in.
+ *-----------------------------------------------------------------------------------
+ */
+static void slot_unlink(TimerSlot *slot, timer_entry_t *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        slot->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        slot->tail = entry->prev;
+    }
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->slot = NULL;
+}
@@ -0,0 +1,134 @@
+/* trace.c : kernel event trace buffer */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/*-----------------------------------------------------------------------------------
+ * This is the kernel trace buffer, which records what the dispatcher and the
+ * drivers did as binary events, without printing anything while it happens. Events
+ * are recorded in a ring of TRACE_BUFFER_SIZE events that overwrites the oldest
+ * ones once it is full, and are read back with systraceread long after the fact.
+ *
+ * Notes on the trace buffer:
+ * - Events fall in categories, TRACE_SYSCALL, TRACE_SCHED, TRACE_IPC, TRACE_TIMER
+ *   and TRACE_INTR, that are enabled and disabled at runtime with systracectl.
+ *   TRACE tests the mask inline, so a disabled event costs a load and a branch
+ * - Recording an event is a read of the time stamp counter and a few stores into
+ *   the slot at the head of the ring, nothing is allocated or locked
+ * - Events are recorded with the kernel lock held or from an ISR, so they are never
+ *   recorded by two processors at once
+ * - Every event carries its sequence number, the count of events recorded before
+ *   it. A reader keeps the sequence number of the next event it wants as a cursor,
+ *   and finds out how many events it missed from the first one it reads
+ *
+ * List of functions that are called from outside this file:
+ * - ktraceinit
+ *   - Empties the trace buffer and enables the default categories
+ * - trace_record
+ *   - Records an event in the trace buffer
+ * - trace_set_mask
+ *   - Implements the kernel side of systracectl
+ * - trace_read
+ *   - Implements the kernel side of systraceread
+ *-----------------------------------------------------------------------------------
+ */
+
+#define TRACE_BUFFER_SIZE (1 << TRACE_BUFFER_ORDER)
+#define TRACE_BUFFER_MASK (TRACE_BUFFER_SIZE - 1)
+
+unsigned int trace_mask;
+
+// The ring of events, and the number of events recorded in it since boot
+static trace_event_t trace_ring[TRACE_BUFFER_SIZE];
+static unsigned long trace_head;
+
+/*-----------------------------------------------------------------------------------
+ * To be called after ksmpinit, before any event is recorded. Empties the trace
+ * buffer and enables the categories in TRACE_DEFAULT_MASK.
+ *-----------------------------------------------------------------------------------
+ */
+void ktraceinit(void) {
+    fill_words(trace_ring, 0, sizeof(trace_ring));
+    trace_head = 0;
+    trace_mask = TRACE_DEFAULT_MASK;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Records an event in the slot at the head of the trace buffer, overwriting the
+ * oldest event if the buffer is full. Called through TRACE, which leaves out the
+ * events of disabled categories.
+ *
+ * @param type The kind of event
+ * @param pid  The PID of the process the event is about
+ * @param arg0 The first argument of the event, see trace_type_t
+ * @param arg1 The second argument of the event
+ *-----------------------------------------------------------------------------------
+ */
+void trace_record(trace_type_t type, unsigned int pid, unsigned long arg0, unsigned long arg1) {
+    trace_event_t *event = &trace_ring[trace_head & TRACE_BUFFER_MASK];
+    event->timestamp = read_tsc();
+    event->seq = trace_head++;
+    event->type = type;
+    event->cpu = this_cpu()->index;
+    event->pid = pid;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of systracectl. Sets the categories of events that are
+ * recorded, the events already recorded are kept.
+ *
+ * @param mask The categories to record, TRACE_SYSCALL to TRACE_ALL, or -1 to leave
+ *             them as they are
+ * @return     The categories that were recorded before, -1 if the mask has bits
+ *             that are not a category
+ *-----------------------------------------------------------------------------------
+ */
+int trace_set_mask(int mask) {
+    int old_mask = trace_mask;
+    if (mask == -1) {
+        return old_mask;
+    }
+    if (mask & ~TRACE_ALL) {
+        return -1;
+    }
+    trace_mask = mask;
+    return old_mask;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of systraceread. Copies the events from the one with
+ * the sequence number in the cursor on, oldest first, and advances the cursor past
+ * them. A cursor pointing at events that have been overwritten starts at the oldest
+ * event still in the buffer.
+ *
+ * @param cursor A pointer to the sequence number of the next event to read, 0 to
+ *               start from the oldest event, already checked by the caller
+ * @param events A pointer to where the events are copied, already checked by the
+ *               caller
+ * @param count  The most events to copy
+ * @return       The number of events copied, 0 if there are no new events, or -1 if
+ *               count is negative
+ *-----------------------------------------------------------------------------------
+ */
+int trace_read(unsigned long *cursor, trace_event_t *events, int count) {
+    if (count < 0) {
+        return -1;
+    }
+    unsigned long seq = *cursor;
+    // The cursor may be ahead of the head only if it was made up by the caller
+    if (seq > trace_head) {
+        seq = trace_head;
+    }
+    if (trace_head - seq > TRACE_BUFFER_SIZE) {
+        seq = trace_head - TRACE_BUFFER_SIZE;
+    }
+    int copied = 0;
+    while (copied < count && seq != trace_head) {
+        events[copied++] = trace_ring[seq & TRACE_BUFFER_MASK];
+        seq++;
+    }
+    *cursor = seq;
+    return copied;
+}
@@ -5,6 +5,7 @@
 #include <xeroslib.h>
 #include <stdarg.h>
 #include <kbd.h>
+#include <format.h>
 
 /*-----------------------------------------------------------------------------------
  *  User processes reside here. root is the first process started by the
@@ -14,16 +15,59 @@
 
 static void shell(void);
 static void alarm_handler(void *arg);
-static void alarm_process(void);
 static void t_process(void);
+static void trace_process(void);
+static void top_process(void *arg);
+static void run_job(PID_t pid, int background);
+static int median_bucket(unsigned long *histogram, int buckets, unsigned long count);
+static proc_status_t *find_status(processStatuses *ps, int procs, int pid);
+static int compare_top_cpu(void *a, void *b);
+static int compare_top_pid(void *a, void *b);
+static int compare_top_syscalls(void *a, void *b);
+static int compare_top_ipc(void *a, void *b);
+static void logger_process(void *arg);
+static char *printable_trace_type(unsigned char type);
 static void remove_newline(char *str);
 static int parse_command(char *input_buf, char *command_buf, char *arg_buf);
 static int is_empty(char *buf);
 static void run_root_tests(void);
 static char *printable_state(process_state_t state, blocked_queue_t blocked_queue);
+static unsigned long read_cycle_counter(void);
+static unsigned long kilocycles(unsigned long long cycles);
+static void print_ipc_queue(char *prefix, char *name, ipc_queue_stats_t *stats, unsigned long depth);
 
-// The time and shell pid for "a" command
-static unsigned int g_time;
+// Calls the "io" command times on each memory device, and the bytes each one moves
+#define IO_BENCH_CALLS 1000
+#define IO_BENCH_BYTES 512
+// Events the "trace" command reads per systraceread, and the milliseconds it sleeps
+// between reads while following the trace buffer
+#define TRACE_READ_BATCH 16
+#define TRACE_FOLLOW_INTERVAL 100
+// Buckets of the histogram of the sampling profiler the "prof" command prints
+#define PROFILE_TOP 10
+// Records the logger process reads per syslogread
+#define LOG_READ_BATCH 8
+// Milliseconds between the refreshes of the "top" command, and the refreshes it makes
+#define TOP_INTERVAL 1000
+#define TOP_REFRESHES 10
+
+// What the rows of the "top" command are sorted by, the largest first but for PIDs
+#define TOP_SORT_CPU 0
+#define TOP_SORT_PID 1
+#define TOP_SORT_SYSCALLS 2
+#define TOP_SORT_IPC 3
+
+// A row of the "top" command, with the rates over the last refresh
+typedef struct top_row {
+    proc_status_t *status;
+    // Share of the CPU time of the refresh in tenths of a percent
+    int cpu_share;
+    // System calls made, and messages sent and received, per second
+    unsigned int syscall_rate;
+    unsigned int ipc_rate;
+} top_row_t;
+
+// The shell pid for "a" command
 static PID_t g_shell_pid;
 
 /*-----------------------------------------------------------------------------------
@@ -33,6 +77,9 @@ static PID_t g_shell_pid;
  */
 void init(void) {
     run_root_tests();
+    // Write out the kernel log from now on, at the lowest priority
+    spawn_attr_t logger_attr = {PROCESS_STACK_SIZE, NUM_PRIORITIES - 1, 0};
+    sysspawn(&logger_process, NULL, 0, &logger_attr);
 
     // The only username to support is cs415
     char *username = "cs415";
@@ -40,9 +87,9 @@ void init(void) {
 
     while (1) {
         char username_buf[32];
-        memset(username_buf, '\0', sizeof(username_buf));
+        fill_words(username_buf, '\0', sizeof(username_buf));
         char password_buf[32];
-        memset(password_buf, '\0', sizeof(password_buf));
+        fill_words(password_buf, '\0', sizeof(password_buf));
 
         // Print a banner
         sysputs("\nWelcome to Xeros - a not so experimental OS\n");
@@ -66,8 +113,8 @@ void init(void) {
         remove_newline(password_buf);
 
         // Verify the username and password
-        int correct_username = strcmp(username_buf, username) == 0;
-        int correct_password = strcmp(password_buf, password) == 0;
+        int correct_username = strcmp_words(username_buf, username) == 0;
+        int correct_password = strcmp_words(password_buf, password) == 0;
         if (correct_username && correct_password) {
             sysputs("\nAuthenticated!\n");
             // Create the shell program
@@ -101,9 +148,9 @@ static void shell(void) {
 
     sysputs("\n");
     while (1) {
-        memset(input_buf, '\0', sizeof(input_buf));
-        memset(command_buf, '\0', sizeof(command_buf));
-        memset(arg_buf, '\0', sizeof(arg_buf));
+        fill_words(input_buf, '\0', sizeof(input_buf));
+        fill_words(command_buf, '\0', sizeof(command_buf));
+        fill_words(arg_buf, '\0', sizeof(arg_buf));
 
         // Print the prompt >
         sysputs("> ");
@@ -126,14 +173,137 @@ static void shell(void) {
         int parse_command_return = parse_command(input_buf, command_buf, arg_buf);
 
         // Commands designated as builtin are run by the shell directly
-        if (strcmp(command_buf, "ps") == 0) {
+        if (strcmp_words(command_buf, "ps") == 0) {
             // ps - Builtin
+            // With -a it prints the accounting of every process instead
+            if (parse_command_return == -1) {
+                sysputs("Usage: ps [-a]\n");
+            } else if (is_empty(arg_buf)) {
+                call_sysgetcputimes();
+            } else if (strcmp_words(arg_buf, "-a") == 0) {
+                call_sysgetaccounting();
+            } else {
+                sysputs("Usage: ps [-a]\n");
+            }
+        } else if (strcmp_words(command_buf, "top") == 0) {
+            // top - Partially builtin
+            // Starts a process that prints the processes every TOP_INTERVAL milliseconds,
+            // sorted by their share of the CPU, their PID, or their system call or IPC rate
+            int top_sort = TOP_SORT_CPU;
+            if (strcmp_words(arg_buf, "pid") == 0) {
+                top_sort = TOP_SORT_PID;
+            } else if (strcmp_words(arg_buf, "sys") == 0) {
+                top_sort = TOP_SORT_SYSCALLS;
+            } else if (strcmp_words(arg_buf, "ipc") == 0) {
+                top_sort = TOP_SORT_IPC;
+            }
+            if (parse_command_return == -1 || (!is_empty(arg_buf) && strcmp_words(arg_buf, "cpu") != 0 &&
+                                               top_sort == TOP_SORT_CPU)) {
+                sysputs("Usage: top [cpu | pid | sys | ipc]\n");
+            } else {
+                PID_t top_process_pid = sysspawn(&top_process, &top_sort, sizeof(top_sort), NULL);
+                run_job(top_process_pid, parse_command_return == 1);
+            }
+        } else if (strcmp_words(command_buf, "mem") == 0) {
+            // mem - Builtin
             if (!is_empty(arg_buf) || parse_command_return == -1) {
-                sysputs("Usage: ps\n");
+                sysputs("Usage: mem\n");
             } else {
-                call_sysgetcputimes();
+                call_sysgetmemstats();
+            }
+        } else if (strcmp_words(command_buf, "sys") == 0) {
+            // sys - Builtin
+            if (!is_empty(arg_buf) || parse_command_return == -1) {
+                sysputs("Usage: sys\n");
+            } else {
+                call_sysgetsyscallstats();
+            }
+        } else if (strcmp_words(command_buf, "lat") == 0) {
+            // lat - Builtin
+            if (!is_empty(arg_buf) || parse_command_return == -1) {
+                sysputs("Usage: lat\n");
+            } else {
+                call_sysgetlatency();
+            }
+        } else if (strcmp_words(command_buf, "ipc") == 0) {
+            // ipc - Builtin
+            if (!is_empty(arg_buf) || parse_command_return == -1) {
+                sysputs("Usage: ipc\n");
+            } else {
+                call_sysgetipcstats();
+            }
+        } else if (strcmp_words(command_buf, "io") == 0) {
+            // io - Builtin
+            if (!is_empty(arg_buf) || parse_command_return == -1) {
+                sysputs("Usage: io\n");
+            } else {
+                call_iobench();
+            }
+        } else if (strcmp_words(command_buf, "load") == 0) {
+            // load - Partially builtin
+            // Starts the load generator, takes the seconds to run for and the number of
+            // CPU-bound, IPC, sleep-heavy and allocation-heavy workers, separated by commas
+            load_config_t load_config;
+            if (parse_command_return == -1 || load_parse(arg_buf, &load_config) != 0) {
+                sysputs("Usage: load [seconds[,cpu[,ipc[,sleep[,alloc]]]]]\n");
+            } else {
+                PID_t load_process_pid = sysspawn(&load_process, &load_config, sizeof(load_config), NULL);
+                run_job(load_process_pid, parse_command_return == 1);
+            }
+        } else if (strcmp_words(command_buf, "trace") == 0) {
+            // trace - Partially builtin
+            // Prints the kernel trace buffer, takes a mask of the categories of events
+            // to record, or with -f starts a process that prints the events as they are
+            // recorded
+            if (parse_command_return == -1) {
+                sysputs("Usage: trace [mask | -f]\n");
+            } else if (is_empty(arg_buf)) {
+                call_systrace(0);
+            } else if (strcmp_words(arg_buf, "-f") == 0) {
+                PID_t trace_process_pid = syscreate(trace_process, PROCESS_STACK_SIZE);
+                run_job(trace_process_pid, parse_command_return == 1);
+            } else if (arg_buf[0] >= '0' && arg_buf[0] <= '9' && systracectl(atoi(arg_buf)) >= 0) {
+                char print_buf[64];
+                sprintf(print_buf, "Tracing categories 0x%x\n", systracectl(-1));
+                sysputs(print_buf);
+            } else {
+                sysputs("Usage: trace [mask | -f]\n");
+            }
+        } else if (strcmp_words(command_buf, "prof") == 0) {
+            // prof - Builtin
+            // Prints the hottest addresses found by the sampling profiler, takes start to
+            // sample every process, the PID of a process to sample only it, or stop
+            if (parse_command_return == -1) {
+                sysputs("Usage: prof [start | pid | stop]\n");
+            } else if (is_empty(arg_buf)) {
+                call_sysprofread();
+            } else if (strcmp_words(arg_buf, "start") == 0) {
+                sysprofstart(0);
+            } else if (strcmp_words(arg_buf, "stop") == 0) {
+                if (sysprofstop() != 0) {
+                    sysputs("The profiler is not running\n");
+                }
+            } else if (atoi(arg_buf) > 0) {
+                if (sysprofstart(atoi(arg_buf)) != 0) {
+                    sysputs("No such process\n");
+                }
+            } else {
+                sysputs("Usage: prof [start | pid | stop]\n");
+            }
+        } else if (strcmp_words(command_buf, "log") == 0) {
+            // log - Builtin
+            // Prints the level of the records made in the kernel log, or sets it
+            if (parse_command_return == -1) {
+                sysputs("Usage: log [level]\n");
+            } else if (!is_empty(arg_buf) && (arg_buf[0] < '0' || arg_buf[0] > '9' ||
+                                               syslogctl(atoi(arg_buf)) < 0)) {
+                sysputs("Usage: log [level], 0 for errors to 3 for debugging\n");
+            } else {
+                char print_buf[64];
+                sprintf(print_buf, "Logging up to level %d\n", syslogctl(-1));
+                sysputs(print_buf);
             }
-        } else if (strcmp(command_buf, "ex") == 0) {
+        } else if (strcmp_words(command_buf, "ex") == 0) {
             // ex - Builtin
             // Causes the shell to exit
             if (!is_empty(arg_buf) || parse_command_return == -1) {
@@ -144,12 +314,18 @@ static void shell(void) {
                 sysclose(fd);
                 sysstop();
             }
-        } else if (strcmp(command_buf, "k") == 0) {
+        } else if (strcmp_words(command_buf, "k") == 0) {
             // k - Builtin
             // Takes a parameter, the PID of the process to terminate, and kills that process
-            int proc_to_kill = atoi(arg_buf);
+            // With a - before it, the parameter is a process group, and the whole job is killed
+            int group = arg_buf[0] == '-';
+            int proc_to_kill = atoi(group ? arg_buf + 1 : arg_buf);
             if (proc_to_kill <= 0 || parse_command_return == -1) {
-                sysputs("Usage: k pid\n");
+                sysputs("Usage: k pid | k -pgid\n");
+            } else if (group) {
+                if (syskillpg(proc_to_kill, 31) == -514) {
+                    sysputs("No such process group\n");
+                }
             } else {
                 // Shell is killing itself
                 if (proc_to_kill == g_shell_pid) {
@@ -163,32 +339,30 @@ static void shell(void) {
                     sysputs("No such process\n");
                 }
             }
-        } else if (strcmp(command_buf, "a") == 0) {
+        } else if (strcmp_words(command_buf, "a") == 0) {
             // a - Partially builtin
             // Takes a parameter that is the number of milliseconds before signal 18 is to be sent
-            g_time = atoi(arg_buf);
-            if (g_time <= 0 || parse_command_return == -1) {
+            int time = atoi(arg_buf);
+            if (time <= 0 || parse_command_return == -1) {
                 sysputs("Usage: a number_of_milliseconds\n");
             } else {
                 // Install a handler that prints "ALARM ALARM ALARM"
                 signal_handler_funcptr old_handler;
                 syssighandler(18, &alarm_handler, &old_handler);
-                PID_t alarm_proc_pid = syscreate(&alarm_process, PROCESS_STACK_SIZE);
+                systimer(g_shell_pid, 18, time, 0);
                 if (parse_command_return != 1) {
-                    // If the command line ends with '&': run the alarm process in the background
-                    // Otherwise, wait for the alarm process to terminate
-                    syswait(alarm_proc_pid);
+                    // If the command line ends with '&': let the alarm go off in the background
+                    // Otherwise, wait for the alarm, the signal ends the sleep
+                    syssleep(time);
                 }
             }
-        } else if (strcmp(command_buf, "t") == 0) {
+        } else if (strcmp_words(command_buf, "t") == 0) {
             if (!is_empty(arg_buf) || parse_command_return == -1) {
                 sysputs("Usage: t\n");
             } else {
                 // t - Starts the t process which simply prints, on a new line, a "T" every 10 seconds or so
                 PID_t t_process_pid = syscreate(t_process, PROCESS_STACK_SIZE);
-                if (parse_command_return != 1) {
-                    syswait(t_process_pid);
-                }
+                run_job(t_process_pid, parse_command_return == 1);
             }
         } else {
             // The command does not exist
@@ -197,6 +371,22 @@ static void shell(void) {
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Places a process the shell started for a command in a process group of its own,
+ * so "k -pgid" with its PID terminates it along with the processes it starts, and
+ * waits for it unless the command runs in the background.
+ *
+ * @param pid        The PID of the process
+ * @param background 1 if the command line ended with '&', 0 otherwise
+ *-----------------------------------------------------------------------------------
+ */
+static void run_job(PID_t pid, int background) {
+    syssetpgid(pid, 0);
+    if (!background) {
+        syswait(pid);
+    }
+}
+
 /*-----------------------------------------------------------------------------------
  * Used to service "a" command. Prints "ALARM ALARM ALARM."
  *-----------------------------------------------------------------------------------
@@ -208,15 +398,6 @@ static void alarm_handler(void *arg) {
     syssighandler(18, NULL, &old_handler);
 }
 
-/*-----------------------------------------------------------------------------------
- * Used to service "a" command. Sleeps for the required number of ticks and then sends the signal 18 to the shell.
- *-----------------------------------------------------------------------------------
- */
-static void alarm_process(void) {
-    syssleep(g_time);
-    syskill(g_shell_pid, 18);
-}
-
 /*-----------------------------------------------------------------------------------
  * Used to service "t" command. Prints, on a new line, a "T" every 10 seconds or so.
  *-----------------------------------------------------------------------------------
@@ -228,6 +409,59 @@ static void t_process(void) {
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Used to service "trace -f" command. Prints the events of the kernel trace buffer
+ * as they are recorded, until it is killed.
+ *-----------------------------------------------------------------------------------
+ */
+static void trace_process(void) {
+    call_systrace(1);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Used to service "top" command. Prints the processes TOP_REFRESHES times, in the
+ * sort order its argument points to.
+ *-----------------------------------------------------------------------------------
+ */
+static void top_process(void *arg) {
+    call_top(*(int *) arg, TOP_REFRESHES);
+}
+
+/*-----------------------------------------------------------------------------------
+ * The logger process, started by init at the lowest priority. Takes the records out
+ * of the kernel log and writes each one out on a line of its own, prefixed with its
+ * level and processor, so the kernel never formats them itself. Sleeps for
+ * LOG_FLUSH_INTERVAL milliseconds whenever the log is empty.
+ *-----------------------------------------------------------------------------------
+ */
+static void logger_process(void *arg) {
+    static char *level_names[] = {"error", "warn", "info", "debug"};
+    log_record_t records[LOG_READ_BATCH];
+    char print_buf[256];
+
+    for (;;) {
+        int count = syslogread(records, LOG_READ_BATCH);
+        if (count <= 0) {
+            syssleep(LOG_FLUSH_INTERVAL);
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            log_record_t *record = &records[i];
+            if (record->dropped > 0) {
+                format_string(print_buf, sizeof(print_buf), "[klog] %d records dropped on cpu %d\n",
+                              record->dropped, record->cpu);
+                sysputs(print_buf);
+            }
+            // A record too long for the buffer is cut short rather than overrunning it
+            int len = format_string(print_buf, sizeof(print_buf), "[%s %d] ",
+                                    level_names[record->level], record->cpu);
+            format_string(print_buf + len, sizeof(print_buf) - len, record->fmt, record->args[0],
+                          record->args[1], record->args[2], record->args[3]);
+            sysputs(print_buf);
+        }
+    }
+}
+
 /*-----------------------------------------------------------------------------------
  * Sets the first newline encountered in the given buffer to a null terminator.
  *
@@ -320,11 +554,21 @@ static int is_empty(char *buf) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Runs test suites that depend on a root process.
+ * Runs test suites that depend on a root process, or the benchmarks in their place,
+ * unless the tests are left out.
  *-----------------------------------------------------------------------------------
  */
 static void run_root_tests(void) {
+    if (BENCH) {
+        run_bench();
+        return;
+    }
+    if (!RUN_TESTS) {
+        return;
+    }
     run_create_test();
+    run_arena_test();
+    run_paging_test();
     // Test suite assumes pre-emption is disabled
     if (!PREEMPTION_ENABLED) {
         // Commented out for Assignment 3: Not applicable - run_msg_test();
@@ -334,15 +578,17 @@ static void run_root_tests(void) {
     if (PREEMPTION_ENABLED) {
         run_preemption_test();
         run_device_test();
+        run_load_test();
     }
     run_syscall_test();
 }
 
 /*-----------------------------------------------------------------------------------
  * Calls sysgetcputimes and lists all the current living/active processes one per
- * line. Each line consists of 3 spaced columns. The columns, which are to have
- * headings, are the PID, the current state of the process, and the amount of time
- * the process has run in milliseconds.
+ * line. Each line consists of 5 spaced columns. The columns, which are to have
+ * headings, are the PID, the current state of the process, the amount of time
+ * the process has run in milliseconds, the peak stack usage of the process in
+ * bytes, and the time left in the current quantum of the process in milliseconds.
  *
  * Note that the state of the process running the ps command (shell) is reported as
  * RUNNING.
@@ -350,20 +596,535 @@ static void run_root_tests(void) {
  */
 void call_sysgetcputimes(void) {
     char print_buf[1024];
-    processStatuses psTab;
     int procs;
+    int shm_id;
+
+    processStatuses *ps = alloc_buffer(PS_SIZE(MAX_PROCESSES + 1), &shm_id);
+    if (ps == NULL) {
+        sysputs("Could not allocate the process table\n");
+        return;
+    }
+    ps->size = MAX_PROCESSES + 1;
+    procs = sysgetcputimes(ps);
+
+    sysputs("PID  | STATE                | CPU TIME   | SHARE  | STACK      | QUANTUM   \n");
+    for (int j = 0; j <= procs; j++) {
+        proc_status_t *status = &ps->proc[j];
+        sprintf(print_buf, "%-4d | %-20s | %-10d | %3d.%d%% | %-10d | %-10d\n", status->pid,
+                printable_state(status->state, status->blocked_queue),
+                status->cpuTime, status->cpuShare / 10, status->cpuShare % 10,
+                status->stackUsage, status->quantumLeft);
+        sysputs(print_buf);
+    }
+    free_buffer(shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetcputimes and prints the accounting of every process, one per line: the
+ * PID, the processor cycles it has run in units of 1024, the times it gave up the
+ * processor through a system call and was switched out by an interrupt, the system
+ * calls it has made and the signals delivered to it. Each blocked queue the process
+ * has spent time on follows on a line of its own, with the cycles it spent there in
+ * the same units.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysgetaccounting(void) {
+    char print_buf[1024];
+    int procs;
+    int shm_id;
 
-    procs = sysgetcputimes(&psTab);
+    processStatuses *ps = alloc_buffer(PS_SIZE(MAX_PROCESSES + 1), &shm_id);
+    if (ps == NULL) {
+        sysputs("Could not allocate the process table\n");
+        return;
+    }
+    ps->size = MAX_PROCESSES + 1;
+    procs = sysgetcputimes(ps);
 
-    sysputs("PID  | STATE                | CPU TIME  \n");
+    sysputs("PID  | KCYCLES    | VOLUNTARY  | INVOLUNTARY | SYSCALLS   | SIGNALS   \n");
     for (int j = 0; j <= procs; j++) {
-        sprintf(print_buf, "%-4d | %-20s | %-10d\n", psTab.pid[j],
-                printable_state(psTab.state[j], psTab.blocked_queue[j]),
-                psTab.cpuTime[j]);
+        proc_status_t *status = &ps->proc[j];
+        sprintf(print_buf, "%-4d | %-10u | %-10u | %-11u | %-10u | %-10u\n", status->pid,
+                kilocycles(status->runCycles), status->voluntarySwitches,
+                status->involuntarySwitches, status->syscalls, status->signalsDelivered);
+        sysputs(print_buf);
+        for (int queue = 0; queue < NUM_BLOCKED_QUEUES; queue++) {
+            if (status->blockedCycles[queue] == 0) {
+                continue;
+            }
+            sprintf(print_buf, "     | %-20s | %u kcycles\n", printable_state(BLOCKED, queue),
+                    kilocycles(status->blockedCycles[queue]));
+            sysputs(print_buf);
+        }
+    }
+    free_buffer(shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetcputimes every TOP_INTERVAL milliseconds and prints the processes, one
+ * per line, with what they did since the last call: the PID, the state, the share
+ * of the CPU time in percent, the priority, the peak stack usage in bytes, and the
+ * system calls made and messages sent and received per second. A process created
+ * since the last call counts everything it did.
+ *
+ * @param sort      What the processes are sorted by, TOP_SORT_CPU to TOP_SORT_IPC
+ * @param refreshes The number of times the processes are printed
+ *-----------------------------------------------------------------------------------
+ */
+void call_top(int sort, int refreshes) {
+    static int (*compare[])(void *, void *) = {compare_top_cpu, compare_top_pid,
+                                               compare_top_syscalls, compare_top_ipc};
+    char print_buf[256];
+    unsigned long long now_us;
+    unsigned long long last_us;
+    int shm_id;
+
+    // The two tables and the rows share one buffer, the tables stay word aligned
+    size_t table_size = (PS_SIZE(MAX_PROCESSES + 1) + sizeof(long) - 1) & ~(sizeof(long) - 1);
+    char *buffer = alloc_buffer(2 * table_size + (MAX_PROCESSES + 1) * sizeof(top_row_t), &shm_id);
+    if (buffer == NULL) {
+        sysputs("Could not allocate the process tables\n");
+        return;
+    }
+    processStatuses *ps = (processStatuses *) buffer;
+    processStatuses *last_ps = (processStatuses *) (buffer + table_size);
+    top_row_t *rows = (top_row_t *) (buffer + 2 * table_size);
+
+    last_ps->size = MAX_PROCESSES + 1;
+    int last_procs = sysgetcputimes(last_ps);
+    sysclock(&last_us);
+    for (int refresh = 1; refresh <= refreshes; refresh++) {
+        syssleep(TOP_INTERVAL);
+        ps->size = MAX_PROCESSES + 1;
+        int procs = sysgetcputimes(ps);
+        sysclock(&now_us);
+        unsigned long elapsed_ms = (unsigned long) (now_us - last_us) / 1000;
+        if (elapsed_ms == 0) {
+            elapsed_ms = 1;
+        }
+
+        // The CPU time of every process over the refresh, shared out between them
+        long total_time = 0;
+        for (int j = 0; j <= procs; j++) {
+            proc_status_t *status = &ps->proc[j];
+            proc_status_t *last = find_status(last_ps, last_procs, status->pid);
+            top_row_t *row = &rows[j];
+            row->status = status;
+            row->cpu_share = status->cpuTime - (last ? last->cpuTime : 0);
+            row->syscall_rate = (status->syscalls - (last ? last->syscalls : 0)) * 1000 / elapsed_ms;
+            unsigned int messages = status->messagesSent + status->messagesReceived;
+            if (last) {
+                messages -= last->messagesSent + last->messagesReceived;
+            }
+            row->ipc_rate = messages * 1000 / elapsed_ms;
+            total_time += row->cpu_share;
+        }
+        for (int j = 0; j <= procs; j++) {
+            rows[j].cpu_share = total_time > 0 ? rows[j].cpu_share * 1000 / total_time : 0;
+        }
+        qsort((char *) rows, procs + 1, sizeof(top_row_t), compare[sort]);
+
+        sprintf(print_buf, "top: %d of %d, every %d ms\n", refresh, refreshes, TOP_INTERVAL);
+        sysputs(print_buf);
+        sysputs("PID  | STATE                | CPU    | PRIO | STACK      | SYS/S    | IPC/S   \n");
+        for (int j = 0; j <= procs; j++) {
+            top_row_t *row = &rows[j];
+            sprintf(print_buf, "%-4d | %-20s | %3d.%d%% | %-4d | %-10d | %-8u | %-8u\n",
+                    row->status->pid,
+                    printable_state(row->status->state, row->status->blocked_queue),
+                    row->cpu_share / 10, row->cpu_share % 10, row->status->priority,
+                    row->status->stackUsage, row->syscall_rate, row->ipc_rate);
+            sysputs(print_buf);
+        }
+
+        processStatuses *swap = last_ps;
+        last_ps = ps;
+        ps = swap;
+        last_procs = procs;
+        last_us = now_us;
+    }
+    free_buffer(shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetmemstats and prints the memory allocator statistics, one per line.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysgetmemstats(void) {
+    char print_buf[1024];
+    mem_stats_t stats;
+
+    if (sysgetmemstats(&stats) != 0) {
+        sysputs("Could not get memory statistics\n");
+        return;
+    }
+    sprintf(print_buf, "Bytes in use           | %u\n"
+                       "Free bytes before hole | %u\n"
+                       "Free bytes after hole  | %u\n"
+                       "Largest free block     | %u\n"
+                       "Free blocks            | %d\n"
+                       "Free pages             | %d\n"
+                       "Allocations            | %d\n"
+                       "Frees                  | %d\n"
+                       "Failed allocations     | %d\n",
+            stats.bytes_in_use, stats.pre_hole_free_bytes, stats.post_hole_free_bytes,
+            stats.largest_free_block, stats.free_block_count, stats.free_pages,
+            stats.num_allocs, stats.num_frees, stats.failed_allocs);
+    sysputs(print_buf);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetsyscallstats for every system call and prints, one per line, the name
+ * of every system call that has been made, the number of times it was made, the
+ * median and most processor cycles it took. The median is the power of 2 that
+ * starts the histogram bucket the median falls in.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysgetsyscallstats(void) {
+    char print_buf[1024];
+    syscall_stats_t stats;
+
+    sysputs("CALL             | COUNT      | MEDIAN     | MAX       \n");
+    for (int call = 0; call < TIMER_INT; call++) {
+        if (sysgetsyscallstats(call, &stats) != 0 || stats.count == 0) {
+            continue;
+        }
+        int bucket = median_bucket(stats.histogram, SYSCALL_HISTOGRAM_BUCKETS, stats.count);
+        sprintf(print_buf, "%-16s | %-10u | >= %-7u | %-10u\n", stats.name, stats.count,
+                1UL << bucket, stats.max_cycles);
+        sysputs(print_buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetlatency for every request and prints, one per line, the name of every
+ * request the kernel has been entered with, the number of times, and the median and
+ * most processor cycles it then ran with interrupts disabled. The PIT ticks held off
+ * by the request follow, with the median and most microseconds they waited. The
+ * medians are the powers of 2 that start the histogram buckets they fall in.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysgetlatency(void) {
+    char print_buf[1024];
+    latency_stats_t stats;
+
+    sysputs("REQUEST          | COUNT      | MEDIAN     | MAX        | TICKS  | MEDIAN US | MAX US\n");
+    for (int request = 0; sysgetlatency(request, &stats) == 0; request++) {
+        if (stats.count == 0) {
+            continue;
+        }
+        int bucket = median_bucket(stats.histogram, SYSCALL_HISTOGRAM_BUCKETS, stats.count);
+        int tick_bucket = median_bucket(stats.tick_histogram, LATENCY_TICK_BUCKETS, stats.tick_count);
+        sprintf(print_buf, "%-16s | %-10u | >= %-7u | %-10u | %-6u | >= %-6u | %u\n", stats.name,
+                stats.count, 1UL << bucket, stats.max_cycles, stats.tick_count,
+                stats.tick_count ? 1UL << tick_bucket : 0, stats.tick_max_us);
+        sysputs(print_buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetipcstats for every process and prints the waits on its queues of
+ * senders and receivers, one queue per line: the PID, the queue, the processes that
+ * joined it and are on it now, the most on it at once, and the mean and most
+ * processor cycles the processes that left it waited, in units of 1024. Processes
+ * that no process has waited on are left out, so the servers that their clients
+ * queue up on stand out.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysgetipcstats(void) {
+    ipc_stats_t stats;
+    char print_buf[32];
+    int shm_id;
+
+    processStatuses *ps = alloc_buffer(PS_SIZE(MAX_PROCESSES + 1), &shm_id);
+    if (ps == NULL) {
+        sysputs("Could not allocate the process table\n");
+        return;
+    }
+    ps->size = MAX_PROCESSES + 1;
+    int procs = sysgetcputimes(ps);
+
+    sysputs("PID  | QUEUE     | WAITS      | DEPTH  | MAX DEPTH | MEAN KCYCLES | MAX KCYCLES\n");
+    // The idle process in the first entry never has a queue
+    for (int j = 1; j <= procs; j++) {
+        int pid = ps->proc[j].pid;
+        if (sysgetipcstats(pid, &stats) != 0
+            || (stats.senders.waits == 0 && stats.receivers.waits == 0)) {
+            continue;
+        }
+        sprintf(print_buf, "%-4d | ", pid);
+        print_ipc_queue(print_buf, "senders", &stats.senders, stats.sender_depth);
+        print_ipc_queue(print_buf, "receivers", &stats.receivers, stats.receiver_depth);
+    }
+    free_buffer(shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Prints a line of the ipc command, for one queue of a process.
+ *
+ * @param prefix The start of the line, with the PID of the process
+ * @param name   The name of the queue
+ * @param stats  The waits on the queue
+ * @param depth  The number of processes on the queue now
+ *-----------------------------------------------------------------------------------
+ */
+static void print_ipc_queue(char *prefix, char *name, ipc_queue_stats_t *stats, unsigned long depth) {
+    char print_buf[256];
+    if (stats->waits == 0) {
+        return;
+    }
+    // The processes still on the queue have not finished their waits
+    unsigned long ended = stats->waits - depth;
+    sprintf(print_buf, "%s%-9s | %-10u | %-6u | %-9u | %-12u | %u\n", prefix, name, stats->waits,
+            depth, stats->max_depth, ended ? kilocycles(stats->wait_cycles) / ended : 0,
+            kilocycles((unsigned long long) stats->max_wait_cycles));
+    sysputs(print_buf);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Times IO_BENCH_CALLS syswrite and sysread calls of IO_BENCH_BYTES bytes on each
+ * memory device and prints the average processor cycles each call took. No hardware
+ * is behind the devices, so this is the cost of the system call, the DII and the
+ * device call alone, a baseline for the throughput of the device path.
+ *-----------------------------------------------------------------------------------
+ */
+void call_iobench(void) {
+    char print_buf[128];
+    char buf[IO_BENCH_BYTES];
+    dev_t devices[] = {NULL_0, ZERO_0, LOOP_0};
+    char *names[] = {"/dev/null", "/dev/zero", "/dev/loop0"};
+
+    fill_words(buf, 'x', sizeof(buf));
+    sysputs("DEVICE     | WRITE CYCLES | READ CYCLES\n");
+    for (int i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        int fd = sysopen(devices[i]);
+        if (fd < 0) {
+            sprintf(print_buf, "%-10s | could not be opened\n", names[i]);
+            sysputs(print_buf);
+            continue;
+        }
+        unsigned long write_cycles = 0;
+        unsigned long read_cycles = 0;
+        for (int call = 0; call < IO_BENCH_CALLS; call++) {
+            // Each write is read back, so the loopback ring never fills up
+            unsigned long start = read_cycle_counter();
+            syswrite(fd, buf, IO_BENCH_BYTES);
+            unsigned long middle = read_cycle_counter();
+            sysread(fd, buf, IO_BENCH_BYTES);
+            read_cycles += read_cycle_counter() - middle;
+            write_cycles += middle - start;
+        }
+        sysclose(fd);
+        sprintf(print_buf, "%-10s | %-12u | %-11u\n", names[i],
+                write_cycles / IO_BENCH_CALLS, read_cycles / IO_BENCH_CALLS);
         sysputs(print_buf);
     }
 }
 
+/*-----------------------------------------------------------------------------------
+ * Calls systraceread and prints the events of the kernel trace buffer, oldest first,
+ * one per line: its sequence number, the processor and the process, the cycles since
+ * the event before it, what happened and its two arguments. Events that were
+ * overwritten before they could be read are counted on a line of their own.
+ *
+ * @param follow 0 to return once every event has been printed, 1 to keep printing
+ *               the events recorded since, every TRACE_FOLLOW_INTERVAL milliseconds
+ *-----------------------------------------------------------------------------------
+ */
+void call_systrace(int follow) {
+    char print_buf[128];
+    trace_event_t events[TRACE_READ_BATCH];
+    unsigned long cursor = 0;
+    unsigned long long last_timestamp = 0;
+
+    sysputs("SEQ        | CPU | PID  | CYCLES     | EVENT          | ARG0       | ARG1\n");
+    for (;;) {
+        unsigned long expected = cursor;
+        int count = systraceread(&cursor, events, TRACE_READ_BATCH);
+        if (count <= 0) {
+            if (!follow) return;
+            syssleep(TRACE_FOLLOW_INTERVAL);
+            continue;
+        }
+        if (events[0].seq != expected) {
+            sprintf(print_buf, "... %u events overwritten\n", events[0].seq - expected);
+            sysputs(print_buf);
+        }
+        for (int i = 0; i < count; i++) {
+            trace_event_t *event = &events[i];
+            // Anything beyond 32 bits is printed as the largest unsigned long
+            unsigned long long delta = last_timestamp ? event->timestamp - last_timestamp : 0;
+            unsigned long cycles = delta >> 32 ? 0xffffffffUL : (unsigned long) delta;
+            last_timestamp = event->timestamp;
+            sprintf(print_buf, "%-10u | %-3d | %-4d | %-10u | %-14s | %-10u | %u\n", event->seq,
+                    event->cpu, event->pid, cycles, printable_trace_type(event->type),
+                    event->arg0, event->arg1);
+            sysputs(print_buf);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysprofread and prints the number of samples the sampling profiler has
+ * taken, and the PROFILE_TOP buckets of its histogram with the most samples, one per
+ * line: the addresses the bucket covers, its samples, and its share of the samples
+ * in tenths of a percent. The addresses are found in the symbol table of the kernel
+ * image, with nm -n.
+ *-----------------------------------------------------------------------------------
+ */
+void call_sysprofread(void) {
+    // Too large for the stack
+    static profile_t profile;
+    char print_buf[128];
+
+    if (sysprofread(&profile) != 0) {
+        sysputs("Could not read the profile\n");
+        return;
+    }
+    unsigned long samples = profile.idle + profile.outside;
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        samples += profile.histogram[i];
+    }
+    sprintf(print_buf, "%s, %u samples, %u idle, %u outside the text\n",
+            profile.running ? "Running" : "Stopped", samples, profile.idle, profile.outside);
+    sysputs(print_buf);
+    if (samples == 0) {
+        return;
+    }
+
+    sysputs("ADDRESSES             | SAMPLES    | SHARE\n");
+    for (int top = 0; top < PROFILE_TOP; top++) {
+        int hottest = 0;
+        for (int i = 1; i < PROFILE_BUCKETS; i++) {
+            if (profile.histogram[i] > profile.histogram[hottest]) {
+                hottest = i;
+            }
+        }
+        unsigned long count = profile.histogram[hottest];
+        if (count == 0) {
+            break;
+        }
+        // Taken out of the copy, so the next pass finds the next hottest bucket
+        profile.histogram[hottest] = 0;
+        unsigned long start = (unsigned long) hottest << profile.shift;
+        unsigned long share = count * 1000 / samples;
+        sprintf(print_buf, "0x%08x-0x%08x | %-10u | %3d.%d%%\n", start,
+                start + (1UL << profile.shift) - 1, count, share / 10, share % 10);
+        sysputs(print_buf);
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns a meaningful name given the type of a kernel trace event.
+ *-----------------------------------------------------------------------------------
+ */
+static char *printable_trace_type(unsigned char type) {
+    switch (type) {
+        case (TRACE_SYSCALL_ENTER):
+            return "syscall enter";
+        case (TRACE_SYSCALL_EXIT):
+            return "syscall exit";
+        case (TRACE_READY):
+            return "ready";
+        case (TRACE_SWITCH):
+            return "switch";
+        case (TRACE_SEND):
+            return "send";
+        case (TRACE_RECV):
+            return "recv";
+        case (TRACE_WAKEUP):
+            return "wakeup";
+        case (TRACE_KBD):
+            return "keyboard";
+        default:
+            return "unknown";
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the low word of the time stamp counter of the processor. Differences of
+ * two readings are right as long as they are below 2^32 cycles.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long read_cycle_counter(void) {
+    unsigned long low;
+    __asm__ volatile("rdtsc" : "=a" (low) : : "%edx");
+    return low;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the given number of cycles in units of 1024, or the largest unsigned long
+ * if that does not fit. Shifts rather than divides, as there is no 64-bit division.
+ *-----------------------------------------------------------------------------------
+ */
+static unsigned long kilocycles(unsigned long long cycles) {
+    cycles >>= 10;
+    return cycles >> 32 ? 0xffffffffUL : (unsigned long) cycles;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finds the bucket of a histogram of a bucket per power of 2 that the median falls
+ * in.
+ *
+ * @param histogram The histogram
+ * @param buckets   The number of buckets of the histogram
+ * @param count     The total of the buckets
+ * @return          The bucket of the median
+ *-----------------------------------------------------------------------------------
+ */
+static int median_bucket(unsigned long *histogram, int buckets, unsigned long count) {
+    unsigned long seen = 0;
+    int bucket = 0;
+    while (bucket < buckets - 1 && (seen += histogram[bucket]) * 2 < count) {
+        bucket++;
+    }
+    return bucket;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Finds the entry of a process in a table filled by sysgetcputimes.
+ *
+ * @param ps    The table
+ * @param procs The last slot used in the table
+ * @param pid   The PID of the process
+ * @return      The entry of the process, NULL if it is not in the table
+ *-----------------------------------------------------------------------------------
+ */
+static proc_status_t *find_status(processStatuses *ps, int procs, int pid) {
+    for (int j = 0; j <= procs; j++) {
+        if (ps->proc[j].pid == pid) {
+            return &ps->proc[j];
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Compare functions of qsort for the rows of the "top" command. All but the one by
+ * PID put the largest first, and rows that compare equal are in the order of PID.
+ *-----------------------------------------------------------------------------------
+ */
+static int compare_top_cpu(void *a, void *b) {
+    int diff = ((top_row_t *) b)->cpu_share - ((top_row_t *) a)->cpu_share;
+    return diff != 0 ? diff : compare_top_pid(a, b);
+}
+
+static int compare_top_pid(void *a, void *b) {
+    return ((top_row_t *) a)->status->pid - ((top_row_t *) b)->status->pid;
+}
+
+static int compare_top_syscalls(void *a, void *b) {
+    unsigned int rate_a = ((top_row_t *) a)->syscall_rate;
+    unsigned int rate_b = ((top_row_t *) b)->syscall_rate;
+    return rate_a != rate_b ? (rate_a < rate_b ? 1 : -1) : compare_top_pid(a, b);
+}
+
+static int compare_top_ipc(void *a, void *b) {
+    unsigned int rate_a = ((top_row_t *) a)->ipc_rate;
+    unsigned int rate_b = ((top_row_t *) b)->ipc_rate;
+    return rate_a != rate_b ? (rate_a < rate_b ? 1 : -1) : compare_top_pid(a, b);
+}
+
 /*-----------------------------------------------------------------------------------
  * Returns a meaningful state name given a process state.
  *
@@ -392,6 +1153,22 @@ static char *printable_state(process_state_t state, blocked_queue_t blocked_queu
                     return "Blocked: Sleeping";
                 case (READ):
                     return "Blocked: I/O read";
+                case (PORT):
+                    return "Blocked: Port";
+                case (FUTEX):
+                    return "Blocked: Futex";
+                case (PIPE):
+                    return "Blocked: Pipe";
+                case (POLL):
+                    return "Blocked: Poll";
+                case (SERIAL):
+                    return "Blocked: Serial";
+                case (DISK):
+                    return "Blocked: Disk";
+                case (WAIT_CHILD):
+                    return "Blocked: Wait-child";
+                case (COPYING):
+                    return "Blocked: Copying";
                 default:
                     assert(0, "Process state is blocked with no blocked queue");
                     return "";
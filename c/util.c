@@ -3,18 +3,171 @@
 #include <xeroskernel.h>
 
 /*-----------------------------------------------------------------------------------
- * This is where utility functions for testing live.
+ * This is where utility functions live, most of which are used for testing.
  *
  * List of functions that are called from outside this file:
+ * - find_first_set_bit
+ *   - Returns the index of the least significant set bit
+ * - find_last_set_bit
+ *   - Returns the index of the most significant set bit
+ * - copy_words
+ *   - Copies a block of memory a word at a time
+ * - move_words
+ *   - Copies a block of memory that may overlap the destination a word at a time
+ * - fill_words
+ *   - Sets every byte of a block of memory a word at a time
+ * - read_tsc
+ *   - Returns the time stamp counter of the processor
  * - assert
  *   - Asserts that a given value is true
  * - assert_equal
  *   - Compares two values
  * - busy_wait
  *   - Pauses the kernel for a few seconds
+ * - get_process_status
+ *   - Retrieves the sysgetcputimes entry of a single process
+ * - alloc_buffer
+ *   - Allocates a buffer too large for a process stack
+ * - free_buffer
+ *   - Frees a buffer allocated by alloc_buffer
  *-----------------------------------------------------------------------------------
  */
 
+/*-----------------------------------------------------------------------------------
+ * Returns the index of the least significant set bit of the given word using a single
+ * bit-scan instruction.
+ *
+ * @param word The word to scan
+ * @return     The index of the least significant set bit, -1 if no bits are set
+ *-----------------------------------------------------------------------------------
+ */
+int find_first_set_bit(unsigned long word) {
+    int index;
+    if (word == 0) {
+        return -1;
+    }
+    __asm__ volatile("bsfl %1, %0;" : "=r" (index) : "rm" (word));
+    return index;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the index of the most significant set bit of the given word using a single
+ * bit-scan instruction.
+ *
+ * @param word The word to scan
+ * @return     The index of the most significant set bit, -1 if no bits are set
+ *-----------------------------------------------------------------------------------
+ */
+int find_last_set_bit(unsigned long word) {
+    int index;
+    if (word == 0) {
+        return -1;
+    }
+    __asm__ volatile("bsrl %1, %0;" : "=r" (index) : "rm" (word));
+    return index;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies a block of memory that does not overlap the destination. The bytes up to
+ * the first word boundary of the destination are copied one at a time, the rest a
+ * word at a time with a single string instruction, and the bytes left over one at
+ * a time again. Unlike strncpy, the copy does not stop at a zero byte.
+ *
+ * @param dst The address to copy to
+ * @param src The address to copy from
+ * @param len The number of bytes to copy
+ *-----------------------------------------------------------------------------------
+ */
+void copy_words(void *dst, const void *src, size_t len) {
+    char *to = dst;
+    const char *from = src;
+    while (len > 0 && ((unsigned long) to & (sizeof(unsigned long) - 1)) != 0) {
+        *to++ = *from++;
+        len--;
+    }
+    int ecx, edi, esi;
+    __asm__ volatile("rep movsl;"
+                     "movl %6, %%ecx;"
+                     "rep movsb;"
+    : "=&c" (ecx), "=&D" (edi), "=&S" (esi)
+    : "0" (len / sizeof(unsigned long)), "1" (to), "2" (from), "g" (len & (sizeof(unsigned long) - 1))
+    : "memory");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies a block of memory that may overlap the destination. A destination below
+ * the source, or past its end, is copied front to back by copy_words. Otherwise the
+ * block is copied back to front, the bytes down to the last word boundary of the
+ * destination one at a time, the rest a word at a time, and the bytes left over one
+ * at a time again. The direction flag is left clear, as an interrupt may come in.
+ *
+ * @param dst The address to copy to
+ * @param src The address to copy from
+ * @param len The number of bytes to copy
+ *-----------------------------------------------------------------------------------
+ */
+void move_words(void *dst, const void *src, size_t len) {
+    char *to = dst;
+    const char *from = src;
+    if (to <= from || to >= from + len) {
+        copy_words(dst, src, len);
+        return;
+    }
+    to += len;
+    from += len;
+    while (len > 0 && ((unsigned long) to & (sizeof(unsigned long) - 1)) != 0) {
+        *--to = *--from;
+        len--;
+    }
+    for (; len >= sizeof(unsigned long); len -= sizeof(unsigned long)) {
+        to -= sizeof(unsigned long);
+        from -= sizeof(unsigned long);
+        *(unsigned long *) to = *(const unsigned long *) from;
+    }
+    while (len > 0) {
+        *--to = *--from;
+        len--;
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Sets every byte of a block of memory to the given value. The bytes up to the
+ * first word boundary are set one at a time, the rest a word at a time with a
+ * single string instruction, and the bytes left over one at a time again.
+ *
+ * @param dst The address of the block
+ * @param c   The value to set the bytes to, taken as an unsigned char
+ * @param len The number of bytes to set
+ *-----------------------------------------------------------------------------------
+ */
+void fill_words(void *dst, int c, size_t len) {
+    unsigned char *to = dst;
+    while (len > 0 && ((unsigned long) to & (sizeof(unsigned long) - 1)) != 0) {
+        *to++ = c;
+        len--;
+    }
+    // The byte repeated in every byte of a word
+    unsigned long word = (unsigned char) c * 0x01010101UL;
+    int ecx, edi;
+    __asm__ volatile("rep stosl;"
+                     "movl %5, %%ecx;"
+                     "rep stosb;"
+    : "=&c" (ecx), "=&D" (edi)
+    : "0" (len / sizeof(unsigned long)), "1" (to), "a" (word), "g" (len & (sizeof(unsigned long) - 1))
+    : "memory");
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns the time stamp counter of the processor, the number of cycles since it was
+ * reset.
+ *-----------------------------------------------------------------------------------
+ */
+unsigned long long read_tsc(void) {
+    unsigned long long tsc;
+    __asm__ volatile("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
 /*-----------------------------------------------------------------------------------
  * Asserts that the given value is true. If assertion fails, it will
  * print the given error message and pause the kernel.
@@ -81,11 +234,73 @@ void dummy_process(void) {
 }
 
 /*-----------------------------------------------------------------------------------
- * Sets priority of calling process to 3, and sysyield to give up control
+ * Sets priority of calling process to the lowest priority, and sysyield to give up control
  * to dummy processes, which call sysstop.
  *-----------------------------------------------------------------------------------
  */
 void yield_to_all() {
-    syssetprio(3);
+    syssetprio(INIT_PRIORITY);
     for (int i = 0; i < 200; i++) sysyield();
 }
+
+/*-----------------------------------------------------------------------------------
+ * Calls sysgetcputimes with room for every process and copies out the entry of the
+ * process with the given PID. The table is too large for a process stack, so it is
+ * allocated with alloc_buffer for the call.
+ *
+ * @param pid    The PID of the process
+ * @param status A pointer to where the entry of the process is copied
+ * @return       0 on success, -1 if there is no process with the given PID or the
+ *               table could not be allocated
+ *-----------------------------------------------------------------------------------
+ */
+int get_process_status(PID_t pid, proc_status_t *status) {
+    int shm_id;
+    processStatuses *ps = alloc_buffer(PS_SIZE(MAX_PROCESSES + 1), &shm_id);
+    if (ps == NULL) {
+        return -1;
+    }
+
+    int result = -1;
+    ps->size = MAX_PROCESSES + 1;
+    int last = sysgetcputimes(ps);
+    for (int i = 0; i <= last; i++) {
+        if (ps->proc[i].pid == pid) {
+            *status = ps->proc[i];
+            result = 0;
+            break;
+        }
+    }
+    free_buffer(shm_id);
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Allocates a zeroed buffer from the pages of a shared memory segment held only by
+ * the calling process, for tables such as those sysgetcputimes fills that are too
+ * large for a process stack and would not fit below the hole in the kernel image.
+ * The buffer is freed by free_buffer, or when the process terminates.
+ *
+ * @param size   The size of the buffer in bytes
+ * @param shm_id Where the identifier of the segment is stored, to free it with
+ * @return       A pointer to the page aligned buffer on success, NULL if the size is
+ *               invalid or not enough memory is available
+ *-----------------------------------------------------------------------------------
+ */
+void *alloc_buffer(size_t size, int *shm_id) {
+    *shm_id = sysshmcreate(size);
+    if (*shm_id < 0) {
+        return NULL;
+    }
+    return sysshmattach(*shm_id);
+}
+
+/*-----------------------------------------------------------------------------------
+ * Frees a buffer allocated by alloc_buffer. The buffer must not be used after.
+ *
+ * @param shm_id The identifier alloc_buffer stored for the buffer
+ *-----------------------------------------------------------------------------------
+ */
+void free_buffer(int shm_id) {
+    sysshmdetach(shm_id);
+}
@@ -0,0 +1,226 @@
+/* workq.c : deferred work of interrupt handlers */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+extern int user_proc_count;
+
+/*-----------------------------------------------------------------------------------
+ * This is the deferred work queue, which splits the servicing of an interrupt in
+ * two. The ISR only does what must be done before the interrupt is acknowledged,
+ * such as reading the data port of the device, and queues a work item for the rest,
+ * which the work process runs with interrupts enabled between the items. The time
+ * interrupts are disabled for thereby does not depend on the amount of work, only
+ * on the longest item.
+ *
+ * Notes on the work queue:
+ * - A work item is embedded in the driver that queues it, and is linked through its
+ *   own next pointer, so queueing never allocates and may be done from an ISR
+ * - Queueing an item that is already on the queue does nothing, the item still runs
+ *   once, so its function must handle all that has built up since it was queued
+ * - The queue is shared by every processor and is only used with the kernel lock
+ *   held
+ *
+ * Notes on the work process:
+ * - The work process is created at boot at the highest priority and drains the
+ *   queue with sysrunwork, which is serviced by preemptible_dispatch a work item
+ *   per step, so an interrupt that comes while the work runs is taken as soon as
+ *   the item it came during is done
+ * - A sysrunwork runs at most WORK_BUDGET items, those queued while it runs
+ *   included, the work process then makes another, so it is pre-empted by the
+ *   timer like any other process and work never holds off a real-time process
+ * - Once the queue is empty the work process waits in syswaitwork, as a futex
+ *   waiter on a word of this file, and queue_work wakes it when it queues an item.
+ *   The check for work and the wait are made with the kernel lock held, so an item
+ *   queued after the last sysrunwork is never missed
+ * - The work process is not a user process, it is left out of the count of user
+ *   processes that a receive from any process goes by
+ *
+ * List of functions that are called from outside this file:
+ * - kworkinit
+ *   - Initializes the work queue to empty
+ * - init_work
+ *   - Initializes a work item with the function it runs
+ * - queue_work
+ *   - Adds a work item to the work queue if it is not already on it
+ * - run_work
+ *   - Runs the work items on the work queue, up to WORK_BUDGET of them
+ * - run_next_work
+ *   - Runs the work item at the front of the work queue
+ * - wait_for_work
+ *   - Implements the kernel side of syswaitwork
+ * - kworkstart
+ *   - Creates the work process
+ * - work_process
+ *   - The work process
+ * - work_pending
+ *   - Returns 1 if there are work items on the work queue, 0 otherwise
+ * - get_work_stats
+ *   - Copies the counters of the work queue
+ *-----------------------------------------------------------------------------------
+ */
+
+// The items waiting to run, in the order they were queued
+static work_t *work_head;
+static work_t *work_tail;
+static unsigned int work_length;
+static work_stats_t work_stats;
+// The futex the work process waits on while the queue is empty, always 0
+static int work_wake;
+
+/*-----------------------------------------------------------------------------------
+ * To be called before any interrupt is enabled. Empties the work queue and clears
+ * its counters.
+ *-----------------------------------------------------------------------------------
+ */
+void kworkinit(void) {
+    work_head = NULL;
+    work_tail = NULL;
+    work_length = 0;
+    fill_words(&work_stats, 0, sizeof(work_stats_t));
+}
+
+/*-----------------------------------------------------------------------------------
+ * Initializes the given work item, which is not on the work queue.
+ *
+ * @param work The work item
+ * @param func The function the item runs
+ *-----------------------------------------------------------------------------------
+ */
+void init_work(work_t *work, work_funcptr func) {
+    assert(work != NULL, "init_work: work was null");
+    assert(func != NULL, "init_work: func was null");
+    work->func = func;
+    work->queued = 0;
+    work->next = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Adds the given work item to the back of the work queue, unless it is already on
+ * the queue.
+ *
+ * @param work The work item
+ * @return     1 if the item was added, 0 if it was already on the queue
+ *-----------------------------------------------------------------------------------
+ */
+int queue_work(work_t *work) {
+    assert(work != NULL, "queue_work: work was null");
+    assert(work->func != NULL, "queue_work: work was not initialized");
+    if (work->queued) {
+        work_stats.coalesced++;
+        return 0;
+    }
+    work->queued = 1;
+    work->next = NULL;
+    if (work_tail) {
+        work_tail->next = work;
+    } else {
+        work_head = work;
+    }
+    work_tail = work;
+    work_stats.queued++;
+    if (++work_length > work_stats.high_water) {
+        work_stats.high_water = work_length;
+    }
+    futex_wake(&work_wake, 1);
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the work items on the work queue in the order they were queued, up to
+ * WORK_BUDGET of them. An item is taken off the queue before its function is
+ * called, so the function may queue it again.
+ *
+ * @return The number of items run
+ *-----------------------------------------------------------------------------------
+ */
+int run_work(void) {
+    int count = 0;
+    while (count < WORK_BUDGET && run_next_work()) {
+        count++;
+    }
+    if (work_head) {
+        work_stats.deferred++;
+    }
+    return count;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Runs the work item at the front of the work queue, taking it off the queue before
+ * its function is called.
+ *
+ * @return 1 if an item was run, 0 if the queue is empty
+ *-----------------------------------------------------------------------------------
+ */
+int run_next_work(void) {
+    work_t *work = work_head;
+    if (work == NULL) {
+        return 0;
+    }
+    work_head = work->next;
+    if (work_head == NULL) {
+        work_tail = NULL;
+    }
+    work_length--;
+    work->next = NULL;
+    work->queued = 0;
+    work->func(work);
+    work_stats.run++;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Returns 1 if there are work items on the work queue, 0 otherwise.
+ *-----------------------------------------------------------------------------------
+ */
+int work_pending(void) {
+    return work_head != NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+ * Implements the kernel side of syswaitwork. Blocks the given process until a work
+ * item is queued, unless there is one on the queue.
+ *
+ * @param proc A pointer to the PCB of the calling process
+ * @return     −1 if the process was blocked, 0 if there is work to run
+ *-----------------------------------------------------------------------------------
+ */
+int wait_for_work(pcb_t *proc) {
+    if (work_head) {
+        return 0;
+    }
+    return futex_wait(proc, &work_wake, 0);
+}
+
+/*-----------------------------------------------------------------------------------
+ * To be called once the dispatcher is initialized and before it is entered. Creates
+ * the work process at the highest priority.
+ *-----------------------------------------------------------------------------------
+ */
+void kworkstart(void) {
+    spawn_attr_t attr = {PROCESS_STACK_SIZE, 0, 0};
+    assert(spawn(NULL, &work_process, NULL, 0, &attr), "Failed to create the work process");
+    user_proc_count--;
+}
+
+/*-----------------------------------------------------------------------------------
+ * The work process. Runs the work items on the work queue as they are queued, with
+ * interrupts enabled between them, and waits while there are none.
+ *-----------------------------------------------------------------------------------
+ */
+void work_process(void *arg) {
+    for (;;) {
+        if (sysrunwork() == 0) {
+            syswaitwork();
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------
+ * Copies the counters of the work queue into the given work_stats_t.
+ *-----------------------------------------------------------------------------------
+ */
+void get_work_stats(work_stats_t *stats) {
+    assert(stats != NULL, "get_work_stats: stats was null");
+    *stats = work_stats;
+}
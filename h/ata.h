@@ -0,0 +1,113 @@
+/* ata.h */
+
+#include <xeroskernel.h>
+
+#ifndef ATA_H
+#define ATA_H
+
+// The primary ATA channel of the PC, with its master drive
+#define ATA_BASE_PORT 0x1F0
+#define ATA_CONTROL_PORT 0x3F6
+#define ATA_IRQ 14
+
+// Registers, as offsets from the base port
+#define ATA_DATA 0
+// Error on read, features on write
+#define ATA_ERROR 1
+#define ATA_SECTOR_COUNT 2
+#define ATA_LBA_LOW 3
+#define ATA_LBA_MID 4
+#define ATA_LBA_HIGH 5
+// Drive select, and bits 24 to 27 of the LBA
+#define ATA_DRIVE 6
+// Status on read, command on write
+#define ATA_STATUS 7
+#define ATA_COMMAND 7
+
+// Drive select of the master drive addressed by LBA
+#define ATA_DRIVE_MASTER_LBA 0xE0
+// Control register: the bit that masks the interrupt of the drive
+#define ATA_CONTROL_NIEN 0x02
+
+// Status bits: busy, ready, drive fault, data request and error
+#define ATA_STATUS_BSY 0x80
+#define ATA_STATUS_DRDY 0x40
+#define ATA_STATUS_DF 0x20
+#define ATA_STATUS_DRQ 0x08
+#define ATA_STATUS_ERR 0x01
+
+// Commands
+#define ATA_CMD_READ_SECTORS 0x20
+#define ATA_CMD_WRITE_SECTORS 0x30
+#define ATA_CMD_IDENTIFY 0xEC
+
+// Status reads a wait for the drive gives up after
+#define ATA_POLL_LIMIT 100000
+
+// Most sectors a single command moves, which is also the most sectors adjacent
+// requests are merged into
+#define ATA_MAX_SECTORS 16
+// Reads and writes of processes in progress at once, and the most blocks each one
+// spans
+#define ATA_MAX_IOS 8
+#define ATA_IO_BLOCKS 8
+
+// sysioctl command of the disk, beside those of every block device in bufcache.h
+// Fill in an ata_stats_t with the counters of the request queue
+#define IOCTL_DISK_STATS 66
+
+// The counters filled in by IOCTL_DISK_STATS, counted since boot
+typedef struct ata_stats {
+    // Commands issued to the drive, and the sectors they moved
+    unsigned int commands;
+    unsigned int sectors;
+    // Block transfers merged into a queued request of an adjacent block
+    unsigned int merges;
+    // Commands that ended with an error
+    unsigned int errors;
+} ata_stats_t;
+
+struct buf;
+
+// A command to the drive for a run of adjacent blocks, each held until it is done
+typedef struct ata_request {
+    unsigned int lba;
+    int count;
+    int write;
+    struct buf *bufs[ATA_MAX_SECTORS];
+    struct ata_request *next;
+} ata_request_t;
+
+/*======================== ATA DISK DEVICE DRIVER UPPER HALF ======================*/
+// Adds the device to the device table
+void ata_register(void);
+// Called to setup the device
+int atainit(void);
+// Sets up device access
+int ataopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int ataclose(devsw_t *devsw, pcb_t *proc);
+int ataread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int atawrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int ataioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int atapoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int ataaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+// Moves a block of a preemptible read or write
+int atastep(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int write);
+
+// The request queue, sorted by sector
+// Merges a transfer into a queued request it is next to
+int ata_merge(ata_request_t *queue, struct buf *buf, int write);
+// Adds a request in sector order
+void ata_insert(ata_request_t **queue, ata_request_t *req);
+// Takes the request C-LOOK picks next
+ata_request_t *ata_take_next(ata_request_t **queue, unsigned int head_lba);
+
+/*======================== ATA DISK DEVICE DRIVER LOWER HALF ======================*/
+// ISR for the disk
+void ata_isr(void);
+
+#endif
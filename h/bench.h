@@ -0,0 +1,34 @@
+/* bench.h */
+
+#include <xeroskernel.h>
+
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timed iterations of each microbenchmark
+#define BENCH_ITERATIONS 1024
+// Iterations of the benchmarks that sleep, each of which takes a time slice or more
+#define BENCH_SLEEP_ITERATIONS 64
+
+// The samples taken of one benchmark, of up to 2^32 - 1 cycles each
+typedef struct bench_stats {
+    unsigned long count;
+    unsigned long long total;
+    unsigned long min;
+    unsigned long max;
+} bench_stats_t;
+
+/*============================== BENCHMARKS =======================================*/
+// Empties the samples of a benchmark
+void bench_reset(bench_stats_t *stats);
+// Adds a sample, the difference between two reads of the time stamp counter
+void bench_sample(bench_stats_t *stats, unsigned long long start, unsigned long long end);
+// Adds a sample measured in some other unit
+void bench_add(bench_stats_t *stats, unsigned long value);
+// Prints the header of the result lines, and a result line
+void bench_header(void);
+void bench_report(char *name, int arg, bench_stats_t *stats, char *unit);
+// Divides without the 64-bit division of libgcc
+unsigned long bench_div(unsigned long long dividend, unsigned long divisor);
+
+#endif
@@ -0,0 +1,97 @@
+/* bufcache.h */
+
+#include <xeroskernel.h>
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+// Bytes in each block of a block device, and in each buffer of the cache
+#define BLOCK_SIZE 512
+// Buffers in the cache, shared by all block devices
+#define NUM_BUFS 32
+// Hash chains buffers are looked up on by block number, a power of 2
+#define BUF_HASH_BUCKETS 16
+
+// Buffer flags
+// The buffer holds the contents of its block
+#define BUF_VALID 0x01
+// The buffer was changed and must be written back before it is reused
+#define BUF_DIRTY 0x02
+// A transfer between the buffer and its device is in progress
+#define BUF_BUSY 0x04
+
+// Returned by the block callbacks of a device whose transfers complete later, see
+// blkdev_t
+#define BLK_STARTED 1
+
+// sysioctl commands of the block devices
+// Move the position of the next read or write to the given byte offset
+#define IOCTL_SEEK 63
+// Write the changed blocks in the buffer cache back to the device
+#define IOCTL_SYNC 64
+// Fill in a bufcache_stats_t with the counters of the buffer cache
+#define IOCTL_CACHE_STATS 65
+
+struct buf;
+
+/*-----------------------------------------------------------------------------------
+ * A block device behind the buffer cache. A driver moves whole blocks between its
+ * storage and a buffer, the cache decides when.
+ *
+ * A driver whose transfers complete on an interrupt returns BLK_STARTED instead of
+ * finishing the transfer. It then holds the buffer with bhold and marks it
+ * BUF_BUSY until the transfer completes, and a write clears BUF_DIRTY when it
+ * starts so a change made while it is in progress is written again.
+ *-----------------------------------------------------------------------------------
+ */
+typedef struct blkdev {
+    // The number of blocks on the device
+    unsigned int num_blocks;
+    // Copy the block of the given buffer from the device into its data, or its
+    // data into the block, return 0 on success, -1 on failure, or BLK_STARTED
+    int (*read_block)(struct blkdev *dev, struct buf *buf);
+    int (*write_block)(struct blkdev *dev, struct buf *buf);
+} blkdev_t;
+
+typedef struct buf {
+    blkdev_t *dev;
+    unsigned int blockno;
+    int flags;
+    // The number of holders of the buffer, it stays on the LRU list only while 0
+    int refcount;
+    char *data;
+    // The next buffer on the same hash chain
+    struct buf *hash_next;
+    // Neighbours on the LRU list, least recently released first
+    struct buf *lru_prev;
+    struct buf *lru_next;
+} buf_t;
+
+// The counters filled in by get_bufcache_stats
+typedef struct bufcache_stats {
+    // Lookups found in the cache, and lookups that had to take a buffer
+    unsigned int hits;
+    unsigned int misses;
+    // Dirty buffers written back to their device
+    unsigned int writebacks;
+} bufcache_stats_t;
+
+/*============================== BUFFER CACHE =====================================*/
+// Initializes the buffer cache
+void kbufinit(void);
+// Returns the buffer of a block holding its contents
+buf_t *bread(blkdev_t *dev, unsigned int blockno);
+// Returns the buffer of a block without reading the block in
+buf_t *bget(blkdev_t *dev, unsigned int blockno);
+// Marks a buffer as changed
+void bdirty(buf_t *buf);
+// Takes another hold of a buffer
+void bhold(buf_t *buf);
+// Gives up a buffer returned by bread or bget
+void brelse(buf_t *buf);
+// Writes back the changed buffers of a device
+int bsync(blkdev_t *dev);
+// Copies the counters of the cache
+void get_bufcache_stats(bufcache_stats_t *stats);
+
+#endif
@@ -0,0 +1,35 @@
+/* console.h */
+
+#include <xeroskernel.h>
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Chars of output held by the console until the next flush to video memory
+#define CONSOLE_BUFFER_SIZE 4096
+
+/*========================= CONSOLE DEVICE DRIVER =================================*/
+// Adds the device to the device table
+void console_register(void);
+// Called to setup the device
+int consoleinit(void);
+// Sets up device access
+int consoleopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int consoleclose(devsw_t *devsw, pcb_t *proc);
+int consoleread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int consolewrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int consoleioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int consolepoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int consoleaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+
+/*========================= CONSOLE OUTPUT BUFFER =================================*/
+// Copies chars into the output buffer
+void console_write(char *buf, int len);
+// Writes the chars in the output buffer to video memory
+void console_flush(void);
+
+#endif
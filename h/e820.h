@@ -0,0 +1,56 @@
+/* e820.h : the memory map of the BIOS */
+
+#ifndef E820_H
+#define E820_H
+
+// Where setup leaves the map, INITSEG:0x0a00 just past the end of setup, as the
+// signature, the number of entries and the entries. startup.S copies it out to
+// e820_boot_map before the bss, which covers this address, is cleared
+#define E820_BOOT_ADDR 0x90a00
+// "SMAP", written by setup once the map is complete
+#define E820_SIGNATURE 0x534d4150
+#define E820_MAX_ENTRIES 32
+#define E820_ENTRY_SIZE 20
+#define E820_BOOT_SIZE (8 + E820_MAX_ENTRIES * E820_ENTRY_SIZE)
+
+// The type of an entry of usable memory
+#define E820_RAM 1
+// The most separate regions of usable memory that are kept
+#define E820_MAX_REGIONS 16
+
+#ifndef LOCORE
+
+// An entry of the map as the BIOS returns it
+typedef struct e820_entry {
+    unsigned long long addr;
+    unsigned long long size;
+    unsigned long type;
+} __attribute__((packed)) e820_entry_t;
+
+typedef struct e820_boot_map {
+    unsigned long signature;
+    unsigned long count;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_boot_map_t;
+
+// A region of usable memory, whole pages from start up to end
+typedef struct e820_region {
+    unsigned long start;
+    unsigned long end;
+} e820_region_t;
+
+// Reads the map saved by startup.S, or assumes the memory the kernel always has
+void e820_init(void);
+// Turns the entries of a map into sorted, separate regions of usable memory
+int e820_sanitize(e820_entry_t *entries, int count, e820_region_t *regions, int max_regions);
+// The regions of usable memory, sorted by address
+int e820_region_count(void);
+e820_region_t *e820_get_region(int index);
+// Returns the region that holds the address, NULL if it is not usable memory
+e820_region_t *e820_find_region(unsigned long addr);
+// 1 if the regions come from the BIOS, 0 if they are the default
+int e820_from_bios(void);
+
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+/* format.h */
+
+#include <xeroskernel.h>
+#include <stdarg.h>
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+// The widest field and the longest %s precision a format may give, wider ones are
+// taken as none, as in _doprnt
+#define FORMAT_MAX_WIDTH 80
+
+/*============================ BUFFERED FORMATTING ================================*/
+// Formats into a buffer, passing it to flush whenever it fills up, or truncating the
+// output if flush is NULL
+int format_buffer(char *buf, int size, void (*flush)(char *buf, int len), char *fmt, va_list ap);
+// Formats into a string of the given size, truncating the output
+int format_string(char *buf, int size, char *fmt, ...);
+
+#endif
@@ -5,7 +5,7 @@
 
 
 #define	NID		48
-#define	NGD		 8
+#define	NGD		16
 
 #define	IRQBASE		32	/* base ivec for IRQ0			*/
 
@@ -111,9 +111,15 @@ struct segtr {
 #define         TIMER_MSB       0x20    /* r/w counter MSB */
 #define         TIMER_16BIT     0x30    /* r/w counter 16 bits, LSB first */
 #define         TIMER_BCD       0x01    /* count in BCD */
+#define         TIMER_READBACK_STATUS0 0xe2 /* 8254 read-back status of counter 0 */
+#define         TIMER_STATUS_OUT 0x80   /* status: output pin is high */
 
 
 /* Some helpful prototypes */
 void initPIT( int divisor );
+void oneshotPIT( unsigned int count );
+unsigned int readPIT( void );
+int firedPIT( void );
+int pendingPIT( void );
 void end_of_intr( void );
 
@@ -7,3 +7,4 @@
 #define	IMR	(ICU1+1)	/* Interrupt Mask Register		*/
 
 #define	EOI	0x20		/* non-specific end of interrupt	*/
+#define	OCW3_READ_IRR	0x0a	/* next read of OCR returns the IRR	*/
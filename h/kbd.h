@@ -28,11 +28,11 @@
 
 // GIVEN scanCodesToAscii.txt CODE ENDS
 
-#define DEFAULT_EOF 0x04
-
-// Internally buffer up to 4 chars via a circular buffer
-// Use 1 index to indicate a full buffer
-#define KBD_BUFFER_SIZE (4 + 1)
+// Scancodes the ISR holds for the deferred work that translates them, a power of 2
+// so the ring is indexed with a mask
+#define KBD_SCANCODE_ORDER 4
+#define KBD_SCANCODE_SIZE (1 << KBD_SCANCODE_ORDER)
+#define KBD_SCANCODE_MASK (KBD_SCANCODE_SIZE - 1)
 #define KEYBOARD_IRQ 1
 
 // Port 0x60 is where data is read from
@@ -44,19 +44,40 @@
 #define IOCTL_CHANGE_EOF 53
 #define IOCTL_ECHO_OFF 55
 #define IOCTL_ECHO_ON 56
+#define IOCTL_GET_STATS 57
+// IOCTL_MODE_CANONICAL and IOCTL_MODE_RAW of the line discipline are in ldisc.h
+
+// The input counters filled in by IOCTL_GET_STATS, counted since the first of the
+// processes that have the keyboard open opened it
+typedef struct kbd_stats {
+    // Chars dropped because the ring of the line discipline was full, or scancodes
+    // because the ring of the ISR was
+    unsigned int dropped;
+    // The most chars the ring of the line discipline has held for a process
+    unsigned int high_water;
+    // Lines passed on to the processes, each waking a process reading once
+    unsigned int lines;
+    // The processes that have the keyboard open
+    unsigned int readers;
+} kbd_stats_t;
 
 /*===================== KEYBOARD DEVICE DRIVER UPPER HALF =========================*/
-void kbd_devsw_init(devsw_t *devsw, dev_t kbd);
+// Adds the devices to the device table
+void kbd_register(void);
 // Called to setup the device
 int kbdinit(void);
 // Sets up device access
-int kbdopen(pcb_t *proc, int device_no);
+int kbdopen(devsw_t *devsw, pcb_t *proc, int device_no);
 // Terminates device access
-int kbdclose(pcb_t *proc);
-int kbdread(pcb_t *proc, void *buf, int buflen);
-int kbdwrite(pcb_t *proc, void *buf, int buflen);
+int kbdclose(devsw_t *devsw, pcb_t *proc);
+int kbdread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int kbdwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
 // Passes special control information
-int kbdioctl(pcb_t *proc, unsigned long command, void *ioctl_args);
+int kbdioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int kbdpoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int kbdaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
 
 /*===================== KEYBOARD DEVICE DRIVER LOWER HALF =========================*/
 // ISR for keyboard
@@ -0,0 +1,101 @@
+/* ldisc.h */
+
+#include <xeroskernel.h>
+
+#ifndef LDISC_H
+#define LDISC_H
+
+// Chars of committed input the ring of a line discipline holds for its slowest
+// reader, a power of 2 so the ring is indexed with a mask
+#define LDISC_RING_ORDER 7
+#define LDISC_RING_SIZE (1 << LDISC_RING_ORDER)
+#define LDISC_RING_MASK (LDISC_RING_SIZE - 1)
+// Longest line that is edited before it is passed on to the readers
+#define LDISC_LINE_SIZE 80
+// Processes that may read a device through its line discipline at once
+#define LDISC_MAX_READERS 4
+
+// In canonical mode input is edited a line at a time and passed on once the line
+// is ended, in raw mode every char is passed on as it arrives
+#define LDISC_CANONICAL 0
+#define LDISC_RAW 1
+
+// Default control chars of canonical mode: end-of-file (Ctrl-D), erase the last
+// char (backspace, or delete) and erase the line (Ctrl-U)
+#define DEFAULT_EOF 0x04
+#define DEFAULT_ERASE '\b'
+#define DELETE_CHAR 0x7F
+#define DEFAULT_KILL 0x15
+// Placed in the ring where an end-of-file was typed, devices never deliver it
+#define LDISC_EOF_MARK '\0'
+
+// sysioctl commands of every device with a line discipline
+// Switch to canonical mode, the default
+#define IOCTL_MODE_CANONICAL 67
+// Switch to raw mode, passing on the line being edited
+#define IOCTL_MODE_RAW 68
+
+// The state of one process reading through a line discipline
+typedef struct ldisc_reader {
+    // The reading process, NULL if the slot is free
+    pcb_t *proc;
+    // The number of chars the reader has taken from the ring
+    unsigned int tail;
+    // Whether the reader wants its input echoed, and whether it has read an EOF
+    int echo;
+    int eof;
+    // The signal that completes the asynchronous read in progress, -1 if there is
+    // none, and its buffer, length and the chars already transferred
+    int aio_signal;
+    char *aio_buf;
+    int aio_len;
+    int aio_done;
+} ldisc_reader_t;
+
+typedef struct ldisc {
+    int mode;
+    // The control chars of canonical mode
+    unsigned char eof;
+    unsigned char erase;
+    unsigned char kill;
+    // Echoes a char on the device, called with each char accepted while any reader
+    // has echo on
+    void (*echo)(char c);
+    // The line being edited in canonical mode, not yet seen by any reader
+    char line[LDISC_LINE_SIZE];
+    int line_len;
+    // The committed input, shared by the readers, and the number of chars placed
+    // in it
+    char ring[LDISC_RING_SIZE];
+    unsigned int head;
+    ldisc_reader_t readers[LDISC_MAX_READERS];
+    int num_readers;
+    // The readers blocked in sysread, on the READ blocked queue
+    Queue waiters;
+    // Chars dropped while the ring was full, the most chars it has held, and the
+    // lines passed on to the readers
+    unsigned int dropped;
+    unsigned int high_water;
+    unsigned int lines;
+} ldisc_t;
+
+/*============================= LINE DISCIPLINE ===================================*/
+// Sets up a line discipline with no readers
+void ldisc_init(ldisc_t *ld, void (*echo)(char c));
+// Adds a reader, the first one resets the line discipline
+int ldisc_open(ldisc_t *ld, pcb_t *proc, int echo);
+// Removes a reader
+int ldisc_close(ldisc_t *ld, pcb_t *proc);
+// Services a sysread and sysaioread of a reader
+int ldisc_read(ldisc_t *ld, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int ldisc_aioread(ldisc_t *ld, pcb_t *proc, void *buf, int buflen, int signal_number);
+// Tells syspoll whether a reader has input to read
+int ldisc_poll(ldisc_t *ld, pcb_t *proc);
+// Changes the mode, the EOF char and the echo of a reader
+int ldisc_set_mode(ldisc_t *ld, int mode);
+int ldisc_set_eof(ldisc_t *ld, int c);
+int ldisc_set_echo(ldisc_t *ld, pcb_t *proc, int echo);
+// Handles a char that arrived from the device
+void ldisc_input(ldisc_t *ld, char c);
+
+#endif
@@ -0,0 +1,35 @@
+/* memdev.h */
+
+#include <xeroskernel.h>
+
+#ifndef MEMDEV_H
+#define MEMDEV_H
+
+// Bytes the ring of the loopback device holds, a power of 2 so the ring is indexed
+// with a mask
+#define LOOP_BUFFER_SIZE 4096
+#define LOOP_BUFFER_MASK (LOOP_BUFFER_SIZE - 1)
+
+/*======================== MEMORY DEVICE DRIVERS ==================================*/
+// Adds the devices to the device table
+void memdev_register(void);
+// Called to setup the devices
+int memdevinit(void);
+// Sets up device access
+int memdevopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int memdevclose(devsw_t *devsw, pcb_t *proc);
+int nullread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int zeroread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int loopread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int nullwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+int loopwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int memdevioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int memdevpoll(devsw_t *devsw, pcb_t *proc);
+int looppoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int memdevaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+
+#endif
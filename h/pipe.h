@@ -0,0 +1,26 @@
+/* pipe.h */
+
+#include <xeroskernel.h>
+
+#ifndef PIPE_H
+#define PIPE_H
+
+/*========================== PIPE DEVICE DRIVER ===================================*/
+// Adds the devices to the device table
+void pipe_register(void);
+// Called to setup the device
+int pipeinit(void);
+// Sets up device access
+int pipeopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int pipeclose(devsw_t *devsw, pcb_t *proc);
+int piperead(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int pipewrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int pipeioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int pipepoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int pipeaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+
+#endif
@@ -0,0 +1,31 @@
+/* ramdisk.h */
+
+#include <xeroskernel.h>
+
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+// Blocks of BLOCK_SIZE bytes the RAM disk holds
+#define RAMDISK_BLOCKS 128
+
+/*======================== RAM DISK DEVICE DRIVER =================================*/
+// Adds the device to the device table
+void ramdisk_register(void);
+// Called to setup the device
+int ramdiskinit(void);
+// Sets up device access
+int ramdiskopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int ramdiskclose(devsw_t *devsw, pcb_t *proc);
+int ramdiskread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int ramdiskwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int ramdiskioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int ramdiskpoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int ramdiskaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+// Moves a block of a preemptible read or write
+int ramdiskstep(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int write);
+
+#endif
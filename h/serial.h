@@ -0,0 +1,108 @@
+/* serial.h */
+
+#include <xeroskernel.h>
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+// The first serial port (COM1), a 16550 UART
+#define SERIAL_BASE_PORT 0x3F8
+#define SERIAL_IRQ 4
+
+// Registers, as offsets from the base port
+// Receive buffer on read, transmit holding register on write
+#define SERIAL_DATA 0
+#define SERIAL_IER 1
+// Interrupt identification on read, FIFO control on write
+#define SERIAL_IIR 2
+#define SERIAL_FCR 2
+#define SERIAL_LCR 3
+#define SERIAL_MCR 4
+#define SERIAL_LSR 5
+#define SERIAL_MSR 6
+#define SERIAL_SCRATCH 7
+// The divisor latch takes the place of the data and interrupt enable registers
+// while the divisor latch access bit of the LCR is set
+#define SERIAL_DLL 0
+#define SERIAL_DLM 1
+
+// Interrupt enable bits: received data, transmit holding register empty, and
+// receiver line status
+#define IER_RX 0x01
+#define IER_TX 0x02
+#define IER_LINE 0x04
+
+// Interrupt identification: bit 0 is clear while an interrupt is pending, and bits
+// 1 to 3 give its cause
+#define IIR_NONE 0x01
+#define IIR_CAUSE_MASK 0x0E
+#define IIR_MODEM 0x00
+#define IIR_TX 0x02
+#define IIR_RX 0x04
+#define IIR_LINE 0x06
+#define IIR_RX_TIMEOUT 0x0C
+
+// Enable and clear both FIFOs, interrupting once 14 bytes have been received
+#define FCR_ENABLE_14 0xC7
+// 8 data bits, no parity, 1 stop bit, and the divisor latch access bit
+#define LCR_8N1 0x03
+#define LCR_DLAB 0x80
+// Data terminal ready, request to send, OUT2 which gates the IRQ line on a PC, and
+// the loopback bit that feeds transmitted bytes back to the receiver
+#define MCR_DTR_RTS_OUT2 0x0B
+#define MCR_LOOPBACK 0x10
+// Line status: data ready, overrun error, and transmit holding register empty
+#define LSR_DATA_READY 0x01
+#define LSR_OVERRUN 0x02
+#define LSR_TX_EMPTY 0x20
+
+// 38400 baud, the divisor of the 115200 Hz clock of the UART
+#define SERIAL_DIVISOR 3
+// Bytes the transmit FIFO takes each time it empties
+#define SERIAL_TX_FIFO_SIZE 16
+
+// Buffer up to 2^SERIAL_BUFFER_ORDER bytes in each direction via rings, a power of 2
+// so the rings are indexed with a mask
+#define SERIAL_BUFFER_ORDER 8
+#define SERIAL_BUFFER_SIZE (1 << SERIAL_BUFFER_ORDER)
+#define SERIAL_BUFFER_MASK (SERIAL_BUFFER_SIZE - 1)
+
+#define IOCTL_LOOPBACK_ON 58
+#define IOCTL_LOOPBACK_OFF 59
+#define IOCTL_SERIAL_STATS 60
+
+// The counters filled in by IOCTL_SERIAL_STATS, counted since the port was first
+// opened
+typedef struct serial_stats {
+    // Bytes dropped because the receive ring was full, and bytes the UART lost
+    // because its receive FIFO overran
+    unsigned int dropped;
+    unsigned int overruns;
+    // Bytes received and transmitted
+    unsigned int received;
+    unsigned int transmitted;
+} serial_stats_t;
+
+/*====================== SERIAL DEVICE DRIVER UPPER HALF ==========================*/
+// Adds the device to the device table
+void serial_register(void);
+// Called to setup the device
+int serialinit(void);
+// Sets up device access
+int serialopen(devsw_t *devsw, pcb_t *proc, int device_no);
+// Terminates device access
+int serialclose(devsw_t *devsw, pcb_t *proc);
+int serialread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+int serialwrite(devsw_t *devsw, pcb_t *proc, void *buf, int buflen);
+// Passes special control information
+int serialioctl(devsw_t *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+// Tells syspoll whether there is input to read
+int serialpoll(devsw_t *devsw, pcb_t *proc);
+// Starts a read that completes with a signal
+int serialaioread(devsw_t *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+
+/*====================== SERIAL DEVICE DRIVER LOWER HALF ==========================*/
+// ISR for the serial port
+void serial_isr(void);
+
+#endif
@@ -0,0 +1,48 @@
+/* slab.h */
+
+#include <xeroskernel.h>
+
+#ifndef SLAB_H
+#define SLAB_H
+
+/* Each slab can track up to 256 objects */
+#define SLAB_BITMAP_WORDS 8
+/* System can support 16 object caches */
+#define KMEM_CACHE_TABLE_SIZE 16
+
+typedef struct kmem_cache_stats {
+    // Number of slabs currently held by the cache
+    int num_slabs;
+    // Number of objects that fit in one slab
+    int objects_per_slab;
+    // Number of objects currently allocated from the cache
+    int objects_in_use;
+    // Number of objects that can be allocated without getting a new slab
+    int objects_free;
+    int num_allocs;
+    int num_frees;
+    int failed_allocs;
+} kmem_cache_stats_t;
+
+struct slab;
+typedef struct kmem_cache {
+    // 1 if this entry of the cache table is in use, 0 otherwise
+    int in_use;
+    char *name;
+    // Size of each object, rounded up to a paragraph
+    size_t object_size;
+    // Slabs with at least one free object, allocations are served from the head
+    struct slab *partial_slabs;
+    // Slabs with no free objects
+    struct slab *full_slabs;
+    kmem_cache_stats_t stats;
+} kmem_cache_t;
+
+void kslabinit(void);
+kmem_cache_t *kmem_cache_create(char *name, size_t object_size);
+int kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+int kmem_cache_free(kmem_cache_t *cache, void *obj);
+int kmem_cache_get_stats(kmem_cache_t *cache, kmem_cache_stats_t *stats);
+
+#endif
@@ -0,0 +1,35 @@
+#include <xeroskernel.h>
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+// Each level of the wheel has WHEEL_SLOTS slots, a slot of a level spans all the
+// slots of the level below, so the wheel times delays of up to
+// WHEEL_SLOTS^WHEEL_LEVELS - 1 ticks
+#define WHEEL_LEVEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVELS 5
+#define WHEEL_MAX_DELAY ((1 << (WHEEL_LEVEL_BITS * WHEEL_LEVELS)) - 1)
+
+// The entries due in a slot, linked through their own next and prev pointers
+typedef struct timer_slot {
+    timer_entry_t *head;
+    timer_entry_t *tail;
+} TimerSlot;
+
+typedef struct timer_wheel {
+    // Ticks since the wheel was initialized
+    unsigned long long now;
+    int size;
+    TimerSlot slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} TimerWheel;
+
+void init_timer_wheel(TimerWheel *wheel);
+void wheel_insert(TimerWheel *wheel, timer_entry_t *entry, int delay);
+int wheel_remove(TimerWheel *wheel, timer_entry_t *entry);
+void wheel_advance(TimerWheel *wheel);
+int wheel_next_expiry(TimerWheel *wheel, int limit);
+int wheel_size(TimerWheel *wheel);
+int in_wheel(timer_entry_t *entry);
+
+#endif
@@ -35,6 +35,7 @@ unsigned short getCS(void);
 unsigned char inb(unsigned int);
 void init8259(void);
 int kprintf(char *fmt, ...);
+void kbmwrite(char *buf, int len);
 void lidt(void);
 void outb(unsigned int, unsigned char);
 void set_evec(unsigned int xnum, unsigned long handler);
@@ -42,28 +43,209 @@ void set_evec(unsigned int xnum, unsigned long handler);
 /* Constants */
 #define PREEMPTION_ENABLED 1
 #define PARAGRAPH_SIZE 16
-/* System can support 32 processes */
-#define PCB_TABLE_SIZE 32
-/* System can support 2 devices */
-#define DEVICE_TABLE_SIZE 2
+/* Blocks of up to 2^9 pages can be allocated from the page allocator */
+#define NUM_PAGE_ORDERS 10
+/* kmalloc takes 2^9 pages after the hole for its heap, room for a stack of the
+   default size for about every process, or 2^8 in paging mode, where the stacks are
+   pages of the page allocator. The rest is left to the slabs, arenas and segments */
+#define KMALLOC_HEAP_ORDER (PAGING_ENABLED ? 8 : 9)
+/* The process table grows 32 processes at a time, up to 256 processes */
+#define PCB_CHUNK_SIZE 32
+#define MAX_PROCESSES 256
+/* Size of a cache line, the fields of a PCB used on every context switch fit in one */
+#define CACHE_LINE_SIZE 64
+/* Kernel timers armed with systimer, shared by all processes */
+#define MAX_TIMERS 32
+/* Message ports created with sysportcreate, shared by all processes, and the
+   messages each port buffers */
+#define MAX_PORTS 32
+#define PORT_SLOTS 16
+/* Shared memory segments created with sysshmcreate, one bit each in the PCB */
+#define MAX_SHM_SEGMENTS 32
+/* Wait queues futex waiters are hashed into by address, a power of 2 */
+#define FUTEX_BUCKETS 64
+/* Pipes in the device table, after the 2 keyboard devices */
+#define NUM_PIPES 2
+/* Bytes the ring buffer of each pipe holds */
+#define PIPE_BUFFER_SIZE 512
+/* Devices drivers can register, with major numbers 0 to DEVICE_TABLE_SIZE - 1. The
+   2 keyboard devices, the pipes, a serial port, the console, a RAM disk, an ATA
+   disk and the null, zero and loopback devices are registered at boot */
+#define DEVICE_TABLE_SIZE 16
+/* Deferred work items run per drain of the work queue, the rest wait for the next
+   drain, so the work process is pre-empted between drains like any process */
+#define WORK_BUDGET 8
+/* Events the kernel trace buffer holds before the oldest are overwritten, a power
+   of 2 so the buffer is indexed with a mask */
+#define TRACE_BUFFER_ORDER 10
+/* Categories of trace events recorded from boot, none so tracing costs a single
+   test per event until it is enabled with systracectl */
+#define TRACE_DEFAULT_MASK 0
+/* Buckets of the histogram of the sampling profiler, which cover the kernel text, so
+   each covers the text size divided by this, rounded up to a power of 2 */
+#define PROFILE_BUCKETS 2048
+/* Records the log ring of each processor holds until the logger process writes them
+   out, a power of 2, records made while it is full are dropped and counted */
+#define LOG_RING_SIZE 64
+/* Milliseconds the logger process sleeps once it has written out every record */
+#define LOG_FLUSH_INTERVAL 50
 #define PROCESS_STACK_SIZE 8192
+/* Smallest stack create will allocate, measured peak usage of the test and shell
+   processes is well below this */
+#define MIN_PROCESS_STACK_SIZE 2048
+/* Smallest stack create_thread will allocate, a thread has no signal or file
+   descriptor table of its own to set up */
+#define MIN_THREAD_STACK_SIZE 1024
+/* Exits of children a process keeps for syswaitany, the oldest is dropped to make
+   room once there are this many */
+#define MAX_CHILD_EXITS 64
+/* The exit status of a process terminated by signal 31 */
+#define EXIT_KILLED (-31)
+// Terminated processes the dispatcher reaps at a time, see disp.c
+#define REAP_BATCH 8
+/* Word that new stacks are painted with to measure their peak usage */
+#define STACK_PAINT_PATTERN 0x5a5a5a5a
+/* Set to 1 to print the peak stack usage of every process when it terminates */
+#define REPORT_STACK_USAGE 0
+/* Number of default sized stacks kept for reuse */
+#define STACK_POOL_SIZE 8
+/* Set to 1 to map process stacks lazily into reserved virtual memory, see paging.c,
+   make paging builds the kernel and the tests with it set */
+#ifndef PAGING_ENABLED
+#define PAGING_ENABLED 0
+#endif
+/* Virtual memory reserved for process stacks in paging mode, one 64KB slot per PCB */
+#define VSTACK_BASE 0x40000000
+#define VSTACK_SLOT_SIZE 0x10000
+/* A single page table of stack slots, so at most 64 processes in paging mode */
+#define NUM_VSTACK_SLOTS 64
+#define VSTACK_END (VSTACK_BASE + NUM_VSTACK_SLOTS * VSTACK_SLOT_SIZE)
+/* Set to 1 to start the other processors of the machine, see smp.c, make smp builds
+   the kernel and the tests with it set */
+#ifndef SMP_ENABLED
+#define SMP_ENABLED 0
+#endif
+/* Most processors the dispatcher runs on, each has a GDT entry after the first 8 */
+#define MAX_CPUS 8
+/* Processors, one bit per index, on which only the processes pinned to them with
+   syssetaffinity run, see the notes on affinity in disp.c */
+#define ISOLATED_CPUS 0x0
+#define ALL_CPUS ((1UL << MAX_CPUS) - 1)
+/* 1 if the affinity of the given process lets it run on the processor with the given index */
+#define CPU_ALLOWED(proc, index) (((proc)->cpu_affinity >> (index)) & 1)
 #define IDLE_PROCESS_STACK_SIZE 512
-#define NUM_PRIORITIES 4
-// By default a process is created with priority 3
-#define INIT_PRIORITY 3
+/* One bit per priority in the ready queue bitmap, so at most 32 */
+#define NUM_PRIORITIES 32
+// By default a process is created with the lowest priority
+#define INIT_PRIORITY (NUM_PRIORITIES - 1)
 #define IDLE_PROC_PID 0
 #define BUFFER_SIZE sizeof(unsigned long)
+// Largest message syssendv and sysrecvv carry, in bytes
+#define MAX_MESSAGE_SIZE 4096
+// Most processes sysrecvset waits for a message from
+#define MAX_RECV_SET 8
+// Most messages syssendbatch and sysrecvbatch handle in a single call
+#define MAX_BATCH 64
+// The result of a message of syssendbatch the kernel has not handled yet
+#define BATCH_PENDING 1
+// Most entries of each ring of sysringsetup, the number of entries is a power of two
+#define IORING_MAX_ENTRIES 256
+// The operations of a submission of sysringenter
+#define IORING_OP_NOP 0
+#define IORING_OP_READ 1
+#define IORING_OP_WRITE 2
+#define IORING_OP_SEND 3
+#define IORING_OP_SLEEP 4
+#define IORING_OP_OPEN 5
+#define IORING_OP_CLOSE 6
 #define TIME_SLICE 10
+/* Time slices a process at the given priority runs before it is rotated, lower
+   priorities get longer quanta so that batch work is switched less often */
+#define PRIORITY_QUANTUM(priority) (1 + (priority) * 3 / NUM_PRIORITIES)
+/* Longest quantum syssetquantum accepts, in milliseconds */
+#define MAX_PROCESS_QUANTUM 1000
+/* Most timer slack syssettimerslack accepts, in milliseconds */
+#define MAX_TIMER_SLACK 1000
+/* Longest period syssetrealtime accepts, in milliseconds */
+#define MAX_REALTIME_PERIOD 10000
+/* Defaults for the multilevel feedback scheduler, passed to kmlfqinit at boot, make
+   mlfq builds the kernel and the tests with it enabled */
+#ifndef MLFQ_ENABLED
+#define MLFQ_ENABLED 0
+#endif
+/* Full time slices a process runs at a priority before it is demoted */
+#define MLFQ_DEMOTE_QUANTA 2
+/* Priorities a process is promoted by when it wakes up */
+#define MLFQ_WAKE_BOOST 4
+/* Ticks between aging passes */
+#define MLFQ_AGING_INTERVAL 50
+/* Scheduling policy passed to kdispinit at boot, SCHED_PRIORITY or SCHED_STRIDE, make
+   stride builds the kernel and the tests with SCHED_STRIDE */
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_PRIORITY
+#endif
+/* Tickets a process holds under the stride scheduler until it calls syssettickets */
+#define DEFAULT_TICKETS 100
+/* Most tickets syssettickets accepts */
+#define MAX_TICKETS 1000
 #define SYSCALL_INTERRUPT_NUMBER 67
+/* Vector of system calls that return without entering the dispatcher */
+#define FAST_SYSCALL_INTERRUPT_NUMBER 68
+/* Vector of system calls serviced on the stack of the process, see disp.c */
+#define PREEMPTIBLE_SYSCALL_INTERRUPT_NUMBER 69
+/* Returned through preemptcall when the rest of the call is left to the dispatcher */
+#define PREEMPT_DISPATCH -1000
 #define TIMER_INTERRUPT_NUMBER 32
 #define KEYBOARD_INTERRUPT_NUMBER 33
+/* Vector of the first serial port, IRQ 4 */
+#define SERIAL_INTERRUPT_NUMBER 36
+/* Vector of the primary ATA channel, IRQ 14 on the second interrupt controller */
+#define ATA_INTERRUPT_NUMBER 46
+/* Vectors of the local APIC timer of the other processors and of spurious APIC
+   interrupts */
+#define APIC_TIMER_INTERRUPT_NUMBER 48
+#define SPURIOUS_INTERRUPT_NUMBER 255
 #define EFLAGS 0x00003200
 #define SIGNAL_TABLE_SIZE 32
-// Allow 4 devices to be opened at once by each process
+/* How syssigprocmask changes the blocked signals of the process */
+#define SIG_BLOCK 0
+#define SIG_UNBLOCK 1
+#define SIG_SETMASK 2
+/* Signals queued with syssigqueue each process holds, further ones fail until the
+   queue is drained */
+#define SIGNAL_QUEUE_SIZE 8
+// File descriptors each process starts with room for, its table grows by doubling
+// up to MAX_FDS as they are opened
 #define FD_TABLE_SIZE 4
+// Allow 16 devices to be opened at once by each process, at most 30 as each has a bit
+// of a syspoll mask below POLL_IPC
+#define MAX_FDS 16
+/* Bit of a syspoll mask for a process waiting to send to the caller, the bits below
+   it stand for the file descriptors */
+#define POLL_IPC (1 << MAX_FDS)
+/* Device independent sysioctl commands, which put a file descriptor in and out of
+   non-blocking mode, where a read that would block returns BLOCKERR instead */
+#define IOCTL_NONBLOCK_ON 61
+#define IOCTL_NONBLOCK_OFF 62
+/* Longest name of a system call in the system call table, including the NUL */
+#define SYSCALL_NAME_LENGTH 16
+/* Buckets of the cycle histogram of a system call, one per power of 2 */
+#define SYSCALL_HISTOGRAM_BUCKETS 32
+/* Buckets of the latency histogram of the PIT tick, one per power of 2 microseconds */
+#define LATENCY_TICK_BUCKETS 16
 
 // Debug flag for logging
 #define DEBUG 0
+// Set to 1 by make bench, which runs the benchmarks in c/bench in place of the tests
+#ifndef BENCH
+#define BENCH 0
+#endif
+// Set to 1 by make fast, which boots without the sample output and the tests
+#ifndef FAST_BOOT
+#define FAST_BOOT 0
+#endif
+// Whether the tests are run at boot and by the root process
+#define RUN_TESTS (!BENCH && !FAST_BOOT)
 
 typedef enum {
     RUNNING,
@@ -93,9 +275,20 @@ typedef enum blocked_queue {
     RECEIVE_ANY,
     SLEEP,
     READ,
+    PORT,
+    FUTEX,
+    PIPE,
+    POLL,
+    SERIAL,
+    DISK,
+    WAIT_CHILD,
+    COPYING,
     NONE
 } blocked_queue_t;
 
+// The number of blocked queues a process may be on, those before NONE
+#define NUM_BLOCKED_QUEUES NONE
+
 struct pcb;
 typedef struct queue {
     size_t size;
@@ -108,6 +301,140 @@ typedef struct queue {
 // funcptr = void (*func)(void), for readability
 typedef void (*funcptr)(void);
 typedef void (*signal_handler_funcptr)(void *);
+typedef void (*syscall_handler_t)(void);
+
+// An entry of a timing wheel, see timerwheel.h, embedded in whatever is timed
+struct timer_slot;
+struct timer_entry;
+typedef void (*timer_expiry_funcptr)(struct timer_entry *entry);
+typedef struct timer_entry {
+    // The tick the entry is due at, the slot of the wheel it is in and its
+    // neighbours in the slot
+    unsigned long long wake_tick;
+    struct timer_slot *slot;
+    struct timer_entry *next;
+    struct timer_entry *prev;
+    // Called when the entry is due, after it has been removed from the wheel
+    timer_expiry_funcptr expire;
+    // The process or kernel timer the entry belongs to
+    void *owner;
+} timer_entry_t;
+
+// A deferred work item, see workq.c, embedded in the driver that queues it
+struct work;
+typedef void (*work_funcptr)(struct work *work);
+typedef struct work {
+    // Called by run_next_work once the item has been taken off the queue
+    work_funcptr func;
+    // Whether the item is on the queue, an item queued again before it runs still
+    // runs once
+    int queued;
+    struct work *next;
+} work_t;
+
+// The counters of the deferred work queue, counted since boot
+typedef struct work_stats {
+    // Items put on the queue, and those already on it when queued again
+    unsigned int queued;
+    unsigned int coalesced;
+    // Items run, and the drains that left items behind for the next one
+    unsigned int run;
+    unsigned int deferred;
+    // The most items the queue has held
+    unsigned int high_water;
+} work_stats_t;
+
+// The categories of kernel trace events, see trace.c, enabled with systracectl
+#define TRACE_SYSCALL 0x01
+#define TRACE_SCHED 0x02
+#define TRACE_IPC 0x04
+#define TRACE_TIMER 0x08
+#define TRACE_INTR 0x10
+#define TRACE_ALL 0x1f
+
+// The kind of a kernel trace event and what its arguments are
+typedef enum {
+    // A system call was entered and serviced: the request, and the result code
+    TRACE_SYSCALL_ENTER,
+    TRACE_SYSCALL_EXIT,
+    // A process was made ready: its priority and the blocked queue it was on
+    TRACE_READY,
+    // A process was picked to run: the PID of the process it replaces
+    TRACE_SWITCH,
+    // A send and a receive: the PID of the peer, 0 for any, and the buffer length
+    TRACE_SEND,
+    TRACE_RECV,
+    // A sleep, poll or IPC timeout expired on a tick: the blocked queue and the tick
+    TRACE_WAKEUP,
+    // A keyboard interrupt: the scancode read, and 1 if it was dropped
+    TRACE_KBD
+} trace_type_t;
+
+// A kernel trace event
+typedef struct trace_event {
+    // The time stamp counter when the event was recorded
+    unsigned long long timestamp;
+    // The number of events recorded before this one
+    unsigned long seq;
+    // A trace_type_t, and the processor the event was recorded on
+    unsigned char type;
+    unsigned char cpu;
+    // The process the event is about
+    unsigned short pid;
+    unsigned long arg0;
+    unsigned long arg1;
+} trace_event_t;
+
+// The levels of kernel log records, see klog.c, the lower the more severe
+#define LOG_ERROR 0
+#define LOG_WARN 1
+#define LOG_INFO 2
+#define LOG_DEBUG 3
+// Records above this level are compiled out, all of them are kept with DEBUG
+#define LOG_COMPILE_LEVEL (DEBUG ? LOG_DEBUG : LOG_INFO)
+// Records up to this level are made from boot, changed at runtime with syslogctl
+#define LOG_DEFAULT_LEVEL LOG_WARN
+// Arguments a log record keeps for its format
+#define LOG_MAX_ARGS 4
+
+// A kernel log record, formatted by the logger process when it is written out
+typedef struct log_record {
+    // The time stamp counter when the record was made
+    unsigned long long timestamp;
+    // The format and its arguments, as passed to KLOG, a %s argument must be a
+    // string constant as it is only read when the record is written out
+    char *fmt;
+    unsigned long args[LOG_MAX_ARGS];
+    // The level, and the processor the record was made on
+    unsigned char level;
+    unsigned char cpu;
+    // The records dropped on the processor since the one before this one
+    unsigned short dropped;
+} log_record_t;
+
+// The histogram of the sampling profiler, see profile.c, as read by sysprofread
+typedef struct profile {
+    // 1 while samples are taken, and the PID of the process sampled, 0 for every
+    // process
+    int running;
+    unsigned int pid;
+    // Bucket i counts the samples from address i << shift to (i + 1) << shift - 1
+    int shift;
+    // Samples of the idle process, and those outside the kernel text, the samples
+    // taken are these and those in the histogram
+    unsigned long idle;
+    unsigned long outside;
+    unsigned long histogram[PROFILE_BUCKETS];
+} profile_t;
+
+// What the handler of a signal is told about it, see signal_info
+typedef struct siginfo {
+    int signal_number;
+    // The PID of the process that queued the signal with syssigqueue and its
+    // payload, both 0 for a signal raised by syskill or a timer
+    unsigned int sender_pid;
+    int value;
+} siginfo_t;
 
 typedef struct signal_delivery_context {
     context_frame_t context_frame;
@@ -115,6 +442,8 @@ typedef struct signal_delivery_context {
     funcptr *return_address;
     signal_handler_funcptr handler;
     void *cntx;
+    siginfo_t info;
+    // The last two fields are read by syssigreturn just below cntx
     // The current value of the current signal processing level
     int last_signal_delivered;
     // Remember the value that needs to be returned for the system call as any context
@@ -126,55 +455,286 @@ typedef struct signal_delivery_context {
 
 typedef enum {
     KBD_0 = 0,
-    KBD_1 = 1
+    KBD_1 = 1,
+    PIPE_0 = 2,
+    PIPE_1 = 3,
+    SERIAL_0 = 4,
+    CONSOLE_0 = 5,
+    RAMDISK_0 = 6,
+    ATA_0 = 7,
+    NULL_0 = 8,
+    ZERO_0 = 9,
+    LOOP_0 = 10
 } dev_t;
 
+// The waits on the queue of senders or receivers of a process, see disp.c
+typedef struct ipc_queue_stats {
+    // Number of processes that joined the queue, and the most on it at once
+    unsigned long waits;
+    unsigned long max_depth;
+    // Cycles the processes that left the queue waited on it, in total and at most
+    unsigned long long wait_cycles;
+    unsigned long max_wait_cycles;
+} ipc_queue_stats_t;
+
+// The exit of a child that syswaitany has not yet returned, see disp.c
+typedef struct child_exit {
+    unsigned int pid;
+    int status;
+    // The process group the child was in
+    unsigned int pgid;
+    struct child_exit *next;
+} child_exit_t;
+
 struct devsw;
+struct arena_chunk;
+// The parts of a PCB used only by signal delivery, file descriptors, IPC between
+// processes and statistics, kept apart from pcb_t so walks over the PCB table and
+// the queue operations of the scheduler do not bring them into the cache. Every PCB
+// has its own, reached through its cold field
+typedef struct pcb_cold {
+    // blocked_queues[0] = queue of senders
+    // blocked_queues[1] = queue of receivers
+    // blocked_queues[2] = queue of waiting processes
+    Queue blocked_queues[3];
+    // The PIDs a receive from any process accepts a message from, all PIDs if the
+    // set is empty
+    unsigned int ipc_recv_set[MAX_RECV_SET];
+    int ipc_recv_set_size;
+    // The waits on the queues of senders and receivers of the process, and the time
+    // stamp at which the process joined the queue it is on
+    ipc_queue_stats_t ipc_queue_stats[RECEIVER + 1];
+    unsigned long long ipc_enqueued_at;
+    // Cycles spent blocked on each blocked queue
+    unsigned long long blocked_cycles[NUM_BLOCKED_QUEUES];
+
+    // Only used through owner, so the signal handlers of a thread are those of the
+    // process that owns it
+    signal_handler_funcptr signal_table[SIGNAL_TABLE_SIZE];
+
+    // The signals queued with syssigqueue, oldest first
+    siginfo_t queued_signals[SIGNAL_QUEUE_SIZE];
+    int num_queued_signals;
+    // Entries of the queue kept free for the asynchronous reads in progress
+    int num_reserved_signals;
+
+    // File descriptor table that allows MAX_FDS devices to be opened at once, only
+    // used through owner like the signal table
+    // Each entry in the table identifies the device associated with the descriptor
+    // as a pointer to the device in device block table
+    // The table starts as fd_inline and is moved to the kernel heap as it grows
+    struct devsw **fd_table;
+    int fd_table_size;
+    struct devsw *fd_inline[FD_TABLE_SIZE];
+    // Bit i is set while file descriptor i of the table is free
+    unsigned int free_fds;
+    // The file descriptors put in non-blocking mode with IOCTL_NONBLOCK_ON, one bit
+    // each
+    unsigned int nonblocking_fds;
+
+    // The rings registered with sysringsetup, NULL if there are none, and the
+    // entries and number of entries less one they had when they were checked
+    struct io_ring *ring;
+    struct io_sqe *ring_sqes;
+    struct io_cqe *ring_cqes;
+    unsigned int ring_mask;
+} pcb_cold_t;
+
 typedef struct pcb {
+    // The fields used by every queue operation and context switch come first, so
+    // they share the first cache line of the PCB, see the notes on the PCB layout in
+    // disp.c
     int pid;
     process_state_t state;
     // prev and next pointers for implementing process queues as doubly-linked lists
     struct pcb *prev;
     struct pcb *next;
-    void *mem_start;
     void *esp;
     // Return value of system call
     int result_code;
-    // A process can have a priority from 0 to 3
-    // with 3 being the lowest priority and 0 being the highest priority
-    // By default a process is created with priority 3
+    // A process can have a priority from 0 to NUM_PRIORITIES - 1
+    // with NUM_PRIORITIES - 1 being the lowest priority and 0 being the highest priority
+    // By default a process is created with the lowest priority
     int priority;
-
+    // Highest priority of the processes blocked on this process, NUM_PRIORITIES if
+    // there are none, the process is scheduled at the higher of this and priority
+    int inherited_priority;
+    // Time slices left in the current quantum of the process
+    int quantum_left;
+    // Processor whose ready queues the process is on when it is ready
+    int cpu;
+    // Scheduler tick at which the process was last made ready
+    unsigned long ready_tick;
     // The process that this process is blocked on
     struct pcb *blocked_on;
     // The blocked queue that this process is on
     blocked_queue_t blocked_queue;
-    // blocked_queues[0] = queue of senders
-    // blocked_queues[1] = queue of receivers
-    // blocked_queues[2] = queue of waiting processes
-    Queue blocked_queues[3];
-    unsigned long *ipc_args;
-    // Used in deltalist to service syssleep
-    // Specifies the delay relative to the time when the predecessor is woken
-    int key;
-
-    // CPU time consumed in ticks
-    long cpuTime;
-
-    signal_handler_funcptr signal_table[SIGNAL_TABLE_SIZE];
-
     // Records all of the signals currently targeted to the process
     int pending_signals;
     // The last signal delivered, -1 if there are no pending signals
     // Indicates the range of signals the process will respond to taking priorities into account
     // Signals numbered > last_signal_delivered will be delivered
     int last_signal_delivered;
+    // The signal, file descriptor and IPC state of the process, see pcb_cold_t
+    struct pcb_cold *cold;
 
-    // File descriptor table that allows 4 devices to be opened at once
-    // Each entry in the table identifies the device associated with the descriptor
-    // as a pointer to the device in device block table
-    struct devsw *fd_table[FD_TABLE_SIZE];
-} pcb_t;
+    void *mem_start;
+    // Size of the stack starting at mem_start
+    unsigned long stack_size;
+    // Highest priority the multilevel feedback scheduler may give the process
+    int base_priority;
+    // Full time slices the process has run at its current priority
+    int quanta_used;
+    // Time slices the process runs before it is rotated, 0 to use the quantum of
+    // its priority
+    int quantum;
+    // Period and budget in time slices if the process is in the real-time class,
+    // rt_period is 0 otherwise
+    int rt_period;
+    int rt_budget;
+    // Time slices of budget left in the current period
+    int rt_budget_left;
+    // Tick at which the current period ends
+    unsigned long rt_deadline;
+    // Share of the processor under the stride scheduler, and the stride and pass
+    // derived from it
+    int tickets;
+    unsigned long stride;
+    unsigned long pass;
+    // Position of the process in the heap of ready processes of the stride scheduler
+    int heap_index;
+    // Processors the process may run on, one bit per index
+    unsigned long cpu_affinity;
+
+    // The message buffer of the send or receive of the process and its length in
+    // bytes, and whether the call returns the number of bytes copied
+    void *ipc_buf;
+    unsigned int ipc_len;
+    int ipc_vectored;
+    // Where a receive stores the PID of the sending process
+    unsigned int *ipc_from_pid;
+    // Where a caller of sysrpc receives the reply once its request is delivered,
+    // NULL for any other send
+    unsigned long *ipc_reply_buf;
+    // The process whose message a preemptible syssendv or sysrecvv of the process is
+    // copying, see msg.c
+    struct pcb *ipc_peer;
+    // The queue of the message port, futex bucket, pipe, serial port, keyboard or
+    // disk read or write the process is blocked on
+    Queue *wait_queue;
+    // The address the process waits on in sysfutexwait
+    int *futex_addr;
+    // The file descriptors and POLL_IPC bit the process waits on in syspoll
+    unsigned int poll_mask;
+    // The buffer of the pipe, serial or keyboard read or write the process is blocked
+    // in, the bytes left to move, and the bytes already moved
+    char *io_buf;
+    int io_len;
+    int io_done;
+    // Used in timerwheel to service syssleep and timeouts, linked separately from
+    // the process queues so a process can be on a blocked queue and in the wheel
+    timer_entry_t timer;
+    // Time slices a sleep or timeout of the process may be extended by so that it
+    // expires in the same tick as others
+    int timer_slack;
+    // The time on the monotonic clock a sleep with sysusleep ends at, 0 for any
+    // other sleep, the tick that starts the time slice it ends in, and the next of
+    // the processes whose sleep ends in the current time slice, see sleep.c
+    unsigned long long sleep_deadline_us;
+    unsigned long long sleep_deadline_tick;
+    struct pcb *next_sleeper;
+
+    // CPU time consumed in ticks
+    long cpuTime;
+    // Cycles spent running, read from the time stamp counter on either side of the
+    // context switch
+    unsigned long long run_cycles;
+    // Times the process gave up the processor through a system call, and times it
+    // was switched out by an interrupt
+    unsigned int voluntary_switches;
+    unsigned int involuntary_switches;
+    // System calls made, and signals whose handlers were called
+    unsigned int syscalls;
+    unsigned int signals_delivered;
+    // Messages the process has had delivered, and has received
+    unsigned int messages_sent;
+    unsigned int messages_received;
+    // The time stamp at which the process was switched out blocked on blocked_as, 0
+    // while it is not blocked, see blocked_cycles
+    unsigned long long blocked_since;
+    blocked_queue_t blocked_as;
+
+    // The process whose signal table and file descriptor table this process uses,
+    // itself unless it is a thread made with create_thread
+    struct pcb *owner;
+    // Threads of the process that have not terminated, 0 for a thread
+    int num_threads;
+
+    // The process that created this process, 0 for a thread or a process created
+    // by the kernel, and the children of this process that have not terminated
+    unsigned int parent_pid;
+    int num_children;
+    // The status this process terminates with, given to sysexit
+    int exit_status;
+    // The exits of children not yet returned by syswaitany, oldest first
+    child_exit_t *child_exits;
+    child_exit_t *child_exits_tail;
+    int num_child_exits;
+    // The PIDs and the status location of the syswaitany the process is blocked in,
+    // a count of 0 waits for any child, and the group of syswaitpg, 0 for any group
+    unsigned int *wait_pids;
+    int wait_count;
+    int *wait_status;
+    unsigned int wait_pgid;
+
+    // The process group of the process, 0 if it is in none, and its neighbours on
+    // the list of members of the group, see pgrp.c
+    unsigned int pgid;
+    struct pcb *pgrp_prev;
+    struct pcb *pgrp_next;
+
+    // The signals held pending instead of delivered, set with syssigprocmask, never
+    // includes signal 31
+    int blocked_signals;
+
+    // Chunks of memory the process has allocated from through sysalloc, released in
+    // bulk when the process is cleaned up
+    struct arena_chunk *arena;
+    // Bit i is set if the process holds shared memory segment i
+    unsigned long shm_held;
+} __attribute__((aligned(CACHE_LINE_SIZE))) pcb_t;
+
+// The state of a processor, reached through its own %gs segment
+typedef struct cpu {
+    // Used by the context switcher at fixed offsets from %gs, keep them first and in
+    // this order, see ctsw.c
+    struct cpu *self;
+    void *k_stack;
+    unsigned long *esp;
+    int eax;
+    int interrupt;
+    unsigned long *args;
+
+    // Index of the processor, 0 for the boot processor
+    int index;
+    // 1 once the processor runs the dispatcher
+    int online;
+    pcb_t *current;
+    pcb_t idle;
+    pcb_cold_t idle_cold;
+    // Multiple ready queues, one for each priority
+    Queue ready_queues[NUM_PRIORITIES];
+    // Bit i is set if ready_queues[i] is non-empty
+    unsigned long ready_bitmap;
+    // Number of processes on the ready queues
+    int num_ready;
+    // Set when a process is made ready that should pre-empt the current process
+    int need_resched;
+} cpu_t;
+
+typedef struct spinlock {
+    volatile int locked;
+} spinlock_t;
 
 /*-----------------------------------------------------------------------------------
  * The device structure: The design of the structure is capable of supporting a wide
@@ -184,12 +744,16 @@ typedef struct pcb {
  * - How this device structure differs from the device structure given in class:
  *   - dvseek, dvgetc, dvputc, dvcntl, dvcsr, dvivec, dvovec, dviint, and dvoint were
  *     removed as there are no corresponding system calls to access these services
- *   - dvioblk was removed as it is not necessary to have device specific data
  *   - dvioctl was added to perform the sysioctl service
+ *   - dvpoll was added to tell syspoll whether there is input to read
+ *   - dvaioread was added to perform the sysaioread service
+ *   - dvstep was added to service sysread and syswrite in steps, see disp.c
+ * - dvioblk points to the device specific data, such as the ring buffer of a pipe,
+ *   so devices of the same kind can share their functions
  * - Each function to perform the various services (aside from dvinit) has as its
- *   parameters a pointer to the PCB of the process that called the corresponding
- *   system call, along with the parameters of the corresponding system call
- *   necessary to perform the service
+ *   parameters the device structure, a pointer to the PCB of the process that
+ *   called the corresponding system call, along with the parameters of the
+ *   corresponding system call necessary to perform the service
  * - As this device structure is to be capable of supporting a wide range of both
  *   physical and virtual devices, the structure is not specific to the keyboard,
  *   which means that parameters may be unused in the keyboard device driver
@@ -201,39 +765,337 @@ typedef struct devsw {
     int dvnum;
     char *dvname;
     int dvminor;
+    // Device specific data
+    void *dvioblk;
 
     // Called to setup the device
     int (*dvinit)(void);
     // Sets up device access
-    int (*dvopen)(pcb_t *proc, int device_no);
+    int (*dvopen)(struct devsw *devsw, pcb_t *proc, int device_no);
     // Terminates device access
-    int (*dvclose)(pcb_t *proc);
+    int (*dvclose)(struct devsw *devsw, pcb_t *proc);
 
-    int (*dvread)(pcb_t *proc, void *buf, int buflen);
-    int (*dvwrite)(pcb_t *proc, void *buf, int buflen);
+    int (*dvread)(struct devsw *devsw, pcb_t *proc, void *buf, int buflen, int nonblocking);
+    int (*dvwrite)(struct devsw *devsw, pcb_t *proc, void *buf, int buflen);
 
     // Pass special control information
-    int (*dvioctl)(pcb_t *proc, unsigned long command, void *ioctl_args);
+    int (*dvioctl)(struct devsw *devsw, pcb_t *proc, unsigned long command, void *ioctl_args);
+    // Whether the device has input for the process to read, for syspoll
+    int (*dvpoll)(struct devsw *devsw, pcb_t *proc);
+    // Starts a read that completes by queuing a signal, for sysaioread
+    int (*dvaioread)(struct devsw *devsw, pcb_t *proc, void *buf, int buflen, int signal_number);
+    // Moves at most a block of a read or write without blocking, for the preemptible
+    // sysread and syswrite, NULL if the device has no such step
+    int (*dvstep)(struct devsw *devsw, pcb_t *proc, void *buf, int buflen, int write);
 } devsw_t;
 
-//  Each element in the structure corresponds to a process in the system
-typedef struct struct_ps {
-    // Last entry used in the table
-    int entries;
+// The status of a process, as reported by sysgetcputimes
+typedef struct proc_status {
     // The process ID
-    int pid[PCB_TABLE_SIZE];
+    int pid;
 
     // The process state
-    process_state_t state[PCB_TABLE_SIZE];
+    process_state_t state;
     // The process blocked queue if state is BLOCKED
-    blocked_queue_t blocked_queue[PCB_TABLE_SIZE];
+    blocked_queue_t blocked_queue;
 
     // CPU time used in milliseconds
-    long cpuTime[PCB_TABLE_SIZE];
+    long cpuTime;
+    // CPU time used in cycles of the time stamp counter
+    unsigned long long runCycles;
+    // Switches out through a system call and by an interrupt
+    unsigned int voluntarySwitches;
+    unsigned int involuntarySwitches;
+    // System calls made and signals delivered
+    unsigned int syscalls;
+    unsigned int signalsDelivered;
+    // Messages sent and received
+    unsigned int messagesSent;
+    unsigned int messagesReceived;
+    // Cycles spent blocked on each blocked queue
+    unsigned long long blockedCycles[NUM_BLOCKED_QUEUES];
+
+    // Peak stack usage in bytes
+    unsigned long stackUsage;
+    // Time left in the current quantum in milliseconds
+    long quantumLeft;
+    // Priority the process is scheduled at, including any inherited priority
+    int priority;
+    // The CPU time of the process as a share of the CPU time of all processes in
+    // tenths of a percent
+    int cpuShare;
+} proc_status_t;
+
+//  Each element of proc corresponds to a process in the system, the caller allocates
+//  room for as many elements as it likes, PS_SIZE gives the size in bytes
+typedef struct struct_ps {
+    // Number of elements of proc, set by the caller
+    int size;
+    // Number of processes in the system including the idle process, which is more
+    // than size if not all of them fit
+    int entries;
+    proc_status_t proc[];
 } processStatuses;
 
+#define PS_SIZE(size) (sizeof(processStatuses) + (size) * sizeof(proc_status_t))
+
+// The arguments of a system call made through preemptcall that has more than one,
+// and how far the call got before it was left to the dispatcher
+typedef struct preempt_args {
+    int arg[3];
+    int done;
+} preempt_args_t;
+
 typedef unsigned int PID_t;
 
+// Tunables of the multilevel feedback scheduler
+typedef struct mlfq_config {
+    // 1 to use the multilevel feedback policy, 0 for static priorities only
+    int enabled;
+    // Full time slices a process runs at a priority before it is demoted
+    int demote_quanta;
+    // Priorities a process is promoted by when it wakes up from sleep, a read or IPC
+    int wake_boost;
+    // Ticks between aging passes, a process that has been ready for a whole pass
+    // is promoted by one priority
+    int aging_interval;
+} mlfq_config_t;
+
+// Policies the dispatcher schedules processes that are not real-time with
+typedef enum {
+    // Strict priorities, round-robin within a priority
+    SCHED_PRIORITY,
+    // Proportional share by tickets, see stride.c
+    SCHED_STRIDE
+} sched_policy_t;
+
+// Live counters of the memory manager, sizes in bytes include the block headers
+typedef struct mem_stats {
+    unsigned long bytes_in_use;
+    // Free bytes in the heap before the hole
+    unsigned long pre_hole_free_bytes;
+    // Free bytes in the heap after the hole
+    unsigned long post_hole_free_bytes;
+    unsigned long largest_free_block;
+    int free_block_count;
+    // Pages left in the page allocator
+    int free_pages;
+    int num_allocs;
+    int num_frees;
+    int failed_allocs;
+} mem_stats_t;
+
+// Statistics of one system call in the system call table
+typedef struct syscall_stats {
+    char name[SYSCALL_NAME_LENGTH];
+    // Number of times the system call was serviced
+    unsigned long count;
+    // Most processor cycles servicing the system call took
+    unsigned long max_cycles;
+    // Element i is the number of calls that took from 2^i to 2^(i + 1) - 1 cycles
+    unsigned long histogram[SYSCALL_HISTOGRAM_BUCKETS];
+} syscall_stats_t;
+
+// Time the kernel spent with interrupts disabled after being entered with one request,
+// a system call or an interrupt, see latency.c
+typedef struct latency_stats {
+    char name[SYSCALL_NAME_LENGTH];
+    // Number of times the kernel was entered with the request, and the most cycles it
+    // then ran before switching back to a process
+    unsigned long count;
+    unsigned long max_cycles;
+    // Element i is the number of entries that took from 2^i to 2^(i + 1) - 1 cycles
+    unsigned long histogram[SYSCALL_HISTOGRAM_BUCKETS];
+    // Number of PIT ticks handled right after an entry with the request, and the most
+    // microseconds one of them waited
+    unsigned long tick_count;
+    unsigned long tick_max_us;
+    // Element i is the number of ticks that waited from 2^i to 2^(i + 1) - 1
+    // microseconds, the last one counts the longer waits too
+    unsigned long tick_histogram[LATENCY_TICK_BUCKETS];
+} latency_stats_t;
+
+// The waits on the IPC queues of a process, as returned by sysgetipcstats
+typedef struct ipc_stats {
+    // The senders waiting for the process to receive their messages
+    ipc_queue_stats_t senders;
+    // The receivers waiting for the process to send to them, callers of sysrpc
+    // waiting for the reply among them
+    ipc_queue_stats_t receivers;
+    // Number of processes on each queue now
+    unsigned long sender_depth;
+    unsigned long receiver_depth;
+} ipc_stats_t;
+
+// A message of syssendbatch, and the result of sending it
+typedef struct send_batch_entry {
+    unsigned int dest_pid;
+    unsigned long num;
+    int result;
+} send_batch_entry_t;
+
+// A message received by sysrecvbatch, and the PID of its sender
+typedef struct recv_batch_entry {
+    unsigned int from_pid;
+    unsigned long num;
+} recv_batch_entry_t;
+
+// An operation queued on the submission ring of sysringsetup
+typedef struct io_sqe {
+    // One of the IORING_OP_ operations
+    int opcode;
+    // The file descriptor of a read, write or close, the PID a send goes to, or the
+    // major device number of an open
+    int fd;
+    // The buffer of a read, write or send and its length in bytes, len is the
+    // milliseconds of a sleep
+    void *buf;
+    int len;
+    // Handed back with the completion, for the process to tell them apart
+    unsigned long user_data;
+} io_sqe_t;
+
+// The completion of an operation, with the result the system call of the same name
+// would return
+typedef struct io_cqe {
+    unsigned long user_data;
+    int result;
+} io_cqe_t;
+
+// A submission ring and a completion ring in the memory of a process, see the notes
+// on submission rings in disp.c. The indices only ever grow, an entry is at its
+// index modulo the number of entries
+typedef struct io_ring {
+    // Set by the process before sysringsetup
+    unsigned int entries;
+    io_sqe_t *sqes;
+    io_cqe_t *cqes;
+    // The process queues submissions at sq_tail, the kernel takes them at sq_head
+    volatile unsigned int sq_head;
+    volatile unsigned int sq_tail;
+    // The kernel posts completions at cq_tail, the process takes them at cq_head
+    volatile unsigned int cq_head;
+    volatile unsigned int cq_tail;
+} io_ring_t;
+
+// A mutex of sync.c, 0 if unlocked, 1 if locked, 2 if locked with processes that
+// may be waiting
+typedef struct mutex {
+    volatile int state;
+} mutex_t;
+
+// A counting semaphore of sync.c
+typedef struct semaphore {
+    volatile int count;
+    // Processes that may be waiting for the count to become positive
+    volatile int waiters;
+} semaphore_t;
+
+// A condition variable of sync.c
+typedef struct cond {
+    // Advanced by every signal and broadcast
+    volatile int seq;
+    // Processes that may be waiting for a signal
+    volatile int waiters;
+} cond_t;
+
+// The largest argument block sysspawn copies onto the stack of the new process
+#define SPAWN_MAX_ARGS 256
+// Flag of spawn_attr_t to give the new process the open file descriptors of its
+// parent
+#define SPAWN_INHERIT_FDS 0x1
+
+// The attributes of a process started with sysspawn
+typedef struct spawn_attr {
+    // Bytes of stack to allocate, at least MIN_PROCESS_STACK_SIZE is
+    int stack_size;
+    // The priority to start at, -1 for the priority syscreate gives
+    int priority;
+    // SPAWN_INHERIT_FDS or 0
+    int flags;
+} spawn_attr_t;
+
+// Smallest stack coro_create accepts
+#define CORO_MIN_STACK_SIZE 256
+
+// A coroutine of coro.c, run by the process of its scheduler
+typedef struct coro {
+    // The stack pointer saved while the coroutine is switched out
+    void *esp;
+    void (*func)(void *arg);
+    void *arg;
+    struct coro_sched *sched;
+    // The next coroutine on the run queue or on the list of woken coroutines
+    struct coro *next;
+    // Whether the coroutine is blocked or has a wake to take, changed atomically
+    // since any process may wake it
+    volatile int park;
+} coro_t;
+
+// The coroutines of a process, which take turns on its stack without a system call
+typedef struct coro_sched {
+    // The caller of coro_run, switched back to once every coroutine has finished
+    coro_t main;
+    coro_t *current;
+    // The ready coroutines, oldest first
+    coro_t *run_head;
+    coro_t *run_tail;
+    // Coroutines created that have not finished
+    int live;
+    // The coroutines woken since the process last looked, newest first
+    coro_t *volatile woken;
+    // Advanced by every wake of a blocked coroutine, the process waits on it in
+    // the kernel while every coroutine is blocked, and is 1 while it does
+    volatile int wakeups;
+    volatile int parked;
+} coro_sched_t;
+
+// The kinds of worker the load generator of load.c runs, and the most workers of a
+// run, an IPC worker also takes a partner process
+#define LOAD_CPU 0
+#define LOAD_IPC 1
+#define LOAD_SLEEP 2
+#define LOAD_ALLOC 3
+#define LOAD_KINDS 4
+#define LOAD_MAX_WORKERS 16
+
+// What the load generator runs, as "load" parses it
+typedef struct load_config {
+    // How long the workers run in milliseconds
+    int duration_ms;
+    // The workers of each kind, indexed by LOAD_CPU to LOAD_ALLOC
+    int workers[LOAD_KINDS];
+} load_config_t;
+
+// What the workers of one kind did over a run of the load generator
+typedef struct load_kind_stats {
+    int workers;
+    // Operations completed and failed, and completed per second
+    unsigned long ops;
+    unsigned long failures;
+    unsigned long ops_per_sec;
+    // The histogram buckets of the 50th, 90th and 99th percentile of the cycles an
+    // operation took, a bucket b holds from 2^b up to 2^(b + 1) - 1 cycles
+    int p50_bucket;
+    int p90_bucket;
+    int p99_bucket;
+    // The CPU time the workers ran for in milliseconds, as sysgetcputimes reports
+    long cpu_ms;
+} load_kind_stats_t;
+
+// The results of a run of the load generator
+typedef struct load_report {
+    // How long the workers ran in milliseconds
+    unsigned long elapsed_ms;
+    unsigned long ops_per_sec;
+    load_kind_stats_t kinds[LOAD_KINDS];
+    // The Jain fairness index of the CPU time of the CPU-bound workers in
+    // thousandths, 1000 if each got the same, and the least and most any got
+    int fairness;
+    long min_cpu_ms;
+    long max_cpu_ms;
+} load_report_t;
+
 typedef enum {
     SYSCREATE,
     SYSYIELD,
@@ -254,30 +1116,169 @@ typedef enum {
     SYSWRITE,
     SYSREAD,
     SYSIOCTL,
+    SYSGETMEMSTATS,
+    SYSALLOC,
+    SYSSETQUANTUM,
+    SYSSETREALTIME,
+    SYSSETTICKETS,
+    SYSGETSYSCALLSTATS,
+    SYSCLOCK,
+    SYSSENDTIM,
+    SYSRECVTIM,
+    SYSTIMER,
+    SYSTIMERCANCEL,
+    SYSSETTIMERSLACK,
+    SYSSENDV,
+    SYSRECVV,
+    SYSRPC,
+    SYSREPLYWAIT,
+    SYSPORTCREATE,
+    SYSPORTDESTROY,
+    SYSPORTSEND,
+    SYSPORTRECV,
+    SYSRECVSET,
+    SYSSENDBATCH,
+    SYSRECVBATCH,
+    SYSSHMCREATE,
+    SYSSHMATTACH,
+    SYSSHMDETACH,
+    SYSFUTEXWAIT,
+    SYSFUTEXWAKE,
+    SYSPOLL,
+    SYSSIGPROCMASK,
+    SYSSIGQUEUE,
+    SYSAIOREAD,
+    SYSTRACECTL,
+    SYSTRACEREAD,
+    SYSPROFSTART,
+    SYSPROFSTOP,
+    SYSPROFREAD,
+    SYSLOGCTL,
+    SYSLOGREAD,
+    SYSGETLATENCY,
+    SYSGETIPCSTATS,
+    SYSCREATETHREAD,
+    SYSSPAWN,
+    SYSEXIT,
+    SYSWAITANY,
+    SYSSETPGID,
+    SYSGETPGID,
+    SYSKILLPG,
+    SYSWAITPG,
+    SYSSETAFFINITY,
+    SYSGETAFFINITY,
+    SYSRINGSETUP,
+    SYSRINGENTER,
+    SYSRUNWORK,
+    SYSWAITWORK,
+    SYSUSLEEP,
     TIMER_INT,
-    KEYBOARD_INT
+    KEYBOARD_INT,
+    APIC_TIMER_INT,
+    SERIAL_INT,
+    ATA_INT
 } request_t;
 
 /* mem.c */
 typedef struct mem_header mem_header_t;
+// The reason a range of memory passed in by a process is invalid
+typedef enum {
+    RANGE_OK = 0,
+    RANGE_NULL,
+    RANGE_EMPTY,
+    RANGE_OVERFLOW,
+    RANGE_IN_KERNEL,
+    RANGE_IN_HOLE,
+    RANGE_BEYOND_MEMORY
+} range_check_t;
 void kmeminit(void);
 void *kmalloc(size_t size);
 int kfree(void *ptr);
+void kstackinit(void);
+void *kstackalloc(size_t size);
+int kstackfree(void *ptr);
+void get_mem_stats(mem_stats_t *stats);
+range_check_t check_range(void *ptr, unsigned long length, int allow_kernel);
 int valid_ptr(void *ptr);
 int valid_buf(void *ptr, unsigned long length);
 
+/* page.c */
+void kpageinit(unsigned long start, unsigned long end);
+void *kpagealloc(int order);
+int kpagefree(void *ptr);
+int page_order(size_t size);
+
+/* page.c testing */
+int get_free_page_count(void);
+
+/* arena.c */
+void *arena_alloc(pcb_t *proc, size_t size);
+void arena_release(pcb_t *proc);
+
+/* realtime.c */
+void krealtimeinit(void);
+int set_realtime(pcb_t *proc, int period_ms, int budget_ms);
+void realtime_release(pcb_t *proc);
+void realtime_ready(pcb_t *proc);
+void realtime_remove(pcb_t *proc);
+pcb_t *realtime_next(void);
+int realtime_tick(pcb_t *current, int ticks);
+int realtime_pending(void);
+
+/* stride.c */
+void kstrideinit(void);
+int set_tickets(pcb_t *proc, int tickets);
+void stride_ready(pcb_t *proc);
+void stride_remove(pcb_t *proc);
+pcb_t *stride_next(int cpu_index);
+void stride_charge(pcb_t *proc, int ticks);
+
+/* systab.c */
+void ksystabinit(void);
+int register_syscall(request_t call, char *name, syscall_handler_t handler);
+int service_syscall(request_t call);
+int get_syscall_stats(int call, syscall_stats_t *stats);
+char *syscall_name(int call);
+
+/* smp.c */
+void ksmpinit(void);
+void smp_boot_aps(void);
+cpu_t *this_cpu(void);
+cpu_t *get_cpu(int index);
+int smp_cpu_count(void);
+unsigned long smp_cpu_mask(void);
+void lapic_eoi(void);
+void spin_lock(spinlock_t *lock);
+void spin_unlock(spinlock_t *lock);
+void kernel_lock(void);
+void kernel_unlock(void);
+
+/* paging.c */
+void kpaginginit(void);
+void *vstack_alloc(int stack);
+void vstack_free(void *mem_start);
+unsigned long vstack_mapped_bytes(void *mem_start, unsigned long size);
+
 /* mem.c testing */
 int get_free_list_length(void);
 void print_free_list(void);
 
 /* disp.c */
-void kdispinit(void);
+void kdispinit(sched_policy_t policy);
+void kdispcpuinit(void);
+void kmlfqinit(mlfq_config_t *config);
 void dispatch(void);
+int kbd_lower_half(void);
+int serial_lower_half(void);
+int ata_lower_half(void);
+int preemptible_dispatch(int call, int arg);
+int fast_dispatch(int call, int arg);
 void ready(pcb_t *proc);
-pcb_t *get_unused_pcb(void);
+pcb_t *get_unused_pcb(pcb_t *owner);
 void enqueue_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue);
 int remove_from_blocked_queue(pcb_t *proc, pcb_t *blocked_on_proc, blocked_queue_t blocked_queue);
-int remove_from_receive_any_queue(pcb_t *proc);
+void update_inherited_priority(pcb_t *proc);
+void reap_terminated(void);
 void idleproc(void);
 
 /* ctsw.c */
@@ -286,10 +1287,15 @@ request_t contextswitch(pcb_t *proc);
 
 /* create.c */
 int create(void (*func)(void), int stack);
+int create_thread(pcb_t *creator, void (*func)(void), int stack);
+int spawn(pcb_t *parent, void (*func)(void *arg), void *args, int args_len, spawn_attr_t *attr);
 void create_idle_proc(pcb_t *idle_proc);
+unsigned long stack_usage(pcb_t *proc);
 
 /* syscall.c */
 int syscall(int call, ...);
+int fastcall(int call, int arg);
+int preemptcall(int call, int arg);
 PID_t syscreate(void (*func)(void), int stack);
 void sysyield(void);
 void sysstop(void);
@@ -309,23 +1315,175 @@ int sysclose(int fd);
 int syswrite(int fd, void *buf, int buflen);
 int sysread(int fd, void *buf, int buflen);
 int sysioctl(int fd, unsigned long command, ...);
+int sysgetmemstats(mem_stats_t *stats);
+void *sysalloc(size_t size);
+int syssetquantum(int milliseconds);
+int syssetrealtime(int period, int budget);
+int syssettickets(int tickets);
+int sysgetsyscallstats(int call, syscall_stats_t *stats);
+int sysclock(unsigned long long *microseconds);
+unsigned int sysusleep(unsigned int microseconds);
+int syssendtim(unsigned int dest_pid, unsigned long num, unsigned int milliseconds);
+int sysrecvtim(unsigned int *from_pid, unsigned int *num, unsigned int milliseconds);
+int systimer(int pid, int signal_number, unsigned int milliseconds, unsigned int period);
+int systimercancel(int timer_id);
+int syssettimerslack(unsigned int milliseconds);
+int syssendv(unsigned int dest_pid, void *buf, unsigned int len);
+int sysrecvv(unsigned int *from_pid, void *buf, unsigned int len);
+int sysrpc(unsigned int dest_pid, unsigned long request, unsigned long *reply);
+int sysreplywait(unsigned int *client_pid, unsigned long reply, unsigned long *request);
+int sysportcreate(void);
+int sysportdestroy(int port);
+int sysportsend(int port, unsigned long num);
+int sysportrecv(int port, unsigned long *num);
+int sysrecvset(unsigned int *from_pid, unsigned int *num, unsigned int *pids, int count);
+int syssendbatch(send_batch_entry_t *msgs, int count);
+int sysrecvbatch(recv_batch_entry_t *msgs, int count);
+int sysshmcreate(size_t size);
+void *sysshmattach(int shm_id);
+int sysshmdetach(int shm_id);
+int sysfutexwait(int *addr, int expected);
+int sysfutexwake(int *addr, int count);
+int syspoll(unsigned int mask, int milliseconds);
+int syssigprocmask(int how, int mask, int *old_mask);
+int syssigqueue(int pid, int signal_number, int value);
+int sysaioread(int fd, void *buf, int buflen, int signal_number);
+int systracectl(int mask);
+int systraceread(unsigned long *cursor, trace_event_t *events, int count);
+int sysprofstart(int pid);
+int sysprofstop(void);
+int sysprofread(profile_t *profile);
+int syslogctl(int level);
+int syslogread(log_record_t *records, int count);
+int sysgetlatency(int request, latency_stats_t *stats);
+int sysgetipcstats(int pid, ipc_stats_t *stats);
+PID_t syscreatethread(void (*func)(void), int stack);
+PID_t sysspawn(void (*func)(void *arg), void *args, int args_len, spawn_attr_t *attr);
+void sysexit(int status);
+PID_t syswaitany(PID_t *pids, int count, int *status);
+int syssetpgid(PID_t pid, PID_t pgid);
+int sysgetpgid(PID_t pid);
+int syskillpg(PID_t pgid, int signal_number);
+PID_t syswaitpg(PID_t pgid, int *status);
+int syssetaffinity(PID_t pid, unsigned long mask);
+int sysgetaffinity(PID_t pid);
+int sysringsetup(io_ring_t *ring);
+int sysringenter(io_ring_t *ring);
+int sysrunwork(void);
+int syswaitwork(void);
 
 /* user.c */
 void init(void);
 void call_sysgetcputimes(void);
+void call_sysgetaccounting(void);
+void call_top(int sort, int refreshes);
+void call_systrace(int follow);
+void call_sysprofread(void);
+void call_sysgetmemstats(void);
+void call_sysgetsyscallstats(void);
+void call_sysgetlatency(void);
+void call_sysgetipcstats(void);
+void call_iobench(void);
+
+/* load.c */
+int load_parse(char *spec, load_config_t *config);
+int load_run(load_config_t *config, load_report_t *report);
+void load_process(void *arg);
 
 /* msg.c */
-int send(pcb_t *send_proc, pcb_t *recv_proc, unsigned long *send_buf);
-int recv(pcb_t *recv_proc, pcb_t *send_proc, unsigned int *from_pid, unsigned int *recv_buf);
+int send(pcb_t *send_proc, pcb_t *recv_proc);
+int recv(pcb_t *recv_proc, pcb_t *send_proc, unsigned int *from_pid);
+void start_reply_wait(pcb_t *proc);
+void ipc_timeout(pcb_t *proc);
+pcb_t *claim_peer(pcb_t *proc, pcb_t *peer, int sending);
+int copy_message_step(pcb_t *proc, int sending, unsigned int *copied);
+void release_peer(pcb_t *proc);
+
+/* port.c */
+void kportinit(void);
+int port_create(pcb_t *owner);
+int port_destroy(pcb_t *owner, int port_id);
+int port_send(pcb_t *proc, int port_id, unsigned long *buf);
+int port_recv(pcb_t *proc, int port_id, unsigned long *buf);
+void release_ports(pcb_t *proc);
+
+/* pgrp.c */
+void kpgrpinit(void);
+int pgrp_join(pcb_t *proc, PID_t pgid);
+void pgrp_leave(pcb_t *proc);
+int pgrp_signal(PID_t pgid, int signal_number);
+int pgrp_has_child(PID_t pgid, PID_t parent_pid);
+
+/* shm.c */
+void kshminit(void);
+int shm_create(pcb_t *proc, size_t size);
+void *shm_attach(pcb_t *proc, int shm_id);
+int shm_detach(pcb_t *proc, int shm_id);
+void release_shm(pcb_t *proc);
+
+/* futex.c */
+void kfutexinit(void);
+int futex_wait(pcb_t *proc, int *addr, int expected);
+int futex_wake(int *addr, int count);
+
+/* poll.c */
+void kpollinit(void);
+unsigned int poll_ready(pcb_t *proc, unsigned int mask);
+void poll_block(pcb_t *proc, unsigned int mask, int milliseconds);
+void poll_check(pcb_t *proc);
+void poll_wakeup(void);
+void poll_timeout(pcb_t *proc);
+
+/* sync.c */
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+int mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+void sem_init(semaphore_t *sem, int count);
+void sem_wait(semaphore_t *sem);
+int sem_trywait(semaphore_t *sem);
+void sem_post(semaphore_t *sem);
+void cond_init(cond_t *cond);
+void cond_wait(cond_t *cond, mutex_t *mutex);
+void cond_signal(cond_t *cond);
+void cond_broadcast(cond_t *cond);
+int compare_and_swap(volatile int *ptr, int expected, int value);
+int exchange(volatile int *ptr, int value);
+int fetch_add(volatile int *ptr, int value);
+
+/* coro.c */
+void coro_init(coro_sched_t *sched);
+int coro_create(coro_sched_t *sched, coro_t *coro, void *stack, int stack_size, void (*func)(void *arg), void *arg);
+void coro_run(coro_sched_t *sched);
+void coro_yield(coro_sched_t *sched);
+void coro_block(coro_sched_t *sched);
+void coro_wake(coro_t *coro);
+coro_t *coro_self(coro_sched_t *sched);
 
 /* sleep.c */
 void ksleepinit(void);
 void sleep(pcb_t *proc, unsigned int milliseconds);
+void sleep_us(pcb_t *proc, unsigned int microseconds);
+unsigned int cancel_sleep(pcb_t *proc);
 void tick(void);
+void set_timeout(pcb_t *proc, unsigned int milliseconds);
+void cancel_timeout(pcb_t *proc);
+int arm_timer(pcb_t *owner, pcb_t *target, int signal_number, unsigned int milliseconds, unsigned int period);
+int cancel_timer(pcb_t *owner, int timer_id);
+void release_timers(pcb_t *proc);
+void tickless_enter(void);
+int tickless_exit(void);
+int split_exit(void);
+unsigned long long clock_us(void);
+unsigned long tick_age_us(void);
 
 /* signal.c */
 void sigtramp(signal_handler_funcptr handler, void *cntx);
 int signal(pcb_t *proc_to_signal, int signal_number);
+int queue_signal(pcb_t *proc_to_signal, int signal_number, unsigned int sender_pid, int value);
+int reserve_queued_signal(pcb_t *proc);
+void release_queued_signal(pcb_t *proc);
+siginfo_t *signal_info(void *cntx);
 void handle_pending_signals(pcb_t *proc);
 int set_signal_bit(int bitmask, int signal_number);
 int is_signal_bit_set(int bitmask, int signal_number);
@@ -333,17 +1491,109 @@ int clear_signal_bit(int bitmask, int signal_number);
 
 /* di_calls.c */
 void kdiinit(void);
+int di_register(devsw_t *devsw, char *name, int major, int minor);
+int di_lookup(char *name);
+void di_init_fds(pcb_t *proc);
+void di_release_fds(pcb_t *proc);
+void di_inherit_fds(pcb_t *proc, pcb_t *parent);
 int di_open(pcb_t *current_proc, int device_no);
 int di_close(pcb_t *current_proc, int fd);
 int di_write(pcb_t *current_proc, int fd, void *buf, int buflen);
 int di_read(pcb_t *current_proc, int fd, void *buf, int buflen);
 int di_ioctl(pcb_t *current_proc, int fd, unsigned long command, void *ioctl_args);
+int di_aioread(pcb_t *current_proc, int fd, void *buf, int buflen, int signal_number);
+int di_step(pcb_t *current_proc, int fd, void *buf, int buflen, int write);
+
+/* workq.c */
+void kworkinit(void);
+void init_work(work_t *work, work_funcptr func);
+int queue_work(work_t *work);
+int run_work(void);
+int run_next_work(void);
+int wait_for_work(pcb_t *proc);
+void kworkstart(void);
+void work_process(void *arg);
+int work_pending(void);
+void get_work_stats(work_stats_t *stats);
+
+/* trace.c */
+// The categories of events being recorded, tested inline so a disabled event costs
+// a load and a branch
+extern unsigned int trace_mask;
+#define TRACE(category, type, pid, arg0, arg1) \
+    do { \
+        if (trace_mask & (category)) trace_record((type), (pid), (arg0), (arg1)); \
+    } while (0)
+void ktraceinit(void);
+void trace_record(trace_type_t type, unsigned int pid, unsigned long arg0, unsigned long arg1);
+int trace_set_mask(int mask);
+int trace_read(unsigned long *cursor, trace_event_t *events, int count);
+
+/* klog.c */
+// The most verbose level of records being made, tested inline so a record that is
+// not made costs a load and a branch, and nothing above LOG_COMPILE_LEVEL is compiled
+extern int log_level;
+#define KLOG(level, ...) \
+    do { \
+        if ((level) <= LOG_COMPILE_LEVEL && (level) <= log_level) klog_record((level), __VA_ARGS__); \
+    } while (0)
+void kloginit(void);
+void klog_record(int level, char *fmt, ...);
+int log_set_level(int level);
+int log_read(log_record_t *records, int count);
+
+/* latency.c */
+void klatencyinit(void);
+void latency_span(request_t request, unsigned long long cycles);
+void latency_tick(request_t request, unsigned long us);
+int get_latency_stats(int request, latency_stats_t *stats);
+
+/* profile.c */
+void kprofileinit(void);
+int profile_start(int pid);
+int profile_stop(void);
+void profile_tick(pcb_t *proc);
+void get_profile(profile_t *profile);
+
+/* util.c */
+int find_first_set_bit(unsigned long word);
+int find_last_set_bit(unsigned long word);
+void copy_words(void *dst, const void *src, size_t len);
+void move_words(void *dst, const void *src, size_t len);
+void fill_words(void *dst, int c, size_t len);
+unsigned long long read_tsc(void);
+int get_process_status(PID_t pid, proc_status_t *status);
+void *alloc_buffer(size_t size, int *shm_id);
+void free_buffer(int shm_id);
+
+/* string.c */
+int strlen_words(char *s);
+int strcmp_words(char *s1, char *s2);
+int strncmp_words(char *s1, char *s2, int n);
+char *strncpy_words(char *s1, char *s2, int n);
 
 /* Functions for testing */
 void run_device_test(void);
 void run_mem_test(void);
+void run_slab_test(void);
+void run_page_test(void);
+void run_arena_test(void);
+void run_paging_test(void);
+void run_smp_test(void);
 void run_queue_test(void);
-void run_deltalist_test(void);
+void run_timerwheel_test(void);
+void run_workq_test(void);
+void run_ldisc_test(void);
+void run_trace_test(void);
+void run_profile_test(void);
+void run_realtime_test(void);
+void run_klog_test(void);
+void run_latency_test(void);
+void run_util_test(void);
+void run_format_test(void);
+void run_string_test(void);
+void run_e820_test(void);
+void run_load_test(void);
 void run_syscall_test(void);
 void run_create_test(void);
 void run_msg_test(void);
@@ -357,5 +1607,11 @@ void m(int n);
 void dummy_process(void);
 void yield_to_all(void);
 
+/* Functions for benchmarking */
+void run_boot_bench(void);
+void run_alloc_bench(void);
+void run_string_bench(void);
+void run_bench(void);
+
 /* Anything you add must be between the #define and this comment */
 #endif